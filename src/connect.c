@@ -43,6 +43,24 @@
 #include "config.h"
 #include "error.h"
 #include "util.h"
+#include "server/ackframe.h"
+#include "server/resumeframe.h"
+#include "server/topicframe.h"
+#include "server/searchframe.h"
+
+
+
+/**
+ * The send_request_line() function shall send the request line of server/topicframe.h that starts with the string pointed to by
+ * parameter verb, followed by the names in the string pointed to by parameter names, with the commas turned to spaces if parameter
+ * commas is nonzero, to the twitserver associated with the socket file descriptor given as parameter. If the line is too long the
+ * message pointed to by parameter toolong is written to stderr.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ */
+static int send_request_line( int sockfd, const char *verb, const char *names, int commas, const char *toolong );
+
+
 
 // Establish a connection with the twitserver. Return the twitserver file descriptor if ok and -1 otherwise
 int connect_to_twitserver( const char * restrict addr, const char * restrict port ){
@@ -144,6 +162,142 @@ int recv_from_twitserver( int sockfd, int timeunit ){
 	return ( status );
 }
 
+// Ask for the twits missed. Return 0 if ok and -1 otherwise.
+int send_resume_to_twitserver( int sockfd, int bytime, unsigned long long value ){
+	char line[ RESUMEFRAME_REQUEST_MAXLEN ];
+	int len;
+
+	len = snprintf( line, sizeof( line ), "%s %llu\n", bytime ? "TIME" : "SEQ", value );
+	assert( len > 0 && len < ( int )sizeof( line ) );
+	errno = 0;
+	if ( writeall( sockfd, line, ( size_t )len ) != ( ssize_t )len ){
+		error( "failed to send the request to the twitserver: (%s)\n", strerror( errno ) );
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+// Ask for the twits after the cursor. Return 0 if ok and -1 otherwise.
+int send_cursor_to_twitserver( int sockfd, const char *name ){
+	char line[ RESUMEFRAME_REQUEST_MAXLEN ];
+	int len;
+
+	assert( name != NULL );
+
+	len = snprintf( line, sizeof( line ), "CURSOR %s\n", name );
+	if ( len < 0 || len >= ( int )sizeof( line ) ){
+		error( "the name of the cursor is too long\n" );
+		return ( -1 );
+	}
+	errno = 0;
+	if ( writeall( sockfd, line, ( size_t )len ) != ( ssize_t )len ){
+		error( "failed to send the request to the twitserver: (%s)\n", strerror( errno ) );
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+// Name the topics, the commas turned to spaces; the twitserver checks the names. Return 0 if ok and -1 otherwise.
+int send_topics_to_twitserver( int sockfd, const char *names ){
+	assert( names != NULL );
+
+	return ( send_request_line( sockfd, TOPICFRAME_TOPICS, names, 1, "too many topics\n" ) );
+}
+
+// Give the keywords, the commas turned to spaces; the twitserver checks them. Return 0 if ok and -1 otherwise.
+int send_keywords_to_twitserver( int sockfd, const char *words ){
+	assert( words != NULL );
+
+	return ( send_request_line( sockfd, TOPICFRAME_KEYWORDS, words, 1, "too many keywords\n" ) );
+}
+
+// Give the regular expressions as they are, separated by spaces, since a comma may be in one. Return 0 if ok and -1 otherwise.
+int send_regexes_to_twitserver( int sockfd, const char *patterns ){
+	assert( patterns != NULL );
+
+	return ( send_request_line( sockfd, TOPICFRAME_REGEXES, patterns, 0, "too many regular expressions\n" ) );
+}
+
+// Give the hashtags and mentions, the commas turned to spaces, after the number of recent twits if any were asked for. Return 0 if ok
+// and -1 otherwise.
+int send_tags_to_twitserver( int sockfd, const char *names, unsigned recent ){
+	char verb[ sizeof( TOPICFRAME_RECENT ) + 16 ];
+
+	assert( names != NULL );
+
+	if ( recent == 0 ){
+		return ( send_request_line( sockfd, TOPICFRAME_TAGS, names, 1, "too many hashtags and mentions\n" ) );
+	}
+	( void )snprintf( verb, sizeof( verb ), "%s%u ", TOPICFRAME_RECENT, recent );
+
+	return ( send_request_line( sockfd, verb, names, 1, "too many hashtags and mentions\n" ) );
+}
+
+// Give the words, the commas turned to spaces, after how many twits are wanted. Return 0 if ok and -1 otherwise.
+int send_search_to_twitserver( int sockfd, const char *words, unsigned count, int any ){
+	char verb[ sizeof( SEARCHFRAME_AND ) + 16 ];
+
+	assert( words != NULL );
+
+	( void )snprintf( verb, sizeof( verb ), "%s%u ", any ? SEARCHFRAME_OR : SEARCHFRAME_AND, count );
+	if ( strlen( verb ) + strlen( words ) + 1 > SEARCHFRAME_REQUEST_MAXLEN ){
+		error( "too many words\n" );
+		return ( -1 );
+	}
+
+	return ( send_request_line( sockfd, verb, words, 1, "too many words\n" ) );
+}
+
+// Receive framed twits and print them. Return 0 if the twitserver closed the connection and -1 otherwise.
+int recv_frames_from_twitserver( int sockfd, int timeunit ){
+	unsigned char header[ RESUMEFRAME_HEADER_SIZE ];
+	char twit[ 65536 ];
+	unsigned long long seq;
+	size_t len;
+	ssize_t nbytes;
+	int i;
+
+	assert( timeunit >= 0 );
+
+	while ( 1 ){
+		sleep( timeunit );
+		errno = 0;
+		if ( ( nbytes = readall( sockfd, header, sizeof( header ) ) ) == 0 ){
+			return ( 0 );
+		}
+		if ( nbytes != ( ssize_t )sizeof( header ) ){
+			error( "could not receive a twit from the twit server: (%s)\n", nbytes == -1 ? strerror( errno ) : "connection closed" );
+			return ( -1 );
+		}
+		// The numbers are little-endian
+		seq = 0;
+		for ( i = 7; i >= 0; --i ){
+			seq = ( seq << 8 ) | header[ RESUMEFRAME_SEQ_OFFSET + i ];
+		}
+		len = ( size_t )header[ RESUMEFRAME_LEN_OFFSET ] | ( ( size_t )header[ RESUMEFRAME_LEN_OFFSET + 1 ] << 8 );
+		errno = 0;
+		if ( len > 0 && ( nbytes = readall( sockfd, twit, len ) ) != ( ssize_t )len ){
+			error( "could not receive a twit from the twit server: (%s)\n", nbytes == -1 ? strerror( errno ) : "connection closed" );
+			return ( -1 );
+		}
+		// The twit may end with its nul byte and a newline; the line has one already
+		if ( len > 0 && twit[ len - 1 ] == '\0' ){
+			--len;
+		}
+		if ( len > 0 && twit[ len - 1 ] == '\n' ){
+			--len;
+		}
+		errno = 0;
+		if ( fprintf( stdout, "%llu %.*s\n", seq, ( int )len, twit ) < 0 ){
+			error( "could not send twit to stdout: (%s)\n", strerror( errno ) );
+			return ( -1 );
+		}
+		( void )fflush( stdout );
+	}
+}
+
 // Send a twit to the twitserver. Return 0 if ok and -1 otherwise.
 int send_to_twitserver( int sockfd, const char * restrict buf, size_t nbytes ){	
 	size_t bytesToSend = nbytes <= TWIT_MAXLEN ? nbytes : TWIT_MAXLEN;
@@ -160,6 +314,34 @@ int send_to_twitserver( int sockfd, const char * restrict buf, size_t nbytes ){
 	return ( status );
 }
 
+// Receive the acknowledgement of the twit sent last. Return 0 if ok and -1 otherwise.
+int recv_ack_from_twitserver( int sockfd, int * restrict ackstatus, unsigned long long * restrict seq ){
+	unsigned char frame[ ACKFRAME_SIZE ];
+	ssize_t nbytes;
+	int i;
+
+	assert( ackstatus != NULL );
+	assert( seq != NULL );
+
+	errno = 0;
+	if ( ( nbytes = readall( sockfd, frame, sizeof( frame ) ) ) != ( ssize_t )sizeof( frame ) ){
+		error( "failed to receive the acknowledgement from the twitserver: (%s)\n", nbytes == -1 ? strerror( errno ) : "connection closed" );
+		return ( -1 );
+	}
+	if ( frame[ 0 ] != ACKFRAME_MAGIC0 || frame[ 1 ] != ACKFRAME_MAGIC1 ){
+		error( "the twitserver sent something that is not an acknowledgement\n" );
+		return ( -1 );
+	}
+	*ackstatus = frame[ 2 ];
+	// The sequence number is little-endian
+	*seq = 0;
+	for ( i = 7; i >= 0; --i ){
+		*seq = ( *seq << 8 ) | frame[ 4 + i ];
+	}
+
+	return ( 0 );
+}
+
 // Close connection with the twitserver. Return 0 if ok and -1 otherwise.
 int disconnect_from_twitserver( enum TwitClientType twitClientType, int sockfd ){
 	int status = 0;
@@ -174,3 +356,33 @@ int disconnect_from_twitserver( enum TwitClientType twitClientType, int sockfd )
 
 	return ( status );
 }
+
+
+
+// Implementation of local functions...
+
+// One write for the whole line; the twitserver reads it up to the newline
+static int send_request_line( int sockfd, const char *verb, const char *names, int commas, const char *toolong ){
+	char line[ TOPICFRAME_REQUEST_MAXLEN ];
+	size_t verblen = strlen( verb );
+	int len;
+	int i;
+
+	len = snprintf( line, sizeof( line ), "%s%s\n", verb, names );
+	if ( len < 0 || len >= ( int )sizeof( line ) ){
+		error( "%s", toolong );
+		return ( -1 );
+	}
+	for ( i = ( int )verblen; commas && i < len; ++i ){
+		if ( line[ i ] == ',' ){
+			line[ i ] = ' ';
+		}
+	}
+	errno = 0;
+	if ( writeall( sockfd, line, ( size_t )len ) != ( ssize_t )len ){
+		error( "failed to send the request to the twitserver: (%s)\n", strerror( errno ) );
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
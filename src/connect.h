@@ -75,6 +75,102 @@ int connect_to_twitserver( const char * restrict addr, const char * restrict por
  */
 int recv_from_twitserver( int sockfd, int timeunit );
 
+/**
+ * The send_resume_to_twitserver() function shall ask the twitserver associated with the socket file descriptor given as parameter, which
+ * shall be connected to its resuming port, for the twits after the one with the sequence number given as parameter value or, if parameter
+ * bytime is nonzero, for the twits since value milliseconds since the Epoch (see server/resumeframe.h). The send_resume_to_twitserver()
+ * function shall write to stderr any message in case of failure.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ * @param sockfd The twitserver file descriptor.
+ * @param bytime Whether value is a time.
+ * @param value The sequence number or the time.
+ */
+int send_resume_to_twitserver( int sockfd, int bytime, unsigned long long value );
+
+/**
+ * The send_cursor_to_twitserver() function shall ask the twitserver associated with the socket file descriptor given as parameter, which
+ * shall be connected to its resuming port, for the twits after the last one it sent to a hearer with the cursor named by parameter name
+ * (see server/resumeframe.h). The send_cursor_to_twitserver() function shall write to stderr any message in case of failure.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ * @param sockfd The twitserver file descriptor.
+ * @param name The name of the cursor.
+ */
+int send_cursor_to_twitserver( int sockfd, const char *name );
+
+/**
+ * The send_topics_to_twitserver() function shall ask the twitserver associated with the socket file descriptor given as parameter, which
+ * shall be connected to its topic port, for the twits on the topics named in the string pointed to by parameter names, separated by commas
+ * (see server/topicframe.h). The send_topics_to_twitserver() function shall write to stderr any message in case of failure.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ * @param sockfd The twitserver file descriptor.
+ * @param names The names of the topics.
+ */
+int send_topics_to_twitserver( int sockfd, const char *names );
+
+/**
+ * The send_keywords_to_twitserver() function shall ask the twitserver associated with the socket file descriptor given as parameter, which
+ * shall be connected to its topic port, for the twits that contain any of the keywords in the string pointed to by parameter words, separated
+ * by commas (see server/topicframe.h). The send_keywords_to_twitserver() function shall write to stderr any message in case of failure.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ * @param sockfd The twitserver file descriptor.
+ * @param words The keywords.
+ */
+int send_keywords_to_twitserver( int sockfd, const char *words );
+
+/**
+ * The send_regexes_to_twitserver() function shall ask the twitserver associated with the socket file descriptor given as parameter, which
+ * shall be connected to its topic port, for the twits that match any of the regular expressions in the string pointed to by parameter
+ * patterns, separated by spaces (see server/topicframe.h). The send_regexes_to_twitserver() function shall write to stderr any message in
+ * case of failure.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ * @param sockfd The twitserver file descriptor.
+ * @param patterns The regular expressions.
+ */
+int send_regexes_to_twitserver( int sockfd, const char *patterns );
+
+/**
+ * The send_tags_to_twitserver() function shall ask the twitserver associated with the socket file descriptor given as parameter, which
+ * shall be connected to its topic port, for the twits with any of the hashtags and mentions in the string pointed to by parameter names,
+ * separated by commas, after the last recent of them it has if parameter recent is not zero (see server/topicframe.h). The
+ * send_tags_to_twitserver() function shall write to stderr any message in case of failure.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ * @param sockfd The twitserver file descriptor.
+ * @param names The hashtags and mentions.
+ * @param recent The number of recent twits asked for; zero for none.
+ */
+int send_tags_to_twitserver( int sockfd, const char *names, unsigned recent );
+
+/**
+ * The send_search_to_twitserver() function shall ask the twitserver associated with the socket file descriptor given as parameter, which
+ * shall be connected to its search port, for the last count twits with all of the words in the string pointed to by parameter words,
+ * separated by commas, or with any of them if parameter any is nonzero (see server/searchframe.h). The send_search_to_twitserver()
+ * function shall write to stderr any message in case of failure.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ * @param sockfd The twitserver file descriptor.
+ * @param words The words.
+ * @param count The number of twits asked for, from 1 to 100.
+ * @param any Whether a twit needs only one of the words.
+ */
+int send_search_to_twitserver( int sockfd, const char *words, unsigned count, int any );
+
+/**
+ * The recv_frames_from_twitserver() function shall receive the framed twits a twitserver sends to the hearers connected to its resuming port,
+ * and to the clients of its search port, from the twitserver associated with the socket file descriptor given as parameter and print each
+ * one to stdout on a line of its own, after its sequence number. The recv_frames_from_twitserver() function shall write to stderr any message in case of failure. The
+ * recv_frames_from_twitserver() function shall receive each twit from the server every timeunit time.
+ *
+ * @return The recv_frames_from_twitserver() function shall return zero if the twitserver closed the connection; otherwise, -1 shall be returned.
+ * @param sockfd The twitserver file descriptor.
+ */
+int recv_frames_from_twitserver( int sockfd, int timeunit );
+
 /**
  * The send_to_twitserver() function shall send nbytes bytes starting from the byte pointed to by parameter buf, which shall not be a NULL pointer,
  * to the twitserver associated with the socket file descriptor given as parameter. The send_to_twitserver() function shall write to stderr any message
@@ -87,6 +183,20 @@ int recv_from_twitserver( int sockfd, int timeunit );
  */
 int send_to_twitserver( int sockfd, const char * restrict buf, size_t nbytes );
 
+/**
+ * The recv_ack_from_twitserver() function shall receive from the twitserver associated with the socket file descriptor given as parameter
+ * the acknowledgement of the twit sent last, which a twitserver sends to the sayers connected to its durable port (see server/ackframe.h).
+ * The status of the acknowledgement, one of the ACKFRAME_ values, shall be stored in the object pointed to by parameter ackstatus and the
+ * sequence number of the twit in the twit log in the object pointed to by parameter seq. The recv_ack_from_twitserver() function shall
+ * write to stderr any message in case of failure.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ * @param sockfd The twitserver file descriptor.
+ * @param ackstatus Pointer to where the status is stored.
+ * @param seq Pointer to where the sequence number is stored.
+ */
+int recv_ack_from_twitserver( int sockfd, int * restrict ackstatus, unsigned long long * restrict seq );
+
 /**
  * The disconnect_from_twitserver() function shall close the connection with twitserver associated with the socket file descriptor given as
  * parameter. The disconnect_from_twitserver() function shall write to stderr any message in case of failure. Parameter twitClientType, which
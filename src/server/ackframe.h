@@ -0,0 +1,66 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file ackframe.h
+ *
+ * File ackframe.h defines the frame the server sends back to a sayer connected to DURABLE_SAYERS_PORT for each twit it sends,
+ * once the fate of the twit is known. The sayer sends the next twit after it has read the frame. A frame is ACKFRAME_SIZE bytes:
+ *	offset 0: ACKFRAME_MAGIC0 and ACKFRAME_MAGIC1
+ *	offset 2: status; one of the ACKFRAME_ values below
+ *	offset 3: zero
+ *	offset 4: sequence number of the twit in the twit log, little-endian; zero with ACKFRAME_REJECTED (uint64_t)
+ *
+ * This header is shared with the clients so it only holds macros.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( ACKFRAME_H_IS_INCLUDED )
+#define ACKFRAME_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#define ACKFRAME_SIZE (12)
+
+#define ACKFRAME_MAGIC0 ('A')
+#define ACKFRAME_MAGIC1 ('K')
+
+// The twit is synced to the twit log
+#define ACKFRAME_SYNCED (0)
+
+// The twit was not taken because the server holds too many twits
+#define ACKFRAME_REJECTED (1)
+
+// The twit was taken but may not be in the twit log; a write or a sync failed or the server stopped first
+#define ACKFRAME_FAILED (2)
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
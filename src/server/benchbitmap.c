@@ -0,0 +1,276 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchbitmap.c
+ *
+ * File benchbitmap.c measures the time to find the hearers of a twit with the bitmaps of bitmap.h, with the hearers the server
+ * takes: HEARERS_MAXCOUNT hearers subscribe to HEARER_TOPICS_MAXCOUNT topics and HEARER_KEYWORDS_MAXCOUNT keywords each, out of
+ * MAX_TERMS terms picked with the skew of words. A twit is on a topic and has TWIT_TERMS keywords in it; its hearers are the union
+ * of the bitmaps of those terms, listed for the delivery, as the consumer finds them. The same is done with 256 hearers, for when
+ * hearers handed over are more than HEARERS_MAXCOUNT for a while, and with 4096, to see how far the bitmaps hold up.
+ *
+ * The baseline keeps the subscribers of each term in a sorted array and walks those of the terms of the twit, skipping the hearers
+ * already found by the number of the twit, as the lists of subscribers used to be walked. The hearers found both ways are checked
+ * to be the same.
+ *
+ * Usage: benchbitmap [hearers]
+ *
+ * @author Tassos Souris
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitmap.h"
+#include "benchutil.h"
+#include "config.h"
+#include "timing.h"
+
+// The most hearers measured, and the terms they subscribe to
+#define MAX_HEARERS (4096)
+#define MAX_TERMS (1000)
+
+// The terms each hearer subscribes to; one picked twice counts once
+#define HEARER_TERMS ( HEARER_TOPICS_MAXCOUNT + HEARER_KEYWORDS_MAXCOUNT )
+
+// The twits measured, and the keywords in each one besides its topic
+#define TWITS (2000)
+#define TWIT_TERMS (3)
+
+// The twits are gone through this many times for each measure; the best time counts
+#define ROUNDS (50)
+
+/**
+ * The comparenumbers() function shall compare the numbers pointed to by parameters a and b for qsort().
+ *
+ * @return Less than, equal to or greater than zero as the first is less than, equal to or greater than the second.
+ */
+static int comparenumbers( const void *a, const void *b );
+
+/**
+ * The findhearers() function shall find the hearers of the twit with the terms pointed to by parameter terms in the bitmaps of
+ * the terms pointed to by parameter bitmaps, into the bitmap pointed to by parameter twitset, store them in the array pointed to
+ * by parameter out, and count them.
+ *
+ * @return The number of hearers.
+ */
+static size_t findhearers( const struct bitmap * restrict bitmaps, const uint32_t * restrict terms, struct bitmap * restrict twitset,
+	uint32_t * restrict out );
+
+/**
+ * The benchhearers() function shall subscribe the number of hearers given as parameter nhearers to the terms, with the sums of
+ * the skew pointed to by parameter sums, and time finding the hearers of the twits with the terms pointed to by parameter twits,
+ * with the bitmaps and with the baseline, printing a line of the results.
+ *
+ * @return Nothing.
+ */
+static void benchhearers( uint32_t nhearers, const double * restrict sums, const uint32_t ( *twits )[ TWIT_TERMS + 1 ],
+	uint64_t * restrict random );
+
+int main( int argc, char *argv[] ){
+	static double sums[ MAX_TERMS ];
+	static uint32_t twits[ TWITS ][ TWIT_TERMS + 1 ];
+	static const uint32_t counts[] = { HEARERS_MAXCOUNT, 256, MAX_HEARERS };
+	uint64_t random = 88172645463325252ull;
+	uint32_t nhearers = 0;
+	size_t i;
+	size_t k;
+
+	if ( argc > 1 ){
+		nhearers = ( uint32_t )strtoul( argv[ 1 ], NULL, 10 );
+		if ( nhearers == 0 || nhearers > MAX_HEARERS ){
+			( void )fprintf( stderr, "benchbitmap: the hearers are from 1 to %d\n", MAX_HEARERS );
+			exit( EXIT_FAILURE );
+		}
+	}
+
+	for ( i = 0; i < MAX_TERMS; ++i ){
+		sums[ i ] = ( i > 0 ? sums[ i - 1 ] : 0.0 ) + 1.0 / ( double )( i + 1 );
+	}
+	for ( i = 0; i < TWITS; ++i ){
+		for ( k = 0; k < TWIT_TERMS + 1; ++k ){
+			twits[ i ][ k ] = pickrank( sums, MAX_TERMS, &random );
+		}
+	}
+
+	( void )printf( "%d terms, %d for each hearer; %d twits, each on a topic with %d keywords\n\n", MAX_TERMS, HEARER_TERMS, TWITS,
+		TWIT_TERMS );
+	( void )printf( "%8s %14s %10s %10s %14s %9s %10s %10s\n", "hearers", "subscriptions", "arrays ns", "bitmap ns", "hearers/twit",
+		"speedup", "arrays KB", "bitmap KB" );
+	if ( nhearers > 0 ){
+		benchhearers( nhearers, sums, twits, &random );
+	}
+	else{
+		for ( i = 0; i < sizeof( counts ) / sizeof( *counts ); ++i ){
+			benchhearers( counts[ i ], sums, twits, &random );
+		}
+	}
+
+	exit( EXIT_SUCCESS );
+}
+
+static int comparenumbers( const void *a, const void *b ){
+	uint32_t x = *( const uint32_t * )a;
+	uint32_t y = *( const uint32_t * )b;
+
+	return ( ( x > y ) - ( x < y ) );
+}
+
+// As the consumer does it, in a bitmap kept from one twit to the next
+static size_t findhearers( const struct bitmap * restrict bitmaps, const uint32_t * restrict terms, struct bitmap * restrict twitset,
+	uint32_t * restrict out ){
+	size_t k;
+
+	clearbitmap( twitset );
+	for ( k = 0; k < TWIT_TERMS + 1; ++k ){
+		( void )orbitmap( twitset, &bitmaps[ terms[ k ] ] );
+	}
+
+	return ( bitmaptoarray( twitset, 0, out, MAX_HEARERS ) );
+}
+
+// The arrays of the baseline are listed from the bitmaps, so they are sorted and have each hearer once
+static void benchhearers( uint32_t nhearers, const double * restrict sums, const uint32_t ( *twits )[ TWIT_TERMS + 1 ],
+	uint64_t * restrict random ){
+	static struct bitmap bitmaps[ MAX_TERMS ];
+	static uint32_t *lists[ MAX_TERMS ];
+	static size_t listlens[ MAX_TERMS ];
+	static uint32_t stamps[ MAX_HEARERS ];
+	static uint32_t stamp = 0;
+	static uint32_t out[ MAX_HEARERS ];
+	static uint32_t expected[ MAX_HEARERS ];
+	struct bitmap twitset;
+	size_t subscriptions = 0;
+	size_t arraybytes = 0;
+	size_t bitmapbytes = 0;
+	size_t found;
+	size_t total = 0;
+	size_t count;
+	size_t i;
+	size_t k;
+	uint64_t begin;
+	uint64_t elapsed;
+	uint64_t best;
+	uint64_t baseline;
+	uint32_t term;
+	uint32_t h;
+	int round;
+
+	for ( i = 0; i < MAX_TERMS; ++i ){
+		initbitmap( &bitmaps[ i ] );
+	}
+	for ( h = 0; h < nhearers; ++h ){
+		for ( k = 0; k < HEARER_TERMS; ++k ){
+			if ( addtobitmap( &bitmaps[ pickrank( sums, MAX_TERMS, random ) ], h ) == -1 ){
+				( void )fprintf( stderr, "addtobitmap() failed (%s)\n", strerror( errno ) );
+				exit( EXIT_FAILURE );
+			}
+		}
+	}
+	for ( i = 0; i < MAX_TERMS; ++i ){
+		listlens[ i ] = bitmapcount( &bitmaps[ i ] );
+		if ( ( lists[ i ] = malloc( ( listlens[ i ] + 1 ) * sizeof( **lists ) ) ) == NULL ){
+			perror( "malloc" );
+			exit( EXIT_FAILURE );
+		}
+		( void )bitmaptoarray( &bitmaps[ i ], 0, lists[ i ], listlens[ i ] );
+		subscriptions += listlens[ i ];
+		arraybytes += listlens[ i ] * sizeof( **lists );
+		bitmapbytes += bitmaps[ i ].bm_capacity * sizeof( *bitmaps[ i ].bm_words );
+	}
+	initbitmap( &twitset );
+
+	// The same hearers both ways, in order
+	for ( i = 0; i < TWITS; ++i ){
+		count = findhearers( bitmaps, twits[ i ], &twitset, out );
+		++stamp;
+		for ( found = 0, k = 0; k < TWIT_TERMS + 1; ++k ){
+			term = twits[ i ][ k ];
+			for ( h = 0; h < listlens[ term ]; ++h ){
+				if ( stamps[ lists[ term ][ h ] ] != stamp ){
+					stamps[ lists[ term ][ h ] ] = stamp;
+					expected[ found++ ] = lists[ term ][ h ];
+				}
+			}
+		}
+		qsort( expected, found, sizeof( *expected ), &comparenumbers );
+		if ( count != found || memcmp( out, expected, found * sizeof( *out ) ) != 0 ){
+			( void )fprintf( stderr, "twit %llu: the bitmaps found other hearers (%llu instead of %llu)\n", ( unsigned long long )i,
+				( unsigned long long )count, ( unsigned long long )found );
+			exit( EXIT_FAILURE );
+		}
+	}
+
+	// The baseline
+	best = UINT64_MAX;
+	for ( round = 0; round < ROUNDS; ++round ){
+		begin = monotonic_ns();
+		for ( i = 0; i < TWITS; ++i ){
+			++stamp;
+			for ( found = 0, k = 0; k < TWIT_TERMS + 1; ++k ){
+				term = twits[ i ][ k ];
+				for ( count = 0; count < listlens[ term ]; ++count ){
+					h = lists[ term ][ count ];
+					if ( stamps[ h ] != stamp ){
+						stamps[ h ] = stamp;
+						out[ found++ ] = h;
+					}
+				}
+			}
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < best ){
+			best = elapsed;
+		}
+	}
+	baseline = best;
+
+	// The bitmaps
+	best = UINT64_MAX;
+	for ( round = 0; round < ROUNDS; ++round ){
+		total = 0;
+		begin = monotonic_ns();
+		for ( i = 0; i < TWITS; ++i ){
+			total += findhearers( bitmaps, twits[ i ], &twitset, out );
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < best ){
+			best = elapsed;
+		}
+	}
+	( void )printf( "%8u %14llu %10.1f %10.1f %14.1f %8.1fx %10.1f %10.1f\n", ( unsigned )nhearers, ( unsigned long long )subscriptions,
+		( double )baseline / TWITS, ( double )best / TWITS, ( double )total / TWITS, ( double )baseline / best, arraybytes / 1024.0,
+		bitmapbytes / 1024.0 );
+	( void )fflush( stdout );
+
+	for ( i = 0; i < MAX_TERMS; ++i ){
+		delbitmap( &bitmaps[ i ] );
+		free( lists[ i ] );
+	}
+	delbitmap( &twitset );
+
+	return ;
+}
@@ -0,0 +1,315 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchfulltext.c
+ *
+ * File benchfulltext.c measures the full-text index of fulltext.h: the time the consumer takes to add a twit to it, so the rate of
+ * twits it keeps up with, and the bytes its posting lists take, and the time to find the last SEARCH_RESULTS_MAXCOUNT twits with all
+ * or with any of the words of a search, with the blocks unpacked by the scalar code and by the SSE2 one, against going through the
+ * twits for them, newest first, each twit of it split into its words, as a search would have to without the index.
+ *
+ * The twits are runs of the words of a corpus (the twits_collection at the top of the repository by default), from a place picked at
+ * random, with a word out of MAX_WORDS more put in each, picked with the skew of words, so that there are rare words too. The searches
+ * are of two words of the corpus with all of them, of one of the corpus and one of the others with all of them, and of two of the
+ * others with any of them; the twits found with the index and without it are checked to be the same.
+ *
+ * Usage: benchfulltext [corpus [twits]]
+ *
+ * @author Tassos Souris
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fulltext.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "config.h"
+
+// The twits made by default, as many as the index keeps, and the words put in them besides those of the corpus
+#define DEFAULT_TWITS ( SEARCH_SEGMENTS_MAXCOUNT * SEARCH_SEGMENT_TWITS )
+#define MAX_WORDS (50000)
+
+// The searches of each kind
+#define QUERIES (100)
+
+// The searches are done this many times with the index; the best time counts
+#define ROUNDS (5)
+
+/**
+ * \struct benchquery
+ *
+ * The benchquery structure is a search: its words, as sent in the request, and whether any of them is enough.
+ */
+struct benchquery{
+	char bq_words[ 2 * ( SEARCH_WORD_MAXLEN + 1 ) ];
+	enum fulltextop bq_op;
+};
+
+/**
+ * The isword() function shall check whether the byte given as parameter c can be in a word, as fulltext.h has it.
+ *
+ * @return Nonzero if it can, zero otherwise.
+ */
+static int isword( unsigned char c );
+
+/**
+ * The haswords() function shall check whether the twit of len bytes pointed to by parameter twit has all of the words of the search
+ * pointed to by parameter bq, or any of them, splitting it into its words as the index does.
+ *
+ * @return Nonzero if it does, zero otherwise.
+ */
+static int haswords( const char * restrict twit, size_t len, const struct benchquery * restrict bq );
+
+int main( int argc, char *argv[] ){
+	static double sums[ MAX_WORDS ];
+	static uint64_t seqs[ SEARCH_RESULTS_MAXCOUNT ];
+	static uint64_t expected[ SEARCH_RESULTS_MAXCOUNT ];
+	static struct benchquery queries[ 3 * QUERIES ];
+	static const char *querynames[] = { "common AND common", "common AND rare", "rare OR rare" };
+	const char *path = "../../twits_collection";
+	struct fulltext ft;
+	char (*twits)[ TWIT_MAXLEN ] = NULL;
+	size_t *twitlens = NULL;
+	char *corpus = NULL;
+	const char **words = NULL;
+	size_t *wordlens = NULL;
+	char rare[ 16 ];
+	size_t ntwits = DEFAULT_TWITS;
+	size_t nwords = 0;
+	size_t corpuslen;
+	size_t rarelen;
+	size_t len;
+	size_t at;
+	size_t end;
+	size_t w;
+	size_t n;
+	size_t count;
+	size_t total;
+	size_t i;
+	size_t j;
+	ssize_t found;
+	uint64_t random = 88172645463325252ull;
+	uint64_t begin;
+	uint64_t elapsed;
+	uint64_t addtime;
+	uint64_t scantime;
+	uint64_t best[ 2 ];
+	int type;
+	int round;
+	int kind;
+
+	if ( argc > 1 ){
+		path = argv[ 1 ];
+	}
+	if ( argc > 2 ){
+		ntwits = ( size_t )strtoull( argv[ 2 ], NULL, 10 );
+	}
+	corpus = readcorpus( path, &corpuslen );
+
+	words = malloc( ( corpuslen + 1 ) * sizeof( *words ) );
+	wordlens = malloc( ( corpuslen + 1 ) * sizeof( *wordlens ) );
+	twits = malloc( ( ntwits + 1 ) * sizeof( *twits ) );
+	twitlens = malloc( ( ntwits + 1 ) * sizeof( *twitlens ) );
+	if ( words == NULL || wordlens == NULL || twits == NULL || twitlens == NULL || initfulltext( &ft ) == -1 ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+
+	// The words of the corpus, as the index has them
+	for ( at = 0; at < corpuslen; at = end ){
+		for ( ; at < corpuslen && !isword( ( unsigned char )corpus[ at ] ); ++at ){
+			continue;
+		}
+		for ( end = at; end < corpuslen && isword( ( unsigned char )corpus[ end ] ); ++end ){
+			continue;
+		}
+		if ( end > at && end - at <= SEARCH_WORD_MAXLEN ){
+			words[ nwords ] = corpus + at;
+			wordlens[ nwords++ ] = end - at;
+		}
+	}
+	if ( nwords == 0 ){
+		( void )fprintf( stderr, "%s: no words in the corpus\n", path );
+		exit( EXIT_FAILURE );
+	}
+
+	// Each twit is 8 to 20 words of the corpus from where it is picked, with one of the others among them, cut at TWIT_MAXLEN bytes
+	for ( i = 0; i < MAX_WORDS; ++i ){
+		sums[ i ] = ( i > 0 ? sums[ i - 1 ] : 0.0 ) + 1.0 / ( double )( i + 1 );
+	}
+	for ( i = 0; i < ntwits; ++i ){
+		rarelen = ( size_t )snprintf( rare, sizeof( rare ), "w%u", ( unsigned )pickrank( sums, MAX_WORDS, &random ) );
+		n = 8 + nextrandom( &random ) % 13;
+		at = nextrandom( &random ) % n;
+		w = nextrandom( &random ) % nwords;
+		for ( len = 0, j = 0; j <= n; ++j ){
+			if ( j == at ){
+				if ( len + rarelen + 1 > TWIT_MAXLEN ){
+					break;
+				}
+				( void )memcpy( twits[ i ] + len, rare, rarelen );
+				len += rarelen;
+			}
+			else{
+				if ( len + wordlens[ w ] + 1 > TWIT_MAXLEN ){
+					break;
+				}
+				( void )memcpy( twits[ i ] + len, words[ w ], wordlens[ w ] );
+				len += wordlens[ w ];
+				w = ( w + 1 ) % nwords;
+			}
+			twits[ i ][ len++ ] = ' ';
+		}
+		twitlens[ i ] = len;
+	}
+
+	// The searches: words of the corpus are picked where they are, so as often as they are there
+	for ( i = 0; i < QUERIES; ++i ){
+		w = nextrandom( &random ) % nwords;
+		j = nextrandom( &random ) % nwords;
+		( void )snprintf( queries[ i ].bq_words, sizeof( queries[ i ].bq_words ), "%.*s %.*s", ( int )wordlens[ w ], words[ w ],
+			( int )wordlens[ j ], words[ j ] );
+		queries[ i ].bq_op = FULLTEXT_AND;
+		w = nextrandom( &random ) % nwords;
+		( void )snprintf( queries[ QUERIES + i ].bq_words, sizeof( queries[ i ].bq_words ), "%.*s w%u", ( int )wordlens[ w ], words[ w ],
+			( unsigned )( 100 + pickrank( sums, MAX_WORDS, &random ) ) );
+		queries[ QUERIES + i ].bq_op = FULLTEXT_AND;
+		( void )snprintf( queries[ 2 * QUERIES + i ].bq_words, sizeof( queries[ i ].bq_words ), "w%u w%u",
+			( unsigned )( 100 + pickrank( sums, MAX_WORDS, &random ) ), ( unsigned )( 100 + pickrank( sums, MAX_WORDS, &random ) ) );
+		queries[ 2 * QUERIES + i ].bq_op = FULLTEXT_OR;
+	}
+
+	// The twits added, numbered from one, as the consumer adds them
+	begin = monotonic_ns();
+	for ( i = 0; i < ntwits; ++i ){
+		if ( addtofulltext( &ft, ( uint64_t )i + 1, twits[ i ], twitlens[ i ] ) == -1 ){
+			( void )fprintf( stderr, "addtofulltext() failed (%s)\n", strerror( errno ) );
+			exit( EXIT_FAILURE );
+		}
+	}
+	addtime = monotonic_ns() - begin;
+	( void )printf( "%llu twits of %llu words of the corpus and %d others, %llu of them in the index\n\n",
+		( unsigned long long )ntwits, ( unsigned long long )nwords, MAX_WORDS, ( unsigned long long )ft.ft_twits );
+	( void )printf( "Index: %.1f ns/twit (%.0f twits/sec); %llu words in %llu segments with %llu postings in %llu bytes, %.2f bytes each"
+		" (4 raw)\n", ( double )addtime / ntwits, ntwits * 1e9 / addtime, ( unsigned long long )ft.ft_words,
+		( unsigned long long )ft.ft_count, ( unsigned long long )ft.ft_postings, ( unsigned long long )ft.ft_bytes,
+		ft.ft_postings > 0 ? ( double )ft.ft_bytes / ft.ft_postings : 0.0 );
+	( void )fflush( stdout );
+
+	// The same twits both ways, newest first; the twits no longer in the index are not gone through
+	( void )printf( "\nLast %d twits of %d searches of each kind:\n", SEARCH_RESULTS_MAXCOUNT, QUERIES );
+	( void )printf( "%20s %10s %14s %14s %14s %9s\n", "search", "found", "scan us", "scalar us", "SSE2 us", "speedup" );
+	for ( type = 0; type < 3; ++type ){
+		total = 0;
+		begin = monotonic_ns();
+		for ( i = type * QUERIES; i < ( size_t )( type + 1 ) * QUERIES; ++i ){
+			for ( count = 0, j = ntwits; j > ntwits - ft.ft_twits && count < SEARCH_RESULTS_MAXCOUNT; --j ){
+				if ( haswords( twits[ j - 1 ], twitlens[ j - 1 ], &queries[ i ] ) ){
+					expected[ count++ ] = ( uint64_t )j;
+				}
+			}
+			total += count;
+			if ( ( found = searchfulltext( &ft, queries[ i ].bq_op, queries[ i ].bq_words, seqs, SEARCH_RESULTS_MAXCOUNT ) ) !=
+				( ssize_t )count || memcmp( seqs, expected, count * sizeof( *seqs ) ) != 0 ){
+				( void )fprintf( stderr, "%s: the index found other twits (%lld instead of %llu)\n", queries[ i ].bq_words,
+					( long long )found, ( unsigned long long )count );
+				exit( EXIT_FAILURE );
+			}
+		}
+		scantime = monotonic_ns() - begin;
+		for ( kind = FULLTEXT_SCALAR; kind <= FULLTEXT_SSE2; ++kind ){
+			best[ kind ] = UINT64_MAX;
+			if ( setfulltextkind( ( enum fulltextkind )kind ) == -1 ){
+				continue;
+			}
+			for ( round = 0; round < ROUNDS; ++round ){
+				begin = monotonic_ns();
+				for ( i = type * QUERIES; i < ( size_t )( type + 1 ) * QUERIES; ++i ){
+					( void )searchfulltext( &ft, queries[ i ].bq_op, queries[ i ].bq_words, seqs, SEARCH_RESULTS_MAXCOUNT );
+				}
+				if ( ( elapsed = monotonic_ns() - begin ) < best[ kind ] ){
+					best[ kind ] = elapsed;
+				}
+			}
+		}
+		( void )printf( "%20s %10.1f %14.2f %14.2f %14.2f %8.1fx\n", querynames[ type ], ( double )total / QUERIES,
+			( double )scantime / QUERIES / 1000.0, ( double )best[ FULLTEXT_SCALAR ] / QUERIES / 1000.0,
+			best[ FULLTEXT_SSE2 ] == UINT64_MAX ? 0.0 : ( double )best[ FULLTEXT_SSE2 ] / QUERIES / 1000.0,
+			( double )scantime / ( best[ FULLTEXT_SSE2 ] == UINT64_MAX ? best[ FULLTEXT_SCALAR ] : best[ FULLTEXT_SSE2 ] ) );
+		( void )fflush( stdout );
+	}
+
+	delfulltext( &ft );
+	free( words );
+	free( wordlens );
+	free( twits );
+	free( twitlens );
+	free( corpus );
+
+	exit( EXIT_SUCCESS );
+}
+
+static int isword( unsigned char c ){
+	return ( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) || c >= 0x80 );
+}
+
+// A word of the search is matched by one of the twit of the same length, the case of the ASCII letters aside
+static int haswords( const char * restrict twit, size_t len, const struct benchquery * restrict bq ){
+	const char *word[ 2 ];
+	size_t wordlen[ 2 ];
+	int has[ 2 ] = { 0, 0 };
+	size_t at;
+	size_t end;
+	size_t k;
+	int i;
+
+	word[ 0 ] = bq->bq_words;
+	wordlen[ 0 ] = strcspn( bq->bq_words, " " );
+	word[ 1 ] = word[ 0 ] + wordlen[ 0 ] + 1;
+	wordlen[ 1 ] = strlen( word[ 1 ] );
+	for ( at = 0; at < len; at = end ){
+		for ( ; at < len && !isword( ( unsigned char )twit[ at ] ); ++at ){
+			continue;
+		}
+		for ( end = at; end < len && isword( ( unsigned char )twit[ end ] ); ++end ){
+			continue;
+		}
+		for ( i = 0; i < 2; ++i ){
+			if ( end - at == wordlen[ i ] ){
+				for ( k = 0; k < wordlen[ i ] && ( twit[ at + k ] | ( ( twit[ at + k ] >= 'A' && twit[ at + k ] <= 'Z' ) ? 0x20 : 0 ) ) ==
+					( word[ i ][ k ] | ( ( word[ i ][ k ] >= 'A' && word[ i ][ k ] <= 'Z' ) ? 0x20 : 0 ) ); ++k ){
+					continue;
+				}
+				has[ i ] |= ( k == wordlen[ i ] );
+			}
+		}
+	}
+
+	return ( bq->bq_op == FULLTEXT_AND ? has[ 0 ] && has[ 1 ] : has[ 0 ] || has[ 1 ] );
+}
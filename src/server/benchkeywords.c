@@ -0,0 +1,334 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchkeywords.c
+ *
+ * File benchkeywords.c measures the automaton of keywords.h as the keywords grow to 100000: the time to subscribe them, to scan a
+ * twit, which is what the consumer pays, and to have a hearer leave and come back, with the links changed for it. The same twits are
+ * also matched the way a hearer does it on its own, keyword after keyword, which costs in proportion to the keywords.
+ *
+ * The twits are cut from the lines of a corpus (the twits_collection at the top of the repository by default), at most TWIT_MAXLEN
+ * bytes each. One keyword in ten is a word of the corpus, so the twits match some; the rest are made of 5 to 10 random letters.
+ * Each hearer subscribes to HEARER_KEYWORDS_MAXCOUNT of them. What the automaton matches is checked against the plain matching
+ * before anything is printed.
+ *
+ * Usage: benchkeywords [corpus [keywords]]
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "keywords.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "config.h"
+
+#define DEFAULT_KEYWORDS (100000)
+
+// The twits are scanned this many times at each step; the best time counts
+#define ROUNDS (5)
+
+// Hearers that leave and come back at each step
+#define CHURNS (1000)
+
+/**
+ * The plainmatch() function shall check whether the len bytes pointed to by parameter text contain the keyword of wordlen bytes
+ * pointed to by parameter word, the case of the letters aside, as a hearer that matches on its own would.
+ *
+ * @return Nonzero if they do, zero otherwise.
+ */
+static int plainmatch( const char * restrict text, size_t len, const char * restrict word, size_t wordlen );
+
+int main( int argc, char *argv[] ){
+	const char *path = "../../twits_collection";
+	struct keywords kw;
+	struct keywordsubscriber *subscribers = NULL;
+	struct twitpoollist_node *tplns = NULL;
+	struct bitmap matched;
+	uint32_t *numbers = NULL;
+	char **twits = NULL;
+	size_t *twitlens = NULL;
+	char **words = NULL; // The words of each hearer, as subscribekeywords() takes them
+	char *corpus = NULL;
+	char **corpuswords = NULL;
+	unsigned char *expected = NULL;
+	size_t ncorpuswords = 0;
+	size_t ntwits = 0;
+	size_t nhearers;
+	size_t nkeywords = DEFAULT_KEYWORDS;
+	size_t corpuslen;
+	size_t subscribed = 0;
+	size_t step;
+	size_t at;
+	size_t end;
+	size_t len;
+	size_t count;
+	size_t total;
+	size_t i;
+	size_t j;
+	size_t h;
+	const char *pick = NULL;
+	char *word = NULL;
+	char *p = NULL;
+	uint64_t random = 88172645463325252ull;
+	uint64_t begin;
+	uint64_t elapsed;
+	uint64_t best;
+	uint64_t subscribetime;
+	uint64_t relinked;
+	uint64_t churntime;
+	uint64_t plaintime;
+	int round;
+	int k;
+
+	if ( argc > 1 ){
+		path = argv[ 1 ];
+	}
+	if ( argc > 2 ){
+		nkeywords = ( size_t )strtoull( argv[ 2 ], NULL, 10 );
+	}
+	corpus = readcorpus( path, &corpuslen );
+	nhearers = ( nkeywords + HEARER_KEYWORDS_MAXCOUNT - 1 ) / HEARER_KEYWORDS_MAXCOUNT;
+
+	twits = malloc( ( corpuslen + 1 ) * sizeof( *twits ) );
+	twitlens = malloc( ( corpuslen + 1 ) * sizeof( *twitlens ) );
+	corpuswords = malloc( ( corpuslen + 1 ) * sizeof( *corpuswords ) );
+	subscribers = calloc( nhearers, sizeof( *subscribers ) );
+	tplns = calloc( nhearers, sizeof( *tplns ) );
+	numbers = malloc( nhearers * sizeof( *numbers ) );
+	words = malloc( nhearers * sizeof( *words ) );
+	expected = malloc( nhearers );
+	if ( twits == NULL || twitlens == NULL || corpuswords == NULL || subscribers == NULL || tplns == NULL || numbers == NULL ||
+		words == NULL || expected == NULL || initkeywords( &kw ) == -1 ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+	initbitmap( &matched );
+	for ( h = 0; h < nhearers; ++h ){
+		tplns[ h ].tpln_hearer = ( uint32_t )h;
+	}
+
+	// A twit is what is left of the line, up to TWIT_MAXLEN bytes
+	for ( at = 0; at < corpuslen; at = end < corpuslen && corpus[ end ] == '\n' ? end + 1 : end ){
+		for ( end = at; end < corpuslen && corpus[ end ] != '\n' && end - at < TWIT_MAXLEN; ++end ){
+			continue;
+		}
+		if ( end > at ){
+			twits[ ntwits ] = corpus + at;
+			twitlens[ ntwits++ ] = end - at;
+		}
+	}
+	// The words of the corpus, cut at the bytes that cannot be in a keyword; in a copy, the twits keep theirs
+	if ( ( p = malloc( corpuslen + 1 ) ) == NULL ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+	( void )memcpy( p, corpus, corpuslen + 1 );
+	for ( i = 0; i < corpuslen; ){
+		for ( ; i < corpuslen && ( p[ i ] <= ' ' || p[ i ] > '~' ); ++i ){
+			p[ i ] = '\0';
+		}
+		for ( j = i; j < corpuslen && p[ j ] > ' ' && p[ j ] <= '~'; ++j ){
+			continue;
+		}
+		if ( j - i >= 4 && j - i <= KEYWORD_MAXLEN ){
+			corpuswords[ ncorpuswords++ ] = p + i;
+		}
+		if ( j < corpuslen ){
+			p[ j++ ] = '\0';
+		}
+		i = j;
+	}
+	if ( ntwits == 0 || ncorpuswords == 0 ){
+		( void )fprintf( stderr, "%s: no twits in the corpus\n", path );
+		exit( EXIT_FAILURE );
+	}
+
+	// The keywords of each hearer, separated by single spaces
+	for ( h = 0; h < nhearers; ++h ){
+		if ( ( words[ h ] = word = malloc( HEARER_KEYWORDS_MAXCOUNT * ( KEYWORD_MAXLEN + 1 ) ) ) == NULL ){
+			perror( "malloc" );
+			exit( EXIT_FAILURE );
+		}
+		for ( k = 0; k < HEARER_KEYWORDS_MAXCOUNT && h * HEARER_KEYWORDS_MAXCOUNT + k < nkeywords; ++k ){
+			if ( k > 0 ){
+				*word++ = ' ';
+			}
+			if ( nextrandom( &random ) % 10 == 0 ){
+				pick = corpuswords[ nextrandom( &random ) % ncorpuswords ];
+				( void )memcpy( word, pick, len = strlen( pick ) );
+			}
+			else{
+				for ( len = 5 + nextrandom( &random ) % 6, i = 0; i < len; ++i ){
+					word[ i ] = ( char )( 'a' + nextrandom( &random ) % 26 );
+				}
+			}
+			word += len;
+		}
+		*word = '\0';
+	}
+
+	( void )printf( "%llu twits from %s (%llu bytes), %d keywords for each hearer\n\n", ( unsigned long long )ntwits, path,
+		( unsigned long long )corpuslen, HEARER_KEYWORDS_MAXCOUNT );
+	( void )printf( "%9s %9s %8s %12s %12s %8s %10s %12s %14s\n", "keywords", "states", "hearers", "subscribe ms", "scan ns/twit",
+		"ns/byte", "churn us", "links/churn", "plain ns/twit" );
+
+	for ( step = nkeywords < 1000 ? nkeywords : 1000; ; step = step * 10 < nkeywords ? step * 10 : nkeywords ){
+		// Subscribe the hearers up to this step
+		begin = monotonic_ns();
+		for ( ; subscribed < ( step + HEARER_KEYWORDS_MAXCOUNT - 1 ) / HEARER_KEYWORDS_MAXCOUNT; ++subscribed ){
+			if ( subscribekeywords( &kw, &subscribers[ subscribed ], &tplns[ subscribed ], words[ subscribed ] ) == -1 ){
+				( void )fprintf( stderr, "subscribekeywords() failed (%s)\n", strerror( errno ) );
+				exit( EXIT_FAILURE );
+			}
+		}
+		subscribetime = monotonic_ns() - begin;
+
+		// Check every twit against the plain matching, which is timed too
+		plaintime = 0;
+		for ( i = 0; i < ntwits; ++i ){
+			begin = monotonic_ns();
+			for ( h = 0; h < subscribed; ++h ){
+				expected[ h ] = 0;
+				for ( word = words[ h ]; *word != '\0' && !expected[ h ]; word += len + ( word[ len ] == ' ' ) ){
+					len = strcspn( word, " " );
+					expected[ h ] = ( unsigned char )plainmatch( twits[ i ], twitlens[ i ], word, len );
+				}
+			}
+			plaintime += monotonic_ns() - begin;
+			clearbitmap( &matched );
+			if ( matchkeywords( &kw, twits[ i ], twitlens[ i ], &matched ) == -1 ){
+				( void )fprintf( stderr, "matchkeywords() failed (%s)\n", strerror( errno ) );
+				exit( EXIT_FAILURE );
+			}
+			count = bitmaptoarray( &matched, 0, numbers, nhearers );
+			for ( j = 0; j < count; ++j ){
+				h = numbers[ j ];
+				if ( h >= subscribed || expected[ h ] != 1 ){
+					( void )fprintf( stderr, "twit %llu: hearer %llu matched by the automaton only\n", ( unsigned long long )i, ( unsigned long long )h );
+					exit( EXIT_FAILURE );
+				}
+				expected[ h ] = 2;
+			}
+			for ( h = 0; h < subscribed; ++h ){
+				if ( expected[ h ] == 1 ){
+					( void )fprintf( stderr, "twit %llu: hearer %llu not matched by the automaton\n", ( unsigned long long )i, ( unsigned long long )h );
+					exit( EXIT_FAILURE );
+				}
+			}
+		}
+
+		// Scan all the twits a few times
+		best = UINT64_MAX;
+		total = 0;
+		for ( round = 0; round < ROUNDS; ++round ){
+			total = 0;
+			begin = monotonic_ns();
+			for ( i = 0; i < ntwits; ++i ){
+				clearbitmap( &matched );
+				( void )matchkeywords( &kw, twits[ i ], twitlens[ i ], &matched );
+				total += bitmapcount( &matched );
+			}
+			if ( ( elapsed = monotonic_ns() - begin ) < best ){
+				best = elapsed;
+			}
+		}
+		for ( len = 0, i = 0; i < ntwits; ++i ){
+			len += twitlens[ i ];
+		}
+
+		// A hearer leaves and comes back, and the next twit is scanned
+		relinked = kw.kw_relinked;
+		begin = monotonic_ns();
+		for ( i = 0; i < CHURNS; ++i ){
+			h = ( size_t )( nextrandom( &random ) % subscribed );
+			unsubscribekeywords( &kw, &subscribers[ h ] );
+			if ( subscribekeywords( &kw, &subscribers[ h ], &tplns[ h ], words[ h ] ) == -1 ){
+				( void )fprintf( stderr, "subscribekeywords() failed (%s)\n", strerror( errno ) );
+				exit( EXIT_FAILURE );
+			}
+			clearbitmap( &matched );
+			( void )matchkeywords( &kw, twits[ i % ntwits ], twitlens[ i % ntwits ], &matched );
+		}
+		churntime = monotonic_ns() - begin;
+
+		( void )printf( "%9llu %9llu %8llu %12.2f %12.1f %8.2f %10.2f %12.1f %14.1f\n", ( unsigned long long )kw.kw_count,
+			( unsigned long long )kw.kw_statecount, ( unsigned long long )subscribed, subscribetime / 1e6, ( double )best / ntwits,
+			( double )best / len, churntime / 1e3 / CHURNS, ( double )( kw.kw_relinked - relinked ) / CHURNS, ( double )plaintime / ntwits );
+		( void )printf( "%9s %.2f hearers matched per twit\n", "", ( double )total / ntwits );
+		( void )fflush( stdout );
+
+		if ( step == nkeywords ){
+			break;
+		}
+	}
+
+	delkeywords( &kw );
+	delbitmap( &matched );
+	for ( h = 0; h < nhearers; ++h ){
+		free( words[ h ] );
+	}
+	free( p );
+	free( expected );
+	free( words );
+	free( numbers );
+	free( tplns );
+	free( subscribers );
+	free( corpuswords );
+	free( twitlens );
+	free( twits );
+	free( corpus );
+
+	exit( EXIT_SUCCESS );
+}
+
+// What a hearer would write for itself; no more than a strstr() that ignores the case
+static int plainmatch( const char * restrict text, size_t len, const char * restrict word, size_t wordlen ){
+	size_t i;
+	size_t j;
+	char a;
+	char b;
+
+	for ( i = 0; i + wordlen <= len; ++i ){
+		for ( j = 0; j < wordlen; ++j ){
+			a = text[ i + j ] >= 'A' && text[ i + j ] <= 'Z' ? ( char )( text[ i + j ] - 'A' + 'a' ) : text[ i + j ];
+			b = word[ j ] >= 'A' && word[ j ] <= 'Z' ? ( char )( word[ j ] - 'A' + 'a' ) : word[ j ];
+			if ( a != b ){
+				break;
+			}
+		}
+		if ( j == wordlen ){
+			return ( 1 );
+		}
+	}
+
+	return ( 0 );
+}
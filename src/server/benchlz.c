@@ -0,0 +1,223 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchlz.c
+ *
+ * File benchlz.c measures the codec of lz.h on twits: the ratio it gets and how many bytes a second it compresses and
+ * decompresses, in blocks of TWITLOG_BLOCK_SIZE bytes as the cold segments of the twit log are compressed.
+ *
+ * The twits are cut from the lines of a corpus (the twits_collection at the top of the repository by default), at most
+ * TWIT_MAXLEN bytes each, and go round it until there are as many bytes as asked for. They are measured twice: as twit log
+ * records, which is what the segments hold, and as the bare text. Every block is decompressed and compared with what was
+ * compressed before anything is printed.
+ *
+ * Usage: benchlz [corpus [megabytes]]
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lz.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "twitlog.h"
+#include "config.h"
+
+#define DEFAULT_MEGABYTES (64)
+
+// Each block is compressed and decompressed this many times; the best time counts
+#define ROUNDS (5)
+
+/**
+ * The bench() function shall compress the len bytes pointed to by parameter buf in blocks of up to TWITLOG_BLOCK_SIZE bytes,
+ * cut at the offsets given by parameter cuts (ncuts of them, increasing, the last being len), decompress them, check that
+ * they are back as they were and print one line named after parameter name.
+ *
+ * @return Nothing.
+ */
+static void bench( const char * restrict name, const unsigned char * restrict buf, size_t len, const size_t * restrict cuts, size_t ncuts );
+
+int main( int argc, char *argv[] ){
+	const char *path = "../../twits_collection";
+	unsigned char *records = NULL;
+	unsigned char *text = NULL;
+	size_t *recordcuts = NULL;
+	size_t *textcuts = NULL;
+	size_t nrecordcuts = 0;
+	size_t ntextcuts = 0;
+	size_t recordlen = 0;
+	size_t textlen = 0;
+	size_t blockstart = 0;
+	size_t textblockstart = 0;
+	size_t target;
+	size_t corpuslen;
+	size_t maxcuts;
+	size_t at = 0;
+	size_t end;
+	size_t len;
+	struct twitlogrecord r;
+	char *corpus = NULL;
+	uint64_t seq = 1;
+	uint64_t time;
+
+	if ( argc > 1 ){
+		path = argv[ 1 ];
+	}
+	target = ( size_t )DEFAULT_MEGABYTES * 1024 * 1024;
+	if ( argc > 2 ){
+		target = ( size_t )strtoull( argv[ 2 ], NULL, 10 ) * 1024 * 1024;
+	}
+	corpus = readcorpus( path, &corpuslen );
+
+	maxcuts = target / TWITLOG_BLOCK_SIZE * 2 + 2;
+	records = malloc( target + TWITLOG_RECORD_MAXSIZE );
+	text = malloc( target + TWIT_MAXLEN );
+	recordcuts = malloc( maxcuts * sizeof( *recordcuts ) );
+	textcuts = malloc( maxcuts * sizeof( *textcuts ) );
+	if ( records == NULL || text == NULL || recordcuts == NULL || textcuts == NULL ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+
+	// A twit is what is left of the line, up to TWIT_MAXLEN bytes; the times go up by a few milliseconds as live twits do
+	time = realtime_ns();
+	while ( recordlen < target ){
+		if ( at >= corpuslen ){
+			at = 0;
+		}
+		for ( end = at; end < corpuslen && corpus[ end ] != '\n' && end - at < TWIT_MAXLEN; ++end ){
+			continue;
+		}
+		len = end - at;
+		if ( len > 0 ){
+			r.tlr_len = ( uint16_t )len;
+			r.tlr_flags = 0;
+			r.tlr_seq = seq++;
+			r.tlr_time = ( time += 1000000u + ( seq * 7919 ) % 5000000u );
+			if ( recordlen + TWITLOG_RECORD_HEADER_SIZE + len - blockstart > TWITLOG_BLOCK_SIZE ){
+				recordcuts[ nrecordcuts++ ] = blockstart = recordlen;
+			}
+			recordlen += encodetwitlogrecord( records + recordlen, &r, corpus + at );
+			if ( textlen + len - textblockstart > TWITLOG_BLOCK_SIZE ){
+				textcuts[ ntextcuts++ ] = textblockstart = textlen;
+			}
+			( void )memcpy( text + textlen, corpus + at, len );
+			textlen += len;
+		}
+		at = end < corpuslen && corpus[ end ] == '\n' ? end + 1 : end;
+	}
+	recordcuts[ nrecordcuts++ ] = recordlen;
+	textcuts[ ntextcuts++ ] = textlen;
+
+	( void )printf( "%llu twits from %s (%llu bytes), blocks of %u bytes\n\n", ( unsigned long long )( seq - 1 ), path,
+		( unsigned long long )corpuslen, ( unsigned )TWITLOG_BLOCK_SIZE );
+	( void )printf( "%-10s %12s %12s %8s %14s %14s\n", "input", "bytes", "compressed", "ratio", "compress MB/s", "decompress GB/s" );
+	bench( "records", records, recordlen, recordcuts, nrecordcuts );
+	bench( "text", text, textlen, textcuts, ntextcuts );
+
+	free( textcuts );
+	free( recordcuts );
+	free( text );
+	free( records );
+	free( corpus );
+
+	exit( EXIT_SUCCESS );
+}
+
+// The times are of whole passes over the blocks, so the caches hold what a segment of that size leaves in them
+static void bench( const char * restrict name, const unsigned char * restrict buf, size_t len, const size_t * restrict cuts, size_t ncuts ){
+	unsigned char *compressed = NULL;
+	unsigned char *decompressed = NULL;
+	size_t *clens = NULL;
+	size_t *coffsets = NULL;
+	size_t capacity = 0;
+	size_t total = 0;
+	size_t start;
+	size_t i;
+	uint64_t begin;
+	uint64_t elapsed;
+	uint64_t best_compress = UINT64_MAX;
+	uint64_t best_decompress = UINT64_MAX;
+	int round;
+
+	for ( i = 0, start = 0; i < ncuts; start = cuts[ i++ ] ){
+		capacity += lzbound( cuts[ i ] - start );
+	}
+	compressed = malloc( capacity );
+	decompressed = malloc( len + TWITLOG_BLOCK_SIZE );
+	clens = malloc( ncuts * sizeof( *clens ) );
+	coffsets = malloc( ncuts * sizeof( *coffsets ) );
+	if ( compressed == NULL || decompressed == NULL || clens == NULL || coffsets == NULL ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+
+	for ( round = 0; round < ROUNDS; ++round ){
+		total = 0;
+		begin = monotonic_ns();
+		for ( i = 0, start = 0; i < ncuts; start = cuts[ i++ ] ){
+			coffsets[ i ] = total;
+			clens[ i ] = lzcompress( compressed + total, lzbound( cuts[ i ] - start ), buf + start, cuts[ i ] - start );
+			assert( clens[ i ] > 0 );
+			total += clens[ i ];
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < best_compress ){
+			best_compress = elapsed;
+		}
+	}
+	for ( round = 0; round < ROUNDS; ++round ){
+		begin = monotonic_ns();
+		for ( i = 0, start = 0; i < ncuts; start = cuts[ i++ ] ){
+			if ( lzdecompress( decompressed + start, TWITLOG_BLOCK_SIZE, compressed + coffsets[ i ], clens[ i ] ) != ( ssize_t )( cuts[ i ] - start ) ){
+				( void )fprintf( stderr, "%s: block %llu does not decompress\n", name, ( unsigned long long )i );
+				exit( EXIT_FAILURE );
+			}
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < best_decompress ){
+			best_decompress = elapsed;
+		}
+	}
+	if ( memcmp( decompressed, buf, len ) != 0 ){
+		( void )fprintf( stderr, "%s: the blocks decompressed differ from what was compressed\n", name );
+		exit( EXIT_FAILURE );
+	}
+
+	( void )printf( "%-10s %12llu %12llu %8.2f %14.1f %14.2f\n", name, ( unsigned long long )len, ( unsigned long long )total,
+		( double )len / total, len / ( best_compress / 1e9 ) / ( 1024.0 * 1024.0 ), len / ( best_decompress / 1e9 ) / 1e9 );
+	( void )fflush( stdout );
+
+	free( coffsets );
+	free( clens );
+	free( decompressed );
+	free( compressed );
+
+	return ;
+}
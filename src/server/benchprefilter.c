@@ -0,0 +1,296 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchprefilter.c
+ *
+ * File benchprefilter.c measures the prefilter of prefilter.h as the keywords grow from 1 to 1024: the twits it lets through to
+ * the automaton of keywords.h, the time it takes with each code the processor can run, and the time of the automaton behind it and
+ * on its own. Each code is checked to find the candidates the scalar one does, and what the automaton matches behind the prefilter
+ * against what it matches on its own.
+ *
+ * The twits are cut from the lines of a corpus (the twits_collection at the top of the repository by default), at most TWIT_MAXLEN
+ * bytes each. One keyword in ten is a word of the corpus, so the twits match some; the rest are made of 5 to 10 random letters.
+ *
+ * Built by the compile script (no optimization) on a one-core Xeon with AVX2, the AVX2 code takes about 220 to 270 ns a twit for 1 to
+ * 16 keywords, against 440 to 660 ns for the scalar one, and the automaton behind it about 250 to 400 ns against 730 to 1200 ns on
+ * its own. From 256 keywords every twit passes and the AVX2 code adds about 150 to 160 ns a twit for nothing, which is why the
+ * prefilter stops above KEYWORDS_PREFILTER_MAXCOUNT. With -O2 the figures drop to between a quarter and an eighth of these.
+ *
+ * Usage: benchprefilter [corpus]
+ *
+ * @author Tassos Souris
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "keywords.h"
+#include "prefilter.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "config.h"
+
+// The keywords measured go from one to MAX_KEYWORDS, four times as many at each step; a keyword picked twice counts once, so there
+// are hearers to spare
+#define MAX_KEYWORDS (1024)
+#define MAX_HEARERS ( 2 * MAX_KEYWORDS / HEARER_KEYWORDS_MAXCOUNT )
+
+// The twits are scanned this many times for each measure; the best time counts
+#define ROUNDS (50)
+
+/**
+ * The timematch() function shall scan the twits pointed to by parameter twits, of the lengths pointed to by parameter twitlens,
+ * with the automaton pointed to by parameter kw ROUNDS times.
+ *
+ * @return The best time of a round, in nanoseconds.
+ */
+static uint64_t timematch( struct keywords * restrict kw, char **twits, const size_t * restrict twitlens, size_t ntwits,
+	struct bitmap * restrict matched );
+
+int main( int argc, char *argv[] ){
+	static const char *kindnames[] = { "scalar", "SSE4.2", "AVX2" };
+	const char *path = "../../twits_collection";
+	struct keywords kw;
+	struct keywordsubscriber subscribers[ MAX_HEARERS ];
+	struct twitpoollist_node tplns[ MAX_HEARERS ];
+	struct bitmap matched;
+	struct bitmap unfiltered;
+	uint32_t numbers[ MAX_HEARERS ];
+	uint32_t unfilterednumbers[ MAX_HEARERS ];
+	char words[ HEARER_KEYWORDS_MAXCOUNT * ( KEYWORD_MAXLEN + 1 ) ];
+	char **twits = NULL;
+	size_t *twitlens = NULL;
+	size_t *firsts = NULL; // The first candidate in each twit
+	char *corpus = NULL;
+	char **corpuswords = NULL;
+	size_t ncorpuswords = 0;
+	size_t ntwits = 0;
+	size_t nkeywords;
+	size_t corpuslen;
+	size_t subscribed;
+	size_t passed;
+	size_t bytes;
+	size_t at;
+	size_t end;
+	size_t len;
+	size_t count;
+	size_t i;
+	size_t j;
+	const char *pick = NULL;
+	char *word = NULL;
+	char *p = NULL;
+	uint64_t random = 88172645463325252ull;
+	uint64_t begin;
+	uint64_t elapsed;
+	uint64_t best;
+	uint64_t sink = 0;
+	enum prefilterkind bestkind;
+	int round;
+	int kind;
+	int k;
+
+	if ( argc > 1 ){
+		path = argv[ 1 ];
+	}
+	corpus = readcorpus( path, &corpuslen );
+	twits = malloc( ( corpuslen + 1 ) * sizeof( *twits ) );
+	twitlens = malloc( ( corpuslen + 1 ) * sizeof( *twitlens ) );
+	firsts = malloc( ( corpuslen + 1 ) * sizeof( *firsts ) );
+	corpuswords = malloc( ( corpuslen + 1 ) * sizeof( *corpuswords ) );
+	p = malloc( corpuslen + 1 );
+	if ( twits == NULL || twitlens == NULL || firsts == NULL || corpuswords == NULL || p == NULL || initkeywords( &kw ) == -1 ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+	initbitmap( &matched );
+	initbitmap( &unfiltered );
+	for ( i = 0; i < MAX_HEARERS; ++i ){
+		tplns[ i ].tpln_hearer = ( uint32_t )i;
+	}
+
+	// A twit is what is left of the line, up to TWIT_MAXLEN bytes
+	for ( at = 0; at < corpuslen; at = end < corpuslen && corpus[ end ] == '\n' ? end + 1 : end ){
+		for ( end = at; end < corpuslen && corpus[ end ] != '\n' && end - at < TWIT_MAXLEN; ++end ){
+			continue;
+		}
+		if ( end > at ){
+			twits[ ntwits ] = corpus + at;
+			twitlens[ ntwits++ ] = end - at;
+		}
+	}
+	for ( bytes = 0, i = 0; i < ntwits; ++i ){
+		bytes += twitlens[ i ];
+	}
+	// The words of the corpus, cut at the bytes that cannot be in a keyword; in a copy, the twits keep theirs
+	( void )memcpy( p, corpus, corpuslen + 1 );
+	for ( i = 0; i < corpuslen; ){
+		for ( ; i < corpuslen && ( p[ i ] <= ' ' || p[ i ] > '~' ); ++i ){
+			p[ i ] = '\0';
+		}
+		for ( j = i; j < corpuslen && p[ j ] > ' ' && p[ j ] <= '~'; ++j ){
+			continue;
+		}
+		if ( j - i >= 4 && j - i <= KEYWORD_MAXLEN ){
+			corpuswords[ ncorpuswords++ ] = p + i;
+		}
+		if ( j < corpuslen ){
+			p[ j++ ] = '\0';
+		}
+		i = j;
+	}
+	if ( ntwits == 0 || ncorpuswords == 0 ){
+		( void )fprintf( stderr, "%s: no twits in the corpus\n", path );
+		exit( EXIT_FAILURE );
+	}
+
+	bestkind = kw.kw_prefilter.pf_kind;
+	( void )printf( "%llu twits from %s (%llu bytes), prefilter running %s\n\n", ( unsigned long long )ntwits, path,
+		( unsigned long long )corpuslen, kindnames[ bestkind ] );
+	( void )printf( "%9s %8s %13s %13s %13s %14s %14s\n", "keywords", "passed", "scalar ns/tw", "SSE4.2 ns/tw", "AVX2 ns/tw",
+		"filtered ns/tw", "automaton ns/tw" );
+
+	// The keywords are subscribed by hearers of up to HEARER_KEYWORDS_MAXCOUNT each; one with fewer is subscribed again with more
+	subscribed = 0;
+	for ( nkeywords = 1; nkeywords <= MAX_KEYWORDS; nkeywords *= 4 ){
+		while ( kw.kw_count < nkeywords && subscribed < MAX_HEARERS ){
+			if ( subscribed > 0 && subscribers[ subscribed - 1 ].ksr_count < HEARER_KEYWORDS_MAXCOUNT ){
+				unsubscribekeywords( &kw, &subscribers[ --subscribed ] );
+			}
+			for ( word = words, k = 0; k < HEARER_KEYWORDS_MAXCOUNT && kw.kw_count + ( size_t )k < nkeywords; ++k ){
+				if ( k > 0 ){
+					*word++ = ' ';
+				}
+				if ( nextrandom( &random ) % 10 == 0 ){
+					pick = corpuswords[ nextrandom( &random ) % ncorpuswords ];
+					( void )memcpy( word, pick, len = strlen( pick ) );
+				}
+				else{
+					for ( len = 5 + nextrandom( &random ) % 6, i = 0; i < len; ++i ){
+						word[ i ] = ( char )( 'a' + nextrandom( &random ) % 26 );
+					}
+				}
+				word += len;
+			}
+			*word = '\0';
+			if ( subscribekeywords( &kw, &subscribers[ subscribed ], &tplns[ subscribed ], words ) == -1 ){
+				perror( "subscribekeywords" );
+				exit( EXIT_FAILURE );
+			}
+			++subscribed;
+		}
+
+		// The automaton behind the prefilter matches what it does on its own
+		for ( passed = 0, i = 0; i < ntwits; ++i ){
+			passed += prefilter( &kw.kw_prefilter, ( const unsigned char * )twits[ i ], twitlens[ i ] ) < twitlens[ i ];
+			kw.kw_prefiltermax = MAX_KEYWORDS;
+			clearbitmap( &matched );
+			( void )matchkeywords( &kw, twits[ i ], twitlens[ i ], &matched );
+			count = bitmaptoarray( &matched, 0, numbers, MAX_HEARERS );
+			kw.kw_prefiltermax = 0;
+			clearbitmap( &unfiltered );
+			( void )matchkeywords( &kw, twits[ i ], twitlens[ i ], &unfiltered );
+			if ( bitmaptoarray( &unfiltered, 0, unfilterednumbers, MAX_HEARERS ) != count ||
+				memcmp( numbers, unfilterednumbers, count * sizeof( *numbers ) ) != 0 ){
+				( void )fprintf( stderr, "twit %llu: the prefilter changed what matched\n", ( unsigned long long )i );
+				exit( EXIT_FAILURE );
+			}
+		}
+		( void )printf( "%9llu %7.1f%%", ( unsigned long long )kw.kw_count, 100.0 * passed / ntwits );
+
+		for ( kind = PREFILTER_SCALAR; kind <= PREFILTER_AVX2; ++kind ){
+			if ( setprefilterkind( &kw.kw_prefilter, ( enum prefilterkind )kind ) == -1 ){
+				( void )printf( " %13s", "-" );
+				continue;
+			}
+			// Each code finds the candidates the scalar one does
+			for ( i = 0; i < ntwits; ++i ){
+				at = prefilter( &kw.kw_prefilter, ( const unsigned char * )twits[ i ], twitlens[ i ] );
+				if ( kind == PREFILTER_SCALAR ){
+					firsts[ i ] = at;
+				}
+				else if ( at != firsts[ i ] ){
+					( void )fprintf( stderr, "twit %llu: %s found %llu, not %llu\n", ( unsigned long long )i, kindnames[ kind ],
+						( unsigned long long )at, ( unsigned long long )firsts[ i ] );
+					exit( EXIT_FAILURE );
+				}
+			}
+			best = UINT64_MAX;
+			for ( round = 0; round < ROUNDS; ++round ){
+				begin = monotonic_ns();
+				for ( i = 0; i < ntwits; ++i ){
+					sink += prefilter( &kw.kw_prefilter, ( const unsigned char * )twits[ i ], twitlens[ i ] );
+				}
+				if ( ( elapsed = monotonic_ns() - begin ) < best ){
+					best = elapsed;
+				}
+			}
+			( void )printf( " %13.1f", ( double )best / ntwits );
+		}
+		( void )setprefilterkind( &kw.kw_prefilter, bestkind );
+
+		// The automaton behind the prefilter and on its own
+		kw.kw_prefiltermax = MAX_KEYWORDS;
+		( void )printf( " %14.1f", ( double )timematch( &kw, twits, twitlens, ntwits, &matched ) / ntwits );
+		kw.kw_prefiltermax = 0;
+		( void )printf( " %14.1f\n", ( double )timematch( &kw, twits, twitlens, ntwits, &matched ) / ntwits );
+		( void )fflush( stdout );
+	}
+	( void )printf( "\n%llu bytes in the twits (%llu)\n", ( unsigned long long )bytes, ( unsigned long long )( sink & 1 ) );
+
+	delkeywords( &kw );
+	delbitmap( &matched );
+	delbitmap( &unfiltered );
+	free( p );
+	free( corpuswords );
+	free( firsts );
+	free( twitlens );
+	free( twits );
+	free( corpus );
+
+	exit( EXIT_SUCCESS );
+}
+static uint64_t timematch( struct keywords * restrict kw, char **twits, const size_t * restrict twitlens, size_t ntwits,
+	struct bitmap * restrict matched ){
+	uint64_t begin;
+	uint64_t elapsed;
+	uint64_t best = UINT64_MAX;
+	size_t i;
+	int round;
+
+	for ( round = 0; round < ROUNDS; ++round ){
+		begin = monotonic_ns();
+		for ( i = 0; i < ntwits; ++i ){
+			clearbitmap( matched );
+			( void )matchkeywords( kw, twits[ i ], twitlens[ i ], matched );
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < best ){
+			best = elapsed;
+		}
+	}
+
+	return ( best );
+}
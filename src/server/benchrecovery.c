@@ -0,0 +1,286 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchrecovery.c
+ *
+ * File benchrecovery.c measures how long opentwitlog() takes to recover a large twit log after a crash.
+ *
+ * Segments of TWITLOG_SEGMENT_SIZE bytes are written, up to the number of megabytes given as second argument (1024 by default),
+ * in the directory given as first argument (benchrecovery.d by default), and the newest one gets half a record at its end, as a
+ * crash in the middle of a write leaves it. The log is then opened, which checks every record and must cut the half record off.
+ * The segments were just written so they are in the page cache; run with a cold cache (echo 3 > /proc/sys/vm/drop_caches as root
+ * between writing and opening, see -k) to include reading the disk. The speed of crc32c() alone is printed first.
+ *
+ * The segments are written without their indexes, so the recovery writes them all. Then twits logged at random times are
+ * looked up with seektwitlog(), each checked with readtwitlog() to be the first one logged at or after the time, and the
+ * time and page faults a lookup takes are printed.
+ *
+ * Usage: benchrecovery [-k] [directory [megabytes]]
+ *	-k keeps the segments and only recovers them if they are already there
+ *
+ * @author Tassos Souris
+ */
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "crc32c.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "twitlog.h"
+
+#define DEFAULT_MEGABYTES (1024)
+
+// Lookups by time
+#define SEEKS (1000)
+
+/**
+ * \struct lookup
+ *
+ * The lookup structure is what checkRecords() is passed by readtwitlog().
+ */
+struct lookup{
+	uint64_t lk_time; /**< The time looked up */
+	uint64_t lk_seq; /**< The twit found */
+	int lk_records; /**< Records seen so far */
+	int lk_ok;
+};
+
+// Text the twits are cut from
+static const char text[] =
+	"After a crash the server reads back every segment of the twit log, checks the checksum of every record and cuts off "
+	"whatever the crash left half written, so that the twits go on from the last one that reached the disk safe and sound.";
+
+/**
+ * The writesegments() function shall write segments of about megabytes megabytes in all to the directory pointed to by parameter
+ * dir, the newest ending with half a record.
+ *
+ * @return The number of records written.
+ */
+static uint64_t writesegments( const char * restrict dir, uint64_t megabytes );
+
+/**
+ * The checkRecords() function shall check, as readtwitlog() calls it from the twit before the one found, that the twit found is the
+ * first logged at or after the time looked up.
+ *
+ * @return Nonzero once the twit found was seen; otherwise zero.
+ */
+static int checkRecords( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg );
+
+int main( int argc, char *argv[] ){
+	const char *dir = "benchrecovery.d";
+	struct twitlogrecovery rc;
+	struct twitlog *tl = NULL;
+	uint64_t megabytes = DEFAULT_MEGABYTES;
+	uint64_t records = 0;
+	uint64_t start, elapsed;
+	unsigned char *buf = NULL;
+	struct lookup lk;
+	struct rusage before, after;
+	uint64_t first, last;
+	uint64_t seeking = 0;
+	uint32_t crc = 0;
+	int keep = 0;
+	int arg = 1;
+	int i;
+
+	if ( argc > arg && strcmp( argv[ arg ], "-k" ) == 0 ){
+		keep = 1;
+		++arg;
+	}
+	if ( argc > arg ){
+		dir = argv[ arg ];
+	}
+	if ( argc > arg + 1 ){
+		megabytes = strtoull( argv[ arg + 1 ], NULL, 10 );
+	}
+
+	// The checksum alone, over 64 MB in records of the usual size
+	if ( ( buf = malloc( 64 * 1024 * 1024 ) ) == NULL ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+	( void )memset( buf, 'x', 64 * 1024 * 1024 );
+	start = monotonic_ns();
+	for ( i = 0; i < 64 * 1024 * 1024 / 128; ++i ){
+		crc ^= crc32c( 0, buf + ( size_t )i * 128, 124 );
+	}
+	elapsed = monotonic_ns() - start;
+	( void )printf( "crc32c (%s): %.2f GB/sec (%08x)\n", crc32cimplementation(), 64.0 / 1024.0 / ( elapsed / 1e9 ), crc );
+	free( buf );
+
+	if ( !keep || access( dir, F_OK ) == -1 ){
+		removesegments( dir );
+		if ( mkdir( dir, 0755 ) == -1 ){
+			perror( dir );
+			exit( EXIT_FAILURE );
+		}
+		start = monotonic_ns();
+		records = writesegments( dir, megabytes );
+		( void )printf( "wrote %llu twits in %.1f sec\n", ( unsigned long long )records, ( monotonic_ns() - start ) / 1e9 );
+	}
+
+	if ( opentwitlog( &tl, dir, TWITLOG_SYNC_NONE, &rc ) == -1 ){
+		perror( dir );
+		exit( EXIT_FAILURE );
+	}
+	closetwitlog( tl );
+	( void )printf( "recovered %llu twits in %llu segments (%.1f MB) with %u threads in %.3f sec: %.2f GB/sec\n",
+		( unsigned long long )rc.tlrc_records,
+		( unsigned long long )rc.tlrc_segments,
+		rc.tlrc_bytes / ( 1024.0 * 1024.0 ),
+		rc.tlrc_threads,
+		rc.tlrc_elapsed / 1e9,
+		rc.tlrc_bytes / 1073741824.0 / ( rc.tlrc_elapsed / 1e9 ) );
+	( void )printf( "cut off %llu bytes, %llu damaged segments, next sequence number %llu\n",
+		( unsigned long long )rc.tlrc_truncated,
+		( unsigned long long )rc.tlrc_damaged,
+		( unsigned long long )rc.tlrc_nextseq );
+	if ( records > 0 && ( rc.tlrc_records != records || rc.tlrc_nextseq != records + 1 || rc.tlrc_truncated == 0 ||
+		rc.tlrc_reindexed != rc.tlrc_segments ) ){
+		( void )fprintf( stderr, "recovery did not find what was written\n" );
+		exit( EXIT_FAILURE );
+	}
+
+	// The time of the first twit; the one of the last is known from the recovery
+	lk.lk_time = 0;
+	lk.lk_records = 0;
+	if ( rc.tlrc_records > 0 && ( seektwitlog( dir, 0, &lk.lk_seq ) == -1 || readtwitlog( dir, lk.lk_seq, &checkRecords, &lk ) == -1 ) ){
+		perror( dir );
+		exit( EXIT_FAILURE );
+	}
+	first = lk.lk_time;
+	last = rc.tlrc_lasttime;
+	srand( 1 );
+	( void )getrusage( RUSAGE_SELF, &before );
+	for ( i = 0; rc.tlrc_records > 0 && i < SEEKS; ++i ){
+		lk.lk_time = first + ( uint64_t )( ( last - first ) * ( rand() / ( RAND_MAX + 1.0 ) ) );
+		start = monotonic_ns();
+		if ( seektwitlog( dir, lk.lk_time, &lk.lk_seq ) == -1 ){
+			perror( dir );
+			exit( EXIT_FAILURE );
+		}
+		seeking += monotonic_ns() - start;
+		// The check reads from the twit before
+		lk.lk_records = 0;
+		lk.lk_ok = 0;
+		if ( readtwitlog( dir, lk.lk_seq > 1 ? lk.lk_seq - 1 : 1, &checkRecords, &lk ) == -1 || !lk.lk_ok ){
+			( void )fprintf( stderr, "seektwitlog() found twit %llu for a time it was not the first at\n", ( unsigned long long )lk.lk_seq );
+			exit( EXIT_FAILURE );
+		}
+	}
+	( void )getrusage( RUSAGE_SELF, &after );
+	if ( rc.tlrc_records > 0 ){
+		( void )printf( "seektwitlog(): %.1f usec, %.1f page faults (%.2f major) per lookup, checking included in the faults\n",
+			seeking / 1000.0 / SEEKS,
+			( double )( after.ru_minflt - before.ru_minflt + after.ru_majflt - before.ru_majflt ) / SEEKS,
+			( double )( after.ru_majflt - before.ru_majflt ) / SEEKS );
+	}
+	if ( !keep ){
+		removesegments( dir );
+	}
+
+	exit( EXIT_SUCCESS );
+}
+
+// Whole segments are built in memory and written at once
+static uint64_t writesegments( const char * restrict dir, uint64_t megabytes ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	unsigned char *segment = NULL;
+	struct twitlogrecord r;
+	uint64_t total = megabytes * 1024 * 1024;
+	uint64_t written = 0;
+	uint64_t seq = 1;
+	size_t len;
+	int i;
+	int fd;
+
+	// Room for the half record too
+	if ( ( segment = malloc( TWITLOG_SEGMENT_SIZE + TWITLOG_RECORD_MAXSIZE ) ) == NULL ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+	while ( written < total ){
+		// The header as startsegment() writes it
+		for ( i = 0; i < 4; ++i ){
+			segment[ i ] = ( unsigned char )( TWITLOG_SEGMENT_MAGIC >> ( 8 * i ) );
+			segment[ 4 + i ] = ( unsigned char )( TWITLOG_VERSION >> ( 8 * i ) );
+		}
+		for ( i = 0; i < 8; ++i ){
+			segment[ 8 + i ] = ( unsigned char )( seq >> ( 8 * i ) );
+		}
+		( void )twitlogsegmentname( path, sizeof( path ), dir, seq );
+		len = TWITLOG_SEGMENT_HEADER_SIZE;
+		while ( len + TWITLOG_RECORD_MAXSIZE <= TWITLOG_SEGMENT_SIZE && written + len < total ){
+			r.tlr_len = ( uint16_t )( 20 + seq * 7 % ( TWIT_MAXLEN - 19 ) );
+			r.tlr_flags = 0;
+			r.tlr_seq = seq++;
+			r.tlr_time = realtime_ns();
+			len += encodetwitlogrecord( segment + len, &r, text + seq % ( sizeof( text ) - 1 - r.tlr_len ) );
+		}
+		written += len;
+		// Half of one more record, as if the server stopped while writing it
+		if ( written >= total ){
+			r.tlr_len = TWIT_MAXLEN;
+			r.tlr_seq = seq;
+			len += encodetwitlogrecord( segment + len, &r, text ) / 2;
+		}
+		if ( ( fd = open( path, O_WRONLY | O_CREAT | O_EXCL, 0644 ) ) == -1 || write( fd, segment, len ) != ( ssize_t )len ){
+			perror( path );
+			exit( EXIT_FAILURE );
+		}
+		( void )close( fd );
+	}
+	free( segment );
+
+	return ( seq - 1 );
+}
+
+// Called from the twit before the one found, unless that is the first one
+static int checkRecords( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg ){
+	struct lookup *lk = ( struct lookup * )arg;
+
+	( void )twit;
+
+	if ( lk->lk_time == 0 ){
+		lk->lk_time = r->tlr_time;
+		return ( 1 );
+	}
+	++lk->lk_records;
+	if ( r->tlr_seq < lk->lk_seq ){
+		return ( r->tlr_time >= lk->lk_time );
+	}
+	lk->lk_ok = ( r->tlr_seq == lk->lk_seq && r->tlr_time >= lk->lk_time );
+
+	return ( 1 );
+}
+
@@ -0,0 +1,309 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchregexes.c
+ *
+ * File benchregexes.c measures the lazy DFA of regexes.h with 1000 and 10000 regular expressions, HEARER_REGEXES_MAXCOUNT for each
+ * hearer: the time to scan a twit and the throughput once the cache is warm, the states of the DFA made, the flushes of the cache
+ * and the twits finished on the NFAs. The same regular expressions, written for regcomp(), are run one after the other with
+ * regexec() as the baseline, and the hearers each twit goes to are checked against theirs. The first rows run with the cache the
+ * server has, REGEX_CACHE_SIZE bytes grown by REGEX_CACHE_REGEX_BYTES for each regular expression, and the bench fails if it
+ * thrashes there. The last one runs the 10000 of them with REGEX_CACHE_SIZE bytes alone: the expressions with a ".*" keep states of
+ * their NFAs in every state of the DFA after their start, so the states of the 10000 take more than that and thrash it.
+ *
+ * The twits are cut from the lines of a corpus (the twits_collection at the top of the repository by default), at most TWIT_MAXLEN
+ * bytes each. One regular expression in ten is built around a word of the corpus, so the twits match some; the rest around
+ * random letters.
+ *
+ * Usage: benchregexes [corpus]
+ *
+ * @author Tassos Souris
+ */
+#include <regex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "regexes.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "config.h"
+
+// The regular expressions measured
+#define MAX_REGEXES (10000)
+#define MAX_HEARERS ( MAX_REGEXES / HEARER_REGEXES_MAXCOUNT )
+
+// The twits are scanned this many times for each measure; the best time counts
+#define ROUNDS (20)
+
+/**
+ * The makeregex() function shall write a regular expression to the buffer pointed to by parameter ours, as regexes.h takes it, and
+ * the same one to the buffer pointed to by parameter posix, as regcomp() takes it, around a word of the corpus if parameter word
+ * is not a NULL pointer and random letters otherwise.
+ *
+ * @return Nothing.
+ */
+static void makeregex( char * restrict ours, char * restrict posix, const char * restrict word, uint64_t * restrict random );
+
+/**
+ * The runrow() function shall subscribe count regular expressions of those pointed to by parameter ours to a struct regexes with a
+ * cache of cachesize bytes and regexbytes for each regular expression, check the hearers each twit goes to against the matches of
+ * the compiled ones pointed to by parameter compiled, time both, and print the row. If parameter mustfit is nonzero the program
+ * fails if the cache thrashed.
+ *
+ * @return Nothing.
+ */
+static void runrow( size_t count, size_t cachesize, size_t regexbytes, int mustfit, char ( *ours )[ REGEX_MAXLEN + 1 ],
+	regex_t *compiled, char **twits, const size_t * restrict twitlens, size_t ntwits, size_t bytes );
+
+int main( int argc, char *argv[] ){
+	const char *path = "../../twits_collection";
+	static char ours[ MAX_REGEXES ][ REGEX_MAXLEN + 1 ];
+	static char posix[ MAX_REGEXES ][ 4 * REGEX_MAXLEN + 1 ];
+	static regex_t compiled[ MAX_REGEXES ];
+	char **twits = NULL;
+	size_t *twitlens = NULL;
+	char *corpus = NULL;
+	char **corpuswords = NULL;
+	size_t ncorpuswords = 0;
+	size_t ntwits = 0;
+	size_t corpuslen;
+	size_t bytes;
+	size_t at;
+	size_t end;
+	size_t i;
+	size_t j;
+	char *p = NULL;
+	uint64_t random = 88172645463325252ull;
+
+	if ( argc > 1 ){
+		path = argv[ 1 ];
+	}
+	corpus = readcorpus( path, &corpuslen );
+	twits = malloc( ( corpuslen + 1 ) * sizeof( *twits ) );
+	twitlens = malloc( ( corpuslen + 1 ) * sizeof( *twitlens ) );
+	corpuswords = malloc( ( corpuslen + 1 ) * sizeof( *corpuswords ) );
+	p = malloc( corpuslen + 1 );
+	if ( twits == NULL || twitlens == NULL || corpuswords == NULL || p == NULL ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+
+	// A twit is what is left of the line, up to TWIT_MAXLEN bytes, with a null byte after it for regexec()
+	for ( at = 0; at < corpuslen; at = end + 1 ){
+		for ( end = at; end < corpuslen && corpus[ end ] != '\n' && end - at < TWIT_MAXLEN; ++end ){
+			continue;
+		}
+		if ( end > at ){
+			twits[ ntwits ] = corpus + at;
+			twitlens[ ntwits++ ] = end - at;
+		}
+		for ( ; end < corpuslen && corpus[ end ] != '\n'; ++end ){
+			continue;
+		}
+		corpus[ end ] = '\0';
+	}
+	for ( bytes = 0, i = 0; i < ntwits; ++i ){
+		bytes += twitlens[ i ];
+	}
+	// The words of the corpus made only of letters, so they need no escaping in either syntax
+	for ( i = 0; i < corpuslen; i = j ){
+		for ( ; i < corpuslen && !( ( corpus[ i ] >= 'a' && corpus[ i ] <= 'z' ) || ( corpus[ i ] >= 'A' && corpus[ i ] <= 'Z' ) ); ++i ){
+			continue;
+		}
+		for ( j = i; j < corpuslen && ( ( corpus[ j ] >= 'a' && corpus[ j ] <= 'z' ) || ( corpus[ j ] >= 'A' && corpus[ j ] <= 'Z' ) ); ++j ){
+			p[ j ] = corpus[ j ];
+		}
+		if ( j - i >= 4 && j - i <= 16 ){
+			p[ j ] = '\0';
+			corpuswords[ ncorpuswords++ ] = p + i;
+		}
+	}
+	if ( ntwits == 0 || ncorpuswords == 0 ){
+		( void )fprintf( stderr, "%s: no twits in the corpus\n", path );
+		exit( EXIT_FAILURE );
+	}
+
+	for ( i = 0; i < MAX_REGEXES; ++i ){
+		makeregex( ours[ i ], posix[ i ], nextrandom( &random ) % 10 == 0 ? corpuswords[ nextrandom( &random ) % ncorpuswords ] : NULL,
+			&random );
+		if ( regcomp( &compiled[ i ], posix[ i ], REG_EXTENDED | REG_NOSUB ) != 0 ){
+			( void )fprintf( stderr, "regcomp() failed for %s\n", posix[ i ] );
+			exit( EXIT_FAILURE );
+		}
+	}
+
+	( void )printf( "%llu twits from %s (%llu bytes), e.g. %s and %s\n\n", ( unsigned long long )ntwits, path,
+		( unsigned long long )corpuslen, ours[ 0 ], ours[ 1 ] );
+	( void )printf( "%8s %8s %8s %8s %8s %10s %12s %9s %10s %8s %8s %12s\n", "regexes", "hearers", "cache", "used", "matched",
+		"DFA ns/tw", "DFA MB/s", "states", "flushes", "thrashed", "speedup", "regexec ns/tw" );
+	runrow( 1000, REGEX_CACHE_SIZE, REGEX_CACHE_REGEX_BYTES, 1, ours, compiled, twits, twitlens, ntwits, bytes );
+	runrow( 10000, REGEX_CACHE_SIZE, REGEX_CACHE_REGEX_BYTES, 1, ours, compiled, twits, twitlens, ntwits, bytes );
+	runrow( 10000, REGEX_CACHE_SIZE, 0, 0, ours, compiled, twits, twitlens, ntwits, bytes );
+
+	for ( i = 0; i < MAX_REGEXES; ++i ){
+		regfree( &compiled[ i ] );
+	}
+	free( p );
+	free( corpuswords );
+	free( twitlens );
+	free( twits );
+	free( corpus );
+
+	exit( EXIT_SUCCESS );
+}
+
+// A word, then one of: a class of digits, a choice of two letters, a wildcard, or up to 20 bytes and two more letters
+static void makeregex( char * restrict ours, char * restrict posix, const char * restrict word, uint64_t * restrict random ){
+	char letters[ 8 ];
+	size_t len;
+	size_t i;
+
+	if ( word == NULL ){
+		for ( len = 3 + nextrandom( random ) % 4, i = 0; i < len; ++i ){
+			letters[ i ] = ( char )( 'a' + nextrandom( random ) % 26 );
+		}
+		letters[ len ] = '\0';
+		word = letters;
+	}
+	switch ( nextrandom( random ) % 4 ){
+	case 0:
+		( void )sprintf( ours, "%s\\d+", word );
+		( void )sprintf( posix, "%s[0-9]+", word );
+		break;
+	case 1:
+		( void )sprintf( ours, "%s(%c|%c)\\w*", word, ( char )( 'a' + nextrandom( random ) % 26 ), ( char )( 'a' + nextrandom( random ) % 26 ) );
+		( void )sprintf( posix, "%s(%c|%c)[[:alnum:]_]*", word, ours[ strlen( word ) + 1 ], ours[ strlen( word ) + 3 ] );
+		break;
+	case 2:
+		( void )sprintf( ours, "%.2s.%s", word, word + 2 );
+		( void )strcpy( posix, ours );
+		break;
+	default:
+		( void )sprintf( ours, "%s.*%c%c", word, ( char )( 'a' + nextrandom( random ) % 26 ), ( char )( 'a' + nextrandom( random ) % 26 ) );
+		( void )strcpy( posix, ours );
+		break;
+	}
+
+	return ;
+}
+
+// The hearers a twit goes to are compared as sets, in the order of the subscribers
+static void runrow( size_t count, size_t cachesize, size_t regexbytes, int mustfit, char ( *ours )[ REGEX_MAXLEN + 1 ],
+	regex_t *compiled, char **twits, const size_t * restrict twitlens, size_t ntwits, size_t bytes ){
+	static struct regexsubscriber subscribers[ MAX_HEARERS ];
+	static struct twitpoollist_node tplns[ MAX_HEARERS ];
+	static uint32_t numbers[ MAX_HEARERS ];
+	static char expected[ MAX_HEARERS ];
+	static char found[ MAX_HEARERS ];
+	char patterns[ HEARER_REGEXES_MAXCOUNT * ( REGEX_MAXLEN + 1 ) ];
+	struct regexes rx;
+	struct bitmap matched;
+	size_t hearers = count / HEARER_REGEXES_MAXCOUNT;
+	size_t matchedtwits = 0;
+	size_t nmatched;
+	size_t h;
+	size_t i;
+	size_t k;
+	uint64_t begin;
+	uint64_t elapsed;
+	uint64_t best = UINT64_MAX;
+	uint64_t baseline;
+	int round;
+
+	if ( initregexes( &rx, cachesize, regexbytes ) == -1 ){
+		perror( "initregexes" );
+		exit( EXIT_FAILURE );
+	}
+	initbitmap( &matched );
+	for ( h = 0; h < hearers; ++h ){
+		tplns[ h ].tpln_hearer = ( uint32_t )h;
+		for ( patterns[ 0 ] = '\0', k = 0; k < HEARER_REGEXES_MAXCOUNT; ++k ){
+			( void )strcat( patterns, k > 0 ? " " : "" );
+			( void )strcat( patterns, ours[ h * HEARER_REGEXES_MAXCOUNT + k ] );
+		}
+		if ( subscriberegexes( &rx, &subscribers[ h ], &tplns[ h ], patterns ) == -1 ){
+			( void )fprintf( stderr, "subscriberegexes() failed for %s\n", patterns );
+			exit( EXIT_FAILURE );
+		}
+	}
+
+	// The baseline checks every hearer, with one regexec() after the other until one matches
+	begin = monotonic_ns();
+	for ( i = 0; i < ntwits; ++i ){
+		clearbitmap( &matched );
+		( void )matchregexes( &rx, twits[ i ], twitlens[ i ], &matched );
+		nmatched = bitmaptoarray( &matched, 0, numbers, hearers );
+		( void )memset( found, 0, hearers );
+		for ( k = 0; k < nmatched; ++k ){
+			found[ numbers[ k ] ] = 1;
+		}
+		for ( h = 0; h < hearers; ++h ){
+			expected[ h ] = 0;
+			for ( k = 0; k < HEARER_REGEXES_MAXCOUNT && !expected[ h ]; ++k ){
+				expected[ h ] = regexec( &compiled[ h * HEARER_REGEXES_MAXCOUNT + k ], twits[ i ], 0, NULL, 0 ) == 0;
+			}
+		}
+		if ( memcmp( found, expected, hearers ) != 0 ){
+			( void )fprintf( stderr, "twit %llu: the hearers matched are not those of regexec()\n", ( unsigned long long )i );
+			exit( EXIT_FAILURE );
+		}
+		matchedtwits += nmatched > 0;
+	}
+	baseline = monotonic_ns() - begin;
+
+	for ( round = 0; round < ROUNDS; ++round ){
+		begin = monotonic_ns();
+		for ( i = 0; i < ntwits; ++i ){
+			clearbitmap( &matched );
+			( void )matchregexes( &rx, twits[ i ], twitlens[ i ], &matched );
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < best ){
+			best = elapsed;
+		}
+	}
+
+	( void )printf( "%8llu %8llu %7lluK %7lluK %7.1f%% %10.1f %12.1f %9llu %10llu %8llu %7.0fx %12.1f\n", ( unsigned long long )count,
+		( unsigned long long )hearers, ( unsigned long long )rx.rx_cachesize * sizeof( uint32_t ) / 1024,
+		( unsigned long long )rx.rx_cacheused * sizeof( uint32_t ) / 1024, 100.0 * matchedtwits / ntwits, ( double )best / ntwits,
+		( double )bytes * 1000.0 / best, ( unsigned long long )rx.rx_dstatecount, ( unsigned long long )rx.rx_flushes,
+		( unsigned long long )rx.rx_thrashed, ( double )baseline / best, ( double )baseline / ntwits );
+	( void )fflush( stdout );
+	if ( mustfit && rx.rx_thrashed > 0 ){
+		( void )fprintf( stderr, "The cache of %lluK thrashed with %llu regular expressions\n",
+			( unsigned long long )rx.rx_cachesize * sizeof( uint32_t ) / 1024, ( unsigned long long )count );
+		exit( EXIT_FAILURE );
+	}
+
+	for ( h = 0; h < hearers; ++h ){
+		unsubscriberegexes( &rx, &subscribers[ h ] );
+	}
+	delregexes( &rx );
+	delbitmap( &matched );
+
+	return ;
+}
@@ -0,0 +1,298 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchrestart.c
+ *
+ * File benchrestart.c measures how long the server takes to get its twit log and its recent history back when it starts again,
+ * from the twit log alone and from a snapshot (see snapshot.h).
+ *
+ * A twit log of about the number of megabytes given as second argument (256 by default) is written in the directory given as first
+ * argument (benchrestart.d by default), with the sync policy TWITLOG_SYNC_NONE. Then the log is opened the way openTwitlog() opens
+ * it, ROUNDS times each way:
+ *	1) from the twit log: opentwitlog() checks every segment and the last HISTORY_SIZE twits are read back into the recent history
+ *	2) from a snapshot written with writesnapshot() after the log was written, with CURSORS cursors: loadsnapshot() maps it,
+ *	opentwitlogfrom() only checks the two newest segments and the recent history and the cursors are copied from the map
+ * and the recent histories are checked to be the same. The segments were just written so they are in the page cache; the time
+ * to read them from the disk comes on top of the first way only.
+ *
+ * Usage: benchrestart [directory [megabytes]]
+ *
+ * @author Tassos Souris
+ */
+#include <sys/stat.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cursors.h"
+#include "history.h"
+#include "snapshot.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "twit.h"
+#include "twitlog.h"
+
+#define DEFAULT_MEGABYTES (256)
+
+// Times the log is opened each way
+#define ROUNDS (3)
+
+// Cursors in the snapshot
+#define CURSORS (100)
+
+// Text the twits are cut from
+static const char text[] =
+	"A server that starts again reads the newest twits back from the twit log into its recent history and checks every segment "
+	"of the log, or maps the snapshot it wrote before it stopped and takes it all from there, checking only what changed since.";
+
+/**
+ * The writelog() function shall append twits to the twit log in the directory pointed to by parameter dir until about megabytes
+ * megabytes are written.
+ *
+ * @return The number of twits appended.
+ */
+static uint64_t writelog( const char * restrict dir, uint64_t megabytes );
+
+/**
+ * The addRecordToHistory() function shall add the twit pointed to by parameter twit, whose record has the header pointed to by
+ * parameter r, to the struct history object pointed to by parameter arg, as openTwitlog() does.
+ *
+ * @return Always zero.
+ */
+static int addRecordToHistory( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg );
+
+/**
+ * The restart() function shall open the twit log in the directory pointed to by parameter dir and fill the empty recent history
+ * pointed to by parameter hs and the empty cursors pointed to by parameter cs, from the snapshot in the file pointed to by parameter
+ * path if it is not a NULL pointer and from the twit log alone otherwise, store what recovery found in the object pointed to by
+ * parameter rc and close the log.
+ *
+ * @return The time it took to open the log and fill the recent history, in nanoseconds.
+ */
+static uint64_t restart( const char * restrict dir, const char * restrict path, struct history * restrict hs, struct cursors * restrict cs,
+	struct twitlogrecovery * restrict rc );
+
+int main( int argc, char *argv[] ){
+	const char *dir = "benchrestart.d";
+	char path[ 512 ];
+	struct historyentry *fromlog = NULL;
+	struct historyentry *fromsnapshot = NULL;
+	struct twitlogrecovery rc;
+	struct twitlog *tl = NULL;
+	struct history hs;
+	struct cursors cs;
+	uint64_t megabytes = DEFAULT_MEGABYTES;
+	uint64_t twits;
+	uint64_t seq;
+	uint64_t start;
+	uint64_t best[ 2 ] = { UINT64_MAX, UINT64_MAX };
+	uint64_t elapsed;
+	char name[ CURSOR_NAME_MAXLEN + 1 ];
+	size_t size;
+	size_t nlog = 0, nsnapshot = 0;
+	int round;
+	int way;
+	int i;
+
+	if ( argc > 1 ){
+		dir = argv[ 1 ];
+	}
+	if ( argc > 2 ){
+		megabytes = strtoull( argv[ 2 ], NULL, 10 );
+	}
+	( void )snprintf( path, sizeof( path ), "%s.snapshot", dir );
+	fromlog = malloc( HISTORY_SIZE * sizeof( *fromlog ) );
+	fromsnapshot = malloc( HISTORY_SIZE * sizeof( *fromsnapshot ) );
+	if ( fromlog == NULL || fromsnapshot == NULL ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+
+	removesegments( dir );
+	start = monotonic_ns();
+	twits = writelog( dir, megabytes );
+	( void )printf( "wrote %llu twits (%llu MB) in %.1f sec\n", ( unsigned long long )twits, ( unsigned long long )megabytes,
+		( monotonic_ns() - start ) / 1e9 );
+
+	// The snapshot the server would write as it stops
+	if ( inithistory( &hs ) == -1 ){
+		perror( "inithistory" );
+		exit( EXIT_FAILURE );
+	}
+	initcursors( &cs );
+	( void )restart( dir, NULL, &hs, &cs, &rc );
+	for ( i = 0; i < CURSORS; ++i ){
+		( void )snprintf( name, sizeof( name ), "hearer-%d", i );
+		if ( takecursor( &cs, name, rc.tlrc_lastseq - ( uint64_t )i, &seq ) == -1 ){
+			perror( "takecursor" );
+			exit( EXIT_FAILURE );
+		}
+	}
+	if ( opentwitlog( &tl, dir, TWITLOG_SYNC_NONE, NULL ) == -1 ){
+		perror( dir );
+		exit( EXIT_FAILURE );
+	}
+	start = monotonic_ns();
+	if ( writesnapshot( path, &hs, &cs, tl, &size ) == -1 ){
+		perror( path );
+		exit( EXIT_FAILURE );
+	}
+	elapsed = monotonic_ns() - start;
+	closetwitlog( tl );
+	delcursors( &cs );
+	delhistory( &hs );
+	( void )printf( "wrote the snapshot (%.1f KB) in %.3f msec\n", size / 1024.0, elapsed / 1e6 );
+
+	( void )printf( "%-10s %12s %10s %10s %10s %10s\n", "from", "msec", "segments", "checked", "twits", "history" );
+	for ( round = 0; round < ROUNDS; ++round ){
+		for ( way = 0; way < 2; ++way ){
+			if ( inithistory( &hs ) == -1 ){
+				perror( "inithistory" );
+				exit( EXIT_FAILURE );
+			}
+			initcursors( &cs );
+			elapsed = restart( dir, way ? path : NULL, &hs, &cs, &rc );
+			if ( elapsed < best[ way ] ){
+				best[ way ] = elapsed;
+			}
+			if ( way ){
+				nsnapshot = copyfromhistory( &hs, 0, fromsnapshot, HISTORY_SIZE );
+			}
+			else{
+				nlog = copyfromhistory( &hs, 0, fromlog, HISTORY_SIZE );
+			}
+			( void )printf( "%-10s %12.3f %10llu %10llu %10llu %10llu\n", way ? "snapshot" : "twit log", elapsed / 1e6,
+				( unsigned long long )( rc.tlrc_segments + rc.tlrc_trusted ), ( unsigned long long )rc.tlrc_segments,
+				( unsigned long long )rc.tlrc_records, ( unsigned long long )( way ? nsnapshot : nlog ) );
+			delcursors( &cs );
+			delhistory( &hs );
+		}
+	}
+	( void )printf( "best: %.3f msec from the twit log, %.3f msec from the snapshot (%.1fx)\n", best[ 0 ] / 1e6, best[ 1 ] / 1e6,
+		( double )best[ 0 ] / ( best[ 1 ] ? best[ 1 ] : 1 ) );
+
+	// The twits may differ only in the bytes after their ends
+	for ( i = 0; ( size_t )i < nlog; ++i ){
+		if ( fromlog[ i ].he_seq != fromsnapshot[ i ].he_seq || fromlog[ i ].he_twitlen != fromsnapshot[ i ].he_twitlen ||
+			memcmp( fromlog[ i ].he_twit, fromsnapshot[ i ].he_twit, fromlog[ i ].he_twitlen ) != 0 ){
+			break;
+		}
+	}
+	if ( nlog != nsnapshot || ( size_t )i != nlog ){
+		( void )fprintf( stderr, "the recent history from the snapshot is not the one from the twit log\n" );
+		exit( EXIT_FAILURE );
+	}
+	free( fromlog );
+	free( fromsnapshot );
+	removesegments( dir );
+	( void )unlink( path );
+
+	exit( EXIT_SUCCESS );
+}
+
+// As in benchtwitlog.c; the writer is never behind for long
+static uint64_t writelog( const char * restrict dir, uint64_t megabytes ){
+	struct twitlogstats tls;
+	struct twitlog *tl = NULL;
+	struct twit t;
+	uint64_t i;
+
+	if ( opentwitlog( &tl, dir, TWITLOG_SYNC_NONE, NULL ) == -1 ){
+		perror( dir );
+		exit( EXIT_FAILURE );
+	}
+	for ( i = 0; ; ++i ){
+		if ( ( i & 1023 ) == 0 ){
+			snapshottwitlog( tl, &tls );
+			if ( tls.tls_bytes >= megabytes * 1024 * 1024 ){
+				break;
+			}
+		}
+		t.t_twitlen = 20 + ( size_t )( i * 7 % ( TWIT_MAXLEN - 19 ) );
+		t.t_twit = ( char * )text + ( i * 13 % ( sizeof( text ) - 1 - t.t_twitlen ) );
+		t.t_seq = nexttwitlogseq( tl );
+		t.t_durable = 0;
+		while ( appendtwitlog( tl, &t ) == -1 ){
+			assert( errno == EAGAIN );
+			( void )sched_yield();
+		}
+	}
+	closetwitlog( tl );
+
+	return ( i );
+}
+
+static int addRecordToHistory( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg ){
+	addtohistory( ( struct history * )arg, r->tlr_seq, r->tlr_time, r->tlr_flags, twit, r->tlr_len );
+
+	return ( 0 );
+}
+
+// What openTwitlog() does, without the threads of the server
+static uint64_t restart( const char * restrict dir, const char * restrict path, struct history * restrict hs, struct cursors * restrict cs,
+	struct twitlogrecovery * restrict rc ){
+	struct snapshot ss;
+	struct twitlog *tl = NULL;
+	uint64_t start;
+	uint64_t elapsed;
+	uint64_t fromseq;
+	size_t count;
+
+	start = monotonic_ns();
+	if ( path != NULL && loadsnapshot( path, &ss ) == -1 ){
+		perror( path );
+		exit( EXIT_FAILURE );
+	}
+	if ( opentwitlogfrom( &tl, dir, TWITLOG_SYNC_NONE, path != NULL ? ss.ss_checkpoints : NULL,
+		path != NULL ? ( size_t )ss.ss_header->ssh_checkpoints : 0, rc ) == -1 ){
+		perror( dir );
+		exit( EXIT_FAILURE );
+	}
+	fromseq = rc->tlrc_lastseq >= HISTORY_SIZE ? rc->tlrc_lastseq - HISTORY_SIZE + 1 : 1;
+	if ( path != NULL ){
+		( void )restorecursors( cs, ss.ss_cursors, ( size_t )ss.ss_header->ssh_cursors );
+		count = ( size_t )ss.ss_header->ssh_entries;
+		if ( count > 0 && rc->tlrc_lastseq < ss.ss_entries[ count - 1 ].he_seq + HISTORY_SIZE ){
+			restorehistory( hs, ss.ss_entries, count );
+			fromseq = ss.ss_entries[ count - 1 ].he_seq + 1;
+		}
+		unloadsnapshot( &ss );
+	}
+	if ( rc->tlrc_lastseq >= fromseq && readtwitlog( dir, fromseq, &addRecordToHistory, hs ) == -1 ){
+		perror( dir );
+		exit( EXIT_FAILURE );
+	}
+	elapsed = monotonic_ns() - start;
+	closetwitlog( tl );
+
+	return ( elapsed );
+}
+
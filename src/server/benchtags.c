@@ -0,0 +1,359 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchtags.c
+ *
+ * File benchtags.c measures the hashtags and the mentions of tags.h: the time to find those of a twit, with the scalar code and with
+ * the SSE2 one, the time the consumer takes to add a twit to the inverted index and the bytes its posting lists take, and the time
+ * to find the last TAG_RECENT_MAXCOUNT twits with a tag in the index and in the recent history, against going through the history
+ * for them, each twit of it looked at for its tags, as a query would have to without the index.
+ *
+ * The twits are cut from the lines of a corpus (the twits_collection at the top of the repository by default), which has no tags,
+ * so up to three are put in each twit at a space, picked out of MAX_TAGS with the skew of words, half of them hashtags and half
+ * mentions. The tags found by both kinds of code, and the twits found with the index and without it, are checked to be the same.
+ *
+ * Usage: benchtags [corpus [twits]]
+ *
+ * @author Tassos Souris
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tags.h"
+#include "history.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "config.h"
+
+// The twits made by default, and the tags they are picked from
+#define DEFAULT_TWITS (200000)
+#define MAX_TAGS (20000)
+
+// The queries for the last twits with a tag
+#define QUERIES (1000)
+
+// The twits are gone through this many times for each measure; the best time counts
+#define ROUNDS (5)
+
+/**
+ * The hastag() function shall check whether the twit of len bytes pointed to by parameter twit has the tag pointed to by parameter
+ * tg, finding its tags as the sayers do.
+ *
+ * @return Nonzero if it does, zero otherwise.
+ */
+static int hastag( const char * restrict twit, size_t len, const struct tag * restrict tg );
+
+int main( int argc, char *argv[] ){
+	static double sums[ MAX_TAGS ];
+	static struct historyentry entries[ TAG_RECENT_MAXCOUNT ];
+	static uint64_t seqs[ TAG_RECENT_MAXCOUNT ];
+	static uint64_t expected[ TAG_RECENT_MAXCOUNT ];
+	static const char *kindnames[] = { "scalar", "SSE2" };
+	const char *path = "../../twits_collection";
+	struct tagindex ti;
+	struct tagsubscriber tgs;
+	struct twitpoollist_node tpln;
+	struct history hs;
+	struct bitmap matched;
+	struct twittag *tags = NULL;
+	struct twittag found[ TWIT_TAGS_MAXCOUNT ];
+	char (*twits)[ TWIT_MAXLEN ] = NULL;
+	size_t *twitlens = NULL;
+	size_t *tagcounts = NULL;
+	uint32_t *queries = NULL;
+	char *corpus = NULL;
+	char **lines = NULL;
+	size_t *linelens = NULL;
+	char name[ TAG_NAME_MAXLEN + 2 ];
+	char tagtext[ 3 * ( TAG_NAME_MAXLEN + 3 ) ];
+	size_t ntwits = DEFAULT_TWITS;
+	size_t nlines = 0;
+	size_t corpuslen;
+	size_t tagtextlen;
+	size_t linelen;
+	size_t at;
+	size_t end;
+	size_t count;
+	size_t total;
+	size_t i;
+	size_t j;
+	size_t k;
+	uint64_t random = 88172645463325252ull;
+	uint64_t seq;
+	uint64_t begin;
+	uint64_t elapsed;
+	uint64_t best;
+	uint64_t baseline;
+	uint64_t scantime;
+	uint64_t indextime;
+	uint64_t gottime;
+	int round;
+	int kind;
+
+	if ( argc > 1 ){
+		path = argv[ 1 ];
+	}
+	if ( argc > 2 ){
+		ntwits = ( size_t )strtoull( argv[ 2 ], NULL, 10 );
+	}
+	corpus = readcorpus( path, &corpuslen );
+
+	lines = malloc( ( corpuslen + 1 ) * sizeof( *lines ) );
+	linelens = malloc( ( corpuslen + 1 ) * sizeof( *linelens ) );
+	twits = malloc( ( ntwits + 1 ) * sizeof( *twits ) );
+	twitlens = malloc( ( ntwits + 1 ) * sizeof( *twitlens ) );
+	tagcounts = malloc( ( ntwits + 1 ) * sizeof( *tagcounts ) );
+	tags = malloc( ( ntwits + 1 ) * TWIT_TAGS_MAXCOUNT * sizeof( *tags ) );
+	queries = malloc( QUERIES * sizeof( *queries ) );
+	if ( lines == NULL || linelens == NULL || twits == NULL || twitlens == NULL || tagcounts == NULL || tags == NULL || queries == NULL ||
+		inittagindex( &ti ) == -1 || inithistory( &hs ) == -1 ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+	initbitmap( &matched );
+	( void )memset( &tpln, 0, sizeof( tpln ) );
+
+	// A line is what is left of it, up to TWIT_MAXLEN bytes
+	for ( at = 0; at < corpuslen; at = end < corpuslen && corpus[ end ] == '\n' ? end + 1 : end ){
+		for ( end = at; end < corpuslen && corpus[ end ] != '\n' && end - at < TWIT_MAXLEN; ++end ){
+			continue;
+		}
+		if ( end > at ){
+			lines[ nlines ] = corpus + at;
+			linelens[ nlines++ ] = end - at;
+		}
+	}
+	if ( nlines == 0 ){
+		( void )fprintf( stderr, "%s: no twits in the corpus\n", path );
+		exit( EXIT_FAILURE );
+	}
+
+	// Each twit is a line with its tags put in after a space in it, or at its start, and cut at TWIT_MAXLEN bytes
+	for ( i = 0; i < MAX_TAGS; ++i ){
+		sums[ i ] = ( i > 0 ? sums[ i - 1 ] : 0.0 ) + 1.0 / ( double )( i + 1 );
+	}
+	for ( i = 0; i < ntwits; ++i ){
+		for ( tagtextlen = 0, k = nextrandom( &random ) % 4; k > 0; --k ){
+			tagtextlen += tagname( tagtext + tagtextlen, pickrank( sums, MAX_TAGS, &random ) );
+			tagtext[ tagtextlen++ ] = ' ';
+		}
+		linelen = linelens[ i % nlines ];
+		for ( at = nextrandom( &random ) % linelen; at > 0 && lines[ i % nlines ][ at - 1 ] != ' '; --at ){
+			continue;
+		}
+		( void )memcpy( twits[ i ], lines[ i % nlines ], at );
+		( void )memcpy( twits[ i ] + at, tagtext, at + tagtextlen > TWIT_MAXLEN ? TWIT_MAXLEN - at : tagtextlen );
+		if ( ( twitlens[ i ] = at + tagtextlen ) < TWIT_MAXLEN ){
+			count = linelen - at < TWIT_MAXLEN - twitlens[ i ] ? linelen - at : TWIT_MAXLEN - twitlens[ i ];
+			( void )memcpy( twits[ i ] + twitlens[ i ], lines[ i % nlines ] + at, count );
+			twitlens[ i ] += count;
+		}
+		else{
+			twitlens[ i ] = TWIT_MAXLEN;
+		}
+	}
+	( void )printf( "%llu twits of the corpus with up to 3 of %d tags each\n\n", ( unsigned long long )ntwits, MAX_TAGS );
+
+	// The tags of the twits, found with each kind of code; the SSE2 one last, so that the rest use it
+	( void )printf( "%8s %14s %14s %9s\n", "code", "ns/twit", "tags/twit", "speedup" );
+	baseline = 0;
+	for ( kind = TAGSCAN_SCALAR; kind <= TAGSCAN_SSE2; ++kind ){
+		if ( settagscankind( ( enum tagscankind )kind ) == -1 ){
+			( void )printf( "%8s %14s\n", kindnames[ kind ], "unsupported" );
+			continue;
+		}
+		for ( i = 0; i < ntwits; ++i ){
+			count = twittags( twits[ i ], twitlens[ i ], found );
+			if ( kind == TAGSCAN_SCALAR ){
+				tagcounts[ i ] = count;
+				( void )memcpy( tags + i * TWIT_TAGS_MAXCOUNT, found, count * sizeof( *found ) );
+			}
+			else if ( count != tagcounts[ i ] || memcmp( tags + i * TWIT_TAGS_MAXCOUNT, found, count * sizeof( *found ) ) != 0 ){
+				( void )fprintf( stderr, "twit %llu: the %s code found other tags\n", ( unsigned long long )i, kindnames[ kind ] );
+				exit( EXIT_FAILURE );
+			}
+		}
+		best = UINT64_MAX;
+		for ( round = 0; round < ROUNDS; ++round ){
+			total = 0;
+			begin = monotonic_ns();
+			for ( i = 0; i < ntwits; ++i ){
+				total += twittags( twits[ i ], twitlens[ i ], found );
+			}
+			if ( ( elapsed = monotonic_ns() - begin ) < best ){
+				best = elapsed;
+			}
+		}
+		if ( kind == TAGSCAN_SCALAR ){
+			baseline = best;
+		}
+		( void )printf( "%8s %14.1f %14.2f %8.1fx\n", kindnames[ kind ], ( double )best / ntwits, ( double )total / ntwits,
+			( double )baseline / best );
+		( void )fflush( stdout );
+	}
+
+	// The twits added to the index and to the recent history, the sequence numbers with gaps as those of the twits left out of the log
+	begin = monotonic_ns();
+	for ( seq = 1, i = 0; i < ntwits; ++i, seq += 1 + nextrandom( &random ) % 3 ){
+		if ( indextwit( &ti, seq, twits[ i ], tags + i * TWIT_TAGS_MAXCOUNT, tagcounts[ i ], &matched ) == -1 ){
+			( void )fprintf( stderr, "indextwit() failed (%s)\n", strerror( errno ) );
+			exit( EXIT_FAILURE );
+		}
+	}
+	indextime = monotonic_ns() - begin;
+	( void )printf( "\nIndex: %.1f ns/twit; %llu tags with %llu postings of the last %d twits in %llu bytes of varints, %.2f bytes each (8 raw)\n",
+		( double )indextime / ntwits, ( unsigned long long )ti.ti_count, ( unsigned long long )ti.ti_postings, HISTORY_SIZE,
+		( unsigned long long )ti.ti_bytes, ti.ti_postings > 0 ? ( double )ti.ti_bytes / ti.ti_postings : 0.0 );
+	( void )fflush( stdout );
+
+	// The queries, with the last HISTORY_SIZE twits in the recent history and the index again, numbered from one
+	deltagindex( &ti );
+	if ( inittagindex( &ti ) == -1 ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+	for ( seq = 1, i = ntwits > HISTORY_SIZE ? ntwits - HISTORY_SIZE : 0; i < ntwits; ++i, ++seq ){
+		addtohistory( &hs, seq, 0, 0, twits[ i ], twitlens[ i ] );
+		if ( indextwit( &ti, seq, twits[ i ], tags + i * TWIT_TAGS_MAXCOUNT, tagcounts[ i ], NULL ) == -1 ){
+			( void )fprintf( stderr, "indextwit() failed (%s)\n", strerror( errno ) );
+			exit( EXIT_FAILURE );
+		}
+	}
+	for ( i = 0; i < QUERIES; ++i ){
+		queries[ i ] = pickrank( sums, MAX_TAGS, &random );
+	}
+	// The same twits both ways, oldest first
+	for ( i = 0; i < QUERIES; ++i ){
+		( void )tagname( name, queries[ i ] );
+		if ( subscribetags( &ti, &tgs, &tpln, name ) != 1 ){
+			( void )fprintf( stderr, "subscribetags() failed (%s)\n", strerror( errno ) );
+			exit( EXIT_FAILURE );
+		}
+		count = recenttagged( &ti, &tgs, seqs, TAG_RECENT_MAXCOUNT );
+		for ( total = 0, j = hs.hs_added; j > 0 && hs.hs_added - j < HISTORY_SIZE && total < TAG_RECENT_MAXCOUNT; --j ){
+			if ( hastag( hs.hs_entries[ ( j - 1 ) % HISTORY_SIZE ].he_twit, hs.hs_entries[ ( j - 1 ) % HISTORY_SIZE ].he_twitlen,
+				tgs.tgs_tags[ 0 ] ) ){
+				expected[ TAG_RECENT_MAXCOUNT - ++total ] = hs.hs_entries[ ( j - 1 ) % HISTORY_SIZE ].he_seq;
+			}
+		}
+		if ( count != total || memcmp( seqs, expected + TAG_RECENT_MAXCOUNT - total, total * sizeof( *seqs ) ) != 0 ||
+			findinhistory( &hs, seqs, count, entries ) != count ){
+			( void )fprintf( stderr, "%s: the index found other twits (%llu instead of %llu)\n", name, ( unsigned long long )count,
+				( unsigned long long )total );
+			exit( EXIT_FAILURE );
+		}
+		unsubscribetags( &ti, &tgs );
+	}
+	best = scantime = gottime = UINT64_MAX;
+	for ( round = 0; round < ROUNDS; ++round ){
+		// Going through the history
+		total = 0;
+		begin = monotonic_ns();
+		for ( i = 0; i < QUERIES; ++i ){
+			( void )tagname( name, queries[ i ] );
+			( void )subscribetags( &ti, &tgs, &tpln, name );
+			for ( count = 0, j = hs.hs_added; j > 0 && hs.hs_added - j < HISTORY_SIZE && count < TAG_RECENT_MAXCOUNT; --j ){
+				if ( hastag( hs.hs_entries[ ( j - 1 ) % HISTORY_SIZE ].he_twit, hs.hs_entries[ ( j - 1 ) % HISTORY_SIZE ].he_twitlen,
+					tgs.tgs_tags[ 0 ] ) ){
+					entries[ TAG_RECENT_MAXCOUNT - ++count ] = hs.hs_entries[ ( j - 1 ) % HISTORY_SIZE ];
+				}
+			}
+			total += count;
+			unsubscribetags( &ti, &tgs );
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < scantime ){
+			scantime = elapsed;
+		}
+		// The sequence numbers in the index alone
+		begin = monotonic_ns();
+		for ( i = 0; i < QUERIES; ++i ){
+			( void )tagname( name, queries[ i ] );
+			( void )subscribetags( &ti, &tgs, &tpln, name );
+			( void )recenttagged( &ti, &tgs, seqs, TAG_RECENT_MAXCOUNT );
+			unsubscribetags( &ti, &tgs );
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < best ){
+			best = elapsed;
+		}
+		// And the twits for them taken from the history, as the server sends them
+		begin = monotonic_ns();
+		for ( i = 0; i < QUERIES; ++i ){
+			( void )tagname( name, queries[ i ] );
+			( void )subscribetags( &ti, &tgs, &tpln, name );
+			count = recenttagged( &ti, &tgs, seqs, TAG_RECENT_MAXCOUNT );
+			( void )findinhistory( &hs, seqs, count, entries );
+			unsubscribetags( &ti, &tgs );
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < gottime ){
+			gottime = elapsed;
+		}
+	}
+	( void )printf( "\nLast %d twits with a tag, %.1f twits found for each of %d queries:\n", TAG_RECENT_MAXCOUNT, ( double )total / QUERIES,
+		QUERIES );
+	( void )printf( "%24s %14s %9s\n", "query", "us/query", "speedup" );
+	( void )printf( "%24s %14.2f %8.1fx\n", "history scanned", ( double )scantime / QUERIES / 1000.0, 1.0 );
+	( void )printf( "%24s %14.2f %8.1fx\n", "index", ( double )best / QUERIES / 1000.0, ( double )scantime / best );
+	( void )printf( "%24s %14.2f %8.1fx\n", "index and history", ( double )gottime / QUERIES / 1000.0, ( double )scantime / gottime );
+
+	deltagindex( &ti );
+	delhistory( &hs );
+	delbitmap( &matched );
+	free( lines );
+	free( linelens );
+	free( twits );
+	free( twitlens );
+	free( tagcounts );
+	free( tags );
+	free( queries );
+	free( corpus );
+
+	exit( EXIT_SUCCESS );
+}
+
+// Some of the names in upper case, which the tags fold
+static int hastag( const char * restrict twit, size_t len, const struct tag * restrict tg ){
+	struct twittag tags[ TWIT_TAGS_MAXCOUNT ];
+	size_t count = twittags( twit, len, tags );
+	size_t i;
+	size_t j;
+
+	for ( i = 0; i < count; ++i ){
+		if ( tags[ i ].tt_hash == tg->tg_hash && tags[ i ].tt_len == tg->tg_namelen ){
+			for ( j = 0; j < tg->tg_namelen && tolower( ( unsigned char )twit[ tags[ i ].tt_offset + j ] ) == tg->tg_name[ j ]; ++j ){
+				continue;
+			}
+			if ( j == tg->tg_namelen ){
+				return ( 1 );
+			}
+		}
+	}
+
+	return ( 0 );
+}
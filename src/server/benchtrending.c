@@ -0,0 +1,350 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchtrending.c
+ *
+ * File benchtrending.c measures what is trending of trending.h: the time the consumer takes to count the tags and the words of a
+ * twit, so the rate of twits it keeps up with, and how close the hashtags and mentions trending most are to those seen most often
+ * in the twits of the window, counted exactly, with the memory both take.
+ *
+ * The twits are cut from the lines of a corpus (the twits_collection at the top of the repository by default), with up to three
+ * tags put in each at a space, picked out of MAX_TAGS with the skew of words, as benchtags does, and are given times a second apart
+ * over the rate of twits. In the twits of the last window one in BURST_EVERY has BURST_TAG too, as a tag that starts trending would;
+ * it should be found among the top ones though it was never seen before.
+ *
+ * Usage: benchtrending [corpus [twits [twits/sec]]]
+ *
+ * @author Tassos Souris
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trending.h"
+#include "tags.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "config.h"
+
+// The twits made by default and their rate, so that the window moves many times, and the tags they are picked from
+#define DEFAULT_TWITS (1000000)
+#define DEFAULT_RATE (500)
+#define MAX_TAGS (20000)
+
+// The tag that starts trending in the last window, and how often it is put in
+#define BURST_TAG "#breaking"
+#define BURST_EVERY (16)
+
+// The tags trending most compared with the exact ones
+#define TOP (20)
+
+// The twits are counted this many times; the best time counts
+#define ROUNDS (3)
+
+/**
+ * \struct exacttag
+ *
+ * The exacttag structure is a tag, by its rank, with the number of twits of the window it is in.
+ */
+struct exacttag{
+	uint32_t et_rank;
+	uint32_t et_count;
+};
+
+/**
+ * The tagrank() function shall return the rank of the tag of len bytes pointed to by parameter name, as tagname() writes it, and
+ * MAX_TAGS for BURST_TAG.
+ *
+ * @return The rank.
+ */
+static uint32_t tagrank( const char * restrict name, size_t len );
+
+/**
+ * The compareexact() function shall compare the tags pointed to by parameters a and b for qsort(), the one in more twits first.
+ *
+ * @return Less than, equal to or greater than zero as a goes before, with or after b.
+ */
+static int compareexact( const void *a, const void *b );
+
+int main( int argc, char *argv[] ){
+	static double sums[ MAX_TAGS ];
+	static struct exacttag exact[ MAX_TAGS + 1 ];
+	static struct trending tr;
+	const char *path = "../../twits_collection";
+	struct trendingentry top[ TOP ];
+	struct twittag *tags = NULL;
+	char (*twits)[ TWIT_MAXLEN ] = NULL;
+	size_t *twitlens = NULL;
+	size_t *tagcounts = NULL;
+	uint32_t *ranks = NULL;
+	char *corpus = NULL;
+	char **lines = NULL;
+	size_t *linelens = NULL;
+	char tagtext[ 4 * ( TAG_NAME_MAXLEN + 3 ) ];
+	size_t ntwits = DEFAULT_TWITS;
+	size_t rate = DEFAULT_RATE;
+	size_t nlines = 0;
+	size_t corpuslen;
+	size_t tagtextlen;
+	size_t linelen;
+	size_t burstfrom;
+	size_t at;
+	size_t end;
+	size_t count;
+	size_t found;
+	size_t distinct;
+	size_t i;
+	size_t j;
+	size_t k;
+	uint64_t random = 88172645463325252ull;
+	uint64_t slotns = ( uint64_t )TRENDING_SLOT_SEC * 1000000000u;
+	uint64_t start = 1000 * slotns;
+	uint64_t now = 0;
+	uint64_t window;
+	uint64_t total;
+	uint64_t begin;
+	uint64_t elapsed;
+	uint64_t best = UINT64_MAX;
+	uint64_t over;
+	uint64_t maxover = 0;
+	uint64_t sumover = 0;
+	uint32_t r;
+	int round;
+
+	if ( argc > 1 ){
+		path = argv[ 1 ];
+	}
+	if ( argc > 2 ){
+		ntwits = ( size_t )strtoull( argv[ 2 ], NULL, 10 );
+	}
+	if ( argc > 3 && ( rate = ( size_t )strtoull( argv[ 3 ], NULL, 10 ) ) == 0 ){
+		rate = DEFAULT_RATE;
+	}
+	corpus = readcorpus( path, &corpuslen );
+
+	lines = malloc( ( corpuslen + 1 ) * sizeof( *lines ) );
+	linelens = malloc( ( corpuslen + 1 ) * sizeof( *linelens ) );
+	twits = malloc( ( ntwits + 1 ) * sizeof( *twits ) );
+	twitlens = malloc( ( ntwits + 1 ) * sizeof( *twitlens ) );
+	tagcounts = malloc( ( ntwits + 1 ) * sizeof( *tagcounts ) );
+	tags = malloc( ( ntwits + 1 ) * TWIT_TAGS_MAXCOUNT * sizeof( *tags ) );
+	ranks = malloc( ( ntwits + 1 ) * 4 * sizeof( *ranks ) );
+	if ( lines == NULL || linelens == NULL || twits == NULL || twitlens == NULL || tagcounts == NULL || tags == NULL || ranks == NULL ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+	( void )settagscankind( TAGSCAN_SSE2 );
+
+	// A line is what is left of it, up to TWIT_MAXLEN bytes
+	for ( at = 0; at < corpuslen; at = end < corpuslen && corpus[ end ] == '\n' ? end + 1 : end ){
+		for ( end = at; end < corpuslen && corpus[ end ] != '\n' && end - at < TWIT_MAXLEN; ++end ){
+			continue;
+		}
+		if ( end > at ){
+			lines[ nlines ] = corpus + at;
+			linelens[ nlines++ ] = end - at;
+		}
+	}
+	if ( nlines == 0 ){
+		( void )fprintf( stderr, "%s: no twits in the corpus\n", path );
+		exit( EXIT_FAILURE );
+	}
+
+	// Each twit is a line with its tags, each once, put in after a space in it, or at its start, and cut at TWIT_MAXLEN bytes
+	for ( i = 0; i < MAX_TAGS; ++i ){
+		sums[ i ] = ( i > 0 ? sums[ i - 1 ] : 0.0 ) + 1.0 / ( double )( i + 1 );
+	}
+	window = ( uint64_t )TRENDING_WINDOW_SLOTS * TRENDING_SLOT_SEC * rate;
+	burstfrom = ntwits > window ? ntwits - window : 0;
+	for ( i = 0; i < ntwits; ++i ){
+		for ( tagtextlen = 0, count = 0, k = nextrandom( &random ) % 4; k > 0; --k ){
+			r = pickrank( sums, MAX_TAGS, &random );
+			for ( j = 0; j < count && ranks[ 4 * i + j ] != r; ++j ){
+				continue;
+			}
+			if ( j == count ){
+				ranks[ 4 * i + count++ ] = r;
+				tagtextlen += tagname( tagtext + tagtextlen, r );
+				tagtext[ tagtextlen++ ] = ' ';
+			}
+		}
+		if ( i >= burstfrom && i % BURST_EVERY == 0 ){
+			ranks[ 4 * i + count++ ] = MAX_TAGS;
+			( void )memcpy( tagtext + tagtextlen, BURST_TAG, sizeof( BURST_TAG ) - 1 );
+			tagtextlen += sizeof( BURST_TAG ) - 1;
+			tagtext[ tagtextlen++ ] = ' ';
+		}
+		for ( ; count < 4; ++count ){
+			ranks[ 4 * i + count ] = UINT32_MAX;
+		}
+		linelen = linelens[ i % nlines ];
+		for ( at = nextrandom( &random ) % linelen; at > 0 && lines[ i % nlines ][ at - 1 ] != ' '; --at ){
+			continue;
+		}
+		( void )memcpy( twits[ i ], lines[ i % nlines ], at );
+		( void )memcpy( twits[ i ] + at, tagtext, at + tagtextlen > TWIT_MAXLEN ? TWIT_MAXLEN - at : tagtextlen );
+		if ( ( twitlens[ i ] = at + tagtextlen ) < TWIT_MAXLEN ){
+			count = linelen - at < TWIT_MAXLEN - twitlens[ i ] ? linelen - at : TWIT_MAXLEN - twitlens[ i ];
+			( void )memcpy( twits[ i ] + twitlens[ i ], lines[ i % nlines ] + at, count );
+			twitlens[ i ] += count;
+		}
+		else{
+			twitlens[ i ] = TWIT_MAXLEN;
+		}
+		// The tags found are the ones counted, so a tag cut off at the end is left out of the exact count too
+		tagcounts[ i ] = twittags( twits[ i ], twitlens[ i ], tags + i * TWIT_TAGS_MAXCOUNT );
+		for ( count = 0; count < 4; ++count ){
+			for ( k = 0; ranks[ 4 * i + count ] != UINT32_MAX && k < tagcounts[ i ]; ++k ){
+				if ( tagrank( twits[ i ] + tags[ i * TWIT_TAGS_MAXCOUNT + k ].tt_offset, tags[ i * TWIT_TAGS_MAXCOUNT + k ].tt_len ) ==
+					ranks[ 4 * i + count ] ){
+					break;
+				}
+			}
+			if ( k == tagcounts[ i ] ){
+				ranks[ 4 * i + count ] = UINT32_MAX;
+			}
+		}
+	}
+	( void )printf( "%llu twits of the corpus with up to 3 of %d tags each at %llu twits/sec, %s in one of %d of the last %llu\n\n",
+		( unsigned long long )ntwits, MAX_TAGS, ( unsigned long long )rate, BURST_TAG, BURST_EVERY, ( unsigned long long )window );
+
+	// The twits counted as the consumer counts them, each at its time
+	for ( round = 0; round < ROUNDS; ++round ){
+		if ( inittrending( &tr ) == -1 ){
+			perror( "inittrending" );
+			exit( EXIT_FAILURE );
+		}
+		begin = monotonic_ns();
+		for ( i = 0; i < ntwits; ++i ){
+			addtotrending( &tr, start + ( uint64_t )i * 1000000000u / rate, twits[ i ], twitlens[ i ], tags + i * TWIT_TAGS_MAXCOUNT,
+				tagcounts[ i ] );
+		}
+		if ( ( elapsed = monotonic_ns() - begin ) < best ){
+			best = elapsed;
+		}
+		if ( round + 1 < ROUNDS ){
+			deltrending( &tr );
+		}
+	}
+	( void )printf( "Count: %.1f ns/twit (%.0f twits/sec); %.2f tags and %.2f words a twit, window moved %llu times, %llu tags and %llu"
+		" words took the place of another followed\n", ( double )best / ntwits, ntwits * 1e9 / best,
+		( double )tr.tr_kinds[ TRENDING_TAGS ].ts_counted / ntwits, ( double )tr.tr_kinds[ TRENDING_WORDS ].ts_counted / ntwits,
+		( unsigned long long )tr.tr_moves, ( unsigned long long )tr.tr_kinds[ TRENDING_TAGS ].ts_replaced,
+		( unsigned long long )tr.tr_kinds[ TRENDING_WORDS ].ts_replaced );
+
+	// The tags of the twits in the window, counted exactly
+	now = start + ( uint64_t )( ntwits - 1 ) * 1000000000u / rate;
+	for ( r = 0; r <= MAX_TAGS; ++r ){
+		exact[ r ].et_rank = r;
+		exact[ r ].et_count = 0;
+	}
+	for ( i = ntwits; i > 0 && ( start + ( uint64_t )( i - 1 ) * 1000000000u / rate ) / slotns + TRENDING_WINDOW_SLOTS > now / slotns; --i ){
+		for ( k = 0; k < 4; ++k ){
+			if ( ranks[ 4 * ( i - 1 ) + k ] != UINT32_MAX ){
+				++exact[ ranks[ 4 * ( i - 1 ) + k ] ].et_count;
+			}
+		}
+	}
+	for ( distinct = 0, r = 0; r <= MAX_TAGS; ++r ){
+		distinct += exact[ r ].et_count > 0;
+	}
+	count = gettrending( &tr, now, TRENDING_TAGS, top, TOP, &total );
+	for ( i = 0; i < count; ++i ){
+		r = tagrank( top[ i ].te_name, top[ i ].te_len );
+		over = top[ i ].te_count - exact[ r ].et_count;
+		sumover += over;
+		maxover = over > maxover ? over : maxover;
+	}
+	qsort( exact, MAX_TAGS + 1, sizeof( *exact ), &compareexact );
+	for ( found = 0, i = 0; i < TOP; ++i ){
+		for ( j = 0; j < count && tagrank( top[ j ].te_name, top[ j ].te_len ) != exact[ i ].et_rank; ++j ){
+			continue;
+		}
+		found += j < count;
+	}
+	( void )printf( "Window: %llu tags counted of %llu different ones; %llu bytes of sketches and summaries, where an exact count would"
+		" take a name and a count for each\n", ( unsigned long long )total, ( unsigned long long )distinct,
+		( unsigned long long )trendingmemory() );
+	( void )printf( "Top %d: %llu of the exact top %d found; counts over by %.1f on average, %llu at most (bound e/%d of the window = %.0f)\n",
+		TOP, ( unsigned long long )found, TOP, count > 0 ? ( double )sumover / count : 0.0, ( unsigned long long )maxover,
+		TRENDING_SKETCH_WIDTH, 2.718281828 * total / TRENDING_SKETCH_WIDTH );
+	( void )printf( "%24s %10s %10s\n", "tag", "estimate", "exact" );
+	for ( i = 0; i < count && i < 10; ++i ){
+		r = tagrank( top[ i ].te_name, top[ i ].te_len );
+		for ( j = 0; exact[ j ].et_rank != r; ++j ){
+			continue;
+		}
+		( void )printf( "%24.*s %10lu %10lu\n", ( int )top[ i ].te_len, top[ i ].te_name, ( unsigned long )top[ i ].te_count,
+			( unsigned long )exact[ j ].et_count );
+	}
+	count = gettrending( &tr, now, TRENDING_WORDS, top, 5, &total );
+	( void )printf( "Words: %llu counted in the window, top:", ( unsigned long long )total );
+	for ( i = 0; i < count; ++i ){
+		( void )printf( " %.*s (%lu)", ( int )top[ i ].te_len, top[ i ].te_name, ( unsigned long )top[ i ].te_count );
+	}
+	( void )printf( "\n" );
+
+	deltrending( &tr );
+	free( lines );
+	free( linelens );
+	free( twits );
+	free( twitlens );
+	free( tagcounts );
+	free( tags );
+	free( ranks );
+	free( corpus );
+
+	exit( EXIT_SUCCESS );
+}
+
+// The names are those of tagname(), in either case; the name in a twit is not nul-terminated
+static uint32_t tagrank( const char * restrict name, size_t len ){
+	uint32_t r = 0;
+	size_t i;
+
+	if ( len == sizeof( BURST_TAG ) - 1 && memcmp( name, BURST_TAG, len ) == 0 ){
+		return ( MAX_TAGS );
+	}
+
+	for ( i = name[ 0 ] == '#' ? 4 : 5; i < len; ++i ){
+		r = 10 * r + ( uint32_t )( name[ i ] - '0' );
+	}
+
+	return ( name[ 0 ] == '#' ? 2 * r : 2 * r + 1 );
+}
+
+static int compareexact( const void *a, const void *b ){
+	const struct exacttag *ea = ( const struct exacttag * )a;
+	const struct exacttag *eb = ( const struct exacttag * )b;
+
+	if ( ea->et_count != eb->et_count ){
+		return ( ea->et_count > eb->et_count ? -1 : 1 );
+	}
+
+	return ( ea->et_rank < eb->et_rank ? -1 : ea->et_rank > eb->et_rank );
+}
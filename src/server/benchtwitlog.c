@@ -0,0 +1,210 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchtwitlog.c
+ *
+ * File benchtwitlog.c measures how many twits a second can be appended to the twit log with each sync policy.
+ *
+ * The twits are appended as fast as appendtwitlog() takes them; when the writer is behind the same twit is tried again,
+ * so the rate is the one the writer sustains. The time includes closetwitlog(), which writes and syncs what is left.
+ * Each policy logs in a directory of its own under the directory given as first argument (benchtwitlog.d by default),
+ * whose segments are removed afterwards.
+ *
+ * Then durable sayers are played by threads that each append a twit and wait for it with waittwitlog() before the next one,
+ * as sayerConnectionHandler() does for DURABLE_SAYERS_PORT. With more of them each sync acknowledges more twits.
+ *
+ * Usage: benchtwitlog [directory [twits]]
+ *
+ * @author Tassos Souris
+ */
+#include <sys/stat.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "histogram.h"
+#include "benchutil.h"
+#include "timing.h"
+#include "twit.h"
+#include "twitlog.h"
+
+#define DEFAULT_TWITS (1000000)
+
+// Twits each durable sayer appends
+#define DURABLE_TWITS (2000)
+
+// Text the twits are cut from
+static const char text[] =
+	"The quick brown fox jumps over the lazy dog while the server keeps every twit it is given on the disk, "
+	"one segment after the other, so that nothing is lost when it is restarted. Hearers that were away can "
+	"later ask for what they missed and sayers never wait for the disk unless they ask for it.";
+
+// The durable sayers take turns to append; the twits must be appended in the order of their sequence numbers
+static pthread_mutex_t appendlock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The durableSayer() function shall append DURABLE_TWITS twits to the twit log pointed to by parameter arg, waiting for each
+ * one to be synced before the next.
+ *
+ * @return Always NULL.
+ */
+static void *durableSayer( void *arg );
+
+int main( int argc, char *argv[] ){
+	const char *dir = "benchtwitlog.d";
+	char policydir[ 200 ];
+	struct twitlogstats tls;
+	struct twitlog *tl = NULL;
+	struct twit t;
+	uint64_t twits = DEFAULT_TWITS;
+	uint64_t retries;
+	uint64_t start, elapsed;
+	uint64_t i;
+	int sync;
+	pthread_t sayers[ SAYERS_MAXCOUNT ];
+	static const int sayercounts[] = { 1, 4, 16, SAYERS_MAXCOUNT };
+	size_t n;
+	int j;
+
+	if ( argc > 1 ){
+		dir = argv[ 1 ];
+	}
+	if ( argc > 2 ){
+		twits = strtoull( argv[ 2 ], NULL, 10 );
+	}
+	if ( mkdir( dir, 0755 ) == -1 && errno != EEXIST ){
+		perror( dir );
+		exit( EXIT_FAILURE );
+	}
+
+	( void )printf( "%-10s %12s %12s %10s %10s %12s %12s\n", "sync", "twits/sec", "MB/sec", "retries", "syncs", "sync p50(us)", "sync p99(us)" );
+	for ( sync = 0; sync < TWITLOG_SYNC_POLICIES; ++sync ){
+		( void )snprintf( policydir, sizeof( policydir ), "%s/%s", dir, twitlogsyncname( sync ) );
+		removesegments( policydir );
+		if ( opentwitlog( &tl, policydir, sync, NULL ) == -1 ){
+			perror( policydir );
+			exit( EXIT_FAILURE );
+		}
+
+		retries = 0;
+		start = monotonic_ns();
+		for ( i = 0; i < twits; ++i ){
+			// Lengths from 20 to TWIT_MAXLEN, from varying places of the text
+			t.t_twitlen = 20 + ( size_t )( i * 7 % ( TWIT_MAXLEN - 19 ) );
+			t.t_twit = ( char * )text + ( i * 13 % ( sizeof( text ) - 1 - t.t_twitlen ) );
+			t.t_seq = nexttwitlogseq( tl );
+			t.t_durable = 0;
+			while ( appendtwitlog( tl, &t ) == -1 ){
+				assert( errno == EAGAIN );
+				++retries;
+				( void )sched_yield();
+			}
+		}
+		snapshottwitlog( tl, &tls );
+		closetwitlog( tl );
+		elapsed = monotonic_ns() - start;
+
+		// The syncs done by closetwitlog() are not in the snapshot; they are one or two and the rate counts them anyway
+		( void )printf( "%-10s %12.0f %12.1f %10llu %10llu %12.1f %12.1f\n",
+			twitlogsyncname( sync ),
+			twits / ( elapsed / 1e9 ),
+			tls.tls_bytes / ( elapsed / 1e9 ) / ( 1024.0 * 1024.0 ),
+			( unsigned long long )retries,
+			( unsigned long long )tls.tls_syncs,
+			histogrampercentile( &tls.tls_sync, 50.0 ) / 1000.0,
+			histogrampercentile( &tls.tls_sync, 99.0 ) / 1000.0 );
+		( void )fflush( stdout );
+		removesegments( policydir );
+	}
+
+	// The policy does not matter to durable twits; with TWITLOG_SYNC_NONE every sync is one they caused
+	( void )printf( "\n%-10s %12s %10s %14s\n", "sayers", "acks/sec", "syncs", "twits/sync" );
+	( void )snprintf( policydir, sizeof( policydir ), "%s/durable", dir );
+	for ( n = 0; n < sizeof( sayercounts ) / sizeof( sayercounts[ 0 ] ); ++n ){
+		removesegments( policydir );
+		if ( opentwitlog( &tl, policydir, TWITLOG_SYNC_NONE, NULL ) == -1 ){
+			perror( policydir );
+			exit( EXIT_FAILURE );
+		}
+		start = monotonic_ns();
+		for ( j = 0; j < sayercounts[ n ]; ++j ){
+			if ( ( errno = pthread_create( &sayers[ j ], NULL, &durableSayer, tl ) ) ){
+				perror( "pthread_create" );
+				exit( EXIT_FAILURE );
+			}
+		}
+		for ( j = 0; j < sayercounts[ n ]; ++j ){
+			( void )pthread_join( sayers[ j ], NULL );
+		}
+		elapsed = monotonic_ns() - start;
+		snapshottwitlog( tl, &tls );
+		closetwitlog( tl );
+
+		( void )printf( "%-10d %12.0f %10llu %14.1f\n",
+			sayercounts[ n ],
+			tls.tls_acked / ( elapsed / 1e9 ),
+			( unsigned long long )tls.tls_syncs,
+			tls.tls_syncs ? ( double )tls.tls_acked / tls.tls_syncs : 0.0 );
+		( void )fflush( stdout );
+	}
+	removesegments( policydir );
+	( void )rmdir( dir );
+
+	exit( EXIT_SUCCESS );
+}
+
+static void *durableSayer( void *arg ){
+	struct twitlog *tl = ( struct twitlog * )arg;
+	struct twit t;
+	int i;
+
+	t.t_twitlen = 100;
+	t.t_twit = ( char * )text;
+	t.t_durable = 1;
+	for ( i = 0; i < DURABLE_TWITS; ++i ){
+		while ( pthread_mutex_lock( &appendlock ) ){ continue; }
+		t.t_seq = nexttwitlogseq( tl );
+		// There is room for a durable twit of each sayer
+		if ( appendtwitlog( tl, &t ) == -1 ){
+			perror( "appendtwitlog" );
+			exit( EXIT_FAILURE );
+		}
+		while ( pthread_mutex_unlock( &appendlock ) ){ continue; }
+		if ( waittwitlog( tl, t.t_seq ) == -1 ){
+			perror( "waittwitlog" );
+			exit( EXIT_FAILURE );
+		}
+	}
+
+	return ( NULL );
+}
+
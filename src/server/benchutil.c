@@ -0,0 +1,115 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchutil.c
+ *
+ * File benchutil.c contains the implementation of the benchutil.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <dirent.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchutil.h"
+
+char *readcorpus( const char * restrict path, size_t * restrict len ){
+	FILE *fp = NULL;
+	char *buf = NULL;
+	long size;
+
+	if ( ( fp = fopen( path, "rb" ) ) == NULL || fseek( fp, 0, SEEK_END ) == -1 || ( size = ftell( fp ) ) <= 0 ||
+		fseek( fp, 0, SEEK_SET ) == -1 ){
+		perror( path );
+		exit( EXIT_FAILURE );
+	}
+	if ( ( buf = malloc( ( size_t )size + 1 ) ) == NULL ){
+		perror( "malloc" );
+		exit( EXIT_FAILURE );
+	}
+	if ( fread( buf, 1, ( size_t )size, fp ) != ( size_t )size ){
+		perror( path );
+		exit( EXIT_FAILURE );
+	}
+	( void )fclose( fp );
+	buf[ size ] = '\0';
+	*len = ( size_t )size;
+
+	return ( buf );
+}
+
+uint64_t nextrandom( uint64_t * restrict state ){
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+
+	return ( *state );
+}
+
+uint32_t pickrank( const double * restrict sums, uint32_t count, uint64_t * restrict random ){
+	double x = ( double )( nextrandom( random ) >> 11 ) / 9007199254740992.0 * sums[ count - 1 ];
+	uint32_t lo = 0;
+	uint32_t hi = count - 1;
+	uint32_t mid;
+
+	while ( lo < hi ){
+		mid = lo + ( hi - lo ) / 2;
+		if ( sums[ mid ] < x ){
+			lo = mid + 1;
+		}
+		else{
+			hi = mid;
+		}
+	}
+
+	return ( lo );
+}
+
+size_t tagname( char * restrict name, uint32_t r ){
+	return ( ( size_t )sprintf( name, r % 2 == 0 ? ( r % 6 == 0 ? "#Tag%u" : "#tag%u" ) : "@user%u", ( unsigned )( r / 2 ) ) );
+}
+
+void removesegments( const char * restrict dir ){
+	char path[ 512 ];
+	struct dirent *entry = NULL;
+	DIR *dp = NULL;
+
+	if ( ( dp = opendir( dir ) ) == NULL ){
+		return ;
+	}
+	while ( ( entry = readdir( dp ) ) != NULL ){
+		if ( strstr( entry->d_name, ".log" ) != NULL || strstr( entry->d_name, ".idx" ) != NULL || strstr( entry->d_name, ".lz" ) != NULL ){
+			( void )snprintf( path, sizeof( path ), "%s/%s", dir, entry->d_name );
+			( void )unlink( path );
+		}
+	}
+	( void )closedir( dp );
+	( void )rmdir( dir );
+
+	return ;
+}
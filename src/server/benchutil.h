@@ -0,0 +1,88 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file benchutil.h
+ *
+ * File benchutil.h declares what the benches share: reading the corpus the twits are cut from, the generator of the random
+ * numbers they are built with, seeded by each bench so its runs are repeatable, picking terms with the skew of words and naming
+ * the tags put in the twits, and removing the segments the benches of the twit log leave. None of it is part of the server.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( BENCHUTIL_H_IS_INCLUDED )
+#define BENCHUTIL_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The readcorpus() function shall read the file at the path pointed to by parameter path into memory, store its size in the
+ * object pointed to by parameter len, and exit the program if that fails.
+ *
+ * @return The bytes of the file, followed by a null byte.
+ */
+char *readcorpus( const char * restrict path, size_t * restrict len );
+
+/**
+ * The nextrandom() function shall return the next number of a xorshift generator whose state is pointed to by parameter state.
+ *
+ * @return The number.
+ */
+uint64_t nextrandom( uint64_t * restrict state );
+
+/**
+ * The pickrank() function shall pick one of count ranks, rank r taken with a chance in proportion to 1 / ( r + 1 ), from the count
+ * sums of those chances pointed to by parameter sums, with the generator whose state is pointed to by parameter random.
+ *
+ * @return The rank.
+ */
+uint32_t pickrank( const double * restrict sums, uint32_t count, uint64_t * restrict random );
+
+/**
+ * The tagname() function shall write the tag with rank r to the buffer pointed to by parameter name, ranks of either parity being
+ * hashtags and mentions, one hashtag in three with a capital letter.
+ *
+ * @return The length of the name.
+ */
+size_t tagname( char * restrict name, uint32_t r );
+
+/**
+ * The removesegments() function shall remove the segments in the directory pointed to by parameter dir and the directory itself.
+ *
+ * @return Nothing.
+ */
+void removesegments( const char * restrict dir );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -0,0 +1,224 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file bitmap.c
+ *
+ * File bitmap.c contains the implementation of the bitmap.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitmap.h"
+
+// Words the storage of a bitmap starts with, enough for the hearers the server takes
+#define BITMAP_INITIAL_WORDS (1)
+
+/**
+ * The reservewords() function shall have the bitset of the bitmap pointed to by parameter bm hold at least count words, the new
+ * ones zero.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ */
+static int reservewords( struct bitmap * restrict bm, uint32_t count );
+
+/**
+ * The countbits() function shall count the bits set in the word given as parameter w.
+ *
+ * @return The number of bits set.
+ */
+static uint32_t countbits( uint64_t w );
+
+
+
+void initbitmap( struct bitmap * restrict bm ){
+	assert( bm != NULL );
+
+	( void )memset( bm, 0, sizeof( *bm ) );
+
+	return ;
+}
+
+void delbitmap( struct bitmap * restrict bm ){
+	assert( bm != NULL );
+
+	free( bm->bm_words );
+	initbitmap( bm );
+
+	return ;
+}
+
+void clearbitmap( struct bitmap * restrict bm ){
+	assert( bm != NULL );
+
+	if ( bm->bm_wordcount > 0 ){
+		( void )memset( bm->bm_words, 0, bm->bm_wordcount * sizeof( *bm->bm_words ) );
+	}
+	bm->bm_wordcount = 0;
+	bm->bm_cardinality = 0;
+
+	return ;
+}
+
+int addtobitmap( struct bitmap * restrict bm, uint32_t n ){
+	uint32_t word = n / 64;
+	uint64_t bit = ( uint64_t )1 << ( n % 64 );
+
+	assert( bm != NULL );
+
+	if ( word >= bm->bm_wordcount ){
+		if ( reservewords( bm, word + 1 ) == -1 ){
+			errno = ENOMEM;
+			return ( -1 );
+		}
+		bm->bm_wordcount = word + 1;
+	}
+	if ( !( bm->bm_words[ word ] & bit ) ){
+		bm->bm_words[ word ] |= bit;
+		++bm->bm_cardinality;
+	}
+
+	return ( 0 );
+}
+
+// The words left zero at the end are no longer in use
+void removefrombitmap( struct bitmap * restrict bm, uint32_t n ){
+	uint32_t word = n / 64;
+	uint64_t bit = ( uint64_t )1 << ( n % 64 );
+
+	assert( bm != NULL );
+
+	if ( word >= bm->bm_wordcount || !( bm->bm_words[ word ] & bit ) ){
+		return ;
+	}
+	bm->bm_words[ word ] &= ~bit;
+	if ( --bm->bm_cardinality == 0 ){
+		delbitmap( bm );
+		return ;
+	}
+	while ( bm->bm_words[ bm->bm_wordcount - 1 ] == 0 ){
+		--bm->bm_wordcount;
+	}
+
+	return ;
+}
+
+int inbitmap( const struct bitmap * restrict bm, uint32_t n ){
+	assert( bm != NULL );
+
+	return ( n / 64 < bm->bm_wordcount && ( ( bm->bm_words[ n / 64 ] >> ( n % 64 ) ) & 1 ) );
+}
+
+size_t bitmapcount( const struct bitmap * restrict bm ){
+	assert( bm != NULL );
+
+	return ( bm->bm_cardinality );
+}
+
+// Only the words that gain bits are counted again
+int orbitmap( struct bitmap * restrict dst, const struct bitmap * restrict src ){
+	uint64_t w;
+	uint32_t i;
+
+	assert( dst != NULL );
+	assert( src != NULL );
+	assert( dst != src );
+
+	if ( src->bm_wordcount > dst->bm_wordcount ){
+		if ( reservewords( dst, src->bm_wordcount ) == -1 ){
+			errno = ENOMEM;
+			return ( -1 );
+		}
+		dst->bm_wordcount = src->bm_wordcount;
+	}
+	for ( i = 0; i < src->bm_wordcount; ++i ){
+		if ( ( w = src->bm_words[ i ] & ~dst->bm_words[ i ] ) != 0 ){
+			dst->bm_words[ i ] |= w;
+			dst->bm_cardinality += countbits( w );
+		}
+	}
+
+	return ( 0 );
+}
+
+// The numbers before the first one are masked off its word
+size_t bitmaptoarray( const struct bitmap * restrict bm, uint32_t from, uint32_t * restrict out, size_t max ){
+	uint64_t word;
+	uint32_t k;
+	size_t count = 0;
+
+	assert( bm != NULL );
+	assert( out != NULL || max == 0 );
+
+	for ( k = from / 64; k < bm->bm_wordcount && count < max; ++k ){
+		word = bm->bm_words[ k ];
+		if ( k == from / 64 ){
+			word &= ~( uint64_t )0 << ( from % 64 );
+		}
+		for ( ; word != 0 && count < max; word &= word - 1 ){
+			out[ count++ ] = k * 64 + ( uint32_t )__builtin_ctzll( word );
+		}
+	}
+
+	return ( count );
+}
+
+
+
+// Implementation of local functions...
+
+// The storage is doubled, so a bitmap filled a number at a time is copied a few times only
+static int reservewords( struct bitmap * restrict bm, uint32_t count ){
+	uint64_t *words = NULL;
+	uint32_t capacity;
+
+	if ( count <= bm->bm_capacity ){
+		return ( 0 );
+	}
+	for ( capacity = bm->bm_capacity > 0 ? bm->bm_capacity : BITMAP_INITIAL_WORDS; capacity < count; capacity *= 2 ){
+		;
+	}
+	if ( ( words = realloc( bm->bm_words, capacity * sizeof( *words ) ) ) == NULL ){
+		return ( -1 );
+	}
+	( void )memset( words + bm->bm_capacity, 0, ( capacity - bm->bm_capacity ) * sizeof( *words ) );
+	bm->bm_words = words;
+	bm->bm_capacity = capacity;
+
+	return ( 0 );
+}
+
+// The bits are counted in the word itself, since without popcnt the builtin is a call into libgcc for every word
+static uint32_t countbits( uint64_t w ){
+	w = w - ( ( w >> 1 ) & 0x5555555555555555ull );
+	w = ( w & 0x3333333333333333ull ) + ( ( w >> 2 ) & 0x3333333333333333ull );
+	w = ( w + ( w >> 4 ) ) & 0x0f0f0f0f0f0f0f0full;
+
+	return ( ( uint32_t )( ( w * 0x0101010101010101ull ) >> 56 ) );
+}
@@ -0,0 +1,145 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file bitmap.h
+ *
+ * File bitmap.h declares the bitmaps of hearers the topics, the keywords, the regular expressions and the tags keep their
+ * subscribers in (see topics.h), so the twitpool consumer finds the hearers of a twit as the union of a few sets rather than by
+ * walking lists, each hearer once whatever number of sets it is in. A hearer is a dense number, the lowest free one when it joins
+ * (see twitpoollist.h), so the numbers stay below HEARERS_MAXCOUNT, but for the few hearers handed over (see handoff.h).
+ *
+ * It is a bitset of 64-bit words, up to the word of the highest number in it, so a bitmap takes a bit for each number up to that
+ * one: a word for the hearers the server takes. The union of two bitmaps is then a word or two of or, the bits each word gains
+ * counted in the word itself, and the numbers are listed a word at a time. A bitmap of numbers as sparse as those of millions of
+ * hearers would take too much storage this way, but the server has none such.
+ *
+ * A bitmap that becomes empty by removing from it frees its storage, so the subscriptions of a topic that lost its subscribers
+ * take none, while clearbitmap() keeps it for the next use, as the consumer clears the same result for each twit. The bitmaps are
+ * not thread safe; those of the server are guarded by the lock of the topics, keywords, regular expressions or tags they belong to.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( BITMAP_H_IS_INCLUDED )
+#define BITMAP_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \struct bitmap
+ *
+ * The bitmap structure holds the bitset of the numbers of a bitmap. The words past the last one in use are kept zero.
+ */
+struct bitmap{
+	uint64_t *bm_words;
+	uint32_t bm_wordcount; /**< Words up to the last one with a number in it */
+	uint32_t bm_capacity; /**< Entries of bm_words */
+	size_t bm_cardinality; /**< Numbers in the bitmap */
+};
+
+
+
+/**
+ * The initbitmap() function shall initialize the empty bitmap pointed to by parameter bm. A bitmap set to all zero bytes is
+ * initialized as well.
+ *
+ * @return Nothing.
+ */
+void initbitmap( struct bitmap * restrict bm );
+
+/**
+ * The delbitmap() function shall free the storage of the bitmap pointed to by parameter bm, which is left empty.
+ *
+ * @return Nothing.
+ */
+void delbitmap( struct bitmap * restrict bm );
+
+/**
+ * The clearbitmap() function shall empty the bitmap pointed to by parameter bm, keeping its storage.
+ *
+ * @return Nothing.
+ */
+void clearbitmap( struct bitmap * restrict bm );
+
+/**
+ * The addtobitmap() function shall add the number given as parameter n to the bitmap pointed to by parameter bm.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate
+ *	the error.
+ * @exception ENOMEM Insufficient storage space for the function to perform the operation.
+ */
+int addtobitmap( struct bitmap * restrict bm, uint32_t n );
+
+/**
+ * The removefrombitmap() function shall remove the number given as parameter n from the bitmap pointed to by parameter bm, if it
+ * is there, and free the storage of the bitmap if it is left empty.
+ *
+ * @return Nothing.
+ */
+void removefrombitmap( struct bitmap * restrict bm, uint32_t n );
+
+/**
+ * The inbitmap() function shall check whether the number given as parameter n is in the bitmap pointed to by parameter bm.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+int inbitmap( const struct bitmap * restrict bm, uint32_t n );
+
+/**
+ * The bitmapcount() function shall count the numbers in the bitmap pointed to by parameter bm.
+ *
+ * @return The count.
+ */
+size_t bitmapcount( const struct bitmap * restrict bm );
+
+/**
+ * The orbitmap() function shall add to the bitmap pointed to by parameter dst the numbers in the bitmap pointed to by parameter
+ * src, which shall be another one.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate
+ *	the error, and the bitmap pointed to by parameter dst has some of the numbers added.
+ * @exception ENOMEM Insufficient storage space for the function to perform the operation.
+ */
+int orbitmap( struct bitmap * restrict dst, const struct bitmap * restrict src );
+
+/**
+ * The bitmaptoarray() function shall store the numbers in the bitmap pointed to by parameter bm from the one given as parameter
+ * from, in increasing order, in the array pointed to by parameter out, up to max of them.
+ *
+ * @return The number of numbers stored.
+ */
+size_t bitmaptoarray( const struct bitmap * restrict bm, uint32_t from, uint32_t * restrict out, size_t max );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -44,12 +44,187 @@ extern "C"{
 // The port in which the server will listen for sayers
 #define SAYERS_PORT  (3331)
 
+// The port in which the server will listen for sayers that want each twit acknowledged once it is synced to the twit log
+#define DURABLE_SAYERS_PORT (3334)
+
 // The port in which the server will listen for hearers
 #define HEARERS_PORT (3332)
 
+// The port in which the server will listen for hearers that first ask for the twits they missed (see resumeframe.h)
+#define RESUMING_HEARERS_PORT (3335)
+
+// The port in which the server will listen for hearers that first name the topics they want (see topicframe.h)
+#define TOPIC_HEARERS_PORT (3336)
+
+// The port in which the server will serve the metrics
+#define METRICS_PORT (3333)
+
+// The port in which the server will answer searches of the twits by the words in them (see searchframe.h)
+#define SEARCH_PORT (3337)
+
+// Maximum time to wait for a read() or write() with a client of the search
+#define SEARCH_WAIT_NSEC (2)
+
+// The port in which the server will answer what is trending (see trendsframe.h)
+#define TRENDS_PORT (3338)
+
+// Maximum time to wait for a read() or write() with a client of the trends
+#define TRENDS_WAIT_NSEC (2)
+
+// Maximum time to wait for a read() or write() with a client of the metrics
+#define METRICS_WAIT_NSEC (2)
+
+// Define LOCK_STATS (add -DLOCK_STATS to the gcc lines in compile) to keep statistics for each lock of the server;
+// they are printed on SIGQUIT and served with the metrics. See lockstats.h
+// #define LOCK_STATS 1
+
+// The events traced by the threads (see trace.h) are written to files named TRACE_FILE_PREFIX.<pid>.<n>
+#define TRACE_FILE_PREFIX "twitserver.trace"
+
+// A twit that takes longer than TRACE_ANOMALY_MSEC milliseconds to go through the server gets the traced events written
+#define TRACE_ANOMALY_MSEC (100)
+
+// But no more often than every TRACE_ANOMALY_INTERVAL_NSEC seconds
+#define TRACE_ANOMALY_INTERVAL_NSEC (10)
+
+// A send() to a hearer that takes longer than TRACE_BLOCKED_MSEC milliseconds is traced as the hearer being blocked
+#define TRACE_BLOCKED_MSEC (1)
+
+// The twits are logged in segments in the directory TWITLOG_DIR (see twitlog.h), relative to the working directory. The server
+// does not start if it cannot create or write it
+#define TWITLOG_DIR "twitlog"
+
+// A new segment of the twit log is started when the next twit would make the current one larger than TWITLOG_SEGMENT_SIZE bytes
+#define TWITLOG_SEGMENT_SIZE (64 * 1024 * 1024)
+
+// Bytes of twits the consumer can hand to the writer of the twit log before twits are left out of it; twice as much memory is used
+#define TWITLOG_BUFFER_SIZE (4 * 1024 * 1024)
+
+// When the twit log is synced to the disk; one of the values of enum twitlogsync (see twitlog.h)
+#define TWITLOG_SYNC TWITLOG_SYNC_INTERVAL
+
+// With TWITLOG_SYNC_INTERVAL the twit log is synced every TWITLOG_SYNC_MSEC milliseconds, if anything was written
+#define TWITLOG_SYNC_MSEC (100)
+
+// While durable sayers wait, the writer of the twit log waits up to TWITLOG_COMMIT_USEC microseconds for the twits of the other
+// durable sayers before it syncs, so one sync acknowledges them all
+#define TWITLOG_COMMIT_USEC (500)
+
+// The index of a segment of the twit log has an entry for a record every TWITLOG_INDEX_STRIDE bytes or so
+#define TWITLOG_INDEX_STRIDE (4096)
+
+// The segments of the twit log whose twits are all older than TWITLOG_RETENTION_SEC seconds are removed; zero keeps them whatever their age
+#define TWITLOG_RETENTION_SEC (7 * 24 * 60 * 60)
+
+// The oldest segments of the twit log are removed while they take more than TWITLOG_RETENTION_BYTES bytes with their indexes; zero for no limit
+#define TWITLOG_RETENTION_BYTES (4ull * 1024 * 1024 * 1024)
+
+// The oldest segments of the twit log are removed while there are more than TWITLOG_RETENTION_SEGMENTS; zero for no limit
+#define TWITLOG_RETENTION_SEGMENTS (0)
+
+// The retention of the twit log is enforced every TWITLOG_RETENTION_CHECK_SEC seconds; the newest segment is never removed
+#define TWITLOG_RETENTION_CHECK_SEC (60)
+
+// Define TWITLOG_ARCHIVE_DIR to have the segments removed moved to that directory, on the same file system, instead of deleted
+// #define TWITLOG_ARCHIVE_DIR "twitlog.archive"
+
+// Set TWITLOG_COMPACT to 1 to have each segment of the twit log written again without the twits that repeat one before them in it,
+// once it is no longer the newest
+#define TWITLOG_COMPACT (0)
+
+// The segments of the twit log older than the newest TWITLOG_HOT_SEGMENTS are compressed; zero for none
+#define TWITLOG_HOT_SEGMENTS (2)
+
+// A compressed segment is cut into blocks of up to TWITLOG_BLOCK_SIZE bytes, each compressed on its own
+#define TWITLOG_BLOCK_SIZE (64 * 1024)
+
+// Number of threads that check the segments of the twit log when the server starts
+#define TWITLOG_RECOVERY_THREADS (4)
+
+// Number of the most recent twits kept in memory (see history.h); filled from the twit log when the server starts
+#define HISTORY_SIZE (4096)
+
+// The recent history, the sequence numbers and the cursors of the hearers are written every SNAPSHOT_INTERVAL_SEC seconds, and when
+// the server terminates, to SNAPSHOT_FILE (see snapshot.h), from which the server starts again without replaying the twit log
+#define SNAPSHOT_FILE "twitserver.snapshot"
+#define SNAPSHOT_INTERVAL_SEC (5)
+
+// Maximum number of cursors kept for hearers that resume by name (see cursors.h); the one taken longest ago makes room for a new one
+#define HEARER_CURSORS_MAXCOUNT (256)
+
+// Maximum length of the name of the cursor of a hearer
+#define CURSOR_NAME_MAXLEN (32)
+
+// Maximum length of the name of a topic and maximum number of topics a hearer subscribes to
+#define TOPIC_NAME_MAXLEN (32)
+#define HEARER_TOPICS_MAXCOUNT (8)
+
+// Maximum length of a keyword and maximum number of keywords a hearer subscribes to
+#define KEYWORD_MAXLEN (32)
+#define HEARER_KEYWORDS_MAXCOUNT (16)
+
+// Maximum length of a regular expression and maximum number of regular expressions a hearer subscribes to
+#define REGEX_MAXLEN (64)
+#define HEARER_REGEXES_MAXCOUNT (8)
+
+// Maximum length of a hashtag or a mention after its '#' or '@', maximum number of them indexed in each twit and maximum number a
+// hearer subscribes to (see tags.h)
+#define TAG_NAME_MAXLEN (32)
+#define TWIT_TAGS_MAXCOUNT (8)
+#define HEARER_TAGS_MAXCOUNT (8)
+
+// Maximum number of recent twits with its hashtags and mentions a hearer asks for before the new ones
+#define TAG_RECENT_MAXCOUNT (100)
+
+// Maximum length of a word searched for, maximum number of words in a search and maximum number of twits a search finds
+#define SEARCH_WORD_MAXLEN (32)
+#define SEARCH_WORDS_MAXCOUNT (8)
+#define SEARCH_RESULTS_MAXCOUNT (100)
+
+// The words of the twits are indexed for the search in segments of SEARCH_SEGMENT_TWITS twits (see fulltext.h); the newest
+// SEARCH_SEGMENTS_MAXCOUNT segments are kept, so the twits before them are not found even if the twit log still has them
+#define SEARCH_SEGMENT_TWITS (65536)
+#define SEARCH_SEGMENTS_MAXCOUNT (16)
+
+// The hashtags, the mentions and the words of the twits are counted over the last TRENDING_WINDOW_SLOTS slots of TRENDING_SLOT_SEC
+// seconds (see trending.h); the window moves a slot at a time
+#define TRENDING_SLOT_SEC (60)
+#define TRENDING_WINDOW_SLOTS (10)
+
+// Each slot has a count-min sketch of TRENDING_SKETCH_DEPTH rows of TRENDING_SKETCH_WIDTH counters for the tags and one for the
+// words; a count is off by at most e / TRENDING_SKETCH_WIDTH of those counted in the window, but for one in e^TRENDING_SKETCH_DEPTH
+#define TRENDING_SKETCH_DEPTH (4)
+#define TRENDING_SKETCH_WIDTH (8192)
+
+// Number of the most frequent tags, and of the most frequent words, followed, and maximum number a client of the trends asks for
+#define TRENDING_MONITORED (256)
+#define TRENDING_RESULTS_MAXCOUNT (50)
+
+// Bytes of the states of the lazy DFA of the regular expressions kept at once (see regexes.h); when they are all taken it starts
+// over. The cache has at least REGEX_CACHE_SIZE bytes and REGEX_CACHE_REGEX_BYTES for each regular expression subscribed to, up to
+// REGEX_CACHE_MAXSIZE: the states of many expressions with a ".*" hold a state of each, and benchregexes fills about 700 bytes a
+// regular expression with 10000 of them, so this leaves room for twice as many states
+#define REGEX_CACHE_SIZE (4 * 1024 * 1024)
+#define REGEX_CACHE_REGEX_BYTES (1536)
+#define REGEX_CACHE_MAXSIZE (64 * 1024 * 1024)
+
+// A server started with -r takes over from the one running through the Unix socket HANDOFF_SOCKET (see handoff.h), which hands over
+// its listening sockets and its hearers
+#define HANDOFF_SOCKET "twitserver.handoff"
+
+// The server handing over waits up to HANDOFF_DRAIN_SEC seconds for its sayers to finish, then as long for its hearers to be handed over
+#define HANDOFF_DRAIN_SEC (5)
+
+// The server taking over waits up to HANDOFF_WAIT_SEC seconds for each message of the one handing over, which may drain for twice
+// HANDOFF_DRAIN_SEC and wait for a hearer blocked sending before it closes its twit log; past that it is taken to be hung
+#define HANDOFF_WAIT_SEC (2 * HANDOFF_DRAIN_SEC + HEARER_WAIT_NSEC + 5)
+
 // Every STATS_UPDATE_NSEC the statistics will be updated
 #define STATS_UPDATE_NSEC (1)
 
+// The longest window (in seconds) over which the incoming and outcoming rates are computed
+#define STATS_RATE_WINDOW_NSEC (60)
+
 // The value used as second argument to the listen() function
 #define SOCKET_BACKLOG (SOMAXCONN)
 
@@ -71,6 +246,12 @@ extern "C"{
 // Maximum number of hearers allowed
 #define HEARERS_MAXCOUNT (30)
 
+// Number of hearers furthest behind that are shown in the statistics
+#define HEARERS_SLOWEST_SHOWN (5)
+
+// Number of the tags, and of the words, trending most that are shown in the statistics
+#define TRENDS_SHOWN (5)
+
 // Maximum number of twits allowed to be stored at any time in memory
 #define TWIT_MAXCOUNT (12000)
 
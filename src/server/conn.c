@@ -33,6 +33,7 @@
  */
 #include <unistd.h>
 #include <sys/types.h>
+#include <stdint.h>
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
@@ -46,6 +47,19 @@
 #include "statistics.h"
 #include "twitpool.h"
 #include "twitpoollist.h"
+#include "timing.h"
+#include "trace.h"
+#include "twitlog.h"
+#include "cursors.h"
+#include "handoff.h"
+#include "topics.h"
+#include "keywords.h"
+#include "regexes.h"
+#include "tags.h"
+#include "history.h"
+#include "topicframe.h"
+#include "ackframe.h"
+#include "replay.h"
 #include "config.h"
 #include "conn.h"
 #include "util.h"
@@ -87,12 +101,13 @@ static void setupHearerConnectionHandler( void *arg );
 
 /**
  * The receivetwit() function shall receive a twit from the socket given as parameter into the buffer pointed to by parameter twit which shall not
- * be a NULL pointer. No more than nbytes shall be read into the buffer.
+ * be a NULL pointer. No more than nbytes shall be read into the buffer. The time at which the whole twit was received shall be stored
+ * in the object pointed to by parameter received, which shall not be a NULL pointer.
  *
  * @return The receivetwit() function shall return the number of bytes read; otherwise, -1 shall be returned meaning that 
  *	the connection must be closed with the socket.
  */
-static ssize_t receivetwit( int sockfd, char *twit, size_t nbytes );
+static ssize_t receivetwit( int sockfd, char *twit, size_t nbytes, uint64_t * restrict received );
 
 /**
  * The sendtwit() function shall send the specified twit to the hearer at the specified sockfd.
@@ -102,6 +117,34 @@ static ssize_t receivetwit( int sockfd, char *twit, size_t nbytes );
  */
 static ssize_t sendtwit( int sockfd, struct twit * restrict t );
 
+/**
+ * The sendack() function shall send to the sayer at the specified sockfd the frame of ackframe.h with the status and sequence
+ * number given as parameters.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ */
+static int sendack( int sockfd, int status, uint64_t seq );
+
+/**
+ * The subscribehearer() function shall read the request line of topicframe.h from the hearer of the connection pointed to by
+ * parameter csi, waiting up to HEARER_WAIT_NSEC seconds, and subscribe its twitpool to the topics, to the keywords, to the regular
+ * expressions or to the hashtags and mentions it names; one that asks for the recent twits with them is sent those first.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EPROTO The request line is not the one of topicframe.h.
+ * @exception ENOMEM There is not enough memory for the keywords, the regular expressions or the hashtags and mentions.
+ */
+static int subscribehearer( struct connserverinfo * restrict csi );
+
+/**
+ * The sendrecent() function shall send to the hearer of the connection pointed to by parameter csi the twits of the recent history
+ * with the count sequence numbers, in increasing order, pointed to by parameter seqs, as it is sent the others.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception ENOMEM Insufficient storage space to copy the twits.
+ */
+static int sendrecent( struct connserverinfo * restrict csi, const uint64_t * restrict seqs, size_t count );
+
 
 
 /**
@@ -111,6 +154,8 @@ static ssize_t sendtwit( int sockfd, struct twit * restrict t );
  *	+ To receive a byte from the sayer up to SAYER_WAIT_NSEC seconds will be elapsed.
  *	If this timeunit passes the connection is closed. Just assume that the sayer is "bad".
  *	+ If an error occurs while reading the connection is closed.
+ *	+ A sayer that came to DURABLE_SAYERS_PORT waits after each twit until it is synced to the twit log, or known not to be,
+ *	and is told with the frame of ackframe.h. Many sayers waiting share the syncs (see waittwitlog()).
  */
 void *sayerConnectionHandler( void *arg ){
 	struct connserverinfo *csi = ( struct connserverinfo * )arg;
@@ -121,6 +166,9 @@ void *sayerConnectionHandler( void *arg ){
 	// rather on the stack. 
 	char twit[ TWIT_MAXLEN + 1 ];
 	const size_t twitlen = sizeof( twit ) / sizeof( twit[ 0 ] );
+	struct twit t = { .t_twit = twit, .t_durable = csi->csi_durable };
+	int ack; // The status sent to a durable sayer
+	int cutoff; // Whether the server stopped taking twits to hand itself over
 
 	assert( csi != NULL );
 	
@@ -138,10 +186,18 @@ void *sayerConnectionHandler( void *arg ){
 			// If the sayer exceeded the limit of twits it can send end here and close the connection
 			break;
 		}
-		if (  ( nread = receivetwit( csi->csi_sockfd, twit, twitlen ) ) == -1 ){	
+		// A server that terminates takes no more twits (see stopsayers())
+		if ( __atomic_load_n( &csi->csi_serverinfo->si_stopping, __ATOMIC_RELAXED ) ){
 			break;
 		}
+		if (  ( nread = receivetwit( csi->csi_sockfd, twit, twitlen, &t.t_received ) ) == -1 ){	
+			break;
+		}
+		t.t_twitlen = ( size_t )nread;
+		t.t_topiclen = twittopic( twit, t.t_twitlen, &t.t_topichash );
+		t.t_tagcount = twittags( twit, t.t_twitlen, t.t_tags );
 		++howmanytwits;
+		trace( TRACE_RECEIVED, t.t_received, 0, ( uint16_t )nread );
 
 		// Update the statistics; a twit arrived
 		acquire_statistics( csi->csi_serverinfo );
@@ -153,11 +209,40 @@ void *sayerConnectionHandler( void *arg ){
 		totaltwitcount = twitpoolcount( &csi->csi_serverinfo->si_twitpool );
 		assert( totaltwitcount <= TWIT_MAXCOUNT );
 		// Store the twit only if it is inside the limit set as TWIT_MAXCOUNT
-		if ( totaltwitcount < TWIT_MAXCOUNT ){
-			( void )putintwitpool( &csi->csi_serverinfo->si_twitpool, twit, ( size_t )nread );
+		ack = ACKFRAME_REJECTED;
+		t.t_seq = 0;
+		// A sayer still connected when the server handing itself over stops taking twits is cut off (see handoff.h)
+		cutoff = ( __atomic_load_n( &csi->csi_serverinfo->si_handoff.ho_state, __ATOMIC_RELAXED ) >= HANDOFF_CUTOFF );
+		if ( !cutoff && totaltwitcount < TWIT_MAXCOUNT ){
+			// The consumer takes the twits in the order they are stored so they reach the twit log in the order
+			// of their sequence numbers. The sayers store them one at a time, so the number is only taken once the
+			// twit is stored; a twit left out leaves no gap in the log
+			t.t_seq = peektwitlogseq( csi->csi_serverinfo->si_twitlog );
+			if ( puttwitintwitpool( &csi->csi_serverinfo->si_twitpool, &t ) == 0 ){
+				( void )nexttwitlogseq( csi->csi_serverinfo->si_twitlog );
+				trace( TRACE_ENQUEUED, t.t_received, 0, 0 );
+				csi->csi_serverinfo->si_queuedseq = t.t_seq;
+				ack = ACKFRAME_SYNCED;
+			} else {
+				t.t_seq = 0;
+			}
 			while ( pthread_cond_signal( &csi->csi_serverinfo->si_twitpool_cond ) ){ continue; }
 		}
 		release_twitpool( csi->csi_serverinfo );
+
+		// Tell a durable sayer once the twit is on the disk
+		if ( csi->csi_durable ){
+			if ( ack == ACKFRAME_SYNCED && waittwitlog( csi->csi_serverinfo->si_twitlog, t.t_seq ) == -1 ){
+				ack = ACKFRAME_FAILED;
+			}
+			if ( sendack( csi->csi_sockfd, ack, ack == ACKFRAME_REJECTED ? 0 : t.t_seq ) == -1 ){
+				break;
+			}
+		}
+		if ( cutoff ){
+			( void )__atomic_fetch_add( &csi->csi_serverinfo->si_handoff.ho_leftout, 1, __ATOMIC_RELAXED );
+			break;
+		}
 	}
 
 	// Cleanup code
@@ -168,7 +253,12 @@ void *sayerConnectionHandler( void *arg ){
 
 void *hearerConnectionHandler( void *arg ){
 	struct connserverinfo *csi = ( struct connserverinfo * )arg;
+	struct hearertelemetry *ht = NULL;
 	struct twit t;
+	struct twitlogrecord r;
+	uint64_t sendstart;
+	uint64_t sendcycles;
+	uint64_t now;
 	int stop = 0;
 
 	assert( csi != NULL );
@@ -179,23 +269,77 @@ void *hearerConnectionHandler( void *arg ){
  	// and not in setupHearerConnectionHandler()
 	pthread_cleanup_push( &cleanupHearerConnectionHandler, csi );
 	setupHearerConnectionHandler( csi );
+	ht = &csi->csi_tpln->tpln_telemetry;
+
+	// A resuming hearer gets what it missed first; meanwhile the new twits wait in its twitpool. One handed over missed nothing
+	if ( csi->csi_resume && !csi->csi_handoff && replaytohearer( csi ) == -1 ){
+		stop = 1;
+	}
+	// A hearer of TOPIC_HEARERS_PORT gets the twits from when it named its topics, its keywords, its regular expressions or its
+	// hashtags and mentions
+	if ( csi->csi_subcount == 0 && csi->csi_kwsubscriber.ksr_count == 0 && csi->csi_rxsubscriber.rsr_count == 0 &&
+		csi->csi_tgsubscriber.tgs_count == 0 && subscribehearer( csi ) == -1 ){
+		stop = 1;
+	}
 
 	// Start sending twits
 	while ( !stop ){
 		// Wait for a twit
 		acquire_twitpool_in_twitpoollist_node( csi->csi_tpln );
-		while ( twitpoolisempty( &csi->csi_tpln->tpln_twitpool ) ){
-			while ( pthread_cond_wait( &csi->csi_tpln->tpln_cond, &csi->csi_tpln->tpln_lock ) ){ continue; }
+		while ( twitpoolisempty( &csi->csi_tpln->tpln_twitpool ) &&
+			__atomic_load_n( &csi->csi_serverinfo->si_handoff.ho_state, __ATOMIC_RELAXED ) < HANDOFF_HEARERS &&
+			!__atomic_load_n( &csi->csi_serverinfo->si_stopping, __ATOMIC_RELAXED ) ){
+			wait_twitpool_in_twitpoollist_node( csi->csi_tpln );
+		}
+		// A server that terminates drops its hearers; they can resume
+		if ( __atomic_load_n( &csi->csi_serverinfo->si_stopping, __ATOMIC_RELAXED ) ){
+			release_twitpool_in_twitpoollist_node( csi->csi_tpln );
+			break;
+		}
+		// Once it was sent every twit, the hearer is handed over to the server that takes over; if it cannot be it is dropped
+		if ( twitpoolisempty( &csi->csi_tpln->tpln_twitpool ) ){
+			release_twitpool_in_twitpoollist_node( csi->csi_tpln );
+			( void )handoffhearer( csi );
+			break;
 		}
 		errno = 0;
 		( void )getfromtwitpool( &csi->csi_tpln->tpln_twitpool, &t );
 		assert( errno == 0 );
+		ht->ht_bytesQueued -= t.t_twitlen;
 		release_twitpool_in_twitpoollist_node( csi->csi_tpln );
 
 		// send the twit
-		if ( sendtwit( csi->csi_sockfd, &t ) == -1 ){
+		sendstart = monotonic_ns();
+		sendcycles = cycles();
+		if ( csi->csi_resume ){
+			// The same record the twit has in the twit log
+			r.tlr_len = ( uint16_t )t.t_twitlen;
+			r.tlr_flags = t.t_durable ? TWITLOG_FLAG_DURABLE : 0;
+			r.tlr_seq = t.t_seq;
+			r.tlr_time = t.t_logged;
+			if ( sendtwitframe( csi->csi_sockfd, &r, t.t_twit ) == -1 ){
+				stop = 1;
+			}
+			else if ( csi->csi_cursor != -1 ){
+				advancecursor( &csi->csi_serverinfo->si_cursors, csi->csi_cursor, t.t_seq );
+			}
+		}
+		else if ( sendtwit( csi->csi_sockfd, &t ) == -1 ){
 			stop = 1;
 		}
+		now = monotonic_ns();
+		( void )__atomic_fetch_add( &ht->ht_sendBlocked_ns, now - sendstart, __ATOMIC_RELAXED );
+		trace( ( now - sendstart > TRACE_BLOCKED_MSEC * 1000000u ) ? TRACE_HEARER_BLOCKED : TRACE_SENT,
+			t.t_received, sendcycles, ( uint16_t )csi->csi_tpln->tpln_id );
+		if ( now - t.t_received > TRACE_ANOMALY_MSEC * 1000000u ){
+			traceanomaly();
+		}
+		if ( !stop ){
+			// Record how long the twit waited for the hearer and how long it spent in the server
+			recordinhistogram( &csi->csi_serverinfo->si_latency[ LATENCY_HEARER ], now - t.t_enqueued );
+			recordinhistogram( &csi->csi_serverinfo->si_latency[ LATENCY_END_TO_END ], now - t.t_received );
+			( void )__atomic_fetch_add( &ht->ht_delivered, 1, __ATOMIC_RELAXED );
+		}
 
 		// Update statistics; a twit was send
 		acquire_statistics( csi->csi_serverinfo );
@@ -212,6 +356,27 @@ void *hearerConnectionHandler( void *arg ){
 	pthread_exit( NULL );
 }
 
+// A hearer subscribes through one of them only, but which one is not kept, and letting go of none is cheap
+void unsubscribehearer( struct serverinfo * restrict si, struct connserverinfo * restrict csi ){
+	assert( si != NULL );
+	assert( csi != NULL );
+
+	acquire_topics( si );
+	unsubscribe( &si->si_topics, csi->csi_subs, csi->csi_subcount );
+	release_topics( si );
+	acquire_keywords( si );
+	unsubscribekeywords( &si->si_keywords, &csi->csi_kwsubscriber );
+	release_keywords( si );
+	acquire_regexes( si );
+	unsubscriberegexes( &si->si_regexes, &csi->csi_rxsubscriber );
+	release_regexes( si );
+	acquire_tags( si );
+	unsubscribetags( &si->si_tags, &csi->csi_tgsubscriber );
+	release_tags( si );
+
+	return ;
+}
+
 
 
 // Here follows the implementation of the local functions...
@@ -233,11 +398,13 @@ static void cleanupSayerConnectionHandler( void *arg ){
 
 	// Cleanup code
 
-	// Close the connection
-	while ( shutdown( csi->csi_sockfd, SHUT_RD ) == -1 ){ continue; }
-	( void )safe_close( csi->csi_sockfd );
+	// Close the connection; shutdown() fails for good once the sayer reset it. The socket leaves its slot before it is closed, so
+	// stopsayers() never shuts down a descriptor that was reused
+	while ( shutdown( csi->csi_sockfd, SHUT_RD ) == -1 && errno == EINTR ){ continue; }
 	// Update the statistics that a sayer was disconnected
 	acquire_statistics( csi->csi_serverinfo );
+	csi->csi_serverinfo->si_sayerfds[ csi->csi_sayerslot ] = -1;
+	( void )safe_close( csi->csi_sockfd );
 	decreaseSayersNum( &csi->csi_serverinfo->si_stats );
 	decreaseThreadsNum( &csi->csi_serverinfo->si_stats );
 	// Must also signal that a sayer was disconnected
@@ -252,13 +419,16 @@ static void cleanupSayerConnectionHandler( void *arg ){
 /** 
  * Cleanup everything from the hearer connection handler.
  * It must:
- *	1) Close the socket
- *	2) Update the statistics
+ *	1) Remove the twitpool from this hearer and from the topics, the keywords, the regular expressions or the hashtags and
+ *	mentions it subscribed to
+ *	2) Close the socket
+ *	3) Update the statistics
  *		--> Decrease number of hearers since one hearer got away
  *		--> Decrease number of threads cause the thread is to be terminated
  *		--> Signal that a hearer was disconnected
- *	3) Remove the twitpool from this hearer
- *	4) Free the csi we got from hearersListener().
+ *	4) Free the csi we got from starthearer().
+ * The twitpool is removed first; the statistics updater samples the socket through it and it must not find
+ * a descriptor that was closed and maybe reused.
  */
 static void cleanupHearerConnectionHandler( void *arg ){
 	struct connserverinfo *csi = ( struct connserverinfo * )arg;
@@ -267,8 +437,20 @@ static void cleanupHearerConnectionHandler( void *arg ){
 
 	// Cleanup code
 
-	// Close the connection
-	while ( shutdown( csi->csi_sockfd, SHUT_WR ) == -1 ){ continue; }
+	// Remove twitpool, once no topic, keyword, regular expression or tag leads to it
+	acquire_twitpool_list( csi->csi_serverinfo );
+	unsubscribehearer( csi->csi_serverinfo, csi );
+	( void )removefromtwitpoollist( &csi->csi_serverinfo->si_twitpool_list, csi->csi_tpln );
+	release_twitpool_list( csi->csi_serverinfo );
+	// Let another hearer take the cursor
+	if ( csi->csi_cursor != -1 ){
+		releasecursor( &csi->csi_serverinfo->si_cursors, csi->csi_cursor );
+	}
+	// Close the connection; one handed over is only closed here, shutdown() would end it for the other server too. shutdown()
+	// fails for good once the hearer reset it
+	if ( !csi->csi_handoff ){
+		while ( shutdown( csi->csi_sockfd, SHUT_WR ) == -1 && errno == EINTR ){ continue; }
+	}
 	( void )safe_close( csi->csi_sockfd );
 	// Update the statistics that a hearer was disconnected
 	acquire_statistics( csi->csi_serverinfo );
@@ -277,10 +459,6 @@ static void cleanupHearerConnectionHandler( void *arg ){
 	// Must also signal that a hearer was disconnected
 	while ( pthread_cond_signal( &csi->csi_serverinfo->si_stats_hearers_cond ) ){ continue; }
 	release_statistics( csi->csi_serverinfo );
-	// Remove twitpool
-	acquire_twitpool_list( csi->csi_serverinfo );
-	( void )removefromtwitpoollist( &csi->csi_serverinfo->si_twitpool_list, csi->csi_tpln );
-	release_twitpool_list( csi->csi_serverinfo );
 	// Free the memory
 	free( csi );
 
@@ -298,6 +476,8 @@ static void setupSayerConnectionHandler( void *arg ){
 
 	assert( csi != NULL );
 
+	tracethread( "sayer" );
+
 	// Set a timeout for reading from the sayer
 	// Since POSIX says that this option may not be supported by all implementations i chose to ignore possible
  	// failure from setsockopt()
@@ -320,6 +500,8 @@ static void setupHearerConnectionHandler( void *arg ){
 
 	assert( csi != NULL );
 
+	tracethread( "hearer" );
+
 	// Set a timeout for writing to a hearer
 	// Since POSIX says that this option may not be supported by all implementations i chose to ignore possible
  	// failure from setsockopt()
@@ -338,13 +520,14 @@ static void setupHearerConnectionHandler( void *arg ){
  *	+ The limit of nbytes
  *	+ A twit can end with a nul byte
  */
-static ssize_t receivetwit( int sockfd, char *twit, size_t nbytes ){
+static ssize_t receivetwit( int sockfd, char *twit, size_t nbytes, uint64_t * restrict received ){
 	size_t nread_total = 0; // How many bytes are read totally
 	ssize_t nread_cur = 0; // return from recv
 	int putnulbyte = 1; // whether a nul byte must be put at the end or not
 
 	assert( twit != NULL );
 	assert( nbytes > 0 );
+	assert( received != NULL );
 
 	nread_total = 0;
 	do{
@@ -377,6 +560,9 @@ static ssize_t receivetwit( int sockfd, char *twit, size_t nbytes ){
 		*( twit + nread_total ) = '\0';
 	}
 
+	// The twit is parsed here
+	*received = monotonic_ns();
+
 	// Return how many bytes received
 	return ( nread_total );
 }
@@ -405,3 +591,165 @@ static ssize_t sendtwit( int sockfd, struct twit * restrict t ){
 
 	return ( nsend_total );
 }
+
+// The sequence number is written little-endian whatever the byte order of the machine
+static int sendack( int sockfd, int status, uint64_t seq ){
+	unsigned char frame[ ACKFRAME_SIZE ];
+	int i;
+
+	frame[ 0 ] = ACKFRAME_MAGIC0;
+	frame[ 1 ] = ACKFRAME_MAGIC1;
+	frame[ 2 ] = ( unsigned char )status;
+	frame[ 3 ] = 0;
+	for ( i = 0; i < 8; ++i ){
+		frame[ 4 + i ] = ( unsigned char )( seq >> ( 8 * i ) );
+	}
+
+	return ( writeall( sockfd, frame, sizeof( frame ) ) == -1 ? -1 : 0 );
+}
+
+// One byte at a time, as readrequest() of replay.c does; the hearer sends nothing else anyway. A hearer that asks for the recent
+// twits with its tags is subscribed to them at the same time, under si_tags_lock, so the twits after the last of those reach its
+// twitpool and it gets each twit once
+static int subscribehearer( struct connserverinfo * restrict csi ){
+	char line[ TOPICFRAME_REQUEST_MAXLEN + 1 ];
+	const char *names = NULL;
+	const char *words = NULL;
+	const char *patterns = NULL;
+	char *tags = NULL;
+	uint64_t seqs[ TAG_RECENT_MAXCOUNT ];
+	unsigned long recent = 0;
+	struct timeval timeout;
+	size_t len = 0;
+	size_t found = 0;
+	ssize_t nread;
+	int count;
+
+	assert( csi != NULL );
+
+	// As with the timeout for writing, a failure is ignored
+	( void )memset( &timeout, 0, sizeof( timeout ) );
+	timeout.tv_sec = ( time_t )HEARER_WAIT_NSEC;
+	timeout.tv_usec = ( suseconds_t )0;
+	( void )setsockopt( csi->csi_sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+
+	do{
+		if ( len == TOPICFRAME_REQUEST_MAXLEN ){
+			errno = EPROTO;
+			return ( -1 );
+		}
+		errno = 0;
+		if ( ( nread = recv( csi->csi_sockfd, line + len, 1, 0 ) ) == -1 ){
+			if ( errno == EINTR ){
+				continue;
+			}
+			return ( -1 );
+		}
+		else if ( nread == 0 ){
+			errno = EPROTO;
+			return ( -1 );
+		}
+	}while ( line[ len++ ] != '\n' );
+	line[ len - 1 ] = '\0';
+	words = line + sizeof( TOPICFRAME_KEYWORDS ) - 1;
+	if ( strncmp( line, TOPICFRAME_KEYWORDS, sizeof( TOPICFRAME_KEYWORDS ) - 1 ) == 0 && validkeywords( words ) ){
+		acquire_twitpool_list( csi->csi_serverinfo );
+		acquire_keywords( csi->csi_serverinfo );
+		count = subscribekeywords( &csi->csi_serverinfo->si_keywords, &csi->csi_kwsubscriber, csi->csi_tpln, words );
+		release_keywords( csi->csi_serverinfo );
+		release_twitpool_list( csi->csi_serverinfo );
+		if ( count == -1 ){
+			return ( -1 );
+		}
+		( void )strcpy( csi->csi_keywords, words );
+		return ( 0 );
+	}
+	patterns = line + sizeof( TOPICFRAME_REGEXES ) - 1;
+	if ( strncmp( line, TOPICFRAME_REGEXES, sizeof( TOPICFRAME_REGEXES ) - 1 ) == 0 && validregexes( patterns ) ){
+		acquire_twitpool_list( csi->csi_serverinfo );
+		acquire_regexes( csi->csi_serverinfo );
+		count = subscriberegexes( &csi->csi_serverinfo->si_regexes, &csi->csi_rxsubscriber, csi->csi_tpln, patterns );
+		release_regexes( csi->csi_serverinfo );
+		release_twitpool_list( csi->csi_serverinfo );
+		if ( count == -1 ){
+			return ( -1 );
+		}
+		( void )strcpy( csi->csi_regexes, patterns );
+		return ( 0 );
+	}
+	tags = line + sizeof( TOPICFRAME_TAGS ) - 1;
+	if ( strncmp( line, TOPICFRAME_RECENT, sizeof( TOPICFRAME_RECENT ) - 1 ) == 0 ){
+		recent = strtoul( line + sizeof( TOPICFRAME_RECENT ) - 1, &tags, 10 );
+		if ( tags == line + sizeof( TOPICFRAME_RECENT ) - 1 || *tags++ != ' ' || recent < 1 || recent > TAG_RECENT_MAXCOUNT ){
+			errno = EPROTO;
+			return ( -1 );
+		}
+	}
+	if ( ( recent > 0 || strncmp( line, TOPICFRAME_TAGS, sizeof( TOPICFRAME_TAGS ) - 1 ) == 0 ) && validtags( tags ) ){
+		acquire_twitpool_list( csi->csi_serverinfo );
+		acquire_tags( csi->csi_serverinfo );
+		if ( ( count = subscribetags( &csi->csi_serverinfo->si_tags, &csi->csi_tgsubscriber, csi->csi_tpln, tags ) ) != -1 ){
+			found = recenttagged( &csi->csi_serverinfo->si_tags, &csi->csi_tgsubscriber, seqs, ( size_t )recent );
+		}
+		release_tags( csi->csi_serverinfo );
+		release_twitpool_list( csi->csi_serverinfo );
+		if ( count == -1 ){
+			return ( -1 );
+		}
+		( void )strcpy( csi->csi_tags, tags );
+		return ( sendrecent( csi, seqs, found ) );
+	}
+	names = line + sizeof( TOPICFRAME_TOPICS ) - 1;
+	if ( strncmp( line, TOPICFRAME_TOPICS, sizeof( TOPICFRAME_TOPICS ) - 1 ) != 0 || !validtopics( names ) ){
+		errno = EPROTO;
+		return ( -1 );
+	}
+
+	acquire_twitpool_list( csi->csi_serverinfo );
+	acquire_topics( csi->csi_serverinfo );
+	count = subscribe( &csi->csi_serverinfo->si_topics, csi->csi_subs, csi->csi_tpln, names );
+	release_topics( csi->csi_serverinfo );
+	release_twitpool_list( csi->csi_serverinfo );
+	if ( count == -1 ){
+		return ( -1 );
+	}
+	( void )strcpy( csi->csi_topics, names );
+	csi->csi_subcount = count;
+
+	return ( 0 );
+}
+
+// The twits are copied out of the recent history at once, so it is not held while they are sent; one gone from it since the hearer
+// asked is not sent
+static int sendrecent( struct connserverinfo * restrict csi, const uint64_t * restrict seqs, size_t count ){
+	struct historyentry *entries = NULL;
+	struct twit t;
+	size_t found;
+	size_t i;
+	int status = 0;
+
+	assert( csi != NULL );
+
+	if ( count == 0 ){
+		return ( 0 );
+	}
+	if ( ( entries = malloc( count * sizeof( *entries ) ) ) == NULL ){
+		errno = ENOMEM;
+		return ( -1 );
+	}
+	found = findinhistory( &csi->csi_serverinfo->si_history, seqs, count, entries );
+	for ( i = 0; i < found && status == 0; ++i ){
+		( void )memset( &t, 0, sizeof( t ) );
+		t.t_twit = entries[ i ].he_twit;
+		t.t_twitlen = entries[ i ].he_twitlen;
+		if ( sendtwit( csi->csi_sockfd, &t ) == -1 ){
+			status = -1;
+		}
+		else{
+			( void )__atomic_fetch_add( &csi->csi_serverinfo->si_recenttwits, 1, __ATOMIC_RELAXED );
+		}
+	}
+	free( entries );
+
+	return ( status );
+}
@@ -27,7 +27,8 @@
 /**
  * \file conn.h
  *
- * The conn.h header file contains the declaration of the sayerConnectionHandler() and hearerConnectionHandler() functions.
+ * The conn.h header file contains the declaration of the sayerConnectionHandler() and hearerConnectionHandler() functions, and of
+ * unsubscribehearer(), which they share with the listener.
  *
  * @author Tassos Souris
  */
@@ -38,6 +39,8 @@
 extern "C"{
 #endif
 
+#include "serverinfo.h"
+
 /**
  * The sayerConnectionHandler() function is responsible for managing the connection with a sayer. The sayerConnectionHandler() function
  * shall run in its own thread and shall be passed a pointer to a connserverinfo structure as parameter that must free before exit.
@@ -54,6 +57,16 @@ void *sayerConnectionHandler( void *arg );
  */
 void *hearerConnectionHandler( void *arg );
 
+/**
+ * The unsubscribehearer() function shall let go of the topics, keywords, regular expressions and tags the hearer of the
+ * connserverinfo structure pointed to by parameter csi subscribed to, each under its own lock in the serverinfo structure pointed
+ * to by parameter si. The twitpool list shall be owned by the caller, so that nothing leads to the twitpool of the hearer once it
+ * is removed from the list. Neither parameter shall be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void unsubscribehearer( struct serverinfo * restrict si, struct connserverinfo * restrict csi );
+
 #if defined( __cplusplus )
 }
 #endif
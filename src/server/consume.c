@@ -39,23 +39,47 @@
 #include "consume.h"
 #include "twitpool.h"
 #include "twitpoollist.h"
+#include "twitlog.h"
+#include "history.h"
+#include "topics.h"
+#include "keywords.h"
+#include "regexes.h"
+#include "tags.h"
+#include "fulltext.h"
+#include "trending.h"
 #include "twit.h"
+#include "timing.h"
+#include "trace.h"
 
 
 
 /**
- * The broadcast_twit() function shall send the twit pointed to by parameter t to the struct twitpool objects in the struct twitpoollist
- * object inside the struct serverinfo object pointed to by parameter si. Neither parameter shall be a NULL pointer.
+ * The broadcast_twit() function shall send the twit pointed to by parameter t to the twitpools of the hearers subscribed to the
+ * global topic, to the topic of the twit, to a keyword in it, to a regular expression it matches and to a hashtag or mention in it,
+ * in the struct serverinfo object pointed to by parameter si. The twit is added to the index of its hashtags and mentions.
+ * Neither parameter shall be a NULL pointer.
  *
  * @return Nothing.
  */
 static void broadcast_twit( struct serverinfo * restrict si, const struct twit * restrict t );
 
+/**
+ * The put_twit() function shall put the twit pointed to by parameter t in the twitpool pointed to by parameter tpln and wake its
+ * hearer.
+ *
+ * @return One if the twit was put in the twitpool, zero otherwise.
+ */
+static uint64_t put_twit( struct serverinfo * restrict si, struct twitpoollist_node * restrict tpln, const struct twit * restrict t );
+
 
 
 /**
  * twitpoolConsumer() is responsible for getting the twits from the twitpool where the server stores the twits
- * send by the sayers and broadcasting those twits to all the hearers. 
+ * send by the sayers and broadcasting those twits to the hearers subscribed to their topics (see topics.h) or to keywords
+ * in them (see keywords.h) or to regular expressions they match (see regexes.h) or to their hashtags and mentions (see tags.h).
+ * Before a twit is broadcast it is appended to the twit log, which gives it its sequence number; appending never
+ * waits for the disk so the hearers are never held back by it. After it is broadcast its words are added to the full-text
+ * index (see fulltext.h), and its tags and words are counted for what is trending (see trending.h).
  */
 void *twitpoolConsumer( void *arg ){
 	struct serverinfo *si = ( struct serverinfo * )arg;
@@ -63,24 +87,44 @@ void *twitpoolConsumer( void *arg ){
 
 	assert( arg != NULL );
 
+	tracethread( "consumer" );
+
 	// Prepared
 	signal_prepared_status( si, 1 );
 
 	// Start consuming twits
 	while ( 1 ){
+		// Under load the twitpool is never empty and the wait below is never reached
+		pthread_testcancel();
+
 		// Get a twit from the twitpool
 		acquire_twitpool( si );
 		while ( twitpoolisempty( &si->si_twitpool ) ){
-			while ( pthread_cond_wait( &si->si_twitpool_cond, &si->si_twitpool_lock ) ){ continue; }
+			wait_twitpool( si );
 		}
 		errno = 0;
 		( void )getfromtwitpool( &si->si_twitpool, &t );
 		assert( errno == 0 );
 		release_twitpool( si );
 
-		// Send the twit to all the hearers
+		// The twit just left the twitpool
+		t.t_dequeued = monotonic_ns();
+		recordinhistogram( &si->si_latency[ LATENCY_CONSUMER_QUEUE ], t.t_dequeued - t.t_received );
+		trace( TRACE_DEQUEUED, t.t_received, 0, 0 );
+
+		// Log the twit; if the log is behind the twit is left out of it and counted but still sent
+		( void )appendtwitlog( si->si_twitlog, &t );
+		addtohistory( &si->si_history, t.t_seq, t.t_logged, t.t_durable ? TWITLOG_FLAG_DURABLE : 0, t.t_twit, t.t_twitlen );
+
+		// Send the twit to the hearers of its topic and of its keywords
 		broadcast_twit( si, &t );
 
+		// Index its words once the hearers have it, so the searches never hold them back
+		( void )addtofulltext( &si->si_fulltext, t.t_seq, t.t_twit, t.t_twitlen );
+
+		// Count its tags and its words in the slot of the time it left the twitpool
+		addtotrending( &si->si_trending, t.t_dequeued, t.t_twit, t.t_twitlen, t.t_tags, t.t_tagcount );
+
 		// Free the twit 
 		free( t.t_twit );
 	}
@@ -92,36 +136,98 @@ void *twitpoolConsumer( void *arg ){
 
 // Implementation of local functions...
 
-// Send the twit to all twitpools
+// Only the twitpools of the subscribers are visited: the bitmaps of the global topic, of the topic of the twit, of the keywords in
+// it, of the regular expressions it matches and of its tags are added up, so a hearer found in several of them gets the twit once. Should a
+// bitmap run out of storage, the twit still goes to the hearers found up to then. Each matcher runs under its own lock, and
+// si_twitpool_list_lock is only taken to turn the numbers found into twitpools, so hearers come and go while a twit is matched.
+// A number whose hearer left since is free or taken by a hearer that joined after the twit, which the boundary leaves out of it
 static void broadcast_twit( struct serverinfo * restrict si, const struct twit * restrict t ){
+	struct bitmap *hearers = &si->si_fanoutset;
 	struct twitpoollist_node *tpln = NULL;
+	uint32_t numbers[ HEARERS_MAXCOUNT ];
+	uint64_t fanout = 0;
+	unsigned long joined; // The twitpools made from now on are of hearers that join after this twit
+	uint32_t from = 0;
+	size_t count;
+	size_t i;
 
 	assert( si != NULL );
 	assert( t != NULL );
 
-	// Acquire ownership of the twitpoollist
+	// A hearer that joins from now on only misses the twits up to this one
 	acquire_twitpool_list( si );
+	si->si_broadcastseq = t->t_seq;
+	joined = si->si_twitpool_list.tpl_nextid;
+	release_twitpool_list( si );
 
-	// For each twitpool
-	for ( tpln = si->si_twitpool_list.tpl_head; tpln != NULL; tpln = tpln->tpln_next ){
-		struct twitpool *tp = &tpln->tpln_twitpool;
-
-		// Acquire ownership of the current twitpool
-		acquire_twitpool_in_twitpoollist_node( tpln );
-
-		// Store the twit in the twitpool
-		( void )putintwitpool( tp, t->t_twit, t->t_twitlen );
-
-		// Signal that a twit just inserted in the twitpool
-		while ( pthread_cond_signal( &tpln->tpln_cond ) ){ continue; }
-
-		// Release ownership of the current twitpool
-		release_twitpool_in_twitpoollist_node( tpln );
+	// Counted before those on topics and with keywords, so a reader that loads these last never finds more of them than in all
+	( void )__atomic_fetch_add( &si->si_broadcasttwits, 1, __ATOMIC_RELAXED );
+	clearbitmap( hearers );
+	acquire_topics( si );
+	( void )orbitmap( hearers, &si->si_topics.ts_global );
+	if ( t->t_topiclen > 0 ){
+		( void )orbitmap( hearers, topicsubscribers( &si->si_topics, t->t_twit + 1, t->t_topiclen, t->t_topichash ) );
+		( void )__atomic_fetch_add( &si->si_topictwits, 1, __ATOMIC_RELEASE );
+	}
+	release_topics( si );
+	acquire_keywords( si );
+	if ( matchkeywords( &si->si_keywords, t->t_twit, t->t_twitlen, hearers ) > 0 ){
+		( void )__atomic_fetch_add( &si->si_keywordtwits, 1, __ATOMIC_RELEASE );
+	}
+	release_keywords( si );
+	acquire_regexes( si );
+	if ( matchregexes( &si->si_regexes, t->t_twit, t->t_twitlen, hearers ) > 0 ){
+		( void )__atomic_fetch_add( &si->si_regextwits, 1, __ATOMIC_RELEASE );
 	}
+	release_regexes( si );
+	acquire_tags( si );
+	if ( indextwit( &si->si_tags, t->t_seq, t->t_twit, t->t_tags, t->t_tagcount, hearers ) > 0 ){
+		( void )__atomic_fetch_add( &si->si_tagtwits, 1, __ATOMIC_RELEASE );
+	}
+	release_tags( si );
 
+	// Acquire ownership of the twitpoollist
+	acquire_twitpool_list( si );
+	// A batch at a time, should hearers handed over and new ones be more than HEARERS_MAXCOUNT for a while
+	do{
+		count = bitmaptoarray( hearers, from, numbers, HEARERS_MAXCOUNT );
+		for ( i = 0; i < count; ++i ){
+			if ( ( tpln = si->si_twitpool_list.tpl_hearers[ numbers[ i ] ] ) != NULL && tpln->tpln_id < joined ){
+				fanout += put_twit( si, tpln, t );
+			}
+		}
+		from = count > 0 ? numbers[ count - 1 ] + 1 : from;
+	}while ( count == HEARERS_MAXCOUNT );
 	// Release ownership of the twitpoollist
 	release_twitpool_list( si );
-	
+	( void )__atomic_fetch_add( &si->si_fanout, fanout, __ATOMIC_RELAXED );
 
 	return ;
 }
+
+// Called with the twitpoollist owned
+static uint64_t put_twit( struct serverinfo * restrict si, struct twitpoollist_node * restrict tpln, const struct twit * restrict t ){
+	struct twitpool *tp = &tpln->tpln_twitpool;
+	struct twit copy = *t;
+	uint64_t count = 0;
+
+	// Acquire ownership of the current twitpool
+	acquire_twitpool_in_twitpoollist_node( tpln );
+
+	// Store the twit in the twitpool
+	copy.t_enqueued = monotonic_ns();
+	if ( puttwitintwitpool( tp, &copy ) == 0 ){
+		tpln->tpln_telemetry.ht_bytesQueued += copy.t_twitlen;
+		recordinhistogram( &si->si_latency[ LATENCY_FANOUT ], copy.t_enqueued - copy.t_dequeued );
+		trace( TRACE_FANNED_OUT, copy.t_received, 0, ( uint16_t )tpln->tpln_id );
+		count = 1;
+	}
+
+	// Signal that a twit just inserted in the twitpool
+	while ( pthread_cond_signal( &tpln->tpln_cond ) ){ continue; }
+
+	// Release ownership of the current twitpool
+	release_twitpool_in_twitpoollist_node( tpln );
+
+	return ( count );
+}
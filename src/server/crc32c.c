@@ -0,0 +1,190 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file crc32c.c
+ *
+ * File crc32c.c contains the implementation of the crc32c.h interface.
+ *
+ * On x86-64 processors with SSE4.2 the checksum is computed with the crc32 instruction, eight bytes at a time. Otherwise it is
+ * computed eight bytes at a time with eight tables (slicing-by-8). Which one is used, and the tables if needed, is decided the
+ * first time a checksum is computed.
+ *
+ * @author Tassos Souris
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#if defined( __x86_64__ )
+#include <nmmintrin.h>
+#endif
+#include "crc32c.h"
+
+
+
+// The reversed Castagnoli polynomial
+#define CRC32C_POLYNOMIAL (0x82f63b78u)
+
+
+
+/**
+ * The choose() function shall choose how crc32c() computes the checksum and build the tables if they are needed.
+ *
+ * @return Nothing.
+ */
+static void choose( void );
+
+/**
+ * The crc32ctables() and crc32cinstruction() functions shall compute the checksum as crc32c() says, the first with the tables and
+ * the second with the crc32 instruction of SSE4.2.
+ *
+ * @return The checksum.
+ */
+static uint32_t crc32ctables( uint32_t crc, const void * restrict buf, size_t len );
+#if defined( __x86_64__ )
+static uint32_t crc32cinstruction( uint32_t crc, const void * restrict buf, size_t len ) __attribute__(( target( "sse4.2" ) ));
+#endif
+
+
+
+// table[ 0 ] is the usual byte table; table[ k ][ b ] is the checksum of byte b followed by k zero bytes
+static uint32_t table[ 8 ][ 256 ];
+
+// Set once by choose()
+static uint32_t ( *compute )( uint32_t crc, const void * restrict buf, size_t len ) = NULL;
+
+static const char *computename = NULL;
+
+static pthread_once_t chooseonce = PTHREAD_ONCE_INIT;
+
+
+
+// The records are small, so pthread_once() is only called until the choice is made
+uint32_t crc32c( uint32_t crc, const void * restrict buf, size_t len ){
+	uint32_t ( *chosen )( uint32_t crc, const void * restrict buf, size_t len ) = __atomic_load_n( &compute, __ATOMIC_ACQUIRE );
+
+	if ( chosen == NULL ){
+		while ( pthread_once( &chooseonce, &choose ) ){ continue; }
+		chosen = compute;
+	}
+
+	return ( chosen( crc, buf, len ) );
+}
+
+const char *crc32cimplementation( void ){
+	while ( pthread_once( &chooseonce, &choose ) ){ continue; }
+
+	return ( computename );
+}
+
+
+
+// Implementation of local functions...
+
+// Eight bytes at a time, then one at a time
+static uint32_t crc32ctables( uint32_t crc, const void * restrict buf, size_t len ){
+	const unsigned char *p = buf;
+
+	crc = ~crc;
+	while ( len >= 8 ){
+		crc ^= ( uint32_t )p[ 0 ] | ( ( uint32_t )p[ 1 ] << 8 ) | ( ( uint32_t )p[ 2 ] << 16 ) | ( ( uint32_t )p[ 3 ] << 24 );
+		crc = table[ 7 ][ crc & 0xff ] ^ table[ 6 ][ ( crc >> 8 ) & 0xff ] ^
+			table[ 5 ][ ( crc >> 16 ) & 0xff ] ^ table[ 4 ][ crc >> 24 ] ^
+			table[ 3 ][ p[ 4 ] ] ^ table[ 2 ][ p[ 5 ] ] ^ table[ 1 ][ p[ 6 ] ] ^ table[ 0 ][ p[ 7 ] ];
+		p += 8;
+		len -= 8;
+	}
+	while ( len-- > 0 ){
+		crc = table[ 0 ][ ( crc ^ *p++ ) & 0xff ] ^ ( crc >> 8 );
+	}
+
+	return ( ~crc );
+}
+
+#if defined( __x86_64__ )
+// One byte at a time up to an eight byte boundary, eight bytes at a time, then one at a time
+static uint32_t crc32cinstruction( uint32_t crc, const void * restrict buf, size_t len ){
+	const unsigned char *p = buf;
+	uint64_t crc64;
+	uint64_t word;
+
+	crc = ~crc;
+	while ( len > 0 && ( ( uintptr_t )p & 7 ) != 0 ){
+		crc = _mm_crc32_u8( crc, *p++ );
+		--len;
+	}
+	crc64 = crc;
+	while ( len >= 8 ){
+		( void )memcpy( &word, p, sizeof( word ) );
+		crc64 = _mm_crc32_u64( crc64, word );
+		p += 8;
+		len -= 8;
+	}
+	crc = ( uint32_t )crc64;
+	while ( len-- > 0 ){
+		crc = _mm_crc32_u8( crc, *p++ );
+	}
+
+	return ( ~crc );
+}
+#endif
+
+// The instruction if the processor has it; the tables are built only if they are used
+static void choose( void ){
+	uint32_t crc;
+	int b;
+	int bit;
+	int k;
+
+#if defined( __x86_64__ )
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "sse4.2" ) ){
+		computename = "sse4.2";
+		__atomic_store_n( &compute, &crc32cinstruction, __ATOMIC_RELEASE );
+		return ;
+	}
+#endif
+
+	for ( b = 0; b < 256; ++b ){
+		crc = ( uint32_t )b;
+		for ( bit = 0; bit < 8; ++bit ){
+			crc = ( crc & 1 ) ? ( crc >> 1 ) ^ CRC32C_POLYNOMIAL : crc >> 1;
+		}
+		table[ 0 ][ b ] = crc;
+	}
+	for ( b = 0; b < 256; ++b ){
+		crc = table[ 0 ][ b ];
+		for ( k = 1; k < 8; ++k ){
+			crc = table[ 0 ][ crc & 0xff ] ^ ( crc >> 8 );
+			table[ k ][ b ] = crc;
+		}
+	}
+	computename = "slicing-by-8";
+	__atomic_store_n( &compute, &crc32ctables, __ATOMIC_RELEASE );
+
+	return ;
+}
@@ -0,0 +1,65 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file crc32c.h
+ *
+ * File crc32c.h declares the functions used to compute the CRC-32C (Castagnoli) checksum of the records of the twit log.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( CRC32C_H_IS_INCLUDED )
+#define CRC32C_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The crc32c() function shall continue the CRC-32C checksum given as parameter crc over the len bytes pointed to by parameter
+ * buf. The checksum of a whole buffer is crc32c( 0, buf, len ), and crc32c( crc32c( 0, a, alen ), b, blen ) is the checksum of
+ * a followed by b.
+ *
+ * @return The checksum.
+ */
+uint32_t crc32c( uint32_t crc, const void * restrict buf, size_t len );
+
+/**
+ * The crc32cimplementation() function shall return the name of the way crc32c() computes the checksum on this processor:
+ * "sse4.2" with the crc32 instruction, "slicing-by-8" with tables.
+ *
+ * @return Pointer to the name.
+ */
+const char *crc32cimplementation( void );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
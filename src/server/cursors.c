@@ -0,0 +1,190 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file cursors.c
+ *
+ * File cursors.c contains the implementation of the cursors.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include "cursors.h"
+#include "lockstats.h"
+#include "timing.h"
+
+
+
+void initcursors( struct cursors * restrict cs ){
+	assert( cs != NULL );
+
+	cs->cs_count = 0;
+	while ( pthread_mutex_init( &cs->cs_lock, NULL ) ){ continue; }
+
+	return ;
+}
+
+void delcursors( struct cursors * restrict cs ){
+	assert( cs != NULL );
+
+	( void )pthread_mutex_destroy( &cs->cs_lock );
+
+	return ;
+}
+
+// The names go in the request line of resumeframe.h and in the snapshot, so they are kept to what needs no escaping
+int validcursorname( const char * restrict name ){
+	size_t len;
+
+	assert( name != NULL );
+
+	for ( len = 0; name[ len ] != '\0'; ++len ){
+		if ( len == CURSOR_NAME_MAXLEN || !( ( name[ len ] >= 'a' && name[ len ] <= 'z' ) || ( name[ len ] >= 'A' && name[ len ] <= 'Z' ) ||
+			( name[ len ] >= '0' && name[ len ] <= '9' ) || name[ len ] == '.' || name[ len ] == '_' || name[ len ] == '-' ) ){
+			return ( 0 );
+		}
+	}
+
+	return ( len > 0 );
+}
+
+// Hearers only take cursors when they connect, so a linear search is enough
+int takecursor( struct cursors * restrict cs, const char * restrict name, uint64_t seq, uint64_t * restrict cursorseq ){
+	struct hearercursor *hc = NULL;
+	size_t i;
+	int cursor = -1;
+
+	assert( cs != NULL );
+	assert( name != NULL );
+	assert( cursorseq != NULL );
+
+	if ( !validcursorname( name ) ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	lock_mutex( LOCK_CURSORS, &cs->cs_lock, &cs->cs_lockedat );
+	for ( i = 0; i < cs->cs_count; ++i ){
+		if ( strcmp( cs->cs_cursors[ i ].hc_name, name ) == 0 ){
+			cursor = ( int )i;
+			break;
+		}
+	}
+	if ( cursor == -1 && cs->cs_count < HEARER_CURSORS_MAXCOUNT ){
+		cursor = ( int )cs->cs_count++;
+		cs->cs_cursors[ cursor ].hc_holders = 0;
+		__atomic_store_n( &cs->cs_cursors[ cursor ].hc_seq, seq, __ATOMIC_RELAXED );
+	}
+	else if ( cursor == -1 ){
+		for ( i = 0; i < cs->cs_count; ++i ){
+			if ( cs->cs_cursors[ i ].hc_holders == 0 && ( cursor == -1 || cs->cs_cursors[ i ].hc_taken < cs->cs_cursors[ cursor ].hc_taken ) ){
+				cursor = ( int )i;
+			}
+		}
+		if ( cursor == -1 ){
+			unlock_mutex( LOCK_CURSORS, &cs->cs_lock, &cs->cs_lockedat );
+			errno = EBUSY;
+			return ( -1 );
+		}
+		__atomic_store_n( &cs->cs_cursors[ cursor ].hc_seq, seq, __ATOMIC_RELAXED );
+	}
+	hc = &cs->cs_cursors[ cursor ];
+	( void )strcpy( hc->hc_name, name );
+	hc->hc_taken = realtime_ns();
+	++hc->hc_holders;
+	*cursorseq = __atomic_load_n( &hc->hc_seq, __ATOMIC_RELAXED );
+	unlock_mutex( LOCK_CURSORS, &cs->cs_lock, &cs->cs_lockedat );
+
+	return ( cursor );
+}
+
+// A cursor with holders is never replaced, so the index stays its own
+void advancecursor( struct cursors * restrict cs, int cursor, uint64_t seq ){
+	assert( cs != NULL );
+	assert( cursor >= 0 && cursor < HEARER_CURSORS_MAXCOUNT );
+
+	__atomic_store_n( &cs->cs_cursors[ cursor ].hc_seq, seq, __ATOMIC_RELAXED );
+
+	return ;
+}
+
+void releasecursor( struct cursors * restrict cs, int cursor ){
+	assert( cs != NULL );
+	assert( cursor >= 0 && cursor < HEARER_CURSORS_MAXCOUNT );
+
+	lock_mutex( LOCK_CURSORS, &cs->cs_lock, &cs->cs_lockedat );
+	assert( cs->cs_cursors[ cursor ].hc_holders > 0 );
+	--cs->cs_cursors[ cursor ].hc_holders;
+	unlock_mutex( LOCK_CURSORS, &cs->cs_lock, &cs->cs_lockedat );
+
+	return ;
+}
+
+size_t copycursors( struct cursors * restrict cs, struct hearercursor * restrict entries ){
+	size_t count;
+	size_t i;
+
+	assert( cs != NULL );
+	assert( entries != NULL );
+
+	lock_mutex( LOCK_CURSORS, &cs->cs_lock, &cs->cs_lockedat );
+	count = cs->cs_count;
+	for ( i = 0; i < count; ++i ){
+		( void )memset( &entries[ i ], 0, sizeof( entries[ i ] ) );
+		( void )strcpy( entries[ i ].hc_name, cs->cs_cursors[ i ].hc_name );
+		entries[ i ].hc_seq = __atomic_load_n( &cs->cs_cursors[ i ].hc_seq, __ATOMIC_RELAXED );
+		entries[ i ].hc_taken = cs->cs_cursors[ i ].hc_taken;
+	}
+	unlock_mutex( LOCK_CURSORS, &cs->cs_lock, &cs->cs_lockedat );
+
+	return ( count );
+}
+
+// The entries come from a file, so a name is only taken if it ends within its array
+size_t restorecursors( struct cursors * restrict cs, const struct hearercursor * restrict entries, size_t count ){
+	struct hearercursor *hc = NULL;
+	size_t i;
+
+	assert( cs != NULL );
+	assert( entries != NULL || count == 0 );
+
+	lock_mutex( LOCK_CURSORS, &cs->cs_lock, &cs->cs_lockedat );
+	for ( i = 0; i < count && cs->cs_count < HEARER_CURSORS_MAXCOUNT; ++i ){
+		if ( memchr( entries[ i ].hc_name, '\0', sizeof( entries[ i ].hc_name ) ) == NULL || !validcursorname( entries[ i ].hc_name ) ){
+			continue;
+		}
+		hc = &cs->cs_cursors[ cs->cs_count++ ];
+		( void )strcpy( hc->hc_name, entries[ i ].hc_name );
+		hc->hc_seq = entries[ i ].hc_seq;
+		hc->hc_taken = entries[ i ].hc_taken;
+		hc->hc_holders = 0;
+	}
+	count = cs->cs_count;
+	unlock_mutex( LOCK_CURSORS, &cs->cs_lock, &cs->cs_lockedat );
+
+	return ( count );
+}
@@ -0,0 +1,145 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file cursors.h
+ *
+ * File cursors.h declares the cursors of the hearers: for each name a hearer resumed with ("CURSOR name", see resumeframe.h), the
+ * sequence number of the last twit it was sent. A hearer that comes back with the same name, even after the server was restarted,
+ * is sent the twits after that one. The cursors are kept in the snapshot (see snapshot.h) so they survive restarts.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( CURSORS_H_IS_INCLUDED )
+#define CURSORS_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "config.h"
+
+/**
+ * \struct hearercursor
+ *
+ * The hearercursor structure is the cursor of a hearer.
+ */
+struct hearercursor{
+	char hc_name[ CURSOR_NAME_MAXLEN + 1 ];
+	uint64_t hc_seq; /**< Sequence number of the last twit sent to the hearer; stored atomically */
+	uint64_t hc_taken; /**< When a hearer last took the cursor, in nanoseconds since the Epoch */
+	unsigned hc_holders; /**< Number of hearers connected with it; only a cursor with none makes room for another */
+};
+
+/**
+ * \struct cursors
+ *
+ * The cursors structure is the table of the cursors of the hearers. The members other than hc_seq are guarded by cs_lock.
+ */
+struct cursors{
+	pthread_mutex_t cs_lock;
+	uint64_t cs_lockedat;
+	struct hearercursor cs_cursors[ HEARER_CURSORS_MAXCOUNT ];
+	size_t cs_count;
+};
+
+
+
+/**
+ * The initcursors() function shall initialize the empty table of cursors pointed to by parameter cs.
+ *
+ * @return Nothing.
+ */
+void initcursors( struct cursors * restrict cs );
+
+/**
+ * The delcursors() function shall release the resources of the table of cursors pointed to by parameter cs.
+ *
+ * @return Nothing.
+ */
+void delcursors( struct cursors * restrict cs );
+
+/**
+ * The validcursorname() function shall check that the string pointed to by parameter name is the name of a cursor: one to
+ * CURSOR_NAME_MAXLEN letters, digits, '.', '_' or '-'.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+int validcursorname( const char * restrict name );
+
+/**
+ * The takecursor() function shall find the cursor named by parameter name in the table pointed to by parameter cs, or create it
+ * with the sequence number given as parameter seq, store its sequence number in the object pointed to by parameter cursorseq and
+ * count the caller as one of its holders until releasecursor(). A new cursor replaces the one taken longest ago that has no holders
+ * if the table is full.
+ *
+ * @return Upon successful completion the index of the cursor shall be returned; otherwise, -1 shall be returned and errno shall be
+ * 	set to indicate the error.
+ * @exception EINVAL The name is not valid.
+ * @exception EBUSY The table is full and every cursor has holders.
+ */
+int takecursor( struct cursors * restrict cs, const char * restrict name, uint64_t seq, uint64_t * restrict cursorseq );
+
+/**
+ * The advancecursor() function shall store the sequence number given as parameter seq in the cursor with index cursor of the table
+ * pointed to by parameter cs, which the caller holds. It takes no lock.
+ *
+ * @return Nothing.
+ */
+void advancecursor( struct cursors * restrict cs, int cursor, uint64_t seq );
+
+/**
+ * The releasecursor() function shall stop counting the caller as a holder of the cursor with index cursor of the table pointed to
+ * by parameter cs.
+ *
+ * @return Nothing.
+ */
+void releasecursor( struct cursors * restrict cs, int cursor );
+
+/**
+ * The copycursors() function shall copy to the array of HEARER_CURSORS_MAXCOUNT entries pointed to by parameter entries the cursors
+ * of the table pointed to by parameter cs, without holders.
+ *
+ * @return The number of cursors copied.
+ */
+size_t copycursors( struct cursors * restrict cs, struct hearercursor * restrict entries );
+
+/**
+ * The restorecursors() function shall fill the empty table of cursors pointed to by parameter cs with the count cursors pointed to
+ * by parameter entries, as copycursors() copied them; those with names not valid and those past HEARER_CURSORS_MAXCOUNT are left out.
+ *
+ * @return The number of cursors restored.
+ */
+size_t restorecursors( struct cursors * restrict cs, const struct hearercursor * restrict entries, size_t count );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -0,0 +1,927 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file fulltext.c
+ *
+ * File fulltext.c contains the implementation of the fulltext.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fulltext.h"
+#include "lockstats.h"
+#include "crc32c.h"
+
+// The vector code is built with the target attribute of gcc, so the rest of the server needs no flags for it
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define FULLTEXT_X86 1
+#include <immintrin.h>
+#endif
+
+#if FULLTEXT_BLOCK_SIZE != 128
+#error "A block is four lanes of 32 postings"
+#endif
+
+// Entries of the hash table a segment starts with; a power of two
+#define FULLTEXT_INITIAL_TABLE (4096)
+
+// Words of fw_data a posting list takes once it outgrows fw_inline
+#define FULLTEXT_INITIAL_DATA (8)
+
+// Most words a twit can have: each takes a byte and the one after it, but for the last
+#define FULLTEXT_TWIT_WORDS ( ( TWIT_MAXLEN + 1 ) / 2 )
+
+/**
+ * \struct wordfound
+ *
+ * The wordfound structure is a word found in a twit or in a search, in lower case.
+ */
+struct wordfound{
+	char wf_name[ SEARCH_WORD_MAXLEN ];
+	uint32_t wf_len;
+	uint32_t wf_hash;
+};
+
+/**
+ * \struct fulltextcursor
+ *
+ * The fulltextcursor structure walks a posting list back from its end, a block at a time.
+ */
+struct fulltextcursor{
+	const struct fulltextword *cu_word;
+	const uint32_t *cu_values; /**< The postings of the block, unpacked */
+	uint32_t cu_block; /**< The block; fw_nblocks for the postings not packed */
+	uint32_t cu_count; /**< Postings of the block */
+	uint32_t cu_pos; /**< The posting the cursor is at */
+	uint32_t cu_buffer[ FULLTEXT_BLOCK_SIZE ];
+};
+
+/**
+ * The iswordbyte() function shall check whether the byte given as parameter c can be in a word.
+ *
+ * @return Nonzero if it can, zero otherwise.
+ */
+static int iswordbyte( unsigned char c );
+
+/**
+ * The findwords() function shall find up to max words in the len bytes pointed to by parameter text, store them in the array pointed
+ * to by parameter found and, if parameter toolong is not a NULL pointer, store in the object it points to whether there are runs of
+ * word bytes longer than SEARCH_WORD_MAXLEN, which are left out.
+ *
+ * @return The number of words found.
+ */
+static size_t findwords( const char * restrict text, size_t len, struct wordfound * restrict found, size_t max, int * restrict toolong );
+
+/**
+ * The newsegment() function shall allocate an empty segment whose postings are counted from the sequence number given as parameter
+ * firstseq.
+ *
+ * @return A pointer to the segment, or a NULL pointer if there is not enough memory.
+ */
+static struct fulltextsegment *newsegment( uint64_t firstseq );
+
+/**
+ * The freesegment() function shall free the segment pointed to by parameter fs and its words.
+ *
+ * @return Nothing.
+ */
+static void freesegment( struct fulltextsegment * restrict fs );
+
+/**
+ * The dropsegment() function shall take the oldest segment out of the index pointed to by parameter ft and free it, or leave it to
+ * the last search going through it to free.
+ *
+ * @return Nothing.
+ */
+static void dropsegment( struct fulltext * restrict ft );
+
+/**
+ * The findword() function shall find the entry of the hash table of the segment pointed to by parameter fs that holds the word
+ * pointed to by parameter wf, or the free one where it would go.
+ *
+ * @return The index of the entry.
+ */
+static size_t findword( const struct fulltextsegment * restrict fs, const struct wordfound * restrict wf );
+
+/**
+ * The addword() function shall add the word pointed to by parameter wf, which is not there, to the segment pointed to by parameter
+ * fs, growing its hash table if it is half full.
+ *
+ * @return A pointer to the word, or a NULL pointer if there is not enough memory.
+ */
+static struct fulltextword *addword( struct fulltextsegment * restrict fs, const struct wordfound * restrict wf );
+
+/**
+ * The addposting() function shall append the posting given as parameter posting, larger than the last one, to the list of the word
+ * pointed to by parameter fw in the segment pointed to by parameter fs, and pack the postings not packed into a block once there
+ * are FULLTEXT_BLOCK_SIZE of them.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned if there is not enough memory.
+ */
+static int addposting( struct fulltextsegment * restrict fs, struct fulltextword * restrict fw, uint32_t posting );
+
+/**
+ * The packblock() function shall pack the FULLTEXT_BLOCK_SIZE postings pointed to by parameter postings into the block pointed to
+ * by parameter out, of four words for each of the bits given as parameter bits, which shall be enough for each difference.
+ *
+ * @return Nothing.
+ */
+static void packblock( const uint32_t * restrict postings, uint32_t * restrict out, uint32_t bits );
+
+/**
+ * The unpackscalar() and unpacksse2() functions shall unpack the block of bits bits pointed to by parameter in, whose first posting
+ * is parameter first, into the FULLTEXT_BLOCK_SIZE postings pointed to by parameter out, one at a time and four at a time with SSE2.
+ *
+ * @return Nothing.
+ */
+static void unpackscalar( const uint32_t * restrict in, uint32_t bits, uint32_t first, uint32_t * restrict out );
+#if defined( FULLTEXT_X86 )
+static void unpacksse2( const uint32_t * restrict in, uint32_t bits, uint32_t first, uint32_t * restrict out ) __attribute__(( target( "sse2" ) ));
+#endif
+
+/**
+ * The startcursor() function shall set the cursor pointed to by parameter cu at the last posting of the word pointed to by
+ * parameter fw, which has at least one.
+ *
+ * @return Nothing.
+ */
+static void startcursor( struct fulltextcursor * restrict cu, const struct fulltextword * restrict fw );
+
+/**
+ * The loadblock() function shall unpack the block given as parameter block of the word of the cursor pointed to by parameter cu,
+ * fw_nblocks for the postings not packed, and leave the cursor at its first posting.
+ *
+ * @return Nothing.
+ */
+static void loadblock( struct fulltextcursor * restrict cu, uint32_t block );
+
+/**
+ * The prevcursor() function shall move the cursor pointed to by parameter cu to the posting before.
+ *
+ * @return Nonzero if there is one, zero otherwise.
+ */
+static int prevcursor( struct fulltextcursor * restrict cu );
+
+/**
+ * The seekcursor() function shall move the cursor pointed to by parameter cu back to the last posting not larger than parameter
+ * target, galloping over the blocks and then over the postings of the block.
+ *
+ * @return Nonzero if there is one, zero otherwise.
+ */
+static int seekcursor( struct fulltextcursor * restrict cu, uint32_t target );
+
+/**
+ * The searchsegment() function shall store in the array pointed to by parameter seqs, newest first, the sequence numbers of the
+ * last max twits of the segment pointed to by parameter fs that have the count words pointed to by parameter words as parameter
+ * op says.
+ *
+ * @return The number of sequence numbers stored.
+ */
+static size_t searchsegment( const struct fulltextsegment * restrict fs, enum fulltextop op, const struct wordfound * restrict words,
+	size_t count, uint64_t * restrict seqs, size_t max );
+
+// The code that unpacks the blocks, for all the searches
+static enum fulltextkind fulltextkindinuse = FULLTEXT_SCALAR;
+static void ( *unpack )( const uint32_t * restrict in, uint32_t bits, uint32_t first, uint32_t * restrict out ) = &unpackscalar;
+
+
+
+int setfulltextkind( enum fulltextkind kind ){
+	if ( kind == FULLTEXT_SCALAR ){
+		unpack = &unpackscalar;
+	}
+#if defined( FULLTEXT_X86 )
+	else if ( kind == FULLTEXT_SSE2 && ( __builtin_cpu_init(), __builtin_cpu_supports( "sse2" ) ) ){
+		unpack = &unpacksse2;
+	}
+#endif
+	else{
+		errno = ENOTSUP;
+		return ( -1 );
+	}
+	fulltextkindinuse = kind;
+
+	return ( 0 );
+}
+
+enum fulltextkind getfulltextkind( void ){
+	return ( fulltextkindinuse );
+}
+
+int initfulltext( struct fulltext * restrict ft ){
+	assert( ft != NULL );
+
+	if ( ( errno = pthread_mutex_init( &ft->ft_lock, NULL ) ) ){
+		return ( -1 );
+	}
+	ft->ft_lockedat = 0;
+	ft->ft_count = 0;
+	ft->ft_twits = 0;
+	ft->ft_words = 0;
+	ft->ft_postings = 0;
+	ft->ft_bytes = 0;
+	ft->ft_dropped = 0;
+	ft->ft_leftout = 0;
+
+	return ( 0 );
+}
+
+void delfulltext( struct fulltext * restrict ft ){
+	size_t i;
+
+	if ( ft != NULL ){
+		for ( i = 0; i < ft->ft_count; ++i ){
+			freesegment( ft->ft_segments[ i ] );
+		}
+		ft->ft_count = 0;
+		( void )pthread_mutex_destroy( &ft->ft_lock );
+	}
+
+	return ;
+}
+
+// The words are found before the lock is taken. The counts are added up for the segment and made known once for the twit
+int addtofulltext( struct fulltext * restrict ft, uint64_t seq, const char * restrict twit, size_t len ){
+	struct wordfound found[ FULLTEXT_TWIT_WORDS ];
+	struct fulltextsegment *fs = NULL;
+	struct fulltextword *fw = NULL;
+	uint64_t words;
+	uint64_t postings;
+	uint64_t bytes;
+	uint64_t leftout = 0;
+	size_t count;
+	size_t slot;
+	size_t i;
+
+	assert( ft != NULL );
+	assert( twit != NULL );
+
+	count = findwords( twit, len, found, FULLTEXT_TWIT_WORDS, NULL );
+
+	lock_mutex( LOCK_FULLTEXT, &ft->ft_lock, &ft->ft_lockedat );
+	fs = ft->ft_count > 0 ? ft->ft_segments[ ft->ft_count - 1 ] : NULL;
+	// The postings of a segment are 32 bits; should the sequence numbers skip that far, a new segment is started early
+	if ( fs == NULL || fs->fs_twits >= SEARCH_SEGMENT_TWITS || seq - fs->fs_firstseq > UINT32_MAX ){
+		if ( ( fs = newsegment( seq ) ) == NULL ){
+			( void )__atomic_fetch_add( &ft->ft_leftout, count, __ATOMIC_RELAXED );
+			unlock_mutex( LOCK_FULLTEXT, &ft->ft_lock, &ft->ft_lockedat );
+			errno = ENOMEM;
+			return ( -1 );
+		}
+		if ( ft->ft_count == SEARCH_SEGMENTS_MAXCOUNT ){
+			dropsegment( ft );
+		}
+		ft->ft_segments[ ft->ft_count++ ] = fs;
+	}
+	words = fs->fs_words;
+	postings = fs->fs_postings;
+	bytes = fs->fs_bytes;
+	for ( i = 0; i < count; ++i ){
+		slot = findword( fs, &found[ i ] );
+		if ( ( ( fw = fs->fs_table[ slot ] ) == NULL && ( fw = addword( fs, &found[ i ] ) ) == NULL ) ||
+			addposting( fs, fw, ( uint32_t )( seq - fs->fs_firstseq ) ) == -1 ){
+			++leftout;
+		}
+	}
+	++fs->fs_twits;
+	fs->fs_lastseq = seq;
+	( void )__atomic_fetch_add( &ft->ft_twits, 1, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &ft->ft_words, fs->fs_words - words, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &ft->ft_postings, fs->fs_postings - postings, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &ft->ft_bytes, fs->fs_bytes - bytes, __ATOMIC_RELAXED );
+	if ( leftout > 0 ){
+		( void )__atomic_fetch_add( &ft->ft_leftout, leftout, __ATOMIC_RELAXED );
+	}
+	unlock_mutex( LOCK_FULLTEXT, &ft->ft_lock, &ft->ft_lockedat );
+
+	if ( leftout > 0 ){
+		errno = ENOMEM;
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+// The segments of older were never searched, so those dropped are freed at once
+void mergefulltext( struct fulltext * restrict ft, struct fulltext * restrict older ){
+	struct fulltextsegment *fs = NULL;
+	size_t drop;
+	size_t kept;
+	size_t i;
+
+	assert( ft != NULL );
+	assert( older != NULL );
+
+	lock_mutex( LOCK_FULLTEXT, &ft->ft_lock, &ft->ft_lockedat );
+	drop = older->ft_count + ft->ft_count > SEARCH_SEGMENTS_MAXCOUNT ? older->ft_count + ft->ft_count - SEARCH_SEGMENTS_MAXCOUNT : 0;
+	for ( i = 0; i < older->ft_count && i < drop; ++i ){
+		freesegment( older->ft_segments[ i ] );
+		( void )__atomic_fetch_add( &ft->ft_dropped, 1, __ATOMIC_RELAXED );
+	}
+	kept = older->ft_count - i;
+	( void )memmove( ft->ft_segments + kept, ft->ft_segments, ft->ft_count * sizeof( *ft->ft_segments ) );
+	for ( i = 0; i < kept; ++i ){
+		fs = ft->ft_segments[ i ] = older->ft_segments[ older->ft_count - kept + i ];
+		( void )__atomic_fetch_add( &ft->ft_twits, fs->fs_twits, __ATOMIC_RELAXED );
+		( void )__atomic_fetch_add( &ft->ft_words, fs->fs_words, __ATOMIC_RELAXED );
+		( void )__atomic_fetch_add( &ft->ft_postings, fs->fs_postings, __ATOMIC_RELAXED );
+		( void )__atomic_fetch_add( &ft->ft_bytes, fs->fs_bytes, __ATOMIC_RELAXED );
+	}
+	ft->ft_count += kept;
+	( void )__atomic_fetch_add( &ft->ft_leftout, older->ft_leftout, __ATOMIC_RELAXED );
+	unlock_mutex( LOCK_FULLTEXT, &ft->ft_lock, &ft->ft_lockedat );
+
+	older->ft_count = 0;
+	older->ft_twits = 0;
+	older->ft_words = 0;
+	older->ft_postings = 0;
+	older->ft_bytes = 0;
+	older->ft_leftout = 0;
+
+	return ;
+}
+
+// The newest segment is searched with the lock owned; the others are sealed, so once counted as searched they are gone through
+// without it, from the newest, until enough twits are found
+ssize_t searchfulltext( struct fulltext * restrict ft, enum fulltextop op, const char * restrict words, uint64_t * restrict seqs, size_t max ){
+	struct fulltextsegment *sealed[ SEARCH_SEGMENTS_MAXCOUNT ];
+	struct wordfound found[ SEARCH_WORDS_MAXCOUNT + 1 ];
+	size_t nsealed = 0;
+	size_t total = 0;
+	size_t count;
+	size_t i;
+	int toolong;
+
+	assert( ft != NULL );
+	assert( words != NULL );
+	assert( seqs != NULL );
+
+	count = findwords( words, strlen( words ), found, SEARCH_WORDS_MAXCOUNT + 1, &toolong );
+	if ( count == 0 || count > SEARCH_WORDS_MAXCOUNT || toolong || ( op != FULLTEXT_AND && op != FULLTEXT_OR ) ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	if ( max > SEARCH_RESULTS_MAXCOUNT ){
+		max = SEARCH_RESULTS_MAXCOUNT;
+	}
+
+	lock_mutex( LOCK_FULLTEXT, &ft->ft_lock, &ft->ft_lockedat );
+	if ( ft->ft_count > 0 ){
+		total = searchsegment( ft->ft_segments[ ft->ft_count - 1 ], op, found, count, seqs, max );
+		for ( i = ft->ft_count - 1; i > 0 && total < max; --i ){
+			sealed[ nsealed ] = ft->ft_segments[ i - 1 ];
+			++sealed[ nsealed++ ]->fs_refs;
+		}
+	}
+	unlock_mutex( LOCK_FULLTEXT, &ft->ft_lock, &ft->ft_lockedat );
+
+	for ( i = 0; i < nsealed && total < max; ++i ){
+		total += searchsegment( sealed[ i ], op, found, count, seqs + total, max - total );
+	}
+
+	if ( nsealed > 0 ){
+		lock_mutex( LOCK_FULLTEXT, &ft->ft_lock, &ft->ft_lockedat );
+		for ( i = 0; i < nsealed; ++i ){
+			if ( --sealed[ i ]->fs_refs == 0 && sealed[ i ]->fs_dropped ){
+				freesegment( sealed[ i ] );
+			}
+		}
+		unlock_mutex( LOCK_FULLTEXT, &ft->ft_lock, &ft->ft_lockedat );
+	}
+
+	return ( ( ssize_t )total );
+}
+
+
+
+// Implementation of local functions...
+
+static int iswordbyte( unsigned char c ){
+	return ( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) || c >= 0x80 );
+}
+
+// A word seen twice in a twit is looked up twice; its posting is not added the second time
+static size_t findwords( const char * restrict text, size_t len, struct wordfound * restrict found, size_t max, int * restrict toolong ){
+	const unsigned char *p = ( const unsigned char * )text;
+	size_t count = 0;
+	size_t start;
+	size_t i;
+	size_t j;
+
+	if ( toolong != NULL ){
+		*toolong = 0;
+	}
+	for ( i = 0; i < len && count < max; ){
+		for ( ; i < len && !iswordbyte( p[ i ] ); ++i ){
+			continue;
+		}
+		for ( start = i; i < len && iswordbyte( p[ i ] ); ++i ){
+			continue;
+		}
+		if ( i == start ){
+			break;
+		}
+		if ( i - start > SEARCH_WORD_MAXLEN ){
+			if ( toolong != NULL ){
+				*toolong = 1;
+			}
+			continue;
+		}
+		for ( j = start; j < i; ++j ){
+			found[ count ].wf_name[ j - start ] = ( char )( p[ j ] >= 'A' && p[ j ] <= 'Z' ? p[ j ] + ( 'a' - 'A' ) : p[ j ] );
+		}
+		found[ count ].wf_len = ( uint32_t )( i - start );
+		found[ count ].wf_hash = crc32c( 0, found[ count ].wf_name, i - start );
+		++count;
+	}
+
+	return ( count );
+}
+
+static struct fulltextsegment *newsegment( uint64_t firstseq ){
+	struct fulltextsegment *fs = NULL;
+
+	if ( ( fs = malloc( sizeof( *fs ) ) ) == NULL ){
+		return ( NULL );
+	}
+	if ( ( fs->fs_table = calloc( FULLTEXT_INITIAL_TABLE, sizeof( *fs->fs_table ) ) ) == NULL ){
+		free( fs );
+		return ( NULL );
+	}
+	fs->fs_firstseq = firstseq;
+	fs->fs_lastseq = firstseq;
+	fs->fs_twits = 0;
+	fs->fs_tablesize = FULLTEXT_INITIAL_TABLE;
+	fs->fs_words = 0;
+	fs->fs_chunks = NULL;
+	fs->fs_postings = 0;
+	fs->fs_bytes = 0;
+	fs->fs_refs = 0;
+	fs->fs_dropped = 0;
+
+	return ( fs );
+}
+
+static void freesegment( struct fulltextsegment * restrict fs ){
+	struct fulltextchunk *fc = NULL;
+	struct fulltextchunk *next = NULL;
+	size_t i;
+
+	for ( fc = fs->fs_chunks; fc != NULL; fc = next ){
+		next = fc->fc_next;
+		for ( i = 0; i < fc->fc_used; ++i ){
+			free( fc->fc_words[ i ].fw_blocks );
+			free( fc->fc_words[ i ].fw_data );
+		}
+		free( fc );
+	}
+	free( fs->fs_table );
+	free( fs );
+
+	return ;
+}
+
+// Called with the lock owned
+static void dropsegment( struct fulltext * restrict ft ){
+	struct fulltextsegment *fs = ft->ft_segments[ 0 ];
+
+	( void )memmove( ft->ft_segments, ft->ft_segments + 1, ( ft->ft_count - 1 ) * sizeof( *ft->ft_segments ) );
+	--ft->ft_count;
+	( void )__atomic_fetch_sub( &ft->ft_twits, fs->fs_twits, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_sub( &ft->ft_words, fs->fs_words, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_sub( &ft->ft_postings, fs->fs_postings, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_sub( &ft->ft_bytes, fs->fs_bytes, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &ft->ft_dropped, 1, __ATOMIC_RELAXED );
+	if ( fs->fs_refs > 0 ){
+		fs->fs_dropped = 1;
+	}
+	else{
+		freesegment( fs );
+	}
+
+	return ;
+}
+
+static size_t findword( const struct fulltextsegment * restrict fs, const struct wordfound * restrict wf ){
+	const struct fulltextword *fw = NULL;
+	size_t mask = fs->fs_tablesize - 1;
+	size_t slot;
+
+	for ( slot = wf->wf_hash & mask; ( fw = fs->fs_table[ slot ] ) != NULL; slot = ( slot + 1 ) & mask ){
+		if ( fw->fw_hash == wf->wf_hash && fw->fw_len == wf->wf_len && memcmp( fw->fw_name, wf->wf_name, wf->wf_len ) == 0 ){
+			break;
+		}
+	}
+
+	return ( slot );
+}
+
+static struct fulltextword *addword( struct fulltextsegment * restrict fs, const struct wordfound * restrict wf ){
+	struct fulltextchunk *fc = fs->fs_chunks;
+	struct fulltextword **table = NULL;
+	struct fulltextword *fw = NULL;
+	size_t size;
+	size_t slot;
+	size_t i;
+
+	// The table is grown first, so the word never takes the last free entries
+	if ( 2 * ( fs->fs_words + 1 ) > fs->fs_tablesize ){
+		size = 2 * fs->fs_tablesize;
+		if ( ( table = calloc( size, sizeof( *table ) ) ) == NULL ){
+			return ( NULL );
+		}
+		for ( i = 0; i < fs->fs_tablesize; ++i ){
+			if ( fs->fs_table[ i ] != NULL ){
+				for ( slot = fs->fs_table[ i ]->fw_hash & ( size - 1 ); table[ slot ] != NULL; slot = ( slot + 1 ) & ( size - 1 ) ){
+					continue;
+				}
+				table[ slot ] = fs->fs_table[ i ];
+			}
+		}
+		free( fs->fs_table );
+		fs->fs_table = table;
+		fs->fs_tablesize = size;
+	}
+	if ( fc == NULL || fc->fc_used == sizeof( fc->fc_words ) / sizeof( fc->fc_words[ 0 ] ) ){
+		if ( ( fc = malloc( sizeof( *fc ) ) ) == NULL ){
+			return ( NULL );
+		}
+		fc->fc_next = fs->fs_chunks;
+		fc->fc_used = 0;
+		fs->fs_chunks = fc;
+	}
+	fw = &fc->fc_words[ fc->fc_used++ ];
+	( void )memcpy( fw->fw_name, wf->wf_name, wf->wf_len );
+	fw->fw_len = wf->wf_len;
+	fw->fw_hash = wf->wf_hash;
+	fw->fw_count = 0;
+	fw->fw_last = 0;
+	fw->fw_blocks = NULL;
+	fw->fw_nblocks = 0;
+	fw->fw_blockcap = 0;
+	fw->fw_data = NULL;
+	fw->fw_packed = 0;
+	fw->fw_datacap = 0;
+	fs->fs_table[ findword( fs, wf ) ] = fw;
+	++fs->fs_words;
+
+	return ( fw );
+}
+
+// The block is packed where the postings it packs were, as it never takes more words than they did
+static int addposting( struct fulltextsegment * restrict fs, struct fulltextword * restrict fw, uint32_t posting ){
+	uint32_t postings[ FULLTEXT_BLOCK_SIZE ];
+	struct fulltextblock *blocks = NULL;
+	uint32_t *data = NULL;
+	uint32_t unpacked = fw->fw_count - fw->fw_nblocks * FULLTEXT_BLOCK_SIZE;
+	uint32_t capacity;
+	uint32_t bits;
+	uint32_t diffs;
+	uint32_t i;
+
+	// The same twit again
+	if ( fw->fw_count > 0 && fw->fw_last == posting ){
+		return ( 0 );
+	}
+	if ( fw->fw_data == NULL && unpacked < FULLTEXT_INLINE_POSTINGS ){
+		fw->fw_inline[ unpacked ] = posting;
+	}
+	else{
+		if ( fw->fw_data == NULL || fw->fw_packed + unpacked == fw->fw_datacap ){
+			capacity = fw->fw_datacap == 0 ? FULLTEXT_INITIAL_DATA : 2 * fw->fw_datacap;
+			if ( ( data = realloc( fw->fw_data, capacity * sizeof( *data ) ) ) == NULL ){
+				return ( -1 );
+			}
+			if ( fw->fw_data == NULL ){
+				( void )memcpy( data, fw->fw_inline, sizeof( fw->fw_inline ) );
+			}
+			fw->fw_data = data;
+			fw->fw_datacap = capacity;
+		}
+		fw->fw_data[ fw->fw_packed + unpacked ] = posting;
+	}
+	++fw->fw_count;
+	fw->fw_last = posting;
+	++fs->fs_postings;
+	fs->fs_bytes += sizeof( posting );
+
+	// A block not packed for want of memory is packed with the next posting
+	if ( ++unpacked >= FULLTEXT_BLOCK_SIZE ){
+		if ( fw->fw_nblocks == fw->fw_blockcap ){
+			capacity = fw->fw_blockcap == 0 ? 4 : 2 * fw->fw_blockcap;
+			if ( ( blocks = realloc( fw->fw_blocks, capacity * sizeof( *blocks ) ) ) == NULL ){
+				return ( 0 );
+			}
+			fw->fw_blocks = blocks;
+			fw->fw_blockcap = capacity;
+		}
+		( void )memcpy( postings, fw->fw_data + fw->fw_packed, sizeof( postings ) );
+		for ( diffs = 0, i = 1; i < FULLTEXT_BLOCK_SIZE; ++i ){
+			diffs |= postings[ i ] - postings[ i < 4 ? 0 : i - 4 ];
+		}
+		for ( bits = 0; bits < 32 && ( diffs >> bits ) != 0; ++bits ){
+			continue;
+		}
+		packblock( postings, fw->fw_data + fw->fw_packed, bits );
+		fw->fw_blocks[ fw->fw_nblocks ].fb_first = postings[ 0 ];
+		fw->fw_blocks[ fw->fw_nblocks ].fb_last = postings[ FULLTEXT_BLOCK_SIZE - 1 ];
+		fw->fw_blocks[ fw->fw_nblocks ].fb_offset = fw->fw_packed;
+		fw->fw_blocks[ fw->fw_nblocks ].fb_bits = bits;
+		++fw->fw_nblocks;
+		fw->fw_packed += 4 * bits;
+		( void )memmove( fw->fw_data + fw->fw_packed, fw->fw_data + fw->fw_packed - 4 * bits + FULLTEXT_BLOCK_SIZE,
+			( unpacked - FULLTEXT_BLOCK_SIZE ) * sizeof( *fw->fw_data ) );
+		fs->fs_bytes = fs->fs_bytes - sizeof( postings ) + 4 * bits * sizeof( uint32_t ) + sizeof( struct fulltextblock );
+	}
+
+	return ( 0 );
+}
+
+// Difference j of lane l is at bit j * bits of the lane, whose word w is out[ 4 * w + l ]
+static void packblock( const uint32_t * restrict postings, uint32_t * restrict out, uint32_t bits ){
+	uint32_t diff;
+	uint32_t at;
+	uint32_t shift;
+	uint32_t w;
+	uint32_t i;
+
+	( void )memset( out, 0, 4 * bits * sizeof( *out ) );
+	for ( i = 0; i < FULLTEXT_BLOCK_SIZE && bits > 0; ++i ){
+		diff = postings[ i ] - postings[ i < 4 ? 0 : i - 4 ];
+		at = ( i / 4 ) * bits;
+		w = at / 32;
+		shift = at % 32;
+		out[ 4 * w + i % 4 ] |= diff << shift;
+		if ( shift + bits > 32 ){
+			out[ 4 * ( w + 1 ) + i % 4 ] |= diff >> ( 32 - shift );
+		}
+	}
+
+	return ;
+}
+
+static void unpackscalar( const uint32_t * restrict in, uint32_t bits, uint32_t first, uint32_t * restrict out ){
+	uint32_t mask = bits == 32 ? UINT32_MAX : ( ( uint32_t )1 << bits ) - 1;
+	uint32_t sums[ 4 ] = { first, first, first, first };
+	uint32_t diff;
+	uint32_t at;
+	uint32_t shift;
+	uint32_t w;
+	uint32_t j;
+	uint32_t l;
+
+	for ( j = 0; j < FULLTEXT_BLOCK_SIZE / 4; ++j ){
+		at = j * bits;
+		w = at / 32;
+		shift = at % 32;
+		for ( l = 0; l < 4; ++l ){
+			diff = bits == 0 ? 0 : in[ 4 * w + l ] >> shift;
+			if ( shift + bits > 32 ){
+				diff |= in[ 4 * ( w + 1 ) + l ] << ( 32 - shift );
+			}
+			sums[ l ] += diff & mask;
+			out[ 4 * j + l ] = sums[ l ];
+		}
+	}
+
+	return ;
+}
+
+#if defined( FULLTEXT_X86 )
+// The shifts take their count from a register, so one loop serves every width
+static void unpacksse2( const uint32_t * restrict in, uint32_t bits, uint32_t first, uint32_t * restrict out ){
+	__m128i mask = _mm_set1_epi32( ( int )( bits == 32 ? UINT32_MAX : ( ( uint32_t )1 << bits ) - 1 ) );
+	__m128i sums = _mm_set1_epi32( ( int )first );
+	__m128i diffs;
+	uint32_t at;
+	uint32_t shift;
+	uint32_t w;
+	uint32_t j;
+
+	for ( j = 0; j < FULLTEXT_BLOCK_SIZE / 4; ++j ){
+		at = j * bits;
+		w = at / 32;
+		shift = at % 32;
+		diffs = bits == 0 ? _mm_setzero_si128() :
+			_mm_srl_epi32( _mm_loadu_si128( ( const __m128i * )( in + 4 * w ) ), _mm_cvtsi32_si128( ( int )shift ) );
+		if ( shift + bits > 32 ){
+			diffs = _mm_or_si128( diffs, _mm_sll_epi32( _mm_loadu_si128( ( const __m128i * )( in + 4 * ( w + 1 ) ) ),
+				_mm_cvtsi32_si128( ( int )( 32 - shift ) ) ) );
+		}
+		sums = _mm_add_epi32( sums, _mm_and_si128( diffs, mask ) );
+		_mm_storeu_si128( ( __m128i * )( out + 4 * j ), sums );
+	}
+
+	return ;
+}
+#endif
+
+static void startcursor( struct fulltextcursor * restrict cu, const struct fulltextword * restrict fw ){
+	cu->cu_word = fw;
+	loadblock( cu, fw->fw_count > fw->fw_nblocks * FULLTEXT_BLOCK_SIZE ? fw->fw_nblocks : fw->fw_nblocks - 1 );
+	cu->cu_pos = cu->cu_count - 1;
+
+	return ;
+}
+
+static void loadblock( struct fulltextcursor * restrict cu, uint32_t block ){
+	const struct fulltextword *fw = cu->cu_word;
+	const uint32_t *data = fw->fw_data != NULL ? fw->fw_data : fw->fw_inline;
+
+	if ( block == fw->fw_nblocks ){
+		cu->cu_values = data + fw->fw_packed;
+		cu->cu_count = fw->fw_count - fw->fw_nblocks * FULLTEXT_BLOCK_SIZE;
+	}
+	else{
+		( *unpack )( data + fw->fw_blocks[ block ].fb_offset, fw->fw_blocks[ block ].fb_bits, fw->fw_blocks[ block ].fb_first,
+			cu->cu_buffer );
+		cu->cu_values = cu->cu_buffer;
+		cu->cu_count = FULLTEXT_BLOCK_SIZE;
+	}
+	cu->cu_block = block;
+	cu->cu_pos = 0;
+
+	return ;
+}
+
+static int prevcursor( struct fulltextcursor * restrict cu ){
+	if ( cu->cu_pos > 0 ){
+		--cu->cu_pos;
+		return ( 1 );
+	}
+	if ( cu->cu_block == 0 ){
+		return ( 0 );
+	}
+	loadblock( cu, cu->cu_block - 1 );
+	cu->cu_pos = cu->cu_count - 1;
+
+	return ( 1 );
+}
+
+// Each gallop doubles its step back from where the cursor is, then the binary search closes in between the last two steps. The
+// blocks before the one of the cursor are all packed
+static int seekcursor( struct fulltextcursor * restrict cu, uint32_t target ){
+	const struct fulltextblock *blocks = cu->cu_word->fw_blocks;
+	uint32_t step;
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t mid;
+
+	if ( cu->cu_values[ cu->cu_pos ] <= target ){
+		return ( 1 );
+	}
+	if ( cu->cu_values[ 0 ] > target ){
+		for ( hi = cu->cu_block, step = 1; step <= hi && blocks[ hi - step ].fb_first > target; step *= 2 ){
+			hi -= step;
+		}
+		if ( step <= hi ){
+			lo = hi - step;
+		}
+		else if ( hi > 0 && blocks[ 0 ].fb_first <= target ){
+			lo = 0;
+		}
+		else{
+			return ( 0 );
+		}
+		while ( hi - lo > 1 ){
+			mid = lo + ( hi - lo ) / 2;
+			if ( blocks[ mid ].fb_first <= target ){
+				lo = mid;
+			}
+			else{
+				hi = mid;
+			}
+		}
+		loadblock( cu, lo );
+		cu->cu_pos = cu->cu_count - 1;
+		if ( cu->cu_values[ cu->cu_pos ] <= target ){
+			return ( 1 );
+		}
+	}
+	// The first posting of the block is not larger than target
+	for ( hi = cu->cu_pos, step = 1; step <= hi && cu->cu_values[ hi - step ] > target; step *= 2 ){
+		hi -= step;
+	}
+	lo = step <= hi ? hi - step : 0;
+	while ( hi - lo > 1 ){
+		mid = lo + ( hi - lo ) / 2;
+		if ( cu->cu_values[ mid ] <= target ){
+			lo = mid;
+		}
+		else{
+			hi = mid;
+		}
+	}
+	cu->cu_pos = lo;
+
+	return ( 1 );
+}
+
+// With all of the words the lists are intersected from the one with the fewest postings: the others skip back to its posting and a
+// list that has none there gives the posting to skip back to next. With any of them the lists are merged from their ends
+static size_t searchsegment( const struct fulltextsegment * restrict fs, enum fulltextop op, const struct wordfound * restrict words,
+	size_t count, uint64_t * restrict seqs, size_t max ){
+	struct fulltextcursor cursors[ SEARCH_WORDS_MAXCOUNT ];
+	const struct fulltextword *fws[ SEARCH_WORDS_MAXCOUNT ];
+	const struct fulltextword *fw = NULL;
+	int active[ SEARCH_WORDS_MAXCOUNT ];
+	size_t found = 0;
+	size_t n = 0;
+	size_t i;
+	size_t j;
+	uint32_t target;
+	uint32_t value;
+	int any;
+
+	for ( i = 0; i < count; ++i ){
+		if ( ( fw = fs->fs_table[ findword( fs, &words[ i ] ) ] ) == NULL ){
+			if ( op == FULLTEXT_AND ){
+				return ( 0 );
+			}
+			continue;
+		}
+		// By the number of postings, so the rarest word leads
+		for ( j = n++; j > 0 && fws[ j - 1 ]->fw_count > fw->fw_count; --j ){
+			fws[ j ] = fws[ j - 1 ];
+		}
+		fws[ j ] = fw;
+	}
+	if ( n == 0 || max == 0 ){
+		return ( 0 );
+	}
+	for ( i = 0; i < n; ++i ){
+		startcursor( &cursors[ i ], fws[ i ] );
+		active[ i ] = 1;
+	}
+
+	if ( op == FULLTEXT_AND ){
+		target = cursors[ 0 ].cu_values[ cursors[ 0 ].cu_pos ];
+		while ( found < max ){
+			for ( i = 0; i < n; ++i ){
+				if ( !seekcursor( &cursors[ i ], target ) ){
+					return ( found );
+				}
+				if ( ( value = cursors[ i ].cu_values[ cursors[ i ].cu_pos ] ) < target ){
+					break;
+				}
+			}
+			if ( i < n ){
+				target = value;
+				continue;
+			}
+			seqs[ found++ ] = fs->fs_firstseq + target;
+			if ( !prevcursor( &cursors[ 0 ] ) ){
+				break;
+			}
+			target = cursors[ 0 ].cu_values[ cursors[ 0 ].cu_pos ];
+		}
+	}
+	else{
+		while ( found < max ){
+			for ( any = 0, target = 0, i = 0; i < n; ++i ){
+				if ( active[ i ] && ( !any || cursors[ i ].cu_values[ cursors[ i ].cu_pos ] > target ) ){
+					target = cursors[ i ].cu_values[ cursors[ i ].cu_pos ];
+					any = 1;
+				}
+			}
+			if ( !any ){
+				break;
+			}
+			seqs[ found++ ] = fs->fs_firstseq + target;
+			for ( i = 0; i < n; ++i ){
+				if ( active[ i ] && cursors[ i ].cu_values[ cursors[ i ].cu_pos ] == target ){
+					active[ i ] = prevcursor( &cursors[ i ] );
+				}
+			}
+		}
+	}
+
+	return ( found );
+}
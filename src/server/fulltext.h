@@ -0,0 +1,246 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file fulltext.h
+ *
+ * File fulltext.h declares the full-text index of the twits, with which the clients of SEARCH_PORT find the last twits with some
+ * words in them (see searchframe.h). A word is a run of 1 to SEARCH_WORD_MAXLEN letters, digits or bytes above 127, so that the
+ * letters of UTF-8 stay in their words; the case of the ASCII letters does not matter. Longer runs are not indexed.
+ *
+ * The consumer adds each twit as it logs it, so the index is built as the twits come and is never built again. It is cut into
+ * segments of SEARCH_SEGMENT_TWITS twits; twits are added to the newest, and once it is full it is sealed, never changes again and
+ * a new one is started. The newest SEARCH_SEGMENTS_MAXCOUNT segments are kept, so the index goes back as far as the recent history
+ * and well into the segments of the twit log, and takes a bounded amount of memory. A segment has a hash table from each word of
+ * its twits to the posting list of the word: the twits with it, as the differences of their sequence numbers from the first twit
+ * of the segment, in order. The last postings of a list are kept as they are; every FULLTEXT_BLOCK_SIZE of them are packed into a
+ * block, with the first and the last of them kept apart so that blocks can be skipped. A block holds the difference of each
+ * posting from the fourth one before it, the first four from the first posting, in as many bits as the largest needs, laid out
+ * in four lanes of 32 bits: posting i is in lane i % 4, so the postings of a block are unpacked four at a time with SSE2 and their
+ * differences added up with four additions at once.
+ *
+ * A search for some words (FULLTEXT_AND) or for any of them (FULLTEXT_OR) goes through the segments from the newest, and through
+ * the posting lists from their ends, so it stops as soon as it has found as many twits as it wants. The lists of the words are
+ * intersected from the one with the fewest postings, each of the others skipping back to the posting that is not after the twit
+ * sought: a galloping search over its blocks, then over the postings of the one found, so most blocks are never unpacked.
+ *
+ * The index is guarded by ft_lock. A search looks the newest segment up with the lock owned, and only takes the others, which are
+ * sealed, from under it, so it never holds up the consumer for more than the one segment. A sealed segment dropped while a
+ * search goes through it is freed by that search.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( FULLTEXT_H_IS_INCLUDED )
+#define FULLTEXT_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "config.h"
+
+// The postings packed together
+#define FULLTEXT_BLOCK_SIZE (128)
+
+// The postings a list keeps in its structure before it needs storage of its own
+#define FULLTEXT_INLINE_POSTINGS (2)
+
+/**
+ * \enum fulltextkind
+ *
+ * The fulltextkind enumeration names the code that unpacks the blocks of the posting lists.
+ */
+enum fulltextkind{
+	FULLTEXT_SCALAR, /**< One posting at a time */
+	FULLTEXT_SSE2 /**< Four postings at a time */
+};
+
+/**
+ * \enum fulltextop
+ *
+ * The fulltextop enumeration names how the words of a search are combined.
+ */
+enum fulltextop{
+	FULLTEXT_AND, /**< The twits with all of the words */
+	FULLTEXT_OR /**< The twits with any of them */
+};
+
+/**
+ * \struct fulltextblock
+ *
+ * The fulltextblock structure locates a block of FULLTEXT_BLOCK_SIZE postings of a posting list.
+ */
+struct fulltextblock{
+	uint32_t fb_first; /**< The first posting */
+	uint32_t fb_last; /**< The last posting */
+	uint32_t fb_offset; /**< Where the block starts in fw_data, in words of 32 bits */
+	uint32_t fb_bits; /**< Bits of each difference; the block takes four words for each */
+};
+
+/**
+ * \struct fulltextword
+ *
+ * The fulltextword structure is a word of the twits of a segment, with its posting list.
+ */
+struct fulltextword{
+	char fw_name[ SEARCH_WORD_MAXLEN ]; /**< In lower case; not nul-terminated */
+	uint32_t fw_len;
+	uint32_t fw_hash;
+	uint32_t fw_count; /**< Postings of the list */
+	uint32_t fw_last; /**< The last posting */
+	struct fulltextblock *fw_blocks; /**< The blocks, oldest first */
+	uint32_t fw_nblocks;
+	uint32_t fw_blockcap;
+	uint32_t *fw_data; /**< The blocks, then the fw_count - fw_nblocks * FULLTEXT_BLOCK_SIZE postings not packed; fw_inline if NULL */
+	uint32_t fw_packed; /**< Words of fw_data the blocks take */
+	uint32_t fw_datacap; /**< Words of fw_data */
+	uint32_t fw_inline[ FULLTEXT_INLINE_POSTINGS ];
+};
+
+/**
+ * \struct fulltextchunk
+ *
+ * The fulltextchunk structure holds the words of a segment, many to an allocation.
+ */
+struct fulltextchunk{
+	struct fulltextchunk *fc_next;
+	size_t fc_used;
+	struct fulltextword fc_words[ 1024 ];
+};
+
+/**
+ * \struct fulltextsegment
+ *
+ * The fulltextsegment structure is a segment of the index.
+ */
+struct fulltextsegment{
+	uint64_t fs_firstseq; /**< Sequence number of its first twit, from which the postings are counted */
+	uint64_t fs_lastseq; /**< Sequence number of its last twit */
+	uint64_t fs_twits; /**< Twits added to it */
+	struct fulltextword **fs_table; /**< Open addressed with linear probing; NULL if free */
+	size_t fs_tablesize; /**< A power of two, at least twice fs_words */
+	size_t fs_words; /**< Words in the table */
+	struct fulltextchunk *fs_chunks; /**< The newest first */
+	uint64_t fs_postings;
+	uint64_t fs_bytes; /**< Bytes of the posting lists, blocks and postings not packed, and of the blocks that locate them */
+	int fs_refs; /**< Searches going through it without the lock */
+	int fs_dropped; /**< Whether it was dropped while searched; the last search to leave frees it */
+};
+
+/**
+ * \struct fulltext
+ *
+ * The fulltext structure is the index. The counts are updated atomically, so the statistics read them without the lock.
+ */
+struct fulltext{
+	pthread_mutex_t ft_lock;
+	uint64_t ft_lockedat;
+	struct fulltextsegment *ft_segments[ SEARCH_SEGMENTS_MAXCOUNT ]; /**< Oldest first; twits go to the last */
+	size_t ft_count;
+	uint64_t ft_twits; /**< Twits in the segments kept */
+	uint64_t ft_words; /**< Words in their tables */
+	uint64_t ft_postings;
+	uint64_t ft_bytes;
+	uint64_t ft_dropped; /**< Segments dropped */
+	uint64_t ft_leftout; /**< Postings not added for lack of storage */
+};
+
+
+
+/**
+ * The setfulltextkind() function shall make the searches unpack the blocks with the code named by parameter kind, if the processor
+ * has it. It shall be called before the index is searched.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception ENOTSUP The processor does not have the instructions of the code.
+ */
+int setfulltextkind( enum fulltextkind kind );
+
+/**
+ * The getfulltextkind() function shall return the code the blocks are unpacked with.
+ *
+ * @return The kind of the code.
+ */
+enum fulltextkind getfulltextkind( void );
+
+/**
+ * The initfulltext() function shall initialize the empty index pointed to by parameter ft.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate
+ *	the error.
+ * @exception ENOMEM There is not enough memory.
+ */
+int initfulltext( struct fulltext * restrict ft );
+
+/**
+ * The delfulltext() function shall free the memory of the index pointed to by parameter ft. No search shall be going through it.
+ *
+ * @return Nothing.
+ */
+void delfulltext( struct fulltext * restrict ft );
+
+/**
+ * The addtofulltext() function shall add the twit of len bytes pointed to by parameter twit, with the sequence number given as
+ * parameter seq, to the index pointed to by parameter ft, starting a new segment, and dropping the oldest if there are
+ * SEARCH_SEGMENTS_MAXCOUNT, when the newest is full. The twits shall be added in the order of their sequence numbers.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the
+ *	error, the twit being added under the words there was storage for.
+ * @exception ENOMEM Insufficient storage space for a segment, a word or a posting list.
+ */
+int addtofulltext( struct fulltext * restrict ft, uint64_t seq, const char * restrict twit, size_t len );
+
+/**
+ * The mergefulltext() function shall move the segments of the index pointed to by parameter older, whose twits shall all have
+ * sequence numbers below those of the index pointed to by parameter ft, in front of the segments of ft, dropping the oldest while
+ * there are more than SEARCH_SEGMENTS_MAXCOUNT. Nobody else shall use older, which is left empty.
+ *
+ * @return Nothing.
+ */
+void mergefulltext( struct fulltext * restrict ft, struct fulltext * restrict older );
+
+/**
+ * The searchfulltext() function shall store in the array pointed to by parameter seqs, newest first, the sequence numbers of the
+ * last max twits, at most SEARCH_RESULTS_MAXCOUNT, in the index pointed to by parameter ft that have all the words (FULLTEXT_AND)
+ * or any of the words (FULLTEXT_OR), as parameter op says, of the string pointed to by parameter words. The words are found in the
+ * string as in the twits; there shall be 1 to SEARCH_WORDS_MAXCOUNT of them, none longer than SEARCH_WORD_MAXLEN. A word repeated
+ * counts once.
+ *
+ * @return Upon successful completion the number of sequence numbers stored shall be returned; otherwise, -1 shall be returned and
+ *	errno shall be set to indicate the error.
+ * @exception EINVAL The words are not valid.
+ */
+ssize_t searchfulltext( struct fulltext * restrict ft, enum fulltextop op, const char * restrict words, uint64_t * restrict seqs, size_t max );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -0,0 +1,689 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file handoff.c
+ *
+ * File handoff.c contains the implementation of the handoff.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "serverinfo.h"
+#include "handoff.h"
+#include "listen.h"
+#include "lockstats.h"
+#include "twitpoollist.h"
+#include "cursors.h"
+#include "timing.h"
+#include "config.h"
+#include "util.h"
+#include "error.h"
+
+#define HANDOFF_MAGIC (0x4f485754u) /**< "TWHO" */
+#define HANDOFF_VERSION (8)
+
+// How often the server handing over looks again at what it waits for
+#define HANDOFF_POLL_MSEC (10)
+
+/**
+ * \enum handoffkind
+ *
+ * The handoffkind enumeration names the messages exchanged by the two servers.
+ */
+enum handoffkind{
+	HANDOFF_REQUEST, /**< The new server asks to take over */
+	HANDOFF_LISTENERS, /**< The old server sends the LISTENERS listening sockets, in the order of enum listenername */
+	HANDOFF_HEARER, /**< The old server sends the connection of a hearer */
+	HANDOFF_ACCEPTED, /**< The new server took the hearer just sent */
+	HANDOFF_REJECTED, /**< The new server has no room for the hearer just sent and closed it */
+	HANDOFF_FINISHED /**< The old server closed the twit log */
+};
+
+/**
+ * \struct handoffmessage
+ *
+ * The handoffmessage structure is a message exchanged by the two servers; the descriptors go along with it.
+ */
+struct handoffmessage{
+	uint32_t hm_magic;
+	uint32_t hm_version;
+	uint32_t hm_kind; /**< One of enum handoffkind */
+	int32_t hm_resume; /**< HANDOFF_HEARER: whether the hearer is sent frames */
+	uint64_t hm_pid; /**< HANDOFF_REQUEST, HANDOFF_LISTENERS: the process sending */
+	uint64_t hm_nextseq; /**< HANDOFF_FINISHED: the next sequence number */
+	uint64_t hm_drain_ns; /**< HANDOFF_FINISHED: how long the hand-over took */
+	uint64_t hm_leftout; /**< HANDOFF_FINISHED: twits of the sayers cut off */
+	uint64_t hm_dropped; /**< HANDOFF_FINISHED: hearers not handed over */
+	char hm_cursor[ CURSOR_NAME_MAXLEN + 1 ]; /**< HANDOFF_HEARER: the name of the cursor of the hearer; empty if none */
+	char hm_topics[ TOPICFRAME_REQUEST_MAXLEN ]; /**< HANDOFF_HEARER: the names of the topics of the hearer; empty for the global one */
+	char hm_keywords[ TOPICFRAME_REQUEST_MAXLEN ]; /**< HANDOFF_HEARER: its keywords; empty if it has none */
+	char hm_regexes[ TOPICFRAME_REQUEST_MAXLEN ]; /**< HANDOFF_HEARER: its regular expressions; empty if it has none */
+	char hm_tags[ TOPICFRAME_REQUEST_MAXLEN ]; /**< HANDOFF_HEARER: its hashtags and mentions; empty if it has none */
+};
+
+/**
+ * The handoffaddress() function shall set the object pointed to by parameter addr to the address of HANDOFF_SOCKET.
+ *
+ * @return Nothing.
+ */
+static void handoffaddress( struct sockaddr_un * restrict addr );
+
+/**
+ * The prepareHandoffSocket() function shall create the socket listening on HANDOFF_SOCKET.
+ *
+ * @return Upon successful completion the socket created shall be returned; otherwise, -1 shall be returned and errno shall be set
+ * 	to indicate the error.
+ */
+static int prepareHandoffSocket( void );
+
+/**
+ * The sendhandoff() function shall send to the socket given as parameter sockfd the message pointed to by parameter hm, of the kind
+ * given as parameter, with the count descriptors pointed to by parameter fds; count shall not be larger than LISTENERS.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ */
+static int sendhandoff( int sockfd, struct handoffmessage * restrict hm, enum handoffkind kind, const int * restrict fds, size_t count );
+
+/**
+ * The recvhandoff() function shall receive from the socket given as parameter sockfd a message into the object pointed to by
+ * parameter hm, store up to maxcount descriptors that came with it in the array pointed to by parameter fds and their number in
+ * the object pointed to by parameter count, if that is not a NULL pointer. The descriptors beyond maxcount are closed, and all of
+ * them if the message is not one of a server.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception ECONNRESET The other server closed the connection.
+ * @exception EPROTO The message is not one of a server.
+ * Any error of recvmsg().
+ */
+static int recvhandoff( int sockfd, struct handoffmessage * restrict hm, int * restrict fds, size_t maxcount, size_t * restrict count );
+
+/**
+ * The handover() function shall hand the server whose struct serverinfo is pointed to by parameter si over to the server of process
+ * pid connected at the socket given as parameter sockfd, as handoff.h describes.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned, errno shall be set to indicate the error
+ * 	and the server goes on as if nobody asked.
+ */
+static int handover( struct serverinfo * restrict si, int sockfd, uint64_t pid );
+
+/**
+ * The connectedsayers() and connectedhearers() functions shall return the number of sayers and hearers connected to the server whose
+ * struct serverinfo is pointed to by parameter si.
+ *
+ * @return The number of sayers or hearers.
+ */
+static int connectedsayers( struct serverinfo * restrict si );
+static int connectedhearers( struct serverinfo * restrict si );
+
+/**
+ * The broadcastseq() function shall return si_broadcastseq of the struct serverinfo object pointed to by parameter si.
+ *
+ * @return The sequence number of the last twit put in the twitpools of the hearers.
+ */
+static uint64_t broadcastseq( struct serverinfo * restrict si );
+
+/**
+ * The pausedrain() function shall sleep for HANDOFF_POLL_MSEC milliseconds.
+ *
+ * @return Nothing.
+ */
+static void pausedrain( void );
+
+/**
+ * The cleanupHandoffListener() function is responsible for cleaning up the resources associated with the handoffListener thread.
+ * The cleanupHandoffListener() function shall receive as argument a pointer to the listening socket.
+ *
+ * @return Nothing.
+ */
+static void cleanupHandoffListener( void *arg );
+
+
+
+void inithandoff( struct handoff * restrict ho ){
+	assert( ho != NULL );
+
+	while ( pthread_mutex_init( &ho->ho_lock, NULL ) ){ continue; }
+	ho->ho_state = HANDOFF_NONE;
+	ho->ho_sockfd = -1;
+	ho->ho_pid = 0;
+	ho->ho_started = 0;
+	ho->ho_drain_ns = 0;
+	ho->ho_paused_ns = 0;
+	ho->ho_leftout = 0;
+	ho->ho_handed = 0;
+	ho->ho_dropped = 0;
+	ho->ho_nextseq = 0;
+	ho->ho_hearercount = 0;
+
+	return ;
+}
+
+void delhandoff( struct handoff * restrict ho ){
+	assert( ho != NULL );
+
+	( void )pthread_mutex_destroy( &ho->ho_lock );
+
+	return ;
+}
+
+// The hearers come as they are handed over, each answered, then the word that the twit log is closed. A server that goes away first
+// leaves its twit log to be recovered as after a crash, which is also safe; one that hangs still holds it
+int takeover( struct serverinfo * restrict si ){
+	struct handoff *ho = NULL;
+	struct handedhearer *hh = NULL;
+	struct handoffmessage hm;
+	struct sockaddr_un addr;
+	struct timeval timeout;
+	size_t count;
+	size_t i;
+	int sockfd;
+	int fd;
+	int finished = 0;
+	int saved_errno;
+
+	assert( si != NULL );
+
+	ho = &si->si_handoff;
+	if ( ( sockfd = socket( AF_UNIX, SOCK_SEQPACKET, 0 ) ) == -1 ){
+		return ( -1 );
+	}
+	handoffaddress( &addr );
+	( void )memset( &timeout, 0, sizeof( timeout ) );
+	timeout.tv_sec = ( time_t )HANDOFF_WAIT_SEC;
+	( void )setsockopt( sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+	( void )memset( &hm, 0, sizeof( hm ) );
+	hm.hm_pid = ( uint64_t )getpid();
+	if ( connect( sockfd, ( struct sockaddr * )&addr, sizeof( addr ) ) == -1 || sendhandoff( sockfd, &hm, HANDOFF_REQUEST, NULL, 0 ) == -1 ||
+		recvhandoff( sockfd, &hm, si->si_listenfds, LISTENERS, &count ) == -1 ){
+		saved_errno = ( errno == EAGAIN || errno == EWOULDBLOCK ) ? ETIMEDOUT : errno;
+		( void )safe_close( sockfd );
+		errno = saved_errno;
+		return ( -1 );
+	}
+	if ( hm.hm_kind != HANDOFF_LISTENERS || count != LISTENERS ){
+		for ( i = 0; i < count; ++i ){
+			( void )safe_close( si->si_listenfds[ i ] );
+			si->si_listenfds[ i ] = -1;
+		}
+		( void )safe_close( sockfd );
+		errno = EPROTO;
+		return ( -1 );
+	}
+	// The old server stopped accepting before it sent the sockets
+	ho->ho_started = monotonic_ns();
+	ho->ho_pid = hm.hm_pid;
+
+	while ( recvhandoff( sockfd, &hm, &fd, 1, &count ) == 0 ){
+		if ( hm.hm_kind == HANDOFF_FINISHED ){
+			ho->ho_nextseq = hm.hm_nextseq;
+			ho->ho_drain_ns = hm.hm_drain_ns;
+			ho->ho_leftout = hm.hm_leftout;
+			ho->ho_dropped = hm.hm_dropped;
+			finished = 1;
+			break;
+		}
+		if ( hm.hm_kind != HANDOFF_HEARER ){
+			if ( count == 1 ){
+				( void )safe_close( fd );
+			}
+			continue;
+		}
+		// The old server counts the hearer as handed over or dropped by the answer
+		if ( count == 1 && ho->ho_hearercount < HEARERS_MAXCOUNT ){
+			hh = &ho->ho_hearers[ ho->ho_hearercount++ ];
+			hh->hh_sockfd = fd;
+			hh->hh_resume = hm.hm_resume;
+			( void )strcpy( hh->hh_cursor, hm.hm_cursor );
+			( void )strcpy( hh->hh_topics, hm.hm_topics );
+			( void )strcpy( hh->hh_keywords, hm.hm_keywords );
+			( void )strcpy( hh->hh_regexes, hm.hm_regexes );
+			( void )strcpy( hh->hh_tags, hm.hm_tags );
+			( void )memset( &hm, 0, sizeof( hm ) );
+			( void )sendhandoff( sockfd, &hm, HANDOFF_ACCEPTED, NULL, 0 );
+		}
+		else{
+			if ( count == 1 ){
+				( void )safe_close( fd );
+			}
+			( void )memset( &hm, 0, sizeof( hm ) );
+			( void )sendhandoff( sockfd, &hm, HANDOFF_REJECTED, NULL, 0 );
+		}
+	}
+	// An old server that sent nothing for HANDOFF_WAIT_SEC seconds is hung with the twit log open; nothing it sent is kept
+	if ( !finished && ( errno == EAGAIN || errno == EWOULDBLOCK ) ){
+		for ( i = 0; i < LISTENERS; ++i ){
+			( void )safe_close( si->si_listenfds[ i ] );
+			si->si_listenfds[ i ] = -1;
+		}
+		for ( i = 0; i < ho->ho_hearercount; ++i ){
+			( void )safe_close( ho->ho_hearers[ i ].hh_sockfd );
+		}
+		ho->ho_hearercount = 0;
+		( void )safe_close( sockfd );
+		errno = ETIMEDOUT;
+		return ( -1 );
+	}
+	ho->ho_handed = ho->ho_hearercount;
+	( void )safe_close( sockfd );
+
+	return ( 0 );
+}
+
+// The hearers take turns on the connection; the name of a cursor held does not change
+int handoffhearer( struct connserverinfo * restrict csi ){
+	struct serverinfo *si = NULL;
+	struct handoff *ho = NULL;
+	struct handoffmessage hm;
+	int status;
+
+	assert( csi != NULL );
+
+	si = csi->csi_serverinfo;
+	ho = &si->si_handoff;
+	( void )memset( &hm, 0, sizeof( hm ) );
+	hm.hm_resume = csi->csi_resume;
+	if ( csi->csi_cursor != -1 ){
+		( void )strcpy( hm.hm_cursor, si->si_cursors.cs_cursors[ csi->csi_cursor ].hc_name );
+	}
+	( void )strcpy( hm.hm_topics, csi->csi_topics );
+	( void )strcpy( hm.hm_keywords, csi->csi_keywords );
+	( void )strcpy( hm.hm_regexes, csi->csi_regexes );
+	( void )strcpy( hm.hm_tags, csi->csi_tags );
+
+	lock_mutex( LOCK_HANDOFF, &ho->ho_lock, &ho->ho_lockedat );
+	if ( ( status = sendhandoff( ho->ho_sockfd, &hm, HANDOFF_HEARER, &csi->csi_sockfd, 1 ) ) == 0 &&
+		( status = recvhandoff( ho->ho_sockfd, &hm, NULL, 0, NULL ) ) == 0 ){
+		if ( hm.hm_kind == HANDOFF_ACCEPTED ){
+			++ho->ho_handed;
+			csi->csi_handoff = 1;
+		}
+		else{
+			++ho->ho_dropped;
+			errno = ECONNREFUSED;
+			status = -1;
+		}
+	}
+	unlock_mutex( LOCK_HANDOFF, &ho->ho_lock, &ho->ho_lockedat );
+
+	return ( status );
+}
+
+int finishhandoff( struct serverinfo * restrict si, uint64_t nextseq ){
+	struct handoff *ho = NULL;
+	struct handoffmessage hm;
+	int status;
+	int saved_errno;
+
+	assert( si != NULL );
+
+	ho = &si->si_handoff;
+	assert( ho->ho_sockfd != -1 );
+	( void )memset( &hm, 0, sizeof( hm ) );
+	hm.hm_nextseq = nextseq;
+	hm.hm_drain_ns = ho->ho_drain_ns;
+	hm.hm_leftout = __atomic_load_n( &ho->ho_leftout, __ATOMIC_RELAXED );
+	hm.hm_dropped = ho->ho_dropped;
+	status = sendhandoff( ho->ho_sockfd, &hm, HANDOFF_FINISHED, NULL, 0 );
+	saved_errno = errno;
+	( void )safe_close( ho->ho_sockfd );
+	ho->ho_sockfd = -1;
+	errno = saved_errno;
+
+	return ( status );
+}
+
+/**
+ * handoffListener() serves one server that takes over; one that does not ask properly is not taken for one.
+ * The connection is left open for the hearers and for finishhandoff(), which the main thread calls once the twit log is closed.
+ */
+void *handoffListener( void *arg ){
+	struct serverinfo *si = ( struct serverinfo * )arg;
+	struct handoffmessage hm;
+	struct timeval timeout;
+	int sockfd = -1;
+	int connsockfd;
+
+	assert( si != NULL );
+
+	pthread_cleanup_push( &cleanupHandoffListener, &sockfd );
+	if ( ( sockfd = prepareHandoffSocket() ) == -1 ){
+		error( "Failed to listen on %s (%s); the server cannot be restarted in its place.\n", HANDOFF_SOCKET, strerror( errno ) );
+		pthread_exit( NULL );
+	}
+
+	( void )memset( &timeout, 0, sizeof( timeout ) );
+	timeout.tv_sec = ( time_t )HANDOFF_DRAIN_SEC;
+	while ( 1 ){
+		if ( ( connsockfd = accept( sockfd, NULL, NULL ) ) == -1 ){
+			if ( errno != EINTR ){
+				error( "accept() failed in handoffListener() (%s)\n", strerror( errno ) );
+			}
+			continue;
+		}
+		( void )setsockopt( connsockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+		if ( recvhandoff( connsockfd, &hm, NULL, 0, NULL ) == 0 && hm.hm_kind == HANDOFF_REQUEST ){
+			if ( handover( si, connsockfd, hm.hm_pid ) == 0 ){
+				break;
+			}
+			error( "Failed to hand the server over to process %llu (%s).\n", ( unsigned long long )hm.hm_pid, strerror( errno ) );
+		}
+		( void )safe_close( connsockfd );
+	}
+
+	// The main thread terminates the server
+	( void )kill( getpid(), SIGUSR1 );
+
+	pthread_cleanup_pop( 1 );
+
+	pthread_exit( NULL );
+}
+
+
+
+// Implementation of local functions...
+
+static void handoffaddress( struct sockaddr_un * restrict addr ){
+	assert( addr != NULL );
+
+	( void )memset( addr, 0, sizeof( *addr ) );
+	addr->sun_family = AF_UNIX;
+	( void )strncpy( addr->sun_path, HANDOFF_SOCKET, sizeof( addr->sun_path ) - 1 );
+
+	return ;
+}
+
+// A socket left behind by a server that crashed is in the way; a server still running would have kept this one off its ports
+static int prepareHandoffSocket( void ){
+	struct sockaddr_un addr;
+	int sockfd;
+	int saved_errno;
+
+	if ( ( sockfd = socket( AF_UNIX, SOCK_SEQPACKET, 0 ) ) == -1 ){
+		return ( -1 );
+	}
+	handoffaddress( &addr );
+	( void )unlink( HANDOFF_SOCKET );
+	if ( bind( sockfd, ( struct sockaddr * )&addr, sizeof( addr ) ) == -1 || listen( sockfd, 1 ) == -1 ){
+		saved_errno = errno;
+		( void )safe_close( sockfd );
+		errno = saved_errno;
+		return ( -1 );
+	}
+
+	return ( sockfd );
+}
+
+static int sendhandoff( int sockfd, struct handoffmessage * restrict hm, enum handoffkind kind, const int * restrict fds, size_t count ){
+	union{
+		struct cmsghdr cm;
+		char buf[ CMSG_SPACE( sizeof( int ) * LISTENERS ) ];
+	} control;
+	struct cmsghdr *cmsg = NULL;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t nsent;
+
+	assert( hm != NULL );
+	assert( count <= LISTENERS );
+
+	hm->hm_magic = HANDOFF_MAGIC;
+	hm->hm_version = HANDOFF_VERSION;
+	hm->hm_kind = ( uint32_t )kind;
+	iov.iov_base = hm;
+	iov.iov_len = sizeof( *hm );
+	( void )memset( &msg, 0, sizeof( msg ) );
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if ( count > 0 ){
+		( void )memset( &control, 0, sizeof( control ) );
+		msg.msg_control = control.buf;
+		msg.msg_controllen = CMSG_SPACE( sizeof( int ) * count );
+		cmsg = CMSG_FIRSTHDR( &msg );
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN( sizeof( int ) * count );
+		( void )memcpy( CMSG_DATA( cmsg ), fds, sizeof( int ) * count );
+	}
+
+	do{
+		nsent = sendmsg( sockfd, &msg, 0 );
+	}while ( nsent == -1 && errno == EINTR );
+
+	return ( nsent == -1 ? -1 : 0 );
+}
+
+static int recvhandoff( int sockfd, struct handoffmessage * restrict hm, int * restrict fds, size_t maxcount, size_t * restrict count ){
+	union{
+		struct cmsghdr cm;
+		char buf[ CMSG_SPACE( sizeof( int ) * LISTENERS ) ];
+	} control;
+	struct cmsghdr *cmsg = NULL;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t nread;
+	size_t received = 0;
+	size_t n;
+	size_t i;
+	int fd;
+
+	assert( hm != NULL );
+
+	iov.iov_base = hm;
+	iov.iov_len = sizeof( *hm );
+	( void )memset( &msg, 0, sizeof( msg ) );
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof( control.buf );
+	do{
+		nread = recvmsg( sockfd, &msg, 0 );
+	}while ( nread == -1 && errno == EINTR );
+	if ( nread == -1 ){
+		return ( -1 );
+	}
+
+	// The descriptors are received whatever the message; those not kept must be closed
+	for ( cmsg = CMSG_FIRSTHDR( &msg ); cmsg != NULL; cmsg = CMSG_NXTHDR( &msg, cmsg ) ){
+		if ( cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ){
+			continue;
+		}
+		n = ( cmsg->cmsg_len - CMSG_LEN( 0 ) ) / sizeof( int );
+		for ( i = 0; i < n; ++i ){
+			( void )memcpy( &fd, CMSG_DATA( cmsg ) + i * sizeof( int ), sizeof( int ) );
+			if ( received < maxcount ){
+				fds[ received++ ] = fd;
+			}
+			else{
+				( void )safe_close( fd );
+			}
+		}
+	}
+	if ( ( size_t )nread != sizeof( *hm ) || hm->hm_magic != HANDOFF_MAGIC || hm->hm_version != HANDOFF_VERSION ||
+		( msg.msg_flags & ( MSG_TRUNC | MSG_CTRUNC ) ) ){
+		for ( i = 0; i < received; ++i ){
+			( void )safe_close( fds[ i ] );
+		}
+		errno = ( nread == 0 ) ? ECONNRESET : EPROTO;
+		return ( -1 );
+	}
+	hm->hm_cursor[ CURSOR_NAME_MAXLEN ] = '\0';
+	hm->hm_topics[ TOPICFRAME_REQUEST_MAXLEN - 1 ] = '\0';
+	hm->hm_keywords[ TOPICFRAME_REQUEST_MAXLEN - 1 ] = '\0';
+	hm->hm_regexes[ TOPICFRAME_REQUEST_MAXLEN - 1 ] = '\0';
+	hm->hm_tags[ TOPICFRAME_REQUEST_MAXLEN - 1 ] = '\0';
+	if ( count != NULL ){
+		*count = received;
+	}
+
+	return ( 0 );
+}
+
+// The copies of the listening sockets are sent before the listeners are stopped, so they never close. A listener may still accept a
+// connection meanwhile; it is served and drained like the others
+static int handover( struct serverinfo * restrict si, int sockfd, uint64_t pid ){
+	struct handoff *ho = NULL;
+	struct handoffmessage hm;
+	int fds[ LISTENERS ];
+	uint64_t deadline;
+	uint64_t queuedseq;
+	int status;
+	int saved_errno;
+	int i;
+
+	assert( si != NULL );
+
+	ho = &si->si_handoff;
+	for ( i = 0; i < LISTENERS; ++i ){
+		if ( ( fds[ i ] = dup( si->si_listenfds[ i ] ) ) == -1 ){
+			saved_errno = errno;
+			while ( --i >= 0 ){
+				( void )safe_close( fds[ i ] );
+			}
+			errno = saved_errno;
+			return ( -1 );
+		}
+	}
+	( void )memset( &hm, 0, sizeof( hm ) );
+	hm.hm_pid = ( uint64_t )getpid();
+	status = sendhandoff( sockfd, &hm, HANDOFF_LISTENERS, fds, LISTENERS );
+	saved_errno = errno;
+	for ( i = 0; i < LISTENERS; ++i ){
+		( void )safe_close( fds[ i ] );
+	}
+	if ( status == -1 ){
+		errno = saved_errno;
+		return ( -1 );
+	}
+
+	// From now on the connections wait for the other server
+	ho->ho_sockfd = sockfd;
+	ho->ho_pid = pid;
+	ho->ho_started = monotonic_ns();
+	__atomic_store_n( &ho->ho_state, HANDOFF_SAYERS, __ATOMIC_RELAXED );
+	( void )pthread_cancel( si->si_sayers_listener_threadid );
+	( void )pthread_cancel( si->si_hearers_listener_threadid );
+	( void )pthread_cancel( si->si_metrics_listener_threadid );
+	( void )pthread_cancel( si->si_search_listener_threadid );
+	( void )pthread_cancel( si->si_trends_listener_threadid );
+
+	// The sayers connected are given the time to finish
+	deadline = ho->ho_started + ( uint64_t )HANDOFF_DRAIN_SEC * 1000000000u;
+	while ( connectedsayers( si ) > 0 && monotonic_ns() < deadline ){
+		pausedrain();
+	}
+
+	// The rest are cut off, so no twit enters the twitpool after the last one queued; once it is broadcast every hearer that sent
+	// what is left in its twitpool has been sent every twit
+	acquire_twitpool( si );
+	__atomic_store_n( &ho->ho_state, HANDOFF_CUTOFF, __ATOMIC_RELAXED );
+	queuedseq = si->si_queuedseq;
+	release_twitpool( si );
+	deadline = monotonic_ns() + ( uint64_t )HANDOFF_DRAIN_SEC * 1000000000u;
+	while ( broadcastseq( si ) < queuedseq && monotonic_ns() < deadline ){
+		pausedrain();
+	}
+	__atomic_store_n( &ho->ho_state, HANDOFF_HEARERS, __ATOMIC_RELAXED );
+	wakehearers( si );
+	while ( connectedhearers( si ) > 0 && monotonic_ns() < deadline ){
+		pausedrain();
+	}
+
+	// The hearers left are dropped when the server terminates, as are those the other server had no room for; they can resume
+	lock_mutex( LOCK_HANDOFF, &ho->ho_lock, &ho->ho_lockedat );
+	ho->ho_dropped += ( uint64_t )connectedhearers( si );
+	unlock_mutex( LOCK_HANDOFF, &ho->ho_lock, &ho->ho_lockedat );
+	ho->ho_drain_ns = monotonic_ns() - ho->ho_started;
+	__atomic_store_n( &ho->ho_state, HANDOFF_DONE, __ATOMIC_RELAXED );
+
+	return ( 0 );
+}
+
+static int connectedsayers( struct serverinfo * restrict si ){
+	int count;
+
+	acquire_statistics( si );
+	count = si->si_stats.stats_sayersNum;
+	release_statistics( si );
+
+	return ( count );
+}
+
+static int connectedhearers( struct serverinfo * restrict si ){
+	int count;
+
+	acquire_statistics( si );
+	count = si->si_stats.stats_hearersNum;
+	release_statistics( si );
+
+	return ( count );
+}
+
+static uint64_t broadcastseq( struct serverinfo * restrict si ){
+	uint64_t seq;
+
+	acquire_twitpool_list( si );
+	seq = si->si_broadcastseq;
+	release_twitpool_list( si );
+
+	return ( seq );
+}
+
+static void pausedrain( void ){
+	struct timespec interval;
+
+	interval.tv_sec = 0;
+	interval.tv_nsec = ( long )HANDOFF_POLL_MSEC * 1000000;
+	( void )nanosleep( &interval, NULL );
+
+	return ;
+}
+
+// The socket is removed with it; the server that took over creates its own
+static void cleanupHandoffListener( void *arg ){
+	int *sockfd = ( int * )arg;
+
+	assert( sockfd != NULL );
+
+	if ( *sockfd != -1 ){
+		( void )safe_close( *sockfd );
+		( void )unlink( HANDOFF_SOCKET );
+	}
+
+	return ;
+}
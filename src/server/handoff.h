@@ -0,0 +1,180 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file handoff.h
+ *
+ * File handoff.h declares the hot restart of the server. The server listens on the Unix socket HANDOFF_SOCKET for a server started
+ * in its place with -r, which takes over:
+ *	1) The server running sends it its listening sockets (SCM_RIGHTS) and stops accepting. The sockets stay open all along, so
+ *	connections that arrive meanwhile wait in their backlog and none is refused.
+ *	2) It waits up to HANDOFF_DRAIN_SEC seconds for its sayers to finish. The twits of the sayers still connected after that are
+ *	left out and their connections closed.
+ *	3) Once the consumer broadcast the last twit, each hearer sends the twits left in its twitpool and is handed over with its
+ *	connection, its framing, its cursor, its topics, its keywords, its regular expressions and its hashtags and mentions; the new
+ *	server answers whether it took it. The hearers it has no room for, and those not handed over within HANDOFF_DRAIN_SEC seconds,
+ *	are dropped and can resume.
+ *	4) It terminates as usual: the last snapshot is written and the twit log closed. Then it tells the new server, which opens the
+ *	twit log and the snapshot only then, and starts accepting on the sockets and sending to the hearers it was handed.
+ *
+ * The twits the hearers are sent keep following on: the old server logs and broadcasts every twit it took before it hands a hearer
+ * over, and the new one gives sequence numbers after them. No connection is accepted from the time the old server stops until the
+ * new one is ready; that time bounds how long a twit waits and the new server measures it.
+ *
+ * The messages are of a SOCK_SEQPACKET socket, so each arrives whole with the descriptors it carries.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( HANDOFF_H_IS_INCLUDED )
+#define HANDOFF_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "topicframe.h"
+#include "config.h"
+
+/**
+ * \enum handoffstate
+ *
+ * The handoffstate enumeration tells how far the server running is in handing itself over.
+ */
+enum handoffstate{
+	HANDOFF_NONE, /**< Nobody took over */
+	HANDOFF_SAYERS, /**< The listening sockets were sent; the sayers connected are waited for */
+	HANDOFF_CUTOFF, /**< The sayers are cut off; the consumer is waited for to broadcast the last twit queued */
+	HANDOFF_HEARERS, /**< The hearers are handed over as soon as they have sent what is left in their twitpools */
+	HANDOFF_DONE /**< The hearers are handed over or dropped; the server terminates */
+};
+
+/**
+ * \struct handedhearer
+ *
+ * The handedhearer structure is a hearer handed over to the server that took over.
+ */
+struct handedhearer{
+	int hh_sockfd;
+	int hh_resume; /**< Whether it is sent the frames of resumeframe.h */
+	char hh_cursor[ CURSOR_NAME_MAXLEN + 1 ]; /**< Name of its cursor; empty if it has none */
+	char hh_topics[ TOPICFRAME_REQUEST_MAXLEN ]; /**< Names of its topics, as subscribe() takes them */
+	char hh_keywords[ TOPICFRAME_REQUEST_MAXLEN ]; /**< Its keywords, as subscribekeywords() takes them; empty if it has none */
+	char hh_regexes[ TOPICFRAME_REQUEST_MAXLEN ]; /**< Its regular expressions, as subscriberegexes() takes them; empty if it has none */
+	char hh_tags[ TOPICFRAME_REQUEST_MAXLEN ]; /**< Its hashtags and mentions, as subscribetags() takes them; empty if it has none */
+};
+
+/**
+ * \struct handoff
+ *
+ * The handoff structure keeps the hot restart of a server, from either side. ho_state is stored atomically; the sayers read it
+ * under si_twitpool_lock, which they are cut off under, and the hearers under the lock of their twitpool, which is taken to wake
+ * them once they are to be handed over.
+ */
+struct handoff{
+	int ho_state; /**< One of enum handoffstate */
+	int ho_sockfd; /**< Connection with the other server; -1 if none */
+	pthread_mutex_t ho_lock; /**< The hearers take turns to hand themselves over */
+	uint64_t ho_lockedat;
+	uint64_t ho_pid; /**< Process of the other server */
+	uint64_t ho_started; /**< When the old server stopped accepting, as seen by monotonic_ns() of this process */
+	uint64_t ho_drain_ns; /**< How long the old server took to hand itself over */
+	uint64_t ho_paused_ns; /**< How long no connection was accepted; measured by the new server */
+	uint64_t ho_leftout; /**< Twits of the sayers cut off; updated atomically */
+	uint64_t ho_handed; /**< Hearers handed over; updated under ho_lock */
+	uint64_t ho_dropped; /**< Hearers that were not; updated under ho_lock */
+	uint64_t ho_nextseq; /**< The next sequence number of the old server */
+	struct handedhearer ho_hearers[ HEARERS_MAXCOUNT ]; /**< The hearers the new server was handed */
+	size_t ho_hearercount;
+};
+
+// Declared in serverinfo.h
+struct serverinfo;
+struct connserverinfo;
+
+
+
+/**
+ * The inithandoff() function shall initialize the struct handoff object pointed to by parameter ho for a server nobody took over.
+ *
+ * @return Nothing.
+ */
+void inithandoff( struct handoff * restrict ho );
+
+/**
+ * The delhandoff() function shall release the resources of the struct handoff object pointed to by parameter ho.
+ *
+ * @return Nothing.
+ */
+void delhandoff( struct handoff * restrict ho );
+
+/**
+ * The takeover() function shall take over from the server listening on HANDOFF_SOCKET for the server whose struct serverinfo is
+ * pointed to by parameter si: its listening sockets are stored in si_listenfds and the hearers it hands over in si_handoff. The
+ * takeover() function returns once the old server closed the twit log, or went away. An old server that sends nothing for
+ * HANDOFF_WAIT_SEC seconds still holds the twit log, so the sockets and the hearers received are closed and takeover() fails.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EPROTO The server listening did not hand over its listening sockets.
+ * @exception ETIMEDOUT The server listening sent nothing for HANDOFF_WAIT_SEC seconds.
+ * Any error of socket(), connect(), send() or recvmsg().
+ */
+int takeover( struct serverinfo * restrict si );
+
+/**
+ * The handoffhearer() function shall hand over the hearer whose struct connserverinfo is pointed to by parameter csi, whose twitpool
+ * is empty, to the server that took over, and wait for it to answer. On success csi_handoff is set and the connection shall only be
+ * closed; a hearer the other server did not take is counted in ho_dropped.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception ECONNREFUSED The other server has no room for the hearer.
+ * Any error of sendmsg() or recvmsg().
+ */
+int handoffhearer( struct connserverinfo * restrict csi );
+
+/**
+ * The finishhandoff() function shall tell the server that took over from the server whose struct serverinfo is pointed to by
+ * parameter si that the twit log is closed, with the next sequence number given as parameter nextseq, and close the connection.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * Any error of send().
+ */
+int finishhandoff( struct serverinfo * restrict si, uint64_t nextseq );
+
+/**
+ * handoffListener() runs on its own thread and listens on HANDOFF_SOCKET for a server that takes over from the one whose struct
+ * serverinfo is pointed to by parameter arg. It hands the server over as described above and, once it is done, sends SIGUSR1 to
+ * the process for the server to terminate.
+ */
+void *handoffListener( void *arg );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
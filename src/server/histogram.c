@@ -0,0 +1,163 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file histogram.c
+ *
+ * File histogram.c contains the implementation of the histogram.h interface.
+ *
+ * The counters are updated with the atomic builtins of gcc so as recording never takes a lock. Readers use
+ * snapshothistogram() to get a copy on which the percentiles are computed.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include "histogram.h"
+
+// Number of buckets used for each power of two
+#define SUBBUCKETS ( 1 << HISTOGRAM_SUBBITS )
+
+
+
+// Forget all the values
+void inithistogram( struct histogram * restrict h ){
+	assert( h != NULL );
+
+	( void )memset( h, 0, sizeof( *h ) );
+
+	return ;
+}
+
+// Count the value in its bucket
+void recordinhistogram( struct histogram * restrict h, uint64_t value ){
+	uint64_t max;
+
+	assert( h != NULL );
+
+	( void )__atomic_fetch_add( &h->h_counts[ histogrambucket( value ) ], 1, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &h->h_sum, value, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &h->h_count, 1, __ATOMIC_RELAXED );
+
+	// Raise the maximum if needed. On failure max gets the current value so just retry while it is less than ours
+	max = __atomic_load_n( &h->h_max, __ATOMIC_RELAXED );
+	while ( value > max ){
+		if ( __atomic_compare_exchange_n( &h->h_max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ){
+			break;
+		}
+	}
+
+	return ;
+}
+
+// Copy the histogram one counter at a time
+void snapshothistogram( const struct histogram * restrict h, struct histogram * restrict snapshot ){
+	int i;
+
+	assert( h != NULL );
+	assert( snapshot != NULL );
+
+	snapshot->h_count = 0;
+	for ( i = 0; i < HISTOGRAM_BUCKETS; ++i ){
+		snapshot->h_counts[ i ] = __atomic_load_n( &h->h_counts[ i ], __ATOMIC_RELAXED );
+		// Count from the buckets copied so as the percentiles agree with the buckets
+		snapshot->h_count += snapshot->h_counts[ i ];
+	}
+	snapshot->h_sum = __atomic_load_n( &h->h_sum, __ATOMIC_RELAXED );
+	snapshot->h_max = __atomic_load_n( &h->h_max, __ATOMIC_RELAXED );
+
+	return ;
+}
+
+// Walk the buckets until the rank of the percentile is reached
+uint64_t histogrampercentile( const struct histogram * restrict h, double q ){
+	uint64_t rank;
+	uint64_t seen = 0;
+	uint64_t value;
+	int i;
+
+	assert( h != NULL );
+	assert( q >= 0.0 && q <= 100.0 );
+
+	if ( h->h_count == 0 ){
+		return ( 0 );
+	}
+
+	// The rank of the percentile is ceil( q / 100 * count ) but at least the first value
+	rank = ( uint64_t )( q / 100.0 * ( double )h->h_count );
+	if ( ( double )rank < q / 100.0 * ( double )h->h_count ){
+		++rank;
+	}
+	if ( rank == 0 ){
+		rank = 1;
+	}
+
+	for ( i = 0; i < HISTOGRAM_BUCKETS - 1; ++i ){
+		seen += h->h_counts[ i ];
+		if ( seen >= rank ){
+			break;
+		}
+	}
+
+	value = histogrambucketmax( i );
+
+	return ( value < h->h_max ? value : h->h_max );
+}
+
+// Small values go to their own bucket; the rest are split by their most significant bit
+int histogrambucket( uint64_t value ){
+	int msb;
+
+	if ( value < SUBBUCKETS ){
+		return ( ( int )value );
+	}
+
+	msb = 63 - __builtin_clzll( value );
+	if ( msb >= HISTOGRAM_MAXBITS ){
+		return ( HISTOGRAM_BUCKETS - 1 );
+	}
+
+	// The HISTOGRAM_SUBBITS bits after the most significant bit select the bucket inside the power of two
+	return ( ( msb - HISTOGRAM_SUBBITS + 1 ) * SUBBUCKETS + ( int )( ( value >> ( msb - HISTOGRAM_SUBBITS ) ) - SUBBUCKETS ) );
+}
+
+// Inverse of histogrambucket()
+uint64_t histogrambucketmax( int bucket ){
+	int shift;
+	uint64_t sub;
+
+	assert( bucket >= 0 && bucket < HISTOGRAM_BUCKETS );
+
+	if ( bucket < SUBBUCKETS ){
+		return ( ( uint64_t )bucket );
+	}
+
+	shift = bucket / SUBBUCKETS - 1;
+	sub = ( uint64_t )( bucket % SUBBUCKETS );
+
+	return ( ( ( SUBBUCKETS + sub + 1 ) << shift ) - 1 );
+}
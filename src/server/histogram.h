@@ -0,0 +1,124 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file histogram.h
+ *
+ * File histogram.h declares the histogram structure and the functions used to record values in it and query it.
+ *
+ * The histogram is log-linear, in the style of HdrHistogram: values below 2^HISTOGRAM_SUBBITS are counted exactly and
+ * every power of two above that is split in 2^HISTOGRAM_SUBBITS equally sized buckets, so the relative error of any value
+ * reported is below 1 / 2^HISTOGRAM_SUBBITS. Recording is lock-free; several threads can record in the same histogram
+ * concurrently with any number of readers.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( HISTOGRAM_H_IS_INCLUDED )
+#define HISTOGRAM_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+// Each power of two is split in 2^HISTOGRAM_SUBBITS buckets
+#define HISTOGRAM_SUBBITS (5)
+
+// Values of HISTOGRAM_MAXBITS bits or more are counted in the last bucket. For nanoseconds that is about 18 minutes.
+#define HISTOGRAM_MAXBITS (40)
+
+// Number of buckets in a histogram
+#define HISTOGRAM_BUCKETS ( ( HISTOGRAM_MAXBITS - HISTOGRAM_SUBBITS + 1 ) << HISTOGRAM_SUBBITS )
+
+/**
+ * \struct histogram
+ *
+ * The histogram structure counts how many times each value was recorded in it, with bounded relative error.
+ */
+struct histogram{
+	uint64_t h_counts[ HISTOGRAM_BUCKETS ]; /**< Number of values recorded in each bucket */
+	uint64_t h_count; /**< Total number of values recorded */
+	uint64_t h_sum; /**< Sum of the values recorded */
+	uint64_t h_max; /**< Largest value recorded */
+};
+
+/**
+ * The inithistogram() function shall initialize the struct histogram object pointed to by parameter h, which shall not
+ * be a NULL pointer, so as no values are recorded in it.
+ *
+ * @return Nothing.
+ */
+void inithistogram( struct histogram * restrict h );
+
+/**
+ * The recordinhistogram() function shall record the value given as parameter in the struct histogram object pointed to by
+ * parameter h, which shall not be a NULL pointer. The recordinhistogram() function is lock-free and may be called by
+ * several threads at the same time for the same histogram.
+ *
+ * @return Nothing.
+ */
+void recordinhistogram( struct histogram * restrict h, uint64_t value );
+
+/**
+ * The snapshothistogram() function shall copy the struct histogram object pointed to by parameter h into the struct histogram
+ * object pointed to by parameter snapshot. Neither parameter shall be a NULL pointer. Values may be recorded in the histogram
+ * pointed to by parameter h while it is copied in which case the copy may include only some of them.
+ *
+ * @return Nothing.
+ */
+void snapshothistogram( const struct histogram * restrict h, struct histogram * restrict snapshot );
+
+/**
+ * The histogrampercentile() function shall return the value below or at which the q-th percentile (0 <= q <= 100) of the values
+ * recorded in the struct histogram object pointed to by parameter h, which shall not be a NULL pointer, lie. The value returned
+ * is the highest value that is counted in the same bucket as the percentile and never more than the largest value recorded.
+ * The histogrampercentile() function shall only be used on a snapshot obtained by snapshothistogram().
+ *
+ * @return The percentile or zero if no values are recorded.
+ */
+uint64_t histogrampercentile( const struct histogram * restrict h, double q );
+
+/**
+ * The histogrambucket() function shall return the index of the bucket in which the value given as parameter is counted.
+ *
+ * @return The index of the bucket.
+ */
+int histogrambucket( uint64_t value );
+
+/**
+ * The histogrambucketmax() function shall return the highest value that is counted in the bucket with the index given as
+ * parameter, which shall be less than HISTOGRAM_BUCKETS.
+ *
+ * @return The highest value of the bucket.
+ */
+uint64_t histogrambucketmax( int bucket );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
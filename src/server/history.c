@@ -0,0 +1,172 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file history.c
+ *
+ * File history.c contains the implementation of the history.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "history.h"
+#include "lockstats.h"
+
+
+
+int inithistory( struct history * restrict hs ){
+	assert( hs != NULL );
+
+	if ( ( hs->hs_entries = malloc( HISTORY_SIZE * sizeof( *hs->hs_entries ) ) ) == NULL ){
+		errno = ENOMEM;
+		return ( -1 );
+	}
+	hs->hs_added = 0;
+	while ( pthread_mutex_init( &hs->hs_lock, NULL ) ){ continue; }
+
+	return ( 0 );
+}
+
+void delhistory( struct history * restrict hs ){
+	assert( hs != NULL );
+
+	( void )pthread_mutex_destroy( &hs->hs_lock );
+	free( hs->hs_entries );
+	hs->hs_entries = NULL;
+
+	return ;
+}
+
+void addtohistory( struct history * restrict hs, uint64_t seq, uint64_t time, unsigned flags, const char * restrict twit, size_t twitlen ){
+	struct historyentry *he;
+
+	assert( hs != NULL );
+	assert( twit != NULL );
+	assert( twitlen <= TWIT_MAXLEN );
+
+	lock_mutex( LOCK_HISTORY, &hs->hs_lock, &hs->hs_lockedat );
+	he = &hs->hs_entries[ hs->hs_added % HISTORY_SIZE ];
+	he->he_seq = seq;
+	he->he_time = time;
+	he->he_flags = flags;
+	he->he_twitlen = twitlen;
+	( void )memcpy( he->he_twit, twit, twitlen );
+	++hs->hs_added;
+	unlock_mutex( LOCK_HISTORY, &hs->hs_lock, &hs->hs_lockedat );
+
+	return ;
+}
+
+// The sequence numbers grow along the ring, so the first twit to copy is found by binary search
+size_t copyfromhistory( struct history * restrict hs, uint64_t fromseq, struct historyentry * restrict entries, size_t max ){
+	uint64_t oldest;
+	uint64_t low, high, mid;
+	uint64_t i;
+	size_t n = 0;
+
+	assert( hs != NULL );
+	assert( entries != NULL || max == 0 );
+
+	lock_mutex( LOCK_HISTORY, &hs->hs_lock, &hs->hs_lockedat );
+	oldest = hs->hs_added > HISTORY_SIZE ? hs->hs_added - HISTORY_SIZE : 0;
+	low = oldest;
+	high = hs->hs_added;
+	while ( low < high ){
+		mid = low + ( high - low ) / 2;
+		if ( hs->hs_entries[ mid % HISTORY_SIZE ].he_seq < fromseq ){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	for ( i = low; i < hs->hs_added && n < max; ++i ){
+		entries[ n++ ] = hs->hs_entries[ i % HISTORY_SIZE ];
+	}
+	unlock_mutex( LOCK_HISTORY, &hs->hs_lock, &hs->hs_lockedat );
+
+	return ( n );
+}
+
+// From the first twit asked for on, found as copyfromhistory() finds it, the ring and the sequence numbers are walked together
+size_t findinhistory( struct history * restrict hs, const uint64_t * restrict seqs, size_t count, struct historyentry * restrict entries ){
+	uint64_t low, high, mid;
+	size_t j = 0;
+	size_t n = 0;
+
+	assert( hs != NULL );
+	assert( seqs != NULL || count == 0 );
+	assert( entries != NULL || count == 0 );
+
+	if ( count == 0 ){
+		return ( 0 );
+	}
+	lock_mutex( LOCK_HISTORY, &hs->hs_lock, &hs->hs_lockedat );
+	low = hs->hs_added > HISTORY_SIZE ? hs->hs_added - HISTORY_SIZE : 0;
+	high = hs->hs_added;
+	while ( low < high ){
+		mid = low + ( high - low ) / 2;
+		if ( hs->hs_entries[ mid % HISTORY_SIZE ].he_seq < seqs[ 0 ] ){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	for ( ; low < hs->hs_added && j < count; ++low ){
+		while ( j < count && seqs[ j ] < hs->hs_entries[ low % HISTORY_SIZE ].he_seq ){
+			++j;
+		}
+		if ( j < count && seqs[ j ] == hs->hs_entries[ low % HISTORY_SIZE ].he_seq ){
+			entries[ n++ ] = hs->hs_entries[ low % HISTORY_SIZE ];
+			++j;
+		}
+	}
+	unlock_mutex( LOCK_HISTORY, &hs->hs_lock, &hs->hs_lockedat );
+
+	return ( n );
+}
+
+// The entries go to the start of the ring in one copy
+void restorehistory( struct history * restrict hs, const struct historyentry * restrict entries, size_t count ){
+	assert( hs != NULL );
+	assert( entries != NULL || count == 0 );
+
+	if ( count > HISTORY_SIZE ){
+		entries += count - HISTORY_SIZE;
+		count = HISTORY_SIZE;
+	}
+	lock_mutex( LOCK_HISTORY, &hs->hs_lock, &hs->hs_lockedat );
+	assert( hs->hs_added == 0 );
+	( void )memcpy( hs->hs_entries, entries, count * sizeof( *entries ) );
+	hs->hs_added = count;
+	unlock_mutex( LOCK_HISTORY, &hs->hs_lock, &hs->hs_lockedat );
+
+	return ;
+}
@@ -0,0 +1,127 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file history.h
+ *
+ * File history.h declares the recent history: a ring of the last HISTORY_SIZE twits the consumer took from the twitpool, with
+ * their sequence numbers in the twit log. It is filled from the twit log when the server starts, so it survives restarts.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( HISTORY_H_IS_INCLUDED )
+#define HISTORY_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "config.h"
+
+/**
+ * \struct historyentry
+ *
+ * The historyentry structure is a twit of the recent history.
+ */
+struct historyentry{
+	uint64_t he_seq; /**< Sequence number in the twit log */
+	uint64_t he_time; /**< When the twit was logged, in nanoseconds since the Epoch */
+	unsigned he_flags; /**< The flags of its record in the twit log */
+	size_t he_twitlen;
+	char he_twit[ TWIT_MAXLEN ];
+};
+
+/**
+ * \struct history
+ *
+ * The history structure is the ring of the recent history. The members are guarded by hs_lock.
+ */
+struct history{
+	pthread_mutex_t hs_lock;
+	uint64_t hs_lockedat;
+	struct historyentry *hs_entries; /**< HISTORY_SIZE entries */
+	uint64_t hs_added; /**< Number of twits ever added; the next one goes to hs_entries[ hs_added % HISTORY_SIZE ] */
+};
+
+
+
+/**
+ * The inithistory() function shall initialize the empty recent history pointed to by parameter hs.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ */
+int inithistory( struct history * restrict hs );
+
+/**
+ * The delhistory() function shall release the resources of the recent history pointed to by parameter hs.
+ *
+ * @return Nothing.
+ */
+void delhistory( struct history * restrict hs );
+
+/**
+ * The addtohistory() function shall add to the recent history pointed to by parameter hs the twitlen bytes pointed to by parameter
+ * twit, with the sequence number, time and flags of its record in the twit log given as parameters, replacing the oldest twit if
+ * the ring is full. The twits shall be added in the order of their sequence numbers.
+ *
+ * @return Nothing.
+ */
+void addtohistory( struct history * restrict hs, uint64_t seq, uint64_t time, unsigned flags, const char * restrict twit, size_t twitlen );
+
+/**
+ * The copyfromhistory() function shall copy to the array of max entries pointed to by parameter entries, oldest first, the twits of
+ * the recent history pointed to by parameter hs whose sequence numbers are not smaller than parameter fromseq, up to max of them.
+ *
+ * @return The number of entries copied.
+ */
+size_t copyfromhistory( struct history * restrict hs, uint64_t fromseq, struct historyentry * restrict entries, size_t max );
+
+/**
+ * The findinhistory() function shall copy to the array pointed to by parameter entries, oldest first, the twits of the recent
+ * history pointed to by parameter hs with the count sequence numbers, in increasing order, pointed to by parameter seqs; those no
+ * longer in it are left out.
+ *
+ * @return The number of entries copied.
+ */
+size_t findinhistory( struct history * restrict hs, const uint64_t * restrict seqs, size_t count, struct historyentry * restrict entries );
+
+/**
+ * The restorehistory() function shall fill the empty recent history pointed to by parameter hs with the count entries pointed to by
+ * parameter entries, oldest first, as copyfromhistory() copied them; only the last HISTORY_SIZE are kept.
+ *
+ * @return Nothing.
+ */
+void restorehistory( struct history * restrict hs, const struct historyentry * restrict entries, size_t count );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
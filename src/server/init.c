@@ -33,6 +33,7 @@
  */
 #include <assert.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include "serverinfo.h"
@@ -40,6 +41,21 @@
 #include "twitpool.h"
 #include "consume.h"
 #include "listen.h"
+#include "metrics.h"
+#include "search.h"
+#include "trends.h"
+#include "statspage.h"
+#include "lockstats.h"
+#include "timing.h"
+#include "trace.h"
+#include "twitlog.h"
+#include "history.h"
+#include "tags.h"
+#include "fulltext.h"
+#include "trending.h"
+#include "cursors.h"
+#include "snapshot.h"
+#include "handoff.h"
 #include "init.h"
 #include "error.h"
 
@@ -73,6 +89,80 @@ static int startSayersListener( struct serverinfo * restrict si );
  */
 static int startTwitpoolConsumer( struct serverinfo * restrict si );
 
+/**
+ * The openTwitlog() function shall open the twit log in TWITLOG_DIR, which recovers it after a crash and starts the thread that
+ * writes it, and fill the recent history with its last twits. If there is a snapshot (see snapshot.h) the recent history and the
+ * cursors of the hearers are taken from it, and only the twits logged after it are read from the twit log.
+ *
+ * @return The openTwitlog() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int openTwitlog( struct serverinfo * restrict si );
+
+/**
+ * The startSnapshotWriter() function shall start the thread that runs the snapshotWriter() function.
+ *
+ * @return The startSnapshotWriter() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int startSnapshotWriter( struct serverinfo * restrict si );
+
+/**
+ * The addRecordToHistory() function shall add the twit pointed to by parameter twit, whose record in the twit log has the header
+ * pointed to by parameter r, to the struct history object pointed to by parameter arg. It is called by readtwitlog().
+ *
+ * @return Always zero, so the reading goes on.
+ */
+static int addRecordToHistory( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg );
+
+/**
+ * The indexHistory() function shall add the twits of the recent history to the index of the hashtags and mentions and to the full-text
+ * index, once the history is filled when the server starts, and keep the sequence number of the first one in si_fulltext_fromseq.
+ *
+ * @return Nothing.
+ */
+static void indexHistory( struct serverinfo * restrict si );
+
+/**
+ * The takeOver() function shall take over from the server running, as takeover() does, before anything else of the server is started.
+ *
+ * @return The takeOver() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int takeOver( struct serverinfo * restrict si );
+
+/**
+ * The startHandedHearers() function shall start serving the hearers handed over by the server taken over from.
+ *
+ * @return Nothing; a hearer that cannot be served is dropped.
+ */
+static void startHandedHearers( struct serverinfo * restrict si );
+
+/**
+ * The startHandoffListener() function shall start the thread that runs the handoffListener() function.
+ *
+ * @return The startHandoffListener() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int startHandoffListener( struct serverinfo * restrict si );
+
+/**
+ * The startMetricsListener() function shall initialize and start the thread that runs the metricsListener() function.
+ *
+ * @return The startMetricsListener() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int startMetricsListener( struct serverinfo * restrict si );
+
+/**
+ * The startSearchListener() function shall initialize and start the thread that runs the searchListener() function.
+ *
+ * @return The startSearchListener() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int startSearchListener( struct serverinfo * restrict si );
+
+/**
+ * The startTrendsListener() function shall initialize and start the thread that runs the trendsListener() function.
+ *
+ * @return The startTrendsListener() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int startTrendsListener( struct serverinfo * restrict si );
+
 /**
  * The initServerinfo() function shall initialize the struct serverinfo object pointed to by parameter si.
  *
@@ -84,17 +174,23 @@ static int initServerinfo( struct serverinfo * restrict si );
 
 /**
  * initializeServer() is used to initialize all things in the server.
- * First it must initialize the members of the struct serverinfo pointed to by parameter si.
- * Then it must start the following threads:
- *	1) The one that updates the statistics
+ * First it must initialize the members of the struct serverinfo pointed to by parameter si and, if parameter restart is nonzero,
+ * take over from the server running, which hands over its listening sockets and its hearers and closes its twit log (see handoff.h).
+ * Then it must open the twit log, which recovers it after a crash and gives back the recent history, and start the following threads:
+ *	0) The one that writes the snapshot, and the one that consumes the twitpool
+ *	1) The one that updates the statistics; then the hearers handed over are started
  *	2) The one that listens for hearers
  *	3) The one that listens for sayers
+ *	4) The one that serves the metrics
+ *	5) The one that answers the searches, which first indexes the twits of the twit log before the recent history
+ *	6) The one that answers what is trending
+ *	7) The one that listens for a server that takes over
  *
  * Note that the following must be done in that order or otherwise information might get lost.
  * For example, if the listeners get started before the statistics updater and messages get exchanged
  * then the statistics updater will not update successfully the statistics structure.
  */
-int initializeServer( struct serverinfo * restrict si ){
+int initializeServer( struct serverinfo * restrict si, int restart ){
 	
 	assert( si != NULL );
 	
@@ -102,6 +198,18 @@ int initializeServer( struct serverinfo * restrict si ){
 		return ( -1 );
 	}
 
+	if ( restart && takeOver( si ) == -1 ){
+		return ( -1 );
+	}
+
+	if ( openTwitlog( si ) == -1 ){
+		return ( -1 );
+	}
+
+	if ( startSnapshotWriter( si ) == -1 ){
+		return ( -1 );
+	}
+
 	if ( startTwitpoolConsumer( si ) == -1 ){
 		return ( -1 );
 	}
@@ -110,6 +218,8 @@ int initializeServer( struct serverinfo * restrict si ){
 		return ( -1 );
 	}
 
+	startHandedHearers( si );
+
 	if ( startHearersListener( si ) == -1 ){
 		return ( -1 );
 	}
@@ -118,6 +228,27 @@ int initializeServer( struct serverinfo * restrict si ){
 		return ( -1 );
 	}
 
+	if ( startMetricsListener( si ) == -1 ){
+		return ( -1 );
+	}
+
+	if ( startSearchListener( si ) == -1 ){
+		return ( -1 );
+	}
+
+	if ( startTrendsListener( si ) == -1 ){
+		return ( -1 );
+	}
+
+	// The connections that arrived since the server taken over stopped accepting are accepted from now on
+	if ( restart ){
+		si->si_handoff.ho_paused_ns = monotonic_ns() - si->si_handoff.ho_started;
+	}
+
+	if ( startHandoffListener( si ) == -1 ){
+		return ( -1 );
+	}
+
 	return ( 0 );
 }
 
@@ -131,6 +262,12 @@ static int startStatisticsUpdater( struct serverinfo * restrict si ){
 
 	assert( si != NULL );
 
+	// The statistics page is for external monitoring only so the server can do without it
+	if ( createstatspage( &si->si_statspage ) == -1 ){
+		error( "Failed to create the statistics page %s: %s\n", STATSPAGE_NAME, strerror( errno ) );
+		si->si_statspage = NULL;
+	}
+
 	// Start the thread that updates the statistics	
 	acquire_preparation_status( si );
 	si->si_prepared = -1;	
@@ -142,7 +279,7 @@ static int startStatisticsUpdater( struct serverinfo * restrict si ){
 	// Wait for the preparation status
 	acquire_preparation_status( si );
 	while ( si->si_prepared == -1 ){
-		while ( pthread_cond_wait( &si->si_prepared_cond, &si->si_prepared_lock ) ){ continue; }
+		wait_preparation_status( si );
 	}
 	prepared = si->si_prepared;
 	release_preparation_status( si );
@@ -176,7 +313,7 @@ static int startHearersListener( struct serverinfo * restrict si ){
 	// Wait for the preparation status
 	acquire_preparation_status( si );
 	while ( si->si_prepared == -1 ){
-		while ( pthread_cond_wait( &si->si_prepared_cond, &si->si_prepared_lock ) ){ continue; }
+		wait_preparation_status( si );
 	}
 	prepared = si->si_prepared;
 	release_preparation_status( si );
@@ -209,7 +346,7 @@ static int startSayersListener( struct serverinfo * restrict si ){
 	// Wait for the preparation status
 	acquire_preparation_status( si );
 	while ( si->si_prepared == -1 ){
-		while ( pthread_cond_wait( &si->si_prepared_cond, &si->si_prepared_lock ) ){ continue; }
+		wait_preparation_status( si );
 	}
 	prepared = si->si_prepared;
 	release_preparation_status( si );
@@ -242,7 +379,7 @@ static int startTwitpoolConsumer( struct serverinfo * restrict si ){
 	// Wait for the preparation status
 	acquire_preparation_status( si );
 	while ( si->si_prepared == -1 ){
-		while ( pthread_cond_wait( &si->si_prepared_cond, &si->si_prepared_lock ) ){ continue; }
+		wait_preparation_status( si );
 	}
 	prepared = si->si_prepared;
 	release_preparation_status( si );
@@ -258,12 +395,307 @@ static int startTwitpoolConsumer( struct serverinfo * restrict si ){
 	return ( 0 );
 }
 
+// Open the twit log; its writer is one more thread. A snapshot that cannot be taken only makes the start slower
+static int openTwitlog( struct serverinfo * restrict si ){
+	const struct twitlogrecovery *rc = &si->si_twitlog_recovery;
+	struct twitlogretention rt;
+	struct snapshot ss;
+	uint64_t start;
+	uint64_t fromseq;
+	uint64_t nextseq;
+	size_t count;
+	int loaded;
+
+	assert( si != NULL );
+
+	start = monotonic_ns();
+	if ( !( loaded = ( loadsnapshot( SNAPSHOT_FILE, &ss ) == 0 ) ) && errno != ENOENT ){
+		error( "The snapshot %s is not taken (%s).\n", SNAPSHOT_FILE, strerror( errno ) );
+	}
+	if ( opentwitlogfrom( &si->si_twitlog, TWITLOG_DIR, TWITLOG_SYNC, loaded ? ss.ss_checkpoints : NULL,
+		loaded ? ( size_t )ss.ss_header->ssh_checkpoints : 0, &si->si_twitlog_recovery ) == -1 ){
+		error( "Failed to open the twit log in %s (%s); the server does not run without it.\n", TWITLOG_DIR, strerror( errno ) );
+		if ( loaded ){
+			unloadsnapshot( &ss );
+		}
+		return ( -1 );
+	}
+	acquire_statistics( si );
+	increaseThreadsNum( &si->si_stats );
+	release_statistics( si );
+
+	nextseq = rc->tlrc_nextseq;
+	fromseq = rc->tlrc_lastseq >= HISTORY_SIZE ? rc->tlrc_lastseq - HISTORY_SIZE + 1 : 1;
+	// The server taken over from may have sent the hearers it handed over twits that never reached the disk; their sequence
+	// numbers are not given again
+	if ( si->si_handoff.ho_nextseq > nextseq ){
+		nextseq = si->si_handoff.ho_nextseq;
+		skiptwitlogseq( si->si_twitlog, nextseq );
+	}
+	if ( loaded ){
+		// The hearers may have been sent twits that never reached the disk; their sequence numbers are not given again
+		if ( ss.ss_header->ssh_nextseq > nextseq ){
+			nextseq = ss.ss_header->ssh_nextseq;
+			skiptwitlogseq( si->si_twitlog, nextseq );
+		}
+		si->si_restored_cursors = restorecursors( &si->si_cursors, ss.ss_cursors, ( size_t )ss.ss_header->ssh_cursors );
+		// The twits logged after the snapshot follow on from it unless there are more of them than the ring holds
+		count = ( size_t )ss.ss_header->ssh_entries;
+		if ( count > 0 && rc->tlrc_lastseq < ss.ss_entries[ count - 1 ].he_seq + HISTORY_SIZE ){
+			restorehistory( &si->si_history, ss.ss_entries, count );
+			si->si_restored_entries = count < HISTORY_SIZE ? count : HISTORY_SIZE;
+			fromseq = ss.ss_entries[ count - 1 ].he_seq + 1;
+		}
+		unloadsnapshot( &ss );
+		si->si_restored = 1;
+	}
+
+	// The consumer is not started yet so nothing else adds to the history; a failure only leaves it short
+	if ( rc->tlrc_lastseq >= fromseq && readtwitlog( TWITLOG_DIR, fromseq, &addRecordToHistory, &si->si_history ) == -1 ){
+		error( "Failed to read the recent history from the twit log in %s (%s).\n", TWITLOG_DIR, strerror( errno ) );
+	}
+	si->si_fulltext_fromseq = nextseq;
+	indexHistory( si );
+	// The twits logged before are the ones hearers resuming missed
+	si->si_broadcastseq = nextseq - 1;
+	si->si_restored_ns = monotonic_ns() - start;
+
+	// The cleaner is one more thread; without it the log only grows
+	rt.tlrt_age = ( uint64_t )TWITLOG_RETENTION_SEC * 1000000000u;
+	rt.tlrt_bytes = TWITLOG_RETENTION_BYTES;
+	rt.tlrt_segments = TWITLOG_RETENTION_SEGMENTS;
+	rt.tlrt_interval = ( uint64_t )TWITLOG_RETENTION_CHECK_SEC * 1000000000u;
+	rt.tlrt_compact = TWITLOG_COMPACT;
+	rt.tlrt_hotsegments = TWITLOG_HOT_SEGMENTS;
+#if defined( TWITLOG_ARCHIVE_DIR )
+	rt.tlrt_archivedir = TWITLOG_ARCHIVE_DIR;
+#else
+	rt.tlrt_archivedir = NULL;
+#endif
+	if ( retaintwitlog( si->si_twitlog, &rt ) == -1 ){
+		error( "Failed to start the cleaner of the twit log in %s (%s).\n", TWITLOG_DIR, strerror( errno ) );
+	}
+	else{
+		acquire_statistics( si );
+		increaseThreadsNum( &si->si_stats );
+		release_statistics( si );
+	}
+
+	return ( 0 );
+}
+
+// The thread is not waited for; it only needs the twit log, the recent history and the cursors, which are ready
+static int startSnapshotWriter( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	if ( ( errno = pthread_create( &si->si_snapshot_writer_threadid, NULL, &snapshotWriter, si ) ) ){
+		error( "Failed to start the thread that writes the snapshot (%s).\n", strerror( errno ) );
+		return ( -1 );
+	}
+	acquire_statistics( si );
+	increaseThreadsNum( &si->si_stats );
+	release_statistics( si );
+
+	return ( 0 );
+}
+
+// Sequence numbers may be missing, so more than HISTORY_SIZE records may be read; the ring keeps the last ones
+static int addRecordToHistory( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg ){
+	assert( r != NULL );
+	assert( twit != NULL );
+	assert( arg != NULL );
+
+	addtohistory( ( struct history * )arg, r->tlr_seq, r->tlr_time, r->tlr_flags, twit, r->tlr_len );
+
+	return ( 0 );
+}
+
+// Nobody is subscribed yet, so no bitmap is needed; should there be no memory to copy the history, the indexes start empty and only
+// the twits to come are found in them
+static void indexHistory( struct serverinfo * restrict si ){
+	struct historyentry *entries = NULL;
+	struct twittag tags[ TWIT_TAGS_MAXCOUNT ];
+	size_t count;
+	size_t i;
+
+	assert( si != NULL );
+
+	if ( ( entries = malloc( HISTORY_SIZE * sizeof( *entries ) ) ) == NULL ){
+		error( "Failed to index the hashtags and mentions of the recent history (%s).\n", strerror( ENOMEM ) );
+		return ;
+	}
+	count = copyfromhistory( &si->si_history, 0, entries, HISTORY_SIZE );
+	for ( i = 0; i < count; ++i ){
+		( void )indextwit( &si->si_tags, entries[ i ].he_seq, entries[ i ].he_twit, tags,
+			twittags( entries[ i ].he_twit, entries[ i ].he_twitlen, tags ), NULL );
+		( void )addtofulltext( &si->si_fulltext, entries[ i ].he_seq, entries[ i ].he_twit, entries[ i ].he_twitlen );
+	}
+	if ( count > 0 ){
+		si->si_fulltext_fromseq = entries[ 0 ].he_seq;
+	}
+	free( entries );
+
+	return ;
+}
+
+// Take over; the twit log of the server taken over is closed when this returns
+static int takeOver( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	if ( takeover( si ) == -1 ){
+		error( "Failed to take over from the server listening on %s (%s).\n", HANDOFF_SOCKET, strerror( errno ) );
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+// The hearers handed over get their twitpools before the first twit is broadcast, so they miss nothing
+static void startHandedHearers( struct serverinfo * restrict si ){
+	const struct handedhearer *hh = NULL;
+	pthread_attr_t attr;
+	size_t i;
+
+	assert( si != NULL );
+
+	while ( pthread_attr_init( &attr ) ){ continue; }
+	while ( pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED ) ){ continue; }
+	for ( i = 0; i < si->si_handoff.ho_hearercount; ++i ){
+		hh = &si->si_handoff.ho_hearers[ i ];
+		( void )starthearer( si, &attr, hh->hh_sockfd, hh->hh_resume, hh->hh_cursor, hh->hh_topics, hh->hh_keywords,
+			hh->hh_regexes, hh->hh_tags );
+	}
+	while ( pthread_attr_destroy( &attr ) ){ continue; }
+
+	return ;
+}
+
+// The thread is not waited for; a server that cannot be taken over from still serves
+static int startHandoffListener( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	if ( ( errno = pthread_create( &si->si_handoff_listener_threadid, NULL, &handoffListener, si ) ) ){
+		error( "Failed to start the thread that listens for a server to take over (%s).\n", strerror( errno ) );
+		return ( -1 );
+	}
+	acquire_statistics( si );
+	increaseThreadsNum( &si->si_stats );
+	release_statistics( si );
+
+	return ( 0 );
+}
+
+// Start metricsListener()
+static int startMetricsListener( struct serverinfo * restrict si ){
+	int prepared;
+
+	assert( si != NULL );
+
+	// Start the thread that serves the metrics
+	acquire_preparation_status( si );
+	si->si_prepared = -1;
+	release_preparation_status( si );
+	if ( ( errno = pthread_create( &si->si_metrics_listener_threadid, NULL, &metricsListener, si ) ) ){
+		error( "Failed to start the thread that serves the metrics (%s).\n", strerror( errno ) );
+		return ( -1 );
+	}
+	// Wait for the preparation status
+	acquire_preparation_status( si );
+	while ( si->si_prepared == -1 ){
+		wait_preparation_status( si );
+	}
+	prepared = si->si_prepared;
+	release_preparation_status( si );
+	if ( prepared == 0 ){
+		error( "The thread that serves the metrics failed to be initialized.\n" );
+		return ( -1 );
+	}
+	// Must update the statistics here cause one more thread got created
+	acquire_statistics( si );
+	increaseThreadsNum( &si->si_stats );
+	release_statistics( si );
+
+	return ( 0 );
+}
+
+// Start searchListener(); it is prepared once it listens, and indexes the twits of the twit log after that
+static int startSearchListener( struct serverinfo * restrict si ){
+	int prepared;
+
+	assert( si != NULL );
+
+	acquire_preparation_status( si );
+	si->si_prepared = -1;
+	release_preparation_status( si );
+	if ( ( errno = pthread_create( &si->si_search_listener_threadid, NULL, &searchListener, si ) ) ){
+		error( "Failed to start the thread that answers the searches (%s).\n", strerror( errno ) );
+		return ( -1 );
+	}
+	acquire_preparation_status( si );
+	while ( si->si_prepared == -1 ){
+		wait_preparation_status( si );
+	}
+	prepared = si->si_prepared;
+	release_preparation_status( si );
+	if ( prepared == 0 ){
+		error( "The thread that answers the searches failed to be initialized.\n" );
+		return ( -1 );
+	}
+	acquire_statistics( si );
+	increaseThreadsNum( &si->si_stats );
+	release_statistics( si );
+
+	return ( 0 );
+}
+
+// Start trendsListener()
+static int startTrendsListener( struct serverinfo * restrict si ){
+	int prepared;
+
+	assert( si != NULL );
+
+	acquire_preparation_status( si );
+	si->si_prepared = -1;
+	release_preparation_status( si );
+	if ( ( errno = pthread_create( &si->si_trends_listener_threadid, NULL, &trendsListener, si ) ) ){
+		error( "Failed to start the thread that answers what is trending (%s).\n", strerror( errno ) );
+		return ( -1 );
+	}
+	acquire_preparation_status( si );
+	while ( si->si_prepared == -1 ){
+		wait_preparation_status( si );
+	}
+	prepared = si->si_prepared;
+	release_preparation_status( si );
+	if ( prepared == 0 ){
+		error( "The thread that answers what is trending failed to be initialized.\n" );
+		return ( -1 );
+	}
+	acquire_statistics( si );
+	increaseThreadsNum( &si->si_stats );
+	release_statistics( si );
+
+	return ( 0 );
+}
+
 // Set up the fields in *si
 static int initServerinfo( struct serverinfo * restrict si ){
 	struct statistics *st = NULL;
+	int stage;
+	int listener;
+	int slot;
 
 	assert( si != NULL );
 
+	// The statistics of the locks (if kept) are taken in cycles; they must be known before any lock is used
+	calibratecycles();
+	initlockstats();
+
+	// The threads trace in rings of their own
+	if ( inittrace() == -1 ){
+		return ( -1 );
+	}
+
 	// Initialize the serverinfo structure. Note there is no need to lock the various fields
 	// here cause only one thread exists
 	while ( pthread_mutex_init( &si->si_stats_lock, NULL ) ){ continue; }
@@ -274,17 +706,32 @@ static int initServerinfo( struct serverinfo * restrict si ){
 	while ( pthread_mutex_init( &si->si_twitpool_lock, NULL ) ){ continue; }
 	while ( pthread_cond_init( &si->si_twitpool_cond, NULL ) ){ continue; }
 	while ( pthread_mutex_init( &si->si_twitpool_list_lock, NULL ) ){ continue; }
+	while ( pthread_mutex_init( &si->si_topics_lock, NULL ) ){ continue; }
+	while ( pthread_mutex_init( &si->si_keywords_lock, NULL ) ){ continue; }
+	while ( pthread_mutex_init( &si->si_regexes_lock, NULL ) ){ continue; }
+	while ( pthread_mutex_init( &si->si_tags_lock, NULL ) ){ continue; }
 
 	// Init statistics
 	st = &si->si_stats;
 	st->stats_storedTwitsNum = 0;
 	st->stats_threadsNum = 1; // one for the main thread
 	st->stats_hearersNum = 0;
+	st->stats_hearerLagNum = 0;
 	st->stats_sayersNum = 0;
 	st->stats_arrivedTwitsNum = 0;
 	st->stats_deliveredTwitsNum = 0;
-	st->stats_averageTwitsIncomingRate = 0.0;
-	st->stats_averageTwitsOutcomingRate = 0.0;
+	initratewindow( &st->stats_incomingRate );
+	initratewindow( &st->stats_outcomingRate );
+	si->si_stats_snapshot_seq = 0;
+	publish_statistics( si );
+
+	// The statistics page is created with the thread that publishes in it, once a server taken over removed its own
+	si->si_statspage = NULL;
+
+	// Init the latency histograms
+	for ( stage = 0; stage < LATENCY_STAGES; ++stage ){
+		inithistogram( &si->si_latency[ stage ] );
+	}
 
 	// Init twitpool
 	if ( inittwitpool( &si->si_twitpool ) == -1 ){
@@ -296,5 +743,80 @@ static int initServerinfo( struct serverinfo * restrict si ){
 		return ( -1 );
 	}
 
+	// Init the topics, with no subscribers yet, and the bitmap the hearers of each twit are found in
+	inittopics( &si->si_topics );
+	initbitmap( &si->si_fanoutset );
+	si->si_broadcasttwits = 0;
+	si->si_topictwits = 0;
+	si->si_fanout = 0;
+
+	// Init the automaton of the keywords, with none yet
+	if ( initkeywords( &si->si_keywords ) == -1 ){
+		return ( -1 );
+	}
+	si->si_keywordtwits = 0;
+
+	// Init the lazy DFA of the regular expressions, with none yet
+	if ( initregexes( &si->si_regexes, REGEX_CACHE_SIZE, REGEX_CACHE_REGEX_BYTES ) == -1 ){
+		return ( -1 );
+	}
+	si->si_regextwits = 0;
+
+	// Init the index of the hashtags and mentions, with no twits yet, and the code the sayers find them with
+	if ( inittagindex( &si->si_tags ) == -1 ){
+		return ( -1 );
+	}
+	( void )settagscankind( TAGSCAN_SSE2 );
+	si->si_tagtwits = 0;
+	si->si_recenttwits = 0;
+
+	// Init the full-text index, with no twits yet, and the code the searches unpack its postings with
+	if ( initfulltext( &si->si_fulltext ) == -1 ){
+		return ( -1 );
+	}
+	( void )setfulltextkind( FULLTEXT_SSE2 );
+	si->si_fulltext_fromseq = 0;
+	si->si_searches = 0;
+	si->si_searchtwits = 0;
+	si->si_searchdisk = 0;
+	si->si_searchmissing = 0;
+
+	// Init the counts of the tags and the words, with their sketches, which take all the memory they ever will
+	if ( inittrending( &si->si_trending ) == -1 ){
+		return ( -1 );
+	}
+	si->si_trendsqueries = 0;
+
+	// Init the recent history
+	if ( inithistory( &si->si_history ) == -1 ){
+		return ( -1 );
+	}
+	si->si_broadcastseq = 0;
+	si->si_replayed_memory = 0;
+	si->si_replayed_disk = 0;
+
+	// Init the cursors of the hearers and what the snapshot gave back
+	initcursors( &si->si_cursors );
+	si->si_restored = 0;
+	si->si_restored_entries = 0;
+	si->si_restored_cursors = 0;
+	si->si_restored_ns = 0;
+	si->si_snapshots = 0;
+	si->si_snapshot_failures = 0;
+	si->si_snapshot_ns = 0;
+	si->si_snapshot_bytes = 0;
+
+	// No listening socket yet and nobody to hand over to
+	for ( listener = 0; listener < LISTENERS; ++listener ){
+		si->si_listenfds[ listener ] = -1;
+	}
+	si->si_queuedseq = 0;
+	inithandoff( &si->si_handoff );
+	si->si_stopping = 0;
+	// No sayer connected yet
+	for ( slot = 0; slot < SAYERS_MAXCOUNT; ++slot ){
+		si->si_sayerfds[ slot ] = -1;
+	}
+
 	return ( 0 );
 }
@@ -41,11 +41,12 @@ extern "C"{
 #include "serverinfo.h"
 
 /**
- * The initializeServer() function shall initialize the server.
+ * The initializeServer() function shall initialize the server; if parameter restart is nonzero it takes over from the server
+ * running (see handoff.h).
  *
  * @return The initializeServer() function shall return zero if successful; otherwise, -1 shall be returned.
  */
-int initializeServer( struct serverinfo * restrict si );
+int initializeServer( struct serverinfo * restrict si, int restart );
 
 #if defined( __cplusplus )
 }
@@ -0,0 +1,696 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file keywords.c
+ *
+ * File keywords.c contains the implementation of the keywords.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "keywords.h"
+#include "topicframe.h"
+
+#if 9 + HEARER_KEYWORDS_MAXCOUNT * ( KEYWORD_MAXLEN + 1 ) > TOPICFRAME_REQUEST_MAXLEN
+#error "The request line of topicframe.h must fit HEARER_KEYWORDS_MAXCOUNT keywords"
+#endif
+
+// The states the automaton starts with and the most it can have, so the key of a transition fits in 32 bits
+#define KEYWORDS_INITIAL_STATES (64)
+#define KEYWORDS_MAX_STATES ( ( uint32_t )1 << 24 )
+
+// The scan runs behind the prefilter while there are at most KEYWORDS_PREFILTER_MAXCOUNT keywords with subscribers, unless
+// kw_prefiltermax is changed; with more, most positions of a twit are candidates and the prefilter only adds to the work (see
+// benchprefilter.c)
+#define KEYWORDS_PREFILTER_MAXCOUNT (128)
+
+/**
+ * The keywordlen() function shall find the length of the keyword at the start of the string pointed to by parameter words, up to
+ * the first character that cannot be in a keyword or the end.
+ *
+ * @return The length of the keyword; zero if there is none or it is longer than KEYWORD_MAXLEN.
+ */
+static size_t keywordlen( const char * restrict words );
+
+/**
+ * The foldbyte() function shall turn the upper case letter given as parameter c to lower case and leave any other byte as it is.
+ *
+ * @return The byte folded.
+ */
+static unsigned char foldbyte( unsigned char c );
+
+/**
+ * The keywordof() function shall store in the array pointed to by parameter word, of KEYWORD_MAXLEN bytes, the keyword that ends at
+ * the state given as parameter state of the automaton pointed to by parameter kw.
+ *
+ * @return The length of the keyword.
+ */
+static size_t keywordof( const struct keywords * restrict kw, uint32_t state, unsigned char * restrict word );
+
+/**
+ * The edgehome() function shall find the entry of the hash table of the transitions of the automaton pointed to by parameter kw
+ * where the probe for the transition with the key given as parameter key starts.
+ *
+ * @return The index of the entry.
+ */
+static uint32_t edgehome( const struct keywords * restrict kw, uint32_t key );
+
+/**
+ * The transition() function shall find the state the automaton pointed to by parameter kw goes to from the state given as parameter
+ * state on the byte given as parameter byte, in the trie; the failure links are not followed.
+ *
+ * @return The state; zero if there is no such transition.
+ */
+static uint32_t transition( const struct keywords * restrict kw, uint32_t state, unsigned char byte );
+
+/**
+ * The newstate() function shall add to the automaton pointed to by parameter kw a state with no references, and the transition to it
+ * from the state given as parameter parent on the byte given as parameter byte.
+ *
+ * @return The new state; zero if there is not enough memory for it.
+ */
+static uint32_t newstate( struct keywords * restrict kw, uint32_t parent, unsigned char byte );
+
+/**
+ * The releasepath() function shall drop a reference from the state given as parameter state of the automaton pointed to by parameter
+ * kw and from each state before it up to the root, freeing those left with none.
+ *
+ * @return Nothing.
+ */
+static void releasepath( struct keywords * restrict kw, uint32_t state );
+
+/**
+ * The growedges() function shall double the entries of the hash table of the transitions of the automaton pointed to by parameter kw.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ */
+static int growedges( struct keywords * restrict kw );
+
+/**
+ * The insertedge() function shall add to the hash table of the transitions of the automaton pointed to by parameter kw the transition
+ * with the key given as parameter key to the state given as parameter state. The table shall have room for it.
+ *
+ * @return Nothing.
+ */
+static void insertedge( struct keywords * restrict kw, uint32_t key, uint32_t state );
+
+/**
+ * The removeedge() function shall take the transition with the key given as parameter key out of the hash table of the transitions
+ * of the automaton pointed to by parameter kw, moving back the entries after it that would no longer be found.
+ *
+ * @return Nothing.
+ */
+static void removeedge( struct keywords * restrict kw, uint32_t key );
+
+/**
+ * The addfailchild() function shall set the failure link of the state given as parameter state of the automaton pointed to by
+ * parameter kw to the state given as parameter fail and list it among the states that fail to that one.
+ *
+ * @return Nothing.
+ */
+static void addfailchild( struct keywords * restrict kw, uint32_t state, uint32_t fail );
+
+/**
+ * The removefailchild() function shall take the state given as parameter state of the automaton pointed to by parameter kw out of
+ * the list of the states that fail to the one its failure link leads to.
+ *
+ * @return Nothing.
+ */
+static void removefailchild( struct keywords * restrict kw, uint32_t state );
+
+/**
+ * The linkstate() function shall set the links of the state given as parameter state, just added to the trie of the automaton
+ * pointed to by parameter kw, and have the states whose longest suffix in the trie it now is fail to it.
+ *
+ * @return Nothing.
+ */
+static void linkstate( struct keywords * restrict kw, uint32_t state );
+
+/**
+ * The unlinkstate() function shall have the states that fail to the state given as parameter state of the automaton pointed to by
+ * parameter kw, which is about to be freed, fail to where it does.
+ *
+ * @return Nothing.
+ */
+static void unlinkstate( struct keywords * restrict kw, uint32_t state );
+
+/**
+ * The spreadoutput() function shall set the output links of the states that fail to the state given as parameter state of the
+ * automaton pointed to by parameter kw, directly or through states where no keyword ends, after the state got its first subscriber
+ * or lost its last one.
+ *
+ * @return Nothing.
+ */
+static void spreadoutput( struct keywords * restrict kw, uint32_t state );
+
+
+
+int initkeywords( struct keywords * restrict kw ){
+	assert( kw != NULL );
+
+	( void )memset( kw, 0, sizeof( *kw ) );
+	kw->kw_states = calloc( KEYWORDS_INITIAL_STATES, sizeof( *kw->kw_states ) );
+	kw->kw_stack = malloc( KEYWORDS_INITIAL_STATES * sizeof( *kw->kw_stack ) );
+	kw->kw_edges = calloc( 2 * KEYWORDS_INITIAL_STATES, sizeof( *kw->kw_edges ) );
+	if ( kw->kw_states == NULL || kw->kw_stack == NULL || kw->kw_edges == NULL ){
+		delkeywords( kw );
+		errno = ENOMEM;
+		return ( -1 );
+	}
+	kw->kw_capacity = KEYWORDS_INITIAL_STATES;
+	kw->kw_edgemask = 2 * KEYWORDS_INITIAL_STATES - 1;
+	// The root is there from the start and never freed
+	kw->kw_top = 1;
+	kw->kw_statecount = 1;
+	initprefilter( &kw->kw_prefilter );
+	kw->kw_prefiltermax = KEYWORDS_PREFILTER_MAXCOUNT;
+
+	return ( 0 );
+}
+
+void delkeywords( struct keywords * restrict kw ){
+	uint32_t state;
+
+	assert( kw != NULL );
+
+	for ( state = 0; kw->kw_states != NULL && state < kw->kw_top; ++state ){
+		delbitmap( &kw->kw_states[ state ].kst_hearers );
+	}
+	free( kw->kw_edges );
+	free( kw->kw_stack );
+	free( kw->kw_states );
+	kw->kw_edges = NULL;
+	kw->kw_stack = NULL;
+	kw->kw_states = NULL;
+
+	return ;
+}
+
+int validkeywords( const char * restrict words ){
+	size_t len;
+	int count = 0;
+
+	assert( words != NULL );
+
+	while ( *words != '\0' ){
+		if ( ( len = keywordlen( words ) ) == 0 || ++count > HEARER_KEYWORDS_MAXCOUNT ){
+			return ( 0 );
+		}
+		words += len;
+		// A space is followed by a keyword
+		if ( *words != '\0' ){
+			if ( *words != ' ' || *++words == '\0' ){
+				return ( 0 );
+			}
+		}
+	}
+
+	return ( count > 0 );
+}
+
+// The states of each keyword are referenced as it goes down the trie, so a failure half way releases them as unsubscribing would
+int subscribekeywords( struct keywords * restrict kw, struct keywordsubscriber * restrict ksr, struct twitpoollist_node * restrict tpln,
+	const char * restrict words ){
+	struct keywordstate *kst = NULL;
+	const char *word = NULL;
+	unsigned char folded[ KEYWORD_MAXLEN ];
+	size_t len;
+	size_t i;
+	uint32_t state;
+	uint32_t next;
+	int j;
+
+	assert( kw != NULL );
+	assert( ksr != NULL );
+	assert( tpln != NULL );
+	assert( words != NULL );
+
+	if ( !validkeywords( words ) ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	ksr->ksr_tpln = tpln;
+	ksr->ksr_count = 0;
+	for ( word = words; *word != '\0'; word += len + ( word[ len ] == ' ' ) ){
+		len = keywordlen( word );
+		for ( state = 0, i = 0; i < len; ++i, state = next ){
+			if ( ( next = transition( kw, state, foldbyte( ( unsigned char )word[ i ] ) ) ) == 0 &&
+				( next = newstate( kw, state, foldbyte( ( unsigned char )word[ i ] ) ) ) == 0 ){
+				releasepath( kw, state );
+				unsubscribekeywords( kw, ksr );
+				errno = ENOMEM;
+				return ( -1 );
+			}
+			++kw->kw_states[ next ].kst_refs;
+			folded[ i ] = foldbyte( ( unsigned char )word[ i ] );
+		}
+		for ( j = 0; j < ksr->ksr_count && ksr->ksr_states[ j ] != state; ++j ){
+			continue;
+		}
+		if ( j < ksr->ksr_count ){
+			releasepath( kw, state );
+			continue;
+		}
+		kst = &kw->kw_states[ state ];
+		if ( addtobitmap( &kst->kst_hearers, tpln->tpln_hearer ) == -1 ){
+			// A state freed must not keep storage
+			if ( kst->kst_subscribers == 0 ){
+				delbitmap( &kst->kst_hearers );
+			}
+			releasepath( kw, state );
+			unsubscribekeywords( kw, ksr );
+			errno = ENOMEM;
+			return ( -1 );
+		}
+		ksr->ksr_states[ ksr->ksr_count++ ] = state;
+		// The output links change only when a keyword gets its first subscriber or loses its last one
+		if ( kst->kst_subscribers++ == 0 ){
+			( void )__atomic_fetch_add( &kw->kw_count, 1, __ATOMIC_RELAXED );
+			spreadoutput( kw, state );
+			addtoprefilter( &kw->kw_prefilter, folded, len );
+		}
+	}
+
+	return ( ksr->ksr_count );
+}
+
+// The bitmap of a keyword frees its storage with the last subscriber, before the state may be freed
+void unsubscribekeywords( struct keywords * restrict kw, struct keywordsubscriber * restrict ksr ){
+	unsigned char word[ KEYWORD_MAXLEN ];
+	uint32_t state;
+	int i;
+
+	assert( kw != NULL );
+	assert( ksr != NULL );
+
+	for ( i = 0; i < ksr->ksr_count; ++i ){
+		state = ksr->ksr_states[ i ];
+		removefrombitmap( &kw->kw_states[ state ].kst_hearers, ksr->ksr_tpln->tpln_hearer );
+		assert( kw->kw_states[ state ].kst_subscribers > 0 );
+		if ( --kw->kw_states[ state ].kst_subscribers == 0 ){
+			( void )__atomic_fetch_sub( &kw->kw_count, 1, __ATOMIC_RELAXED );
+			spreadoutput( kw, state );
+			removefromprefilter( &kw->kw_prefilter, word, keywordof( kw, state, word ) );
+		}
+		releasepath( kw, state );
+	}
+	ksr->ksr_count = 0;
+
+	return ;
+}
+
+// The hearers of a keyword are added the first time it is found; found again, it is skipped by the number of the scan, and so are
+// the keywords after it along the output links, which were found with it. Back at the root, the automaton would stay there until
+// a keyword can start, which is where the prefilter takes it
+int matchkeywords( struct keywords * restrict kw, const char * restrict text, size_t len, struct bitmap * restrict matched ){
+	struct keywordstate *states = NULL;
+	unsigned long scan;
+	uint32_t state = 0;
+	uint32_t next;
+	uint32_t out;
+	size_t i;
+	size_t skip;
+	int found = 0;
+	int filter;
+
+	assert( kw != NULL );
+	assert( text != NULL || len == 0 );
+	assert( matched != NULL );
+
+	if ( kw->kw_count == 0 ){
+		return ( 0 );
+	}
+	states = kw->kw_states;
+	scan = ++kw->kw_scan;
+	filter = kw->kw_count <= kw->kw_prefiltermax;
+
+	for ( i = 0; i < len; ++i ){
+		if ( state == 0 && filter ){
+			if ( ( skip = prefilter( &kw->kw_prefilter, ( const unsigned char * )text + i, len - i ) ) == len - i ){
+				if ( i == 0 ){
+					( void )__atomic_fetch_add( &kw->kw_filtered, 1, __ATOMIC_RELAXED );
+				}
+				break;
+			}
+			i += skip;
+		}
+		while ( ( next = transition( kw, state, foldbyte( ( unsigned char )text[ i ] ) ) ) == 0 && state != 0 ){
+			state = states[ state ].kst_fail;
+		}
+		state = next;
+		for ( out = states[ state ].kst_subscribers != 0 ? state : states[ state ].kst_output; out != 0 && states[ out ].kst_scan != scan;
+			out = states[ out ].kst_output ){
+			states[ out ].kst_scan = scan;
+			if ( orbitmap( matched, &states[ out ].kst_hearers ) == -1 ){
+				return ( -1 );
+			}
+			++found;
+		}
+	}
+
+	return ( found );
+}
+
+
+
+// Implementation of local functions...
+
+// Anything printable but the space; it needs no escaping in the request line
+static size_t keywordlen( const char * restrict words ){
+	size_t len;
+
+	for ( len = 0; words[ len ] > ' ' && words[ len ] <= '~'; ++len ){
+		continue;
+	}
+
+	return ( len <= KEYWORD_MAXLEN ? len : 0 );
+}
+
+static unsigned char foldbyte( unsigned char c ){
+	return ( c >= 'A' && c <= 'Z' ? ( unsigned char )( c - 'A' + 'a' ) : c );
+}
+
+// The depth of the state first, then the bytes from the last one up
+static size_t keywordof( const struct keywords * restrict kw, uint32_t state, unsigned char * restrict word ){
+	size_t len = 0;
+	size_t i;
+	uint32_t s;
+
+	for ( s = state; s != 0; s = kw->kw_states[ s ].kst_parent ){
+		++len;
+	}
+	assert( len <= KEYWORD_MAXLEN );
+	for ( s = state, i = len; s != 0; s = kw->kw_states[ s ].kst_parent ){
+		word[ --i ] = kw->kw_states[ s ].kst_byte;
+	}
+
+	return ( len );
+}
+
+// The keys of the children of a state are consecutive, so they are mixed before they are masked
+static uint32_t edgehome( const struct keywords * restrict kw, uint32_t key ){
+	key *= UINT32_C( 0x9e3779b1 );
+
+	return ( ( key ^ ( key >> 16 ) ) & kw->kw_edgemask );
+}
+
+// The table is never more than half full, so a free entry ends every probe
+static uint32_t transition( const struct keywords * restrict kw, uint32_t state, unsigned char byte ){
+	const struct keywordedge *edge = NULL;
+	uint32_t key;
+	uint32_t index;
+
+	if ( state == 0 ){
+		return ( kw->kw_root[ byte ] );
+	}
+	key = ( state << 8 ) | byte;
+	for ( index = edgehome( kw, key ); ; index = ( index + 1 ) & kw->kw_edgemask ){
+		edge = &kw->kw_edges[ index ];
+		if ( edge->ke_state == 0 || edge->ke_key == key ){
+			return ( edge->ke_state );
+		}
+	}
+}
+
+// The states are referred to by their index, so they can be moved when there are more of them
+static uint32_t newstate( struct keywords * restrict kw, uint32_t parent, unsigned char byte ){
+	struct keywordstate *states = NULL;
+	uint32_t *stack = NULL;
+	uint32_t state;
+
+	if ( kw->kw_free == 0 && kw->kw_top == kw->kw_capacity ){
+		if ( kw->kw_capacity == KEYWORDS_MAX_STATES ){
+			return ( 0 );
+		}
+		if ( ( states = realloc( kw->kw_states, 2 * kw->kw_capacity * sizeof( *states ) ) ) == NULL ){
+			return ( 0 );
+		}
+		kw->kw_states = states;
+		if ( ( stack = realloc( kw->kw_stack, 2 * kw->kw_capacity * sizeof( *stack ) ) ) == NULL ){
+			return ( 0 );
+		}
+		kw->kw_stack = stack;
+		kw->kw_capacity *= 2;
+	}
+	if ( parent != 0 && 2 * ( kw->kw_edgecount + 1 ) > kw->kw_edgemask + 1 && growedges( kw ) == -1 ){
+		return ( 0 );
+	}
+
+	if ( kw->kw_free != 0 ){
+		state = kw->kw_free;
+		kw->kw_free = kw->kw_states[ state ].kst_sibling;
+	}
+	else{
+		state = kw->kw_top++;
+	}
+	( void )memset( &kw->kw_states[ state ], 0, sizeof( kw->kw_states[ state ] ) );
+	kw->kw_states[ state ].kst_parent = parent;
+	kw->kw_states[ state ].kst_byte = byte;
+	kw->kw_states[ state ].kst_sibling = kw->kw_states[ parent ].kst_child;
+	kw->kw_states[ parent ].kst_child = state;
+	if ( parent == 0 ){
+		kw->kw_root[ byte ] = state;
+	}
+	else{
+		insertedge( kw, ( parent << 8 ) | byte, state );
+	}
+	linkstate( kw, state );
+	( void )__atomic_fetch_add( &kw->kw_statecount, 1, __ATOMIC_RELAXED );
+
+	return ( state );
+}
+
+// A state is referenced by every keyword through it, so one left with none has no children either
+static void releasepath( struct keywords * restrict kw, uint32_t state ){
+	struct keywordstate *kst = NULL;
+	uint32_t *link = NULL;
+	uint32_t parent;
+
+	for ( ; state != 0; state = parent ){
+		kst = &kw->kw_states[ state ];
+		parent = kst->kst_parent;
+		assert( kst->kst_refs > 0 );
+		if ( --kst->kst_refs > 0 ){
+			continue;
+		}
+		assert( kst->kst_child == 0 && kst->kst_subscribers == 0 );
+		unlinkstate( kw, state );
+		if ( parent == 0 ){
+			kw->kw_root[ kst->kst_byte ] = 0;
+		}
+		else{
+			removeedge( kw, ( parent << 8 ) | kst->kst_byte );
+		}
+		for ( link = &kw->kw_states[ parent ].kst_child; *link != state; link = &kw->kw_states[ *link ].kst_sibling ){
+			assert( *link != 0 );
+		}
+		*link = kst->kst_sibling;
+		kst->kst_sibling = kw->kw_free;
+		kw->kw_free = state;
+		( void )__atomic_fetch_sub( &kw->kw_statecount, 1, __ATOMIC_RELAXED );
+	}
+
+	return ;
+}
+
+static int growedges( struct keywords * restrict kw ){
+	struct keywordedge *old = kw->kw_edges;
+	uint32_t oldsize = kw->kw_edgemask + 1;
+	uint32_t index;
+
+	if ( ( kw->kw_edges = calloc( 2 * ( size_t )oldsize, sizeof( *kw->kw_edges ) ) ) == NULL ){
+		kw->kw_edges = old;
+		return ( -1 );
+	}
+	kw->kw_edgemask = 2 * oldsize - 1;
+	kw->kw_edgecount = 0;
+	for ( index = 0; index < oldsize; ++index ){
+		if ( old[ index ].ke_state != 0 ){
+			insertedge( kw, old[ index ].ke_key, old[ index ].ke_state );
+		}
+	}
+	free( old );
+
+	return ( 0 );
+}
+
+static void insertedge( struct keywords * restrict kw, uint32_t key, uint32_t state ){
+	uint32_t index;
+
+	for ( index = edgehome( kw, key ); kw->kw_edges[ index ].ke_state != 0; index = ( index + 1 ) & kw->kw_edgemask ){
+		continue;
+	}
+	kw->kw_edges[ index ].ke_key = key;
+	kw->kw_edges[ index ].ke_state = state;
+	++kw->kw_edgecount;
+
+	return ;
+}
+
+// Deleting without tombstones keeps the probes as short as if the transition had never been there, as removetopic() does
+static void removeedge( struct keywords * restrict kw, uint32_t key ){
+	uint32_t hole;
+	uint32_t index;
+	uint32_t home;
+
+	for ( hole = edgehome( kw, key ); kw->kw_edges[ hole ].ke_key != key || kw->kw_edges[ hole ].ke_state == 0;
+		hole = ( hole + 1 ) & kw->kw_edgemask ){
+		assert( kw->kw_edges[ hole ].ke_state != 0 );
+	}
+	for ( index = ( hole + 1 ) & kw->kw_edgemask; kw->kw_edges[ index ].ke_state != 0; index = ( index + 1 ) & kw->kw_edgemask ){
+		// The entry stays if its probe starts after the hole
+		home = edgehome( kw, kw->kw_edges[ index ].ke_key );
+		if ( ( ( index - home ) & kw->kw_edgemask ) < ( ( index - hole ) & kw->kw_edgemask ) ){
+			continue;
+		}
+		kw->kw_edges[ hole ] = kw->kw_edges[ index ];
+		hole = index;
+	}
+	kw->kw_edges[ hole ].ke_state = 0;
+	--kw->kw_edgecount;
+
+	return ;
+}
+
+static void addfailchild( struct keywords * restrict kw, uint32_t state, uint32_t fail ){
+	struct keywordstate *states = kw->kw_states;
+
+	states[ state ].kst_fail = fail;
+	states[ state ].kst_failprev = 0;
+	states[ state ].kst_failnext = states[ fail ].kst_failchild;
+	if ( states[ fail ].kst_failchild != 0 ){
+		states[ states[ fail ].kst_failchild ].kst_failprev = state;
+	}
+	states[ fail ].kst_failchild = state;
+
+	return ;
+}
+
+// Doubly linked, since most of the states fail to the root
+static void removefailchild( struct keywords * restrict kw, uint32_t state ){
+	struct keywordstate *states = kw->kw_states;
+
+	if ( states[ state ].kst_failprev != 0 ){
+		states[ states[ state ].kst_failprev ].kst_failnext = states[ state ].kst_failnext;
+	}
+	else{
+		states[ states[ state ].kst_fail ].kst_failchild = states[ state ].kst_failnext;
+	}
+	if ( states[ state ].kst_failnext != 0 ){
+		states[ states[ state ].kst_failnext ].kst_failprev = states[ state ].kst_failprev;
+	}
+
+	return ;
+}
+
+// The states that should now fail to the new one are the children on its byte of the states that fail to its parent, and they
+// failed to where the new one does. Below a state with such a child the children on the byte fail to that child, so the walk stops
+static void linkstate( struct keywords * restrict kw, uint32_t state ){
+	struct keywordstate *states = kw->kw_states;
+	uint32_t parent = states[ state ].kst_parent;
+	unsigned char byte = states[ state ].kst_byte;
+	uint32_t fail = 0;
+	uint32_t top = 0;
+	uint32_t next;
+	uint32_t child;
+
+	if ( parent != 0 ){
+		for ( fail = states[ parent ].kst_fail; ( next = transition( kw, fail, byte ) ) == 0 && fail != 0; ){
+			fail = states[ fail ].kst_fail;
+		}
+		fail = next;
+	}
+	addfailchild( kw, state, fail );
+	states[ state ].kst_output = states[ fail ].kst_subscribers != 0 ? fail : states[ fail ].kst_output;
+
+	for ( child = states[ parent ].kst_failchild; child != 0; child = states[ child ].kst_failnext ){
+		kw->kw_stack[ top++ ] = child;
+	}
+	while ( top > 0 ){
+		next = kw->kw_stack[ --top ];
+		if ( next == state ){
+			continue;
+		}
+		if ( ( child = transition( kw, next, byte ) ) != 0 ){
+			// Its output link stays, the new state has no subscribers yet
+			assert( states[ child ].kst_fail == fail );
+			removefailchild( kw, child );
+			addfailchild( kw, child, state );
+			( void )__atomic_fetch_add( &kw->kw_relinked, 1, __ATOMIC_RELAXED );
+			continue;
+		}
+		for ( child = states[ next ].kst_failchild; child != 0; child = states[ child ].kst_failnext ){
+			kw->kw_stack[ top++ ] = child;
+		}
+	}
+
+	return ;
+}
+
+// The longest suffix of those states after the one freed is where it fails to; with no subscribers it had the same output link
+static void unlinkstate( struct keywords * restrict kw, uint32_t state ){
+	struct keywordstate *states = kw->kw_states;
+	uint32_t child;
+
+	while ( ( child = states[ state ].kst_failchild ) != 0 ){
+		removefailchild( kw, child );
+		addfailchild( kw, child, states[ state ].kst_fail );
+		( void )__atomic_fetch_add( &kw->kw_relinked, 1, __ATOMIC_RELAXED );
+	}
+	removefailchild( kw, state );
+
+	return ;
+}
+
+// A state where a keyword ends keeps the output links below it pointing to itself, so the walk stops there
+static void spreadoutput( struct keywords * restrict kw, uint32_t state ){
+	struct keywordstate *states = kw->kw_states;
+	uint32_t output = states[ state ].kst_subscribers != 0 ? state : states[ state ].kst_output;
+	uint32_t top = 0;
+	uint32_t next;
+	uint32_t child;
+
+	for ( child = states[ state ].kst_failchild; child != 0; child = states[ child ].kst_failnext ){
+		kw->kw_stack[ top++ ] = child;
+	}
+	while ( top > 0 ){
+		next = kw->kw_stack[ --top ];
+		states[ next ].kst_output = output;
+		( void )__atomic_fetch_add( &kw->kw_relinked, 1, __ATOMIC_RELAXED );
+		if ( states[ next ].kst_subscribers != 0 ){
+			continue;
+		}
+		for ( child = states[ next ].kst_failchild; child != 0; child = states[ child ].kst_failnext ){
+			kw->kw_stack[ top++ ] = child;
+		}
+	}
+
+	return ;
+}
@@ -0,0 +1,192 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file keywords.h
+ *
+ * File keywords.h declares the keywords the hearers subscribe to (see topicframe.h). The keywords of all the hearers are compiled
+ * into one Aho-Corasick automaton, so the twitpool consumer scans each twit once and finds the hearers with a keyword in it as it
+ * goes, at a cost that depends on the length of the twit and on what matched, not on how many keywords and hearers there are. Each
+ * state where a keyword ends has the bitmap of the numbers of the twitpools of its subscribers (see bitmap.h), which the scan adds
+ * to the result once for each keyword found.
+ *
+ * The automaton is the trie of the keywords, in lower case, with a failure link from each state to the state of the longest proper
+ * suffix of its string that is in the trie, and an output link to the nearest state along the failure links where a keyword ends.
+ * The links are kept as the keywords come and go rather than computed again for the whole trie: each state also lists the states
+ * whose failure link leads to it, so a new state takes over only the states that should now fail to it, a state freed hands its
+ * own over to its failure link, and a keyword that gets its first subscriber, or loses its last one, changes the output links of
+ * the states that fail to it and no others. Only the states no other keyword goes through are added or freed.
+ *
+ * The transitions are kept in a hash table keyed by the state and the byte, except those of the root, where the scan spends most of
+ * its time, which has a table of its own. While there are few keywords, the scan runs behind a prefilter (see prefilter.h), which
+ * skips over the bytes where none of them can start, a vector at a time, whenever the automaton is back at the root. The keywords are
+ * guarded by si_keywords_lock.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( KEYWORDS_H_IS_INCLUDED )
+#define KEYWORDS_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "twitpoollist.h"
+#include "prefilter.h"
+#include "bitmap.h"
+#include "config.h"
+
+/**
+ * \struct keywordsubscriber
+ *
+ * The keywordsubscriber structure holds the subscriptions of a hearer, the state where each of its keywords ends.
+ */
+struct keywordsubscriber{
+	struct twitpoollist_node *ksr_tpln;
+	int ksr_count; /**< Number of subscriptions; zero if the hearer has no keywords */
+	uint32_t ksr_states[ HEARER_KEYWORDS_MAXCOUNT ];
+};
+
+/**
+ * \struct keywordstate
+ *
+ * The keywordstate structure is a state of the automaton; the state zero is the root. A state that is free is linked in the free
+ * list through kst_sibling.
+ */
+struct keywordstate{
+	uint32_t kst_fail; /**< The failure link */
+	uint32_t kst_failchild; /**< The first state whose failure link leads here, linked through kst_failnext and kst_failprev */
+	uint32_t kst_failnext;
+	uint32_t kst_failprev;
+	uint32_t kst_output; /**< The output link; zero if no keyword ends along the failure links */
+	uint32_t kst_parent;
+	uint32_t kst_child; /**< The first of the children, linked through kst_sibling; zero if there are none */
+	uint32_t kst_sibling;
+	uint32_t kst_refs; /**< Number of keywords subscribed to that go through the state; zero if it is free */
+	unsigned char kst_byte; /**< The byte of the transition from the parent */
+	uint32_t kst_subscribers; /**< Number of hearers whose keyword ends here */
+	unsigned long kst_scan; /**< The last scan that found the keyword, so its hearers are added once for each twit */
+	struct bitmap kst_hearers; /**< The numbers of the twitpools of those hearers */
+};
+
+/**
+ * \struct keywordedge
+ *
+ * The keywordedge structure is an entry of the hash table of the transitions; ke_state is zero if the entry is free.
+ */
+struct keywordedge{
+	uint32_t ke_key; /**< The state the transition leaves, shifted left by 8 bits, and the byte */
+	uint32_t ke_state;
+};
+
+/**
+ * \struct keywords
+ *
+ * The keywords structure is the automaton. The counts are updated atomically, so the statistics read them without the lock.
+ */
+struct keywords{
+	struct keywordstate *kw_states;
+	uint32_t *kw_stack; /**< For walking the states that fail to one, as many entries as kw_states */
+	uint32_t kw_capacity; /**< Entries of kw_states */
+	uint32_t kw_top; /**< States ever used; those after it have never been */
+	uint32_t kw_free; /**< The first free state below kw_top; zero if there is none */
+	struct keywordedge *kw_edges; /**< Open addressed with linear probing */
+	uint32_t kw_edgemask; /**< Entries of kw_edges minus one, a power of two */
+	uint32_t kw_edgecount;
+	uint32_t kw_root[ 256 ]; /**< The transitions of the root */
+	unsigned long kw_scan; /**< Number of twits scanned */
+	size_t kw_count; /**< Keywords with subscribers */
+	size_t kw_statecount; /**< States in use, the root included */
+	uint64_t kw_relinked; /**< Number of links changed for states other than those added and freed */
+	struct prefilter kw_prefilter; /**< Has the keywords with subscribers */
+	size_t kw_prefiltermax; /**< The scan runs behind the prefilter while there are at most that many keywords with subscribers */
+	uint64_t kw_filtered; /**< Number of twits the prefilter found no keyword could be in */
+};
+
+
+
+/**
+ * The initkeywords() function shall initialize the automaton pointed to by parameter kw with no keywords.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate
+ *	the error.
+ * @exception ENOMEM There is not enough memory.
+ */
+int initkeywords( struct keywords * restrict kw );
+
+/**
+ * The delkeywords() function shall free the memory of the automaton pointed to by parameter kw.
+ *
+ * @return Nothing.
+ */
+void delkeywords( struct keywords * restrict kw );
+
+/**
+ * The validkeywords() function shall check that the string pointed to by parameter words is what follows "KEYWORDS " in the request
+ * line of topicframe.h: one to HEARER_KEYWORDS_MAXCOUNT keywords separated by single spaces.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+int validkeywords( const char * restrict words );
+
+/**
+ * The subscribekeywords() function shall subscribe the twitpool pointed to by parameter tpln to the keywords in the string pointed
+ * to by parameter words, as validkeywords() checks it, through the structure pointed to by parameter ksr. A keyword repeated, the
+ * case of its letters aside, is subscribed to once.
+ *
+ * @return Upon successful completion the number of subscriptions shall be returned; otherwise, -1 shall be returned, nothing
+ *	shall be subscribed to and errno shall be set to indicate the error.
+ * @exception EINVAL The keywords are not valid.
+ * @exception ENOMEM There is not enough memory for the states of the keywords or their bitmaps.
+ */
+int subscribekeywords( struct keywords * restrict kw, struct keywordsubscriber * restrict ksr, struct twitpoollist_node * restrict tpln,
+	const char * restrict words );
+
+/**
+ * The unsubscribekeywords() function shall undo the subscriptions in the structure pointed to by parameter ksr, as subscribekeywords()
+ * made them. The structure is left with none.
+ *
+ * @return Nothing.
+ */
+void unsubscribekeywords( struct keywords * restrict kw, struct keywordsubscriber * restrict ksr );
+
+/**
+ * The matchkeywords() function shall scan the len bytes pointed to by parameter text and add to the bitmap pointed to by parameter
+ * matched the numbers of the twitpools of the hearers with a keyword in them.
+ *
+ * @return Upon successful completion the number of keywords with subscribers found shall be returned, each once; otherwise, -1
+ *	shall be returned and errno shall be set to indicate the error.
+ * @exception ENOMEM Insufficient storage space for the bitmap.
+ */
+int matchkeywords( struct keywords * restrict kw, const char * restrict text, size_t len, struct bitmap * restrict matched );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -40,9 +40,11 @@
 #include <pthread.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <poll.h>
 #include "serverinfo.h"
 #include "listen.h"
 #include "conn.h"
+#include "cursors.h"
 #include "config.h"
 #include "util.h"
 #include "error.h"
@@ -51,6 +53,9 @@ struct listenerinfo{
 	struct serverinfo *li_serverinfo;
 	pthread_attr_t li_threadattr;
 	int li_sockfd;
+	int li_durablesockfd; /**< Only the sayersListener listens for durable sayers */
+	int li_resumingsockfd; /**< Only the hearersListener listens for resuming hearers */
+	int li_topicsockfd; /**< and for hearers of topics */
 };
 
 /**
@@ -173,11 +178,12 @@ int prepareListenerSocket( int port ){
  * sayersListener() runs on its own thread and is responsible for accepting connections from sayers. 
  * The port to which the sayersListener() function will listen for sayers is obtained from config.h (SAYERS_PORT).
  * The steps the sayersListener() function takes are:
- *	1) The socket that will listen for sayers at the port SAYERS_PORT is created.
+ *	1) The sockets that will listen for sayers at the ports SAYERS_PORT and DURABLE_SAYERS_PORT are created.
  *	2) If successfull (the above step) the sayersListener() function notifies through the serverinfo structure
  *	passed as parameter that is prepared.
- *	3) It waits for a connection from a sayer and if a connection arrives: 
- *		1) Start a new thread that handles the connection with the sayer sayerConnectionHandler().
+ *	3) It waits for a connection from a sayer on either socket and if a connection arrives: 
+ *		1) Start a new thread that handles the connection with the sayer sayerConnectionHandler(), telling it whether
+ *		the sayer came to DURABLE_SAYERS_PORT and so waits for each twit to be acknowledged.
  *		2) Update the statistics structure (a new sayer arrived).
  */
 void *sayersListener( void *arg ){
@@ -185,8 +191,13 @@ void *sayersListener( void *arg ){
 	struct connserverinfo *csi = NULL; // Malloced each time a connection arrives
 	pthread_t threadid; // Used for the threads created to handle the connections
 	int connsockfd = -1; // The socket from each connection arriving
+	struct pollfd fds[ 2 ]; // The two listening sockets
+	int durable; // Whether the connection arrived at DURABLE_SAYERS_PORT
+	int cancelstate; // Restored once there is room for a sayer
 	struct listenerinfo li = {
-		.li_serverinfo = si
+		.li_serverinfo = si,
+		.li_sockfd = -1,
+		.li_durablesockfd = -1
 	};
 
 	assert( si != NULL );
@@ -201,17 +212,33 @@ void *sayersListener( void *arg ){
 	
 	// Wait for connections
 	while ( 1 ){
-		// Do not accept any more connections if we are full of sayers
+		// Do not accept any more connections if we are full of sayers. The listener is not cancelled while it waits, or it
+		// would leave the statistics locked for the server that goes on handing itself over (see handoff.h)
+		( void )pthread_setcancelstate( PTHREAD_CANCEL_DISABLE, &cancelstate );
 		acquire_statistics( si );
 		assert( si->si_stats.stats_sayersNum <= SAYERS_MAXCOUNT );		
 		while ( si->si_stats.stats_sayersNum == SAYERS_MAXCOUNT ){
-			while ( pthread_cond_wait( &si->si_stats_sayers_cond, &si->si_stats_lock ) ){ continue; }
+			wait_statistics( si, &si->si_stats_sayers_cond );
 		}
 		assert( si->si_stats.stats_sayersNum < SAYERS_MAXCOUNT );
 		release_statistics( si );
+		( void )pthread_setcancelstate( cancelstate, NULL );
 
+		// Wait until a sayer arrives at either port
+		fds[ 0 ].fd = li.li_sockfd;
+		fds[ 1 ].fd = li.li_durablesockfd;
+		fds[ 0 ].events = fds[ 1 ].events = POLLIN;
 		errno = 0;
-		if ( ( connsockfd = accept( li.li_sockfd, NULL, NULL ) ) == -1 ){
+		if ( poll( fds, 2, -1 ) == -1 ){
+			if ( errno != EINTR ){
+				error( "poll() failed in sayersListener() (%s)\n", strerror( errno ) );
+			}
+			continue;
+		}
+		durable = ( fds[ 0 ].revents == 0 );
+
+		errno = 0;
+		if ( ( connsockfd = accept( durable ? li.li_durablesockfd : li.li_sockfd, NULL, NULL ) ) == -1 ){
 			error( "accept() failed in sayersListener() (%s)\n", strerror( errno ) );
 			continue;
 		}
@@ -226,11 +253,26 @@ void *sayersListener( void *arg ){
 		}
 		csi->csi_serverinfo = si;
 		csi->csi_sockfd = connsockfd;
+		csi->csi_durable = durable;
+		csi->csi_sayerslot = 0;
+		csi->csi_resume = 0;
+		csi->csi_boundary = 0;
+		csi->csi_cursor = -1;
+		csi->csi_handoff = 0;
 
 		// CAUTION: the statistics must be locked before the thread is created cause in case the connection gets closed
 		// before the nums are increased here and the created thread decreases the nums then we have an error.
  		// So lock the statistics beforehand to avoid any race condition		
 		acquire_statistics( si );
+		// There is a free slot for the socket, as there are fewer than SAYERS_MAXCOUNT sayers. One that arrives once stopsayers()
+		// went through the slots is shut down here
+		while ( si->si_sayerfds[ csi->csi_sayerslot ] != -1 ){
+			++csi->csi_sayerslot;
+		}
+		assert( csi->csi_sayerslot < SAYERS_MAXCOUNT );
+		if ( __atomic_load_n( &si->si_stopping, __ATOMIC_RELAXED ) ){
+			( void )shutdown( connsockfd, SHUT_RDWR );
+		}
 		// Create the new thread to handle the connection
 		if ( ( errno = pthread_create( &threadid, &li.li_threadattr, &sayerConnectionHandler, csi ) ) ){
 			error( "pthread_create() failed in sayersListener() (%s)\n", strerror( errno ) );
@@ -242,6 +284,7 @@ void *sayersListener( void *arg ){
 		}
 		else{
 			// Update the statistics that a new sayer was connected
+			si->si_sayerfds[ csi->csi_sayerslot ] = connsockfd;
 			increaseSayersNum( &si->si_stats );
 			increaseThreadsNum( &si->si_stats );
 		}
@@ -259,21 +302,24 @@ void *sayersListener( void *arg ){
  * hearersListener() runs on its own thread and is responsible for accepting connections from hearers. 
  * The port to which the hearersListener() function will listen for hearers is obtained from config.h (HEARERS_PORT).
  * The steps the hearersListener() function takes are:
- *	1) The socket that will listen for hearers at the port HEARERS_PORT is created.
+ *	1) The sockets that will listen for hearers at the ports HEARERS_PORT, RESUMING_HEARERS_PORT and TOPIC_HEARERS_PORT are created.
  *	2) If successfull (the above step) the hearersListener() function notifies through the serverinfo structure
  *	passed as parameter that is prepared.
- *	3) It waits for a connection from a hearer and if a connection arrives: 
- *		1) Start a new thread that handles the connection with the hearer hearerConnectionHandler().
- *		2) Update the statistics structure (a new hearer arrived).
+ *	3) It waits for a connection from a hearer on any socket and if a connection arrives it is started with starthearer(),
+ *	on the global topic unless it came to TOPIC_HEARERS_PORT to name its topics.
  */
 void *hearersListener( void *arg ){
 	struct serverinfo *si = ( struct serverinfo * )arg;
-	struct connserverinfo *csi = NULL; // Malloced each time a connection arrives
-	struct twitpoollist_node *tpln = NULL; // used for the twitpoollist_node of each hearer
-	pthread_t threadid; // Used for the threads created to handle the connections
 	int connsockfd = -1; // The socket from each connection arriving
+	struct pollfd fds[ 3 ]; // The three listening sockets
+	int resume; // Whether the connection arrived at RESUMING_HEARERS_PORT
+	int topics; // Whether the connection arrived at TOPIC_HEARERS_PORT
+	int cancelstate; // Restored once there is room for a hearer
 	struct listenerinfo li = {
-		.li_serverinfo = si
+		.li_serverinfo = si,
+		.li_sockfd = -1,
+		.li_resumingsockfd = -1,
+		.li_topicsockfd = -1
 	};
 
 	assert( si != NULL );
@@ -288,84 +334,275 @@ void *hearersListener( void *arg ){
 
 	// Wait for connections
 	while ( 1 ){
-		// Do not accept any more connections if we are full of hearers
+		// Do not accept any more connections if we are full of hearers; not cancelled meanwhile, as above
+		( void )pthread_setcancelstate( PTHREAD_CANCEL_DISABLE, &cancelstate );
 		acquire_statistics( si );
 		assert( si->si_stats.stats_hearersNum <= HEARERS_MAXCOUNT );		
 		while ( si->si_stats.stats_hearersNum == HEARERS_MAXCOUNT ){
-			while ( pthread_cond_wait( &si->si_stats_hearers_cond, &si->si_stats_lock ) ){ continue; }
+			wait_statistics( si, &si->si_stats_hearers_cond );
 		}
 		assert( si->si_stats.stats_hearersNum < SAYERS_MAXCOUNT );
 		release_statistics( si );
+		( void )pthread_setcancelstate( cancelstate, NULL );
 
+		// Wait until a hearer arrives at any port
+		fds[ 0 ].fd = li.li_sockfd;
+		fds[ 1 ].fd = li.li_resumingsockfd;
+		fds[ 2 ].fd = li.li_topicsockfd;
+		fds[ 0 ].events = fds[ 1 ].events = fds[ 2 ].events = POLLIN;
 		errno = 0;
-		if ( ( connsockfd = accept( li.li_sockfd, NULL, NULL ) ) == -1 ){
-			error( "accept() failed in hearersListener() (%s)\n", strerror( errno ) );
+		if ( poll( fds, 3, -1 ) == -1 ){
+			if ( errno != EINTR ){
+				error( "poll() failed in hearersListener() (%s)\n", strerror( errno ) );
+			}
 			continue;
 		}
-		// A connection arrived. Create a new struct connserverinfo object
- 		// for the new thread
+		resume = ( fds[ 0 ].revents == 0 && fds[ 1 ].revents != 0 );
+		topics = ( fds[ 0 ].revents == 0 && fds[ 1 ].revents == 0 );
+
 		errno = 0;
-		if ( ( csi = malloc( sizeof( *csi ) ) ) == NULL ){
-			error( "malloc() failed in hearersListener() (%s)\n", strerror( errno ) );
-			// must close the socket here
-			safe_close( connsockfd );
+		if ( ( connsockfd = accept( resume ? li.li_resumingsockfd : ( topics ? li.li_topicsockfd : li.li_sockfd ), NULL, NULL ) ) == -1 ){
+			error( "accept() failed in hearersListener() (%s)\n", strerror( errno ) );
 			continue;
 		}
-		
-		// Acquire ownership of the twitpool list
-		acquire_twitpool_list( si );
-		errno = 0;
-		// Create a twitpool for that hearer
-		if ( newtwitpool( &si->si_twitpool_list, &tpln ) == -1  ){
-			error( "newtwitpool() failed in hearersListener() (%s)\n", strerror( errno ) );
-			// do cleanup work
-			// close the socket
-			safe_close( connsockfd );
-			// free structure
-			free( csi );
+		// A twitpool and a thread for the hearer; on failure the connection is closed
+		( void )starthearer( si, &li.li_threadattr, connsockfd, resume, NULL, topics ? NULL : "", NULL, NULL, NULL );
+	}
 
-			// CAUTION: do **not** forget to unlock the list here
-			// Release ownership of the twitpool list
-			release_twitpool_list( si );
+	// Perform cleanup
+	pthread_cleanup_pop( 1 );
 
-			continue;
-		}
+	// Not Reached
+	pthread_exit( NULL );
+}
+
+// Create the twitpool of the hearer, subscribe it and note the last twit put in the twitpools; a hearer that came to
+// RESUMING_HEARERS_PORT is replayed what it missed up to that twit and gets the rest through its twitpool. Then start
+// hearerConnectionHandler() and update the statistics structure (a new hearer arrived)
+int starthearer( struct serverinfo * restrict si, const pthread_attr_t * restrict attr, int connsockfd, int resume, const char * restrict cursor,
+	const char * restrict topics, const char * restrict keywords, const char * restrict regexes, const char * restrict tags ){
+	struct connserverinfo *csi = NULL; // The thread frees it
+	struct twitpoollist_node *tpln = NULL; // The twitpool of the hearer
+	pthread_t threadid;
+	uint64_t cursorseq;
+	int count = 0; // Subscriptions made here
+	int status = 0;
+
+	assert( si != NULL );
+	assert( attr != NULL );
+
+	// Create a new struct connserverinfo object for the new thread
+	errno = 0;
+	if ( ( csi = malloc( sizeof( *csi ) ) ) == NULL ){
+		error( "malloc() failed in starthearer() (%s)\n", strerror( errno ) );
+		// must close the socket here
+		safe_close( connsockfd );
+		return ( -1 );
+	}
+	
+	// Acquire ownership of the twitpool list
+	acquire_twitpool_list( si );
+	errno = 0;
+	// Create a twitpool for that hearer
+	if ( newtwitpool( &si->si_twitpool_list, &tpln ) == -1  ){
+		error( "newtwitpool() failed in starthearer() (%s)\n", strerror( errno ) );
+		// do cleanup work
+		// close the socket
+		safe_close( connsockfd );
+		// free structure
+		free( csi );
+
+		// CAUTION: do **not** forget to unlock the list here
 		// Release ownership of the twitpool list
 		release_twitpool_list( si );
 
-		csi->csi_serverinfo = si;
-		csi->csi_sockfd = connsockfd;
-		csi->csi_tpln = tpln;
-
-		// CAUTION: the statistics must be locked before the thread is created cause in case the connection gets closed
-		// before the nums are increased here and the created thread decreases the nums then we have an error.
- 		// So lock the statistics beforehand to avoid any race condition		
-		acquire_statistics( si );
-		// Create the new thread to handle the connection
-		if ( ( errno = pthread_create( &threadid, &li.li_threadattr, &hearerConnectionHandler, csi ) ) ){
-			error( "pthread_create() failed in hearersListener() (%s)\n", strerror( errno ) );
-			// must close the socket here
-			safe_close( connsockfd );
-			// note that if the thread failed to be created we must free the memory for csi here
-			// otherwise, the thread must free the memory itself
-			free( csi );
+		return ( -1 );
+	}
+	// The statistics updater samples the socket through the twitpool
+	tpln->tpln_sockfd = connsockfd;
+	// Every twit after this one goes to the new twitpool; a resuming hearer is replayed the ones up to it
+	csi->csi_boundary = si->si_broadcastseq;
+	csi->csi_topics[ 0 ] = '\0';
+	csi->csi_subcount = 0;
+	csi->csi_keywords[ 0 ] = '\0';
+	csi->csi_kwsubscriber.ksr_count = 0;
+	csi->csi_regexes[ 0 ] = '\0';
+	csi->csi_rxsubscriber.rsr_count = 0;
+	csi->csi_tags[ 0 ] = '\0';
+	csi->csi_tgsubscriber.tgs_count = 0;
+	errno = 0;
+	if ( keywords != NULL && *keywords != '\0' ){
+		acquire_keywords( si );
+		count = subscribekeywords( &si->si_keywords, &csi->csi_kwsubscriber, tpln, keywords );
+		release_keywords( si );
+	}
+	else if ( regexes != NULL && *regexes != '\0' ){
+		acquire_regexes( si );
+		count = subscriberegexes( &si->si_regexes, &csi->csi_rxsubscriber, tpln, regexes );
+		release_regexes( si );
+	}
+	else if ( tags != NULL && *tags != '\0' ){
+		acquire_tags( si );
+		count = subscribetags( &si->si_tags, &csi->csi_tgsubscriber, tpln, tags );
+		release_tags( si );
+	}
+	else if ( topics != NULL ){
+		acquire_topics( si );
+		count = csi->csi_subcount = subscribe( &si->si_topics, csi->csi_subs, tpln, topics );
+		release_topics( si );
+	}
+	if ( count == -1 ){
+		error( "The hearer handed over could not be subscribed again (%s)\n", strerror( errno ) );
+		( void )removefromtwitpoollist( &si->si_twitpool_list, tpln );
+		release_twitpool_list( si );
+		safe_close( connsockfd );
+		free( csi );
+		return ( -1 );
+	}
+	if ( keywords != NULL && *keywords != '\0' ){
+		( void )strcpy( csi->csi_keywords, keywords );
+	}
+	else if ( regexes != NULL && *regexes != '\0' ){
+		( void )strcpy( csi->csi_regexes, regexes );
+	}
+	else if ( tags != NULL && *tags != '\0' ){
+		( void )strcpy( csi->csi_tags, tags );
+	}
+	else if ( topics != NULL ){
+		( void )strcpy( csi->csi_topics, topics );
+	}
+	// Release ownership of the twitpool list
+	release_twitpool_list( si );
+
+	csi->csi_serverinfo = si;
+	csi->csi_sockfd = connsockfd;
+	csi->csi_tpln = tpln;
+	csi->csi_durable = 0;
+	csi->csi_sayerslot = -1;
+	csi->csi_resume = resume;
+	csi->csi_cursor = -1;
+	csi->csi_handoff = ( cursor != NULL );
+	// A hearer handed over keeps its cursor
+	if ( cursor != NULL && *cursor != '\0' && ( csi->csi_cursor = takecursor( &si->si_cursors, cursor, csi->csi_boundary, &cursorseq ) ) == -1 ){
+		error( "The hearer handed over lost its cursor %s (%s)\n", cursor, strerror( errno ) );
+	}
 
-			// must also remove the twitpool created for the hearer
-			( void )removefromtwitpoollist( &si->si_twitpool_list, tpln );
+	// CAUTION: the statistics must be locked before the thread is created cause in case the connection gets closed
+	// before the nums are increased here and the created thread decreases the nums then we have an error.
+	// So lock the statistics beforehand to avoid any race condition
+	acquire_statistics( si );
+	// Create the new thread to handle the connection
+	if ( ( errno = pthread_create( &threadid, attr, &hearerConnectionHandler, csi ) ) ){
+		error( "pthread_create() failed in starthearer() (%s)\n", strerror( errno ) );
+		// must close the socket here
+		safe_close( connsockfd );
+		// must also remove the twitpool created for the hearer and let go of its subscriptions and its cursor
+		acquire_twitpool_list( si );
+		unsubscribehearer( si, csi );
+		( void )removefromtwitpoollist( &si->si_twitpool_list, tpln );
+		release_twitpool_list( si );
+		if ( csi->csi_cursor != -1 ){
+			releasecursor( &si->si_cursors, csi->csi_cursor );
 		}
-		else{
-			// Update the statistics that a new hearer was connected
-			increaseHearersNum( &si->si_stats );
-			increaseThreadsNum( &si->si_stats );
+		// note that if the thread failed to be created we must free the memory for csi here
+		// otherwise, the thread must free the memory itself
+		free( csi );
+		status = -1;
+	}
+	else{
+		// Update the statistics that a new hearer was connected
+		increaseHearersNum( &si->si_stats );
+		increaseThreadsNum( &si->si_stats );
+	}
+	release_statistics( si );
+
+	return ( status );
+}
+
+// The socket is kept for a server that takes over in turn
+int listenerSocket( struct serverinfo * restrict si, enum listenername name ){
+	static const int ports[ LISTENERS ] = {
+		[ LISTEN_SAYERS ] = SAYERS_PORT,
+		[ LISTEN_DURABLE_SAYERS ] = DURABLE_SAYERS_PORT,
+		[ LISTEN_HEARERS ] = HEARERS_PORT,
+		[ LISTEN_RESUMING_HEARERS ] = RESUMING_HEARERS_PORT,
+		[ LISTEN_TOPIC_HEARERS ] = TOPIC_HEARERS_PORT,
+		[ LISTEN_METRICS ] = METRICS_PORT,
+		[ LISTEN_SEARCH ] = SEARCH_PORT,
+		[ LISTEN_TRENDS ] = TRENDS_PORT
+	};
+
+	assert( si != NULL );
+	assert( name >= 0 && name < LISTENERS );
+
+	if ( si->si_listenfds[ name ] == -1 ){
+		si->si_listenfds[ name ] = prepareListenerSocket( ports[ name ] );
+	}
+
+	return ( si->si_listenfds[ name ] );
+}
+
+// A hearer looks at the state of the handoff and at si_stopping under the lock of its twitpool, so it either sees them or is waiting when woken
+void wakehearers( struct serverinfo * restrict si ){
+	struct twitpoollist_node *tpln = NULL;
+
+	assert( si != NULL );
+
+	acquire_twitpool_list( si );
+	for ( tpln = si->si_twitpool_list.tpl_head; tpln != NULL; tpln = tpln->tpln_next ){
+		acquire_twitpool_in_twitpoollist_node( tpln );
+		while ( pthread_cond_broadcast( &tpln->tpln_cond ) ){ continue; }
+		release_twitpool_in_twitpoollist_node( tpln );
+	}
+	release_twitpool_list( si );
+
+	return ;
+}
+
+// The listener may be waiting for a hearer to leave, and may start one more until it is joined; that one sees si_stopping itself.
+// Each hearer signals si_stats_hearers_cond once it is gone
+void stophearers( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	__atomic_store_n( &si->si_stopping, 1, __ATOMIC_RELAXED );
+	wakehearers( si );
+	( void )pthread_join( si->si_hearers_listener_threadid, NULL );
+
+	acquire_statistics( si );
+	while ( si->si_stats.stats_hearersNum > 0 ){
+		wait_statistics( si, &si->si_stats_hearers_cond );
+	}
+	release_statistics( si );
+
+	return ;
+}
+
+// The sayers listener may be waiting for a sayer to leave, so it is joined once they are told to. A durable sayer may be waiting for
+// its twit to be synced by a writer the consumer no longer hands twits to; it is let go. Each sayer signals si_stats_sayers_cond once
+// it is gone
+void stopsayers( struct serverinfo * restrict si ){
+	int slot;
+
+	assert( si != NULL );
+
+	acquire_statistics( si );
+	__atomic_store_n( &si->si_stopping, 1, __ATOMIC_RELAXED );
+	for ( slot = 0; slot < SAYERS_MAXCOUNT; ++slot ){
+		if ( si->si_sayerfds[ slot ] != -1 ){
+			( void )shutdown( si->si_sayerfds[ slot ], SHUT_RDWR );
 		}
-		release_statistics( si );
 	}
+	release_statistics( si );
+	releasetwitlogwaiters( si->si_twitlog );
+	( void )pthread_join( si->si_sayers_listener_threadid, NULL );
 
-	// Perform cleanup
-	pthread_cleanup_pop( 1 );
+	acquire_statistics( si );
+	while ( si->si_stats.stats_sayersNum > 0 ){
+		wait_statistics( si, &si->si_stats_sayers_cond );
+	}
+	release_statistics( si );
 
-	// Not Reached
-	pthread_exit( NULL );
+	return ;
 }
 
 // Prepare the socket for listening for sayers
@@ -374,12 +611,36 @@ int prepareSayersListenerSocket( void ){
 	return ( prepareListenerSocket( SAYERS_PORT ) );
 }
 
+// Prepare the socket for listening for durable sayers
+int prepareDurableSayersListenerSocket( void ){
+	// Obtain the port from config.h and delegate to prepareListenerSocket()
+	return ( prepareListenerSocket( DURABLE_SAYERS_PORT ) );
+}
+
 // Prepare the socket for listening for hearers
 int prepareHearersListenerSocket( void ){
 	// Obtain the port from config.h and delegate to prepareListenerSocket()
 	return ( prepareListenerSocket( HEARERS_PORT ) );
 }
 
+// Prepare the socket for listening for resuming hearers
+int prepareResumingHearersListenerSocket( void ){
+	// Obtain the port from config.h and delegate to prepareListenerSocket()
+	return ( prepareListenerSocket( RESUMING_HEARERS_PORT ) );
+}
+
+// Prepare the socket for listening for hearers of topics
+int prepareTopicHearersListenerSocket( void ){
+	// Obtain the port from config.h and delegate to prepareListenerSocket()
+	return ( prepareListenerSocket( TOPIC_HEARERS_PORT ) );
+}
+
+// Prepare the socket for listening for clients of the metrics
+int prepareMetricsListenerSocket( void ){
+	// Obtain the port from config.h and delegate to prepareListenerSocket()
+	return ( prepareListenerSocket( METRICS_PORT ) );
+}
+
 
 
 // Implementation of local functions...
@@ -390,10 +651,12 @@ static void setupHearersListener( void *arg ){
 
 	assert( li != NULL );
 
-	// Prepare the socket to listen for hearers
+	// Prepare the sockets to listen for hearers
 	errno = 0;
-	if ( ( li->li_sockfd = prepareHearersListenerSocket() ) == -1 ){
-		error( "failed to prepare the socket for hearers in hearersListener() (%s)\n", strerror( errno ) );
+	if ( ( li->li_sockfd = listenerSocket( li->li_serverinfo, LISTEN_HEARERS ) ) == -1 ||
+		( li->li_resumingsockfd = listenerSocket( li->li_serverinfo, LISTEN_RESUMING_HEARERS ) ) == -1 ||
+		( li->li_topicsockfd = listenerSocket( li->li_serverinfo, LISTEN_TOPIC_HEARERS ) ) == -1 ){
+		error( "failed to prepare the sockets for hearers in hearersListener() (%s)\n", strerror( errno ) );
 		// Could not prepare so now inform about the status and terminate
 		signal_prepared_status( li->li_serverinfo, 0 );
 		pthread_exit( NULL );
@@ -414,9 +677,10 @@ static void setupSayersListener( void *arg ){
 
 	assert( li != NULL );
 
-	// Prepare the socket to listen for sayers
-	if ( ( li->li_sockfd = prepareSayersListenerSocket() ) == -1 ){
-		error( "failed to prepare the socket for sayers in sayersListener() (%s)\n", strerror( errno ) );
+	// Prepare the sockets to listen for sayers
+	if ( ( li->li_sockfd = listenerSocket( li->li_serverinfo, LISTEN_SAYERS ) ) == -1 ||
+		( li->li_durablesockfd = listenerSocket( li->li_serverinfo, LISTEN_DURABLE_SAYERS ) ) == -1 ){
+		error( "failed to prepare the sockets for sayers in sayersListener() (%s)\n", strerror( errno ) );
 		// Could not prepare so now inform about the status and terminate
 		signal_prepared_status( li->li_serverinfo, 0 );
 		pthread_exit( NULL );
@@ -441,9 +705,14 @@ static void cleanupHearersListener( void *arg ){
 	if ( li->li_sockfd != -1 ){
 		( void )safe_close( li->li_sockfd );
 	}
+	if ( li->li_resumingsockfd != -1 ){
+		( void )safe_close( li->li_resumingsockfd );
+	}
+	if ( li->li_topicsockfd != -1 ){
+		( void )safe_close( li->li_topicsockfd );
+	}
 	while ( pthread_attr_destroy( &li->li_threadattr ) ){ continue; }
 
-
 	return ;
 }
 
@@ -457,6 +726,9 @@ static void cleanupSayersListener( void *arg ){
 	if ( li->li_sockfd != -1 ){
 		( void )safe_close( li->li_sockfd );
 	}
+	if ( li->li_durablesockfd != -1 ){
+		( void )safe_close( li->li_durablesockfd );
+	}
 	while ( pthread_attr_destroy( &li->li_threadattr ) ){ continue; }
 
 	return ;
@@ -27,7 +27,7 @@
 /**
  * \file listen.h
  *
- * The listen.h header file contains the declaration of the prepareListenerSocket() function.
+ * The listen.h header file contains the declaration of the prepareListenerSocket() function and of the listeners.
  *
  * @author Tassos Souris
  */
@@ -38,6 +38,9 @@
 extern "C"{
 #endif
 
+#include <pthread.h>
+#include "serverinfo.h"
+
 /**
  * The prepareListenerSocket() function shall create a socket to listen for connections in the local machine at the specified port.
  *
@@ -54,6 +57,15 @@ int prepareListenerSocket( int port );
  */
 int prepareSayersListenerSocket( void );
 
+/**
+ * The prepareDurableSayersListenerSocket() function shall create a socket to listen for sayers that wait for each twit to be
+ * synced to the twit log.
+ *
+ * @return Upon successful completion the socket created shall be returned; otherwise, -1 shall be returned and errno shall be set
+ * 	to indicate the error.
+ */
+int prepareDurableSayersListenerSocket( void );
+
 /**
  * The prepareHearersListenerSocket() function shall create a socket to listen for hearers.
  *
@@ -62,6 +74,84 @@ int prepareSayersListenerSocket( void );
  */
 int prepareHearersListenerSocket( void );
 
+/**
+ * The prepareResumingHearersListenerSocket() function shall create a socket to listen for hearers that first ask for the twits
+ * they missed.
+ *
+ * @return Upon successful completion the socket created shall be returned; otherwise, -1 shall be returned and errno shall be set
+ * 	to indicate the error.
+ */
+int prepareResumingHearersListenerSocket( void );
+
+/**
+ * The prepareTopicHearersListenerSocket() function shall create a socket to listen for hearers that first name the topics they want.
+ *
+ * @return Upon successful completion the socket created shall be returned; otherwise, -1 shall be returned and errno shall be set
+ * 	to indicate the error.
+ */
+int prepareTopicHearersListenerSocket( void );
+
+/**
+ * The prepareMetricsListenerSocket() function shall create a socket to listen for clients of the metrics.
+ *
+ * @return Upon successful completion the socket created shall be returned; otherwise, -1 shall be returned and errno shall be set
+ * 	to indicate the error.
+ */
+int prepareMetricsListenerSocket( void );
+
+/**
+ * The listenerSocket() function shall return the socket the server whose struct serverinfo is pointed to by parameter si listens
+ * on for the listener given as parameter name: the one taken over from another server (see handoff.h) or else one created for its
+ * port, which is kept in si_listenfds to be handed over in turn.
+ *
+ * @return Upon successful completion the socket shall be returned; otherwise, -1 shall be returned and errno shall be set
+ * 	to indicate the error.
+ */
+int listenerSocket( struct serverinfo * restrict si, enum listenername name );
+
+/**
+ * The starthearer() function shall start serving the hearer connected at the socket given as parameter connsockfd for the server
+ * whose struct serverinfo is pointed to by parameter si: it gets a twitpool and a thread created with the attributes pointed to by
+ * parameter attr. A hearer for which parameter resume is nonzero is sent the frames of resumeframe.h. A hearer handed over by
+ * another server (see handoff.h) is given with the name of its cursor, empty if it has none, and is not replayed anything; for a
+ * hearer that just connected parameter cursor shall be a NULL pointer. The hearer is subscribed to the keywords in the string pointed
+ * to by parameter keywords if it is not empty, as subscribekeywords() takes them (see keywords.h), else to the regular expressions in
+ * the string pointed to by parameter regexes if it is not empty, as subscriberegexes() takes them (see regexes.h), else to the
+ * hashtags and mentions in the string pointed to by parameter tags if it is not empty, as subscribetags() takes them (see tags.h),
+ * and otherwise to the topics named in the string pointed to by parameter topics, as subscribe() takes them (see topics.h); NULL
+ * pointers for all leave it to the hearer to name them with the request line of topicframe.h. On failure the connection is closed.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ */
+int starthearer( struct serverinfo * restrict si, const pthread_attr_t * restrict attr, int connsockfd, int resume, const char * restrict cursor,
+	const char * restrict topics, const char * restrict keywords, const char * restrict regexes, const char * restrict tags );
+
+/**
+ * The wakehearers() function shall wake the hearers of the server whose struct serverinfo is pointed to by parameter si that wait
+ * for a twit, so they find out they are to be handed over (see handoff.h) or to stop.
+ *
+ * @return Nothing.
+ */
+void wakehearers( struct serverinfo * restrict si );
+
+/**
+ * The stophearers() function shall make every hearer of the server whose struct serverinfo is pointed to by parameter si leave and
+ * wait until they all have, with their twitpools removed. The hearers listener shall have been cancelled; it is joined here. A hearer
+ * blocked sending leaves within HEARER_WAIT_NSEC seconds.
+ *
+ * @return Nothing.
+ */
+void stophearers( struct serverinfo * restrict si );
+
+/**
+ * The stopsayers() function shall make every sayer of the server whose struct serverinfo is pointed to by parameter si leave, shutting
+ * down their connections and letting go those waiting for their twits to be synced to the twit log, and wait until they all have.
+ * The sayers listener shall have been cancelled; it is joined here.
+ *
+ * @return Nothing.
+ */
+void stopsayers( struct serverinfo * restrict si );
+
 /**
  * The sayersListener() function shall be responsible for accepting connections from sayers. The sayersListener() function
  * shall run in its own thread and shall be passed a pointer to a serverinfo structure as parameter.
@@ -0,0 +1,170 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file lockstats.c
+ *
+ * File lockstats.c contains the implementation of the lockstats.h interface.
+ *
+ * The statistics are global rather than part of the serverinfo structure because the twitpools of the hearers are locked
+ * where no serverinfo structure is at hand. They are only updated with atomic builtins or through the histograms, which
+ * are lock-free, so the statistics of a lock never need a lock themselves.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include "histogram.h"
+#include "lockstats.h"
+#include "timing.h"
+
+
+
+// One for each named lock
+static struct lockstats lockstats[ LOCK_NAMES ];
+
+
+
+// Start from zero
+void initlockstats( void ){
+	int name;
+
+	for ( name = 0; name < LOCK_NAMES; ++name ){
+		lockstats[ name ].ls_acquired = 0;
+		lockstats[ name ].ls_contended = 0;
+		inithistogram( &lockstats[ name ].ls_wait );
+		inithistogram( &lockstats[ name ].ls_hold );
+	}
+
+	return ;
+}
+
+// Try first; only if that fails the lock is contended and the wait is timed
+void lockstats_lock( enum lockname name, pthread_mutex_t * restrict mutex, uint64_t * restrict lockedat ){
+	uint64_t start;
+	int status;
+
+	assert( name >= 0 && name < LOCK_NAMES );
+	assert( mutex != NULL );
+	assert( lockedat != NULL );
+
+	if ( ( status = pthread_mutex_trylock( mutex ) ) == 0 ){
+		*lockedat = cycles();
+	}
+	else{
+		assert( status == EBUSY );
+		start = cycles();
+		while ( pthread_mutex_lock( mutex ) ){ continue; }
+		*lockedat = cycles();
+		( void )__atomic_fetch_add( &lockstats[ name ].ls_contended, 1, __ATOMIC_RELAXED );
+		recordinhistogram( &lockstats[ name ].ls_wait, cyclestons( *lockedat - start ) );
+	}
+	( void )__atomic_fetch_add( &lockstats[ name ].ls_acquired, 1, __ATOMIC_RELAXED );
+
+	return ;
+}
+
+// The hold time is taken before the mutex is released so lockedat is still ours
+void lockstats_unlock( enum lockname name, pthread_mutex_t * restrict mutex, const uint64_t * restrict lockedat ){
+	assert( name >= 0 && name < LOCK_NAMES );
+	assert( mutex != NULL );
+	assert( lockedat != NULL );
+
+	recordinhistogram( &lockstats[ name ].ls_hold, cyclestons( cycles() - *lockedat ) );
+	while ( pthread_mutex_unlock( mutex ) ){ continue; }
+
+	return ;
+}
+
+// End the hold before waiting and start a new one when woken up
+void lockstats_wait( enum lockname name, pthread_cond_t * restrict cond, pthread_mutex_t * restrict mutex, uint64_t * restrict lockedat ){
+	assert( name >= 0 && name < LOCK_NAMES );
+	assert( cond != NULL );
+	assert( mutex != NULL );
+	assert( lockedat != NULL );
+
+	recordinhistogram( &lockstats[ name ].ls_hold, cyclestons( cycles() - *lockedat ) );
+	while ( pthread_cond_wait( cond, mutex ) ){ continue; }
+	*lockedat = cycles();
+
+	return ;
+}
+
+// Like lockstats_wait(); the mutex is owned again whether the wait timed out or not
+int lockstats_timedwait( enum lockname name, pthread_cond_t * restrict cond, pthread_mutex_t * restrict mutex, uint64_t * restrict lockedat,
+	const struct timespec * restrict abstime ){
+	int status;
+
+	assert( name >= 0 && name < LOCK_NAMES );
+	assert( cond != NULL );
+	assert( mutex != NULL );
+	assert( lockedat != NULL );
+	assert( abstime != NULL );
+
+	recordinhistogram( &lockstats[ name ].ls_hold, cyclestons( cycles() - *lockedat ) );
+	status = pthread_cond_timedwait( cond, mutex, abstime );
+	*lockedat = cycles();
+
+	return ( status );
+}
+
+// Copy the counters and the histograms
+void snapshotlockstats( enum lockname name, struct lockstats * restrict ls ){
+	assert( name >= 0 && name < LOCK_NAMES );
+	assert( ls != NULL );
+
+	ls->ls_acquired = __atomic_load_n( &lockstats[ name ].ls_acquired, __ATOMIC_RELAXED );
+	ls->ls_contended = __atomic_load_n( &lockstats[ name ].ls_contended, __ATOMIC_RELAXED );
+	snapshothistogram( &lockstats[ name ].ls_wait, &ls->ls_wait );
+	snapshothistogram( &lockstats[ name ].ls_hold, &ls->ls_hold );
+
+	return ;
+}
+
+const char *lockstatsname( enum lockname name ){
+	static const char * const names[ LOCK_NAMES ] = {
+		[ LOCK_STATISTICS ] = "statistics",
+		[ LOCK_PREPARATION_STATUS ] = "preparation_status",
+		[ LOCK_TWITPOOL ] = "twitpool",
+		[ LOCK_TWITPOOL_LIST ] = "twitpool_list",
+		[ LOCK_HEARER_TWITPOOL ] = "hearer_twitpool",
+		[ LOCK_TWITLOG ] = "twitlog",
+		[ LOCK_HISTORY ] = "history",
+		[ LOCK_CURSORS ] = "cursors",
+		[ LOCK_HANDOFF ] = "handoff",
+		[ LOCK_FULLTEXT ] = "fulltext",
+		[ LOCK_TRENDING ] = "trending",
+		[ LOCK_TOPICS ] = "topics",
+		[ LOCK_KEYWORDS ] = "keywords",
+		[ LOCK_REGEXES ] = "regexes",
+		[ LOCK_TAGS ] = "tags"
+	};
+
+	assert( name >= 0 && name < LOCK_NAMES );
+
+	return ( names[ name ] );
+}
@@ -0,0 +1,174 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file lockstats.h
+ *
+ * File lockstats.h declares the functions used to lock the mutexes of the server and, if the server is compiled with
+ * LOCK_STATS defined, to keep statistics for each of them: how many times it was acquired, how many of those it was
+ * already owned by another thread, and histograms of the time spent waiting for it and the time it was owned. The times
+ * are taken with cycles() so the cost of the statistics is small, but it is not zero so they are off by default.
+ *
+ * The mutexes are grouped by name (see enum lockname); all the twitpools of the hearers share one name.
+ * Code shall use the lock_mutex(), unlock_mutex(), wait_mutex() and timedwait_mutex() macros, which compile to plain calls to the pthread functions
+ * without LOCK_STATS. Each takes a pointer to a uint64_t kept with the mutex and written only by the owner of the mutex, in
+ * which the time the mutex was acquired is kept.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( LOCKSTATS_H_IS_INCLUDED )
+#define LOCKSTATS_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "histogram.h"
+
+/**
+ * \enum lockname
+ *
+ * The lockname enumeration names the mutexes for which statistics are kept.
+ */
+enum lockname{
+	LOCK_STATISTICS, /**< si_stats_lock */
+	LOCK_PREPARATION_STATUS, /**< si_prepared_lock */
+	LOCK_TWITPOOL, /**< si_twitpool_lock */
+	LOCK_TWITPOOL_LIST, /**< si_twitpool_list_lock */
+	LOCK_HEARER_TWITPOOL, /**< tpln_lock of every twitpoollist_node */
+	LOCK_TWITLOG, /**< tl_lock of the twit log */
+	LOCK_HISTORY, /**< hs_lock of the recent history */
+	LOCK_CURSORS, /**< cs_lock of the cursors of the hearers */
+	LOCK_HANDOFF, /**< ho_lock of the hot restart */
+	LOCK_FULLTEXT, /**< ft_lock of the full-text index */
+	LOCK_TRENDING, /**< tr_lock of the trends */
+	LOCK_TOPICS, /**< si_topics_lock */
+	LOCK_KEYWORDS, /**< si_keywords_lock */
+	LOCK_REGEXES, /**< si_regexes_lock */
+	LOCK_TAGS, /**< si_tags_lock */
+	LOCK_NAMES
+};
+
+/**
+ * \struct lockstats
+ *
+ * The lockstats structure keeps the statistics of a named lock. Times are in nanoseconds.
+ */
+struct lockstats{
+	uint64_t ls_acquired; /**< Number of times the lock was acquired */
+	uint64_t ls_contended; /**< Number of times the lock was owned by another thread when asked for */
+	struct histogram ls_wait; /**< Time spent waiting for the lock, for each contended acquisition */
+	struct histogram ls_hold; /**< Time the lock was owned, for each acquisition. Waits on a condition are not counted */
+};
+
+#if defined( LOCK_STATS )
+#define lock_mutex( name, mutex, lockedat ) lockstats_lock( (name), (mutex), (lockedat) )
+#define unlock_mutex( name, mutex, lockedat ) lockstats_unlock( (name), (mutex), (lockedat) )
+#define wait_mutex( name, cond, mutex, lockedat ) lockstats_wait( (name), (cond), (mutex), (lockedat) )
+#define timedwait_mutex( name, cond, mutex, lockedat, abstime ) lockstats_timedwait( (name), (cond), (mutex), (lockedat), (abstime) )
+#else
+#define lock_mutex( name, mutex, lockedat ) do{ \
+	( void )(lockedat); \
+	while ( pthread_mutex_lock( (mutex) ) ){ continue; } \
+}while ( 0 )
+#define unlock_mutex( name, mutex, lockedat ) do{ \
+	( void )(lockedat); \
+	while ( pthread_mutex_unlock( (mutex) ) ){ continue; } \
+}while ( 0 )
+#define wait_mutex( name, cond, mutex, lockedat ) do{ \
+	( void )(lockedat); \
+	while ( pthread_cond_wait( (cond), (mutex) ) ){ continue; } \
+}while ( 0 )
+#define timedwait_mutex( name, cond, mutex, lockedat, abstime ) ( ( void )(lockedat), pthread_cond_timedwait( (cond), (mutex), (abstime) ) )
+#endif
+
+
+
+/**
+ * The initlockstats() function shall forget the statistics of all the locks. It shall be called once, before any lock is used.
+ *
+ * @return Nothing.
+ */
+void initlockstats( void );
+
+/**
+ * The lockstats_lock() function shall lock the mutex pointed to by parameter mutex, count it for the lock given as parameter
+ * name and store in the object pointed to by parameter lockedat the time it was locked.
+ *
+ * @return Nothing.
+ */
+void lockstats_lock( enum lockname name, pthread_mutex_t * restrict mutex, uint64_t * restrict lockedat );
+
+/**
+ * The lockstats_unlock() function shall record for the lock given as parameter name the time since the time pointed to by
+ * parameter lockedat, as stored by lockstats_lock(), and unlock the mutex pointed to by parameter mutex.
+ *
+ * @return Nothing.
+ */
+void lockstats_unlock( enum lockname name, pthread_mutex_t * restrict mutex, const uint64_t * restrict lockedat );
+
+/**
+ * The lockstats_wait() function shall wait on the condition pointed to by parameter cond with the mutex pointed to by parameter
+ * mutex, which is owned by the caller, like pthread_cond_wait(). The time the mutex is released while waiting is not counted as
+ * time the mutex was owned.
+ *
+ * @return Nothing.
+ */
+void lockstats_wait( enum lockname name, pthread_cond_t * restrict cond, pthread_mutex_t * restrict mutex, uint64_t * restrict lockedat );
+
+/**
+ * The lockstats_timedwait() function shall wait on the condition pointed to by parameter cond with the mutex pointed to by
+ * parameter mutex, which is owned by the caller, like pthread_cond_timedwait() until the time pointed to by parameter abstime.
+ * The time the mutex is released while waiting is not counted as time the mutex was owned.
+ *
+ * @return The value returned by pthread_cond_timedwait().
+ */
+int lockstats_timedwait( enum lockname name, pthread_cond_t * restrict cond, pthread_mutex_t * restrict mutex, uint64_t * restrict lockedat,
+	const struct timespec * restrict abstime );
+
+/**
+ * The snapshotlockstats() function shall store in the object pointed to by parameter ls a copy of the statistics of the lock
+ * given as parameter name. The histograms of the copy can be queried with histogrampercentile().
+ *
+ * @return Nothing.
+ */
+void snapshotlockstats( enum lockname name, struct lockstats * restrict ls );
+
+/**
+ * The lockstatsname() function shall return the name of the lock given as parameter.
+ *
+ * @return Pointer to a string naming the lock.
+ */
+const char *lockstatsname( enum lockname name );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
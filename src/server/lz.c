@@ -0,0 +1,301 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file lz.c
+ *
+ * File lz.c contains the implementation of the lz.h interface.
+ *
+ * The compressor is greedy: it hashes the next LZ_MINMATCH bytes, looks at the one position the table has for that hash and takes
+ * the match there if there is one, extended backwards over the literals and forwards as far as it goes. The longer it finds no
+ * match the more bytes it skips, so data that does not compress goes by fast. As in LZ4 the last LZ_LASTLITERALS bytes are always
+ * literals and no match starts in the last LZ_MFLIMIT bytes.
+ *
+ * @author Tassos Souris
+ */
+#include <sys/types.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+
+
+
+// Bits of the hash; the table is 4 << LZ_HASH_LOG bytes on the stack
+#define LZ_HASH_LOG (13)
+
+#define LZ_LASTLITERALS (5)
+
+#define LZ_MFLIMIT (12)
+
+// The skip grows by one every 1 << LZ_SKIP_LOG bytes without a match
+#define LZ_SKIP_LOG (6)
+
+
+
+/**
+ * The read32() function shall return the four bytes pointed to by parameter p, in the byte order of the processor.
+ *
+ * @return The bytes as an unsigned integer.
+ */
+static uint32_t read32( const unsigned char *p );
+
+/**
+ * The hash() function shall return the hash of the four bytes given as parameter value, of LZ_HASH_LOG bits.
+ *
+ * @return The hash.
+ */
+static uint32_t hash( uint32_t value );
+
+/**
+ * The putlength() function shall store at dst, if it fits before end, the bytes that are added to a length of 15 in a token to
+ * make the length given as parameter len, which shall not be smaller than 15.
+ *
+ * @return The byte after them; NULL if they do not fit.
+ */
+static unsigned char *putlength( unsigned char * restrict dst, const unsigned char *end, size_t len );
+
+
+
+size_t lzbound( size_t len ){
+	return ( len + len / 255 + 16 );
+}
+
+size_t lzcompress( unsigned char * restrict dst, size_t dstcap, const unsigned char * restrict src, size_t len ){
+	uint32_t table[ 1 << LZ_HASH_LOG ];
+	const unsigned char *end = dst + dstcap;
+	unsigned char *op = dst;
+	unsigned char *token;
+	size_t ip = 0;
+	size_t anchor = 0;
+	size_t ref;
+	size_t litlen;
+	size_t matchlen;
+	size_t step;
+	uint32_t value;
+	uint32_t h;
+
+	assert( dst != NULL );
+	assert( src != NULL || len == 0 );
+
+	( void )memset( table, 0, sizeof( table ) );
+	if ( len > LZ_MFLIMIT ){
+		while ( ip < len - LZ_MFLIMIT ){
+			value = read32( src + ip );
+			h = hash( value );
+			ref = table[ h ];
+			table[ h ] = ( uint32_t )ip;
+			if ( ref >= ip || ip - ref >= LZ_WINDOW || read32( src + ref ) != value ){
+				step = 1 + ( ( ip - anchor ) >> LZ_SKIP_LOG );
+				ip += step;
+				continue;
+			}
+			// Backwards over the literals, then forwards up to the last literals
+			while ( ip > anchor && ref > 0 && src[ ip - 1 ] == src[ ref - 1 ] ){
+				--ip;
+				--ref;
+			}
+			matchlen = LZ_MINMATCH;
+			while ( ip + matchlen < len - LZ_LASTLITERALS && src[ ip + matchlen ] == src[ ref + matchlen ] ){
+				++matchlen;
+			}
+
+			litlen = ip - anchor;
+			if ( ( size_t )( end - op ) < 1 + litlen + 2 ){
+				return ( 0 );
+			}
+			token = op++;
+			*token = ( unsigned char )( ( litlen < 15 ? litlen : 15 ) << 4 );
+			if ( litlen >= 15 && ( op = putlength( op, end, litlen - 15 ) ) == NULL ){
+				return ( 0 );
+			}
+			if ( ( size_t )( end - op ) < litlen + 2 ){
+				return ( 0 );
+			}
+			( void )memcpy( op, src + anchor, litlen );
+			op += litlen;
+			*op++ = ( unsigned char )( ip - ref );
+			*op++ = ( unsigned char )( ( ip - ref ) >> 8 );
+			*token |= ( unsigned char )( matchlen - LZ_MINMATCH < 15 ? matchlen - LZ_MINMATCH : 15 );
+			if ( matchlen - LZ_MINMATCH >= 15 && ( op = putlength( op, end, matchlen - LZ_MINMATCH - 15 ) ) == NULL ){
+				return ( 0 );
+			}
+
+			ip += matchlen;
+			anchor = ip;
+			// The position just before is hashed too; a match often follows a match
+			if ( ip < len - LZ_MFLIMIT ){
+				table[ hash( read32( src + ip - 2 ) ) ] = ( uint32_t )( ip - 2 );
+			}
+		}
+	}
+
+	// The last literals
+	litlen = len - anchor;
+	if ( op == end ){
+		return ( 0 );
+	}
+	token = op++;
+	*token = ( unsigned char )( ( litlen < 15 ? litlen : 15 ) << 4 );
+	if ( litlen >= 15 && ( op = putlength( op, end, litlen - 15 ) ) == NULL ){
+		return ( 0 );
+	}
+	if ( ( size_t )( end - op ) < litlen ){
+		return ( 0 );
+	}
+	if ( litlen > 0 ){
+		( void )memcpy( op, src + anchor, litlen );
+	}
+	op += litlen;
+
+	return ( ( size_t )( op - dst ) );
+}
+
+// Every length and offset is checked against what is left of both buffers
+ssize_t lzdecompress( unsigned char * restrict dst, size_t dstcap, const unsigned char * restrict src, size_t len ){
+	size_t ip = 0;
+	size_t op = 0;
+	size_t litlen;
+	size_t matchlen;
+	size_t offset;
+	size_t i;
+	unsigned char token;
+	unsigned char b;
+
+	assert( dst != NULL );
+	assert( src != NULL );
+
+	while ( ip < len ){
+		token = src[ ip++ ];
+		litlen = token >> 4;
+		if ( litlen == 15 ){
+			do{
+				if ( ip == len ){
+					errno = EILSEQ;
+					return ( -1 );
+				}
+				b = src[ ip++ ];
+				litlen += b;
+			}while ( b == 255 );
+		}
+		if ( litlen > len - ip || litlen > dstcap - op ){
+			errno = EILSEQ;
+			return ( -1 );
+		}
+		// Sixteen bytes at a time where there is room past the run in both buffers
+		if ( len - ip >= litlen + 16 && dstcap - op >= litlen + 16 ){
+			for ( i = 0; i < litlen; i += 16 ){
+				( void )memcpy( dst + op + i, src + ip + i, 16 );
+			}
+		}
+		else{
+			( void )memcpy( dst + op, src + ip, litlen );
+		}
+		ip += litlen;
+		op += litlen;
+		// The last sequence has no match
+		if ( ip == len ){
+			break;
+		}
+
+		if ( len - ip < 2 ){
+			errno = EILSEQ;
+			return ( -1 );
+		}
+		offset = ( size_t )src[ ip ] | ( ( size_t )src[ ip + 1 ] << 8 );
+		ip += 2;
+		matchlen = token & 15;
+		if ( matchlen == 15 ){
+			do{
+				if ( ip == len ){
+					errno = EILSEQ;
+					return ( -1 );
+				}
+				b = src[ ip++ ];
+				matchlen += b;
+			}while ( b == 255 );
+		}
+		matchlen += LZ_MINMATCH;
+		if ( offset == 0 || offset > op || matchlen > dstcap - op ){
+			errno = EILSEQ;
+			return ( -1 );
+		}
+		// Eight bytes at a time read only what is already there when the match is that far; a match closer than its length
+		// repeats what it copies
+		if ( offset >= 8 && dstcap - op >= matchlen + 8 ){
+			for ( i = 0; i < matchlen; i += 8 ){
+				( void )memcpy( dst + op + i, dst + op + i - offset, 8 );
+			}
+		}
+		else if ( offset >= matchlen ){
+			( void )memcpy( dst + op, dst + op - offset, matchlen );
+		}
+		else{
+			for ( i = 0; i < matchlen; ++i ){
+				dst[ op + i ] = dst[ op + i - offset ];
+			}
+		}
+		op += matchlen;
+	}
+
+	return ( ( ssize_t )op );
+}
+
+
+
+// Implementation of local functions...
+
+static uint32_t read32( const unsigned char *p ){
+	uint32_t value;
+
+	( void )memcpy( &value, p, sizeof( value ) );
+
+	return ( value );
+}
+
+// Fibonacci hashing
+static uint32_t hash( uint32_t value ){
+	return ( ( value * 2654435761u ) >> ( 32 - LZ_HASH_LOG ) );
+}
+
+static unsigned char *putlength( unsigned char * restrict dst, const unsigned char *end, size_t len ){
+	assert( dst != NULL );
+
+	while ( len >= 255 ){
+		if ( dst == end ){
+			return ( NULL );
+		}
+		*dst++ = 255;
+		len -= 255;
+	}
+	if ( dst == end ){
+		return ( NULL );
+	}
+	*dst++ = ( unsigned char )len;
+
+	return ( dst );
+}
@@ -0,0 +1,86 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file lz.h
+ *
+ * File lz.h declares the codec the cold segments of the twit log are compressed with, a fast compressor of the LZ77 family with
+ * no entropy coding, in the block format of LZ4. A compressed block is a list of sequences, each of a token byte, literals, a match
+ * offset and more of the match length:
+ *	token: number of literals in the high four bits and match length minus LZ_MINMATCH in the low four bits; 15 is followed by
+ *	bytes added to it, up to the first one that is not 255
+ *	the literals, copied as they are
+ *	offset of the match back from where it is copied to, 1 to LZ_WINDOW - 1 (uint16_t, little-endian)
+ * The last sequence has only its literals. Each block is decompressed on its own, so the blocks of a segment can be read in any order.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( LZ_H_IS_INCLUDED )
+#define LZ_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// The shortest match
+#define LZ_MINMATCH (4)
+
+// Matches are looked for in the last LZ_WINDOW bytes
+#define LZ_WINDOW (65536)
+
+/**
+ * The lzbound() function shall return the largest size lzcompress() can make len bytes.
+ *
+ * @return The number of bytes.
+ */
+size_t lzbound( size_t len );
+
+/**
+ * The lzcompress() function shall compress the len bytes pointed to by parameter src into the buffer of dstcap bytes pointed to by
+ * parameter dst. A buffer of lzbound( len ) bytes is always large enough.
+ *
+ * @return The number of bytes of the compressed block; zero if it does not fit in dstcap bytes.
+ */
+size_t lzcompress( unsigned char * restrict dst, size_t dstcap, const unsigned char * restrict src, size_t len );
+
+/**
+ * The lzdecompress() function shall decompress the compressed block of len bytes pointed to by parameter src into the buffer of
+ * dstcap bytes pointed to by parameter dst. It never reads or writes outside the two buffers, whatever the block holds, but the
+ * bytes of dst after those decompressed may be written over.
+ *
+ * @return The number of bytes decompressed; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EILSEQ The block is not valid or is decompressed to more than dstcap bytes.
+ */
+ssize_t lzdecompress( unsigned char * restrict dst, size_t dstcap, const unsigned char * restrict src, size_t len );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
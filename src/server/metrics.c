@@ -0,0 +1,900 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file metrics.c
+ *
+ * File metrics.c contains the implementation of the metrics.h interface.
+ *
+ * The metrics page is built only from data that can be read without locking: the copy of the statistics published
+ * by statisticsUpdater() (see snapshot_statistics()) and the latency histograms, which are recorded lock-free.
+ * So a client scraping the metrics, however often, never adds latency to the threads that move the twits.
+ *
+ * Clients are served one at a time by the thread that accepts them. A scrape takes well under a millisecond and
+ * the socket timeouts (METRICS_WAIT_NSEC) stop a slow client from holding the thread for long.
+ *
+ * @author Tassos Souris
+ */
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include "serverinfo.h"
+#include "statistics.h"
+#include "histogram.h"
+#include "lockstats.h"
+#include "twitlog.h"
+#include "fulltext.h"
+#include "trending.h"
+#include "listen.h"
+#include "metrics.h"
+#include "config.h"
+#include "util.h"
+#include "error.h"
+
+// Latency buckets are exported for every power of two nanoseconds starting from 2^METRICS_MINBITS (about a microsecond)
+#define METRICS_MINBITS (10)
+
+/**
+ * \struct textbuffer
+ *
+ * The textbuffer structure is a growing buffer in which the metrics page is formatted.
+ */
+struct textbuffer{
+	char *tb_text;
+	size_t tb_len;
+	size_t tb_size;
+};
+
+/**
+ * \struct metricsinfo
+ *
+ * The metricsinfo structure keeps the resources of the metricsListener thread so as they can be released by the cleanup handler.
+ */
+struct metricsinfo{
+	struct serverinfo *mi_serverinfo;
+	struct textbuffer mi_buffer;
+	int mi_sockfd;
+	int mi_connsockfd;
+};
+
+
+
+/**
+ * The setupMetricsListener() shall perform all the necessary actions for the preparation of the metricsListener thread.
+ * The setupMetricsListener() function shall receive as argument a pointer to a struct metricsinfo object.
+ *
+ * @return Nothing.
+ */
+static void setupMetricsListener( void *arg );
+
+/**
+ * The cleanupMetricsListener() function is responsible for cleaning up the resources associated with the metricsListener thread.
+ * The cleanupMetricsListener() function shall receive as argument a pointer to a struct metricsinfo object.
+ *
+ * @return Nothing.
+ */
+static void cleanupMetricsListener( void *arg );
+
+/**
+ * The servemetrics() function shall read the request of the client connected at the socket given as parameter and answer with
+ * the metrics page, formatted in the struct textbuffer object pointed to by parameter tb.
+ *
+ * @return The servemetrics() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int servemetrics( struct serverinfo * restrict si, struct textbuffer * restrict tb, int sockfd );
+
+/**
+ * The formatmetrics() function shall format the metrics page for the serverinfo structure pointed to by parameter si in the
+ * struct textbuffer object pointed to by parameter tb.
+ *
+ * @return The formatmetrics() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int formatmetrics( struct serverinfo * restrict si, struct textbuffer * restrict tb );
+
+/**
+ * The formatrates() function shall format the metrics of the incoming and outcoming struct ratewindow objects of the statistics
+ * structure pointed to by parameter stats in the struct textbuffer object pointed to by tb.
+ *
+ * @return The formatrates() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int formatrates( struct textbuffer * restrict tb, const struct statistics * restrict stats );
+
+/**
+ * The formathearerlag() function shall format the lag of the HEARERS_SLOWEST_SHOWN hearers furthest behind, as kept in the
+ * statistics structure pointed to by parameter stats, in the struct textbuffer object pointed to by tb. The hearers are told
+ * apart by the label hearer.
+ *
+ * @return The formathearerlag() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int formathearerlag( struct textbuffer * restrict tb, const struct statistics * restrict stats );
+
+/**
+ * The hearerlagvalue() function shall return the value of the metric at index metric of the table hearerlagmetrics for the
+ * struct hearerlag object pointed to by parameter hl.
+ *
+ * @return The value of the metric.
+ */
+static double hearerlagvalue( const struct hearerlag * restrict hl, int metric );
+
+/**
+ * The formattwitlog() function shall format the counters of the twit log of the server described by parameter si, and of the
+ * twits replayed from it and from the recent history, in the struct textbuffer object pointed to by parameter tb.
+ *
+ * @return The formattwitlog() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int formattwitlog( struct textbuffer * restrict tb, struct serverinfo * restrict si );
+
+/**
+ * The formattopics() function shall format the counters of the topics of the server described by parameter si in the struct
+ * textbuffer object pointed to by parameter tb.
+ *
+ * @return The formattopics() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int formattopics( struct textbuffer * restrict tb, struct serverinfo * restrict si );
+
+/**
+ * The formatsearch() function shall format the counters of the full-text index and of the searches of the server described by
+ * parameter si in the struct textbuffer object pointed to by parameter tb.
+ *
+ * @return The formatsearch() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int formatsearch( struct textbuffer * restrict tb, struct serverinfo * restrict si );
+
+/**
+ * The formattrends() function shall format the counters of the tags and the words counted for what is trending in the server
+ * described by parameter si in the struct textbuffer object pointed to by parameter tb.
+ *
+ * @return The formattrends() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int formattrends( struct textbuffer * restrict tb, struct serverinfo * restrict si );
+
+#if defined( LOCK_STATS )
+/**
+ * The formatlockstats() function shall format the statistics of each lock in the struct textbuffer object pointed to by parameter tb.
+ *
+ * @return The formatlockstats() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int formatlockstats( struct textbuffer * restrict tb );
+#endif
+
+/**
+ * The formathistogram() function shall format the histogram of nanoseconds pointed to by parameter h as the samples of the Prometheus
+ * histogram in seconds named by parameter name, with the label named by parameter label set to the string pointed to by parameter
+ * value, in the struct textbuffer object pointed to by parameter tb.
+ *
+ * @return The formathistogram() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int formathistogram( struct textbuffer * restrict tb, const char * restrict name, const char * restrict label,
+	const char * restrict value, const struct histogram * restrict h );
+
+/**
+ * The appendtext() function shall append to the struct textbuffer object pointed to by parameter tb the text formatted
+ * as with the printf() function.
+ *
+ * @return The appendtext() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int appendtext( struct textbuffer * restrict tb, const char * restrict format, ... );
+
+
+
+// The metrics of each hearer; hearerlagvalue() knows the value of each, by index
+static const struct{
+	const char *hlm_name;
+	const char *hlm_help;
+} hearerlagmetrics[] = {
+	{ "twitserver_hearer_queued_twits", "Number of twits waiting for the hearer." },
+	{ "twitserver_hearer_queued_bytes", "Number of bytes of the twits waiting for the hearer." },
+	{ "twitserver_hearer_oldest_twit_seconds", "Age of the oldest twit waiting for the hearer." },
+	{ "twitserver_hearer_delivered_twits_per_second", "Rate of twits delivered to the hearer." },
+	{ "twitserver_hearer_send_blocked_ratio", "Fraction of the time spent blocked in send() to the hearer." },
+	{ "twitserver_hearer_tcp_retransmits", "Number of segments retransmitted to the hearer." },
+	{ "twitserver_hearer_tcp_snd_cwnd", "Congestion window of the connection with the hearer, in segments." },
+	{ "twitserver_hearer_tcp_unacked", "Number of segments sent to the hearer and not yet acknowledged." },
+	{ "twitserver_hearer_tcp_rtt_seconds", "Smoothed round trip time of the connection with the hearer." }
+};
+
+
+
+/**
+ * metricsListener() runs on its own thread and is responsible for serving the metrics.
+ * The port to which the metricsListener() function will listen is obtained from config.h (METRICS_PORT).
+ * The steps the metricsListener() function takes are:
+ *	1) The socket that will listen at the port METRICS_PORT is created.
+ *	2) If successfull (the above step) the metricsListener() function notifies through the serverinfo structure
+ *	passed as parameter that is prepared.
+ *	3) It waits for a connection and when one arrives it answers with the metrics and closes the connection.
+ */
+void *metricsListener( void *arg ){
+	struct serverinfo *si = ( struct serverinfo * )arg;
+	struct metricsinfo mi = {
+		.mi_serverinfo = si,
+		.mi_buffer = { .tb_text = NULL },
+		.mi_sockfd = -1,
+		.mi_connsockfd = -1
+	};
+
+	assert( si != NULL );
+
+	// POSIX says that pthread_cleanup_push() and pthread_cleanup_pop() must appear as statements
+	// and in pairs within the same lexical scope so pthread_cleanup_push() must be put here
+ 	// and not in setupMetricsListener()
+	pthread_cleanup_push( &cleanupMetricsListener, &mi );
+	setupMetricsListener( &mi );
+
+	// Wait for connections
+	while ( 1 ){
+		errno = 0;
+		if ( ( mi.mi_connsockfd = accept( mi.mi_sockfd, NULL, NULL ) ) == -1 ){
+			error( "accept() failed in metricsListener() (%s)\n", strerror( errno ) );
+			continue;
+		}
+		( void )servemetrics( si, &mi.mi_buffer, mi.mi_connsockfd );
+		( void )safe_close( mi.mi_connsockfd );
+		mi.mi_connsockfd = -1;
+	}
+
+	// Perform cleanup
+	pthread_cleanup_pop( 1 );
+
+	// Not Reached
+	pthread_exit( NULL );
+}
+
+
+
+// Implementation of local functions...
+
+// Setup the metrics listener
+static void setupMetricsListener( void *arg ){
+	struct metricsinfo *mi = ( struct metricsinfo * )arg;
+
+	assert( mi != NULL );
+
+	// Prepare the socket to listen for the clients of the metrics
+	errno = 0;
+	if ( ( mi->mi_sockfd = listenerSocket( mi->mi_serverinfo, LISTEN_METRICS ) ) == -1 ){
+		error( "failed to prepare the socket for metrics in metricsListener() (%s)\n", strerror( errno ) );
+		// Could not prepare so now inform about the status and terminate
+		signal_prepared_status( mi->mi_serverinfo, 0 );
+		pthread_exit( NULL );
+	}
+	// The preparation is successful
+	signal_prepared_status( mi->mi_serverinfo, 1 );
+
+	return ;
+}
+
+// Cleanup the metrics listener
+static void cleanupMetricsListener( void *arg ){
+	struct metricsinfo *mi = ( struct metricsinfo * )arg;
+
+	assert( mi != NULL );
+
+	// Cleanup code
+	if ( mi->mi_connsockfd != -1 ){
+		( void )safe_close( mi->mi_connsockfd );
+	}
+	if ( mi->mi_sockfd != -1 ){
+		( void )safe_close( mi->mi_sockfd );
+	}
+	free( mi->mi_buffer.tb_text );
+
+	return ;
+}
+
+// Read the request and answer with the metrics
+static int servemetrics( struct serverinfo * restrict si, struct textbuffer * restrict tb, int sockfd ){
+	char request[ 1024 ];
+	char header[ 128 ];
+	size_t nread_total = 0;
+	ssize_t nread_cur;
+	int headerlen;
+	struct timeval timeout;
+
+	assert( si != NULL );
+	assert( tb != NULL );
+
+	// Do not let a slow client hold the thread
+	( void )memset( &timeout, 0, sizeof( timeout ) );
+	timeout.tv_sec = ( time_t )METRICS_WAIT_NSEC;
+	timeout.tv_usec = ( suseconds_t )0;
+	( void )setsockopt( sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+	( void )setsockopt( sockfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+
+	// Whatever the request is the answer is the metrics page; just consume the request header up to the empty line
+	// so as the client does not get a reset for unread data when the socket is closed
+	while ( nread_total < sizeof( request ) - 1 ){
+		errno = 0;
+		nread_cur = recv( sockfd, request + nread_total, sizeof( request ) - 1 - nread_total, 0 );
+		if ( nread_cur == -1 && errno == EINTR ){
+			continue;
+		}
+		else if ( nread_cur <= 0 ){
+			break;
+		}
+		nread_total += nread_cur;
+		request[ nread_total ] = '\0';
+		if ( strstr( request, "\r\n\r\n" ) != NULL || strstr( request, "\n\n" ) != NULL ){
+			break;
+		}
+	}
+
+	// Format the page
+	tb->tb_len = 0;
+	if ( formatmetrics( si, tb ) == -1 ){
+		error( "failed to format the metrics in metricsListener()\n" );
+		return ( -1 );
+	}
+
+	headerlen = snprintf( header, sizeof( header ),
+		"HTTP/1.0 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: %lu\r\n"
+		"\r\n",
+		( unsigned long )tb->tb_len );
+	assert( headerlen > 0 && ( size_t )headerlen < sizeof( header ) );
+	if ( writeall( sockfd, header, ( size_t )headerlen ) == -1 || writeall( sockfd, tb->tb_text, tb->tb_len ) == -1 ){
+		return ( -1 );
+	}
+	( void )shutdown( sockfd, SHUT_WR );
+
+	return ( 0 );
+}
+
+// Format the whole page
+static int formatmetrics( struct serverinfo * restrict si, struct textbuffer * restrict tb ){
+	struct statistics stats;
+	struct histogram snapshot;
+	int stage;
+	int status = 0;
+
+	assert( si != NULL );
+	assert( tb != NULL );
+
+	snapshot_statistics( si, &stats );
+
+	status |= appendtext( tb,
+		"# HELP twitserver_threads Number of active threads.\n"
+		"# TYPE twitserver_threads gauge\n"
+		"twitserver_threads %d\n"
+		"# HELP twitserver_hearers Number of hearers connected.\n"
+		"# TYPE twitserver_hearers gauge\n"
+		"twitserver_hearers %d\n"
+		"# HELP twitserver_sayers Number of sayers connected.\n"
+		"# TYPE twitserver_sayers gauge\n"
+		"twitserver_sayers %d\n"
+		"# HELP twitserver_stored_twits Number of twits waiting in the twitpool shared by the sayers.\n"
+		"# TYPE twitserver_stored_twits gauge\n"
+		"twitserver_stored_twits %d\n"
+		"# HELP twitserver_arrived_twits_total Number of twits arrived from sayers.\n"
+		"# TYPE twitserver_arrived_twits_total counter\n"
+		"twitserver_arrived_twits_total %llu\n"
+		"# HELP twitserver_delivered_twits_total Number of twits delivered to hearers.\n"
+		"# TYPE twitserver_delivered_twits_total counter\n"
+		"twitserver_delivered_twits_total %llu\n",
+		stats.stats_threadsNum,
+		stats.stats_hearersNum,
+		stats.stats_sayersNum,
+		stats.stats_storedTwitsNum,
+		( unsigned long long )stats.stats_arrivedTwitsNum,
+		( unsigned long long )stats.stats_deliveredTwitsNum );
+
+	status |= formatrates( tb, &stats );
+	status |= formathearerlag( tb, &stats );
+
+	status |= appendtext( tb,
+		"# HELP twitserver_latency_seconds Time a twit spends in each stage of the server.\n"
+		"# TYPE twitserver_latency_seconds histogram\n" );
+	for ( stage = 0; stage < LATENCY_STAGES; ++stage ){
+		snapshothistogram( &si->si_latency[ stage ], &snapshot );
+		status |= formathistogram( tb, "twitserver_latency_seconds", "stage", latencystagename( stage ), &snapshot );
+	}
+
+	status |= formattwitlog( tb, si );
+	status |= formattopics( tb, si );
+	status |= formatsearch( tb, si );
+	status |= formattrends( tb, si );
+
+#if defined( LOCK_STATS )
+	status |= formatlockstats( tb );
+#endif
+
+	return ( status ? -1 : 0 );
+}
+
+// Format the rates; the samples of each metric must follow its TYPE line so each metric is done for both directions in turn
+static int formatrates( struct textbuffer * restrict tb, const struct statistics * restrict stats ){
+	const struct ratewindow *in = NULL;
+	const struct ratewindow *out = NULL;
+	int status = 0;
+
+	assert( tb != NULL );
+	assert( stats != NULL );
+
+	in = &stats->stats_incomingRate;
+	out = &stats->stats_outcomingRate;
+
+	status |= appendtext( tb,
+		"# HELP twitserver_rate_twits_per_second Rate of twits over a window.\n"
+		"# TYPE twitserver_rate_twits_per_second gauge\n"
+		"twitserver_rate_twits_per_second{direction=\"incoming\",window=\"1s\"} %.3f\n"
+		"twitserver_rate_twits_per_second{direction=\"incoming\",window=\"10s\"} %.3f\n"
+		"twitserver_rate_twits_per_second{direction=\"incoming\",window=\"60s\"} %.3f\n"
+		"twitserver_rate_twits_per_second{direction=\"outcoming\",window=\"1s\"} %.3f\n"
+		"twitserver_rate_twits_per_second{direction=\"outcoming\",window=\"10s\"} %.3f\n"
+		"twitserver_rate_twits_per_second{direction=\"outcoming\",window=\"60s\"} %.3f\n",
+		in->rw_rate1s, in->rw_rate10s, in->rw_rate60s,
+		out->rw_rate1s, out->rw_rate10s, out->rw_rate60s );
+	status |= appendtext( tb,
+		"# HELP twitserver_rate_percentile_twits_per_second Percentiles of the per-second rates over the longest window.\n"
+		"# TYPE twitserver_rate_percentile_twits_per_second gauge\n"
+		"twitserver_rate_percentile_twits_per_second{direction=\"incoming\",quantile=\"0.5\"} %.3f\n"
+		"twitserver_rate_percentile_twits_per_second{direction=\"incoming\",quantile=\"0.9\"} %.3f\n"
+		"twitserver_rate_percentile_twits_per_second{direction=\"incoming\",quantile=\"0.99\"} %.3f\n"
+		"twitserver_rate_percentile_twits_per_second{direction=\"outcoming\",quantile=\"0.5\"} %.3f\n"
+		"twitserver_rate_percentile_twits_per_second{direction=\"outcoming\",quantile=\"0.9\"} %.3f\n"
+		"twitserver_rate_percentile_twits_per_second{direction=\"outcoming\",quantile=\"0.99\"} %.3f\n",
+		in->rw_p50, in->rw_p90, in->rw_p99,
+		out->rw_p50, out->rw_p90, out->rw_p99 );
+	status |= appendtext( tb,
+		"# HELP twitserver_rate_peak_twits_per_second Highest per-second rate seen.\n"
+		"# TYPE twitserver_rate_peak_twits_per_second gauge\n"
+		"twitserver_rate_peak_twits_per_second{direction=\"incoming\"} %.3f\n"
+		"twitserver_rate_peak_twits_per_second{direction=\"outcoming\"} %.3f\n",
+		in->rw_peak, out->rw_peak );
+
+	return ( status );
+}
+
+// Format the hearers furthest behind; the samples of each metric must follow its TYPE line
+static int formathearerlag( struct textbuffer * restrict tb, const struct statistics * restrict stats ){
+	const int metricsNum = sizeof( hearerlagmetrics ) / sizeof( hearerlagmetrics[ 0 ] );
+	int metric;
+	int i;
+	int status = 0;
+
+	assert( tb != NULL );
+	assert( stats != NULL );
+
+	for ( metric = 0; metric < metricsNum; ++metric ){
+		status |= appendtext( tb, "# HELP %s %s\n# TYPE %s gauge\n",
+			hearerlagmetrics[ metric ].hlm_name, hearerlagmetrics[ metric ].hlm_help, hearerlagmetrics[ metric ].hlm_name );
+		for ( i = 0; i < stats->stats_hearerLagNum && i < HEARERS_SLOWEST_SHOWN; ++i ){
+			status |= appendtext( tb, "%s{hearer=\"%lu\"} %.9g\n", hearerlagmetrics[ metric ].hlm_name,
+				stats->stats_hearerLag[ i ].hl_id, hearerlagvalue( &stats->stats_hearerLag[ i ], metric ) );
+		}
+	}
+
+	return ( status );
+}
+
+// In the order of hearerlagmetrics
+static double hearerlagvalue( const struct hearerlag * restrict hl, int metric ){
+	assert( hl != NULL );
+
+	switch ( metric ){
+		case 0: return ( ( double )hl->hl_queued );
+		case 1: return ( ( double )hl->hl_bytesQueued );
+		case 2: return ( hl->hl_oldest_ns / 1e9 );
+		case 3: return ( hl->hl_deliveredRate );
+		case 4: return ( hl->hl_sendBlocked );
+		case 5: return ( hl->hl_retransmits );
+		case 6: return ( hl->hl_sndCwnd );
+		case 7: return ( hl->hl_unacked );
+		case 8: return ( hl->hl_rtt_us / 1e6 );
+		default: assert( 0 );
+	}
+
+	return ( 0.0 );
+}
+
+// Format the counters of the twit log and the histogram of its syncs
+// Read without the lock, as for the statistics printed; the twits on topics and with keywords are loaded first, see broadcast_twit()
+static int formattopics( struct textbuffer * restrict tb, struct serverinfo * restrict si ){
+	uint64_t topictwits;
+	uint64_t keywordtwits;
+	uint64_t broadcast;
+
+	assert( tb != NULL );
+	assert( si != NULL );
+
+	topictwits = __atomic_load_n( &si->si_topictwits, __ATOMIC_ACQUIRE );
+	keywordtwits = __atomic_load_n( &si->si_keywordtwits, __ATOMIC_ACQUIRE );
+	broadcast = __atomic_load_n( &si->si_broadcasttwits, __ATOMIC_RELAXED );
+
+	return ( appendtext( tb,
+		"# HELP twitserver_topics Number of topics with subscribers, the global one aside.\n"
+		"# TYPE twitserver_topics gauge\n"
+		"twitserver_topics %llu\n"
+		"# HELP twitserver_global_hearers Number of hearers on the global topic.\n"
+		"# TYPE twitserver_global_hearers gauge\n"
+		"twitserver_global_hearers %llu\n"
+		"# HELP twitserver_broadcast_twits_total Number of twits broadcast, by topic.\n"
+		"# TYPE twitserver_broadcast_twits_total counter\n"
+		"twitserver_broadcast_twits_total{topic=\"global\"} %llu\n"
+		"twitserver_broadcast_twits_total{topic=\"other\"} %llu\n"
+		"# HELP twitserver_fanout_twits_total Number of twits put in the twitpools of the hearers.\n"
+		"# TYPE twitserver_fanout_twits_total counter\n"
+		"twitserver_fanout_twits_total %llu\n"
+		"# HELP twitserver_keywords Number of keywords with subscribers.\n"
+		"# TYPE twitserver_keywords gauge\n"
+		"twitserver_keywords %llu\n"
+		"# HELP twitserver_keyword_states Number of states of the automaton of the keywords.\n"
+		"# TYPE twitserver_keyword_states gauge\n"
+		"twitserver_keyword_states %llu\n"
+		"# HELP twitserver_keyword_twits_total Number of twits with a keyword of a hearer in them.\n"
+		"# TYPE twitserver_keyword_twits_total counter\n"
+		"twitserver_keyword_twits_total %llu\n"
+		"# HELP twitserver_keyword_prefiltered_twits_total Number of twits the prefilter of the keywords found none could be in.\n"
+		"# TYPE twitserver_keyword_prefiltered_twits_total counter\n"
+		"twitserver_keyword_prefiltered_twits_total %llu\n"
+		"# HELP twitserver_regexes Number of regular expressions with subscribers.\n"
+		"# TYPE twitserver_regexes gauge\n"
+		"twitserver_regexes %llu\n"
+		"# HELP twitserver_regex_dfa_states Number of states of the lazy DFA of the regular expressions in its cache.\n"
+		"# TYPE twitserver_regex_dfa_states gauge\n"
+		"twitserver_regex_dfa_states %llu\n"
+		"# HELP twitserver_regex_cache_flushes_total Number of times the cache of the lazy DFA was full and flushed.\n"
+		"# TYPE twitserver_regex_cache_flushes_total counter\n"
+		"twitserver_regex_cache_flushes_total %llu\n"
+		"# HELP twitserver_regex_thrashed_twits_total Number of twits finished on the NFAs as the cache of the lazy DFA thrashed.\n"
+		"# TYPE twitserver_regex_thrashed_twits_total counter\n"
+		"twitserver_regex_thrashed_twits_total %llu\n"
+		"# HELP twitserver_regex_twits_total Number of twits that matched a regular expression of a hearer.\n"
+		"# TYPE twitserver_regex_twits_total counter\n"
+		"twitserver_regex_twits_total %llu\n"
+		"# HELP twitserver_tags Number of hashtags and mentions in the index of the recent twits or with subscribers.\n"
+		"# TYPE twitserver_tags gauge\n"
+		"twitserver_tags %llu\n"
+		"# HELP twitserver_tag_postings Number of twits in the posting lists of the index, once for each of their tags.\n"
+		"# TYPE twitserver_tag_postings gauge\n"
+		"twitserver_tag_postings %llu\n"
+		"# HELP twitserver_tag_posting_bytes Number of bytes of the delta-encoded posting lists of the index.\n"
+		"# TYPE twitserver_tag_posting_bytes gauge\n"
+		"twitserver_tag_posting_bytes %llu\n"
+		"# HELP twitserver_tag_twits_total Number of twits with a hashtag or a mention a hearer subscribed to.\n"
+		"# TYPE twitserver_tag_twits_total counter\n"
+		"twitserver_tag_twits_total %llu\n"
+		"# HELP twitserver_tag_recent_twits_total Number of recent twits sent to the hearers that asked for those with their tags.\n"
+		"# TYPE twitserver_tag_recent_twits_total counter\n"
+		"twitserver_tag_recent_twits_total %llu\n",
+		( unsigned long long )__atomic_load_n( &si->si_topics.ts_count, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_topics.ts_globalcount, __ATOMIC_RELAXED ),
+		( unsigned long long )( broadcast - topictwits ),
+		( unsigned long long )topictwits,
+		( unsigned long long )__atomic_load_n( &si->si_fanout, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_keywords.kw_count, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_keywords.kw_statecount, __ATOMIC_RELAXED ),
+		( unsigned long long )keywordtwits,
+		( unsigned long long )__atomic_load_n( &si->si_keywords.kw_filtered, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_regexes.rx_count, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_regexes.rx_dstatecount, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_regexes.rx_flushes, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_regexes.rx_thrashed, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_regextwits, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_tags.ti_count, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_tags.ti_postings, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_tags.ti_bytes, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_tagtwits, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_recenttwits, __ATOMIC_RELAXED ) ) );
+}
+
+// The twits from the disk are read first; they are counted after the others
+static int formatsearch( struct textbuffer * restrict tb, struct serverinfo * restrict si ){
+	const struct fulltext *ft = NULL;
+	uint64_t disk;
+
+	assert( tb != NULL );
+	assert( si != NULL );
+
+	ft = &si->si_fulltext;
+	disk = __atomic_load_n( &si->si_searchdisk, __ATOMIC_RELAXED );
+
+	return ( appendtext( tb,
+		"# HELP twitserver_fulltext_twits Number of twits in the full-text index.\n"
+		"# TYPE twitserver_fulltext_twits gauge\n"
+		"twitserver_fulltext_twits %llu\n"
+		"# HELP twitserver_fulltext_words Number of words in the full-text index, once for each of its segments.\n"
+		"# TYPE twitserver_fulltext_words gauge\n"
+		"twitserver_fulltext_words %llu\n"
+		"# HELP twitserver_fulltext_postings Number of twits in the posting lists of the full-text index, once for each of their words.\n"
+		"# TYPE twitserver_fulltext_postings gauge\n"
+		"twitserver_fulltext_postings %llu\n"
+		"# HELP twitserver_fulltext_posting_bytes Number of bytes of the block-packed posting lists of the full-text index.\n"
+		"# TYPE twitserver_fulltext_posting_bytes gauge\n"
+		"twitserver_fulltext_posting_bytes %llu\n"
+		"# HELP twitserver_fulltext_segments_dropped_total Number of segments of the full-text index dropped as the newest were kept.\n"
+		"# TYPE twitserver_fulltext_segments_dropped_total counter\n"
+		"twitserver_fulltext_segments_dropped_total %llu\n"
+		"# HELP twitserver_searches_total Number of searches answered.\n"
+		"# TYPE twitserver_searches_total counter\n"
+		"twitserver_searches_total %llu\n"
+		"# HELP twitserver_search_twits_total Number of twits sent for the searches, by where they were taken from.\n"
+		"# TYPE twitserver_search_twits_total counter\n"
+		"twitserver_search_twits_total{source=\"memory\"} %llu\n"
+		"twitserver_search_twits_total{source=\"disk\"} %llu\n"
+		"# HELP twitserver_search_missing_twits_total Number of twits found by the searches that were no longer in the twit log.\n"
+		"# TYPE twitserver_search_missing_twits_total counter\n"
+		"twitserver_search_missing_twits_total %llu\n",
+		( unsigned long long )__atomic_load_n( &ft->ft_twits, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &ft->ft_words, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &ft->ft_postings, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &ft->ft_bytes, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &ft->ft_dropped, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_searches, __ATOMIC_RELAXED ),
+		( unsigned long long )( __atomic_load_n( &si->si_searchtwits, __ATOMIC_RELAXED ) - disk ),
+		( unsigned long long )disk,
+		( unsigned long long )__atomic_load_n( &si->si_searchmissing, __ATOMIC_RELAXED ) ) );
+}
+
+// The counters are read without the lock; what is trending itself is asked for at TRENDS_PORT
+static int formattrends( struct textbuffer * restrict tb, struct serverinfo * restrict si ){
+	const struct trending *tr = NULL;
+
+	assert( tb != NULL );
+	assert( si != NULL );
+
+	tr = &si->si_trending;
+
+	return ( appendtext( tb,
+		"# HELP twitserver_trending_twits_total Number of twits whose tags and words were counted for what is trending.\n"
+		"# TYPE twitserver_trending_twits_total counter\n"
+		"twitserver_trending_twits_total %llu\n"
+		"# HELP twitserver_trending_counted_total Number of tags and of words counted for what is trending.\n"
+		"# TYPE twitserver_trending_counted_total counter\n"
+		"twitserver_trending_counted_total{kind=\"tags\"} %llu\n"
+		"twitserver_trending_counted_total{kind=\"words\"} %llu\n"
+		"# HELP twitserver_trending_replaced_total Number of times a tag or a word took the place of another among those followed.\n"
+		"# TYPE twitserver_trending_replaced_total counter\n"
+		"twitserver_trending_replaced_total{kind=\"tags\"} %llu\n"
+		"twitserver_trending_replaced_total{kind=\"words\"} %llu\n"
+		"# HELP twitserver_trending_window_moves_total Number of times the window of what is trending moved on.\n"
+		"# TYPE twitserver_trending_window_moves_total counter\n"
+		"twitserver_trending_window_moves_total %llu\n"
+		"# HELP twitserver_trending_sketch_bytes Number of bytes the counts of what is trending take.\n"
+		"# TYPE twitserver_trending_sketch_bytes gauge\n"
+		"twitserver_trending_sketch_bytes %llu\n"
+		"# HELP twitserver_trends_requests_total Number of requests for what is trending answered.\n"
+		"# TYPE twitserver_trends_requests_total counter\n"
+		"twitserver_trends_requests_total %llu\n",
+		( unsigned long long )__atomic_load_n( &tr->tr_twits, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &tr->tr_kinds[ TRENDING_TAGS ].ts_counted, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &tr->tr_kinds[ TRENDING_WORDS ].ts_counted, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &tr->tr_kinds[ TRENDING_TAGS ].ts_replaced, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &tr->tr_kinds[ TRENDING_WORDS ].ts_replaced, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &tr->tr_moves, __ATOMIC_RELAXED ),
+		( unsigned long long )trendingmemory(),
+		( unsigned long long )__atomic_load_n( &si->si_trendsqueries, __ATOMIC_RELAXED ) ) );
+}
+
+static int formattwitlog( struct textbuffer * restrict tb, struct serverinfo * restrict si ){
+	struct twitlogstats tls;
+	int status = 0;
+
+	assert( tb != NULL );
+	assert( si != NULL );
+
+	snapshottwitlog( si->si_twitlog, &tls );
+	status |= appendtext( tb,
+		"# HELP twitserver_twitlog_twits_total Number of twits written to the twit log or left out of it.\n"
+		"# TYPE twitserver_twitlog_twits_total counter\n"
+		"twitserver_twitlog_twits_total{result=\"written\"} %llu\n"
+		"twitserver_twitlog_twits_total{result=\"dropped\"} %llu\n"
+		"# HELP twitserver_twitlog_bytes_total Number of bytes written to the twit log.\n"
+		"# TYPE twitserver_twitlog_bytes_total counter\n"
+		"twitserver_twitlog_bytes_total %llu\n"
+		"# HELP twitserver_twitlog_segments_total Number of segments of the twit log started.\n"
+		"# TYPE twitserver_twitlog_segments_total counter\n"
+		"twitserver_twitlog_segments_total %llu\n"
+		"# HELP twitserver_twitlog_errors_total Number of writes, syncs, removals, compactions and compressions of the twit log that failed.\n"
+		"# TYPE twitserver_twitlog_errors_total counter\n"
+		"twitserver_twitlog_errors_total %llu\n"
+		"# HELP twitserver_twitlog_acked_total Number of twits synced for the durable sayers and resuming hearers waiting for them.\n"
+		"# TYPE twitserver_twitlog_acked_total counter\n"
+		"twitserver_twitlog_acked_total %llu\n"
+		"# HELP twitserver_twitlog_commits_total Number of syncs of the twit log done for those waiting.\n"
+		"# TYPE twitserver_twitlog_commits_total counter\n"
+		"twitserver_twitlog_commits_total %llu\n"
+		"# HELP twitserver_replayed_twits_total Number of twits replayed to resuming hearers, by where they were found.\n"
+		"# TYPE twitserver_replayed_twits_total counter\n"
+		"twitserver_replayed_twits_total{source=\"memory\"} %llu\n"
+		"twitserver_replayed_twits_total{source=\"disk\"} %llu\n"
+		"# HELP twitserver_twitlog_removed_segments_total Number of segments of the twit log removed or archived by the retention.\n"
+		"# TYPE twitserver_twitlog_removed_segments_total counter\n"
+		"twitserver_twitlog_removed_segments_total %llu\n"
+		"# HELP twitserver_twitlog_reclaimed_bytes_total Number of bytes of the twit log removed or archived, or saved by compaction and compression.\n"
+		"# TYPE twitserver_twitlog_reclaimed_bytes_total counter\n"
+		"twitserver_twitlog_reclaimed_bytes_total %llu\n"
+		"# HELP twitserver_twitlog_compacted_segments_total Number of segments of the twit log compacted.\n"
+		"# TYPE twitserver_twitlog_compacted_segments_total counter\n"
+		"twitserver_twitlog_compacted_segments_total %llu\n"
+		"# HELP twitserver_twitlog_compacted_bytes_total Number of bytes of the segments of the twit log compacted.\n"
+		"# TYPE twitserver_twitlog_compacted_bytes_total counter\n"
+		"twitserver_twitlog_compacted_bytes_total %llu\n"
+		"# HELP twitserver_twitlog_compaction_seconds_total Time spent compacting segments of the twit log.\n"
+		"# TYPE twitserver_twitlog_compaction_seconds_total counter\n"
+		"twitserver_twitlog_compaction_seconds_total %.6f\n"
+		"# HELP twitserver_twitlog_duplicates_total Number of duplicate twits compaction left out of the twit log.\n"
+		"# TYPE twitserver_twitlog_duplicates_total counter\n"
+		"twitserver_twitlog_duplicates_total %llu\n"
+		"# HELP twitserver_twitlog_compressed_segments_total Number of segments of the twit log compressed.\n"
+		"# TYPE twitserver_twitlog_compressed_segments_total counter\n"
+		"twitserver_twitlog_compressed_segments_total %llu\n"
+		"# HELP twitserver_twitlog_compressed_bytes_total Number of bytes of the segments of the twit log compressed, before and after.\n"
+		"# TYPE twitserver_twitlog_compressed_bytes_total counter\n"
+		"twitserver_twitlog_compressed_bytes_total{stage=\"in\"} %llu\n"
+		"twitserver_twitlog_compressed_bytes_total{stage=\"out\"} %llu\n"
+		"# HELP twitserver_twitlog_next_sequence Sequence number the next twit will get.\n"
+		"# TYPE twitserver_twitlog_next_sequence gauge\n"
+		"twitserver_twitlog_next_sequence %llu\n"
+		"# HELP twitserver_twitlog_sync_seconds Time each sync of the twit log took.\n"
+		"# TYPE twitserver_twitlog_sync_seconds histogram\n",
+		( unsigned long long )tls.tls_written,
+		( unsigned long long )tls.tls_dropped,
+		( unsigned long long )tls.tls_bytes,
+		( unsigned long long )tls.tls_segments,
+		( unsigned long long )tls.tls_errors,
+		( unsigned long long )tls.tls_acked,
+		( unsigned long long )tls.tls_commits,
+		( unsigned long long )__atomic_load_n( &si->si_replayed_memory, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_replayed_disk, __ATOMIC_RELAXED ),
+		( unsigned long long )tls.tls_removed,
+		( unsigned long long )tls.tls_reclaimed,
+		( unsigned long long )tls.tls_compacted,
+		( unsigned long long )tls.tls_compactbytes,
+		tls.tls_compactns / 1e9,
+		( unsigned long long )tls.tls_duplicates,
+		( unsigned long long )tls.tls_compressed,
+		( unsigned long long )tls.tls_compressedin,
+		( unsigned long long )tls.tls_compressedout,
+		( unsigned long long )tls.tls_nextseq );
+	status |= formathistogram( tb, "twitserver_twitlog_sync_seconds", "sync", twitlogsyncname( TWITLOG_SYNC ), &tls.tls_sync );
+
+	return ( status );
+}
+
+#if defined( LOCK_STATS )
+// Format the counters and histograms of every lock; one metric at a time
+static int formatlockstats( struct textbuffer * restrict tb ){
+	struct lockstats ls;
+	int name;
+	int status = 0;
+
+	assert( tb != NULL );
+
+	status |= appendtext( tb,
+		"# HELP twitserver_lock_acquisitions_total Number of times each lock was acquired.\n"
+		"# TYPE twitserver_lock_acquisitions_total counter\n" );
+	for ( name = 0; name < LOCK_NAMES; ++name ){
+		snapshotlockstats( name, &ls );
+		status |= appendtext( tb, "twitserver_lock_acquisitions_total{lock=\"%s\"} %llu\n",
+			lockstatsname( name ), ( unsigned long long )ls.ls_acquired );
+	}
+	status |= appendtext( tb,
+		"# HELP twitserver_lock_contended_total Number of times each lock was owned by another thread when asked for.\n"
+		"# TYPE twitserver_lock_contended_total counter\n" );
+	for ( name = 0; name < LOCK_NAMES; ++name ){
+		snapshotlockstats( name, &ls );
+		status |= appendtext( tb, "twitserver_lock_contended_total{lock=\"%s\"} %llu\n",
+			lockstatsname( name ), ( unsigned long long )ls.ls_contended );
+	}
+	status |= appendtext( tb,
+		"# HELP twitserver_lock_wait_seconds Time spent waiting for each lock when contended.\n"
+		"# TYPE twitserver_lock_wait_seconds histogram\n" );
+	for ( name = 0; name < LOCK_NAMES; ++name ){
+		snapshotlockstats( name, &ls );
+		status |= formathistogram( tb, "twitserver_lock_wait_seconds", "lock", lockstatsname( name ), &ls.ls_wait );
+	}
+	status |= appendtext( tb,
+		"# HELP twitserver_lock_hold_seconds Time each lock was owned.\n"
+		"# TYPE twitserver_lock_hold_seconds histogram\n" );
+	for ( name = 0; name < LOCK_NAMES; ++name ){
+		snapshotlockstats( name, &ls );
+		status |= formathistogram( tb, "twitserver_lock_hold_seconds", "lock", lockstatsname( name ), &ls.ls_hold );
+	}
+
+	return ( status );
+}
+#endif
+
+// Format a histogram. The buckets of the histogram are merged into power of two buckets
+static int formathistogram( struct textbuffer * restrict tb, const char * restrict name, const char * restrict label,
+	const char * restrict value, const struct histogram * restrict h ){
+	uint64_t cumulative = 0;
+	uint64_t upper;
+	int bucket;
+	int status = 0;
+
+	assert( tb != NULL );
+	assert( name != NULL );
+	assert( label != NULL );
+	assert( value != NULL );
+	assert( h != NULL );
+
+	for ( bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket ){
+		cumulative += h->h_counts[ bucket ];
+		upper = histogrambucketmax( bucket ) + 1;
+		// Only the buckets that end at a power of two
+		if ( upper >= ( ( uint64_t )1 << METRICS_MINBITS ) && ( upper & ( upper - 1 ) ) == 0 ){
+			status |= appendtext( tb, "%s_bucket{%s=\"%s\",le=\"%.9f\"} %llu\n",
+				name, label, value, upper / 1e9, ( unsigned long long )cumulative );
+		}
+	}
+	status |= appendtext( tb,
+		"%s_bucket{%s=\"%s\",le=\"+Inf\"} %llu\n"
+		"%s_sum{%s=\"%s\"} %.9f\n"
+		"%s_count{%s=\"%s\"} %llu\n",
+		name, label, value, ( unsigned long long )h->h_count,
+		name, label, value, h->h_sum / 1e9,
+		name, label, value, ( unsigned long long )h->h_count );
+
+	return ( status );
+}
+
+// printf() into the buffer, growing it as needed
+static int appendtext( struct textbuffer * restrict tb, const char * restrict format, ... ){
+	va_list ap;
+	int len;
+
+	assert( tb != NULL );
+	assert( format != NULL );
+
+	while ( 1 ){
+		size_t available = tb->tb_size - tb->tb_len;
+
+		va_start( ap, format );
+		len = vsnprintf( tb->tb_text == NULL ? NULL : tb->tb_text + tb->tb_len, available, format, ap );
+		va_end( ap );
+		if ( len < 0 ){
+			return ( -1 );
+		}
+		if ( ( size_t )len < available ){
+			tb->tb_len += len;
+			break;
+		}
+
+		// Did not fit; at least double the buffer and retry
+		{
+			size_t newsize = 2 * tb->tb_size + len + 1;
+			char *newtext = realloc( tb->tb_text, newsize );
+			if ( newtext == NULL ){
+				return ( -1 );
+			}
+			tb->tb_text = newtext;
+			tb->tb_size = newsize;
+		}
+	}
+
+	return ( 0 );
+}
@@ -0,0 +1,282 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file prefilter.c
+ *
+ * File prefilter.c contains the implementation of the prefilter.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include "prefilter.h"
+
+// The vector code is built with the target attribute of gcc, so the rest of the server needs no flags for it
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define PREFILTER_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * The bucketof() function shall find the bucket of the keyword in lower case pointed to by parameter word.
+ *
+ * @return The bucket.
+ */
+static unsigned bucketof( const unsigned char * restrict word );
+
+/**
+ * The countkeyword() function shall add the value given as parameter delta to the counts of the prefilter pointed to by parameter
+ * pf for the keyword of len bytes pointed to by parameter word, and build its tables again.
+ *
+ * @return Nothing.
+ */
+static void countkeyword( struct prefilter * restrict pf, const unsigned char * restrict word, size_t len, int delta );
+
+/**
+ * The scanscalar(), scansse42() and scanavx2() functions shall do what prefilter() does, one position at a time, 16 positions at
+ * a time with SSE4.2 and 32 positions at a time with AVX2.
+ *
+ * @return The first position where a keyword may start; len if there is none.
+ */
+static size_t scanscalar( const struct prefilter * restrict pf, const unsigned char * restrict text, size_t len );
+#if defined( PREFILTER_X86 )
+static size_t scansse42( const struct prefilter * restrict pf, const unsigned char * restrict text, size_t len ) __attribute__(( target( "sse4.2" ) ));
+static size_t scanavx2( const struct prefilter * restrict pf, const unsigned char * restrict text, size_t len ) __attribute__(( target( "avx2" ) ));
+#endif
+
+
+
+void initprefilter( struct prefilter * restrict pf ){
+	assert( pf != NULL );
+
+	( void )memset( pf, 0, sizeof( *pf ) );
+	pf->pf_bytes = PREFILTER_BYTES;
+	if ( setprefilterkind( pf, PREFILTER_AVX2 ) == -1 && setprefilterkind( pf, PREFILTER_SSE42 ) == -1 ){
+		( void )setprefilterkind( pf, PREFILTER_SCALAR );
+	}
+
+	return ;
+}
+
+int setprefilterkind( struct prefilter * restrict pf, enum prefilterkind kind ){
+	assert( pf != NULL );
+
+	if ( kind == PREFILTER_SCALAR ){
+		pf->pf_scan = &scanscalar;
+	}
+#if defined( PREFILTER_X86 )
+	else if ( kind == PREFILTER_SSE42 && ( __builtin_cpu_init(), __builtin_cpu_supports( "sse4.2" ) ) ){
+		pf->pf_scan = &scansse42;
+	}
+	else if ( kind == PREFILTER_AVX2 && ( __builtin_cpu_init(), __builtin_cpu_supports( "avx2" ) ) ){
+		pf->pf_scan = &scanavx2;
+	}
+#endif
+	else{
+		errno = ENOTSUP;
+		return ( -1 );
+	}
+	pf->pf_kind = kind;
+
+	return ( 0 );
+}
+
+void addtoprefilter( struct prefilter * restrict pf, const unsigned char * restrict word, size_t len ){
+	assert( pf != NULL );
+	assert( word != NULL && len > 0 );
+
+	countkeyword( pf, word, len, 1 );
+
+	return ;
+}
+
+void removefromprefilter( struct prefilter * restrict pf, const unsigned char * restrict word, size_t len ){
+	assert( pf != NULL );
+	assert( word != NULL && len > 0 );
+
+	countkeyword( pf, word, len, -1 );
+
+	return ;
+}
+
+size_t prefilter( const struct prefilter * restrict pf, const unsigned char * restrict text, size_t len ){
+	assert( pf != NULL );
+	assert( text != NULL || len == 0 );
+
+	return ( pf->pf_scan( pf, text, len ) );
+}
+
+
+
+// Implementation of local functions...
+
+// By the low bits of the first byte: the letters that share them differ in one bit of each nibble, so the tables of the first byte
+// let through no other letter
+static unsigned bucketof( const unsigned char * restrict word ){
+	return ( word[ 0 ] & ( PREFILTER_BUCKETS - 1 ) );
+}
+
+// A letter counts for the high nibble of its upper case too; the low nibble is the same
+static void countkeyword( struct prefilter * restrict pf, const unsigned char * restrict word, size_t len, int delta ){
+	unsigned bucket = bucketof( word );
+	unsigned char c;
+	unsigned char lo;
+	unsigned char hi;
+	size_t m;
+	size_t n;
+	unsigned b;
+
+	if ( len < PREFILTER_BYTES ){
+		pf->pf_short[ len ] += ( uint32_t )delta;
+	}
+	for ( m = 0; m < len && m < PREFILTER_BYTES; ++m ){
+		c = word[ m ];
+		pf->pf_counts[ m ][ 0 ][ c & 0x0f ][ bucket ] += ( uint32_t )delta;
+		pf->pf_counts[ m ][ 1 ][ c >> 4 ][ bucket ] += ( uint32_t )delta;
+		if ( c >= 'a' && c <= 'z' ){
+			pf->pf_counts[ m ][ 1 ][ ( c - 'a' + 'A' ) >> 4 ][ bucket ] += ( uint32_t )delta;
+		}
+	}
+
+	// The shortest keyword decides how many bytes are looked at
+	for ( pf->pf_bytes = 1; pf->pf_bytes < PREFILTER_BYTES && pf->pf_short[ pf->pf_bytes ] == 0; ++pf->pf_bytes ){
+		continue;
+	}
+	for ( m = 0; m < PREFILTER_BYTES; ++m ){
+		for ( n = 0; n < 16; ++n ){
+			lo = 0;
+			hi = 0;
+			for ( b = 0; b < PREFILTER_BUCKETS; ++b ){
+				lo |= ( unsigned char )( ( pf->pf_counts[ m ][ 0 ][ n ][ b ] > 0 ) << b );
+				hi |= ( unsigned char )( ( pf->pf_counts[ m ][ 1 ][ n ][ b ] > 0 ) << b );
+			}
+			pf->pf_lo[ m ][ n ] = pf->pf_lo[ m ][ n + 16 ] = lo;
+			pf->pf_hi[ m ][ n ] = pf->pf_hi[ m ][ n + 16 ] = hi;
+		}
+	}
+
+	return ;
+}
+
+// A keyword is at least pf_bytes long, so it cannot start in the last pf_bytes - 1 positions
+static size_t scanscalar( const struct prefilter * restrict pf, const unsigned char * restrict text, size_t len ){
+	unsigned char buckets;
+	size_t i;
+	size_t m;
+
+	for ( i = 0; i + pf->pf_bytes <= len; ++i ){
+		buckets = 0xff;
+		for ( m = 0; m < pf->pf_bytes && buckets != 0; ++m ){
+			buckets &= pf->pf_lo[ m ][ text[ i + m ] & 0x0f ] & pf->pf_hi[ m ][ text[ i + m ] >> 4 ];
+		}
+		if ( buckets != 0 ){
+			return ( i );
+		}
+	}
+
+	return ( len );
+}
+
+#if defined( PREFILTER_X86 )
+// The loads for the later bytes of the keywords are at later positions, so the buckets of each lane line up with the first byte.
+// The last step has what is left copied before zeros, which no keyword has
+static size_t scansse42( const struct prefilter * restrict pf, const unsigned char * restrict text, size_t len ){
+	const __m128i nibble = _mm_set1_epi8( 0x0f );
+	const __m128i zero = _mm_setzero_si128();
+	unsigned char tail[ 16 + PREFILTER_BYTES ] = { 0 };
+	__m128i lo[ PREFILTER_BYTES ];
+	__m128i hi[ PREFILTER_BYTES ];
+	__m128i buckets;
+	__m128i v;
+	const unsigned char *block = NULL;
+	size_t i;
+	size_t m;
+	unsigned mask;
+
+	for ( m = 0; m < pf->pf_bytes; ++m ){
+		lo[ m ] = _mm_loadu_si128( ( const __m128i * )pf->pf_lo[ m ] );
+		hi[ m ] = _mm_loadu_si128( ( const __m128i * )pf->pf_hi[ m ] );
+	}
+	for ( i = 0; i + pf->pf_bytes <= len; i += 16 ){
+		block = text + i;
+		if ( i + 16 + pf->pf_bytes - 1 > len ){
+			( void )memcpy( tail, block, len - i );
+			block = tail;
+		}
+		buckets = _mm_set1_epi8( ( char )0xff );
+		for ( m = 0; m < pf->pf_bytes; ++m ){
+			v = _mm_loadu_si128( ( const __m128i * )( block + m ) );
+			buckets = _mm_and_si128( buckets, _mm_and_si128( _mm_shuffle_epi8( lo[ m ], _mm_and_si128( v, nibble ) ),
+				_mm_shuffle_epi8( hi[ m ], _mm_and_si128( _mm_srli_epi16( v, 4 ), nibble ) ) ) );
+		}
+		if ( ( mask = ( unsigned )_mm_movemask_epi8( _mm_cmpeq_epi8( buckets, zero ) ) ^ 0xffffu ) != 0 ){
+			return ( i + ( size_t )__builtin_ctz( mask ) );
+		}
+	}
+
+	return ( len );
+}
+
+// As scansse42(), the tables repeated in both halves since the shuffles do not cross them
+static size_t scanavx2( const struct prefilter * restrict pf, const unsigned char * restrict text, size_t len ){
+	const __m256i nibble = _mm256_set1_epi8( 0x0f );
+	const __m256i zero = _mm256_setzero_si256();
+	unsigned char tail[ 32 + PREFILTER_BYTES ] = { 0 };
+	__m256i lo[ PREFILTER_BYTES ];
+	__m256i hi[ PREFILTER_BYTES ];
+	__m256i buckets;
+	__m256i v;
+	const unsigned char *block = NULL;
+	size_t i;
+	size_t m;
+	uint32_t mask;
+
+	for ( m = 0; m < pf->pf_bytes; ++m ){
+		lo[ m ] = _mm256_loadu_si256( ( const __m256i * )pf->pf_lo[ m ] );
+		hi[ m ] = _mm256_loadu_si256( ( const __m256i * )pf->pf_hi[ m ] );
+	}
+	for ( i = 0; i + pf->pf_bytes <= len; i += 32 ){
+		block = text + i;
+		if ( i + 32 + pf->pf_bytes - 1 > len ){
+			( void )memcpy( tail, block, len - i );
+			block = tail;
+		}
+		buckets = _mm256_set1_epi8( ( char )0xff );
+		for ( m = 0; m < pf->pf_bytes; ++m ){
+			v = _mm256_loadu_si256( ( const __m256i * )( block + m ) );
+			buckets = _mm256_and_si256( buckets, _mm256_and_si256( _mm256_shuffle_epi8( lo[ m ], _mm256_and_si256( v, nibble ) ),
+				_mm256_shuffle_epi8( hi[ m ], _mm256_and_si256( _mm256_srli_epi16( v, 4 ), nibble ) ) ) );
+		}
+		if ( ( mask = ~( uint32_t )_mm256_movemask_epi8( _mm256_cmpeq_epi8( buckets, zero ) ) ) != 0 ){
+			return ( i + ( size_t )__builtin_ctz( mask ) );
+		}
+	}
+
+	return ( len );
+}
+#endif
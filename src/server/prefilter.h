@@ -0,0 +1,135 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file prefilter.h
+ *
+ * File prefilter.h declares the prefilter the automaton of the keywords (see keywords.h) runs behind. Most twits have none of the
+ * keywords in them, and the prefilter rejects those a few cycles a byte, before the automaton goes through them a byte at a time.
+ *
+ * It is the fingerprint matching of Teddy: each keyword is put in one of eight buckets, and for each of the first PREFILTER_BYTES
+ * bytes of the keywords, a table of 16 entries for the low nibble of the byte and another one for the high nibble have the bits of
+ * the buckets of the keywords with that nibble there. A position of the twit is a candidate if, for each of those bytes, both of its
+ * nibbles have a bucket in common in all the tables; with SSE4.2 and AVX2 the lookups are byte shuffles over 16 or 32 positions at
+ * once. A candidate may be a false positive, but a position that is not a candidate cannot start a keyword, so the automaton starts
+ * from the first candidate, if there is one. The tables use the shortest keyword, up to PREFILTER_BYTES bytes, and match either case
+ * of the letters.
+ *
+ * The tables are built from counts kept for each keyword with subscribers, so a keyword that comes or goes only changes those. The
+ * code for the instructions the processor has is chosen at run time, with the scalar one for the others.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( PREFILTER_H_IS_INCLUDED )
+#define PREFILTER_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bytes of the keywords the prefilter looks at, at most
+#define PREFILTER_BYTES (4)
+
+// Buckets of the keywords, one for each bit of a byte
+#define PREFILTER_BUCKETS (8)
+
+/**
+ * \enum prefilterkind
+ *
+ * The code the prefilter runs.
+ */
+enum prefilterkind{
+	PREFILTER_SCALAR,
+	PREFILTER_SSE42,
+	PREFILTER_AVX2
+};
+
+/**
+ * \struct prefilter
+ *
+ * The prefilter structure holds the tables, 32 bytes each so AVX2 loads both halves at once, and the counts they are built from.
+ */
+struct prefilter{
+	unsigned char pf_lo[ PREFILTER_BYTES ][ 32 ]; /**< The buckets with each low nibble at each byte */
+	unsigned char pf_hi[ PREFILTER_BYTES ][ 32 ]; /**< The buckets with each high nibble at each byte */
+	uint32_t pf_counts[ PREFILTER_BYTES ][ 2 ][ 16 ][ PREFILTER_BUCKETS ]; /**< Keywords of each bucket with each nibble at each byte */
+	uint32_t pf_short[ PREFILTER_BYTES ]; /**< Keywords of each length shorter than PREFILTER_BYTES, by length */
+	size_t pf_bytes; /**< Bytes of the keywords the tables are used for */
+	enum prefilterkind pf_kind;
+	size_t ( *pf_scan )( const struct prefilter * restrict pf, const unsigned char * restrict text, size_t len );
+};
+
+
+
+/**
+ * The initprefilter() function shall initialize the prefilter pointed to by parameter pf with no keywords, to run the best code
+ * for the processor.
+ *
+ * @return Nothing.
+ */
+void initprefilter( struct prefilter * restrict pf );
+
+/**
+ * The setprefilterkind() function shall have the prefilter pointed to by parameter pf run the code given as parameter kind.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate
+ *	the error.
+ * @exception ENOTSUP The processor does not have the instructions of that code.
+ */
+int setprefilterkind( struct prefilter * restrict pf, enum prefilterkind kind );
+
+/**
+ * The addtoprefilter() function shall add the keyword of len bytes, in lower case, pointed to by parameter word to the prefilter
+ * pointed to by parameter pf.
+ *
+ * @return Nothing.
+ */
+void addtoprefilter( struct prefilter * restrict pf, const unsigned char * restrict word, size_t len );
+
+/**
+ * The removefromprefilter() function shall remove the keyword of len bytes pointed to by parameter word, as it was added with
+ * addtoprefilter(), from the prefilter pointed to by parameter pf.
+ *
+ * @return Nothing.
+ */
+void removefromprefilter( struct prefilter * restrict pf, const unsigned char * restrict word, size_t len );
+
+/**
+ * The prefilter() function shall find the first position of the len bytes pointed to by parameter text where a keyword of the
+ * prefilter pointed to by parameter pf may start.
+ *
+ * @return The position; len if there is none.
+ */
+size_t prefilter( const struct prefilter * restrict pf, const unsigned char * restrict text, size_t len );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
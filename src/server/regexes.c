@@ -0,0 +1,1163 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file regexes.c
+ *
+ * File regexes.c contains the implementation of the regexes.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "regexes.h"
+#include "topicframe.h"
+
+#if 8 + HEARER_REGEXES_MAXCOUNT * ( REGEX_MAXLEN + 1 ) > TOPICFRAME_REQUEST_MAXLEN
+#error "The request line of topicframe.h must fit HEARER_REGEXES_MAXCOUNT regular expressions"
+#endif
+
+#if REGEX_CACHE_MAXSIZE / 4 >= UINT32_MAX
+#error "The cache must be numbered in words within 32 bits"
+#endif
+
+#if REGEX_MAXLEN + 1 > ( 1 << REGEX_NODE_SHIFT ) || REGEX_MAXLEN * 2 + 1 >= 0xff
+#error "The states of an NFA must be numbered within REGEX_NODE_SHIFT bits, and the outs left to patch within a byte"
+#endif
+
+// No state of an NFA, and the end of a list of the outs left to patch
+#define REGEX_NONE (0xff)
+
+// No state of the DFA, and no slot
+#define REGEX_NOSTATE ( UINT32_MAX )
+
+// The cache thrashes if it is flushed before the scan went through REGEX_THRASH_BYTES bytes for each of its states
+#define REGEX_THRASH_BYTES (10)
+
+// The slots the regular expressions start with
+#define REGEX_INITIAL_SLOTS (64)
+
+// The state of the DFA at the word given of the cache, and the words it takes with no states of the NFAs
+#define REGEX_DSTATE( rx, state ) ( ( struct regexdstate * )( ( rx )->rx_cache + ( state ) ) )
+#define REGEX_DSTATE_WORDS ( sizeof( struct regexdstate ) / sizeof( uint32_t ) )
+
+// The state of the slot of a state of an NFA
+#define REGEX_STATE( id, node ) ( ( ( id ) & ~( ( 1u << REGEX_NODE_SHIFT ) - 1 ) ) | ( node ) )
+
+// The outs left to patch are listed through the outs themselves: the out rn_out of the state n is n * 2, its rn_out1 n * 2 + 1
+#define REGEX_OUT( n ) ( ( uint8_t )( ( n ) * 2 ) )
+#define REGEX_OUT1( n ) ( ( uint8_t )( ( n ) * 2 + 1 ) )
+
+/**
+ * \struct regexparser
+ *
+ * The regexparser structure holds what the parse of a regular expression has made so far.
+ */
+struct regexparser{
+	const char *rpa_at; /**< The next character */
+	const char *rpa_end;
+	struct regexnode *rpa_nodes;
+	int rpa_count;
+	uint32_t ( *rpa_classes )[ 8 ]; /**< REGEX_MAXLEN classes */
+	int rpa_classcount;
+};
+
+/**
+ * \struct regexfrag
+ *
+ * The regexfrag structure is a part of an NFA made by the parse: its first state and the list of its outs left to patch.
+ */
+struct regexfrag{
+	uint8_t rf_start;
+	uint8_t rf_outs;
+};
+
+/**
+ * The patternlen() function shall find the length of the regular expression at the start of the string pointed to by parameter
+ * patterns, up to the first character that cannot be in one or the end.
+ *
+ * @return The length of the regular expression; zero if there is none or it is longer than REGEX_MAXLEN.
+ */
+static size_t patternlen( const char * restrict patterns );
+
+/**
+ * The compilepattern() function shall compile the regular expression of len bytes pointed to by parameter pattern to the NFA of the
+ * slot pointed to by parameter rp, with its classes stored in the array pointed to by parameter classes, of REGEX_MAXLEN of them.
+ * The rp_classes member is left alone.
+ *
+ * @return Upon successful completion the number of classes shall be returned; otherwise, -1 shall be returned.
+ */
+static int compilepattern( const char * restrict pattern, size_t len, struct regexpattern * restrict rp, uint32_t ( *classes )[ 8 ] );
+
+/**
+ * The parsealt(), parseconcat(), parserepeat() and parseatom() functions shall parse the alternatives, the concatenation, the
+ * repetition and the atom at the next character of the parse pointed to by parameter pa, and store what they made in the object
+ * pointed to by parameter frag.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ */
+static int parsealt( struct regexparser * restrict pa, struct regexfrag * restrict frag );
+static int parseconcat( struct regexparser * restrict pa, struct regexfrag * restrict frag );
+static int parserepeat( struct regexparser * restrict pa, struct regexfrag * restrict frag );
+static int parseatom( struct regexparser * restrict pa, struct regexfrag * restrict frag );
+
+/**
+ * The parseclass() function shall parse the class at the next character of the parse pointed to by parameter pa, after its '[',
+ * and store its bytes in the array pointed to by parameter bits.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ */
+static int parseclass( struct regexparser * restrict pa, uint32_t bits[ 8 ] );
+
+/**
+ * The escapeclass() function shall add to the array pointed to by parameter bits the bytes of the class that the escape with the
+ * character given as parameter c stands for, if it is one.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+static int escapeclass( char c, uint32_t bits[ 8 ] );
+
+/**
+ * The newnode() function shall add to the NFA of the parse pointed to by parameter pa a state with the op, the argument and the
+ * outs given as parameters.
+ *
+ * @return Upon successful completion the state shall be returned; otherwise, -1 shall be returned.
+ */
+static int newnode( struct regexparser * restrict pa, enum regexop op, uint8_t arg, uint8_t out, uint8_t out1 );
+
+/**
+ * The newclass() function shall add the bytes in the array pointed to by parameter bits as a class of the parse pointed to by
+ * parameter pa, and a state that goes on them.
+ *
+ * @return Upon successful completion the state shall be returned; otherwise, -1 shall be returned.
+ */
+static int newclass( struct regexparser * restrict pa, const uint32_t bits[ 8 ] );
+
+/**
+ * The patchouts() function shall set the outs of the list given as parameter outs, of the NFA pointed to by parameter nodes, to the
+ * state given as parameter target.
+ *
+ * @return Nothing.
+ */
+static void patchouts( struct regexnode * restrict nodes, uint8_t outs, uint8_t target );
+
+/**
+ * The appendouts() function shall append the list of outs given as parameter second to the one given as parameter first, of the
+ * NFA pointed to by parameter nodes.
+ *
+ * @return The list.
+ */
+static uint8_t appendouts( struct regexnode * restrict nodes, uint8_t first, uint8_t second );
+
+/**
+ * The matchesempty() function shall check whether the NFA of the slot pointed to by parameter rp matches without a byte.
+ *
+ * @return Nonzero if it does, zero otherwise.
+ */
+static int matchesempty( const struct regexpattern * restrict rp );
+
+/**
+ * The newslot() function shall take a free slot of the regular expressions pointed to by parameter rx, adding slots if there is
+ * none.
+ *
+ * @return The slot; REGEX_NOSTATE if there is not enough memory for it.
+ */
+static uint32_t newslot( struct regexes * restrict rx );
+
+/**
+ * The addstarts() function shall add the states the NFA of the slot given as parameter slot goes to from its start to the lists of
+ * the bytes it goes on, in the regular expressions pointed to by parameter rx.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ */
+static int addstarts( struct regexes * restrict rx, uint32_t slot );
+
+/**
+ * The removestarts() function shall take the states of the free slots out of the lists of the bytes of the regular expressions
+ * pointed to by parameter rx.
+ *
+ * @return Nothing.
+ */
+static void removestarts( struct regexes * restrict rx );
+
+/**
+ * The addclosure() function shall add to the set pointed to by parameter set the state given as parameter id, of the NFAs of the
+ * regular expressions pointed to by parameter rx, and those it goes to on no byte.
+ *
+ * @return Nothing.
+ */
+static void addclosure( struct regexes * restrict rx, struct regexset * restrict set, uint32_t id );
+
+/**
+ * The stepset() function shall add to the set pointed to by parameter to the states the count states pointed to by parameter ids,
+ * and the start of every NFA, go to on the byte given as parameter byte.
+ *
+ * @return Nothing.
+ */
+static void stepset( struct regexes * restrict rx, const uint32_t * restrict ids, uint32_t count, unsigned char byte,
+	struct regexset * restrict to );
+
+/**
+ * The makestate() function shall make the state of the DFA the state given as parameter from goes to on the byte given as parameter
+ * byte, with the states of the NFAs left in rx_sets[ 0 ], flushing the cache if it is full; the state from is then gone. The object
+ * pointed to by parameter thrashed is set to nonzero if the cache was flushed too soon.
+ *
+ * @return The state; REGEX_NOSTATE if it does not fit in the cache.
+ */
+static uint32_t makestate( struct regexes * restrict rx, uint32_t from, unsigned char byte, int * restrict thrashed );
+
+/**
+ * The sizecache() function shall resize the cache of the regular expressions pointed to by parameter rx for those subscribed to,
+ * and its hash table with it. The cache shall be flushed after it; if there is not enough memory the size it had is kept.
+ *
+ * @return Nothing.
+ */
+static void sizecache( struct regexes * restrict rx );
+
+/**
+ * The flushcache() function shall empty the cache of the regular expressions pointed to by parameter rx, but for the state the scan
+ * starts from.
+ *
+ * @return Nothing.
+ */
+static void flushcache( struct regexes * restrict rx );
+
+/**
+ * The addstate() function shall add to the cache of the regular expressions pointed to by parameter rx a state with the count
+ * states of the NFAs in rx_key and the hash given as parameter hash. The cache shall have room for it.
+ *
+ * @return The state.
+ */
+static uint32_t addstate( struct regexes * restrict rx, uint32_t count, uint32_t hash );
+
+/**
+ * The scannfa() function shall go on with the scan of the len bytes pointed to by parameter text from the states of the NFAs in
+ * rx_sets[ 0 ], without the cache, and set the bits of the slots that match.
+ *
+ * @return Nothing.
+ */
+static void scannfa( struct regexes * restrict rx, const unsigned char * restrict text, size_t len );
+
+/**
+ * The hitset() function shall set the bits of the slots whose NFA matched in the set pointed to by parameter set.
+ *
+ * @return Nothing.
+ */
+static void hitset( struct regexes * restrict rx, const struct regexset * restrict set );
+
+/**
+ * The compareids() function shall compare the states of the NFAs pointed to by parameters a and b, for qsort().
+ *
+ * @return Less than, equal to or greater than zero as the first is less than, equal to or greater than the second.
+ */
+static int compareids( const void *a, const void *b );
+
+
+
+int initregexes( struct regexes * restrict rx, size_t cachesize, size_t regexbytes ){
+	assert( rx != NULL );
+
+	( void )memset( rx, 0, sizeof( *rx ) );
+	if ( cachesize < 4 * sizeof( struct regexdstate ) || cachesize / sizeof( uint32_t ) >= REGEX_NOSTATE ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	rx->rx_mincachesize = cachesize;
+	rx->rx_regexbytes = regexbytes;
+	// With none subscribed to, the cache is allocated at its least
+	sizecache( rx );
+	rx->rx_capacity = REGEX_INITIAL_SLOTS;
+	rx->rx_patterns = malloc( REGEX_INITIAL_SLOTS * sizeof( *rx->rx_patterns ) );
+	rx->rx_sets[ 0 ].rs_dense = malloc( ( REGEX_INITIAL_SLOTS << REGEX_NODE_SHIFT ) * sizeof( uint32_t ) );
+	rx->rx_sets[ 0 ].rs_sparse = calloc( REGEX_INITIAL_SLOTS << REGEX_NODE_SHIFT, sizeof( uint32_t ) );
+	rx->rx_sets[ 1 ].rs_dense = malloc( ( REGEX_INITIAL_SLOTS << REGEX_NODE_SHIFT ) * sizeof( uint32_t ) );
+	rx->rx_sets[ 1 ].rs_sparse = calloc( REGEX_INITIAL_SLOTS << REGEX_NODE_SHIFT, sizeof( uint32_t ) );
+	rx->rx_stack = malloc( ( 2 * ( REGEX_INITIAL_SLOTS << REGEX_NODE_SHIFT ) + 1 ) * sizeof( uint32_t ) );
+	rx->rx_key = malloc( ( REGEX_INITIAL_SLOTS << REGEX_NODE_SHIFT ) * sizeof( uint32_t ) );
+	rx->rx_hits = calloc( REGEX_INITIAL_SLOTS / 64, sizeof( uint64_t ) );
+	if ( rx->rx_patterns == NULL || rx->rx_sets[ 0 ].rs_dense == NULL || rx->rx_sets[ 0 ].rs_sparse == NULL || rx->rx_sets[ 1 ].rs_dense == NULL ||
+		rx->rx_sets[ 1 ].rs_sparse == NULL || rx->rx_stack == NULL || rx->rx_key == NULL || rx->rx_hits == NULL || rx->rx_cache == NULL ||
+		rx->rx_buckets == NULL ){
+		delregexes( rx );
+		errno = ENOMEM;
+		return ( -1 );
+	}
+	rx->rx_free = REGEX_NOSTATE;
+	flushcache( rx );
+
+	return ( 0 );
+}
+
+void delregexes( struct regexes * restrict rx ){
+	uint32_t i;
+
+	if ( rx != NULL ){
+		for ( i = 0; i < rx->rx_top; ++i ){
+			if ( rx->rx_patterns[ i ].rp_subscriber != NULL ){
+				free( rx->rx_patterns[ i ].rp_classes );
+			}
+		}
+		for ( i = 0; i < 256; ++i ){
+			free( rx->rx_starts[ i ].rst_states );
+		}
+		free( rx->rx_buckets );
+		free( rx->rx_cache );
+		free( rx->rx_hits );
+		free( rx->rx_key );
+		free( rx->rx_stack );
+		free( rx->rx_sets[ 1 ].rs_sparse );
+		free( rx->rx_sets[ 1 ].rs_dense );
+		free( rx->rx_sets[ 0 ].rs_sparse );
+		free( rx->rx_sets[ 0 ].rs_dense );
+		free( rx->rx_patterns );
+		( void )memset( rx, 0, sizeof( *rx ) );
+	}
+
+	return ;
+}
+
+// Each one is compiled, on the stack
+int validregexes( const char * restrict patterns ){
+	struct regexpattern rp;
+	uint32_t classes[ REGEX_MAXLEN ][ 8 ];
+	size_t len;
+	int count = 0;
+
+	assert( patterns != NULL );
+
+	while ( *patterns != '\0' ){
+		if ( ( len = patternlen( patterns ) ) == 0 || ++count > HEARER_REGEXES_MAXCOUNT || compilepattern( patterns, len, &rp, classes ) == -1 ){
+			return ( 0 );
+		}
+		patterns += len;
+		// A space is followed by a regular expression
+		if ( *patterns != '\0' ){
+			if ( *patterns != ' ' || *++patterns == '\0' ){
+				return ( 0 );
+			}
+		}
+	}
+
+	return ( count > 0 );
+}
+
+// A failure half way frees the slots taken so far as unsubscribing would
+int subscriberegexes( struct regexes * restrict rx, struct regexsubscriber * restrict rsr, struct twitpoollist_node * restrict tpln,
+	const char * restrict patterns ){
+	struct regexpattern *rp = NULL;
+	uint32_t classes[ REGEX_MAXLEN ][ 8 ];
+	const char *pattern = NULL;
+	size_t len;
+	uint32_t slot;
+	int count;
+
+	assert( rx != NULL );
+	assert( rsr != NULL );
+	assert( tpln != NULL );
+	assert( patterns != NULL );
+
+	if ( !validregexes( patterns ) ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	rsr->rsr_tpln = tpln;
+	rsr->rsr_count = 0;
+	for ( pattern = patterns; *pattern != '\0'; pattern += len + ( pattern[ len ] == ' ' ) ){
+		len = patternlen( pattern );
+		if ( ( slot = newslot( rx ) ) == REGEX_NOSTATE ){
+			unsubscriberegexes( rx, rsr );
+			errno = ENOMEM;
+			return ( -1 );
+		}
+		rp = &rx->rx_patterns[ slot ];
+		count = compilepattern( pattern, len, rp, classes );
+		assert( count != -1 );
+		rp->rp_classes = NULL;
+		if ( count > 0 && ( rp->rp_classes = malloc( ( size_t )count * sizeof( *rp->rp_classes ) ) ) != NULL ){
+			( void )memcpy( rp->rp_classes, classes, ( size_t )count * sizeof( *rp->rp_classes ) );
+		}
+		rp->rp_subscriber = rsr;
+		rsr->rsr_slots[ rsr->rsr_count++ ] = slot;
+		( void )__atomic_fetch_add( &rx->rx_count, 1, __ATOMIC_RELAXED );
+		if ( ( count > 0 && rp->rp_classes == NULL ) || addstarts( rx, slot ) == -1 ){
+			unsubscriberegexes( rx, rsr );
+			errno = ENOMEM;
+			return ( -1 );
+		}
+	}
+	sizecache( rx );
+	flushcache( rx );
+
+	return ( rsr->rsr_count );
+}
+
+void unsubscriberegexes( struct regexes * restrict rx, struct regexsubscriber * restrict rsr ){
+	struct regexpattern *rp = NULL;
+	int i;
+
+	assert( rx != NULL );
+	assert( rsr != NULL );
+
+	if ( rsr->rsr_count == 0 ){
+		return ;
+	}
+	for ( i = 0; i < rsr->rsr_count; ++i ){
+		rp = &rx->rx_patterns[ rsr->rsr_slots[ i ] ];
+		free( rp->rp_classes );
+		rp->rp_classes = NULL;
+		rp->rp_subscriber = NULL;
+		rp->rp_nextfree = rx->rx_free;
+		rx->rx_free = rsr->rsr_slots[ i ];
+		( void )__atomic_fetch_sub( &rx->rx_count, 1, __ATOMIC_RELAXED );
+	}
+	rsr->rsr_count = 0;
+	removestarts( rx );
+	sizecache( rx );
+	flushcache( rx );
+
+	return ;
+}
+
+// The bytes are looked up in the cache until a state is not there; the hearer of each slot found in the bitset is added to the
+// bitmap, which has it once however many of its slots matched
+int matchregexes( struct regexes * restrict rx, const char * restrict text, size_t len, struct bitmap * restrict matched ){
+	const struct regexdstate *ds = NULL;
+	const struct regexsubscriber *rsr = NULL;
+	uint32_t state = 0;
+	uint32_t next;
+	uint32_t j;
+	uint32_t w;
+	size_t mark = 0;
+	size_t i;
+	int found = 0;
+	int thrashed;
+
+	assert( rx != NULL );
+	assert( text != NULL || len == 0 );
+	assert( matched != NULL );
+
+	if ( rx->rx_count == 0 ){
+		return ( 0 );
+	}
+
+	// While the cache is left alone after it thrashed, the twit is scanned on the NFAs from the start
+	if ( rx->rx_nfabytes > 0 ){
+		rx->rx_sets[ 0 ].rs_count = 0;
+		scannfa( rx, ( const unsigned char * )text, len );
+		rx->rx_nfabytes -= len < rx->rx_nfabytes ? len : rx->rx_nfabytes;
+		( void )__atomic_fetch_add( &rx->rx_thrashed, 1, __ATOMIC_RELAXED );
+		mark = i = len;
+	}
+	for ( i = mark; i < len; ++i ){
+		if ( ( next = REGEX_DSTATE( rx, state )->rd_next[ ( unsigned char )text[ i ] ] ) == REGEX_NOSTATE ){
+			rx->rx_sinceflush += i - mark;
+			mark = i;
+			thrashed = 0;
+			if ( ( next = makestate( rx, state, ( unsigned char )text[ i ], &thrashed ) ) == REGEX_NOSTATE || thrashed ){
+				hitset( rx, &rx->rx_sets[ 0 ] );
+				scannfa( rx, ( const unsigned char * )text + i + 1, len - i - 1 );
+				( void )__atomic_fetch_add( &rx->rx_thrashed, 1, __ATOMIC_RELAXED );
+				mark = i = len;
+				break;
+			}
+		}
+		state = next;
+		ds = REGEX_DSTATE( rx, state );
+		for ( j = 0; j < ds->rd_matchcount; ++j ){
+			rx->rx_hits[ ds->rd_ids[ ds->rd_setlen + j ] / 64 ] |= ( uint64_t )1 << ( ds->rd_ids[ ds->rd_setlen + j ] % 64 );
+		}
+	}
+	rx->rx_sinceflush += i - mark;
+
+	// The bitset is left empty for the next scan, even if the bitmap ran out of storage
+	for ( w = 0; w < ( rx->rx_top + 63 ) / 64; ++w ){
+		for ( ; rx->rx_hits[ w ] != 0; rx->rx_hits[ w ] &= rx->rx_hits[ w ] - 1 ){
+			if ( found == -1 ){
+				continue;
+			}
+			rsr = rx->rx_patterns[ w * 64 + ( uint32_t )__builtin_ctzll( rx->rx_hits[ w ] ) ].rp_subscriber;
+			found = addtobitmap( matched, rsr->rsr_tpln->tpln_hearer ) == -1 ? -1 : found + 1;
+		}
+	}
+
+	return ( found );
+}
+
+
+
+// Implementation of local functions...
+
+// Anything printable but the space; it needs no escaping in the request line
+static size_t patternlen( const char * restrict patterns ){
+	size_t len;
+
+	for ( len = 0; patterns[ len ] > ' ' && patterns[ len ] <= '~'; ++len ){
+		continue;
+	}
+
+	return ( len <= REGEX_MAXLEN ? len : 0 );
+}
+
+// Each character makes at most one state, and the match one more; the parentheses none
+static int compilepattern( const char * restrict pattern, size_t len, struct regexpattern * restrict rp, uint32_t ( *classes )[ 8 ] ){
+	struct regexparser pa;
+	struct regexfrag frag;
+	int match;
+
+	pa.rpa_at = pattern;
+	pa.rpa_end = pattern + len;
+	pa.rpa_nodes = rp->rp_nodes;
+	pa.rpa_count = 0;
+	pa.rpa_classes = classes;
+	pa.rpa_classcount = 0;
+	if ( parsealt( &pa, &frag ) == -1 || pa.rpa_at != pa.rpa_end || ( match = newnode( &pa, REGEX_MATCH, 0, REGEX_NONE, REGEX_NONE ) ) == -1 ){
+		return ( -1 );
+	}
+	patchouts( rp->rp_nodes, frag.rf_outs, ( uint8_t )match );
+	rp->rp_start = frag.rf_start;
+	if ( matchesempty( rp ) ){
+		return ( -1 );
+	}
+
+	return ( pa.rpa_classcount );
+}
+
+static int parsealt( struct regexparser * restrict pa, struct regexfrag * restrict frag ){
+	struct regexfrag right;
+	int split;
+
+	if ( parseconcat( pa, frag ) == -1 ){
+		return ( -1 );
+	}
+	while ( pa->rpa_at < pa->rpa_end && *pa->rpa_at == '|' ){
+		++pa->rpa_at;
+		if ( parseconcat( pa, &right ) == -1 || ( split = newnode( pa, REGEX_SPLIT, 0, frag->rf_start, right.rf_start ) ) == -1 ){
+			return ( -1 );
+		}
+		frag->rf_start = ( uint8_t )split;
+		frag->rf_outs = appendouts( pa->rpa_nodes, frag->rf_outs, right.rf_outs );
+	}
+
+	return ( 0 );
+}
+
+// An empty one is not taken, as in "a|" or "()"
+static int parseconcat( struct regexparser * restrict pa, struct regexfrag * restrict frag ){
+	struct regexfrag next;
+	int empty = 1;
+
+	while ( pa->rpa_at < pa->rpa_end && *pa->rpa_at != '|' && *pa->rpa_at != ')' ){
+		if ( parserepeat( pa, &next ) == -1 ){
+			return ( -1 );
+		}
+		if ( empty ){
+			*frag = next;
+			empty = 0;
+		}
+		else{
+			patchouts( pa->rpa_nodes, frag->rf_outs, next.rf_start );
+			frag->rf_outs = next.rf_outs;
+		}
+	}
+
+	return ( empty ? -1 : 0 );
+}
+
+// A split in front for '*' and '?', behind for '+', looping back to the atom for both but '?'
+static int parserepeat( struct regexparser * restrict pa, struct regexfrag * restrict frag ){
+	char c;
+	int split;
+
+	if ( parseatom( pa, frag ) == -1 ){
+		return ( -1 );
+	}
+	while ( pa->rpa_at < pa->rpa_end && ( *pa->rpa_at == '*' || *pa->rpa_at == '+' || *pa->rpa_at == '?' ) ){
+		c = *pa->rpa_at++;
+		if ( ( split = newnode( pa, REGEX_SPLIT, 0, frag->rf_start, REGEX_NONE ) ) == -1 ){
+			return ( -1 );
+		}
+		if ( c == '?' ){
+			frag->rf_outs = appendouts( pa->rpa_nodes, frag->rf_outs, REGEX_OUT1( split ) );
+			frag->rf_start = ( uint8_t )split;
+		}
+		else{
+			patchouts( pa->rpa_nodes, frag->rf_outs, ( uint8_t )split );
+			frag->rf_outs = REGEX_OUT1( split );
+			if ( c == '*' ){
+				frag->rf_start = ( uint8_t )split;
+			}
+		}
+	}
+
+	return ( 0 );
+}
+
+static int parseatom( struct regexparser * restrict pa, struct regexfrag * restrict frag ){
+	uint32_t bits[ 8 ];
+	char c;
+	int node;
+
+	if ( pa->rpa_at == pa->rpa_end ){
+		return ( -1 );
+	}
+	( void )memset( bits, 0, sizeof( bits ) );
+	c = *pa->rpa_at++;
+	if ( c == '(' ){
+		if ( parsealt( pa, frag ) == -1 || pa->rpa_at == pa->rpa_end || *pa->rpa_at++ != ')' ){
+			return ( -1 );
+		}
+		return ( 0 );
+	}
+	if ( c == ')' || c == '|' || c == '*' || c == '+' || c == '?' || c == '^' || c == '$' || c == '{' || c == '}' || c == ']' ){
+		return ( -1 );
+	}
+	if ( c == '.' ){
+		( void )memset( bits, 0xff, sizeof( bits ) );
+		node = newclass( pa, bits );
+	}
+	else if ( c == '[' ){
+		node = parseclass( pa, bits ) == -1 ? -1 : newclass( pa, bits );
+	}
+	else if ( c == '\\' ){
+		if ( pa->rpa_at == pa->rpa_end ){
+			return ( -1 );
+		}
+		c = *pa->rpa_at++;
+		if ( escapeclass( c, bits ) ){
+			node = newclass( pa, bits );
+		}
+		else if ( ( c >= '0' && c <= '9' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= 'a' && c <= 'z' ) ){
+			return ( -1 );
+		}
+		else{
+			node = newnode( pa, REGEX_BYTE, ( uint8_t )c, REGEX_NONE, REGEX_NONE );
+		}
+	}
+	else{
+		node = newnode( pa, REGEX_BYTE, ( uint8_t )c, REGEX_NONE, REGEX_NONE );
+	}
+	if ( node == -1 ){
+		return ( -1 );
+	}
+	frag->rf_start = ( uint8_t )node;
+	frag->rf_outs = REGEX_OUT( node );
+
+	return ( 0 );
+}
+
+// A ']' first is in the class, and a '-' first or last; an escape of a letter or a digit is one of the classes or not taken
+static int parseclass( struct regexparser * restrict pa, uint32_t bits[ 8 ] ){
+	unsigned char lo;
+	unsigned char hi;
+	unsigned b;
+	int negate = 0;
+	int first = 1;
+	int i;
+
+	if ( pa->rpa_at < pa->rpa_end && *pa->rpa_at == '^' ){
+		negate = 1;
+		++pa->rpa_at;
+	}
+	for ( ; ; first = 0 ){
+		if ( pa->rpa_at == pa->rpa_end ){
+			return ( -1 );
+		}
+		lo = ( unsigned char )*pa->rpa_at++;
+		if ( lo == ']' && !first ){
+			break;
+		}
+		if ( lo == '\\' ){
+			if ( pa->rpa_at == pa->rpa_end ){
+				return ( -1 );
+			}
+			if ( escapeclass( *pa->rpa_at, bits ) ){
+				++pa->rpa_at;
+				continue;
+			}
+			lo = ( unsigned char )*pa->rpa_at++;
+			if ( ( lo >= '0' && lo <= '9' ) || ( lo >= 'A' && lo <= 'Z' ) || ( lo >= 'a' && lo <= 'z' ) ){
+				return ( -1 );
+			}
+		}
+		hi = lo;
+		if ( pa->rpa_end - pa->rpa_at >= 2 && pa->rpa_at[ 0 ] == '-' && pa->rpa_at[ 1 ] != ']' ){
+			pa->rpa_at += 1;
+			hi = ( unsigned char )*pa->rpa_at++;
+			if ( hi == '\\' ){
+				if ( pa->rpa_at == pa->rpa_end ){
+					return ( -1 );
+				}
+				hi = ( unsigned char )*pa->rpa_at++;
+				if ( ( hi >= '0' && hi <= '9' ) || ( hi >= 'A' && hi <= 'Z' ) || ( hi >= 'a' && hi <= 'z' ) ){
+					return ( -1 );
+				}
+			}
+			if ( hi < lo ){
+				return ( -1 );
+			}
+		}
+		for ( b = lo; b <= hi; ++b ){
+			bits[ b / 32 ] |= ( uint32_t )1 << ( b % 32 );
+		}
+	}
+	for ( i = 0; i < 8; ++i ){
+		bits[ i ] = negate ? ~bits[ i ] : bits[ i ];
+	}
+	for ( i = 0; i < 8 && bits[ i ] == 0; ++i ){
+		continue;
+	}
+
+	return ( i < 8 ? 0 : -1 );
+}
+
+// The bytes of the C locale; the upper case letter for the bytes that are not in the class
+static int escapeclass( char c, uint32_t bits[ 8 ] ){
+	uint32_t class[ 8 ];
+	unsigned b;
+	int i;
+
+	( void )memset( class, 0, sizeof( class ) );
+	for ( b = 0; b < 256; ++b ){
+		if ( ( ( c == 'w' || c == 'W' ) && ( ( b >= '0' && b <= '9' ) || ( b >= 'A' && b <= 'Z' ) || ( b >= 'a' && b <= 'z' ) || b == '_' ) ) ||
+			( ( c == 'd' || c == 'D' ) && b >= '0' && b <= '9' ) ||
+			( ( c == 's' || c == 'S' ) && ( b == ' ' || ( b >= '\t' && b <= '\r' ) ) ) ){
+			class[ b / 32 ] |= ( uint32_t )1 << ( b % 32 );
+		}
+	}
+	if ( c != 'w' && c != 'W' && c != 'd' && c != 'D' && c != 's' && c != 'S' ){
+		return ( 0 );
+	}
+	for ( i = 0; i < 8; ++i ){
+		bits[ i ] |= c >= 'a' ? class[ i ] : ~class[ i ];
+	}
+
+	return ( 1 );
+}
+
+static int newnode( struct regexparser * restrict pa, enum regexop op, uint8_t arg, uint8_t out, uint8_t out1 ){
+	struct regexnode *node = NULL;
+
+	if ( pa->rpa_count == REGEX_MAXLEN + 1 ){
+		return ( -1 );
+	}
+	node = &pa->rpa_nodes[ pa->rpa_count ];
+	node->rn_op = ( uint8_t )op;
+	node->rn_arg = arg;
+	node->rn_out = out;
+	node->rn_out1 = out1;
+
+	return ( pa->rpa_count++ );
+}
+
+static int newclass( struct regexparser * restrict pa, const uint32_t bits[ 8 ] ){
+	if ( pa->rpa_classcount == REGEX_MAXLEN ){
+		return ( -1 );
+	}
+	( void )memcpy( pa->rpa_classes[ pa->rpa_classcount ], bits, sizeof( pa->rpa_classes[ 0 ] ) );
+
+	return ( newnode( pa, REGEX_CLASS, ( uint8_t )pa->rpa_classcount++, REGEX_NONE, REGEX_NONE ) );
+}
+
+// Each out left to patch holds the next one in the list
+static void patchouts( struct regexnode * restrict nodes, uint8_t outs, uint8_t target ){
+	uint8_t *out = NULL;
+	uint8_t next;
+
+	for ( ; outs != REGEX_NONE; outs = next ){
+		out = outs % 2 == 0 ? &nodes[ outs / 2 ].rn_out : &nodes[ outs / 2 ].rn_out1;
+		next = *out;
+		*out = target;
+	}
+
+	return ;
+}
+
+static uint8_t appendouts( struct regexnode * restrict nodes, uint8_t first, uint8_t second ){
+	uint8_t *out = NULL;
+	uint8_t outs;
+
+	if ( first == REGEX_NONE ){
+		return ( second );
+	}
+	for ( outs = first; ; outs = *out ){
+		out = outs % 2 == 0 ? &nodes[ outs / 2 ].rn_out : &nodes[ outs / 2 ].rn_out1;
+		if ( *out == REGEX_NONE ){
+			break;
+		}
+	}
+	*out = second;
+
+	return ( first );
+}
+
+static int matchesempty( const struct regexpattern * restrict rp ){
+	uint8_t seen[ REGEX_MAXLEN + 1 ];
+	uint8_t stack[ 2 * ( REGEX_MAXLEN + 1 ) + 1 ];
+	const struct regexnode *node = NULL;
+	int top = 0;
+	uint8_t n;
+
+	( void )memset( seen, 0, sizeof( seen ) );
+	stack[ top++ ] = rp->rp_start;
+	while ( top > 0 ){
+		n = stack[ --top ];
+		if ( seen[ n ] ){
+			continue;
+		}
+		seen[ n ] = 1;
+		node = &rp->rp_nodes[ n ];
+		if ( node->rn_op == REGEX_MATCH ){
+			return ( 1 );
+		}
+		if ( node->rn_op == REGEX_SPLIT ){
+			stack[ top++ ] = node->rn_out1;
+			stack[ top++ ] = node->rn_out;
+		}
+	}
+
+	return ( 0 );
+}
+
+// Every array sized by the slots is grown before any is used with more; one that could not be grown leaves the others larger
+static uint32_t newslot( struct regexes * restrict rx ){
+	struct regexpattern *patterns = NULL;
+	uint32_t *array = NULL;
+	uint64_t *hits = NULL;
+	size_t ids;
+	uint32_t slot;
+	int i;
+
+	if ( rx->rx_free != REGEX_NOSTATE ){
+		slot = rx->rx_free;
+		rx->rx_free = rx->rx_patterns[ slot ].rp_nextfree;
+		return ( slot );
+	}
+	if ( rx->rx_top == rx->rx_capacity ){
+		if ( rx->rx_capacity > ( REGEX_NOSTATE >> ( REGEX_NODE_SHIFT + 2 ) ) ){
+			return ( REGEX_NOSTATE );
+		}
+		ids = ( size_t )rx->rx_capacity << ( REGEX_NODE_SHIFT + 1 );
+		if ( ( patterns = realloc( rx->rx_patterns, 2 * rx->rx_capacity * sizeof( *patterns ) ) ) == NULL ){
+			return ( REGEX_NOSTATE );
+		}
+		rx->rx_patterns = patterns;
+		for ( i = 0; i < 2; ++i ){
+			if ( ( array = realloc( rx->rx_sets[ i ].rs_dense, ids * sizeof( *array ) ) ) == NULL ){
+				return ( REGEX_NOSTATE );
+			}
+			rx->rx_sets[ i ].rs_dense = array;
+			if ( ( array = realloc( rx->rx_sets[ i ].rs_sparse, ids * sizeof( *array ) ) ) == NULL ){
+				return ( REGEX_NOSTATE );
+			}
+			( void )memset( array + ids / 2, 0, ids / 2 * sizeof( *array ) );
+			rx->rx_sets[ i ].rs_sparse = array;
+		}
+		if ( ( array = realloc( rx->rx_stack, ( 2 * ids + 1 ) * sizeof( *array ) ) ) == NULL ){
+			return ( REGEX_NOSTATE );
+		}
+		rx->rx_stack = array;
+		if ( ( array = realloc( rx->rx_key, ids * sizeof( *array ) ) ) == NULL ){
+			return ( REGEX_NOSTATE );
+		}
+		rx->rx_key = array;
+		if ( ( hits = realloc( rx->rx_hits, 2 * rx->rx_capacity / 64 * sizeof( *hits ) ) ) == NULL ){
+			return ( REGEX_NOSTATE );
+		}
+		( void )memset( hits + rx->rx_capacity / 64, 0, rx->rx_capacity / 64 * sizeof( *hits ) );
+		rx->rx_hits = hits;
+		rx->rx_capacity *= 2;
+	}
+
+	return ( rx->rx_top++ );
+}
+
+// The states the start goes to on no byte, then those they go to on each byte
+static int addstarts( struct regexes * restrict rx, uint32_t slot ){
+	const struct regexpattern *rp = &rx->rx_patterns[ slot ];
+	const struct regexnode *node = NULL;
+	struct regexstarts *rst = NULL;
+	uint32_t *states = NULL;
+	uint8_t seen[ REGEX_MAXLEN + 1 ];
+	uint8_t stack[ 2 * ( REGEX_MAXLEN + 1 ) + 1 ];
+	int top = 0;
+	unsigned b;
+	uint8_t n;
+
+	( void )memset( seen, 0, sizeof( seen ) );
+	stack[ top++ ] = rp->rp_start;
+	while ( top > 0 ){
+		n = stack[ --top ];
+		if ( seen[ n ] ){
+			continue;
+		}
+		seen[ n ] = 1;
+		node = &rp->rp_nodes[ n ];
+		if ( node->rn_op == REGEX_SPLIT ){
+			stack[ top++ ] = node->rn_out1;
+			stack[ top++ ] = node->rn_out;
+			continue;
+		}
+		for ( b = 0; b < 256 && node->rn_op != REGEX_MATCH; ++b ){
+			if ( node->rn_op == REGEX_BYTE ? node->rn_arg != b : !( ( rp->rp_classes[ node->rn_arg ][ b / 32 ] >> ( b % 32 ) ) & 1 ) ){
+				continue;
+			}
+			rst = &rx->rx_starts[ b ];
+			if ( rst->rst_count == rst->rst_capacity ){
+				if ( ( states = realloc( rst->rst_states, ( rst->rst_capacity * 2 + 8 ) * sizeof( *states ) ) ) == NULL ){
+					return ( -1 );
+				}
+				rst->rst_states = states;
+				rst->rst_capacity = rst->rst_capacity * 2 + 8;
+			}
+			rst->rst_states[ rst->rst_count++ ] = ( slot << REGEX_NODE_SHIFT ) | node->rn_out;
+		}
+	}
+
+	return ( 0 );
+}
+
+static void removestarts( struct regexes * restrict rx ){
+	struct regexstarts *rst = NULL;
+	uint32_t i;
+	uint32_t j;
+	unsigned b;
+
+	for ( b = 0; b < 256; ++b ){
+		rst = &rx->rx_starts[ b ];
+		for ( i = j = 0; i < rst->rst_count; ++i ){
+			if ( rx->rx_patterns[ rst->rst_states[ i ] >> REGEX_NODE_SHIFT ].rp_subscriber != NULL ){
+				rst->rst_states[ j++ ] = rst->rst_states[ i ];
+			}
+		}
+		rst->rst_count = j;
+	}
+
+	return ;
+}
+
+static void addclosure( struct regexes * restrict rx, struct regexset * restrict set, uint32_t id ){
+	const struct regexnode *node = NULL;
+	uint32_t top = 0;
+
+	rx->rx_stack[ top++ ] = id;
+	while ( top > 0 ){
+		id = rx->rx_stack[ --top ];
+		if ( set->rs_sparse[ id ] < set->rs_count && set->rs_dense[ set->rs_sparse[ id ] ] == id ){
+			continue;
+		}
+		set->rs_sparse[ id ] = set->rs_count;
+		set->rs_dense[ set->rs_count++ ] = id;
+		node = &rx->rx_patterns[ id >> REGEX_NODE_SHIFT ].rp_nodes[ id & ( ( 1u << REGEX_NODE_SHIFT ) - 1 ) ];
+		if ( node->rn_op == REGEX_SPLIT ){
+			rx->rx_stack[ top++ ] = REGEX_STATE( id, node->rn_out1 );
+			rx->rx_stack[ top++ ] = REGEX_STATE( id, node->rn_out );
+		}
+	}
+
+	return ;
+}
+
+static void stepset( struct regexes * restrict rx, const uint32_t * restrict ids, uint32_t count, unsigned char byte,
+	struct regexset * restrict to ){
+	const struct regexpattern *rp = NULL;
+	const struct regexnode *node = NULL;
+	const struct regexstarts *rst = &rx->rx_starts[ byte ];
+	uint32_t i;
+
+	for ( i = 0; i < count; ++i ){
+		rp = &rx->rx_patterns[ ids[ i ] >> REGEX_NODE_SHIFT ];
+		node = &rp->rp_nodes[ ids[ i ] & ( ( 1u << REGEX_NODE_SHIFT ) - 1 ) ];
+		if ( ( node->rn_op == REGEX_BYTE && node->rn_arg == byte ) ||
+			( node->rn_op == REGEX_CLASS && ( ( rp->rp_classes[ node->rn_arg ][ byte / 32 ] >> ( byte % 32 ) ) & 1 ) ) ){
+			addclosure( rx, to, REGEX_STATE( ids[ i ], node->rn_out ) );
+		}
+	}
+	for ( i = 0; i < rst->rst_count; ++i ){
+		addclosure( rx, to, rst->rst_states[ i ] );
+	}
+
+	return ;
+}
+
+// The states of the NFAs that only go to others on no byte are left out, and the rest sorted, so a set has one key
+static uint32_t makestate( struct regexes * restrict rx, uint32_t from, unsigned char byte, int * restrict thrashed ){
+	struct regexset *set = &rx->rx_sets[ 0 ];
+	const struct regexdstate *ds = REGEX_DSTATE( rx, from );
+	const struct regexnode *node = NULL;
+	uint32_t count = 0;
+	uint32_t hash = 2166136261u;
+	uint32_t state;
+	uint32_t i;
+
+	set->rs_count = 0;
+	stepset( rx, ds->rd_ids, ds->rd_setlen, byte, set );
+	for ( i = 0; i < set->rs_count; ++i ){
+		node = &rx->rx_patterns[ set->rs_dense[ i ] >> REGEX_NODE_SHIFT ].rp_nodes[ set->rs_dense[ i ] & ( ( 1u << REGEX_NODE_SHIFT ) - 1 ) ];
+		if ( node->rn_op != REGEX_SPLIT ){
+			rx->rx_key[ count++ ] = set->rs_dense[ i ];
+		}
+	}
+	qsort( rx->rx_key, count, sizeof( *rx->rx_key ), &compareids );
+	for ( i = 0; i < count; ++i ){
+		hash = ( hash ^ rx->rx_key[ i ] ) * 16777619u;
+	}
+
+	for ( state = rx->rx_buckets[ hash & rx->rx_bucketmask ]; state != REGEX_NOSTATE; state = ds->rd_chain ){
+		ds = REGEX_DSTATE( rx, state );
+		if ( ds->rd_hash == hash && ds->rd_setlen == count && memcmp( ds->rd_ids, rx->rx_key, count * sizeof( *rx->rx_key ) ) == 0 ){
+			REGEX_DSTATE( rx, from )->rd_next[ byte ] = state;
+			return ( state );
+		}
+	}
+	// The slots that matched are at most as many as the states of the NFAs
+	if ( rx->rx_cachesize - rx->rx_cacheused < REGEX_DSTATE_WORDS + 2 * ( size_t )count ){
+		// The twits after it are scanned without the cache for as many bytes as it should have lasted
+		if ( rx->rx_sinceflush < ( size_t )REGEX_THRASH_BYTES * rx->rx_dcount ){
+			*thrashed = 1;
+			rx->rx_nfabytes = ( size_t )REGEX_THRASH_BYTES * rx->rx_dcount;
+		}
+		( void )__atomic_fetch_add( &rx->rx_flushes, 1, __ATOMIC_RELAXED );
+		flushcache( rx );
+		if ( rx->rx_cachesize - rx->rx_cacheused < REGEX_DSTATE_WORDS + 2 * ( size_t )count ){
+			return ( REGEX_NOSTATE );
+		}
+		return ( addstate( rx, count, hash ) );
+	}
+	state = addstate( rx, count, hash );
+	REGEX_DSTATE( rx, from )->rd_next[ byte ] = state;
+
+	return ( state );
+}
+
+// The size goes up from the least in steps of twice as much, so hearers coming and going resize it seldom
+static void sizecache( struct regexes * restrict rx ){
+	uint32_t *cache = NULL;
+	uint32_t *buckets = NULL;
+	uint32_t nbuckets;
+	size_t size = rx->rx_mincachesize;
+
+	while ( size < rx->rx_count * rx->rx_regexbytes && 2 * size <= REGEX_CACHE_MAXSIZE ){
+		size *= 2;
+	}
+	if ( size / sizeof( uint32_t ) == rx->rx_cachesize ){
+		return ;
+	}
+	// As many buckets as states with no states of the NFAs would fit
+	for ( nbuckets = 1; nbuckets < size / sizeof( struct regexdstate ); nbuckets *= 2 ){
+		continue;
+	}
+	if ( ( cache = realloc( rx->rx_cache, size ) ) == NULL ){
+		return ;
+	}
+	rx->rx_cache = cache;
+	rx->rx_cachesize = ( uint32_t )( size / sizeof( uint32_t ) );
+	// Fewer buckets than that only make the chains longer
+	if ( ( buckets = realloc( rx->rx_buckets, nbuckets * sizeof( *rx->rx_buckets ) ) ) != NULL ){
+		rx->rx_buckets = buckets;
+		rx->rx_bucketmask = nbuckets - 1;
+	}
+
+	return ;
+}
+
+static void flushcache( struct regexes * restrict rx ){
+	( void )memset( rx->rx_buckets, 0xff, ( rx->rx_bucketmask + 1 ) * sizeof( *rx->rx_buckets ) );
+	rx->rx_dcount = 0;
+	rx->rx_cacheused = 0;
+	rx->rx_sinceflush = 0;
+	( void )addstate( rx, 0, 2166136261u );
+
+	return ;
+}
+
+static uint32_t addstate( struct regexes * restrict rx, uint32_t count, uint32_t hash ){
+	struct regexdstate *ds = REGEX_DSTATE( rx, rx->rx_cacheused );
+	const struct regexnode *node = NULL;
+	uint32_t state = rx->rx_cacheused;
+	uint32_t i;
+
+	( void )memset( ds->rd_next, 0xff, sizeof( ds->rd_next ) );
+	ds->rd_setlen = count;
+	( void )memcpy( ds->rd_ids, rx->rx_key, count * sizeof( *rx->rx_key ) );
+	ds->rd_matchcount = 0;
+	for ( i = 0; i < count; ++i ){
+		node = &rx->rx_patterns[ rx->rx_key[ i ] >> REGEX_NODE_SHIFT ].rp_nodes[ rx->rx_key[ i ] & ( ( 1u << REGEX_NODE_SHIFT ) - 1 ) ];
+		if ( node->rn_op == REGEX_MATCH ){
+			ds->rd_ids[ count + ds->rd_matchcount++ ] = rx->rx_key[ i ] >> REGEX_NODE_SHIFT;
+		}
+	}
+	ds->rd_hash = hash;
+	ds->rd_chain = rx->rx_buckets[ hash & rx->rx_bucketmask ];
+	rx->rx_buckets[ hash & rx->rx_bucketmask ] = state;
+	rx->rx_cacheused += ( uint32_t )REGEX_DSTATE_WORDS + count + ds->rd_matchcount;
+	__atomic_store_n( &rx->rx_dstatecount, ++rx->rx_dcount, __ATOMIC_RELAXED );
+
+	return ( state );
+}
+
+// The two sets take turns
+static void scannfa( struct regexes * restrict rx, const unsigned char * restrict text, size_t len ){
+	struct regexset *from = &rx->rx_sets[ 0 ];
+	struct regexset *to = &rx->rx_sets[ 1 ];
+	struct regexset *swap = NULL;
+	size_t i;
+
+	for ( i = 0; i < len; ++i ){
+		to->rs_count = 0;
+		stepset( rx, from->rs_dense, from->rs_count, text[ i ], to );
+		hitset( rx, to );
+		swap = from;
+		from = to;
+		to = swap;
+	}
+
+	return ;
+}
+
+static void hitset( struct regexes * restrict rx, const struct regexset * restrict set ){
+	const struct regexnode *node = NULL;
+	uint32_t slot;
+	uint32_t i;
+
+	for ( i = 0; i < set->rs_count; ++i ){
+		slot = set->rs_dense[ i ] >> REGEX_NODE_SHIFT;
+		node = &rx->rx_patterns[ slot ].rp_nodes[ set->rs_dense[ i ] & ( ( 1u << REGEX_NODE_SHIFT ) - 1 ) ];
+		if ( node->rn_op == REGEX_MATCH ){
+			rx->rx_hits[ slot / 64 ] |= ( uint64_t )1 << ( slot % 64 );
+		}
+	}
+
+	return ;
+}
+
+static int compareids( const void *a, const void *b ){
+	uint32_t x = *( const uint32_t * )a;
+	uint32_t y = *( const uint32_t * )b;
+
+	return ( x < y ? -1 : x > y );
+}
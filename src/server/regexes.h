@@ -0,0 +1,249 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file regexes.h
+ *
+ * File regexes.h declares the regular expressions the hearers subscribe to (see topicframe.h). Each one is compiled to a Thompson
+ * NFA of its own, in a slot; the NFAs of all the hearers are run together as one, by a lazy DFA whose states, the sets of the states
+ * of the NFAs the scan can be in, are made the first time a twit leads to them and cached, so the twitpool consumer scans each twit
+ * once with a lookup a byte for as long as the states it needs are in the cache.
+ *
+ * The expressions match anywhere in the twit, so at every byte the scan may start each of them again; rather than keep the states
+ * where they start in every set, a table for each byte lists the states the NFAs go to from their start on it, and each step adds
+ * those of its byte. A DFA state also has the slots whose expression matched as the scan got there; as it goes, the scan sets their
+ * bits in a bitset of the slots, from which the numbers of the twitpools of their hearers are added to a bitmap (see bitmap.h).
+ *
+ * The states are kept in a cache of at least cachesize bytes and regexbytes for each regular expression subscribed to, up to
+ * REGEX_CACHE_MAXSIZE, each with its transitions and its states of the NFAs, so a state of many of them takes more room. The cache is
+ * resized, in steps of twice its size, only as a hearer subscribes or goes, when it is flushed anyway. When it is full the cache is
+ * flushed and the scan goes on from the state it is in, made again. If the cache is flushed before the scan went through ten bytes
+ * for each state of it, it thrashes: the twit is finished on the NFAs themselves, without caching anything, and so are the twits
+ * after it until as many bytes were scanned; then the cache is tried again. A hearer that subscribes or goes flushes the cache, since
+ * the states are sets of the states of the NFAs it changes. The regular expressions are guarded by si_regexes_lock; the scan changes
+ * the cache, so it runs with the lock held too.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( REGEXES_H_IS_INCLUDED )
+#define REGEXES_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "twitpoollist.h"
+#include "bitmap.h"
+#include "config.h"
+
+// The states of the NFA of the slot s are numbered from s << REGEX_NODE_SHIFT; an expression has at most REGEX_MAXLEN + 1 of them
+#define REGEX_NODE_SHIFT (7)
+
+/**
+ * \enum regexop
+ *
+ * What a state of an NFA does.
+ */
+enum regexop{
+	REGEX_BYTE, /**< Goes to rn_out on the byte rn_arg */
+	REGEX_CLASS, /**< Goes to rn_out on a byte of the class rn_arg */
+	REGEX_SPLIT, /**< Goes to both rn_out and rn_out1 on no byte */
+	REGEX_MATCH /**< The expression matched */
+};
+
+/**
+ * \struct regexnode
+ *
+ * The regexnode structure is a state of an NFA; the states it goes to are numbered within the NFA.
+ */
+struct regexnode{
+	uint8_t rn_op; /**< One of enum regexop */
+	uint8_t rn_arg;
+	uint8_t rn_out;
+	uint8_t rn_out1;
+};
+
+/**
+ * \struct regexpattern
+ *
+ * The regexpattern structure is a slot, with the NFA of a regular expression. A slot that is free is linked in the free list through
+ * rp_nextfree.
+ */
+struct regexpattern{
+	struct regexnode rp_nodes[ REGEX_MAXLEN + 1 ];
+	uint32_t ( *rp_classes )[ 8 ]; /**< The bytes of each class, a bit each; NULL if there are no classes */
+	uint8_t rp_start;
+	struct regexsubscriber *rp_subscriber; /**< The hearer of the expression; NULL if the slot is free */
+	uint32_t rp_nextfree;
+};
+
+/**
+ * \struct regexsubscriber
+ *
+ * The regexsubscriber structure holds the slots of the regular expressions of a hearer.
+ */
+struct regexsubscriber{
+	struct twitpoollist_node *rsr_tpln;
+	int rsr_count; /**< Number of slots; zero if the hearer has no regular expressions */
+	uint32_t rsr_slots[ HEARER_REGEXES_MAXCOUNT ];
+};
+
+/**
+ * \struct regexset
+ *
+ * The regexset structure is a set of states of the NFAs, with the states in rs_dense and the place of each in rs_sparse, so it
+ * is emptied at once.
+ */
+struct regexset{
+	uint32_t *rs_dense;
+	uint32_t *rs_sparse;
+	uint32_t rs_count;
+};
+
+/**
+ * \struct regexstarts
+ *
+ * The regexstarts structure lists the states the NFAs go to from their start on a byte.
+ */
+struct regexstarts{
+	uint32_t *rst_states;
+	uint32_t rst_count;
+	uint32_t rst_capacity;
+};
+
+/**
+ * \struct regexdstate
+ *
+ * The regexdstate structure is a state of the lazy DFA, in the cache. A state is known by where it is in the cache, in words.
+ */
+struct regexdstate{
+	uint32_t rd_next[ 256 ]; /**< The state each byte leads to; UINT32_MAX if it was not made yet */
+	uint32_t rd_setlen;
+	uint32_t rd_matchcount;
+	uint32_t rd_hash;
+	uint32_t rd_chain; /**< The next state in the same bucket; UINT32_MAX if there is none */
+	uint32_t rd_ids[]; /**< Its states of the NFAs in order, rd_setlen of them, then the slots that matched */
+};
+
+/**
+ * \struct regexes
+ *
+ * The regexes structure holds the slots and the cache of the lazy DFA. The counts are updated atomically, so the statistics read
+ * them without the lock.
+ */
+struct regexes{
+	struct regexpattern *rx_patterns;
+	uint32_t rx_capacity; /**< Slots in rx_patterns, a multiple of 64 */
+	uint32_t rx_top; /**< Slots ever used; those after it have never been */
+	uint32_t rx_free; /**< The first free slot below rx_top; UINT32_MAX if there is none */
+	struct regexstarts rx_starts[ 256 ];
+	struct regexset rx_sets[ 2 ]; /**< For making a state and for the scan without the cache; rx_capacity << REGEX_NODE_SHIFT each */
+	uint32_t *rx_stack; /**< For following the states an NFA goes to on no byte */
+	uint32_t *rx_key; /**< The states of the NFAs of a state being made */
+	uint64_t *rx_hits; /**< The slots that matched the twit scanned, a bit each */
+	uint32_t *rx_cache; /**< The states one after the other; the first one is the one the scan starts from */
+	uint32_t rx_cachesize; /**< In words */
+	size_t rx_mincachesize; /**< The least bytes of the cache */
+	size_t rx_regexbytes; /**< Bytes of the cache for each regular expression subscribed to */
+	uint32_t rx_cacheused;
+	uint32_t rx_dcount;
+	uint32_t *rx_buckets; /**< The first state of each bucket of the hash table of the states */
+	uint32_t rx_bucketmask; /**< Buckets minus one, a power of two */
+	size_t rx_sinceflush; /**< Bytes scanned with the cache since it was last flushed */
+	size_t rx_nfabytes; /**< Bytes left to scan without the cache since it thrashed */
+	size_t rx_count; /**< Regular expressions subscribed to */
+	size_t rx_dstatecount; /**< States in the cache */
+	uint64_t rx_flushes; /**< Number of times the cache was flushed */
+	uint64_t rx_thrashed; /**< Number of twits finished without the cache */
+};
+
+
+
+/**
+ * The initregexes() function shall initialize the regular expressions pointed to by parameter rx with none, and with a cache of
+ * about cachesize bytes, grown to regexbytes for each regular expression subscribed to, up to REGEX_CACHE_MAXSIZE; a regexbytes of
+ * zero keeps it at cachesize.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate
+ *	the error.
+ * @exception EINVAL The cache would not have room for a few states.
+ * @exception ENOMEM There is not enough memory.
+ */
+int initregexes( struct regexes * restrict rx, size_t cachesize, size_t regexbytes );
+
+/**
+ * The delregexes() function shall free the memory of the regular expressions pointed to by parameter rx.
+ *
+ * @return Nothing.
+ */
+void delregexes( struct regexes * restrict rx );
+
+/**
+ * The validregexes() function shall check that the string pointed to by parameter patterns is what follows "REGEXES " in the request
+ * line of topicframe.h: one to HEARER_REGEXES_MAXCOUNT regular expressions separated by single spaces.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+int validregexes( const char * restrict patterns );
+
+/**
+ * The subscriberegexes() function shall subscribe the twitpool pointed to by parameter tpln to the regular expressions in the
+ * string pointed to by parameter patterns, as validregexes() checks it, through the structure pointed to by parameter rsr, a slot
+ * each, and flush the cache, resized for the regular expressions subscribed to.
+ *
+ * @return Upon successful completion the number of slots shall be returned; otherwise, -1 shall be returned, nothing shall be
+ *	subscribed to and errno shall be set to indicate the error.
+ * @exception EINVAL The regular expressions are not valid.
+ * @exception ENOMEM There is not enough memory for the slots.
+ */
+int subscriberegexes( struct regexes * restrict rx, struct regexsubscriber * restrict rsr, struct twitpoollist_node * restrict tpln,
+	const char * restrict patterns );
+
+/**
+ * The unsubscriberegexes() function shall free the slots in the structure pointed to by parameter rsr, as subscriberegexes() took
+ * them, and flush the cache, resized for the regular expressions left, if there were any. The structure is left with none.
+ *
+ * @return Nothing.
+ */
+void unsubscriberegexes( struct regexes * restrict rx, struct regexsubscriber * restrict rsr );
+
+/**
+ * The matchregexes() function shall scan the len bytes pointed to by parameter text and add to the bitmap pointed to by parameter
+ * matched the numbers of the twitpools of the hearers with a regular expression that matches them.
+ *
+ * @return Upon successful completion the number of regular expressions that match shall be returned; otherwise, -1 shall be
+ *	returned and errno shall be set to indicate the error.
+ * @exception ENOMEM Insufficient storage space for the bitmap.
+ */
+int matchregexes( struct regexes * restrict rx, const char * restrict text, size_t len, struct bitmap * restrict matched );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
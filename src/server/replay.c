@@ -0,0 +1,291 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file replay.c
+ *
+ * File replay.c contains the implementation of the replay.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "serverinfo.h"
+#include "history.h"
+#include "cursors.h"
+#include "twitlog.h"
+#include "resumeframe.h"
+#include "config.h"
+#include "replay.h"
+#include "util.h"
+
+// The frames are the records of the twit log
+#if RESUMEFRAME_HEADER_SIZE != TWITLOG_RECORD_HEADER_SIZE
+#error "The frames of resumeframe.h must be the records of twitlog.h"
+#endif
+
+/**
+ * The readrequest() function shall read the request line of resumeframe.h from the hearer at the specified sockfd, waiting up to
+ * HEARER_WAIT_NSEC seconds, and store in the objects pointed to by parameters istime and value whether it asks by time and the number.
+ * The name of the cursor the hearer asks for is stored in the array of CURSOR_NAME_MAXLEN + 1 characters pointed to by parameter
+ * name; it is left empty if the hearer asks by sequence number or time.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EPROTO The request line is not one of resumeframe.h.
+ */
+static int readrequest( int sockfd, int * restrict istime, uint64_t * restrict value, char * restrict name );
+
+/**
+ * The snapshothistory() function shall copy to the array of HISTORY_SIZE entries pointed to by parameter entries, oldest first,
+ * the twits of the recent history of the server pointed to by parameter si with sequence numbers from fromseq up to boundary.
+ *
+ * @return The number of entries copied.
+ */
+static size_t snapshothistory( struct serverinfo * restrict si, uint64_t fromseq, uint64_t boundary, struct historyentry * restrict entries );
+
+
+
+/**
+ * The twits are taken in two parts, older ones first:
+ *	1) Those of the twit log before the first one the recent history has, once the writer has written them. They are sent
+ *	from the segments with sendtwitlog(), and again from where that left off as long as the recent history has moved past
+ *	it meanwhile, so a hearer far behind catches up with the disk before it is sent anything from memory.
+ *	2) Those of a snapshot of the recent history up to csi_boundary; the twitpool has the ones after it.
+ * A hearer asking by time starts from the first twit logged at or after it, found in the snapshot when the snapshot reaches
+ * that far back and in the twit log otherwise. A hearer asking by cursor starts after the twit its cursor has, which follows it
+ * from then on; a new cursor starts at csi_boundary.
+ */
+int replaytohearer( struct connserverinfo * restrict csi ){
+	struct serverinfo *si;
+	struct historyentry *entries = NULL;
+	struct twitlogrecord r;
+	uint64_t next;
+	uint64_t limit;
+	uint64_t value;
+	uint64_t seq;
+	uint64_t sent;
+	size_t count;
+	size_t first = 0;
+	size_t i;
+	char name[ CURSOR_NAME_MAXLEN + 1 ];
+	int istime;
+	int status = -1;
+
+	assert( csi != NULL );
+
+	si = csi->csi_serverinfo;
+	if ( readrequest( csi->csi_sockfd, &istime, &value, name ) == -1 ){
+		return ( -1 );
+	}
+	if ( name[ 0 ] != '\0' && ( csi->csi_cursor = takecursor( &si->si_cursors, name, csi->csi_boundary, &value ) ) == -1 ){
+		return ( -1 );
+	}
+	if ( ( entries = malloc( HISTORY_SIZE * sizeof( *entries ) ) ) == NULL ){
+		errno = ENOMEM;
+		return ( -1 );
+	}
+
+	do{
+		// The twits after the boundary come through the twitpool
+		next = istime ? 0 : ( value == UINT64_MAX ? value : value + 1 );
+		if ( istime ){
+			value *= 1000000u;
+			count = snapshothistory( si, 0, csi->csi_boundary, entries );
+			while ( first < count && entries[ first ].he_time < value ){
+				++first;
+			}
+			if ( first > 0 ){
+				next = first < count ? entries[ first ].he_seq : csi->csi_boundary + 1;
+			}
+			else{
+				// The snapshot does not reach that far back
+				if ( seektwitlog( TWITLOG_DIR, value, &seq ) == -1 ){
+					break;
+				}
+				next = seq ? seq : ( count > 0 ? entries[ 0 ].he_seq : csi->csi_boundary + 1 );
+			}
+		}
+
+		// The older twits from the twit log, until the recent history reaches back to the next one
+		while ( 1 ){
+			count = snapshothistory( si, next, csi->csi_boundary, entries );
+			limit = count > 0 ? entries[ 0 ].he_seq : csi->csi_boundary + 1;
+			if ( next >= limit ){
+				break;
+			}
+			// A server that terminates does not send the rest (see stophearers())
+			if ( __atomic_load_n( &si->si_stopping, __ATOMIC_RELAXED ) ){
+				break;
+			}
+			// Every twit before the limit was handed to the writer, or left out of the log, before the last one handed to it
+			if ( ( seq = appendedtwitlogseq( si->si_twitlog ) ) > 0 ){
+				( void )waittwitlog( si->si_twitlog, seq );
+			}
+			sent = 0;
+			status = sendtwitlog( TWITLOG_DIR, next, limit, csi->csi_sockfd, &sent );
+			( void )__atomic_fetch_add( &si->si_replayed_disk, sent, __ATOMIC_RELAXED );
+			if ( status == -1 ){
+				break;
+			}
+			// Every twit before the limit the twit log has was sent
+			if ( csi->csi_cursor != -1 ){
+				advancecursor( &si->si_cursors, csi->csi_cursor, limit - 1 );
+			}
+			next = limit;
+		}
+		if ( next < limit ){
+			break;
+		}
+		status = -1;
+
+		// Then those of the snapshot
+		for ( i = 0; i < count; ++i ){
+			r.tlr_len = ( uint16_t )entries[ i ].he_twitlen;
+			r.tlr_flags = ( uint16_t )entries[ i ].he_flags;
+			r.tlr_seq = entries[ i ].he_seq;
+			r.tlr_time = entries[ i ].he_time;
+			if ( sendtwitframe( csi->csi_sockfd, &r, entries[ i ].he_twit ) == -1 ){
+				break;
+			}
+			if ( csi->csi_cursor != -1 ){
+				advancecursor( &si->si_cursors, csi->csi_cursor, r.tlr_seq );
+			}
+		}
+		( void )__atomic_fetch_add( &si->si_replayed_memory, i, __ATOMIC_RELAXED );
+		if ( i == count ){
+			status = 0;
+		}
+	}while ( 0 );
+	free( entries );
+
+	return ( status );
+}
+
+// The record and the twit go in one send()
+int sendtwitframe( int sockfd, const struct twitlogrecord * restrict r, const char * restrict twit ){
+	unsigned char frame[ TWITLOG_RECORD_MAXSIZE ];
+	size_t len;
+
+	assert( r != NULL );
+	assert( twit != NULL );
+
+	len = encodetwitlogrecord( frame, r, twit );
+
+	return ( writeall( sockfd, frame, len ) == -1 ? -1 : 0 );
+}
+
+
+
+// Implementation of local functions...
+
+// One byte at a time so nothing after the newline is taken; the hearer sends nothing else anyway
+static int readrequest( int sockfd, int * restrict istime, uint64_t * restrict value, char * restrict name ){
+	char line[ RESUMEFRAME_REQUEST_MAXLEN + 1 ];
+	struct timeval timeout;
+	const char *number;
+	char *end = NULL;
+	size_t len = 0;
+	ssize_t nread;
+
+	assert( istime != NULL );
+	assert( value != NULL );
+	assert( name != NULL );
+
+	name[ 0 ] = '\0';
+	// As with the timeout for writing, a failure is ignored
+	( void )memset( &timeout, 0, sizeof( timeout ) );
+	timeout.tv_sec = ( time_t )HEARER_WAIT_NSEC;
+	timeout.tv_usec = ( suseconds_t )0;
+	( void )setsockopt( sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+
+	do{
+		if ( len == RESUMEFRAME_REQUEST_MAXLEN ){
+			errno = EPROTO;
+			return ( -1 );
+		}
+		errno = 0;
+		if ( ( nread = recv( sockfd, line + len, 1, 0 ) ) == -1 ){
+			if ( errno == EINTR ){
+				continue;
+			}
+			return ( -1 );
+		}
+		else if ( nread == 0 ){
+			errno = EPROTO;
+			return ( -1 );
+		}
+	}while ( line[ len++ ] != '\n' );
+	line[ len - 1 ] = '\0';
+
+	if ( strncmp( line, "SEQ ", 4 ) == 0 ){
+		*istime = 0;
+		number = line + 4;
+	}
+	else if ( strncmp( line, "TIME ", 5 ) == 0 ){
+		*istime = 1;
+		number = line + 5;
+	}
+	else if ( strncmp( line, "CURSOR ", 7 ) == 0 && validcursorname( line + 7 ) ){
+		// The cursor gives the sequence number
+		*istime = 0;
+		*value = 0;
+		( void )strcpy( name, line + 7 );
+		return ( 0 );
+	}
+	else{
+		errno = EPROTO;
+		return ( -1 );
+	}
+	errno = 0;
+	*value = strtoull( number, &end, 10 );
+	if ( errno || end == number || *end != '\0' ){
+		errno = EPROTO;
+		return ( -1 );
+	}
+	// A time that does not fit in nanoseconds is in the future anyway
+	if ( *istime && *value > UINT64_MAX / 1000000u ){
+		*value = UINT64_MAX / 1000000u;
+	}
+
+	return ( 0 );
+}
+
+static size_t snapshothistory( struct serverinfo * restrict si, uint64_t fromseq, uint64_t boundary, struct historyentry * restrict entries ){
+	size_t count;
+
+	count = copyfromhistory( &si->si_history, fromseq, entries, HISTORY_SIZE );
+	while ( count > 0 && entries[ count - 1 ].he_seq > boundary ){
+		--count;
+	}
+
+	return ( count );
+}
@@ -0,0 +1,77 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file replay.h
+ *
+ * File replay.h declares how a hearer that came to RESUMING_HEARERS_PORT is sent the twits it missed before the new ones, with
+ * the frames of resumeframe.h.
+ *
+ * The hearersListener() notes in csi_boundary the last twit put in the twitpools when it created the twitpool of the hearer;
+ * every later twit reaches the twitpool. replaytohearer() sends the twits the hearer asked for up to that one: the older ones
+ * straight from the segments of the twit log with sendfile(), after waiting for the writer to write them, until the hearer has
+ * caught up with the recent history, and then those still in it. The frames are the records of the twit log, so the hearer gets
+ * each twit once, in order and in the same form, whichever way it came.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( REPLAY_H_IS_INCLUDED )
+#define REPLAY_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "serverinfo.h"
+#include "twitlog.h"
+
+/**
+ * The replaytohearer() function shall read the request line of resumeframe.h from the hearer of the connection pointed to by
+ * parameter csi and send it the twits it asked for with sequence numbers up to csi_boundary.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate
+ * 	the error, meaning that the connection must be closed.
+ * @exception EPROTO The request line is not one of resumeframe.h.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * Any error of recv(), send() or sendtwitlog().
+ */
+int replaytohearer( struct connserverinfo * restrict csi );
+
+/**
+ * The sendtwitframe() function shall send to the hearer at the specified sockfd the frame of resumeframe.h of the twit pointed
+ * to by parameter twit, which is the twit log record pointed to by parameter r with that twit.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ */
+int sendtwitframe( int sockfd, const struct twitlogrecord * restrict r, const char * restrict twit );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
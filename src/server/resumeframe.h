@@ -0,0 +1,71 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file resumeframe.h
+ *
+ * File resumeframe.h defines what a hearer connected to RESUMING_HEARERS_PORT and the server send each other. The hearer first
+ * sends one request line, at most RESUMEFRAME_REQUEST_MAXLEN bytes with the newline:
+ *	"SEQ n\n" for the twits after the one with sequence number n, the last the hearer got (zero for all of them)
+ *	"TIME ms\n" for the twits logged at or after ms milliseconds since the Epoch
+ *	"CURSOR name\n" for the twits after the last one sent to a hearer that resumed with the same name, even before the server was
+ *	restarted; the new twits only if there is no such cursor yet. The name is 1 to 32 letters, digits, '.', '_' or '-'
+ * The server then sends the twits it still has, from the recent history or from the twit log, followed without a gap by the
+ * new twits as they come. Each twit is sent as the record of the twit log it has, or would have had, on the disk (see twitlog.h),
+ * so the old twits are sent straight from the segments. A record is a header of RESUMEFRAME_HEADER_SIZE bytes followed by the twit:
+ *	offset 0: CRC-32C of bytes 4 up to the end of the twit (uint32_t)
+ *	offset RESUMEFRAME_LEN_OFFSET: length of the twit (uint16_t)
+ *	offset 6: flags (uint16_t)
+ *	offset RESUMEFRAME_SEQ_OFFSET: sequence number of the twit, which the hearer sends back in "SEQ" when it reconnects (uint64_t)
+ *	offset RESUMEFRAME_TIME_OFFSET: time the twit was logged, in nanoseconds since the Epoch (uint64_t)
+ * Numbers are little-endian. Sequence numbers only grow but may skip twits that were never logged.
+ *
+ * This header is shared with the clients so it only holds macros.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( RESUMEFRAME_H_IS_INCLUDED )
+#define RESUMEFRAME_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#define RESUMEFRAME_REQUEST_MAXLEN (64)
+
+#define RESUMEFRAME_HEADER_SIZE (24)
+
+#define RESUMEFRAME_LEN_OFFSET (4)
+
+#define RESUMEFRAME_SEQ_OFFSET (8)
+
+#define RESUMEFRAME_TIME_OFFSET (16)
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
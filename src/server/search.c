@@ -0,0 +1,493 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file search.c
+ *
+ * File search.c contains the implementation of the search.h interface.
+ *
+ * The searches are answered one at a time by the thread that accepts them, as the metrics are. The index gives the sequence numbers
+ * of the twits found; the twits are then taken from the recent history, or read from the twit log for those older than it, so the
+ * index keeps no copy of them. The socket timeouts (SEARCH_WAIT_NSEC) stop a slow client from holding the thread for long.
+ *
+ * @author Tassos Souris
+ */
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include "serverinfo.h"
+#include "statistics.h"
+#include "fulltext.h"
+#include "history.h"
+#include "twitlog.h"
+#include "listen.h"
+#include "search.h"
+#include "searchframe.h"
+#include "config.h"
+#include "util.h"
+#include "error.h"
+
+// The twit log is read on from a twit found there to the next one while it is at most SEARCH_DISK_GAP twits further; past that it is
+// looked up again through the index of its segment
+#define SEARCH_DISK_GAP (64)
+
+/**
+ * \struct searchinfo
+ *
+ * The searchinfo structure keeps the resources of the searchListener thread so as they can be released by the cleanup handler.
+ */
+struct searchinfo{
+	struct serverinfo *si_serverinfo;
+	int si_sockfd;
+	int si_connsockfd;
+};
+
+/**
+ * \struct searchanswer
+ *
+ * The searchanswer structure holds the twits found by a search, by their sequence numbers in increasing order, as they are gathered.
+ */
+struct searchanswer{
+	uint64_t sa_seqs[ SEARCH_RESULTS_MAXCOUNT ];
+	struct historyentry sa_entries[ SEARCH_RESULTS_MAXCOUNT ];
+	int sa_found[ SEARCH_RESULTS_MAXCOUNT ];
+	size_t sa_count;
+	size_t sa_next; /**< The twit read from the twit log next */
+};
+
+/**
+ * \struct searchfill
+ *
+ * The searchfill structure is what addRecordToFulltext() is passed by readtwitlog().
+ */
+struct searchfill{
+	struct fulltext *sf_fulltext;
+	uint64_t sf_toseq; /**< The first twit not added */
+};
+
+
+
+/**
+ * The setupSearchListener() shall perform all the necessary actions for the preparation of the searchListener thread.
+ * The setupSearchListener() function shall receive as argument a pointer to a struct searchinfo object.
+ *
+ * @return Nothing.
+ */
+static void setupSearchListener( void *arg );
+
+/**
+ * The cleanupSearchListener() function is responsible for cleaning up the resources associated with the searchListener thread.
+ * The cleanupSearchListener() function shall receive as argument a pointer to a struct searchinfo object.
+ *
+ * @return Nothing.
+ */
+static void cleanupSearchListener( void *arg );
+
+/**
+ * The fillfulltext() function shall add to the full-text index of the server described by parameter si the twits of the twit log
+ * before si_fulltext_fromseq, as many as it keeps.
+ *
+ * @return Nothing; should the twit log not be read, only the twits indexed when the server started are found.
+ */
+static void fillfulltext( struct serverinfo * restrict si );
+
+/**
+ * The addRecordToFulltext() function shall add the twit pointed to by parameter twit, whose record in the twit log has the header
+ * pointed to by parameter r, to the struct fulltext object of the struct searchfill object pointed to by parameter arg, unless it is
+ * not before sf_toseq. It is called by readtwitlog().
+ *
+ * @return Nonzero once the twits before sf_toseq are all added, zero otherwise.
+ */
+static int addRecordToFulltext( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg );
+
+/**
+ * The servesearch() function shall read the request of the client connected at the socket given as parameter, search the full-text
+ * index of the server described by parameter si and send the twits found, with the struct searchanswer object pointed to by
+ * parameter sa.
+ *
+ * @return The servesearch() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int servesearch( struct serverinfo * restrict si, struct searchanswer * restrict sa, int sockfd );
+
+/**
+ * The readsearch() function shall read the request line of searchframe.h from the socket given as parameter into the buffer pointed
+ * to by parameter line, of SEARCHFRAME_REQUEST_MAXLEN + 1 bytes, and store in the objects pointed to by parameters op and max what
+ * it asks for, and in the object pointed to by parameter words a pointer to its words, in line.
+ *
+ * @return The readsearch() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int readsearch( int sockfd, char * restrict line, enum fulltextop * restrict op, size_t * restrict max, const char ** restrict words );
+
+/**
+ * The findtwits() function shall find the twits of the struct searchanswer object pointed to by parameter sa in the recent history of
+ * the server described by parameter si, and then in the twit log.
+ *
+ * @return The number of twits found in the twit log; the twits not found are left out.
+ */
+static size_t findtwits( struct serverinfo * restrict si, struct searchanswer * restrict sa );
+
+/**
+ * The addRecordToAnswer() function shall keep the twit pointed to by parameter twit, whose record in the twit log has the header
+ * pointed to by parameter r, in the struct searchanswer object pointed to by parameter arg if it is the one read next. It is called
+ * by readtwitlog().
+ *
+ * @return Nonzero once the next twit is too far ahead, zero otherwise.
+ */
+static int addRecordToAnswer( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg );
+
+
+
+/**
+ * searchListener() runs on its own thread and is responsible for answering the searches.
+ * The port to which the searchListener() function will listen is obtained from config.h (SEARCH_PORT).
+ * The steps the searchListener() function takes are:
+ *	1) The socket that will listen at the port SEARCH_PORT is created.
+ *	2) If successfull (the above step) the searchListener() function notifies through the serverinfo structure
+ *	passed as parameter that is prepared.
+ *	3) The twits of the twit log before those indexed are added to the full-text index.
+ *	4) It waits for a connection and when one arrives it answers the search and closes the connection.
+ */
+void *searchListener( void *arg ){
+	struct serverinfo *si = ( struct serverinfo * )arg;
+	struct searchinfo sei = {
+		.si_serverinfo = si,
+		.si_sockfd = -1,
+		.si_connsockfd = -1
+	};
+	struct searchanswer sa;
+
+	assert( si != NULL );
+
+	// POSIX says that pthread_cleanup_push() and pthread_cleanup_pop() must appear as statements
+	// and in pairs within the same lexical scope so pthread_cleanup_push() must be put here
+ 	// and not in setupSearchListener()
+	pthread_cleanup_push( &cleanupSearchListener, &sei );
+	setupSearchListener( &sei );
+	fillfulltext( si );
+
+	// Wait for connections
+	while ( 1 ){
+		errno = 0;
+		if ( ( sei.si_connsockfd = accept( sei.si_sockfd, NULL, NULL ) ) == -1 ){
+			error( "accept() failed in searchListener() (%s)\n", strerror( errno ) );
+			continue;
+		}
+		( void )servesearch( si, &sa, sei.si_connsockfd );
+		( void )safe_close( sei.si_connsockfd );
+		sei.si_connsockfd = -1;
+	}
+
+	// Perform cleanup
+	pthread_cleanup_pop( 1 );
+
+	// Not Reached
+	pthread_exit( NULL );
+}
+
+
+
+// Implementation of local functions...
+
+// Setup the search listener
+static void setupSearchListener( void *arg ){
+	struct searchinfo *sei = ( struct searchinfo * )arg;
+
+	assert( sei != NULL );
+
+	// Prepare the socket to listen for the clients of the search
+	errno = 0;
+	if ( ( sei->si_sockfd = listenerSocket( sei->si_serverinfo, LISTEN_SEARCH ) ) == -1 ){
+		error( "failed to prepare the socket for searches in searchListener() (%s)\n", strerror( errno ) );
+		// Could not prepare so now inform about the status and terminate
+		signal_prepared_status( sei->si_serverinfo, 0 );
+		pthread_exit( NULL );
+	}
+	// The preparation is successful
+	signal_prepared_status( sei->si_serverinfo, 1 );
+
+	return ;
+}
+
+// Cleanup the search listener
+static void cleanupSearchListener( void *arg ){
+	struct searchinfo *sei = ( struct searchinfo * )arg;
+
+	assert( sei != NULL );
+
+	// Cleanup code
+	if ( sei->si_connsockfd != -1 ){
+		( void )safe_close( sei->si_connsockfd );
+	}
+	if ( sei->si_sockfd != -1 ){
+		( void )safe_close( sei->si_sockfd );
+	}
+
+	return ;
+}
+
+// The twits are indexed apart, while the consumer goes on adding the new ones, and their segments are then put before the others in
+// one go. Reading the log is not cancelled halfway, so its segments are never left mapped; it takes a second or so at most
+static void fillfulltext( struct serverinfo * restrict si ){
+	struct fulltext older;
+	struct searchfill sf;
+	uint64_t span = ( uint64_t )SEARCH_SEGMENTS_MAXCOUNT * SEARCH_SEGMENT_TWITS;
+	uint64_t fromseq;
+	int state;
+
+	assert( si != NULL );
+
+	sf.sf_fulltext = &older;
+	sf.sf_toseq = si->si_fulltext_fromseq;
+	if ( sf.sf_toseq <= 1 || initfulltext( &older ) == -1 ){
+		return ;
+	}
+	fromseq = sf.sf_toseq > span ? sf.sf_toseq - span : 1;
+	( void )pthread_setcancelstate( PTHREAD_CANCEL_DISABLE, &state );
+	if ( readtwitlog( TWITLOG_DIR, fromseq, &addRecordToFulltext, &sf ) == -1 ){
+		error( "Failed to index the words of the twits in the twit log in %s (%s).\n", TWITLOG_DIR, strerror( errno ) );
+	}
+	mergefulltext( &si->si_fulltext, &older );
+	delfulltext( &older );
+	( void )pthread_setcancelstate( state, NULL );
+
+	return ;
+}
+
+// The twits of the recent history follow; they were indexed when the server started
+static int addRecordToFulltext( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg ){
+	struct searchfill *sf = ( struct searchfill * )arg;
+
+	assert( r != NULL );
+	assert( twit != NULL );
+	assert( sf != NULL );
+
+	if ( r->tlr_seq >= sf->sf_toseq ){
+		return ( 1 );
+	}
+	( void )addtofulltext( sf->sf_fulltext, r->tlr_seq, twit, r->tlr_len );
+
+	return ( 0 );
+}
+
+// The twits go out newest first in one write; a request the server does not take gets the connection closed
+static int servesearch( struct serverinfo * restrict si, struct searchanswer * restrict sa, int sockfd ){
+	unsigned char records[ SEARCH_RESULTS_MAXCOUNT * TWITLOG_RECORD_MAXSIZE ];
+	char line[ SEARCHFRAME_REQUEST_MAXLEN + 1 ];
+	uint64_t found[ SEARCH_RESULTS_MAXCOUNT ];
+	const char *words = NULL;
+	struct twitlogrecord r;
+	struct timeval timeout;
+	enum fulltextop op;
+	size_t max;
+	size_t len = 0;
+	size_t sent = 0;
+	size_t disk;
+	size_t i;
+	ssize_t count;
+
+	assert( si != NULL );
+	assert( sa != NULL );
+
+	// Do not let a slow client hold the thread
+	( void )memset( &timeout, 0, sizeof( timeout ) );
+	timeout.tv_sec = ( time_t )SEARCH_WAIT_NSEC;
+	timeout.tv_usec = ( suseconds_t )0;
+	( void )setsockopt( sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+	( void )setsockopt( sockfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+
+	if ( readsearch( sockfd, line, &op, &max, &words ) == -1 ||
+		( count = searchfulltext( &si->si_fulltext, op, words, found, max ) ) == -1 ){
+		return ( -1 );
+	}
+
+	// Newest first from the index, oldest first for the history and the twit log
+	sa->sa_count = ( size_t )count;
+	for ( i = 0; i < sa->sa_count; ++i ){
+		sa->sa_seqs[ i ] = found[ sa->sa_count - 1 - i ];
+	}
+	disk = findtwits( si, sa );
+	for ( i = sa->sa_count; i > 0; --i ){
+		if ( sa->sa_found[ i - 1 ] ){
+			r.tlr_len = ( uint16_t )sa->sa_entries[ i - 1 ].he_twitlen;
+			r.tlr_flags = ( uint16_t )sa->sa_entries[ i - 1 ].he_flags;
+			r.tlr_seq = sa->sa_entries[ i - 1 ].he_seq;
+			r.tlr_time = sa->sa_entries[ i - 1 ].he_time;
+			len += encodetwitlogrecord( records + len, &r, sa->sa_entries[ i - 1 ].he_twit );
+			++sent;
+		}
+	}
+	( void )__atomic_fetch_add( &si->si_searches, 1, __ATOMIC_RELAXED );
+	// Those from the disk are counted after all of them, so they are never more
+	( void )__atomic_fetch_add( &si->si_searchtwits, sent, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &si->si_searchdisk, disk, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &si->si_searchmissing, sa->sa_count - sent, __ATOMIC_RELAXED );
+	if ( len > 0 && writeall( sockfd, records, len ) == -1 ){
+		return ( -1 );
+	}
+	( void )shutdown( sockfd, SHUT_WR );
+
+	return ( 0 );
+}
+
+// One byte at a time so nothing after the newline is taken, as with the hearers that resume
+static int readsearch( int sockfd, char * restrict line, enum fulltextop * restrict op, size_t * restrict max, const char ** restrict words ){
+	const char *number = NULL;
+	char *end = NULL;
+	unsigned long value;
+	size_t len = 0;
+	ssize_t nread;
+
+	do{
+		if ( len == SEARCHFRAME_REQUEST_MAXLEN ){
+			errno = EPROTO;
+			return ( -1 );
+		}
+		errno = 0;
+		if ( ( nread = recv( sockfd, line + len, 1, 0 ) ) == -1 ){
+			if ( errno == EINTR ){
+				continue;
+			}
+			return ( -1 );
+		}
+		else if ( nread == 0 ){
+			errno = EPROTO;
+			return ( -1 );
+		}
+	}while ( line[ len++ ] != '\n' );
+	line[ len - 1 ] = '\0';
+
+	if ( strncmp( line, SEARCHFRAME_AND, sizeof( SEARCHFRAME_AND ) - 1 ) == 0 ){
+		*op = FULLTEXT_AND;
+		number = line + sizeof( SEARCHFRAME_AND ) - 1;
+	}
+	else if ( strncmp( line, SEARCHFRAME_OR, sizeof( SEARCHFRAME_OR ) - 1 ) == 0 ){
+		*op = FULLTEXT_OR;
+		number = line + sizeof( SEARCHFRAME_OR ) - 1;
+	}
+	else{
+		errno = EPROTO;
+		return ( -1 );
+	}
+	errno = 0;
+	value = strtoul( number, &end, 10 );
+	if ( errno || end == number || *end != ' ' || value == 0 || value > SEARCH_RESULTS_MAXCOUNT ){
+		errno = EPROTO;
+		return ( -1 );
+	}
+	*max = ( size_t )value;
+	*words = end + 1;
+
+	return ( 0 );
+}
+
+// The recent history has the newest twits, so those not in it are the oldest ones; they are read from the twit log in one pass, but
+// for long gaps between them
+static size_t findtwits( struct serverinfo * restrict si, struct searchanswer * restrict sa ){
+	struct historyentry *entries = sa->sa_entries;
+	size_t found;
+	size_t disk;
+	size_t next;
+	size_t i;
+	size_t j;
+
+	assert( si != NULL );
+	assert( sa != NULL );
+
+	// The entries of the history are put at the place of their sequence numbers, from the last, which is never before its own
+	found = findinhistory( &si->si_history, sa->sa_seqs, sa->sa_count, entries );
+	for ( i = sa->sa_count, j = found; i > 0; --i ){
+		if ( j > 0 && entries[ j - 1 ].he_seq == sa->sa_seqs[ i - 1 ] ){
+			if ( j != i ){
+				entries[ i - 1 ] = entries[ j - 1 ];
+			}
+			sa->sa_found[ i - 1 ] = 1;
+			--j;
+		}
+		else{
+			sa->sa_found[ i - 1 ] = 0;
+		}
+	}
+	if ( found == sa->sa_count ){
+		return ( 0 );
+	}
+
+	for ( sa->sa_next = 0; sa->sa_next < sa->sa_count; ){
+		if ( sa->sa_found[ sa->sa_next ] ){
+			++sa->sa_next;
+			continue;
+		}
+		next = sa->sa_next;
+		if ( readtwitlog( TWITLOG_DIR, sa->sa_seqs[ next ], &addRecordToAnswer, sa ) == -1 || sa->sa_next == next ){
+			// Not there any more
+			++sa->sa_next;
+		}
+	}
+	for ( disk = 0, i = 0; i < sa->sa_count; ++i ){
+		disk += ( size_t )sa->sa_found[ i ];
+	}
+
+	return ( disk - found );
+}
+
+// The twits asked for that are passed were not logged or are gone with their segment
+static int addRecordToAnswer( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg ){
+	struct searchanswer *sa = ( struct searchanswer * )arg;
+	struct historyentry *he = NULL;
+
+	assert( r != NULL );
+	assert( twit != NULL );
+	assert( sa != NULL );
+
+	while ( sa->sa_next < sa->sa_count && ( sa->sa_found[ sa->sa_next ] || sa->sa_seqs[ sa->sa_next ] < r->tlr_seq ) ){
+		++sa->sa_next;
+	}
+	if ( sa->sa_next == sa->sa_count ){
+		return ( 1 );
+	}
+	if ( sa->sa_seqs[ sa->sa_next ] == r->tlr_seq && r->tlr_len <= TWIT_MAXLEN ){
+		he = &sa->sa_entries[ sa->sa_next ];
+		he->he_seq = r->tlr_seq;
+		he->he_time = r->tlr_time;
+		he->he_flags = r->tlr_flags;
+		he->he_twitlen = r->tlr_len;
+		( void )memcpy( he->he_twit, twit, r->tlr_len );
+		sa->sa_found[ sa->sa_next++ ] = 1;
+		while ( sa->sa_next < sa->sa_count && sa->sa_found[ sa->sa_next ] ){
+			++sa->sa_next;
+		}
+		if ( sa->sa_next == sa->sa_count ){
+			return ( 1 );
+		}
+	}
+
+	return ( sa->sa_seqs[ sa->sa_next ] - r->tlr_seq > SEARCH_DISK_GAP );
+}
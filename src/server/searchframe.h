@@ -0,0 +1,61 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file searchframe.h
+ *
+ * File searchframe.h defines what a client connected to SEARCH_PORT and the server send each other. The client sends one request
+ * line, at most SEARCHFRAME_REQUEST_MAXLEN bytes with the newline:
+ *	"AND n word ...\n" for the last n twits with all of up to 8 words, separated by single spaces
+ *	"OR n word ...\n" for the last n twits with any of them
+ * n from 1 to 100. A word is 1 to 32 letters, digits or bytes above 127, the case of the ASCII letters aside, and is found in a twit
+ * where it stands between other characters or its ends, so "rain" is in "#rain, again" but not in "raining". The server sends the
+ * twits found, newest first, each as the record of the twit log described in resumeframe.h, and closes the connection; it closes it
+ * at once for a request it does not take. The twits searched are the most recent ones the server indexed (see fulltext.h), from the
+ * recent history or from the twit log, so a twit found may be missing from the answer if its segment of the twit log was removed.
+ *
+ * This header is shared with the clients so it only holds macros.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( SEARCHFRAME_H_IS_INCLUDED )
+#define SEARCHFRAME_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#define SEARCHFRAME_REQUEST_MAXLEN (288)
+
+#define SEARCHFRAME_AND "AND "
+
+#define SEARCHFRAME_OR "OR "
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file seqlock.c
+ *
+ * File seqlock.c contains the implementation of the seqlock.h interface.
+ *
+ * The ordering is done with the atomic builtins of gcc. The data itself is copied with plain memcpy(); a reader that
+ * overlaps with the writer may see a torn copy but it will notice from the sequence and throw it away.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include <sched.h>
+#include "seqlock.h"
+
+
+
+// Make the sequence odd, copy, make it even again
+void seqlock_write( volatile unsigned * restrict seq, void * restrict dst, const void * restrict src, size_t size ){
+	unsigned s;
+
+	assert( seq != NULL );
+	assert( dst != NULL );
+	assert( src != NULL );
+
+	s = __atomic_load_n( seq, __ATOMIC_RELAXED );
+	assert( ( s & 1 ) == 0 );
+	__atomic_store_n( seq, s + 1, __ATOMIC_RELAXED );
+	// The odd sequence must be visible before any byte of the data changes
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+	( void )memcpy( dst, src, size );
+	__atomic_store_n( seq, s + 2, __ATOMIC_RELEASE );
+
+	return ;
+}
+
+// Copy until the sequence is even and did not change while copying
+unsigned seqlock_read( const volatile unsigned * restrict seq, void * restrict dst, const void * restrict src, size_t size ){
+	unsigned before;
+	unsigned after;
+
+	assert( seq != NULL );
+	assert( dst != NULL );
+	assert( src != NULL );
+
+	while ( 1 ){
+		before = __atomic_load_n( seq, __ATOMIC_ACQUIRE );
+		if ( before & 1 ){
+			// The writer is in the middle of an update. It is short so let it finish
+			( void )sched_yield();
+			continue;
+		}
+		( void )memcpy( dst, ( const void * )src, size );
+		// The copy must complete before the sequence is read again
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+		after = __atomic_load_n( seq, __ATOMIC_RELAXED );
+		if ( before == after ){
+			break;
+		}
+	}
+
+	return ( before );
+}
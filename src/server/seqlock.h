@@ -0,0 +1,70 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file seqlock.h
+ *
+ * File seqlock.h declares the functions of a sequence lock (seqlock).
+ *
+ * A seqlock protects data that is written by a single writer and read by any number of readers, without the readers
+ * ever blocking the writer. The writer makes the sequence odd before it changes the data and even again when done.
+ * A reader copies the data and retries if the sequence was odd or changed while copying. Readers need no write access
+ * to the sequence so it can also live in memory shared read-only with other processes.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( SEQLOCK_H_IS_INCLUDED )
+#define SEQLOCK_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+
+/**
+ * The seqlock_write() function shall copy size bytes from the object pointed to by parameter src to the object pointed to by
+ * parameter dst, which is protected by the sequence pointed to by parameter seq. Only one thread shall write at a time.
+ * No parameter shall be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void seqlock_write( volatile unsigned * restrict seq, void * restrict dst, const void * restrict src, size_t size );
+
+/**
+ * The seqlock_read() function shall copy size bytes from the object pointed to by parameter src, which is protected by
+ * the sequence pointed to by parameter seq, to the object pointed to by parameter dst. The copy is retried until it
+ * does not overlap with a write. No parameter shall be a NULL pointer.
+ *
+ * @return The value of the sequence the copy corresponds to.
+ */
+unsigned seqlock_read( const volatile unsigned * restrict seq, void * restrict dst, const void * restrict src, size_t size );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -31,18 +31,30 @@
  *
  * @author Tassos Souris
  */
+#include <unistd.h>
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
 #include "serverinfo.h"
 #include "listen.h"
 #include "init.h"
 #include "sighandling.h"
 #include "statistics.h"
+#include "statspage.h"
+#include "histogram.h"
+#include "lockstats.h"
+#include "trace.h"
+#include "twitlog.h"
+#include "fulltext.h"
+#include "trending.h"
+#include "timing.h"
 #include "twitpool.h"
+#include "snapshot.h"
+#include "handoff.h"
 #include "config.h"
 #include "util.h"
 #include "error.h"
@@ -53,12 +65,17 @@
  * The server is divided into several subsystems where each subsystem consists of one or more threads.
  *
  * The threads that exist in the server are:
- *	1) A thread responsible for accepting connections from hearers
+ *	1) A thread responsible for accepting connections from hearers, at HEARERS_PORT, RESUMING_HEARERS_PORT and TOPIC_HEARERS_PORT
  *	2) A thread responsible for accepting connections from sayers
  *	3) A thread responsible for handling signals
  *	4) A thread responsible for updating the statistics every N seconds
  *	5) One thread for each sayer and hearer connected to the server
- *	6) A thread that retrieves the twits that are stored "globally" and sends them to each of the hearers
+ *	6) A thread that retrieves the twits that are stored "globally" and sends them to the hearers of their topics (see topics.h)
+ *	7) A thread that serves the metrics to clients such as Prometheus at METRICS_PORT
+ *	8) A thread that answers the searches of the twits by their words at SEARCH_PORT (see searchframe.h)
+ *	9) A thread that answers what is trending, the tags and the words seen most often of late, at TRENDS_PORT (see trendsframe.h)
+ *	10) A thread that listens for a server started with -r to take over, which it hands the listening sockets and the hearers
+ *	(see handoff.h)
  *
  * + The thread that is responsible for handling signals will inform the other threads that they must terminate normally
  * if requested so in the arrival of a SIGQUIT signal and after the user has confirmed termination of the server.
@@ -96,6 +113,94 @@ static void cleanup_server( struct serverinfo * restrict si );
  */
 static void print_statistics( const struct statistics * restrict stats );
 
+/**
+ * The print_ratewindow() function shall print to stdout the rates kept in the struct ratewindow object pointed to by parameter rw
+ * prefixed by the name pointed to by parameter name.
+ *
+ * @return Nothing.
+ */
+static void print_ratewindow( const char * restrict name, const struct ratewindow * restrict rw );
+
+/**
+ * The print_hearerlag() function shall print to stdout the lag of the HEARERS_SLOWEST_SHOWN hearers furthest behind, as kept in
+ * the statistics structure pointed to by parameter stats.
+ *
+ * @return Nothing.
+ */
+static void print_hearerlag( const struct statistics * restrict stats );
+
+/**
+ * The print_latencies() function shall print to stdout the percentiles of the latency of each stage, as recorded in the
+ * array of LATENCY_STAGES histograms pointed to by parameter latency.
+ *
+ * @return Nothing.
+ */
+static void print_latencies( const struct histogram * restrict latency );
+
+/**
+ * The print_twitlog() function shall print to stdout the counters of the twit log of the server described by parameter si and
+ * of the twits replayed from it and from the recent history.
+ *
+ * @return Nothing.
+ */
+static void print_twitlog( struct serverinfo * restrict si );
+
+/**
+ * The print_topics() function shall print to stdout the counters of the topics of the server described by parameter si.
+ *
+ * @return Nothing.
+ */
+static void print_topics( struct serverinfo * restrict si );
+
+/**
+ * The print_search() function shall print to stdout the counters of the full-text index and of the searches of the server described
+ * by parameter si.
+ *
+ * @return Nothing.
+ */
+static void print_search( struct serverinfo * restrict si );
+
+/**
+ * The print_trends() function shall print to stdout the counters of the tags and the words counted for what is trending in the
+ * server described by parameter si, with the ones trending most.
+ *
+ * @return Nothing.
+ */
+static void print_trends( struct serverinfo * restrict si );
+
+/**
+ * The print_recovery() function shall print to stdout what was found in the twit log when it was opened and what was taken from
+ * the snapshot, as stored in the serverinfo structure pointed to by parameter si.
+ *
+ * @return Nothing.
+ */
+static void print_recovery( const struct serverinfo * restrict si );
+
+/**
+ * The print_handoff() function shall print to stdout how the server described by parameter si was handed over, or took over from
+ * another if parameter tookover is nonzero.
+ *
+ * @return Nothing.
+ */
+static void print_handoff( const struct serverinfo * restrict si, int tookover );
+
+/**
+ * The usage() function shall display to stderr information about the usage of the program and exit with exit status EXIT_FAILURE.
+ *
+ * @return Nothing.
+ */
+static void usage( const char * restrict programname );
+
+#if defined( LOCK_STATS )
+/**
+ * The print_lockstats() function shall print to stdout the statistics of each lock. They are only kept if the server is compiled
+ * with LOCK_STATS defined.
+ *
+ * @return Nothing.
+ */
+static void print_lockstats( void );
+#endif
+
 /**
  * The discardline() function shall consume bytes from fp until EOF or the newline character is encountered.
  *
@@ -115,14 +220,31 @@ static void discardline( FILE *fp );
  *	3) The thread responsible for updating the statistics every N seconds
  * For each of the above threads it waits for their preparation status.
  *
- * The main thread also is responsible for handling some signals. On the arrival of a SIGQUIT signal it prints the statistics
+ * The main thread also is responsible for handling some signals. On the arrival of a SIGQUIT signal it prints the statistics,
+ * on the arrival of a SIGUSR2 signal it writes the events traced by the threads to a file (see trace.h)
  * and when it gets interrupted with Control-C (SIGINT) it asks user if it wants the server to terminate and continues
- * appropriately. The last approach is also applied to other signals.
+ * appropriately. The last approach is also applied to other signals. SIGUSR1 comes once the server is handed over to one
+ * started with -r in its place, and it terminates then.
  */
 int main( int argc, char *argv[] ){	
 	struct serverinfo si;
+	struct statistics stats;
+	char tracepath[ 256 ];
 	sigset_t sigset;
 	int signum;
+	int restart = 0; // Whether -r was given
+	int opt;
+
+	// -r takes over from the server running
+	while ( ( opt = getopt( argc, argv, "r" ) ) != -1 ){
+		if ( opt != 'r' ){
+			usage( argv[ 0 ] );
+		}
+		restart = 1;
+	}
+	if ( optind != argc ){
+		usage( argv[ 0 ] );
+	}
 	
 	// Set up signal handling
 	setup_signals( &sigset );
@@ -131,11 +253,15 @@ int main( int argc, char *argv[] ){
 	block_signals();
 
 	// Setup the threads
-	if ( initializeServer( &si ) == -1 ){
+	if ( initializeServer( &si, restart ) == -1 ){
 		error( "Server failed to be initialized.\nExiting now...\n" );
 		exit( EXIT_FAILURE );
 	}
 	printf( "Server got initialized successfully.\n" );
+	if ( restart ){
+		print_handoff( &si, 1 );
+	}
+	print_recovery( &si );
 	fflush( stdout );
 
 	// Unblock the signals
@@ -149,12 +275,35 @@ int main( int argc, char *argv[] ){
 		fflush( stdout );
 		switch ( signum ){
 		case SIGQUIT:
-			acquire_statistics( &si );
-			acquire_twitpool( &si );
-			si.si_stats.stats_storedTwitsNum = twitpoolcount( &si.si_twitpool );
-			release_twitpool( &si );
-			print_statistics( &si.si_stats );
-			release_statistics( &si );
+			// Print the statistics last published; that needs no locking and the threads moving the twits are not disturbed
+			snapshot_statistics( &si, &stats );
+			print_statistics( &stats );
+			// The histograms need no locking either
+			print_latencies( si.si_latency );
+			print_topics( &si );
+			print_search( &si );
+			print_trends( &si );
+			print_twitlog( &si );
+#if defined( LOCK_STATS )
+			print_lockstats();
+#endif
+			break;
+		case SIGUSR2:
+			if ( flushtrace( tracepath, sizeof( tracepath ) ) == -1 ){
+				error( "Failed to write the traced events to %s: %s\n", tracepath, strerror( errno ) );
+			}
+			else{
+				printf( "The traced events were written to %s\n", tracepath );
+				fflush( stdout );
+			}
+			break;
+		case SIGUSR1:
+			// Sent by the thread that handed the server over; the twit log is closed before the other server is told
+			if ( __atomic_load_n( &si.si_handoff.ho_state, __ATOMIC_RELAXED ) == HANDOFF_DONE ){
+				print_handoff( &si, 0 );
+				cleanup_server( &si );
+				exit( EXIT_SUCCESS );
+			}
 			break;
 		case SIGKILL:
 			// Fall through
@@ -175,7 +324,7 @@ int main( int argc, char *argv[] ){
 
 
 
-// Print the statistics to stdout. This function assumes that the structure is locked.
+// Print the statistics to stdout. The structure must not change while printed.
 static void print_statistics( const struct statistics * restrict stats ){
 	
 	assert( stats != NULL );
@@ -186,25 +335,381 @@ static void print_statistics( const struct statistics * restrict stats ){
 		"Hear connections = %d\n"
 		"Say connections = %d\n"
 		"Twits currently stored = %d\n"
-		"Total twits arrived = %d\n"
-		"Total twits delivered = %d\n"
-		"Average incoming rate = %f\n"
-		"Average outcoming rate = %f\n"
-		"\n\n",
+		"Total twits arrived = %llu\n"
+		"Total twits delivered = %llu\n",
 		stats->stats_threadsNum,
 		stats->stats_hearersNum,
 		stats->stats_sayersNum,
 		stats->stats_storedTwitsNum,
-		stats->stats_arrivedTwitsNum,
-		stats->stats_deliveredTwitsNum,
-		stats->stats_averageTwitsIncomingRate,
-		stats->stats_averageTwitsOutcomingRate
+		( unsigned long long )stats->stats_arrivedTwitsNum,
+		( unsigned long long )stats->stats_deliveredTwitsNum
+	);
+	print_ratewindow( "Incoming", &stats->stats_incomingRate );
+	print_ratewindow( "Outcoming", &stats->stats_outcomingRate );
+	print_hearerlag( stats );
+	printf( "\n\n" );
+	fflush( stdout );
+
+	return ;
+}
+
+// Print the rates of a struct ratewindow. The structure must not change while printed.
+static void print_ratewindow( const char * restrict name, const struct ratewindow * restrict rw ){
+	char peaktime[ 32 ];
+	struct tm tmbuf;
+
+	assert( name != NULL );
+	assert( rw != NULL );
+
+	// The time of the peak is printed only if there was a peak
+	( void )strcpy( peaktime, "-" );
+	if ( rw->rw_peak > 0.0 && localtime_r( &rw->rw_peaktime, &tmbuf ) != NULL ){
+		( void )strftime( peaktime, sizeof( peaktime ), "%Y-%m-%d %H:%M:%S", &tmbuf );
+	}
+
+	printf( "%s rate (1s/10s/60s) = %.2f / %.2f / %.2f twits/sec\n"
+		"%s rate percentiles over %ds (p50/p90/p99) = %.2f / %.2f / %.2f twits/sec\n"
+		"%s peak rate = %.2f twits/sec (at %s)\n",
+		name, rw->rw_rate1s, rw->rw_rate10s, rw->rw_rate60s,
+		name, STATS_RATE_WINDOW_NSEC, rw->rw_p50, rw->rw_p90, rw->rw_p99,
+		name, rw->rw_peak, peaktime
 	);
+
+	return ;
+}
+
+
+// Print the hearers furthest behind. The structure must not change while printed.
+static void print_hearerlag( const struct statistics * restrict stats ){
+	const struct hearerlag *hl = NULL;
+	int i;
+
+	assert( stats != NULL );
+
+	printf( "Slowest hearers:\n"
+		"----------------\n"
+		"%-8s %8s %10s %12s %10s %8s %8s %8s %8s %10s\n",
+		"hearer", "queued", "bytes", "oldest(ms)", "twits/s", "blocked", "retrans", "cwnd", "unacked", "rtt(us)" );
+	for ( i = 0; i < stats->stats_hearerLagNum && i < HEARERS_SLOWEST_SHOWN; ++i ){
+		hl = &stats->stats_hearerLag[ i ];
+		printf( "%-8lu %8llu %10llu %12.1f %10.2f %7.1f%% %8u %8u %8u %10u\n",
+			hl->hl_id,
+			( unsigned long long )hl->hl_queued,
+			( unsigned long long )hl->hl_bytesQueued,
+			hl->hl_oldest_ns / 1000000.0,
+			hl->hl_deliveredRate,
+			hl->hl_sendBlocked * 100.0,
+			( unsigned )hl->hl_retransmits,
+			( unsigned )hl->hl_sndCwnd,
+			( unsigned )hl->hl_unacked,
+			( unsigned )hl->hl_rtt_us );
+	}
+
+	return ;
+}
+
+// Print the percentiles of each stage in microseconds
+static void print_latencies( const struct histogram * restrict latency ){
+	struct histogram snapshot;
+	int stage;
+
+	assert( latency != NULL );
+
+	printf( "Latency per stage (usec):\n"
+		"-------------------------\n"
+		"%-16s %12s %12s %12s %12s %12s\n",
+		"stage", "count", "p50", "p99", "p999", "max" );
+	for ( stage = 0; stage < LATENCY_STAGES; ++stage ){
+		snapshothistogram( &latency[ stage ], &snapshot );
+		printf( "%-16s %12llu %12.1f %12.1f %12.1f %12.1f\n",
+			latencystagename( stage ),
+			( unsigned long long )snapshot.h_count,
+			histogrampercentile( &snapshot, 50.0 ) / 1000.0,
+			histogrampercentile( &snapshot, 99.0 ) / 1000.0,
+			histogrampercentile( &snapshot, 99.9 ) / 1000.0,
+			snapshot.h_max / 1000.0 );
+	}
+	printf( "\n\n" );
 	fflush( stdout );
 
 	return ;
 }
 
+// The counters are read without the lock; they may be a moment apart
+static void print_topics( struct serverinfo * restrict si ){
+	uint64_t broadcast;
+	uint64_t fanout;
+	uint64_t postings;
+	uint64_t bytes;
+
+	assert( si != NULL );
+
+	broadcast = __atomic_load_n( &si->si_broadcasttwits, __ATOMIC_RELAXED );
+	fanout = __atomic_load_n( &si->si_fanout, __ATOMIC_RELAXED );
+	postings = __atomic_load_n( &si->si_tags.ti_postings, __ATOMIC_RELAXED );
+	bytes = __atomic_load_n( &si->si_tags.ti_bytes, __ATOMIC_RELAXED );
+	printf( "Topics:\n"
+		"-------\n"
+		"Topics with subscribers = %llu, and %llu hearers on the global topic\n"
+		"Keywords with subscribers = %llu, in %llu states of the automaton (%llu links changed as they came and went)\n"
+		"Twits rejected by the prefilter of the keywords = %llu (%s code)\n"
+		"Regular expressions with subscribers = %llu, in %llu states of the lazy DFA (%llu flushes, %llu twits finished without it)\n"
+		"Hashtags and mentions in the index = %llu, with %llu postings in %llu bytes (%.2f bytes each, %llu left out; %s code)\n"
+		"Twits broadcast = %llu (%llu on topics, %llu with keywords, %llu with regular expressions, %llu with tags), put in %llu twitpools (%.2f per twit)\n"
+		"Recent twits sent to the hearers of tags = %llu\n\n\n",
+		( unsigned long long )__atomic_load_n( &si->si_topics.ts_count, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_topics.ts_globalcount, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_keywords.kw_count, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_keywords.kw_statecount, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_keywords.kw_relinked, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_keywords.kw_filtered, __ATOMIC_RELAXED ),
+		si->si_keywords.kw_prefilter.pf_kind == PREFILTER_AVX2 ? "AVX2" : si->si_keywords.kw_prefilter.pf_kind == PREFILTER_SSE42 ?
+			"SSE4.2" : "scalar",
+		( unsigned long long )__atomic_load_n( &si->si_regexes.rx_count, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_regexes.rx_dstatecount, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_regexes.rx_flushes, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_regexes.rx_thrashed, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_tags.ti_count, __ATOMIC_RELAXED ),
+		( unsigned long long )postings,
+		( unsigned long long )bytes,
+		postings ? ( double )bytes / postings : 0.0,
+		( unsigned long long )__atomic_load_n( &si->si_tags.ti_leftout, __ATOMIC_RELAXED ),
+		gettagscankind() == TAGSCAN_SSE2 ? "SSE2" : "scalar",
+		( unsigned long long )broadcast,
+		( unsigned long long )__atomic_load_n( &si->si_topictwits, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_keywordtwits, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_regextwits, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_tagtwits, __ATOMIC_RELAXED ),
+		( unsigned long long )fanout,
+		broadcast ? ( double )fanout / broadcast : 0.0,
+		( unsigned long long )__atomic_load_n( &si->si_recenttwits, __ATOMIC_RELAXED ) );
+	fflush( stdout );
+
+	return ;
+}
+
+// The counters are read without the lock, as for the topics
+static void print_search( struct serverinfo * restrict si ){
+	const struct fulltext *ft = NULL;
+	uint64_t postings;
+	uint64_t bytes;
+
+	assert( si != NULL );
+
+	ft = &si->si_fulltext;
+	postings = __atomic_load_n( &ft->ft_postings, __ATOMIC_RELAXED );
+	bytes = __atomic_load_n( &ft->ft_bytes, __ATOMIC_RELAXED );
+	printf( "Search:\n"
+		"-------\n"
+		"Twits in the full-text index = %llu, from sequence number %llu on when the server started (%llu segments dropped)\n"
+		"Words in the index = %llu, with %llu postings in %llu bytes (%.2f bytes each, %llu left out; %s code)\n"
+		"Searches = %llu, with %llu twits sent (%llu from the disk, %llu no longer there)\n\n\n",
+		( unsigned long long )__atomic_load_n( &ft->ft_twits, __ATOMIC_RELAXED ),
+		( unsigned long long )si->si_fulltext_fromseq,
+		( unsigned long long )__atomic_load_n( &ft->ft_dropped, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &ft->ft_words, __ATOMIC_RELAXED ),
+		( unsigned long long )postings,
+		( unsigned long long )bytes,
+		postings ? ( double )bytes / postings : 0.0,
+		( unsigned long long )__atomic_load_n( &ft->ft_leftout, __ATOMIC_RELAXED ),
+		getfulltextkind() == FULLTEXT_SSE2 ? "SSE2" : "scalar",
+		( unsigned long long )__atomic_load_n( &si->si_searches, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_searchtwits, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_searchdisk, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_searchmissing, __ATOMIC_RELAXED ) );
+	fflush( stdout );
+
+	return ;
+}
+
+// The few trending most are taken as a client of the trends would; the counters are read without the lock
+static void print_trends( struct serverinfo * restrict si ){
+	static const char *kindnames[ TRENDING_KINDS ] = { "Hashtags and mentions", "Words" };
+	struct trendingentry top[ TRENDS_SHOWN ];
+	const struct trendingsummary *ts = NULL;
+	uint64_t now = monotonic_ns();
+	uint64_t total;
+	size_t count;
+	size_t i;
+	int kind;
+
+	assert( si != NULL );
+
+	printf( "Trends:\n"
+		"-------\n"
+		"Twits counted = %llu, over the last %d seconds in %d slots (window moved %llu times; %.1f MB of sketches)\n",
+		( unsigned long long )__atomic_load_n( &si->si_trending.tr_twits, __ATOMIC_RELAXED ),
+		TRENDING_WINDOW_SLOTS * TRENDING_SLOT_SEC, TRENDING_WINDOW_SLOTS,
+		( unsigned long long )__atomic_load_n( &si->si_trending.tr_moves, __ATOMIC_RELAXED ),
+		( double )trendingmemory() / ( 1024.0 * 1024.0 ) );
+	for ( kind = 0; kind < TRENDING_KINDS; ++kind ){
+		ts = &si->si_trending.tr_kinds[ kind ];
+		count = gettrending( &si->si_trending, now, ( enum trendingkind )kind, top, TRENDS_SHOWN, &total );
+		printf( "%s counted = %llu (%llu in the window, %llu times one took the place of another followed):",
+			kindnames[ kind ], ( unsigned long long )__atomic_load_n( &ts->ts_counted, __ATOMIC_RELAXED ),
+			( unsigned long long )total, ( unsigned long long )__atomic_load_n( &ts->ts_replaced, __ATOMIC_RELAXED ) );
+		for ( i = 0; i < count; ++i ){
+			printf( "%s %.*s (%lu)", i > 0 ? "," : "", ( int )top[ i ].te_len, top[ i ].te_name, ( unsigned long )top[ i ].te_count );
+		}
+		printf( "\n" );
+	}
+	printf( "Requests answered = %llu\n\n\n", ( unsigned long long )__atomic_load_n( &si->si_trendsqueries, __ATOMIC_RELAXED ) );
+	fflush( stdout );
+
+	return ;
+}
+
+// Print the counters of the twit log and the percentiles of its syncs
+static void print_twitlog( struct serverinfo * restrict si ){
+	struct twitlogstats tls;
+
+	assert( si != NULL );
+
+	snapshottwitlog( si->si_twitlog, &tls );
+	printf( "Twit log (%s, sync %s):\n"
+		"---------\n"
+		"Twits logged = %llu of %llu (%llu left out)\n"
+		"Bytes written = %llu in %llu segments\n"
+		"Next sequence number = %llu\n"
+		"Syncs = %llu (usec p50/p99/max = %.1f / %.1f / %.1f)\n"
+		"Twits waited for and synced = %llu in %llu commits\n"
+		"Twits replayed to resuming hearers = %llu from memory, %llu from the disk\n"
+		"Segments removed = %llu (%.1f MB reclaimed, compaction and compression included)\n"
+		"Segments compacted = %llu (%.1f MB at %.1f MB/sec, %llu duplicate twits left out)\n"
+		"Segments compressed = %llu (%.1f MB to %.1f MB, ratio %.2f)\n"
+		"Errors = %llu\n"
+		"Snapshots written = %llu (last %.1f KB in %.3f msec, %llu failed)\n\n\n",
+		TWITLOG_DIR, twitlogsyncname( TWITLOG_SYNC ),
+		( unsigned long long )tls.tls_written,
+		( unsigned long long )( tls.tls_appended + tls.tls_dropped ),
+		( unsigned long long )tls.tls_dropped,
+		( unsigned long long )tls.tls_bytes,
+		( unsigned long long )tls.tls_segments,
+		( unsigned long long )tls.tls_nextseq,
+		( unsigned long long )tls.tls_syncs,
+		histogrampercentile( &tls.tls_sync, 50.0 ) / 1000.0,
+		histogrampercentile( &tls.tls_sync, 99.0 ) / 1000.0,
+		tls.tls_sync.h_max / 1000.0,
+		( unsigned long long )tls.tls_acked,
+		( unsigned long long )tls.tls_commits,
+		( unsigned long long )__atomic_load_n( &si->si_replayed_memory, __ATOMIC_RELAXED ),
+		( unsigned long long )__atomic_load_n( &si->si_replayed_disk, __ATOMIC_RELAXED ),
+		( unsigned long long )tls.tls_removed,
+		tls.tls_reclaimed / ( 1024.0 * 1024.0 ),
+		( unsigned long long )tls.tls_compacted,
+		tls.tls_compactbytes / ( 1024.0 * 1024.0 ),
+		tls.tls_compactns ? tls.tls_compactbytes / ( tls.tls_compactns / 1e9 ) / ( 1024.0 * 1024.0 ) : 0.0,
+		( unsigned long long )tls.tls_duplicates,
+		( unsigned long long )tls.tls_compressed,
+		tls.tls_compressedin / ( 1024.0 * 1024.0 ),
+		tls.tls_compressedout / ( 1024.0 * 1024.0 ),
+		tls.tls_compressedout ? ( double )tls.tls_compressedin / tls.tls_compressedout : 0.0,
+		( unsigned long long )tls.tls_errors,
+		( unsigned long long )__atomic_load_n( &si->si_snapshots, __ATOMIC_RELAXED ),
+		__atomic_load_n( &si->si_snapshot_bytes, __ATOMIC_RELAXED ) / 1024.0,
+		__atomic_load_n( &si->si_snapshot_ns, __ATOMIC_RELAXED ) / 1e6,
+		( unsigned long long )__atomic_load_n( &si->si_snapshot_failures, __ATOMIC_RELAXED ) );
+	fflush( stdout );
+
+	return ;
+}
+
+// One line, two if something was cut off, is damaged or was indexed again, and one for the snapshot
+static void print_recovery( const struct serverinfo * restrict si ){
+	const struct twitlogrecovery *rc = NULL;
+
+	assert( si != NULL );
+
+	rc = &si->si_twitlog_recovery;
+	printf( "Twit log recovered: %llu twits in %llu segments (%.1f MB) checked by %u threads in %.3f sec; next sequence number = %llu\n",
+		( unsigned long long )rc->tlrc_records,
+		( unsigned long long )rc->tlrc_segments,
+		rc->tlrc_bytes / ( 1024.0 * 1024.0 ),
+		rc->tlrc_threads,
+		rc->tlrc_elapsed / 1e9,
+		( unsigned long long )rc->tlrc_nextseq );
+	if ( rc->tlrc_truncated > 0 || rc->tlrc_damaged > 0 || rc->tlrc_reindexed > 0 ){
+		printf( "Twit log: %llu bytes cut off the newest segment, %llu older segments damaged, %llu indexes written again\n",
+			( unsigned long long )rc->tlrc_truncated,
+			( unsigned long long )rc->tlrc_damaged,
+			( unsigned long long )rc->tlrc_reindexed );
+	}
+	if ( si->si_restored ){
+		printf( "Snapshot %s taken: %llu twits of the recent history, %llu cursors, %llu older segments not checked again; "
+			"the twit log and the recent history were ready in %.3f msec\n",
+			SNAPSHOT_FILE,
+			( unsigned long long )si->si_restored_entries,
+			( unsigned long long )si->si_restored_cursors,
+			( unsigned long long )rc->tlrc_trusted,
+			si->si_restored_ns / 1e6 );
+	}
+	else{
+		printf( "No snapshot taken; the twit log and the recent history were ready in %.3f msec\n", si->si_restored_ns / 1e6 );
+	}
+
+	return ;
+}
+
+// The time no connection was accepted is only known to the server that took over
+static void print_handoff( const struct serverinfo * restrict si, int tookover ){
+	const struct handoff *ho = NULL;
+
+	assert( si != NULL );
+
+	ho = &si->si_handoff;
+	if ( tookover ){
+		printf( "Took over from process %llu: %llu hearers handed over, %llu dropped, %llu twits left out; "
+			"it drained in %.3f msec and no connection was accepted for %.3f msec\n",
+			( unsigned long long )ho->ho_pid,
+			( unsigned long long )ho->ho_handed,
+			( unsigned long long )ho->ho_dropped,
+			( unsigned long long )ho->ho_leftout,
+			ho->ho_drain_ns / 1e6,
+			ho->ho_paused_ns / 1e6 );
+	}
+	else{
+		printf( "Handed over to process %llu: %llu hearers handed over, %llu dropped, %llu twits left out; drained in %.3f msec\n",
+			( unsigned long long )ho->ho_pid,
+			( unsigned long long )ho->ho_handed,
+			( unsigned long long )ho->ho_dropped,
+			( unsigned long long )__atomic_load_n( &ho->ho_leftout, __ATOMIC_RELAXED ),
+			ho->ho_drain_ns / 1e6 );
+	}
+	fflush( stdout );
+
+	return ;
+}
+
+#if defined( LOCK_STATS )
+// Print the counters and percentiles of each lock
+static void print_lockstats( void ){
+	struct lockstats ls;
+	int name;
+
+	printf( "Locks (usec):\n"
+		"-------------\n"
+		"%-20s %12s %12s %10s %10s %10s %10s %10s %10s\n",
+		"lock", "acquired", "contended", "wait p50", "wait p99", "wait max", "hold p50", "hold p99", "hold max" );
+	for ( name = 0; name < LOCK_NAMES; ++name ){
+		snapshotlockstats( name, &ls );
+		printf( "%-20s %12llu %12llu %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+			lockstatsname( name ),
+			( unsigned long long )ls.ls_acquired,
+			( unsigned long long )ls.ls_contended,
+			histogrampercentile( &ls.ls_wait, 50.0 ) / 1000.0,
+			histogrampercentile( &ls.ls_wait, 99.0 ) / 1000.0,
+			ls.ls_wait.h_max / 1000.0,
+			histogrampercentile( &ls.ls_hold, 50.0 ) / 1000.0,
+			histogrampercentile( &ls.ls_hold, 99.0 ) / 1000.0,
+			ls.ls_hold.h_max / 1000.0 );
+	}
+	printf( "\n\n" );
+	fflush( stdout );
+
+	return ;
+}
+#endif
+
 // Ask user if server is to be terminated or not
 static int handle_termination( void ){
 	char buffer[ 2 ];
@@ -247,6 +752,17 @@ static int handle_termination( void ){
 	return ( toTerminate );
 }
 
+// Display usage info and exit
+static void usage( const char * restrict programname ){
+	assert( programname != NULL );
+	error( "usage: %s [-r]\n"
+		"  -r  take over the listeners and hearers of the server running\n"
+		"The twits are logged in the directory %s and the snapshot is written to %s, both in the working directory,\n"
+		"which must be writable: the server does not start if it cannot open the twit log.\n",
+		programname, TWITLOG_DIR, SNAPSHOT_FILE );
+	exit( EXIT_FAILURE );
+}
+
 // Discard a line from fp
 static void discardline( FILE *fp ){
 	int ch;
@@ -262,6 +778,8 @@ static void discardline( FILE *fp ){
 
 // Do cleanup for the server
 static void cleanup_server( struct serverinfo * restrict si ){
+	struct twitlogstats tls;
+
 	assert( si != NULL );
 
 	// Stop the threads
@@ -269,6 +787,41 @@ static void cleanup_server( struct serverinfo * restrict si ){
 	( void )pthread_cancel( si->si_twitpool_consumer_threadid );
 	( void )pthread_cancel( si->si_sayers_listener_threadid );
 	( void )pthread_cancel( si->si_hearers_listener_threadid );
+	( void )pthread_cancel( si->si_metrics_listener_threadid );
+	( void )pthread_cancel( si->si_search_listener_threadid );
+	( void )pthread_cancel( si->si_trends_listener_threadid );
+	( void )pthread_cancel( si->si_snapshot_writer_threadid );
+	( void )pthread_cancel( si->si_handoff_listener_threadid );
+	( void )pthread_join( si->si_handoff_listener_threadid, NULL );
+	// A search may be going through the segments of the full-text index without its lock
+	( void )pthread_join( si->si_search_listener_threadid, NULL );
+	// An answer may be taking the lock of the counts
+	( void )pthread_join( si->si_trends_listener_threadid, NULL );
+
+	// The sayers and the hearers go before the twitpools, the twit log they use and the locks they take
+	stopsayers( si );
+	stophearers( si );
+
+	// The statistics updater publishes in the statistics page so it must be gone before the page is removed
+	( void )pthread_join( si->si_statistics_updater_threadid, NULL );
+	if ( si->si_statspage != NULL ){
+		removestatspage( si->si_statspage );
+	}
+
+	// Once the consumer is gone nothing more is appended; the last snapshot is written then, so the server starts again from where
+	// it stopped. The twits it appended are written and synced before the log is closed
+	( void )pthread_join( si->si_twitpool_consumer_threadid, NULL );
+	( void )pthread_join( si->si_snapshot_writer_threadid, NULL );
+	if ( writesnapshot( SNAPSHOT_FILE, &si->si_history, &si->si_cursors, si->si_twitlog, NULL ) == -1 ){
+		error( "Failed to write the snapshot to %s (%s).\n", SNAPSHOT_FILE, strerror( errno ) );
+	}
+	snapshottwitlog( si->si_twitlog, &tls );
+	closetwitlog( si->si_twitlog );
+
+	// A server taking over opens the twit log and the snapshot once it is told
+	if ( si->si_handoff.ho_sockfd != -1 && finishhandoff( si, tls.tls_nextseq ) == -1 ){
+		error( "Failed to tell process %llu that the twit log is closed (%s).\n", ( unsigned long long )si->si_handoff.ho_pid, strerror( errno ) );
+	}
 
 	// Destroy mutexes and conditions
 	( void )pthread_cond_destroy( &si->si_stats_sayers_cond );
@@ -279,6 +832,10 @@ static void cleanup_server( struct serverinfo * restrict si ){
 	( void )pthread_mutex_destroy( &si->si_prepared_lock );
 	( void )pthread_mutex_destroy( &si->si_twitpool_lock );
 	( void )pthread_mutex_destroy( &si->si_twitpool_list_lock );
+	( void )pthread_mutex_destroy( &si->si_topics_lock );
+	( void )pthread_mutex_destroy( &si->si_keywords_lock );
+	( void )pthread_mutex_destroy( &si->si_regexes_lock );
+	( void )pthread_mutex_destroy( &si->si_tags_lock );
 
 	// Destroy the twitpool
 	( void )deltwitpool( &si->si_twitpool );
@@ -286,5 +843,17 @@ static void cleanup_server( struct serverinfo * restrict si ){
 	// Destroy the twitpool list
 	( void )deltwitpoollist( &si->si_twitpool_list );
 
+	// Destroy the recent history; the consumer that added to it is gone
+	delhistory( &si->si_history );
+	delcursors( &si->si_cursors );
+	deltopics( &si->si_topics );
+	delkeywords( &si->si_keywords );
+	delregexes( &si->si_regexes );
+	deltagindex( &si->si_tags );
+	delfulltext( &si->si_fulltext );
+	deltrending( &si->si_trending );
+	delbitmap( &si->si_fanoutset );
+	delhandoff( &si->si_handoff );
+
 	return ;
 }
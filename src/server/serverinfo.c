@@ -34,13 +34,15 @@
 #include <assert.h>
 #include <pthread.h>
 #include "serverinfo.h"
+#include "seqlock.h"
+#include "lockstats.h"
 
 
 
 void acquire_statistics( struct serverinfo * restrict si ){
 	assert( si != NULL );
 
-	while ( pthread_mutex_lock( &si->si_stats_lock ) ){ continue; }
+	lock_mutex( LOCK_STATISTICS, &si->si_stats_lock, &si->si_stats_lockedat );
 
 	return ;
 }
@@ -48,7 +50,33 @@ void acquire_statistics( struct serverinfo * restrict si ){
 void release_statistics( struct serverinfo * restrict si ){
 	assert( si != NULL );
 
-	while ( pthread_mutex_unlock( &si->si_stats_lock ) ){ continue; }
+	unlock_mutex( LOCK_STATISTICS, &si->si_stats_lock, &si->si_stats_lockedat );
+
+	return ;
+}
+
+void wait_statistics( struct serverinfo * restrict si, pthread_cond_t * restrict cond ){
+	assert( si != NULL );
+	assert( cond != NULL );
+
+	wait_mutex( LOCK_STATISTICS, cond, &si->si_stats_lock, &si->si_stats_lockedat );
+
+	return ;
+}
+
+void publish_statistics( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	seqlock_write( &si->si_stats_snapshot_seq, &si->si_stats_snapshot, &si->si_stats, sizeof( si->si_stats ) );
+
+	return ;
+}
+
+void snapshot_statistics( struct serverinfo * restrict si, struct statistics * restrict stats ){
+	assert( si != NULL );
+	assert( stats != NULL );
+
+	( void )seqlock_read( &si->si_stats_snapshot_seq, stats, &si->si_stats_snapshot, sizeof( *stats ) );
 
 	return ;
 }
@@ -56,7 +84,7 @@ void release_statistics( struct serverinfo * restrict si ){
 void acquire_twitpool( struct serverinfo * restrict si ){
 	assert( si != NULL );
 
-	while ( pthread_mutex_lock( &si->si_twitpool_lock ) ){ continue; }
+	lock_mutex( LOCK_TWITPOOL, &si->si_twitpool_lock, &si->si_twitpool_lockedat );
 
 	return ;
 }
@@ -64,7 +92,15 @@ void acquire_twitpool( struct serverinfo * restrict si ){
 void release_twitpool( struct serverinfo * restrict si ){
 	assert( si != NULL );
 
-	while ( pthread_mutex_unlock( &si->si_twitpool_lock ) ){ continue; }
+	unlock_mutex( LOCK_TWITPOOL, &si->si_twitpool_lock, &si->si_twitpool_lockedat );
+
+	return ;
+}
+
+void wait_twitpool( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	wait_mutex( LOCK_TWITPOOL, &si->si_twitpool_cond, &si->si_twitpool_lock, &si->si_twitpool_lockedat );
 
 	return ;
 }
@@ -72,7 +108,7 @@ void release_twitpool( struct serverinfo * restrict si ){
 void acquire_twitpool_list( struct serverinfo * restrict si ){
 	assert( si != NULL );
 
-	while ( pthread_mutex_lock( &si->si_twitpool_list_lock ) ){ continue; }
+	lock_mutex( LOCK_TWITPOOL_LIST, &si->si_twitpool_list_lock, &si->si_twitpool_list_lockedat );
 
 	return ;
 }
@@ -80,7 +116,71 @@ void acquire_twitpool_list( struct serverinfo * restrict si ){
 void release_twitpool_list( struct serverinfo * restrict si ){
 	assert( si != NULL );
 
-	while ( pthread_mutex_unlock( &si->si_twitpool_list_lock ) ){ continue; }
+	unlock_mutex( LOCK_TWITPOOL_LIST, &si->si_twitpool_list_lock, &si->si_twitpool_list_lockedat );
+
+	return ;
+}
+
+void acquire_topics( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	lock_mutex( LOCK_TOPICS, &si->si_topics_lock, &si->si_topics_lockedat );
+
+	return ;
+}
+
+void release_topics( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	unlock_mutex( LOCK_TOPICS, &si->si_topics_lock, &si->si_topics_lockedat );
+
+	return ;
+}
+
+void acquire_keywords( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	lock_mutex( LOCK_KEYWORDS, &si->si_keywords_lock, &si->si_keywords_lockedat );
+
+	return ;
+}
+
+void release_keywords( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	unlock_mutex( LOCK_KEYWORDS, &si->si_keywords_lock, &si->si_keywords_lockedat );
+
+	return ;
+}
+
+void acquire_regexes( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	lock_mutex( LOCK_REGEXES, &si->si_regexes_lock, &si->si_regexes_lockedat );
+
+	return ;
+}
+
+void release_regexes( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	unlock_mutex( LOCK_REGEXES, &si->si_regexes_lock, &si->si_regexes_lockedat );
+
+	return ;
+}
+
+void acquire_tags( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	lock_mutex( LOCK_TAGS, &si->si_tags_lock, &si->si_tags_lockedat );
+
+	return ;
+}
+
+void release_tags( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	unlock_mutex( LOCK_TAGS, &si->si_tags_lock, &si->si_tags_lockedat );
 
 	return ;
 }
@@ -88,7 +188,7 @@ void release_twitpool_list( struct serverinfo * restrict si ){
 void acquire_preparation_status( struct serverinfo * restrict si ){
 	assert( si != NULL );
 
-	while ( pthread_mutex_lock( &si->si_prepared_lock ) ){ continue; }
+	lock_mutex( LOCK_PREPARATION_STATUS, &si->si_prepared_lock, &si->si_prepared_lockedat );
 
 	return ;
 }
@@ -96,11 +196,32 @@ void acquire_preparation_status( struct serverinfo * restrict si ){
 void release_preparation_status( struct serverinfo * restrict si ){
 	assert( si != NULL );
 
-	while ( pthread_mutex_unlock( &si->si_prepared_lock ) ){ continue; }
+	unlock_mutex( LOCK_PREPARATION_STATUS, &si->si_prepared_lock, &si->si_prepared_lockedat );
 
 	return ;
 }
 
+void wait_preparation_status( struct serverinfo * restrict si ){
+	assert( si != NULL );
+
+	wait_mutex( LOCK_PREPARATION_STATUS, &si->si_prepared_cond, &si->si_prepared_lock, &si->si_prepared_lockedat );
+
+	return ;
+}
+
+const char *latencystagename( enum latencystage stage ){
+	static const char * const names[ LATENCY_STAGES ] = {
+		[ LATENCY_CONSUMER_QUEUE ] = "consumer_queue",
+		[ LATENCY_FANOUT ] = "fanout",
+		[ LATENCY_HEARER ] = "hearer",
+		[ LATENCY_END_TO_END ] = "end_to_end"
+	};
+
+	assert( stage >= 0 && stage < LATENCY_STAGES );
+
+	return ( names[ stage ] );
+}
+
 void signal_prepared_status( struct serverinfo * restrict si, int status ){
 	assert( si != NULL );
 	assert( status == 0 || status == 1 );
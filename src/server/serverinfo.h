@@ -39,11 +39,56 @@ extern "C"{
 #endif
 
 #include <pthread.h>
+#include <stdint.h>
+#include "histogram.h"
 #include "statistics.h"
 #include "twitpool.h"
 #include "twitpoollist.h"
+#include "history.h"
+#include "cursors.h"
+#include "twitlog.h"
+#include "topics.h"
+#include "keywords.h"
+#include "regexes.h"
+#include "tags.h"
+#include "bitmap.h"
+#include "fulltext.h"
+#include "trending.h"
+#include "topicframe.h"
+#include "handoff.h"
 
+// Declared in statspage.h
+struct statspage;
 
+/**
+ * \enum latencystage
+ *
+ * The latencystage enumeration names the stages a twit passes through inside the server, whose latency is measured.
+ */
+enum latencystage{
+	LATENCY_CONSUMER_QUEUE, /**< From receivetwit() until the twit leaves the twitpool shared by the sayers */
+	LATENCY_FANOUT, /**< From leaving the shared twitpool until entering the twitpool of a hearer */
+	LATENCY_HEARER, /**< From entering the twitpool of a hearer until sendtwit() is done with it */
+	LATENCY_END_TO_END, /**< From receivetwit() until sendtwit() is done with it */
+	LATENCY_STAGES
+};
+
+/**
+ * \enum listenername
+ *
+ * The listenername enumeration names the listening sockets of the server, which are handed over on a hot restart (see handoff.h).
+ */
+enum listenername{
+	LISTEN_SAYERS, /**< SAYERS_PORT */
+	LISTEN_DURABLE_SAYERS, /**< DURABLE_SAYERS_PORT */
+	LISTEN_HEARERS, /**< HEARERS_PORT */
+	LISTEN_RESUMING_HEARERS, /**< RESUMING_HEARERS_PORT */
+	LISTEN_TOPIC_HEARERS, /**< TOPIC_HEARERS_PORT */
+	LISTEN_METRICS, /**< METRICS_PORT */
+	LISTEN_SEARCH, /**< SEARCH_PORT */
+	LISTEN_TRENDS, /**< TRENDS_PORT */
+	LISTENERS
+};
 
 /**
  * \struct serverinfo
@@ -56,6 +101,8 @@ extern "C"{
  *		+ A lock for handling access to the statistics structure
  *		+ A condition for signaling whether a sayer was disconnected
  *		+ A condition for signaling whether a hearer was disconnected
+ *		+ A copy of the statistics structure, guarded by a seqlock, for readers that must not lock
+ *		+ The statistics page shared with other processes, if it could be created
  *	2) Managing preparation status 
  *		+ A flag that gets one of three values; first it is -1 meaning that the
  *		preparation status has not yet been determined. It later gets 1 or 0
@@ -64,7 +111,16 @@ extern "C"{
  *		+ A condition variable for signaling whether the preparation status
  *		is determined or not.
  *	3) Managing the message data structure
- *	4) Keeping track of the threads
+ *		+ The twit log to which the consumer appends every twit before it is sent to the hearers
+ *		+ The topics, the keywords and the regular expressions the hearers subscribe to, through which the consumer finds the twitpools a twit goes to
+ *		+ The recent history, the cursors of the hearers and the snapshot of both
+ *		+ The full-text index of the recent twits, searched through SEARCH_PORT
+ *		+ The counts of the tags and the words of the twits of the last minutes, whose most frequent are asked for through TRENDS_PORT
+ *	4) Keeping track of the latency of each stage a twit passes through
+ *	5) Keeping track of the threads
+ *	6) Handing the server over to one restarted in its place: the listening sockets and the state of the hot restart
+ *
+ * Next to each mutex is the time it was acquired, as kept by lock_mutex() (see lockstats.h).
  *
  * The members in the serverinfo structure are ordered logically as parts that can be grouped together.
  * Reordering the members i could save around 8 bytes (as shown in my machine) but since only one object
@@ -75,19 +131,103 @@ struct serverinfo{
 	// Managing the statistics
 	struct statistics si_stats;
 	pthread_mutex_t si_stats_lock;
+	uint64_t si_stats_lockedat;
 	pthread_cond_t si_stats_sayers_cond;
 	pthread_cond_t si_stats_hearers_cond;
+	// The sockets of the sayers connected, one a slot, -1 for a free slot; guarded by si_stats_lock (see stopsayers())
+	int si_sayerfds[ SAYERS_MAXCOUNT ];
+	// Copy of the statistics published every STATS_UPDATE_NSEC seconds for readers that must not lock
+	struct statistics si_stats_snapshot;
+	volatile unsigned si_stats_snapshot_seq;
+	// Statistics page shared with other processes; NULL if it could not be created. Only the statistics updater publishes in it
+	struct statspage *si_statspage;
 	// Managing preparation status
 	int si_prepared;
 	pthread_mutex_t si_prepared_lock;
+	uint64_t si_prepared_lockedat;
 	pthread_cond_t si_prepared_cond;
 	// Structure holding the twits
 	struct twitpool si_twitpool;
 	pthread_mutex_t si_twitpool_lock;
+	uint64_t si_twitpool_lockedat;
 	pthread_cond_t si_twitpool_cond;
+	// The twits on disk; only the twitpool consumer appends to it
+	struct twitlog *si_twitlog;
+	// What was found in the twit log when it was opened
+	struct twitlogrecovery si_twitlog_recovery;
+	// The most recent twits; only the twitpool consumer adds to it
+	struct history si_history;
+	// The cursors of the hearers that resume by name
+	struct cursors si_cursors;
+	// What was taken from the snapshot when the server started: twits of the recent history, cursors, and how long opening the
+	// twit log and filling the recent history took, snapshot or not
+	uint64_t si_restored_entries;
+	uint64_t si_restored_cursors;
+	uint64_t si_restored_ns;
+	int si_restored; /**< Whether a snapshot was taken */
+	// Snapshots written, failed, and the time and size of the last one; updated atomically
+	uint64_t si_snapshots;
+	uint64_t si_snapshot_failures;
+	uint64_t si_snapshot_ns;
+	uint64_t si_snapshot_bytes;
 	// One twitpool for each hearer
 	struct twitpoollist si_twitpool_list;
 	pthread_mutex_t si_twitpool_list_lock;
+	uint64_t si_twitpool_list_lockedat;
+	// The subscribers of each topic; guarded by si_topics_lock. Each of the matchers below has a lock of its own, so the consumer
+	// matches a twit without holding si_twitpool_list_lock; a thread that holds both takes si_twitpool_list_lock first
+	struct topics si_topics;
+	pthread_mutex_t si_topics_lock;
+	uint64_t si_topics_lockedat;
+	// Twits broadcast, those of them on a topic other than the global one, and the twitpools they were put in; updated atomically
+	uint64_t si_broadcasttwits;
+	uint64_t si_topictwits;
+	uint64_t si_fanout;
+	// The automaton of the keywords of the hearers; guarded by si_keywords_lock
+	struct keywords si_keywords;
+	pthread_mutex_t si_keywords_lock;
+	uint64_t si_keywords_lockedat;
+	// Twits that had a keyword of a hearer in them; updated atomically
+	uint64_t si_keywordtwits;
+	// The lazy DFA of the regular expressions of the hearers; guarded by si_regexes_lock
+	struct regexes si_regexes;
+	pthread_mutex_t si_regexes_lock;
+	uint64_t si_regexes_lockedat;
+	// Twits that matched a regular expression of a hearer; updated atomically
+	uint64_t si_regextwits;
+	// The inverted index of the hashtags and mentions of the recent twits, with their subscribers; guarded by si_tags_lock
+	struct tagindex si_tags;
+	pthread_mutex_t si_tags_lock;
+	uint64_t si_tags_lockedat;
+	// Twits that had a hashtag or a mention a hearer subscribed to, and the recent twits sent to the hearers that asked for them;
+	// updated atomically
+	uint64_t si_tagtwits;
+	uint64_t si_recenttwits;
+	// The numbers of the twitpools the twit being broadcast goes to, from the bitmaps of the above, reused for each twit; only used
+	// by the consumer
+	struct bitmap si_fanoutset;
+	// Sequence number of the last twit put in the twitpools of the hearers; guarded by si_twitpool_list_lock
+	uint64_t si_broadcastseq;
+	// Sequence number of the last twit put in the twitpool shared by the sayers; guarded by si_twitpool_lock
+	uint64_t si_queuedseq;
+	// Number of twits replayed to resuming hearers from the recent history and from the twit log; updated atomically
+	uint64_t si_replayed_memory;
+	uint64_t si_replayed_disk;
+	// The words of the twits; the consumer adds each twit after the recent history, and the search listener fills it first with the
+	// twits of the twit log before si_fulltext_fromseq, the first one indexed when the server started
+	struct fulltext si_fulltext;
+	uint64_t si_fulltext_fromseq;
+	// Searches answered, the twits sent, those of them read from the twit log and those found but no longer there; updated atomically
+	uint64_t si_searches;
+	uint64_t si_searchtwits;
+	uint64_t si_searchdisk;
+	uint64_t si_searchmissing;
+	// The tags and the words counted over the last minutes; the consumer adds each twit after the full-text index
+	struct trending si_trending;
+	// Requests for what is trending answered; updated atomically
+	uint64_t si_trendsqueries;
+	// Latency of each stage; recorded without locking
+	struct histogram si_latency[ LATENCY_STAGES ];
 	// This is the thread listening for sayers
 	pthread_t si_sayers_listener_threadid;
 	// This is the thread listening for hearers
@@ -96,6 +236,22 @@ struct serverinfo{
 	pthread_t si_statistics_updater_threadid;	
 	// This is the thread consuming the twitpool
 	pthread_t si_twitpool_consumer_threadid;
+	// This is the thread serving the metrics
+	pthread_t si_metrics_listener_threadid;
+	// This is the thread answering the searches
+	pthread_t si_search_listener_threadid;
+	// This is the thread answering what is trending
+	pthread_t si_trends_listener_threadid;
+	// This is the thread writing the snapshot
+	pthread_t si_snapshot_writer_threadid;
+	// This is the thread listening for a server that takes over
+	pthread_t si_handoff_listener_threadid;
+	// The listening sockets, taken over or created by the listeners; -1 until then
+	int si_listenfds[ LISTENERS ];
+	// The hot restart, to this server or from it
+	struct handoff si_handoff;
+	// Set atomically once the server terminates; the sayers and the hearers then leave (see stopsayers() and stophearers())
+	int si_stopping;
 };
 
 /**
@@ -110,6 +266,21 @@ struct connserverinfo{
 	struct serverinfo *csi_serverinfo;
 	struct twitpoollist_node *csi_tpln;
 	int csi_sockfd;
+	int csi_durable; /**< Whether the sayer waits for each twit to be synced to the twit log */
+	int csi_sayerslot; /**< The slot of the sayer in si_sayerfds */
+	int csi_resume; /**< Whether the hearer asks for the twits it missed first (see replay.h) */
+	uint64_t csi_boundary; /**< Twits with larger sequence numbers reach the twitpool of the hearer */
+	int csi_cursor; /**< The cursor in si_cursors the hearer holds; -1 if it resumed without one */
+	int csi_handoff; /**< Whether the hearer is handed over, to this server or from it (see handoff.h) */
+	char csi_topics[ TOPICFRAME_REQUEST_MAXLEN ]; /**< The names of the topics of the hearer, as in the request line of topicframe.h */
+	struct subscription csi_subs[ HEARER_TOPICS_MAXCOUNT ]; /**< The subscriptions of the hearer, linked in si_topics */
+	int csi_subcount; /**< Number of subscriptions; zero until the hearer of TOPIC_HEARERS_PORT named its topics */
+	char csi_keywords[ TOPICFRAME_REQUEST_MAXLEN ]; /**< The keywords of the hearer, as in the request line of topicframe.h */
+	struct keywordsubscriber csi_kwsubscriber; /**< Its subscriptions to them, linked in si_keywords */
+	char csi_regexes[ TOPICFRAME_REQUEST_MAXLEN ]; /**< The regular expressions of the hearer, as in the request line of topicframe.h */
+	struct regexsubscriber csi_rxsubscriber; /**< Its slots for them in si_regexes */
+	char csi_tags[ TOPICFRAME_REQUEST_MAXLEN ]; /**< The hashtags and mentions of the hearer, as in the request line of topicframe.h */
+	struct tagsubscriber csi_tgsubscriber; /**< Its subscriptions to them in si_tags */
 };
 
 
@@ -130,6 +301,33 @@ void acquire_statistics( struct serverinfo * restrict si );
  */
 void release_statistics( struct serverinfo * restrict si );
 
+/**
+ * The wait_statistics() function shall wait on the condition pointed to by parameter cond, which shall be one of the conditions
+ * of the statistics structure in the serverinfo structure pointed to by parameter si. The statistics structure shall be owned by
+ * the caller and it is owned again when the wait_statistics() function returns. Neither parameter shall be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void wait_statistics( struct serverinfo * restrict si, pthread_cond_t * restrict cond );
+
+/**
+ * The publish_statistics() function shall copy the statistics structure in the serverinfo structure pointed to by parameter si,
+ * which shall not be a NULL pointer, to the copy read by snapshot_statistics(). The statistics structure shall be owned by the
+ * caller and only one thread shall publish the statistics.
+ *
+ * @return Nothing.
+ */
+void publish_statistics( struct serverinfo * restrict si );
+
+/**
+ * The snapshot_statistics() function shall store in the object pointed to by parameter stats the statistics last published
+ * with publish_statistics() for the serverinfo structure pointed to by parameter si. Neither parameter shall be a NULL pointer.
+ * The snapshot_statistics() function never locks and never blocks the publisher.
+ *
+ * @return Nothing.
+ */
+void snapshot_statistics( struct serverinfo * restrict si, struct statistics * restrict stats );
+
 /**
  * The acquire_twitpool() function shall acquire ownership of the twitpool structure in the serverinfo structure
  * pointed to by parameter si, which shall not be a NULL pointer.
@@ -146,6 +344,15 @@ void acquire_twitpool( struct serverinfo * restrict si );
  */
 void release_twitpool( struct serverinfo * restrict si );
 
+/**
+ * The wait_twitpool() function shall wait until the condition of the twitpool structure in the serverinfo structure pointed to by
+ * parameter si, which shall not be a NULL pointer, is signaled. The twitpool structure shall be owned by the caller and it is owned
+ * again when the wait_twitpool() function returns.
+ *
+ * @return Nothing.
+ */
+void wait_twitpool( struct serverinfo * restrict si );
+
 /**
  * The acquire_twitpool_list() function shall acquire ownership of the twitpoollist structure in the serverinfo structure
  * pointed to by parameter si, which shall not be a NULL pointer.
@@ -162,6 +369,70 @@ void acquire_twitpool_list( struct serverinfo * restrict si );
  */
 void release_twitpool_list( struct serverinfo * restrict si );
 
+/**
+ * The acquire_topics() function shall acquire ownership of the topics in the serverinfo structure pointed to by parameter si,
+ * which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void acquire_topics( struct serverinfo * restrict si );
+
+/**
+ * The release_topics() function shall release ownership of the topics in the serverinfo structure pointed to by parameter si,
+ * which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void release_topics( struct serverinfo * restrict si );
+
+/**
+ * The acquire_keywords() function shall acquire ownership of the keywords in the serverinfo structure pointed to by parameter si,
+ * which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void acquire_keywords( struct serverinfo * restrict si );
+
+/**
+ * The release_keywords() function shall release ownership of the keywords in the serverinfo structure pointed to by parameter si,
+ * which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void release_keywords( struct serverinfo * restrict si );
+
+/**
+ * The acquire_regexes() function shall acquire ownership of the regular expressions in the serverinfo structure pointed to by
+ * parameter si, which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void acquire_regexes( struct serverinfo * restrict si );
+
+/**
+ * The release_regexes() function shall release ownership of the regular expressions in the serverinfo structure pointed to by
+ * parameter si, which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void release_regexes( struct serverinfo * restrict si );
+
+/**
+ * The acquire_tags() function shall acquire ownership of the index of the tags in the serverinfo structure pointed to by parameter
+ * si, which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void acquire_tags( struct serverinfo * restrict si );
+
+/**
+ * The release_tags() function shall release ownership of the index of the tags in the serverinfo structure pointed to by parameter
+ * si, which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void release_tags( struct serverinfo * restrict si );
+
 /**
  * The acquire_preparation_status() function shall acquire ownership of the preparation status member in the serverinfo structure
  * pointed to by parameter si, which shall not be a NULL pointer.
@@ -178,6 +449,23 @@ void acquire_preparation_status( struct serverinfo * restrict si );
  */
 void release_preparation_status( struct serverinfo * restrict si );
 
+/**
+ * The wait_preparation_status() function shall wait until the condition of the preparation status in the serverinfo structure
+ * pointed to by parameter si, which shall not be a NULL pointer, is signaled. The preparation status shall be owned by the caller
+ * and it is owned again when the wait_preparation_status() function returns.
+ *
+ * @return Nothing.
+ */
+void wait_preparation_status( struct serverinfo * restrict si );
+
+/**
+ * The latencystagename() function shall return the name of the stage given as parameter, which shall be a valid
+ * enum latencystage value other than LATENCY_STAGES.
+ *
+ * @return Pointer to the name of the stage.
+ */
+const char *latencystagename( enum latencystage stage );
+
 /**
  * The signal_prepared_status() function shall signal the prepared status of the struct serverinfo object pointed to by parameter
  * si. The status given as parameter shall be either 0 or 1.
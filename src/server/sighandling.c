@@ -80,6 +80,9 @@ void setup_signals( sigset_t * restrict sigset ){
 	ADD_SIGNAL( SIGHUP );
 	// set up for SIGTERM
 	ADD_SIGNAL( SIGTERM );
+	// set up for SIGUSR1 and SIGUSR2
+	ADD_SIGNAL( SIGUSR1 );
+	ADD_SIGNAL( SIGUSR2 );
 	
 	// set the signal mask
 	while ( pthread_sigmask( SIG_BLOCK, sigset, NULL ) ){ continue; }
@@ -0,0 +1,304 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file snapshot.c
+ *
+ * File snapshot.c contains the implementation of the snapshot.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "crc32c.h"
+#include "serverinfo.h"
+#include "snapshot.h"
+#include "timing.h"
+#include "config.h"
+#include "error.h"
+#include "util.h"
+
+// Each part starts on an 8 byte boundary of the map
+#define SNAPSHOT_ALIGN( offset ) ( ( ( offset ) + 7 ) & ~( uint64_t )7 )
+
+/**
+ * The checksnapshot() function shall check the snapshot of size bytes pointed to by parameter map, as loadsnapshot() says.
+ *
+ * @return Nonzero if it is one this server can take, zero otherwise.
+ */
+static int checksnapshot( const unsigned char * restrict map, size_t size );
+
+/**
+ * The checkpart() function shall tell whether count elements of elementsize bytes at offset at fit in a snapshot of size bytes.
+ *
+ * @return Nonzero if they do, zero otherwise.
+ */
+static int checkpart( uint64_t at, uint64_t count, size_t elementsize, size_t size );
+
+/**
+ * The snapshotcrc() function shall return the CRC-32C of the snapshot of size bytes pointed to by parameter map, taking its ssh_crc
+ * member as zero.
+ *
+ * @return The checksum.
+ */
+static uint32_t snapshotcrc( const unsigned char * restrict map, size_t size );
+
+
+
+// The recent history is copied before the cursors and both before the next sequence number, so that number is larger than theirs.
+// The file is built in memory and written with one write()
+int writesnapshot( const char * restrict path, struct history * restrict hs, struct cursors * restrict cs, struct twitlog * restrict tl,
+	size_t * restrict size ){
+	char newpath[ 512 ];
+	struct snapshotheader *ssh = NULL;
+	struct twitlogcheckpoint *cps = NULL;
+	struct twitlogstats tls;
+	unsigned char *buf = NULL;
+	uint64_t entriesat, cursorsat, checkpointsat, end;
+	size_t count;
+	int fd;
+
+	assert( path != NULL );
+	assert( hs != NULL );
+	assert( cs != NULL );
+	assert( tl != NULL );
+
+	if ( snprintf( newpath, sizeof( newpath ), "%s.new", path ) >= ( int )sizeof( newpath ) ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	if ( checkpointtwitlog( tl, &cps, &count ) == -1 ){
+		return ( -1 );
+	}
+	entriesat = SNAPSHOT_ALIGN( sizeof( *ssh ) );
+	cursorsat = SNAPSHOT_ALIGN( entriesat + HISTORY_SIZE * sizeof( struct historyentry ) );
+	checkpointsat = SNAPSHOT_ALIGN( cursorsat + HEARER_CURSORS_MAXCOUNT * sizeof( struct hearercursor ) );
+	end = checkpointsat + count * sizeof( *cps );
+	if ( ( buf = calloc( 1, ( size_t )end ) ) == NULL ){
+		free( cps );
+		errno = ENOMEM;
+		return ( -1 );
+	}
+
+	ssh = ( struct snapshotheader * )buf;
+	ssh->ssh_magic = SNAPSHOT_MAGIC;
+	ssh->ssh_version = SNAPSHOT_VERSION;
+	ssh->ssh_entrysize = ( uint32_t )sizeof( struct historyentry );
+	ssh->ssh_cursorsize = ( uint32_t )sizeof( struct hearercursor );
+	ssh->ssh_checkpointsize = ( uint32_t )sizeof( *cps );
+	ssh->ssh_written = realtime_ns();
+	ssh->ssh_entries = copyfromhistory( hs, 0, ( struct historyentry * )( buf + entriesat ), HISTORY_SIZE );
+	ssh->ssh_entriesat = entriesat;
+	ssh->ssh_cursors = copycursors( cs, ( struct hearercursor * )( buf + cursorsat ) );
+	ssh->ssh_cursorsat = cursorsat;
+	ssh->ssh_checkpoints = count;
+	ssh->ssh_checkpointsat = checkpointsat;
+	if ( count > 0 ){
+		( void )memcpy( buf + checkpointsat, cps, count * sizeof( *cps ) );
+	}
+	free( cps );
+	snapshottwitlog( tl, &tls );
+	ssh->ssh_nextseq = tls.tls_nextseq;
+	// The parts are as long as they can get; the file is cut after the checkpoints
+	ssh->ssh_size = end;
+	ssh->ssh_crc = snapshotcrc( buf, ( size_t )end );
+
+	if ( ( fd = open( newpath, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 ){
+		free( buf );
+		return ( -1 );
+	}
+	if ( writeall( fd, buf, ( size_t )end ) == -1 || fsync( fd ) == -1 ){
+		( void )safe_close( fd );
+		( void )unlink( newpath );
+		free( buf );
+		return ( -1 );
+	}
+	( void )safe_close( fd );
+	free( buf );
+	if ( rename( newpath, path ) == -1 ){
+		( void )unlink( newpath );
+		return ( -1 );
+	}
+	if ( size != NULL ){
+		*size = ( size_t )end;
+	}
+
+	return ( 0 );
+}
+
+// Mapped shared and read only; the parts are used in place
+int loadsnapshot( const char * restrict path, struct snapshot * restrict ss ){
+	const struct snapshotheader *ssh = NULL;
+	struct stat st;
+	void *map = NULL;
+	int fd;
+
+	assert( path != NULL );
+	assert( ss != NULL );
+
+	if ( ( fd = open( path, O_RDONLY ) ) == -1 ){
+		return ( -1 );
+	}
+	if ( fstat( fd, &st ) == -1 ){
+		( void )safe_close( fd );
+		return ( -1 );
+	}
+	if ( ( size_t )st.st_size < sizeof( *ssh ) ){
+		( void )safe_close( fd );
+		errno = EPROTO;
+		return ( -1 );
+	}
+	map = mmap( NULL, ( size_t )st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	( void )safe_close( fd );
+	if ( map == MAP_FAILED ){
+		return ( -1 );
+	}
+	if ( !checksnapshot( map, ( size_t )st.st_size ) ){
+		( void )munmap( map, ( size_t )st.st_size );
+		errno = EPROTO;
+		return ( -1 );
+	}
+
+	ssh = ( const struct snapshotheader * )map;
+	ss->ss_map = map;
+	ss->ss_size = ( size_t )st.st_size;
+	ss->ss_header = ssh;
+	ss->ss_entries = ( const struct historyentry * )( ( const unsigned char * )map + ssh->ssh_entriesat );
+	ss->ss_cursors = ( const struct hearercursor * )( ( const unsigned char * )map + ssh->ssh_cursorsat );
+	ss->ss_checkpoints = ( const struct twitlogcheckpoint * )( ( const unsigned char * )map + ssh->ssh_checkpointsat );
+
+	return ( 0 );
+}
+
+void unloadsnapshot( struct snapshot * restrict ss ){
+	assert( ss != NULL );
+
+	( void )munmap( ss->ss_map, ss->ss_size );
+	ss->ss_map = NULL;
+
+	return ;
+}
+
+// Only a failure after a success, or the first one, is reported; the counters tell the rest
+void *snapshotWriter( void *arg ){
+	struct serverinfo *si = ( struct serverinfo * )arg;
+	struct timespec interval;
+	uint64_t start;
+	size_t size;
+	int failing = 0;
+	int state;
+
+	assert( arg != NULL );
+
+	interval.tv_sec = ( time_t )SNAPSHOT_INTERVAL_SEC;
+	interval.tv_nsec = 0;
+	while ( 1 ){
+		// nanosleep() is where the thread is cancelled
+		( void )nanosleep( &interval, NULL );
+		( void )pthread_setcancelstate( PTHREAD_CANCEL_DISABLE, &state );
+		start = monotonic_ns();
+		if ( writesnapshot( SNAPSHOT_FILE, &si->si_history, &si->si_cursors, si->si_twitlog, &size ) == -1 ){
+			if ( !failing ){
+				error( "Failed to write the snapshot to %s (%s).\n", SNAPSHOT_FILE, strerror( errno ) );
+			}
+			failing = 1;
+			( void )__atomic_fetch_add( &si->si_snapshot_failures, 1, __ATOMIC_RELAXED );
+		}
+		else{
+			failing = 0;
+			__atomic_store_n( &si->si_snapshot_ns, monotonic_ns() - start, __ATOMIC_RELAXED );
+			__atomic_store_n( &si->si_snapshot_bytes, ( uint64_t )size, __ATOMIC_RELAXED );
+			( void )__atomic_fetch_add( &si->si_snapshots, 1, __ATOMIC_RELAXED );
+		}
+		( void )pthread_setcancelstate( state, NULL );
+	}
+
+	// Not Reached
+	return ( NULL );
+}
+
+
+
+// Implementation of local functions...
+
+// The header first, then the checksum, then the order of the entries
+static int checksnapshot( const unsigned char * restrict map, size_t size ){
+	const struct snapshotheader *ssh = ( const struct snapshotheader * )map;
+	const struct historyentry *entries = NULL;
+	const struct twitlogcheckpoint *cps = NULL;
+	uint64_t i;
+
+	assert( map != NULL );
+
+	if ( ssh->ssh_magic != SNAPSHOT_MAGIC || ssh->ssh_version != SNAPSHOT_VERSION || ssh->ssh_size != size ||
+		ssh->ssh_entrysize != sizeof( struct historyentry ) || ssh->ssh_cursorsize != sizeof( struct hearercursor ) ||
+		ssh->ssh_checkpointsize != sizeof( struct twitlogcheckpoint ) ||
+		!checkpart( ssh->ssh_entriesat, ssh->ssh_entries, sizeof( struct historyentry ), size ) ||
+		!checkpart( ssh->ssh_cursorsat, ssh->ssh_cursors, sizeof( struct hearercursor ), size ) ||
+		!checkpart( ssh->ssh_checkpointsat, ssh->ssh_checkpoints, sizeof( struct twitlogcheckpoint ), size ) ||
+		snapshotcrc( map, size ) != ssh->ssh_crc ){
+		return ( 0 );
+	}
+	entries = ( const struct historyentry * )( map + ssh->ssh_entriesat );
+	for ( i = 0; i < ssh->ssh_entries; ++i ){
+		if ( entries[ i ].he_twitlen > TWIT_MAXLEN || entries[ i ].he_seq >= ssh->ssh_nextseq || ( i > 0 && entries[ i ].he_seq <= entries[ i - 1 ].he_seq ) ){
+			return ( 0 );
+		}
+	}
+	cps = ( const struct twitlogcheckpoint * )( map + ssh->ssh_checkpointsat );
+	for ( i = 1; i < ssh->ssh_checkpoints; ++i ){
+		if ( cps[ i ].tlcp_firstseq <= cps[ i - 1 ].tlcp_firstseq ){
+			return ( 0 );
+		}
+	}
+
+	return ( 1 );
+}
+
+static int checkpart( uint64_t at, uint64_t count, size_t elementsize, size_t size ){
+	return ( at % 8 == 0 && at >= sizeof( struct snapshotheader ) && at <= size && count <= ( size - at ) / elementsize );
+}
+
+static uint32_t snapshotcrc( const unsigned char * restrict map, size_t size ){
+	static const unsigned char zero[ sizeof( uint32_t ) ] = { 0 };
+	size_t at = offsetof( struct snapshotheader, ssh_crc );
+	uint32_t crc;
+
+	crc = crc32c( 0, map, at );
+	crc = crc32c( crc, zero, sizeof( zero ) );
+
+	return ( crc32c( crc, map + at + sizeof( zero ), size - at - sizeof( zero ) ) );
+}
@@ -0,0 +1,145 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file snapshot.h
+ *
+ * File snapshot.h declares the snapshot: a file with the recent history, the sequence number the next twit gets, the cursors of
+ * the hearers and checkpoints of the older segments of the twit log, from which the server starts again without reading the
+ * recent history back from the twit log or checking the segments that did not change.
+ *
+ * A background thread writes it every SNAPSHOT_INTERVAL_SEC seconds and the server writes it once more when it terminates. It is
+ * written to a file next to it first, synced and renamed over it, so it is whole or not there. Each part is an array of the
+ * structures the server keeps in memory, laid out as they are, so a server starting again maps the file, checks it and copies
+ * the recent history into its ring with a memcpy(). The file starts with a struct snapshotheader, followed by:
+ *	ssh_entries struct historyentry at offset ssh_entriesat, oldest first
+ *	ssh_cursors struct hearercursor at offset ssh_cursorsat
+ *	ssh_checkpoints struct twitlogcheckpoint at offset ssh_checkpointsat, sorted by tlcp_firstseq
+ * A snapshot written by a server compiled with other sizes, or on another kind of machine, is not taken; neither is one whose
+ * checksum does not match. The server then starts from the twit log alone.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( SNAPSHOT_H_IS_INCLUDED )
+#define SNAPSHOT_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cursors.h"
+#include "history.h"
+#include "twitlog.h"
+
+#define SNAPSHOT_MAGIC (0x4e535754u) /* "TWSN" */
+
+#define SNAPSHOT_VERSION (1)
+
+/**
+ * \struct snapshotheader
+ *
+ * The snapshotheader structure starts the snapshot.
+ */
+struct snapshotheader{
+	uint32_t ssh_magic;
+	uint32_t ssh_version;
+	uint32_t ssh_crc; /**< CRC-32C of the whole file with this member zero */
+	uint32_t ssh_entrysize; /**< sizeof( struct historyentry ) */
+	uint32_t ssh_cursorsize; /**< sizeof( struct hearercursor ) */
+	uint32_t ssh_checkpointsize; /**< sizeof( struct twitlogcheckpoint ) */
+	uint64_t ssh_size; /**< Bytes of the file */
+	uint64_t ssh_written; /**< When it was written, in nanoseconds since the Epoch */
+	uint64_t ssh_nextseq; /**< Sequence number the next twit got; larger than those of the entries and the cursors */
+	uint64_t ssh_entries;
+	uint64_t ssh_entriesat;
+	uint64_t ssh_cursors;
+	uint64_t ssh_cursorsat;
+	uint64_t ssh_checkpoints;
+	uint64_t ssh_checkpointsat;
+};
+
+/**
+ * \struct snapshot
+ *
+ * The snapshot structure is a snapshot mapped by loadsnapshot(). The parts point into the map.
+ */
+struct snapshot{
+	void *ss_map;
+	size_t ss_size;
+	const struct snapshotheader *ss_header;
+	const struct historyentry *ss_entries;
+	const struct hearercursor *ss_cursors;
+	const struct twitlogcheckpoint *ss_checkpoints;
+};
+
+// Declared in serverinfo.h
+struct serverinfo;
+
+
+
+/**
+ * The writesnapshot() function shall write to the file pointed to by parameter path the snapshot of the recent history pointed to
+ * by parameter hs, of the cursors pointed to by parameter cs and of the twit log pointed to by parameter tl, and store its size in
+ * the object pointed to by parameter size if that is not a NULL pointer. The file is replaced once the new one is synced.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * Any error of checkpointtwitlog(), open(), write(), fsync() or rename().
+ */
+int writesnapshot( const char * restrict path, struct history * restrict hs, struct cursors * restrict cs, struct twitlog * restrict tl,
+	size_t * restrict size );
+
+/**
+ * The loadsnapshot() function shall map the snapshot in the file pointed to by parameter path, check it and set the object pointed
+ * to by parameter ss to it. The entries are checked to be in the order of their sequence numbers, below ssh_nextseq, and not longer
+ * than TWIT_MAXLEN. The snapshot shall be released with unloadsnapshot().
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EPROTO The file is not a snapshot this server can take.
+ * Any error of open() or mmap().
+ */
+int loadsnapshot( const char * restrict path, struct snapshot * restrict ss );
+
+/**
+ * The unloadsnapshot() function shall release the snapshot pointed to by parameter ss.
+ *
+ * @return Nothing.
+ */
+void unloadsnapshot( struct snapshot * restrict ss );
+
+/**
+ * snapshotWriter() runs on its own thread and writes the snapshot of the server whose struct serverinfo is pointed to by parameter
+ * arg to SNAPSHOT_FILE every SNAPSHOT_INTERVAL_SEC seconds, until it is cancelled. It is not cancelled in the middle of a snapshot.
+ */
+void *snapshotWriter( void *arg );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
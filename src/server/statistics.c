@@ -31,11 +31,77 @@
  *
  * @author Tassos Souris
  */
+// struct tcp_info is not part of POSIX
+#define _DEFAULT_SOURCE 1
+
 #include <unistd.h>
 #include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include "serverinfo.h"
 #include "statistics.h"
+#include "statspage.h"
+#include "histogram.h"
+#include "timing.h"
+#include "trace.h"
 #include "config.h"
+#include "error.h"
+
+
+
+/**
+ * The windowrate() function shall return the average of the most recent samples stored in the struct ratewindow object pointed to
+ * by parameter rw that cover the last nsec seconds. If fewer samples are available the average of those shall be returned.
+ *
+ * @return The average rate over the window.
+ */
+static float windowrate( const struct ratewindow * restrict rw, int nsec );
+
+/**
+ * The percentile() function shall return the q-th percentile (0 < q <= 100) of the n values, sorted in ascending order, in the array
+ * pointed to by parameter sorted, using the nearest-rank method.
+ *
+ * @return The percentile.
+ */
+static float percentile( const float * restrict sorted, int n, int q );
+
+/**
+ * The collecthearerlag() function shall sample the lag of each hearer in the twitpool list of the serverinfo structure pointed to
+ * by parameter si and store it in the array of HEARERS_MAXCOUNT struct hearerlag objects pointed to by parameter lag, the hearer
+ * furthest behind first. The caller shall not own the twitpool list.
+ *
+ * @return The number of hearers stored in the array.
+ */
+static int collecthearerlag( struct serverinfo * restrict si, struct hearerlag * restrict lag );
+
+/**
+ * The sampletcpinfo() function shall store in the struct hearerlag object pointed to by parameter hl the state of the TCP connection
+ * at the socket given as parameter. Where TCP_INFO is not supported, or the socket is not connected, the state is all zeros.
+ *
+ * @return Nothing.
+ */
+static void sampletcpinfo( int sockfd, struct hearerlag * restrict hl );
+
+/**
+ * The comparehearerlag() function shall compare the two struct hearerlag objects pointed to by parameters a and b so as the hearer
+ * furthest behind comes first: the one with the oldest twit waiting, then the one with the most bytes waiting. It is used with qsort().
+ *
+ * @return Refer to the qsort() function.
+ */
+static int comparehearerlag( const void *a, const void *b );
+
+/**
+ * The fillstatspage() function shall store in the struct statspage_data object pointed to by parameter data everything published
+ * in the statistics page except the statistics, as found in the serverinfo structure pointed to by parameter si.
+ *
+ * @return Nothing.
+ */
+static void fillstatspage( struct serverinfo * restrict si, struct statspage_data * restrict data );
 
 
 
@@ -46,14 +112,26 @@
  * when sayersListener() accepts a new connection from a sayer the member stats_sayersNum is increased
  * by one by sayersListener(). 
  * The only members that cannot be changed by the other threads and *must* be updated every some time unit
- * are stats_averageTwitsIncomingRate and stats_averageTwitsOutcomingRate. The time unit is obtained
- * from config.h (STATS_UPDATE_NSEC). The statisticsUpdater() function updates those two fields every
- * STATS_UPDATE_NSEC seconds.
+ * are stats_incomingRate and stats_outcomingRate. The time unit is obtained from config.h (STATS_UPDATE_NSEC).
+ * Every STATS_UPDATE_NSEC seconds the statisticsUpdater() function samples the total number of twits arrived and delivered
+ * and stores the difference from the previous sample, turned into a per-second rate, in the ring of each struct ratewindow.
+ * It also samples the lag of each hearer (see struct hearerlag); the twitpool list is walked before the statistics are locked so
+ * as no thread ever waits for the twitpool list while owning the statistics.
+ * Having done that it publishes a copy of the statistics for the readers that must not lock (see snapshot_statistics()) and,
+ * together with the latency histograms and the lag of each hearer, in the statistics page read by other processes (see statspage.h).
+ * Last, when some twit took longer than TRACE_ANOMALY_MSEC milliseconds to go through the server (see traceanomaly()) it also writes
+ * the traced events to a file, at most once every TRACE_ANOMALY_INTERVAL_NSEC seconds.
+ * The thread sleeps until an absolute deadline on the monotonic clock so as the time it spends updating the statistics
+ * (or waiting for the lock) does not make the samples drift.
  */
 void *statisticsUpdater( void *arg ){
 	struct serverinfo *si = ( struct serverinfo * )arg;
-	float averageTwitsIncomingRate = 0.0;
-	float averageTwitsOutcomingRate = 0.0;
+	struct hearerlag lag[ HEARERS_MAXCOUNT ];
+	struct statspage_data data;
+	struct timespec deadline;
+	char tracepath[ 256 ];
+	uint64_t lasttrace = 0;
+	int lagNum;
 
 	assert( si != NULL );
 
@@ -61,17 +139,254 @@ void *statisticsUpdater( void *arg ){
 	signal_prepared_status( si, 1 );
 
 	// Every STATS_UPDATE_NSEC seconds 
+	while ( clock_gettime( CLOCK_MONOTONIC, &deadline ) == -1 ){ continue; }
 	while ( 1 ){
-		sleep( STATS_UPDATE_NSEC );
+		deadline.tv_sec += STATS_UPDATE_NSEC;
+		while ( ( errno = clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL ) ) == EINTR ){ continue; }
+		lagNum = collecthearerlag( si, lag );
 		// Update the statistics structure
 		acquire_statistics( si );
-		averageTwitsIncomingRate = si->si_stats.stats_averageTwitsIncomingRate = 
-			( averageTwitsIncomingRate + si->si_stats.stats_arrivedTwitsNum ) / 2;
-		averageTwitsOutcomingRate = si->si_stats.stats_averageTwitsOutcomingRate = 
-			( averageTwitsOutcomingRate + si->si_stats.stats_deliveredTwitsNum ) / 2;
+		si->si_stats.stats_hearerLagNum = lagNum;
+		( void )memcpy( si->si_stats.stats_hearerLag, lag, lagNum * sizeof( lag[ 0 ] ) );
+		updateratewindow( &si->si_stats.stats_incomingRate, si->si_stats.stats_arrivedTwitsNum );
+		updateratewindow( &si->si_stats.stats_outcomingRate, si->si_stats.stats_deliveredTwitsNum );
+		acquire_twitpool( si );
+		si->si_stats.stats_storedTwitsNum = twitpoolcount( &si->si_twitpool );
+		release_twitpool( si );
+		// Let the readers that must not lock see the new statistics
+		publish_statistics( si );
+		data.spd_stats = si->si_stats;
 		release_statistics( si );
+		// Same for the other processes
+		if ( si->si_statspage != NULL ){
+			fillstatspage( si, &data );
+			publishstatspage( si->si_statspage, &data );
+		}
+		// Some twit was too slow; keep the events that explain it, unless that was just done
+		if ( takeanomaly() && ( lasttrace == 0 || monotonic_ns() - lasttrace >= TRACE_ANOMALY_INTERVAL_NSEC * 1000000000ull ) ){
+			lasttrace = monotonic_ns();
+			if ( flushtrace( tracepath, sizeof( tracepath ) ) == -1 ){
+				error( "Failed to write the traced events to %s: %s\n", tracepath, strerror( errno ) );
+			}
+			else{
+				error( "A twit took longer than %d msec; the traced events were written to %s\n", TRACE_ANOMALY_MSEC, tracepath );
+			}
+		}
 	}
 
 	pthread_exit( NULL );
 }
 
+// Forget any samples
+void initratewindow( struct ratewindow * restrict rw ){
+	assert( rw != NULL );
+
+	( void )memset( rw, 0, sizeof( *rw ) );
+
+	return ;
+}
+
+// Store a new sample and recompute everything derived from the samples
+void updateratewindow( struct ratewindow * restrict rw, uint64_t counter ){
+	float sorted[ RATE_SAMPLES_MAX ];
+	float sample;
+	int i, j;
+
+	assert( rw != NULL );
+
+	// The counters are totals so the rate is the difference from the previous sample. Unsigned
+	// subtraction keeps the difference right even if a counter ever wraps around
+	sample = ( float )( counter - rw->rw_lastcounter ) / STATS_UPDATE_NSEC;
+	rw->rw_lastcounter = counter;
+
+	// Store the sample in the ring overwriting the oldest one
+	rw->rw_samples[ rw->rw_next ] = sample;
+	rw->rw_next = ( rw->rw_next + 1 ) % RATE_SAMPLES_MAX;
+	if ( rw->rw_count < RATE_SAMPLES_MAX ){
+		++rw->rw_count;
+	}
+
+	// Windowed rates
+	rw->rw_rate1s = windowrate( rw, 1 );
+	rw->rw_rate10s = windowrate( rw, 10 );
+	rw->rw_rate60s = windowrate( rw, 60 );
+
+	// Percentiles of the per-second rates. The ring is small so an insertion sort is fine here
+	for ( i = 0; i < rw->rw_count; ++i ){
+		for ( j = i; j > 0 && sorted[ j - 1 ] > rw->rw_samples[ i ]; --j ){
+			sorted[ j ] = sorted[ j - 1 ];
+		}
+		sorted[ j ] = rw->rw_samples[ i ];
+	}
+	rw->rw_p50 = percentile( sorted, rw->rw_count, 50 );
+	rw->rw_p90 = percentile( sorted, rw->rw_count, 90 );
+	rw->rw_p99 = percentile( sorted, rw->rw_count, 99 );
+
+	// Peak second
+	if ( sample > rw->rw_peak ){
+		rw->rw_peak = sample;
+		rw->rw_peaktime = time( NULL );
+	}
+
+	return ;
+}
+
+
+
+// Implementation of local functions...
+
+// Average of the samples covering the last nsec seconds
+static float windowrate( const struct ratewindow * restrict rw, int nsec ){
+	float sum = 0.0;
+	int n;
+	int i;
+
+	assert( rw != NULL );
+	assert( nsec > 0 );
+
+	// How many samples cover the window. At least one sample is needed even if nsec < STATS_UPDATE_NSEC
+	n = nsec / STATS_UPDATE_NSEC;
+	if ( n < 1 ){
+		n = 1;
+	}
+	if ( n > rw->rw_count ){
+		n = rw->rw_count;
+	}
+	if ( n == 0 ){
+		return ( 0.0 );
+	}
+
+	// Walk the ring backwards starting from the most recent sample
+	for ( i = 1; i <= n; ++i ){
+		sum += rw->rw_samples[ ( rw->rw_next - i + RATE_SAMPLES_MAX ) % RATE_SAMPLES_MAX ];
+	}
+
+	return ( sum / n );
+}
+
+// Nearest-rank percentile
+static float percentile( const float * restrict sorted, int n, int q ){
+	int rank;
+
+	assert( sorted != NULL );
+	assert( q > 0 && q <= 100 );
+
+	if ( n == 0 ){
+		return ( 0.0 );
+	}
+
+	// rank = ceil( q / 100 * n )
+	rank = ( q * n + 99 ) / 100;
+
+	return ( sorted[ rank - 1 ] );
+}
+
+// Walk the twitpool list and sample each hearer
+static int collecthearerlag( struct serverinfo * restrict si, struct hearerlag * restrict lag ){
+	struct twitpoollist_node *tpln = NULL;
+	struct hearertelemetry *ht = NULL;
+	struct hearerlag *hl = NULL;
+	const struct twitpool_node *oldest = NULL;
+	uint64_t now;
+	uint64_t sendBlocked_ns;
+	int n = 0;
+
+	assert( si != NULL );
+	assert( lag != NULL );
+
+	acquire_twitpool_list( si );
+	now = monotonic_ns();
+	for ( tpln = si->si_twitpool_list.tpl_head; tpln != NULL && n < HEARERS_MAXCOUNT; tpln = tpln->tpln_next ){
+		hl = &lag[ n++ ];
+		ht = &tpln->tpln_telemetry;
+		hl->hl_id = tpln->tpln_id;
+
+		// What is waiting; the oldest twit is at the head
+		acquire_twitpool_in_twitpoollist_node( tpln );
+		hl->hl_queued = tpln->tpln_twitpool.tp_count;
+		hl->hl_bytesQueued = ht->ht_bytesQueued;
+		hl->hl_oldest_ns = 0;
+		oldest = tpln->tpln_twitpool.tp_head;
+		if ( oldest != NULL && oldest->tpn_twit.t_enqueued != 0 && oldest->tpn_twit.t_enqueued < now ){
+			hl->hl_oldest_ns = now - oldest->tpn_twit.t_enqueued;
+		}
+		release_twitpool_in_twitpoollist_node( tpln );
+
+		// The counters are totals so the rates are the difference from the previous sample
+		hl->hl_delivered = __atomic_load_n( &ht->ht_delivered, __ATOMIC_RELAXED );
+		sendBlocked_ns = __atomic_load_n( &ht->ht_sendBlocked_ns, __ATOMIC_RELAXED );
+		hl->hl_deliveredRate = ( float )( hl->hl_delivered - ht->ht_lastDelivered ) / STATS_UPDATE_NSEC;
+		hl->hl_sendBlocked = ( float )( sendBlocked_ns - ht->ht_lastSendBlocked_ns ) / ( STATS_UPDATE_NSEC * 1000000000.0 );
+		ht->ht_lastDelivered = hl->hl_delivered;
+		ht->ht_lastSendBlocked_ns = sendBlocked_ns;
+
+		// The socket stays open as long as the twitpool is in the list
+		sampletcpinfo( tpln->tpln_sockfd, hl );
+	}
+	release_twitpool_list( si );
+
+	qsort( lag, n, sizeof( lag[ 0 ] ), comparehearerlag );
+
+	return ( n );
+}
+
+// Ask the kernel
+static void sampletcpinfo( int sockfd, struct hearerlag * restrict hl ){
+#if defined( TCP_INFO )
+	struct tcp_info info;
+	socklen_t infolen = sizeof( info );
+#endif
+
+	assert( hl != NULL );
+
+	hl->hl_retransmits = 0;
+	hl->hl_sndCwnd = 0;
+	hl->hl_unacked = 0;
+	hl->hl_rtt_us = 0;
+
+#if defined( TCP_INFO )
+	if ( sockfd != -1 && getsockopt( sockfd, IPPROTO_TCP, TCP_INFO, &info, &infolen ) == 0 ){
+		hl->hl_retransmits = info.tcpi_total_retrans;
+		hl->hl_sndCwnd = info.tcpi_snd_cwnd;
+		hl->hl_unacked = info.tcpi_unacked;
+		hl->hl_rtt_us = info.tcpi_rtt;
+	}
+#else
+	( void )sockfd;
+#endif
+
+	return ;
+}
+
+// Furthest behind first
+static int comparehearerlag( const void *a, const void *b ){
+	const struct hearerlag *la = ( const struct hearerlag * )a;
+	const struct hearerlag *lb = ( const struct hearerlag * )b;
+
+	if ( la->hl_oldest_ns != lb->hl_oldest_ns ){
+		return ( la->hl_oldest_ns < lb->hl_oldest_ns ? 1 : -1 );
+	}
+	if ( la->hl_bytesQueued != lb->hl_bytesQueued ){
+		return ( la->hl_bytesQueued < lb->hl_bytesQueued ? 1 : -1 );
+	}
+
+	return ( 0 );
+}
+
+// Histograms
+static void fillstatspage( struct serverinfo * restrict si, struct statspage_data * restrict data ){
+	int stage;
+
+	assert( si != NULL );
+	assert( data != NULL );
+
+	for ( stage = 0; stage < LATENCY_STAGES; ++stage ){
+		snapshothistogram( &si->si_latency[ stage ], &data->spd_latency[ stage ] );
+		( void )strncpy( data->spd_stagename[ stage ], latencystagename( stage ), STATSPAGE_STAGENAME_MAXLEN - 1 );
+		data->spd_stagename[ stage ][ STATSPAGE_STAGENAME_MAXLEN - 1 ] = '\0';
+	}
+
+	data->spd_updated_ns = monotonic_ns();
+
+	return ;
+}
@@ -40,12 +40,18 @@ extern "C"{
 
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include "config.h"
 
 #define THREADS_MAX INT_MAX
 #define HEARERS_MAX INT_MAX
 #define SAYERS_MAX INT_MAX
-#define ARRIVED_TWITS_MAX INT_MAX
-#define DELIVERED_TWITS_MAX INT_MAX
+#define ARRIVED_TWITS_MAX UINT64_MAX
+#define DELIVERED_TWITS_MAX UINT64_MAX
+
+// Number of samples kept in a struct ratewindow; one sample every STATS_UPDATE_NSEC seconds
+#define RATE_SAMPLES_MAX ( STATS_RATE_WINDOW_NSEC / STATS_UPDATE_NSEC )
 
 #define increaseTwitsStored( stats )
 #define increaseThreadsNum( st ) do{ \
@@ -94,6 +100,46 @@ extern "C"{
 	}	\
 }while ( 0 )
 
+/**
+ * \struct ratewindow
+ *
+ * The ratewindow structure keeps the per-second rates of a monotonically increasing counter (e.g the number of twits arrived)
+ * in a fixed ring of samples, together with the rates and percentiles derived from those samples.
+ */
+struct ratewindow{
+	float rw_samples[ RATE_SAMPLES_MAX ]; /**< Ring of per-second rates; the most recent one is at rw_next - 1 */
+	int rw_next; /**< Index in rw_samples where the next sample will be stored */
+	int rw_count; /**< Number of valid samples in rw_samples */
+	uint64_t rw_lastcounter; /**< Value of the counter when the last sample was taken */
+	float rw_rate1s; /**< Rate over the last second */
+	float rw_rate10s; /**< Rate over the last 10 seconds */
+	float rw_rate60s; /**< Rate over the last 60 seconds */
+	float rw_p50; /**< Median of the per-second rates in the window */
+	float rw_p90; /**< 90th percentile of the per-second rates in the window */
+	float rw_p99; /**< 99th percentile of the per-second rates in the window */
+	float rw_peak; /**< Highest per-second rate seen in the lifetime of the server */
+	time_t rw_peaktime; /**< Time at which rw_peak was seen */
+};
+
+/**
+ * \struct hearerlag
+ *
+ * The hearerlag structure describes how far behind a hearer is, as sampled by the statistics updater.
+ */
+struct hearerlag{
+	unsigned long hl_id; /**< Identifier of the hearer (tpln_id) */
+	uint64_t hl_queued; /**< Number of twits waiting in the twitpool of the hearer */
+	uint64_t hl_bytesQueued; /**< Number of bytes of the twits waiting */
+	uint64_t hl_oldest_ns; /**< Age of the oldest twit waiting, in nanoseconds; zero if none */
+	uint64_t hl_delivered; /**< Total number of twits delivered to the hearer */
+	float hl_deliveredRate; /**< Twits delivered per sec since the previous sample */
+	float hl_sendBlocked; /**< Fraction of the time since the previous sample spent blocked in send() */
+	uint32_t hl_retransmits; /**< Total number of segments retransmitted to the hearer (TCP_INFO) */
+	uint32_t hl_sndCwnd; /**< Congestion window, in segments (TCP_INFO) */
+	uint32_t hl_unacked; /**< Number of segments sent and not yet acknowledged (TCP_INFO) */
+	uint32_t hl_rtt_us; /**< Smoothed round trip time in microseconds (TCP_INFO) */
+};
+
 /**
  * \struct statistics
  *
@@ -104,12 +150,31 @@ struct statistics{
 	int stats_threadsNum; /**< Number of threads */
 	int stats_hearersNum; /**< Number of hearers connected to the server */
 	int stats_sayersNum;  /**< Number of sayers connected to the server */
-	int stats_arrivedTwitsNum; /**< Total number of twits arrived in the server */ 
-	int stats_deliveredTwitsNum; /**< Total number of twits delivered to the hearers */
-	float stats_averageTwitsIncomingRate; /**< Average incoming rate of twits per sec */
-	float stats_averageTwitsOutcomingRate; /**< Average outcoming rate of twits per sec */
+	uint64_t stats_arrivedTwitsNum; /**< Total number of twits arrived in the server */ 
+	uint64_t stats_deliveredTwitsNum; /**< Total number of twits delivered to the hearers */
+	struct ratewindow stats_incomingRate; /**< Incoming rate of twits per sec */
+	struct ratewindow stats_outcomingRate; /**< Outcoming rate of twits per sec */
+	int stats_hearerLagNum; /**< Number of valid entries in stats_hearerLag */
+	struct hearerlag stats_hearerLag[ HEARERS_MAXCOUNT ]; /**< The lag of each hearer; the one furthest behind first */
 };
 
+/**
+ * The initratewindow() function shall initialize the struct ratewindow object pointed to by parameter rw, which shall not be
+ * a NULL pointer, so as no samples are stored in it.
+ *
+ * @return Nothing.
+ */
+void initratewindow( struct ratewindow * restrict rw );
+
+/**
+ * The updateratewindow() function shall store in the struct ratewindow object pointed to by parameter rw, which shall not be
+ * a NULL pointer, a new sample computed from the current value of the counter given as parameter, and recompute the rates,
+ * percentiles and peak kept in that object. The updateratewindow() function shall be called every STATS_UPDATE_NSEC seconds.
+ *
+ * @return Nothing.
+ */
+void updateratewindow( struct ratewindow * restrict rw, uint64_t counter );
+
 /**
  * The statisticsUpdater() function shall update every STATS_UPDATE_NSEC the statistics structure of the serverinfo structure
  * passed as parameter. The statisticsUpdater() function shall run in its own thread of execution.
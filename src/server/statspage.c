@@ -0,0 +1,165 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file statspage.c
+ *
+ * File statspage.c contains the implementation of the statspage.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "seqlock.h"
+#include "statspage.h"
+
+
+
+// Create, size and map the object and fill in the header
+int createstatspage( struct statspage ** restrict page ){
+	struct statspage *p = NULL;
+	int fd;
+	int errno_saved;
+
+	if ( page == NULL ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+
+	if ( ( fd = shm_open( STATSPAGE_NAME, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH ) ) == -1 ){
+		return ( -1 );
+	}
+	if ( ftruncate( fd, sizeof( struct statspage ) ) == -1 ||
+		( p = mmap( NULL, sizeof( struct statspage ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) ) == MAP_FAILED ){
+		errno_saved = errno;
+		( void )close( fd );
+		( void )shm_unlink( STATSPAGE_NAME );
+		errno = errno_saved;
+		return ( -1 );
+	}
+	// The mapping stays valid after the descriptor is closed
+	( void )close( fd );
+
+	// ftruncate() filled the object with zeros so the sequence is even and the data empty
+	p->sp_version = STATSPAGE_VERSION;
+	p->sp_size = sizeof( struct statspage );
+	// The magic goes last so a reader that sees it sees the rest of the header too
+	__atomic_store_n( &p->sp_magic, STATSPAGE_MAGIC, __ATOMIC_RELEASE );
+
+	*page = p;
+
+	return ( 0 );
+}
+
+// Publish under the seqlock
+void publishstatspage( struct statspage * restrict page, const struct statspage_data * restrict data ){
+	assert( page != NULL );
+	assert( data != NULL );
+
+	seqlock_write( &page->sp_seq, &page->sp_data, data, sizeof( *data ) );
+
+	return ;
+}
+
+// Unmap and unlink
+void removestatspage( struct statspage * restrict page ){
+	assert( page != NULL );
+
+	( void )munmap( page, sizeof( struct statspage ) );
+	( void )shm_unlink( STATSPAGE_NAME );
+
+	return ;
+}
+
+// Map read-only and check the header
+int openstatspage( const struct statspage ** restrict page ){
+	struct statspage *p = NULL;
+	struct stat st;
+	int fd;
+	int errno_saved;
+
+	if ( page == NULL ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+
+	if ( ( fd = shm_open( STATSPAGE_NAME, O_RDONLY, 0 ) ) == -1 ){
+		return ( -1 );
+	}
+	if ( fstat( fd, &st ) == -1 ){
+		errno_saved = errno;
+		( void )close( fd );
+		errno = errno_saved;
+		return ( -1 );
+	}
+	// A server of another version may have a page of another size; do not map past its end
+	if ( st.st_size != sizeof( struct statspage ) ){
+		( void )close( fd );
+		errno = EPROTO;
+		return ( -1 );
+	}
+	if ( ( p = mmap( NULL, sizeof( struct statspage ), PROT_READ, MAP_SHARED, fd, 0 ) ) == MAP_FAILED ){
+		errno_saved = errno;
+		( void )close( fd );
+		errno = errno_saved;
+		return ( -1 );
+	}
+	( void )close( fd );
+
+	if ( __atomic_load_n( &p->sp_magic, __ATOMIC_ACQUIRE ) != STATSPAGE_MAGIC || 
+		p->sp_version != STATSPAGE_VERSION || p->sp_size != sizeof( struct statspage ) ){
+		( void )munmap( p, sizeof( struct statspage ) );
+		errno = EPROTO;
+		return ( -1 );
+	}
+
+	*page = p;
+
+	return ( 0 );
+}
+
+// Copy under the seqlock
+unsigned readstatspage( const struct statspage * restrict page, struct statspage_data * restrict data ){
+	assert( page != NULL );
+	assert( data != NULL );
+
+	return ( seqlock_read( &page->sp_seq, data, &page->sp_data, sizeof( *data ) ) );
+}
+
+// Unmap
+void closestatspage( const struct statspage * restrict page ){
+	assert( page != NULL );
+
+	( void )munmap( ( void * )page, sizeof( struct statspage ) );
+
+	return ;
+}
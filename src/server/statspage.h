@@ -0,0 +1,150 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file statspage.h
+ *
+ * File statspage.h declares the layout of the statistics page and the functions used to publish it and to read it.
+ *
+ * The statistics page is a POSIX shared memory object (named STATSPAGE_NAME) in which the server publishes, every
+ * STATS_UPDATE_NSEC seconds, the statistics (which include the lag of each hearer) and the latency histograms. The data is guarded by a
+ * seqlock (see seqlock.h) so any number of external processes can map the page read-only and poll it as often as they
+ * like; the server never takes a lock or makes a system call on their behalf.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( STATSPAGE_H_IS_INCLUDED )
+#define STATSPAGE_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stdint.h>
+#include "config.h"
+#include "histogram.h"
+#include "serverinfo.h"
+#include "statistics.h"
+
+// Name of the shared memory object
+#define STATSPAGE_NAME "/twitserver.stats"
+
+// First four bytes of the page ("TWST")
+#define STATSPAGE_MAGIC (0x54535754u)
+
+// Changes whenever the layout of the page changes
+#define STATSPAGE_VERSION (3)
+
+// Maximum length of the name of a latency stage, including the terminating null byte
+#define STATSPAGE_STAGENAME_MAXLEN (32)
+
+/**
+ * \struct statspage_data
+ *
+ * The statspage_data structure is the data published in the page; it is the part guarded by the seqlock.
+ */
+struct statspage_data{
+	uint64_t spd_updated_ns; /**< monotonic_ns() at the time the data was published */
+	struct statistics spd_stats;
+	struct histogram spd_latency[ LATENCY_STAGES ];
+	char spd_stagename[ LATENCY_STAGES ][ STATSPAGE_STAGENAME_MAXLEN ];
+};
+
+/**
+ * \struct statspage
+ *
+ * The statspage structure is the layout of the shared memory object. A reader shall check sp_magic, sp_version and sp_size
+ * before it trusts anything else in the page.
+ */
+struct statspage{
+	uint32_t sp_magic;
+	uint32_t sp_version;
+	uint32_t sp_size; /**< sizeof( struct statspage ) of the server */
+	volatile unsigned sp_seq; /**< The seqlock guarding sp_data */
+	struct statspage_data sp_data;
+};
+
+
+
+/**
+ * The createstatspage() function shall create (or truncate, if it already exists) the shared memory object STATSPAGE_NAME,
+ * map it for reading and writing and store a pointer to it in the object pointed to by parameter page.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @param page Pointer to the object to store the pointer to the page in.
+ * @exception EINVAL Parameter page is a NULL pointer.
+ * @exception Any of the errors of the shm_open(), ftruncate() and mmap() functions.
+ */
+int createstatspage( struct statspage ** restrict page );
+
+/**
+ * The publishstatspage() function shall publish the struct statspage_data object pointed to by parameter data in the page
+ * pointed to by parameter page. Only one thread shall publish in a page. No parameter shall be a NULL pointer.
+ *
+ * @return Nothing.
+ */
+void publishstatspage( struct statspage * restrict page, const struct statspage_data * restrict data );
+
+/**
+ * The removestatspage() function shall unmap the page pointed to by parameter page, as created by createstatspage(), and
+ * remove the shared memory object. Readers that have it mapped keep seeing the last data published.
+ *
+ * @return Nothing.
+ */
+void removestatspage( struct statspage * restrict page );
+
+/**
+ * The openstatspage() function shall map read-only the shared memory object STATSPAGE_NAME, as created by a server, and
+ * store a pointer to it in the object pointed to by parameter page.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @param page Pointer to the object to store the pointer to the page in.
+ * @exception EINVAL Parameter page is a NULL pointer.
+ * @exception EPROTO The object is not a statistics page of the same version and size.
+ * @exception Any of the errors of the shm_open(), fstat() and mmap() functions.
+ */
+int openstatspage( const struct statspage ** restrict page );
+
+/**
+ * The readstatspage() function shall store in the object pointed to by parameter data a consistent copy of the data published
+ * in the page pointed to by parameter page. No parameter shall be a NULL pointer.
+ *
+ * @return The sequence the copy corresponds to; it changes every time the data is published.
+ */
+unsigned readstatspage( const struct statspage * restrict page, struct statspage_data * restrict data );
+
+/**
+ * The closestatspage() function shall unmap the page pointed to by parameter page, as opened by openstatspage().
+ *
+ * @return Nothing.
+ */
+void closestatspage( const struct statspage * restrict page );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
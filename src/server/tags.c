@@ -0,0 +1,737 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file tags.c
+ *
+ * File tags.c contains the implementation of the tags.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tags.h"
+#include "topicframe.h"
+#include "crc32c.h"
+
+// The vector code is built with the target attribute of gcc, so the rest of the server needs no flags for it
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define TAGS_X86 1
+#include <immintrin.h>
+#endif
+
+#if 28 + HEARER_TAGS_MAXCOUNT * ( TAG_NAME_MAXLEN + 2 ) > TOPICFRAME_REQUEST_MAXLEN
+#error "The request line of topicframe.h must fit the count of recent twits and HEARER_TAGS_MAXCOUNT tags"
+#endif
+
+#if TWIT_MAXLEN > 255 || TAG_NAME_MAXLEN > 254
+#error "The offsets and the lengths of the tags of a twit must fit in a byte"
+#endif
+
+// Words of the masks of the bytes of a twit, a bit for each byte
+#define TAGS_MASK_WORDS ( ( TWIT_MAXLEN + 63 ) / 64 )
+
+// The longest varint, that of a difference of 64 bits
+#define TAGS_VARINT_MAXLEN (10)
+
+// Bytes the posting list of a tag starts with
+#define TAGS_INITIAL_DELTAS (16)
+
+/**
+ * The isword() function shall check whether the byte given as parameter c can be in the name of a tag.
+ *
+ * @return Nonzero if it can, zero otherwise.
+ */
+static int isword( unsigned char c );
+
+/**
+ * The foldbyte() function shall return the byte given as parameter c in lower case.
+ *
+ * @return The byte.
+ */
+static char foldbyte( char c );
+
+/**
+ * The markscalar() and marksse2() functions shall set, in the masks of TAGS_MASK_WORDS words pointed to by parameters sigils and
+ * words, which are zero, the bits of the bytes of the len bytes pointed to by parameter text that are '#' or '@' and that can be
+ * in the name of a tag, one byte at a time and 16 bytes at a time with SSE2.
+ *
+ * @return Nothing.
+ */
+static void markscalar( const unsigned char * restrict text, size_t len, uint64_t * restrict sigils, uint64_t * restrict words );
+#if defined( TAGS_X86 )
+static void marksse2( const unsigned char * restrict text, size_t len, uint64_t * restrict sigils, uint64_t * restrict words ) __attribute__(( target( "sse2" ) ));
+#endif
+
+/**
+ * The runlength() function shall count the bits set in the mask of TAGS_MASK_WORDS words pointed to by parameter words from the
+ * bit given as parameter at on.
+ *
+ * @return The number of bits set before the first one clear.
+ */
+static size_t runlength( const uint64_t * restrict words, size_t at );
+
+/**
+ * The tagnamelen() function shall find the length of the tag at the start of the string pointed to by parameter names, up to a
+ * space or the end.
+ *
+ * @return The length of the tag, its '#' or '@' included; zero if it is not one.
+ */
+static size_t tagnamelen( const char * restrict names );
+
+/**
+ * The findtag() function shall find the entry of the table of the index pointed to by parameter ti that the tag in lower case of
+ * len bytes pointed to by parameter name and hash given as parameter hash has, or would have.
+ *
+ * @return The index of the entry; it is free if the tag is not in the table.
+ */
+static size_t findtag( const struct tagindex * restrict ti, const char * restrict name, size_t len, uint32_t hash );
+
+/**
+ * The newtag() function shall put the tag in lower case of len bytes pointed to by parameter name, with the hash given as parameter
+ * hash, in the free entry with index slot of the table of the index pointed to by parameter ti, with no twits and no subscribers.
+ *
+ * @return The tag; NULL if there is not enough memory.
+ */
+static struct tag *newtag( struct tagindex * restrict ti, size_t slot, const char * restrict name, size_t len, uint32_t hash );
+
+/**
+ * The releasetag() function shall take the tag pointed to by parameter tg out of the table of the index pointed to by parameter
+ * ti and free it if it has no twits and no subscribers, moving back the entries after it that would no longer be found.
+ *
+ * @return Nothing.
+ */
+static void releasetag( struct tagindex * restrict ti, struct tag * restrict tg );
+
+/**
+ * The addposting() function shall append the twit with the sequence number given as parameter seq, larger than those before, to
+ * the posting list of the tag pointed to by parameter tg in the index pointed to by parameter ti.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ */
+static int addposting( struct tagindex * restrict ti, struct tag * restrict tg, uint64_t seq );
+
+/**
+ * The dropposting() function shall take the oldest twit off the posting list of the tag pointed to by parameter tg in the index
+ * pointed to by parameter ti.
+ *
+ * @return Nothing.
+ */
+static void dropposting( struct tagindex * restrict ti, struct tag * restrict tg );
+
+/**
+ * The lastpostings() function shall store in the array pointed to by parameter seqs, oldest first, the sequence numbers of the
+ * last max twits, at most TAG_RECENT_MAXCOUNT, of the posting list of the tag pointed to by parameter tg.
+ *
+ * @return The number of sequence numbers stored.
+ */
+static size_t lastpostings( const struct tag * restrict tg, uint64_t * restrict seqs, size_t max );
+
+// The code that marks the bytes, for all the sayers
+static enum tagscankind tagscankindinuse = TAGSCAN_SCALAR;
+static void ( *marks )( const unsigned char * restrict text, size_t len, uint64_t * restrict sigils, uint64_t * restrict words ) = &markscalar;
+
+
+
+int settagscankind( enum tagscankind kind ){
+	if ( kind == TAGSCAN_SCALAR ){
+		marks = &markscalar;
+	}
+#if defined( TAGS_X86 )
+	else if ( kind == TAGSCAN_SSE2 && ( __builtin_cpu_init(), __builtin_cpu_supports( "sse2" ) ) ){
+		marks = &marksse2;
+	}
+#endif
+	else{
+		errno = ENOTSUP;
+		return ( -1 );
+	}
+	tagscankindinuse = kind;
+
+	return ( 0 );
+}
+
+enum tagscankind gettagscankind( void ){
+	return ( tagscankindinuse );
+}
+
+// Called by the sayers, so the consumer only looks the hashes up. A tag starts at a '#' or '@' whose bit is set in the mask of the
+// starts, the bytes after neither a word byte nor another '#' or '@' and before a word byte; its name runs to the first bit clear in
+// the mask of the words
+size_t twittags( const char * restrict twit, size_t len, struct twittag * restrict tags ){
+	uint64_t sigils[ TAGS_MASK_WORDS ] = { 0 };
+	uint64_t words[ TAGS_MASK_WORDS ] = { 0 };
+	uint64_t starts;
+	uint64_t before;
+	uint64_t after;
+	char folded[ TAG_NAME_MAXLEN + 1 ];
+	uint32_t hash;
+	size_t count = 0;
+	size_t namelen;
+	size_t at;
+	size_t i;
+	size_t j;
+	size_t k;
+
+	assert( twit != NULL );
+	assert( tags != NULL );
+	assert( len <= TWIT_MAXLEN );
+
+	marks( ( const unsigned char * )twit, len, sigils, words );
+	for ( k = 0; k < TAGS_MASK_WORDS && count < TWIT_TAGS_MAXCOUNT; ++k ){
+		before = ( ( sigils[ k ] | words[ k ] ) << 1 ) | ( k > 0 ? ( sigils[ k - 1 ] | words[ k - 1 ] ) >> 63 : 0 );
+		after = ( words[ k ] >> 1 ) | ( k + 1 < TAGS_MASK_WORDS ? words[ k + 1 ] << 63 : 0 );
+		for ( starts = sigils[ k ] & ~before & after; starts != 0 && count < TWIT_TAGS_MAXCOUNT; starts &= starts - 1 ){
+			at = 64 * k + ( size_t )__builtin_ctzll( starts );
+			if ( ( namelen = runlength( words, at + 1 ) ) > TAG_NAME_MAXLEN ){
+				continue;
+			}
+			for ( i = 0; i <= namelen; ++i ){
+				folded[ i ] = foldbyte( twit[ at + i ] );
+			}
+			hash = crc32c( 0, folded, namelen + 1 );
+			// Found before, in another case maybe
+			for ( j = 0; j < count; ++j ){
+				if ( tags[ j ].tt_hash == hash && tags[ j ].tt_len == namelen + 1 ){
+					for ( i = 0; i <= namelen && foldbyte( twit[ tags[ j ].tt_offset + i ] ) == folded[ i ]; ++i ){
+						continue;
+					}
+					if ( i > namelen ){
+						break;
+					}
+				}
+			}
+			if ( j < count ){
+				continue;
+			}
+			tags[ count ].tt_hash = hash;
+			tags[ count ].tt_offset = ( uint8_t )at;
+			tags[ count ].tt_len = ( uint8_t )( namelen + 1 );
+			++count;
+		}
+	}
+
+	return ( count );
+}
+
+int validtags( const char * restrict names ){
+	size_t len;
+	int count = 0;
+
+	assert( names != NULL );
+
+	while ( *names != '\0' ){
+		if ( ( len = tagnamelen( names ) ) == 0 || ++count > HEARER_TAGS_MAXCOUNT ){
+			return ( 0 );
+		}
+		names += len;
+		// A space is followed by a tag
+		if ( *names == ' ' && *++names == '\0' ){
+			return ( 0 );
+		}
+	}
+
+	return ( count > 0 );
+}
+
+int inittagindex( struct tagindex * restrict ti ){
+	assert( ti != NULL );
+
+	( void )memset( ti, 0, sizeof( *ti ) );
+	if ( ( ti->ti_table = calloc( TAGS_TABLE_SIZE, sizeof( *ti->ti_table ) ) ) == NULL ||
+		( ti->ti_window = calloc( HISTORY_SIZE, sizeof( *ti->ti_window ) ) ) == NULL ){
+		free( ti->ti_table );
+		ti->ti_table = NULL;
+		errno = ENOMEM;
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+void deltagindex( struct tagindex * restrict ti ){
+	struct tag *tg = NULL;
+	size_t index;
+
+	assert( ti != NULL );
+
+	for ( index = 0; ti->ti_table != NULL && index < TAGS_TABLE_SIZE; ++index ){
+		if ( ( tg = ti->ti_table[ index ] ) != NULL ){
+			delbitmap( &tg->tg_hearers );
+			free( tg->tg_deltas );
+			free( tg );
+		}
+	}
+	free( ti->ti_table );
+	free( ti->ti_window );
+	ti->ti_table = NULL;
+	ti->ti_window = NULL;
+	ti->ti_count = 0;
+	ti->ti_postings = 0;
+	ti->ti_bytes = 0;
+
+	return ;
+}
+
+// The twit that falls out is the oldest in the lists of its tags, so it is at their front
+int indextwit( struct tagindex * restrict ti, uint64_t seq, const char * restrict twit, const struct twittag * restrict tags, size_t count,
+	struct bitmap * restrict matched ){
+	struct tagwindowslot *tws = NULL;
+	struct tag *tg = NULL;
+	char folded[ TAG_NAME_MAXLEN + 1 ];
+	size_t slot;
+	size_t i;
+	size_t j;
+	int found = 0;
+	int status = 0;
+
+	assert( ti != NULL );
+	assert( twit != NULL );
+	assert( tags != NULL || count == 0 );
+	assert( count <= TWIT_TAGS_MAXCOUNT );
+
+	tws = &ti->ti_window[ ti->ti_indexed % HISTORY_SIZE ];
+	for ( i = 0; i < tws->tws_count; ++i ){
+		dropposting( ti, tws->tws_tags[ i ] );
+		releasetag( ti, tws->tws_tags[ i ] );
+	}
+	tws->tws_count = 0;
+	++ti->ti_indexed;
+
+	for ( i = 0; i < count; ++i ){
+		for ( j = 0; j < tags[ i ].tt_len; ++j ){
+			folded[ j ] = foldbyte( twit[ tags[ i ].tt_offset + j ] );
+		}
+		slot = findtag( ti, folded, tags[ i ].tt_len, tags[ i ].tt_hash );
+		if ( ( tg = ti->ti_table[ slot ] ) == NULL && ( tg = newtag( ti, slot, folded, tags[ i ].tt_len, tags[ i ].tt_hash ) ) == NULL ){
+			( void )__atomic_fetch_add( &ti->ti_leftout, 1, __ATOMIC_RELAXED );
+			status = -1;
+			continue;
+		}
+		if ( addposting( ti, tg, seq ) == -1 ){
+			releasetag( ti, tg );
+			( void )__atomic_fetch_add( &ti->ti_leftout, 1, __ATOMIC_RELAXED );
+			status = -1;
+			continue;
+		}
+		tws->tws_tags[ tws->tws_count++ ] = tg;
+		if ( tg->tg_subscribers > 0 ){
+			assert( matched != NULL );
+			++found;
+			if ( orbitmap( matched, &tg->tg_hearers ) == -1 ){
+				status = -1;
+			}
+		}
+	}
+	if ( status == -1 ){
+		errno = ENOMEM;
+		return ( -1 );
+	}
+
+	return ( found );
+}
+
+// A tag is found as the sayers find them, in lower case, so it may be in the table already for the twits that have it
+int subscribetags( struct tagindex * restrict ti, struct tagsubscriber * restrict tgs, struct twitpoollist_node * restrict tpln,
+	const char * restrict names ){
+	struct tag *tg = NULL;
+	char folded[ TAG_NAME_MAXLEN + 1 ];
+	uint32_t hash;
+	size_t len;
+	size_t slot;
+	size_t i;
+	int j;
+
+	assert( ti != NULL );
+	assert( tgs != NULL );
+	assert( tpln != NULL );
+	assert( names != NULL );
+
+	if ( !validtags( names ) ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	tgs->tgs_tpln = tpln;
+	tgs->tgs_count = 0;
+	for ( ; *names != '\0'; names += len + ( names[ len ] == ' ' ) ){
+		len = tagnamelen( names );
+		for ( i = 0; i < len; ++i ){
+			folded[ i ] = foldbyte( names[ i ] );
+		}
+		hash = crc32c( 0, folded, len );
+		slot = findtag( ti, folded, len, hash );
+		if ( ( tg = ti->ti_table[ slot ] ) == NULL && ( tg = newtag( ti, slot, folded, len, hash ) ) == NULL ){
+			unsubscribetags( ti, tgs );
+			errno = ENOMEM;
+			return ( -1 );
+		}
+		for ( j = 0; j < tgs->tgs_count && tgs->tgs_tags[ j ] != tg; ++j ){
+			continue;
+		}
+		if ( j < tgs->tgs_count ){
+			continue;
+		}
+		if ( addtobitmap( &tg->tg_hearers, tpln->tpln_hearer ) == -1 ){
+			releasetag( ti, tg );
+			unsubscribetags( ti, tgs );
+			errno = ENOMEM;
+			return ( -1 );
+		}
+		++tg->tg_subscribers;
+		tgs->tgs_tags[ tgs->tgs_count++ ] = tg;
+	}
+
+	return ( tgs->tgs_count );
+}
+
+// The bitmap of a tag frees its storage with the last subscriber
+void unsubscribetags( struct tagindex * restrict ti, struct tagsubscriber * restrict tgs ){
+	struct tag *tg = NULL;
+	int i;
+
+	assert( ti != NULL );
+	assert( tgs != NULL );
+
+	for ( i = 0; i < tgs->tgs_count; ++i ){
+		tg = tgs->tgs_tags[ i ];
+		removefrombitmap( &tg->tg_hearers, tgs->tgs_tpln->tpln_hearer );
+		assert( tg->tg_subscribers > 0 );
+		--tg->tg_subscribers;
+		releasetag( ti, tg );
+	}
+	tgs->tgs_count = 0;
+
+	return ;
+}
+
+// The last twits of each tag are merged from the newest back, a twit with several of the tags taken once
+size_t recenttagged( const struct tagindex * restrict ti, const struct tagsubscriber * restrict tgs, uint64_t * restrict seqs, size_t max ){
+	uint64_t lists[ HEARER_TAGS_MAXCOUNT ][ TAG_RECENT_MAXCOUNT ];
+	size_t left[ HEARER_TAGS_MAXCOUNT ];
+	uint64_t newest;
+	size_t count = 0;
+	int i;
+	int best;
+
+	assert( ti != NULL );
+	assert( tgs != NULL );
+	assert( seqs != NULL || max == 0 );
+
+	if ( max > TAG_RECENT_MAXCOUNT ){
+		max = TAG_RECENT_MAXCOUNT;
+	}
+	for ( i = 0; i < tgs->tgs_count; ++i ){
+		left[ i ] = lastpostings( tgs->tgs_tags[ i ], lists[ i ], max );
+	}
+	while ( count < max ){
+		for ( best = -1, newest = 0, i = 0; i < tgs->tgs_count; ++i ){
+			if ( left[ i ] > 0 && lists[ i ][ left[ i ] - 1 ] >= newest ){
+				newest = lists[ i ][ left[ i ] - 1 ];
+				best = i;
+			}
+		}
+		if ( best == -1 ){
+			break;
+		}
+		for ( i = 0; i < tgs->tgs_count; ++i ){
+			if ( left[ i ] > 0 && lists[ i ][ left[ i ] - 1 ] == newest ){
+				--left[ i ];
+			}
+		}
+		seqs[ max - ++count ] = newest;
+	}
+	( void )memmove( seqs, seqs + max - count, count * sizeof( *seqs ) );
+
+	return ( count );
+}
+
+
+
+// Implementation of local functions...
+
+static int isword( unsigned char c ){
+	return ( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) || c == '_' );
+}
+
+static char foldbyte( char c ){
+	return ( ( c >= 'A' && c <= 'Z' ) ? ( char )( c - 'A' + 'a' ) : c );
+}
+
+static void markscalar( const unsigned char * restrict text, size_t len, uint64_t * restrict sigils, uint64_t * restrict words ){
+	size_t i;
+
+	for ( i = 0; i < len; ++i ){
+		if ( text[ i ] == '#' || text[ i ] == '@' ){
+			sigils[ i / 64 ] |= ( uint64_t )1 << ( i % 64 );
+		}
+		else if ( isword( text[ i ] ) ){
+			words[ i / 64 ] |= ( uint64_t )1 << ( i % 64 );
+		}
+	}
+
+	return ;
+}
+
+#if defined( TAGS_X86 )
+// The comparisons are signed, so the bytes from 0x80 on are below every range. A letter is in a-z once 0x20 is set in it, which
+// takes no other byte there; the last vector comes from a copy padded with zeros, which are in no range
+static void marksse2( const unsigned char * restrict text, size_t len, uint64_t * restrict sigils, uint64_t * restrict words ){
+	const __m128i hash = _mm_set1_epi8( '#' );
+	const __m128i at = _mm_set1_epi8( '@' );
+	const __m128i lowercase = _mm_set1_epi8( 0x20 );
+	const __m128i beforea = _mm_set1_epi8( 'a' - 1 );
+	const __m128i afterz = _mm_set1_epi8( 'z' + 1 );
+	const __m128i before0 = _mm_set1_epi8( '0' - 1 );
+	const __m128i after9 = _mm_set1_epi8( '9' + 1 );
+	const __m128i underscore = _mm_set1_epi8( '_' );
+	unsigned char last[ 16 ];
+	__m128i v;
+	__m128i folded;
+	__m128i word;
+	size_t i;
+
+	for ( i = 0; i < len; i += 16 ){
+		if ( len - i >= 16 ){
+			v = _mm_loadu_si128( ( const __m128i * )( text + i ) );
+		}
+		else{
+			( void )memset( last, 0, sizeof( last ) );
+			( void )memcpy( last, text + i, len - i );
+			v = _mm_loadu_si128( ( const __m128i * )last );
+		}
+		folded = _mm_or_si128( v, lowercase );
+		word = _mm_or_si128( _mm_and_si128( _mm_cmpgt_epi8( folded, beforea ), _mm_cmpgt_epi8( afterz, folded ) ),
+			_mm_or_si128( _mm_and_si128( _mm_cmpgt_epi8( v, before0 ), _mm_cmpgt_epi8( after9, v ) ), _mm_cmpeq_epi8( v, underscore ) ) );
+		// Sixteen bits never straddle two words, i being a multiple of 16
+		sigils[ i / 64 ] |= ( uint64_t )( unsigned )_mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, hash ), _mm_cmpeq_epi8( v, at ) ) ) << ( i % 64 );
+		words[ i / 64 ] |= ( uint64_t )( unsigned )_mm_movemask_epi8( word ) << ( i % 64 );
+	}
+
+	return ;
+}
+#endif
+
+// The bits after the twit are clear, so the run ends within the masks
+static size_t runlength( const uint64_t * restrict words, size_t at ){
+	uint64_t rest;
+	size_t count = 0;
+
+	while ( at < 64 * TAGS_MASK_WORDS ){
+		if ( ( rest = ~words[ at / 64 ] >> ( at % 64 ) ) != 0 ){
+			return ( count + ( size_t )__builtin_ctzll( rest ) );
+		}
+		count += 64 - at % 64;
+		at += 64 - at % 64;
+	}
+
+	return ( count );
+}
+
+static size_t tagnamelen( const char * restrict names ){
+	size_t len;
+
+	if ( names[ 0 ] != '#' && names[ 0 ] != '@' ){
+		return ( 0 );
+	}
+	for ( len = 1; isword( ( unsigned char )names[ len ] ); ++len ){
+		continue;
+	}
+	if ( len == 1 || len > TAG_NAME_MAXLEN + 1 || ( names[ len ] != ' ' && names[ len ] != '\0' ) ){
+		return ( 0 );
+	}
+
+	return ( len );
+}
+
+// The table is never more than half full, so a free entry ends every probe
+static size_t findtag( const struct tagindex * restrict ti, const char * restrict name, size_t len, uint32_t hash ){
+	const struct tag *tg = NULL;
+	size_t index;
+
+	for ( index = hash & ( TAGS_TABLE_SIZE - 1 ); ; index = ( index + 1 ) & ( TAGS_TABLE_SIZE - 1 ) ){
+		tg = ti->ti_table[ index ];
+		if ( tg == NULL || ( tg->tg_hash == hash && tg->tg_namelen == len && memcmp( tg->tg_name, name, len ) == 0 ) ){
+			return ( index );
+		}
+	}
+}
+
+static struct tag *newtag( struct tagindex * restrict ti, size_t slot, const char * restrict name, size_t len, uint32_t hash ){
+	struct tag *tg = NULL;
+
+	assert( ti->ti_table[ slot ] == NULL );
+	assert( len <= TAG_NAME_MAXLEN + 1 );
+
+	if ( ( tg = calloc( 1, sizeof( *tg ) ) ) == NULL ){
+		return ( NULL );
+	}
+	( void )memcpy( tg->tg_name, name, len );
+	tg->tg_namelen = len;
+	tg->tg_hash = hash;
+	initbitmap( &tg->tg_hearers );
+	ti->ti_table[ slot ] = tg;
+	( void )__atomic_fetch_add( &ti->ti_count, 1, __ATOMIC_RELAXED );
+
+	return ( tg );
+}
+
+// Deleting without tombstones keeps the probes as short as if the tag had never been there; the tags are found through pointers,
+// so moving the entries changes nothing else
+static void releasetag( struct tagindex * restrict ti, struct tag * restrict tg ){
+	size_t hole;
+	size_t index;
+	size_t home;
+
+	if ( tg->tg_count > 0 || tg->tg_subscribers > 0 ){
+		return ;
+	}
+	hole = findtag( ti, tg->tg_name, tg->tg_namelen, tg->tg_hash );
+	assert( ti->ti_table[ hole ] == tg );
+	for ( index = ( hole + 1 ) & ( TAGS_TABLE_SIZE - 1 ); ti->ti_table[ index ] != NULL; index = ( index + 1 ) & ( TAGS_TABLE_SIZE - 1 ) ){
+		// The entry stays if its probe starts after the hole
+		home = ti->ti_table[ index ]->tg_hash & ( TAGS_TABLE_SIZE - 1 );
+		if ( ( ( index - home ) & ( TAGS_TABLE_SIZE - 1 ) ) < ( ( index - hole ) & ( TAGS_TABLE_SIZE - 1 ) ) ){
+			continue;
+		}
+		ti->ti_table[ hole ] = ti->ti_table[ index ];
+		hole = index;
+	}
+	ti->ti_table[ hole ] = NULL;
+	( void )__atomic_fetch_sub( &ti->ti_count, 1, __ATOMIC_RELAXED );
+	delbitmap( &tg->tg_hearers );
+	free( tg->tg_deltas );
+	free( tg );
+
+	return ;
+}
+
+// The bytes taken off the front are reused by moving the list back once there is no room at the end; the list grows only if
+// that leaves less than half of it free
+static int addposting( struct tagindex * restrict ti, struct tag * restrict tg, uint64_t seq ){
+	unsigned char *deltas = NULL;
+	uint64_t delta;
+	uint32_t capacity;
+	uint32_t len;
+
+	if ( tg->tg_count == 0 ){
+		tg->tg_first = tg->tg_last = seq;
+		tg->tg_head = tg->tg_tail = 0;
+		tg->tg_count = 1;
+		( void )__atomic_fetch_add( &ti->ti_postings, 1, __ATOMIC_RELAXED );
+		return ( 0 );
+	}
+	assert( seq > tg->tg_last );
+	if ( tg->tg_tail + TAGS_VARINT_MAXLEN > tg->tg_capacity ){
+		len = tg->tg_tail - tg->tg_head;
+		if ( tg->tg_head > 0 ){
+			( void )memmove( tg->tg_deltas, tg->tg_deltas + tg->tg_head, len );
+			tg->tg_head = 0;
+			tg->tg_tail = len;
+		}
+		if ( 2 * ( len + TAGS_VARINT_MAXLEN ) > tg->tg_capacity ){
+			capacity = tg->tg_capacity == 0 ? TAGS_INITIAL_DELTAS : 2 * tg->tg_capacity;
+			if ( ( deltas = realloc( tg->tg_deltas, capacity ) ) == NULL ){
+				return ( -1 );
+			}
+			tg->tg_deltas = deltas;
+			tg->tg_capacity = capacity;
+		}
+	}
+	len = 0;
+	for ( delta = seq - tg->tg_last; delta >= 0x80; delta >>= 7 ){
+		tg->tg_deltas[ tg->tg_tail + len++ ] = ( unsigned char )( delta | 0x80 );
+	}
+	tg->tg_deltas[ tg->tg_tail + len++ ] = ( unsigned char )delta;
+	tg->tg_tail += len;
+	tg->tg_last = seq;
+	++tg->tg_count;
+	( void )__atomic_fetch_add( &ti->ti_postings, 1, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &ti->ti_bytes, len, __ATOMIC_RELAXED );
+
+	return ( 0 );
+}
+
+// The second twit becomes the oldest; its difference is what the oldest is moved by
+static void dropposting( struct tagindex * restrict ti, struct tag * restrict tg ){
+	uint64_t delta = 0;
+	uint32_t len = 0;
+	unsigned shift = 0;
+
+	assert( tg->tg_count > 0 );
+
+	( void )__atomic_fetch_sub( &ti->ti_postings, 1, __ATOMIC_RELAXED );
+	if ( --tg->tg_count == 0 ){
+		( void )__atomic_fetch_sub( &ti->ti_bytes, tg->tg_tail - tg->tg_head, __ATOMIC_RELAXED );
+		tg->tg_head = tg->tg_tail = 0;
+		return ;
+	}
+	do{
+		delta |= ( uint64_t )( tg->tg_deltas[ tg->tg_head + len ] & 0x7f ) << shift;
+		shift += 7;
+	}while ( tg->tg_deltas[ tg->tg_head + len++ ] & 0x80 );
+	tg->tg_first += delta;
+	tg->tg_head += len;
+	( void )__atomic_fetch_sub( &ti->ti_bytes, len, __ATOMIC_RELAXED );
+
+	return ;
+}
+
+// The varints are read from the oldest on, the last max kept in a ring
+static size_t lastpostings( const struct tag * restrict tg, uint64_t * restrict seqs, size_t max ){
+	uint64_t ring[ TAG_RECENT_MAXCOUNT ];
+	uint64_t seq;
+	uint64_t delta;
+	uint32_t at;
+	unsigned shift;
+	size_t count;
+	size_t i;
+
+	assert( max <= TAG_RECENT_MAXCOUNT );
+
+	if ( tg->tg_count == 0 || max == 0 ){
+		return ( 0 );
+	}
+	ring[ 0 ] = seq = tg->tg_first;
+	count = 1;
+	for ( at = tg->tg_head; at < tg->tg_tail; ++count ){
+		delta = 0;
+		shift = 0;
+		do{
+			delta |= ( uint64_t )( tg->tg_deltas[ at ] & 0x7f ) << shift;
+			shift += 7;
+		}while ( tg->tg_deltas[ at++ ] & 0x80 );
+		seq += delta;
+		ring[ count % max ] = seq;
+	}
+	assert( count == tg->tg_count );
+	for ( i = 0; i < max && i < count; ++i ){
+		seqs[ i ] = ring[ ( count > max ? count - max + i : i ) % max ];
+	}
+
+	return ( i );
+}
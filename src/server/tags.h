@@ -0,0 +1,235 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file tags.h
+ *
+ * File tags.h declares the hashtags and the mentions of the twits: the words that start with '#' or '@', such as "#rain" or "@alice".
+ * Each sayer finds those of its twits as it receives them, so the consumer does not have to, marking the '#', '@' and word bytes of
+ * a twit 16 at a time with SSE2 and finding the tags with bit operations on the masks. The consumer then adds each twit to the
+ * inverted index of its tags, which keeps, for each tag, the sequence numbers of the twits of the recent history (see history.h)
+ * that have it, and puts the twit in the twitpools of the hearers subscribed to them (see topicframe.h).
+ *
+ * A tag is a '#' or '@' at the start of the twit or after a byte other than a letter, a digit, '_', '#' or '@', followed by 1 to
+ * TAG_NAME_MAXLEN letters, digits or '_'; the case of the letters does not matter, so "#Rain" is "#rain". A twit has each tag once,
+ * and up to TWIT_TAGS_MAXCOUNT of them; those after are left out.
+ *
+ * The index is a hash table from the tag, in lower case, to its posting list and the bitmap of the numbers of the twitpools of its
+ * subscribers (see bitmap.h). The posting list has the sequence number of the oldest twit with the tag and, for each later one, the
+ * difference from the one before as a varint of 7 bits a byte, mostly one or two bytes for a twit instead of eight. The index
+ * remembers the tags of the last HISTORY_SIZE twits, as the recent history does, and as a twit falls out of it takes the twit off
+ * the front of the lists of its tags, so the lists stay in order and never need to be searched. A tag with no twits and no
+ * subscribers is taken out of the table. The last twits with a tag are found in its list alone, without going through the
+ * history. The index is guarded by si_tags_lock.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( TAGS_H_IS_INCLUDED )
+#define TAGS_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "twitpoollist.h"
+#include "bitmap.h"
+#include "twit.h"
+#include "config.h"
+
+// Entries of the hash table; a power of two at least twice the tags of the twits remembered and those the hearers can subscribe to
+#define TAGS_TABLE_SIZE (131072)
+
+#if TAGS_TABLE_SIZE < 2 * ( HISTORY_SIZE * TWIT_TAGS_MAXCOUNT + HEARERS_MAXCOUNT * HEARER_TAGS_MAXCOUNT ) || ( TAGS_TABLE_SIZE & ( TAGS_TABLE_SIZE - 1 ) )
+#error "TAGS_TABLE_SIZE must be a power of two at least twice HISTORY_SIZE * TWIT_TAGS_MAXCOUNT + HEARERS_MAXCOUNT * HEARER_TAGS_MAXCOUNT"
+#endif
+
+/**
+ * \enum tagscankind
+ *
+ * The tagscankind enumeration names the code that marks the bytes of a twit as twittags() looks for the tags.
+ */
+enum tagscankind{
+	TAGSCAN_SCALAR, /**< One byte at a time */
+	TAGSCAN_SSE2 /**< 16 bytes at a time */
+};
+
+/**
+ * \struct tag
+ *
+ * The tag structure is a hashtag or a mention in the index, with its posting list and its subscribers.
+ */
+struct tag{
+	char tg_name[ TAG_NAME_MAXLEN + 2 ]; /**< The '#' or '@' and the name, in lower case */
+	size_t tg_namelen;
+	uint32_t tg_hash;
+	uint32_t tg_count; /**< Twits remembered with the tag; zero if the list is empty */
+	uint64_t tg_first; /**< Sequence number of the oldest of them */
+	uint64_t tg_last; /**< Sequence number of the newest of them */
+	unsigned char *tg_deltas; /**< The varints of the differences of the others, from tg_deltas[ tg_head ] to tg_deltas[ tg_tail ] */
+	uint32_t tg_head;
+	uint32_t tg_tail;
+	uint32_t tg_capacity; /**< Bytes of tg_deltas */
+	uint32_t tg_subscribers; /**< Number of hearers subscribed to the tag */
+	struct bitmap tg_hearers; /**< The numbers of their twitpools */
+};
+
+/**
+ * \struct tagsubscriber
+ *
+ * The tagsubscriber structure holds the subscriptions of a hearer to its tags.
+ */
+struct tagsubscriber{
+	struct twitpoollist_node *tgs_tpln;
+	int tgs_count; /**< Number of subscriptions; zero if the hearer has no tags */
+	struct tag *tgs_tags[ HEARER_TAGS_MAXCOUNT ];
+};
+
+/**
+ * \struct tagwindowslot
+ *
+ * The tagwindowslot structure holds the tags of a twit remembered, to take it off their posting lists as it falls out.
+ */
+struct tagwindowslot{
+	struct tag *tws_tags[ TWIT_TAGS_MAXCOUNT ];
+	size_t tws_count;
+};
+
+/**
+ * \struct tagindex
+ *
+ * The tagindex structure is the inverted index. The counts are updated atomically, so the statistics read them without the lock.
+ */
+struct tagindex{
+	struct tag **ti_table; /**< TAGS_TABLE_SIZE entries, open addressed with linear probing; NULL if free */
+	struct tagwindowslot *ti_window; /**< HISTORY_SIZE slots; the next twit goes to ti_window[ ti_indexed % HISTORY_SIZE ] */
+	uint64_t ti_indexed; /**< Number of twits ever added */
+	size_t ti_count; /**< Tags in the table */
+	uint64_t ti_postings; /**< Twits in the posting lists, once for each of their tags */
+	uint64_t ti_bytes; /**< Bytes of the varints in the posting lists */
+	uint64_t ti_leftout; /**< Tags of twits not added to the index for lack of storage */
+};
+
+
+
+/**
+ * The settagscankind() function shall make twittags() mark the bytes with the code named by parameter kind, if the processor has it.
+ * It shall be called before the sayers start.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception ENOTSUP The processor does not have the instructions of the code.
+ */
+int settagscankind( enum tagscankind kind );
+
+/**
+ * The gettagscankind() function shall return the code twittags() marks the bytes with.
+ *
+ * @return The kind of the code.
+ */
+enum tagscankind gettagscankind( void );
+
+/**
+ * The twittags() function shall find the tags in the twit of len bytes, at most TWIT_MAXLEN, pointed to by parameter twit, and
+ * store them, each once, in the array of TWIT_TAGS_MAXCOUNT entries pointed to by parameter tags.
+ *
+ * @return The number of tags found.
+ */
+size_t twittags( const char * restrict twit, size_t len, struct twittag * restrict tags );
+
+/**
+ * The validtags() function shall check that the string pointed to by parameter names is a list of one to HEARER_TAGS_MAXCOUNT tags
+ * separated by single spaces, as in the request lines of topicframe.h.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+int validtags( const char * restrict names );
+
+/**
+ * The inittagindex() function shall initialize the empty index pointed to by parameter ti.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate
+ *	the error.
+ * @exception ENOMEM There is not enough memory.
+ */
+int inittagindex( struct tagindex * restrict ti );
+
+/**
+ * The deltagindex() function shall free the memory of the index pointed to by parameter ti.
+ *
+ * @return Nothing.
+ */
+void deltagindex( struct tagindex * restrict ti );
+
+/**
+ * The indextwit() function shall add the twit with the sequence number given as parameter seq and the count tags pointed to by
+ * parameter tags, as twittags() found them in the twit pointed to by parameter twit, to the index pointed to by parameter ti, and
+ * take the oldest twit remembered out of it if there are HISTORY_SIZE. The numbers of the twitpools of the subscribers of the tags
+ * are added to the bitmap pointed to by parameter matched, which may be a NULL pointer while no hearer is subscribed. The twits
+ * shall be added in the order of their sequence numbers.
+ *
+ * @return Upon successful completion the number of tags with subscribers shall be returned; otherwise, -1 shall be returned and
+ *	errno shall be set to indicate the error, the twit being added under the tags there was storage for.
+ * @exception ENOMEM Insufficient storage space for a tag, its posting list or the bitmap.
+ */
+int indextwit( struct tagindex * restrict ti, uint64_t seq, const char * restrict twit, const struct twittag * restrict tags, size_t count,
+	struct bitmap * restrict matched );
+
+/**
+ * The subscribetags() function shall subscribe the twitpool pointed to by parameter tpln to the tags in the string pointed to by
+ * parameter names, as validtags() checks it, through the structure pointed to by parameter tgs. A tag repeated, the case of its
+ * letters aside, is subscribed to once.
+ *
+ * @return Upon successful completion the number of subscriptions shall be returned; otherwise, -1 shall be returned, nothing
+ *	shall be subscribed to and errno shall be set to indicate the error.
+ * @exception EINVAL The tags are not valid.
+ * @exception ENOMEM There is not enough memory for the tags or their bitmaps.
+ */
+int subscribetags( struct tagindex * restrict ti, struct tagsubscriber * restrict tgs, struct twitpoollist_node * restrict tpln,
+	const char * restrict names );
+
+/**
+ * The unsubscribetags() function shall undo the subscriptions in the structure pointed to by parameter tgs, as subscribetags() made
+ * them. The structure is left with none.
+ *
+ * @return Nothing.
+ */
+void unsubscribetags( struct tagindex * restrict ti, struct tagsubscriber * restrict tgs );
+
+/**
+ * The recenttagged() function shall store in the array pointed to by parameter seqs, oldest first, the sequence numbers of the last
+ * max twits, at most TAG_RECENT_MAXCOUNT, in the index pointed to by parameter ti that have any of the tags of the structure pointed
+ * to by parameter tgs.
+ *
+ * @return The number of sequence numbers stored.
+ */
+size_t recenttagged( const struct tagindex * restrict ti, const struct tagsubscriber * restrict tgs, uint64_t * restrict seqs, size_t max );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
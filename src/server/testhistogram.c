@@ -0,0 +1,69 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "histogram.h"
+
+#define LIMIT 100000
+
+int main( void ){
+	static struct histogram h;
+	static struct histogram snapshot;
+	uint64_t value;
+	int bucket;
+
+	inithistogram( &h );
+
+	// Every value must fall in a bucket whose highest value is not less than the value and not too far from it
+	for ( value = 0; value < ( ( uint64_t )1 << 36 ); value = value * 3 / 2 + 1 ){
+		bucket = histogrambucket( value );
+		assert( bucket >= 0 && bucket < HISTOGRAM_BUCKETS );
+		assert( histogrambucketmax( bucket ) >= value );
+		assert( histogrambucketmax( bucket ) - value <= value >> ( HISTOGRAM_SUBBITS - 1 ) );
+	}
+
+	// Record 1..LIMIT and check the percentiles are within the error of the histogram
+	for ( value = 1; value <= LIMIT; ++value ){
+		recordinhistogram( &h, value );
+	}
+	snapshothistogram( &h, &snapshot );
+	assert( snapshot.h_count == LIMIT );
+	assert( snapshot.h_max == LIMIT );
+	( void )printf( "p50 = %llu p99 = %llu p999 = %llu max = %llu\n",
+		( unsigned long long )histogrampercentile( &snapshot, 50.0 ),
+		( unsigned long long )histogrampercentile( &snapshot, 99.0 ),
+		( unsigned long long )histogrampercentile( &snapshot, 99.9 ),
+		( unsigned long long )snapshot.h_max );
+	( void )fflush( stdout );
+	value = histogrampercentile( &snapshot, 50.0 );
+	assert( value >= LIMIT / 2 && value <= LIMIT / 2 + ( LIMIT / 2 >> ( HISTOGRAM_SUBBITS - 1 ) ) );
+	assert( histogrampercentile( &snapshot, 100.0 ) == LIMIT );
+
+	exit( EXIT_SUCCESS );
+}
@@ -0,0 +1,106 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file timing.c
+ *
+ * File timing.c contains the implementation of the timing.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <stdint.h>
+#include <time.h>
+#include "timing.h"
+
+
+
+// How many nanoseconds a cycle lasts; set once by calibratecycles(). Until then cycles are taken for nanoseconds
+static double nspercycle = 1.0;
+
+
+
+// Read the monotonic clock
+uint64_t monotonic_ns( void ){
+	struct timespec ts;
+
+	// clock_gettime() can only fail for an invalid clock and CLOCK_MONOTONIC is always there in the systems we run on
+	while ( clock_gettime( CLOCK_MONOTONIC, &ts ) == -1 ){ continue; }
+
+	return ( ( uint64_t )ts.tv_sec * 1000000000u + ( uint64_t )ts.tv_nsec );
+}
+
+// Read the realtime clock
+uint64_t realtime_ns( void ){
+	struct timespec ts;
+
+	while ( clock_gettime( CLOCK_REALTIME, &ts ) == -1 ){ continue; }
+
+	return ( ( uint64_t )ts.tv_sec * 1000000000u + ( uint64_t )ts.tv_nsec );
+}
+
+// Read the counter of the processor. The counters used tick at a constant rate on the processors we run on
+uint64_t cycles( void ){
+#if defined( __x86_64__ ) || defined( __i386__ )
+	uint32_t lo;
+	uint32_t hi;
+
+	__asm__ __volatile__( "rdtsc" : "=a" ( lo ), "=d" ( hi ) );
+
+	return ( ( ( uint64_t )hi << 32 ) | lo );
+#elif defined( __aarch64__ )
+	uint64_t value;
+
+	__asm__ __volatile__( "mrs %0, cntvct_el0" : "=r" ( value ) );
+
+	return ( value );
+#else
+	return ( monotonic_ns() );
+#endif
+}
+
+// Count the cycles in a few milliseconds of the monotonic clock
+void calibratecycles( void ){
+	const struct timespec duration = { .tv_sec = 0, .tv_nsec = 10000000L };
+	uint64_t startns, endns;
+	uint64_t startcycles, endcycles;
+
+	startns = monotonic_ns();
+	startcycles = cycles();
+	while ( nanosleep( &duration, NULL ) == -1 ){ continue; }
+	endcycles = cycles();
+	endns = monotonic_ns();
+
+	if ( endcycles > startcycles ){
+		nspercycle = ( double )( endns - startns ) / ( double )( endcycles - startcycles );
+	}
+
+	return ;
+}
+
+// Scale by the calibrated rate
+uint64_t cyclestons( uint64_t ncycles ){
+	return ( ( uint64_t )( ncycles * nspercycle ) );
+}
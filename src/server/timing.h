@@ -0,0 +1,86 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file timing.h
+ *
+ * File timing.h declares the functions used by the server to take timestamps.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( TIMING_H_IS_INCLUDED )
+#define TIMING_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+/**
+ * The monotonic_ns() function shall return the current time of the monotonic clock (CLOCK_MONOTONIC) in nanoseconds.
+ * The value returned is only meaningful when compared with another value returned by monotonic_ns().
+ *
+ * @return The current time of the monotonic clock in nanoseconds.
+ */
+uint64_t monotonic_ns( void );
+
+/**
+ * The realtime_ns() function shall return the current time of the realtime clock (CLOCK_REALTIME) in nanoseconds since the Epoch.
+ *
+ * @return The current time of the realtime clock in nanoseconds.
+ */
+uint64_t realtime_ns( void );
+
+/**
+ * The cycles() function shall return the value of the cycle counter of the processor, where one can be read cheaply from user
+ * space; otherwise it shall return the same as monotonic_ns(). The value returned is only meaningful when compared with another
+ * value returned by cycles(), on any processor, and converted to nanoseconds with cyclestons().
+ *
+ * @return The current value of the cycle counter.
+ */
+uint64_t cycles( void );
+
+/**
+ * The calibratecycles() function shall measure how many nanoseconds a cycle counted by cycles() lasts. It takes a few milliseconds
+ * and it shall be called once, before cyclestons() is used by any thread.
+ *
+ * @return Nothing.
+ */
+void calibratecycles( void );
+
+/**
+ * The cyclestons() function shall convert the number of cycles given as parameter, as counted by cycles(), to nanoseconds.
+ *
+ * @return The number of nanoseconds.
+ */
+uint64_t cyclestons( uint64_t ncycles );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
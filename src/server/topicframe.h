@@ -0,0 +1,82 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file topicframe.h
+ *
+ * File topicframe.h defines how the twits are put on topics. A sayer puts a twit on a topic by starting it with '/', the name of
+ * the topic and a space, as in "/weather rain again"; the name is 1 to 32 letters, digits, '.', '_' or '-'. Any other twit is on
+ * the global topic, as is one that names "global". A twit that is just "/name" is on the topic too.
+ *
+ * A hearer connected to TOPIC_HEARERS_PORT first sends one request line, at most TOPICFRAME_REQUEST_MAXLEN bytes with the newline:
+ *	"TOPICS name ...\n" for the twits on up to 8 topics, their names separated by single spaces
+ *	"KEYWORDS word ...\n" for the twits that contain any of up to 16 keywords, separated by single spaces; a keyword is 1 to 32
+ *	printable characters other than the space and matches anywhere in the twit, the case of the letters aside
+ *	"REGEXES pattern ...\n" for the twits that match any of up to 8 regular expressions, separated by single spaces; a regular
+ *	expression is 1 to 64 printable characters other than the space and matches anywhere in the twit. It has the characters that
+ *	stand for themselves, '.' for any byte, classes such as "[a-z_]" or "[^0-9]", the escapes "\w", "\d" and "\s" and their
+ *	negations "\W", "\D" and "\S", a backslash before any other punctuation character for that character, and '*', '+', '?',
+ *	'|' and parentheses, as in "#ad\w+" or "(buy|sell) [0-9]+". There are no anchors, and outside of a class '^', '$', '{',
+ *	'}' and ']' need a backslash. One that matches the empty string would match every twit and is not taken
+ *	"TAGS tag ...\n" for the twits with any of up to 8 hashtags or mentions, separated by single spaces; a tag is '#' or '@'
+ *	followed by 1 to 32 letters, digits or '_', as in "#rain" or "@alice", the case of the letters aside, and is found in a twit
+ *	where it stands on its own (see tags.h)
+ *	"RECENT n tag ...\n" for the same, after the last n twits of the recent history with any of the tags, n from 1 to 100
+ * and is then sent those twits as they come, as a hearer connected to HEARERS_PORT is sent every twit. The twits keep the name of
+ * their topic. Naming the global topic asks for every twit, which is what the hearers of HEARERS_PORT and RESUMING_HEARERS_PORT get.
+ *
+ * This header is shared with the clients so it only holds macros.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( TOPICFRAME_H_IS_INCLUDED )
+#define TOPICFRAME_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#define TOPICFRAME_REQUEST_MAXLEN (544)
+
+#define TOPICFRAME_PREFIX '/'
+
+#define TOPICFRAME_GLOBAL "global"
+
+#define TOPICFRAME_TOPICS "TOPICS "
+
+#define TOPICFRAME_KEYWORDS "KEYWORDS "
+
+#define TOPICFRAME_REGEXES "REGEXES "
+
+#define TOPICFRAME_TAGS "TAGS "
+
+#define TOPICFRAME_RECENT "RECENT "
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
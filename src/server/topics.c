@@ -0,0 +1,321 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file topics.c
+ *
+ * File topics.c contains the implementation of the topics.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include "topics.h"
+#include "topicframe.h"
+#include "crc32c.h"
+
+#if 7 + HEARER_TOPICS_MAXCOUNT * ( TOPIC_NAME_MAXLEN + 1 ) > TOPICFRAME_REQUEST_MAXLEN
+#error "The request line of topicframe.h must fit HEARER_TOPICS_MAXCOUNT names"
+#endif
+
+/**
+ * The topicnamelen() function shall find the length of the name of a topic at the start of the len bytes pointed to by parameter
+ * names, up to the first character that cannot be in a name or the end.
+ *
+ * @return The length of the name; zero if there is none or it is longer than TOPIC_NAME_MAXLEN.
+ */
+static size_t topicnamelen( const char * restrict names, size_t len );
+
+/**
+ * The isglobal() function shall check whether the name of len bytes pointed to by parameter name is that of the global topic.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+static int isglobal( const char * restrict name, size_t len );
+
+/**
+ * The findtopic() function shall find the entry of the table pointed to by parameter ts that the topic with the name of len bytes
+ * pointed to by parameter name and hash given as parameter hash has, or would have.
+ *
+ * @return The index of the entry; it is free if the topic has no subscribers.
+ */
+static size_t findtopic( const struct topics * restrict ts, const char * restrict name, size_t len, uint32_t hash );
+
+/**
+ * The removetopic() function shall free the entry with index hole of the table pointed to by parameter ts, moving back the entries
+ * after it that would no longer be found, and the subscriptions that point to them.
+ *
+ * @return Nothing.
+ */
+static void removetopic( struct topics * restrict ts, size_t hole );
+
+
+
+void inittopics( struct topics * restrict ts ){
+	assert( ts != NULL );
+
+	( void )memset( ts, 0, sizeof( *ts ) );
+
+	return ;
+}
+
+void deltopics( struct topics * restrict ts ){
+	size_t index;
+
+	assert( ts != NULL );
+
+	for ( index = 0; index < TOPICS_TABLE_SIZE; ++index ){
+		delbitmap( &ts->ts_table[ index ].tp_hearers );
+		ts->ts_table[ index ].tp_subscribers = NULL;
+	}
+	delbitmap( &ts->ts_global );
+	ts->ts_count = 0;
+	ts->ts_globalcount = 0;
+
+	return ;
+}
+
+// Called by the sayers, so the consumer only looks the hash up
+size_t twittopic( const char * restrict twit, size_t len, uint32_t * restrict hash ){
+	size_t namelen;
+
+	assert( twit != NULL );
+	assert( hash != NULL );
+
+	*hash = 0;
+	if ( len < 2 || twit[ 0 ] != TOPICFRAME_PREFIX || ( namelen = topicnamelen( twit + 1, len - 1 ) ) == 0 || isglobal( twit + 1, namelen ) ){
+		return ( 0 );
+	}
+	// The twit may be just the name, and what the sayer typed may end with its newline
+	if ( namelen + 1 < len && twit[ namelen + 1 ] != ' ' && twit[ namelen + 1 ] != '\t' && twit[ namelen + 1 ] != '\r' && twit[ namelen + 1 ] != '\n' ){
+		return ( 0 );
+	}
+	*hash = crc32c( 0, twit + 1, namelen );
+
+	return ( namelen );
+}
+
+int validtopics( const char * restrict names ){
+	size_t len;
+	size_t namelen;
+	int count = 0;
+
+	assert( names != NULL );
+
+	len = strlen( names );
+	while ( len > 0 ){
+		if ( ( namelen = topicnamelen( names, len ) ) == 0 || ++count > HEARER_TOPICS_MAXCOUNT ){
+			return ( 0 );
+		}
+		names += namelen;
+		len -= namelen;
+		// A space is followed by a name
+		if ( len > 0 ){
+			if ( *names != ' ' || --len == 0 ){
+				return ( 0 );
+			}
+			++names;
+		}
+	}
+
+	return ( count > 0 );
+}
+
+// A name repeated is subscribed to once, and the global topic takes the place of all the others. The number of the twitpool is put
+// in the bitmap of a topic before the subscription is linked, so a failure leaves it as it was
+int subscribe( struct topics * restrict ts, struct subscription * restrict subs, struct twitpoollist_node * restrict tpln,
+	const char * restrict names ){
+	const char *name = NULL;
+	struct topic *tp = NULL;
+	size_t namelen;
+	size_t index;
+	uint32_t hash;
+	int count = 0;
+	int i;
+
+	assert( ts != NULL );
+	assert( subs != NULL );
+	assert( tpln != NULL );
+	assert( names != NULL );
+
+	if ( *names != '\0' && !validtopics( names ) ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	for ( name = names; *name != '\0'; name += namelen + ( name[ namelen ] == ' ' ) ){
+		namelen = topicnamelen( name, strlen( name ) );
+		if ( isglobal( name, namelen ) ){
+			break;
+		}
+	}
+	if ( *name != '\0' || *names == '\0' ){
+		if ( addtobitmap( &ts->ts_global, tpln->tpln_hearer ) == -1 ){
+			return ( -1 );
+		}
+		subs[ 0 ].sub_tpln = tpln;
+		subs[ 0 ].sub_topic = TOPICS_TABLE_SIZE;
+		subs[ 0 ].sub_next = NULL;
+		( void )__atomic_fetch_add( &ts->ts_globalcount, 1, __ATOMIC_RELAXED );
+		return ( 1 );
+	}
+
+	for ( name = names; *name != '\0'; name += namelen + ( name[ namelen ] == ' ' ) ){
+		namelen = topicnamelen( name, strlen( name ) );
+		hash = crc32c( 0, name, namelen );
+		index = findtopic( ts, name, namelen, hash );
+		for ( i = 0; i < count && subs[ i ].sub_topic != index; ++i ){
+			continue;
+		}
+		if ( i < count ){
+			continue;
+		}
+		tp = &ts->ts_table[ index ];
+		if ( addtobitmap( &tp->tp_hearers, tpln->tpln_hearer ) == -1 ){
+			if ( tp->tp_subscribers == NULL ){
+				delbitmap( &tp->tp_hearers );
+			}
+			unsubscribe( ts, subs, count );
+			errno = ENOMEM;
+			return ( -1 );
+		}
+		if ( tp->tp_subscribers == NULL ){
+			( void )memcpy( tp->tp_name, name, namelen );
+			tp->tp_name[ namelen ] = '\0';
+			tp->tp_namelen = namelen;
+			tp->tp_hash = hash;
+			( void )__atomic_fetch_add( &ts->ts_count, 1, __ATOMIC_RELAXED );
+		}
+		subs[ count ].sub_tpln = tpln;
+		subs[ count ].sub_topic = index;
+		subs[ count ].sub_next = tp->tp_subscribers;
+		tp->tp_subscribers = &subs[ count ];
+		++count;
+	}
+
+	return ( count );
+}
+
+// The lists are short, at most HEARERS_MAXCOUNT subscribers each
+void unsubscribe( struct topics * restrict ts, struct subscription * restrict subs, int count ){
+	struct subscription **link = NULL;
+	int i;
+
+	assert( ts != NULL );
+	assert( subs != NULL || count == 0 );
+
+	for ( i = 0; i < count; ++i ){
+		if ( subs[ i ].sub_topic == TOPICS_TABLE_SIZE ){
+			removefrombitmap( &ts->ts_global, subs[ i ].sub_tpln->tpln_hearer );
+			( void )__atomic_fetch_sub( &ts->ts_globalcount, 1, __ATOMIC_RELAXED );
+			continue;
+		}
+		// The bitmap frees its storage with the last subscriber, before the entry is taken out
+		removefrombitmap( &ts->ts_table[ subs[ i ].sub_topic ].tp_hearers, subs[ i ].sub_tpln->tpln_hearer );
+		link = &ts->ts_table[ subs[ i ].sub_topic ].tp_subscribers;
+		while ( *link != &subs[ i ] ){
+			assert( *link != NULL );
+			link = &( *link )->sub_next;
+		}
+		*link = subs[ i ].sub_next;
+		if ( ts->ts_table[ subs[ i ].sub_topic ].tp_subscribers == NULL ){
+			removetopic( ts, subs[ i ].sub_topic );
+			( void )__atomic_fetch_sub( &ts->ts_count, 1, __ATOMIC_RELAXED );
+		}
+	}
+
+	return ;
+}
+
+// A free entry has an empty bitmap
+const struct bitmap *topicsubscribers( const struct topics * restrict ts, const char * restrict name, size_t len, uint32_t hash ){
+	assert( ts != NULL );
+	assert( name != NULL );
+
+	return ( &ts->ts_table[ findtopic( ts, name, len, hash ) ].tp_hearers );
+}
+
+
+
+// Implementation of local functions...
+
+// The characters of the names of cursors; they need no escaping either
+static size_t topicnamelen( const char * restrict names, size_t len ){
+	size_t namelen;
+	char c;
+
+	for ( namelen = 0; namelen < len; ++namelen ){
+		c = names[ namelen ];
+		if ( !( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) || c == '.' || c == '_' || c == '-' ) ){
+			break;
+		}
+	}
+
+	return ( namelen <= TOPIC_NAME_MAXLEN ? namelen : 0 );
+}
+
+static int isglobal( const char * restrict name, size_t len ){
+	return ( len == sizeof( TOPICFRAME_GLOBAL ) - 1 && memcmp( name, TOPICFRAME_GLOBAL, len ) == 0 );
+}
+
+// The table is never more than half full, so a free entry ends every probe
+static size_t findtopic( const struct topics * restrict ts, const char * restrict name, size_t len, uint32_t hash ){
+	const struct topic *tp = NULL;
+	size_t index;
+
+	for ( index = hash & ( TOPICS_TABLE_SIZE - 1 ); ; index = ( index + 1 ) & ( TOPICS_TABLE_SIZE - 1 ) ){
+		tp = &ts->ts_table[ index ];
+		if ( tp->tp_subscribers == NULL || ( tp->tp_hash == hash && tp->tp_namelen == len && memcmp( tp->tp_name, name, len ) == 0 ) ){
+			return ( index );
+		}
+	}
+}
+
+// Deleting without tombstones keeps the probes as short as if the topic had never been there
+static void removetopic( struct topics * restrict ts, size_t hole ){
+	struct subscription *sub = NULL;
+	size_t index;
+	size_t home;
+
+	for ( index = ( hole + 1 ) & ( TOPICS_TABLE_SIZE - 1 ); ts->ts_table[ index ].tp_subscribers != NULL;
+		index = ( index + 1 ) & ( TOPICS_TABLE_SIZE - 1 ) ){
+		// The entry stays if its probe starts after the hole
+		home = ts->ts_table[ index ].tp_hash & ( TOPICS_TABLE_SIZE - 1 );
+		if ( ( ( index - home ) & ( TOPICS_TABLE_SIZE - 1 ) ) < ( ( index - hole ) & ( TOPICS_TABLE_SIZE - 1 ) ) ){
+			continue;
+		}
+		ts->ts_table[ hole ] = ts->ts_table[ index ];
+		for ( sub = ts->ts_table[ hole ].tp_subscribers; sub != NULL; sub = sub->sub_next ){
+			sub->sub_topic = hole;
+		}
+		hole = index;
+	}
+	// The bitmap of the last entry moved went with it
+	ts->ts_table[ hole ].tp_subscribers = NULL;
+	initbitmap( &ts->ts_table[ hole ].tp_hearers );
+
+	return ;
+}
@@ -0,0 +1,164 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file topics.h
+ *
+ * File topics.h declares the topics the hearers subscribe to (see topicframe.h). The twitpool consumer puts each twit in the
+ * twitpools of the hearers on the global topic and of those subscribed to the topic of the twit, which it finds in a hash table
+ * from the name of the topic to the bitmap of the numbers of its subscribers (see bitmap.h), and adds to those of the keywords and
+ * the regular expressions. The work of fanning a twit out is proportional to the hearers that want it rather than to all of them.
+ *
+ * A hearer subscribes through the subscription structures it owns, one for each of its topics, which are linked in the lists of
+ * the topics as well, so an entry moved in the table finds them. The table holds the topics that have subscribers; an entry is
+ * taken out with its last subscriber. The topics are guarded by si_topics_lock, which the consumer holds only while it looks the
+ * topic of a twit up.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( TOPICS_H_IS_INCLUDED )
+#define TOPICS_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "twitpoollist.h"
+#include "bitmap.h"
+#include "config.h"
+
+// Entries of the hash table; a power of two at least twice the topics the hearers can subscribe to, so the probes stay short
+#define TOPICS_TABLE_SIZE (512)
+
+#if TOPICS_TABLE_SIZE < 2 * HEARERS_MAXCOUNT * HEARER_TOPICS_MAXCOUNT || ( TOPICS_TABLE_SIZE & ( TOPICS_TABLE_SIZE - 1 ) )
+#error "TOPICS_TABLE_SIZE must be a power of two at least twice HEARERS_MAXCOUNT * HEARER_TOPICS_MAXCOUNT"
+#endif
+
+/**
+ * \struct subscription
+ *
+ * The subscription structure links the twitpool of a hearer in the list of the subscribers of one of its topics.
+ */
+struct subscription{
+	struct subscription *sub_next; /**< Unused for the global topic */
+	struct twitpoollist_node *sub_tpln;
+	size_t sub_topic; /**< Entry of the topic in the table; TOPICS_TABLE_SIZE for the global topic */
+};
+
+/**
+ * \struct topic
+ *
+ * The topic structure is an entry of the hash table; tp_subscribers is NULL if the entry is free.
+ */
+struct topic{
+	char tp_name[ TOPIC_NAME_MAXLEN + 1 ];
+	size_t tp_namelen;
+	uint32_t tp_hash;
+	struct subscription *tp_subscribers;
+	struct bitmap tp_hearers; /**< The numbers of the twitpools of the subscribers (see twitpoollist.h) */
+};
+
+/**
+ * \struct topics
+ *
+ * The topics structure is the hash table of the topics, open addressed with linear probing, and the subscribers of the global topic.
+ * The counts are updated atomically, so the statistics read them without the lock.
+ */
+struct topics{
+	struct topic ts_table[ TOPICS_TABLE_SIZE ];
+	size_t ts_count; /**< Topics with subscribers, the global one aside */
+	struct bitmap ts_global; /**< The numbers of the twitpools of the subscribers of the global topic */
+	size_t ts_globalcount;
+};
+
+
+
+/**
+ * The inittopics() function shall initialize the empty table of topics pointed to by parameter ts.
+ *
+ * @return Nothing.
+ */
+void inittopics( struct topics * restrict ts );
+
+/**
+ * The deltopics() function shall free the storage of the bitmaps of the table of topics pointed to by parameter ts, which is left
+ * empty.
+ *
+ * @return Nothing.
+ */
+void deltopics( struct topics * restrict ts );
+
+/**
+ * The twittopic() function shall find the topic the twit of len bytes pointed to by parameter twit is on, as topicframe.h puts it.
+ * The hash of its name is stored in the object pointed to by parameter hash; the name starts at twit + 1.
+ *
+ * @return The length of the name of the topic; zero if the twit is on the global topic.
+ */
+size_t twittopic( const char * restrict twit, size_t len, uint32_t * restrict hash );
+
+/**
+ * The validtopics() function shall check that the string pointed to by parameter names is what follows "TOPICS " in the request
+ * line of topicframe.h: one to HEARER_TOPICS_MAXCOUNT names of topics separated by single spaces.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+int validtopics( const char * restrict names );
+
+/**
+ * The subscribe() function shall subscribe the twitpool pointed to by parameter tpln to the topics named in the string pointed
+ * to by parameter names, as validtopics() checks it, or to the global topic if the string is empty or names it. The subscriptions
+ * are kept in the array of HEARER_TOPICS_MAXCOUNT entries pointed to by parameter subs.
+ *
+ * @return Upon successful completion the number of subscriptions shall be returned; otherwise, -1 shall be returned and errno
+ *	shall be set to indicate the error.
+ * @exception EINVAL The names are not valid.
+ * @exception ENOMEM Insufficient storage space for the function to perform the operation.
+ */
+int subscribe( struct topics * restrict ts, struct subscription * restrict subs, struct twitpoollist_node * restrict tpln,
+	const char * restrict names );
+
+/**
+ * The unsubscribe() function shall undo the count subscriptions in the array pointed to by parameter subs, as subscribe() made them.
+ *
+ * @return Nothing.
+ */
+void unsubscribe( struct topics * restrict ts, struct subscription * restrict subs, int count );
+
+/**
+ * The topicsubscribers() function shall find the subscribers of the topic whose name of len bytes, pointed to by parameter name,
+ * has the hash given as parameter hash, as twittopic() found them.
+ *
+ * @return The bitmap of the numbers of their twitpools; empty if the topic has none.
+ */
+const struct bitmap *topicsubscribers( const struct topics * restrict ts, const char * restrict name, size_t len, uint32_t hash );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -0,0 +1,337 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file trace.c
+ *
+ * File trace.c contains the implementation of the trace.h interface.
+ *
+ * A ring counts the events ever written in it (tr_head); event i is kept at tr_events[ i % TRACE_RING_EVENTS ]. The owner
+ * writes the event and only then makes tr_head count it, with release ordering, so whoever reads tr_head with acquire ordering
+ * sees every event it counts. While a ring is copied by flushtrace() its owner keeps writing, so after the copy tr_head is read
+ * again and the events that may have been overwritten in the meantime are thrown away.
+ *
+ * @author Tassos Souris
+ */
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "timing.h"
+#include "trace.h"
+#include "config.h"
+
+
+
+/**
+ * \struct tracering
+ *
+ * The tracering structure is the ring of a thread.
+ */
+struct tracering{
+	int tr_owned; /**< 1 while a thread owns the ring; taken with an atomic compare-and-swap */
+	uint32_t tr_thread; /**< Number of the thread that owns (or last owned) the ring */
+	char tr_name[ TRACE_THREADNAME_MAXLEN ];
+	uint64_t tr_head; /**< Number of events ever written in the ring */
+	struct traceevent tr_events[ TRACE_RING_EVENTS ];
+};
+
+
+
+/**
+ * The releasering() function shall give back the ring pointed to by parameter arg. It is the destructor of the key under which
+ * each thread keeps its ring.
+ *
+ * @return Nothing.
+ */
+static void releasering( void *arg );
+
+/**
+ * The takering() function shall find a free ring and make it owned by the calling thread, under the name pointed to by parameter name.
+ * Rings never used are preferred so the events of terminated threads are kept as long as possible.
+ *
+ * @return Pointer to the ring; NULL if none is free.
+ */
+static struct tracering *takering( const char * restrict name );
+
+/**
+ * The copyring() function shall copy to the array of TRACE_RING_EVENTS struct traceevent objects pointed to by parameter events
+ * the events of the ring pointed to by parameter ring that are not being overwritten, oldest first.
+ *
+ * @return The number of events copied.
+ */
+static uint32_t copyring( struct tracering * restrict ring, struct traceevent * restrict events );
+
+
+
+// The rings
+static struct tracering rings[ TRACE_RINGS ];
+
+// Each thread keeps its ring under this key
+static pthread_key_t ringkey;
+
+// Number given to the next thread that takes a ring
+static uint32_t nextthread = 0;
+
+// cycles() and monotonic_ns() when inittrace() was called. Over the lifetime of the server they measure the length
+// of a cycle far better than calibratecycles() can in a few milliseconds
+static uint64_t startcycles;
+static uint64_t startns;
+
+// Set by traceanomaly() and cleared by takeanomaly()
+static int anomaly = 0;
+
+// Only one flushtrace() at a time; it shares the copy buffer and the counter of files
+static pthread_mutex_t flushlock = PTHREAD_MUTEX_INITIALIZER;
+static struct traceevent flushbuffer[ TRACE_RING_EVENTS ];
+static unsigned flushcount = 0;
+
+
+
+int inittrace( void ){
+	if ( ( errno = pthread_key_create( &ringkey, &releasering ) ) ){
+		return ( -1 );
+	}
+	startns = monotonic_ns();
+	startcycles = cycles();
+
+	return ( 0 );
+}
+
+void tracethread( const char * restrict name ){
+	struct tracering *ring = NULL;
+
+	assert( name != NULL );
+
+	// A thread that already has a ring keeps it
+	if ( pthread_getspecific( ringkey ) != NULL ){
+		return ;
+	}
+	if ( ( ring = takering( name ) ) != NULL ){
+		while ( pthread_setspecific( ringkey, ring ) ){ continue; }
+	}
+
+	return ;
+}
+
+// The hot path: no locks, no system calls
+void trace( enum traceeventtype type, uint64_t twit, uint64_t start, uint16_t arg ){
+	struct tracering *ring = NULL;
+	struct traceevent *event = NULL;
+	uint64_t now;
+	uint64_t head;
+
+	assert( type >= 0 && type < TRACE_EVENT_TYPES );
+
+	if ( ( ring = pthread_getspecific( ringkey ) ) == NULL ){
+		return ;
+	}
+
+	now = cycles();
+	head = ring->tr_head;
+	event = &ring->tr_events[ head & ( TRACE_RING_EVENTS - 1 ) ];
+	event->te_cycles = ( start != 0 ) ? start : now;
+	event->te_twit = twit;
+	event->te_duration = ( start != 0 && now > start ) ? now - start : 0;
+	event->te_type = ( uint16_t )type;
+	event->te_arg = arg;
+	event->te_reserved = 0;
+	__atomic_store_n( &ring->tr_head, head + 1, __ATOMIC_RELEASE );
+
+	return ;
+}
+
+void traceanomaly( void ){
+	__atomic_store_n( &anomaly, 1, __ATOMIC_RELAXED );
+
+	return ;
+}
+
+int takeanomaly( void ){
+	return ( __atomic_exchange_n( &anomaly, 0, __ATOMIC_RELAXED ) );
+}
+
+// Header, then each ring that has events
+int flushtrace( char * restrict path, size_t pathsize ){
+	struct tracefileheader fh;
+	struct traceringheader rh;
+	FILE *fp = NULL;
+	int status = 0;
+	int i;
+
+	if ( path == NULL ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+
+	while ( pthread_mutex_lock( &flushlock ) ){ continue; }
+
+	( void )snprintf( path, pathsize, "%s.%ld.%u", TRACE_FILE_PREFIX, ( long )getpid(), flushcount++ );
+	if ( ( fp = fopen( path, "wb" ) ) == NULL ){
+		while ( pthread_mutex_unlock( &flushlock ) ){ continue; }
+		return ( -1 );
+	}
+
+	( void )memset( &fh, 0, sizeof( fh ) );
+	fh.tfh_magic = TRACE_MAGIC;
+	fh.tfh_version = TRACE_VERSION;
+	fh.tfh_cycles = cycles();
+	fh.tfh_ns = monotonic_ns();
+	if ( fh.tfh_ns - startns >= 1000000000u && fh.tfh_cycles > startcycles ){
+		fh.tfh_nspercycle = ( double )( fh.tfh_ns - startns ) / ( double )( fh.tfh_cycles - startcycles );
+	}
+	else{
+		fh.tfh_nspercycle = ( double )cyclestons( 1000000000u ) / 1e9;
+	}
+	for ( i = 0; i < TRACE_RINGS; ++i ){
+		if ( __atomic_load_n( &rings[ i ].tr_head, __ATOMIC_ACQUIRE ) != 0 ){
+			++fh.tfh_rings;
+		}
+	}
+	if ( fwrite( &fh, sizeof( fh ), 1, fp ) != 1 ){
+		status = -1;
+	}
+
+	// Rings that got their first event after the header was written are left out; the header counted them out
+	for ( i = 0; i < TRACE_RINGS && status == 0 && fh.tfh_rings > 0; ++i ){
+		if ( __atomic_load_n( &rings[ i ].tr_head, __ATOMIC_ACQUIRE ) == 0 ){
+			continue;
+		}
+		--fh.tfh_rings;
+		( void )memset( &rh, 0, sizeof( rh ) );
+		rh.trh_thread = __atomic_load_n( &rings[ i ].tr_thread, __ATOMIC_RELAXED );
+		( void )memcpy( rh.trh_name, rings[ i ].tr_name, sizeof( rh.trh_name ) );
+		rh.trh_name[ TRACE_THREADNAME_MAXLEN - 1 ] = '\0';
+		rh.trh_events = copyring( &rings[ i ], flushbuffer );
+		if ( fwrite( &rh, sizeof( rh ), 1, fp ) != 1 ||
+			fwrite( flushbuffer, sizeof( flushbuffer[ 0 ] ), rh.trh_events, fp ) != rh.trh_events ){
+			status = -1;
+		}
+	}
+
+	if ( fclose( fp ) == EOF ){
+		status = -1;
+	}
+	while ( pthread_mutex_unlock( &flushlock ) ){ continue; }
+
+	return ( status );
+}
+
+const char *traceeventname( enum traceeventtype type ){
+	static const char * const names[ TRACE_EVENT_TYPES ] = {
+		[ TRACE_RECEIVED ] = "received",
+		[ TRACE_ENQUEUED ] = "enqueued",
+		[ TRACE_DEQUEUED ] = "dequeued",
+		[ TRACE_FANNED_OUT ] = "fanned_out",
+		[ TRACE_SENT ] = "sent",
+		[ TRACE_HEARER_BLOCKED ] = "hearer_blocked"
+	};
+
+	assert( type >= 0 && type < TRACE_EVENT_TYPES );
+
+	return ( names[ type ] );
+}
+
+
+
+// Implementation of local functions...
+
+// The events stay in the ring until another thread takes it
+static void releasering( void *arg ){
+	struct tracering *ring = ( struct tracering * )arg;
+
+	assert( ring != NULL );
+
+	__atomic_store_n( &ring->tr_owned, 0, __ATOMIC_RELEASE );
+
+	return ;
+}
+
+// First a ring never used, then any free ring
+static struct tracering *takering( const char * restrict name ){
+	int expected;
+	int pass;
+	int i;
+
+	assert( name != NULL );
+
+	for ( pass = 0; pass < 2; ++pass ){
+		for ( i = 0; i < TRACE_RINGS; ++i ){
+			if ( pass == 0 && __atomic_load_n( &rings[ i ].tr_head, __ATOMIC_RELAXED ) != 0 ){
+				continue;
+			}
+			expected = 0;
+			if ( __atomic_compare_exchange_n( &rings[ i ].tr_owned, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ){
+				// The events of the previous owner go
+				__atomic_store_n( &rings[ i ].tr_head, 0, __ATOMIC_RELEASE );
+				( void )strncpy( rings[ i ].tr_name, name, TRACE_THREADNAME_MAXLEN - 1 );
+				rings[ i ].tr_name[ TRACE_THREADNAME_MAXLEN - 1 ] = '\0';
+				__atomic_store_n( &rings[ i ].tr_thread, __atomic_fetch_add( &nextthread, 1, __ATOMIC_RELAXED ), __ATOMIC_RELAXED );
+				return ( &rings[ i ] );
+			}
+		}
+	}
+
+	return ( NULL );
+}
+
+// Copy, then keep only what was not overwritten while copying
+static uint32_t copyring( struct tracering * restrict ring, struct traceevent * restrict events ){
+	uint64_t before;
+	uint64_t after;
+	uint64_t first;
+	uint64_t i;
+
+	assert( ring != NULL );
+	assert( events != NULL );
+
+	before = __atomic_load_n( &ring->tr_head, __ATOMIC_ACQUIRE );
+	first = ( before > TRACE_RING_EVENTS ) ? before - TRACE_RING_EVENTS : 0;
+	for ( i = first; i < before; ++i ){
+		events[ i - first ] = ring->tr_events[ i & ( TRACE_RING_EVENTS - 1 ) ];
+	}
+	__atomic_thread_fence( __ATOMIC_ACQUIRE );
+	after = __atomic_load_n( &ring->tr_head, __ATOMIC_RELAXED );
+
+	// The ring changed owner while copied; nothing can be trusted
+	if ( after < before ){
+		return ( 0 );
+	}
+	// Event after - TRACE_RING_EVENTS may be half overwritten by the write of event after, which is not counted yet
+	if ( after + 1 > first + TRACE_RING_EVENTS ){
+		uint64_t lost = after + 1 - ( first + TRACE_RING_EVENTS );
+		if ( lost >= before - first ){
+			return ( 0 );
+		}
+		( void )memmove( events, events + lost, ( before - first - lost ) * sizeof( events[ 0 ] ) );
+		return ( ( uint32_t )( before - first - lost ) );
+	}
+
+	return ( ( uint32_t )( before - first ) );
+}
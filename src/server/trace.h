@@ -0,0 +1,189 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file trace.h
+ *
+ * File trace.h declares the tracing facility of the server.
+ *
+ * Every thread that moves twits records what it does to them as fixed-size binary events (struct traceevent), timestamped
+ * with cycles(), in a ring of its own. Only the owner writes in a ring so recording takes no lock and no system call; when
+ * the ring is full the oldest events are overwritten. The rings are written to a file (flushtrace()) on SIGUSR2 or when a
+ * twit takes longer than TRACE_ANOMALY_MSEC milliseconds to go through the server, and the twittrace program turns such files into
+ * JSON for the Chrome trace viewer.
+ *
+ * The file starts with a struct tracefileheader, followed for each ring by a struct traceringheader and the events of the
+ * ring, oldest first. All fields are in the byte order of the machine that wrote the file.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( TRACE_H_IS_INCLUDED )
+#define TRACE_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Number of rings; a thread that finds none free is not traced
+#define TRACE_RINGS ( SAYERS_MAXCOUNT + HEARERS_MAXCOUNT + 8 )
+
+// Number of events in each ring; must be a power of two
+#define TRACE_RING_EVENTS (4096)
+
+// Maximum length of the name of a thread, including the terminating null byte
+#define TRACE_THREADNAME_MAXLEN (16)
+
+// First four bytes of a trace file ("TWTR")
+#define TRACE_MAGIC (0x52545754u)
+
+// Changes whenever the format of the file changes
+#define TRACE_VERSION (1)
+
+/**
+ * \enum traceeventtype
+ *
+ * The traceeventtype enumeration names the events recorded.
+ */
+enum traceeventtype{
+	TRACE_RECEIVED, /**< A sayer handler received a twit; te_arg is its length */
+	TRACE_ENQUEUED, /**< A sayer handler stored a twit in the twitpool shared by the sayers */
+	TRACE_DEQUEUED, /**< The consumer took a twit out of the twitpool shared by the sayers */
+	TRACE_FANNED_OUT, /**< The consumer stored a twit in the twitpool of a hearer; te_arg is the hearer */
+	TRACE_SENT, /**< A hearer handler sent a twit; te_duration is the time spent in send() and te_arg the hearer */
+	TRACE_HEARER_BLOCKED, /**< Like TRACE_SENT, for a send() that took longer than TRACE_BLOCKED_MSEC milliseconds */
+	TRACE_EVENT_TYPES
+};
+
+/**
+ * \struct traceevent
+ *
+ * The traceevent structure is one event of a ring.
+ */
+struct traceevent{
+	uint64_t te_cycles; /**< cycles() when the event happened or, for events with a duration, started */
+	uint64_t te_twit; /**< The twit the event is about, identified by its t_received */
+	uint64_t te_duration; /**< Duration in cycles; zero for events without one */
+	uint16_t te_type; /**< One of enum traceeventtype */
+	uint16_t te_arg; /**< Depends on te_type */
+	uint32_t te_reserved;
+};
+
+/**
+ * \struct tracefileheader
+ *
+ * The tracefileheader structure starts a trace file. The pair tfh_cycles, tfh_ns relates cycles to the monotonic clock so
+ * events of different files can be placed on the same timeline.
+ */
+struct tracefileheader{
+	uint32_t tfh_magic;
+	uint32_t tfh_version;
+	double tfh_nspercycle; /**< Nanoseconds a cycle lasts */
+	uint64_t tfh_cycles; /**< cycles() when the file was written */
+	uint64_t tfh_ns; /**< monotonic_ns() when the file was written */
+	uint32_t tfh_rings; /**< Number of rings that follow */
+	uint32_t tfh_reserved;
+};
+
+/**
+ * \struct traceringheader
+ *
+ * The traceringheader structure precedes the events of a ring in a trace file.
+ */
+struct traceringheader{
+	uint32_t trh_thread; /**< Number of the thread that wrote the ring, unique in the lifetime of the server */
+	uint32_t trh_events; /**< Number of events that follow */
+	char trh_name[ TRACE_THREADNAME_MAXLEN ];
+};
+
+
+
+/**
+ * The inittrace() function shall prepare the tracing facility. It shall be called once, before any other thread is created.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception Any of the errors of the pthread_key_create() function.
+ */
+int inittrace( void );
+
+/**
+ * The tracethread() function shall give a ring to the calling thread, named by the string pointed to by parameter name. The ring
+ * is given back when the thread terminates. If no ring is free the events of the thread are not recorded.
+ *
+ * @return Nothing.
+ */
+void tracethread( const char * restrict name );
+
+/**
+ * The trace() function shall record an event of the type given as parameter, about the twit identified by parameter twit, in the
+ * ring of the calling thread. Parameter start is the value of cycles() when the event started, for events with a duration, and
+ * zero otherwise. The meaning of parameter arg depends on the type of the event.
+ *
+ * @return Nothing.
+ */
+void trace( enum traceeventtype type, uint64_t twit, uint64_t start, uint16_t arg );
+
+/**
+ * The traceanomaly() function shall ask for the rings to be written to a file. It only sets a flag, which is taken with
+ * takeanomaly(), so it can be called on any path.
+ *
+ * @return Nothing.
+ */
+void traceanomaly( void );
+
+/**
+ * The takeanomaly() function shall tell whether traceanomaly() was called since the last call to takeanomaly().
+ *
+ * @return 1 if it was; otherwise, zero.
+ */
+int takeanomaly( void );
+
+/**
+ * The flushtrace() function shall write the events of every ring to a new file, named after TRACE_FILE_PREFIX, the process
+ * and a counter, and store the name of the file in the buffer pointed to by parameter path, of size pathsize bytes.
+ * The threads keep recording while the rings are written.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EINVAL Parameter path is a NULL pointer.
+ * @exception Any of the errors of the open() and write() functions.
+ */
+int flushtrace( char * restrict path, size_t pathsize );
+
+/**
+ * The traceeventname() function shall return the name of the type of event given as parameter.
+ *
+ * @return Pointer to a string naming the type of event.
+ */
+const char *traceeventname( enum traceeventtype type );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
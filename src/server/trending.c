@@ -0,0 +1,589 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file trending.c
+ *
+ * File trending.c contains the implementation of the trending.h interface.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trending.h"
+#include "lockstats.h"
+#include "crc32c.h"
+
+// Counters of a sketch
+#define TRENDING_SKETCH_SIZE ( TRENDING_SKETCH_DEPTH * TRENDING_SKETCH_WIDTH )
+
+// Most words a twit can have counted: each takes TRENDING_WORD_MINLEN bytes and the one after it, but for the last
+#define TRENDING_TWIT_WORDS ( ( TWIT_MAXLEN + 1 ) / ( TRENDING_WORD_MINLEN + 1 ) )
+
+/**
+ * The iswordbyte() function shall check whether the byte given as parameter c can be in a word.
+ *
+ * @return Nonzero if it can, zero otherwise.
+ */
+static int iswordbyte( unsigned char c );
+
+/**
+ * The isstopword() function shall check whether the word of len bytes, in lower case, pointed to by parameter name, whose hash is
+ * given as parameter hash, is one of the commonest words of English, which are not counted.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+static int isstopword( const char * restrict name, size_t len, uint32_t hash );
+
+/**
+ * The findwords() function shall find the words of the twit of len bytes pointed to by parameter twit that are counted, each once,
+ * and store their names and hashes in the array of TRENDING_TWIT_WORDS entries pointed to by parameter found.
+ *
+ * @return The number of words found.
+ */
+static size_t findwords( const char * restrict twit, size_t len, struct trendingentry * restrict found );
+
+/**
+ * The column() function shall return the counter of row row of a sketch that the tag or the word with the hash given as parameter
+ * hash adds to.
+ *
+ * @return The counter, from zero to TRENDING_SKETCH_WIDTH - 1.
+ */
+static uint32_t column( uint32_t hash, int row );
+
+/**
+ * The estimate() function shall return the smallest of the counters the tag or the word with the hash given as parameter hash adds to
+ * in the sum of the sketches of the summary pointed to by parameter ts.
+ *
+ * @return Its count over the window.
+ */
+static uint32_t estimate( const struct trendingsummary * restrict ts, uint32_t hash );
+
+/**
+ * The tally() function shall count the tag or the word pointed to by parameter e, with its name and hash, in the sketch of the slot
+ * pos and in their sum of the summary pointed to by parameter ts, and have the summary follow it if its count is among the largest.
+ *
+ * @return Nothing.
+ */
+static void tally( struct trendingsummary * restrict ts, size_t pos, const struct trendingentry * restrict e );
+
+/**
+ * The findentry() function shall find the entry of the hash table of the summary pointed to by parameter ts that has the tag or the
+ * word with the name, the length and the hash of the one pointed to by parameter e, or the free entry it would go to.
+ *
+ * @return The entry.
+ */
+static size_t findentry( const struct trendingsummary * restrict ts, const struct trendingentry * restrict e );
+
+/**
+ * The removeentry() function shall take the entry n of the summary pointed to by parameter ts out of its hash table, moving back the
+ * entries after it that would no longer be found.
+ *
+ * @return Nothing.
+ */
+static void removeentry( struct trendingsummary * restrict ts, uint32_t n );
+
+/**
+ * The siftup() and siftdown() functions shall move the entry at position pos of the heap of the summary pointed to by parameter ts
+ * towards the top of the heap, or away from it, until its count is in order.
+ *
+ * @return Nothing.
+ */
+static void siftup( struct trendingsummary * restrict ts, uint32_t pos );
+static void siftdown( struct trendingsummary * restrict ts, uint32_t pos );
+
+/**
+ * The movewindow() function shall move the window of the struct trending object pointed to by parameter tr on to the slot given as
+ * parameter slot, if it is after the newest one, clearing the slots left behind, and take the counts of the summaries from the
+ * sketches again. It shall be called with the lock owned.
+ *
+ * @return Nothing.
+ */
+static void movewindow( struct trending * restrict tr, uint64_t slot );
+
+/**
+ * The recount() function shall take the counts of the entries of the summary pointed to by parameter ts from the sum of its
+ * sketches, free those left at zero and put the others back in the hash table and the heap.
+ *
+ * @return Nothing.
+ */
+static void recount( struct trendingsummary * restrict ts );
+
+/**
+ * The compareentries() function shall compare the entries pointed to by parameters a and b for qsort(), the one with the larger
+ * count first and then by name.
+ *
+ * @return Less than, equal to or greater than zero as a goes before, with or after b.
+ */
+static int compareentries( const void *a, const void *b );
+
+// The multipliers of the hashes of the rows; odd, so that each row takes the bits of the hash its own way
+static const uint32_t rowmultipliers[ 8 ] = {
+	0x9e3779b1u, 0x85ebca77u, 0xc2b2ae3du, 0x27d4eb2fu, 0x165667b1u, 0xd3a2646bu, 0xfd7046c5u, 0xb55a4f09u
+};
+
+// The words not counted
+static const char *const stopwords[] = {
+	"about", "after", "all", "also", "and", "any", "are", "been", "but", "can", "could", "did", "for", "from", "had", "has", "have",
+	"her", "him", "his", "how", "into", "its", "just", "like", "more", "not", "now", "one", "our", "out", "she", "some", "than",
+	"that", "the", "their", "them", "then", "there", "they", "this", "was", "were", "what", "when", "which", "who", "will", "with",
+	"would", "you", "your"
+};
+
+// One more than the words not counted, by their hashes, open addressed with linear probing; zero if free. It is filled by
+// inittrending(), before the consumer starts
+#define TRENDING_STOPWORDS_TABLE (256)
+static uint8_t stopwordtable[ TRENDING_STOPWORDS_TABLE ];
+
+
+
+int inittrending( struct trending * restrict tr ){
+	size_t entry;
+	size_t i;
+	int kind;
+
+	assert( tr != NULL );
+
+	// Filled again the same way by each call
+	for ( i = 0; i < sizeof( stopwords ) / sizeof( stopwords[ 0 ] ); ++i ){
+		for ( entry = crc32c( 0, stopwords[ i ], strlen( stopwords[ i ] ) ) & ( TRENDING_STOPWORDS_TABLE - 1 );
+			stopwordtable[ entry ] != 0 && stopwordtable[ entry ] != i + 1; entry = ( entry + 1 ) & ( TRENDING_STOPWORDS_TABLE - 1 ) ){
+			continue;
+		}
+		stopwordtable[ entry ] = ( uint8_t )( i + 1 );
+	}
+
+	( void )memset( tr, 0, sizeof( *tr ) );
+	if ( ( errno = pthread_mutex_init( &tr->tr_lock, NULL ) ) ){
+		return ( -1 );
+	}
+	for ( kind = 0; kind < TRENDING_KINDS; ++kind ){
+		if ( ( tr->tr_kinds[ kind ].ts_sketches = calloc( ( size_t )( TRENDING_WINDOW_SLOTS + 1 ) * TRENDING_SKETCH_SIZE,
+			sizeof( uint32_t ) ) ) == NULL ){
+			deltrending( tr );
+			errno = ENOMEM;
+			return ( -1 );
+		}
+	}
+
+	return ( 0 );
+}
+
+void deltrending( struct trending * restrict tr ){
+	int kind;
+
+	if ( tr != NULL ){
+		for ( kind = 0; kind < TRENDING_KINDS; ++kind ){
+			free( tr->tr_kinds[ kind ].ts_sketches );
+			tr->tr_kinds[ kind ].ts_sketches = NULL;
+		}
+		( void )pthread_mutex_destroy( &tr->tr_lock );
+	}
+
+	return ;
+}
+
+// The names are folded and hashed before the lock is taken; the tags come with their hashes, as the sayers found them
+void addtotrending( struct trending * restrict tr, uint64_t now, const char * restrict twit, size_t len, const struct twittag * restrict tags,
+	size_t count ){
+	struct trendingentry found[ TWIT_TAGS_MAXCOUNT ];
+	struct trendingentry words[ TRENDING_TWIT_WORDS ];
+	size_t nwords;
+	size_t pos;
+	size_t i;
+	size_t j;
+
+	assert( tr != NULL );
+	assert( twit != NULL );
+	assert( count <= TWIT_TAGS_MAXCOUNT );
+
+	for ( i = 0; i < count; ++i ){
+		for ( j = 0; j < tags[ i ].tt_len; ++j ){
+			found[ i ].te_name[ j ] = ( char )( ( twit[ tags[ i ].tt_offset + j ] >= 'A' && twit[ tags[ i ].tt_offset + j ] <= 'Z' ) ?
+				twit[ tags[ i ].tt_offset + j ] - 'A' + 'a' : twit[ tags[ i ].tt_offset + j ] );
+		}
+		found[ i ].te_len = tags[ i ].tt_len;
+		found[ i ].te_hash = tags[ i ].tt_hash;
+	}
+	nwords = findwords( twit, len, words );
+
+	lock_mutex( LOCK_TRENDING, &tr->tr_lock, &tr->tr_lockedat );
+	movewindow( tr, now / ( ( uint64_t )TRENDING_SLOT_SEC * 1000000000u ) );
+	pos = ( size_t )( tr->tr_slot % TRENDING_WINDOW_SLOTS );
+	for ( i = 0; i < count; ++i ){
+		tally( &tr->tr_kinds[ TRENDING_TAGS ], pos, &found[ i ] );
+	}
+	for ( i = 0; i < nwords; ++i ){
+		tally( &tr->tr_kinds[ TRENDING_WORDS ], pos, &words[ i ] );
+	}
+	( void )__atomic_fetch_add( &tr->tr_kinds[ TRENDING_TAGS ].ts_counted, count, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &tr->tr_kinds[ TRENDING_WORDS ].ts_counted, nwords, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &tr->tr_twits, 1, __ATOMIC_RELAXED );
+	unlock_mutex( LOCK_TRENDING, &tr->tr_lock, &tr->tr_lockedat );
+
+	return ;
+}
+
+// The summary is copied with the lock owned and sorted after it is released, so the consumer waits for a few kilobytes at most
+size_t gettrending( struct trending * restrict tr, uint64_t now, enum trendingkind kind, struct trendingentry * restrict top, size_t max,
+	uint64_t * restrict total ){
+	struct trendingentry entries[ TRENDING_MONITORED ];
+	const struct trendingsummary *ts = NULL;
+	size_t used;
+	size_t count;
+
+	assert( tr != NULL );
+	assert( kind >= 0 && kind < TRENDING_KINDS );
+	assert( top != NULL || max == 0 );
+
+	lock_mutex( LOCK_TRENDING, &tr->tr_lock, &tr->tr_lockedat );
+	movewindow( tr, now / ( ( uint64_t )TRENDING_SLOT_SEC * 1000000000u ) );
+	ts = &tr->tr_kinds[ kind ];
+	used = ts->ts_used;
+	( void )memcpy( entries, ts->ts_entries, used * sizeof( *entries ) );
+	if ( total != NULL ){
+		*total = ts->ts_windowcount;
+	}
+	unlock_mutex( LOCK_TRENDING, &tr->tr_lock, &tr->tr_lockedat );
+
+	qsort( entries, used, sizeof( *entries ), &compareentries );
+	for ( count = 0; count < max && count < used && entries[ count ].te_count > 0; ++count ){
+		top[ count ] = entries[ count ];
+	}
+
+	return ( count );
+}
+
+size_t trendingmemory( void ){
+	return ( sizeof( struct trending ) + ( size_t )TRENDING_KINDS * ( TRENDING_WINDOW_SLOTS + 1 ) * TRENDING_SKETCH_SIZE * sizeof( uint32_t ) );
+}
+
+
+
+// Implementation of local functions...
+
+static int iswordbyte( unsigned char c ){
+	return ( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) || c >= 0x80 );
+}
+
+// The hash of the word is needed anyway, so the words are looked up by it; most are not there and stop at the first free entry
+static int isstopword( const char * restrict name, size_t len, uint32_t hash ){
+	const char *word = NULL;
+	size_t entry;
+
+	for ( entry = hash & ( TRENDING_STOPWORDS_TABLE - 1 ); stopwordtable[ entry ] != 0; entry = ( entry + 1 ) & ( TRENDING_STOPWORDS_TABLE - 1 ) ){
+		word = stopwords[ stopwordtable[ entry ] - 1 ];
+		if ( strncmp( word, name, len ) == 0 && word[ len ] == '\0' ){
+			return ( 1 );
+		}
+	}
+
+	return ( 0 );
+}
+
+// A word repeated in the twit is found once; there are few words, so the ones before are looked through
+static size_t findwords( const char * restrict twit, size_t len, struct trendingentry * restrict found ){
+	const unsigned char *p = ( const unsigned char * )twit;
+	struct trendingentry *e = NULL;
+	size_t count = 0;
+	size_t start;
+	size_t i;
+	size_t j;
+
+	for ( i = 0; i < len && count < TRENDING_TWIT_WORDS; ){
+		for ( ; i < len && !iswordbyte( p[ i ] ); ++i ){
+			continue;
+		}
+		for ( start = i; i < len && iswordbyte( p[ i ] ); ++i ){
+			continue;
+		}
+		if ( i - start < TRENDING_WORD_MINLEN || i - start > SEARCH_WORD_MAXLEN ){
+			continue;
+		}
+		e = &found[ count ];
+		for ( j = start; j < i; ++j ){
+			e->te_name[ j - start ] = ( char )( p[ j ] >= 'A' && p[ j ] <= 'Z' ? p[ j ] + ( 'a' - 'A' ) : p[ j ] );
+		}
+		e->te_len = ( uint32_t )( i - start );
+		e->te_hash = crc32c( 0, e->te_name, e->te_len );
+		if ( isstopword( e->te_name, e->te_len, e->te_hash ) ){
+			continue;
+		}
+		for ( j = 0; j < count && ( found[ j ].te_hash != e->te_hash || found[ j ].te_len != e->te_len ||
+			memcmp( found[ j ].te_name, e->te_name, e->te_len ) != 0 ); ++j ){
+			continue;
+		}
+		if ( j == count ){
+			++count;
+		}
+	}
+
+	return ( count );
+}
+
+// The high bits of the product depend on all the bits of the hash; they are taken to the width by a multiplication, not a division
+static uint32_t column( uint32_t hash, int row ){
+	return ( ( uint32_t )( ( ( uint64_t )( uint32_t )( hash * rowmultipliers[ row ] ) * TRENDING_SKETCH_WIDTH ) >> 32 ) );
+}
+
+static uint32_t estimate( const struct trendingsummary * restrict ts, uint32_t hash ){
+	const uint32_t *sum = ts->ts_sketches + ( size_t )TRENDING_WINDOW_SLOTS * TRENDING_SKETCH_SIZE;
+	uint32_t least = UINT32_MAX;
+	uint32_t c;
+	int row;
+
+	for ( row = 0; row < TRENDING_SKETCH_DEPTH; ++row ){
+		if ( ( c = sum[ row * TRENDING_SKETCH_WIDTH + column( hash, row ) ] ) < least ){
+			least = c;
+		}
+	}
+
+	return ( least );
+}
+
+// The estimate is found as the counters are added to. A tag not followed whose estimate is not above the smallest count followed is
+// left to the sketch; the summary is looked up first, as the tags most often counted are the ones followed
+static void tally( struct trendingsummary * restrict ts, size_t pos, const struct trendingentry * restrict e ){
+	uint32_t *slot = ts->ts_sketches + pos * TRENDING_SKETCH_SIZE;
+	uint32_t *sum = ts->ts_sketches + ( size_t )TRENDING_WINDOW_SLOTS * TRENDING_SKETCH_SIZE;
+	struct trendingentry *te = NULL;
+	uint32_t least = UINT32_MAX;
+	uint32_t at;
+	uint32_t n;
+	size_t entry;
+	int replaced = 0;
+	int row;
+
+	for ( row = 0; row < TRENDING_SKETCH_DEPTH; ++row ){
+		at = ( uint32_t )row * TRENDING_SKETCH_WIDTH + column( e->te_hash, row );
+		++slot[ at ];
+		if ( ++sum[ at ] < least ){
+			least = sum[ at ];
+		}
+	}
+	++ts->ts_slotcounts[ pos ];
+	++ts->ts_windowcount;
+
+	entry = findentry( ts, e );
+	if ( ts->ts_table[ entry ] != 0 ){
+		te = &ts->ts_entries[ ts->ts_table[ entry ] - 1 ];
+		te->te_count = least;
+		siftdown( ts, te->te_heap );
+		return ;
+	}
+	if ( ts->ts_used < TRENDING_MONITORED ){
+		n = ts->ts_used++;
+		te = &ts->ts_entries[ n ];
+		te->te_heap = n;
+		ts->ts_heap[ n ] = ( uint16_t )n;
+	}
+	else{
+		n = ts->ts_heap[ 0 ];
+		te = &ts->ts_entries[ n ];
+		if ( least <= te->te_count ){
+			return ;
+		}
+		// The entry leaves the table, which may move those after it, so the free one is looked for again
+		removeentry( ts, n );
+		entry = findentry( ts, e );
+		replaced = 1;
+		( void )__atomic_fetch_add( &ts->ts_replaced, 1, __ATOMIC_RELAXED );
+	}
+	( void )memcpy( te->te_name, e->te_name, e->te_len );
+	te->te_len = e->te_len;
+	te->te_hash = e->te_hash;
+	te->te_count = least;
+	ts->ts_table[ entry ] = ( uint16_t )( n + 1 );
+	// A new entry goes up from the bottom of the heap, and the one given to another tag down from the top
+	if ( replaced ){
+		siftdown( ts, te->te_heap );
+	}
+	else{
+		siftup( ts, te->te_heap );
+	}
+
+	return ;
+}
+
+static size_t findentry( const struct trendingsummary * restrict ts, const struct trendingentry * restrict e ){
+	const struct trendingentry *te = NULL;
+	size_t entry;
+
+	for ( entry = e->te_hash & ( TRENDING_TABLE_SIZE - 1 ); ts->ts_table[ entry ] != 0; entry = ( entry + 1 ) & ( TRENDING_TABLE_SIZE - 1 ) ){
+		te = &ts->ts_entries[ ts->ts_table[ entry ] - 1 ];
+		if ( te->te_hash == e->te_hash && te->te_len == e->te_len && memcmp( te->te_name, e->te_name, e->te_len ) == 0 ){
+			break;
+		}
+	}
+
+	return ( entry );
+}
+
+// An entry after the one removed moves back to its place unless its home is after that place, going round the end of the table
+static void removeentry( struct trendingsummary * restrict ts, uint32_t n ){
+	size_t hole;
+	size_t entry;
+	size_t home;
+
+	for ( hole = ts->ts_entries[ n ].te_hash & ( TRENDING_TABLE_SIZE - 1 ); ts->ts_table[ hole ] != n + 1;
+		hole = ( hole + 1 ) & ( TRENDING_TABLE_SIZE - 1 ) ){
+		assert( ts->ts_table[ hole ] != 0 );
+	}
+	for ( entry = ( hole + 1 ) & ( TRENDING_TABLE_SIZE - 1 ); ts->ts_table[ entry ] != 0; entry = ( entry + 1 ) & ( TRENDING_TABLE_SIZE - 1 ) ){
+		home = ts->ts_entries[ ts->ts_table[ entry ] - 1 ].te_hash & ( TRENDING_TABLE_SIZE - 1 );
+		if ( ( ( entry - home ) & ( TRENDING_TABLE_SIZE - 1 ) ) >= ( ( entry - hole ) & ( TRENDING_TABLE_SIZE - 1 ) ) ){
+			ts->ts_table[ hole ] = ts->ts_table[ entry ];
+			hole = entry;
+		}
+	}
+	ts->ts_table[ hole ] = 0;
+
+	return ;
+}
+
+static void siftup( struct trendingsummary * restrict ts, uint32_t pos ){
+	uint16_t n = ts->ts_heap[ pos ];
+	uint32_t parent;
+
+	while ( pos > 0 && ts->ts_entries[ ts->ts_heap[ parent = ( pos - 1 ) / 2 ] ].te_count > ts->ts_entries[ n ].te_count ){
+		ts->ts_heap[ pos ] = ts->ts_heap[ parent ];
+		ts->ts_entries[ ts->ts_heap[ pos ] ].te_heap = pos;
+		pos = parent;
+	}
+	ts->ts_heap[ pos ] = n;
+	ts->ts_entries[ n ].te_heap = pos;
+
+	return ;
+}
+
+static void siftdown( struct trendingsummary * restrict ts, uint32_t pos ){
+	uint16_t n = ts->ts_heap[ pos ];
+	uint32_t child;
+
+	while ( ( child = 2 * pos + 1 ) < ts->ts_used ){
+		if ( child + 1 < ts->ts_used && ts->ts_entries[ ts->ts_heap[ child + 1 ] ].te_count < ts->ts_entries[ ts->ts_heap[ child ] ].te_count ){
+			++child;
+		}
+		if ( ts->ts_entries[ ts->ts_heap[ child ] ].te_count >= ts->ts_entries[ n ].te_count ){
+			break;
+		}
+		ts->ts_heap[ pos ] = ts->ts_heap[ child ];
+		ts->ts_entries[ ts->ts_heap[ pos ] ].te_heap = pos;
+		pos = child;
+	}
+	ts->ts_heap[ pos ] = n;
+	ts->ts_entries[ n ].te_heap = pos;
+
+	return ;
+}
+
+// A slot left behind is taken off the sum and cleared; should the window have moved past all of them, everything is cleared at once
+static void movewindow( struct trending * restrict tr, uint64_t slot ){
+	struct trendingsummary *ts = NULL;
+	uint32_t *sum = NULL;
+	uint32_t *old = NULL;
+	uint64_t step;
+	size_t pos;
+	size_t i;
+	int kind;
+
+	if ( slot <= tr->tr_slot ){
+		return ;
+	}
+	for ( kind = 0; kind < TRENDING_KINDS; ++kind ){
+		ts = &tr->tr_kinds[ kind ];
+		sum = ts->ts_sketches + ( size_t )TRENDING_WINDOW_SLOTS * TRENDING_SKETCH_SIZE;
+		if ( slot - tr->tr_slot >= TRENDING_WINDOW_SLOTS ){
+			( void )memset( ts->ts_sketches, 0, ( size_t )( TRENDING_WINDOW_SLOTS + 1 ) * TRENDING_SKETCH_SIZE * sizeof( uint32_t ) );
+			( void )memset( ts->ts_slotcounts, 0, sizeof( ts->ts_slotcounts ) );
+			ts->ts_windowcount = 0;
+		}
+		else{
+			for ( step = tr->tr_slot + 1; step <= slot; ++step ){
+				pos = ( size_t )( step % TRENDING_WINDOW_SLOTS );
+				old = ts->ts_sketches + pos * TRENDING_SKETCH_SIZE;
+				for ( i = 0; i < TRENDING_SKETCH_SIZE; ++i ){
+					sum[ i ] -= old[ i ];
+				}
+				( void )memset( old, 0, TRENDING_SKETCH_SIZE * sizeof( uint32_t ) );
+				ts->ts_windowcount -= ts->ts_slotcounts[ pos ];
+				ts->ts_slotcounts[ pos ] = 0;
+			}
+		}
+		recount( ts );
+	}
+	tr->tr_slot = slot;
+	( void )__atomic_fetch_add( &tr->tr_moves, 1, __ATOMIC_RELAXED );
+
+	return ;
+}
+
+// The entries kept are moved to the front, in the order they were, and made a heap from the bottom up
+static void recount( struct trendingsummary * restrict ts ){
+	struct trendingentry *te = NULL;
+	size_t entry;
+	uint32_t kept = 0;
+	uint32_t n;
+
+	( void )memset( ts->ts_table, 0, sizeof( ts->ts_table ) );
+	for ( n = 0; n < ts->ts_used; ++n ){
+		te = &ts->ts_entries[ n ];
+		if ( ( te->te_count = estimate( ts, te->te_hash ) ) == 0 ){
+			continue;
+		}
+		if ( kept != n ){
+			ts->ts_entries[ kept ] = *te;
+		}
+		entry = findentry( ts, &ts->ts_entries[ kept ] );
+		ts->ts_table[ entry ] = ( uint16_t )( kept + 1 );
+		ts->ts_heap[ kept ] = ( uint16_t )kept;
+		ts->ts_entries[ kept ].te_heap = kept;
+		++kept;
+	}
+	ts->ts_used = kept;
+	for ( n = kept / 2; n > 0; --n ){
+		siftdown( ts, n - 1 );
+	}
+
+	return ;
+}
+
+static int compareentries( const void *a, const void *b ){
+	const struct trendingentry *ea = ( const struct trendingentry * )a;
+	const struct trendingentry *eb = ( const struct trendingentry * )b;
+	int order;
+
+	if ( ea->te_count != eb->te_count ){
+		return ( ea->te_count > eb->te_count ? -1 : 1 );
+	}
+	if ( ( order = memcmp( ea->te_name, eb->te_name, ea->te_len < eb->te_len ? ea->te_len : eb->te_len ) ) != 0 ){
+		return ( order );
+	}
+
+	return ( ea->te_len < eb->te_len ? -1 : ea->te_len > eb->te_len );
+}
@@ -0,0 +1,190 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file trending.h
+ *
+ * File trending.h declares what is trending: the hashtags and mentions (see tags.h) and the words of the twits seen most often over
+ * the last TRENDING_WINDOW_SLOTS slots of TRENDING_SLOT_SEC seconds, which the clients of TRENDS_PORT ask for (see trendsframe.h).
+ * A word is as fulltext.h has it, but of TRENDING_WORD_MINLEN bytes at least and none of the commonest words of English, which would
+ * be at the top all the time. A twit counts once for each of its tags and words, however many times it has them.
+ *
+ * The tags and the words are counted apart, each in a count-min sketch: TRENDING_SKETCH_DEPTH rows of TRENDING_SKETCH_WIDTH counters,
+ * a tag adding one to a counter of each row picked by a hash of its own, so that the smallest of those is its count, or a bit more
+ * when other tags share its counters, never less. There is a sketch for each slot of the window and one that is their sum, from
+ * which the counts are taken; as a slot is left behind its sketch is taken off the sum and cleared for the slot to come. The sketches
+ * take the same memory however many tags there are, and a tag costs a few counters of each, whose estimate is found as they are added
+ * to.
+ *
+ * The sketch does not know the tags, so the most frequent ones are followed by a space-saving summary of TRENDING_MONITORED of them,
+ * kept in a heap by their counts, with a small hash table from their names. The counts of the summary are the estimates of the sketch
+ * over the window rather than counts of its own, so that they go down as the window moves: a tag followed gets its count from the
+ * sketch each time it is seen, and a tag not followed takes the place of the one with the smallest count once its estimate goes
+ * above it. As a slot is left behind the counts of the summary are all taken from the sketch again, and those left at zero make room.
+ * A tag seen often enough in the window is always followed, and what is trending is the summary, from the largest count.
+ *
+ * The counts are guarded by tr_lock. The consumer adds each twit with the lock owned, and the clients take a copy of the summary.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( TRENDING_H_IS_INCLUDED )
+#define TRENDING_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "twit.h"
+#include "config.h"
+
+// The shortest word counted
+#define TRENDING_WORD_MINLEN (3)
+
+// The longest name of what is counted: a tag with its '#' or '@', or a word
+#define TRENDING_NAME_MAXLEN ( TAG_NAME_MAXLEN + 1 > SEARCH_WORD_MAXLEN ? TAG_NAME_MAXLEN + 1 : SEARCH_WORD_MAXLEN )
+
+// Entries of the hash table of a summary; a power of two at least twice TRENDING_MONITORED
+#define TRENDING_TABLE_SIZE (1024)
+
+#if TRENDING_TABLE_SIZE < 2 * TRENDING_MONITORED || ( TRENDING_TABLE_SIZE & ( TRENDING_TABLE_SIZE - 1 ) ) || TRENDING_MONITORED > 65535
+#error "TRENDING_TABLE_SIZE must be a power of two at least twice TRENDING_MONITORED, which must be below 65536"
+#endif
+
+#if TRENDING_SKETCH_DEPTH < 1 || TRENDING_SKETCH_DEPTH > 8
+#error "TRENDING_SKETCH_DEPTH must be from 1 to 8"
+#endif
+
+/**
+ * \enum trendingkind
+ *
+ * The trendingkind enumeration names what is counted.
+ */
+enum trendingkind{
+	TRENDING_TAGS, /**< The hashtags and the mentions */
+	TRENDING_WORDS, /**< The words */
+	TRENDING_KINDS
+};
+
+/**
+ * \struct trendingentry
+ *
+ * The trendingentry structure is a tag or a word followed by a summary, with its count over the window.
+ */
+struct trendingentry{
+	char te_name[ TRENDING_NAME_MAXLEN ]; /**< In lower case; not nul-terminated */
+	uint32_t te_len;
+	uint32_t te_hash;
+	uint32_t te_count; /**< The estimate of the sketch */
+	uint32_t te_heap; /**< Where it is in ts_heap */
+};
+
+/**
+ * \struct trendingsummary
+ *
+ * The trendingsummary structure counts the tags or the words: the sketches of the slots and the summary of the most frequent ones.
+ */
+struct trendingsummary{
+	uint32_t *ts_sketches; /**< TRENDING_WINDOW_SLOTS + 1 sketches of TRENDING_SKETCH_DEPTH rows: one for each slot, then their sum */
+	uint64_t ts_slotcounts[ TRENDING_WINDOW_SLOTS ]; /**< Tags or words counted in each slot */
+	uint64_t ts_windowcount; /**< Their sum */
+	struct trendingentry ts_entries[ TRENDING_MONITORED ];
+	uint32_t ts_used; /**< Entries taken */
+	uint16_t ts_heap[ TRENDING_MONITORED ]; /**< The entries taken, as a heap with the smallest count first */
+	uint16_t ts_table[ TRENDING_TABLE_SIZE ]; /**< One more than the entries, open addressed with linear probing; zero if free */
+	uint64_t ts_counted; /**< Tags or words ever counted */
+	uint64_t ts_replaced; /**< Entries given to another tag or word */
+};
+
+/**
+ * \struct trending
+ *
+ * The trending structure counts the tags and the words of the twits. The counters of the statistics are updated atomically, so they
+ * are read without the lock.
+ */
+struct trending{
+	pthread_mutex_t tr_lock;
+	uint64_t tr_lockedat;
+	uint64_t tr_slot; /**< The newest slot, counted from when monotonic_ns() started */
+	struct trendingsummary tr_kinds[ TRENDING_KINDS ];
+	uint64_t tr_twits; /**< Twits ever added */
+	uint64_t tr_moves; /**< Times the window moved */
+};
+
+
+
+/**
+ * The inittrending() function shall initialize the struct trending object pointed to by parameter tr, with nothing counted.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate
+ *	the error.
+ * @exception ENOMEM There is not enough memory for the sketches.
+ */
+int inittrending( struct trending * restrict tr );
+
+/**
+ * The deltrending() function shall free the memory of the struct trending object pointed to by parameter tr.
+ *
+ * @return Nothing.
+ */
+void deltrending( struct trending * restrict tr );
+
+/**
+ * The addtotrending() function shall count, in the struct trending object pointed to by parameter tr, the count tags pointed to
+ * by parameter tags and the words of the twit of len bytes pointed to by parameter twit, which has them, at the time given as
+ * parameter now, as returned by monotonic_ns(), moving the window on first if now is in a slot after it.
+ *
+ * @return Nothing.
+ */
+void addtotrending( struct trending * restrict tr, uint64_t now, const char * restrict twit, size_t len, const struct twittag * restrict tags,
+	size_t count );
+
+/**
+ * The gettrending() function shall store in the array pointed to by parameter top the max tags or words, as parameter kind says,
+ * with the largest counts over the window of the struct trending object pointed to by parameter tr at the time given as parameter
+ * now, largest first, and in the object pointed to by parameter total, if it is not a NULL pointer, how many were counted over the
+ * window in all.
+ *
+ * @return The number of tags or words stored; those counted zero times are left out.
+ */
+size_t gettrending( struct trending * restrict tr, uint64_t now, enum trendingkind kind, struct trendingentry * restrict top, size_t max,
+	uint64_t * restrict total );
+
+/**
+ * The trendingmemory() function shall return the bytes the struct trending object takes, with its sketches, however many tags
+ * and words it counts.
+ *
+ * @return The number of bytes.
+ */
+size_t trendingmemory( void );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -0,0 +1,276 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file trends.c
+ *
+ * File trends.c contains the implementation of the trends.h interface.
+ *
+ * The clients are answered one at a time by the thread that accepts them, as those of the search are; an answer is a copy of a
+ * summary of a few kilobytes, so the consumer is held up for no longer than that. The socket timeouts (TRENDS_WAIT_NSEC) stop a slow
+ * client from holding the thread for long.
+ *
+ * @author Tassos Souris
+ */
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include "serverinfo.h"
+#include "trending.h"
+#include "timing.h"
+#include "listen.h"
+#include "trends.h"
+#include "trendsframe.h"
+#include "config.h"
+#include "util.h"
+#include "error.h"
+
+/**
+ * \struct trendsinfo
+ *
+ * The trendsinfo structure keeps the resources of the trendsListener thread so as they can be released by the cleanup handler.
+ */
+struct trendsinfo{
+	struct serverinfo *ti_serverinfo;
+	int ti_sockfd;
+	int ti_connsockfd;
+};
+
+
+
+/**
+ * The setupTrendsListener() shall perform all the necessary actions for the preparation of the trendsListener thread.
+ * The setupTrendsListener() function shall receive as argument a pointer to a struct trendsinfo object.
+ *
+ * @return Nothing.
+ */
+static void setupTrendsListener( void *arg );
+
+/**
+ * The cleanupTrendsListener() function is responsible for cleaning up the resources associated with the trendsListener thread.
+ * The cleanupTrendsListener() function shall receive as argument a pointer to a struct trendsinfo object.
+ *
+ * @return Nothing.
+ */
+static void cleanupTrendsListener( void *arg );
+
+/**
+ * The servetrends() function shall read the request of the client connected at the socket given as parameter and send the tags or
+ * the words trending in the server described by parameter si.
+ *
+ * @return The servetrends() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int servetrends( struct serverinfo * restrict si, int sockfd );
+
+/**
+ * The readtrends() function shall read the request line of trendsframe.h from the socket given as parameter and store in the objects
+ * pointed to by parameters kind and max what it asks for.
+ *
+ * @return The readtrends() function shall return zero if successful; otherwise, -1 shall be returned.
+ */
+static int readtrends( int sockfd, enum trendingkind * restrict kind, size_t * restrict max );
+
+
+
+/**
+ * trendsListener() runs on its own thread and is responsible for answering what is trending.
+ * The port to which the trendsListener() function will listen is obtained from config.h (TRENDS_PORT).
+ * The steps the trendsListener() function takes are:
+ *	1) The socket that will listen at the port TRENDS_PORT is created.
+ *	2) If successfull (the above step) the trendsListener() function notifies through the serverinfo structure
+ *	passed as parameter that is prepared.
+ *	3) It waits for a connection and when one arrives it answers the request and closes the connection.
+ */
+void *trendsListener( void *arg ){
+	struct serverinfo *si = ( struct serverinfo * )arg;
+	struct trendsinfo ti = {
+		.ti_serverinfo = si,
+		.ti_sockfd = -1,
+		.ti_connsockfd = -1
+	};
+
+	assert( si != NULL );
+
+	// POSIX says that pthread_cleanup_push() and pthread_cleanup_pop() must appear as statements
+	// and in pairs within the same lexical scope so pthread_cleanup_push() must be put here
+ 	// and not in setupTrendsListener()
+	pthread_cleanup_push( &cleanupTrendsListener, &ti );
+	setupTrendsListener( &ti );
+
+	// Wait for connections
+	while ( 1 ){
+		errno = 0;
+		if ( ( ti.ti_connsockfd = accept( ti.ti_sockfd, NULL, NULL ) ) == -1 ){
+			error( "accept() failed in trendsListener() (%s)\n", strerror( errno ) );
+			continue;
+		}
+		( void )servetrends( si, ti.ti_connsockfd );
+		( void )safe_close( ti.ti_connsockfd );
+		ti.ti_connsockfd = -1;
+	}
+
+	// Perform cleanup
+	pthread_cleanup_pop( 1 );
+
+	// Not Reached
+	pthread_exit( NULL );
+}
+
+
+
+// Implementation of local functions...
+
+// Setup the trends listener
+static void setupTrendsListener( void *arg ){
+	struct trendsinfo *ti = ( struct trendsinfo * )arg;
+
+	assert( ti != NULL );
+
+	// Prepare the socket to listen for the clients of the trends
+	errno = 0;
+	if ( ( ti->ti_sockfd = listenerSocket( ti->ti_serverinfo, LISTEN_TRENDS ) ) == -1 ){
+		error( "failed to prepare the socket for the trends in trendsListener() (%s)\n", strerror( errno ) );
+		// Could not prepare so now inform about the status and terminate
+		signal_prepared_status( ti->ti_serverinfo, 0 );
+		pthread_exit( NULL );
+	}
+	// The preparation is successful
+	signal_prepared_status( ti->ti_serverinfo, 1 );
+
+	return ;
+}
+
+// Cleanup the trends listener
+static void cleanupTrendsListener( void *arg ){
+	struct trendsinfo *ti = ( struct trendsinfo * )arg;
+
+	assert( ti != NULL );
+
+	// Cleanup code
+	if ( ti->ti_connsockfd != -1 ){
+		( void )safe_close( ti->ti_connsockfd );
+	}
+	if ( ti->ti_sockfd != -1 ){
+		( void )safe_close( ti->ti_sockfd );
+	}
+
+	return ;
+}
+
+// The lines go out in one write; a request the server does not take gets the connection closed
+static int servetrends( struct serverinfo * restrict si, int sockfd ){
+	struct trendingentry top[ TRENDING_RESULTS_MAXCOUNT ];
+	char lines[ TRENDING_RESULTS_MAXCOUNT * ( TRENDING_NAME_MAXLEN + 12 ) ];
+	struct timeval timeout;
+	enum trendingkind kind;
+	size_t max;
+	size_t count;
+	size_t len = 0;
+	size_t i;
+
+	assert( si != NULL );
+
+	// Do not let a slow client hold the thread
+	( void )memset( &timeout, 0, sizeof( timeout ) );
+	timeout.tv_sec = ( time_t )TRENDS_WAIT_NSEC;
+	timeout.tv_usec = ( suseconds_t )0;
+	( void )setsockopt( sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+	( void )setsockopt( sockfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+
+	if ( readtrends( sockfd, &kind, &max ) == -1 ){
+		return ( -1 );
+	}
+	count = gettrending( &si->si_trending, monotonic_ns(), kind, top, max, NULL );
+	for ( i = 0; i < count; ++i ){
+		len += ( size_t )snprintf( lines + len, sizeof( lines ) - len, "%.*s %lu\n", ( int )top[ i ].te_len, top[ i ].te_name,
+			( unsigned long )top[ i ].te_count );
+	}
+	( void )__atomic_fetch_add( &si->si_trendsqueries, 1, __ATOMIC_RELAXED );
+	if ( len > 0 && writeall( sockfd, lines, len ) == -1 ){
+		return ( -1 );
+	}
+	( void )shutdown( sockfd, SHUT_WR );
+
+	return ( 0 );
+}
+
+// One byte at a time so nothing after the newline is taken, as with the searches
+static int readtrends( int sockfd, enum trendingkind * restrict kind, size_t * restrict max ){
+	char line[ TRENDSFRAME_REQUEST_MAXLEN + 1 ];
+	const char *number = NULL;
+	char *end = NULL;
+	unsigned long value;
+	size_t len = 0;
+	ssize_t nread;
+
+	do{
+		if ( len == TRENDSFRAME_REQUEST_MAXLEN ){
+			errno = EPROTO;
+			return ( -1 );
+		}
+		errno = 0;
+		if ( ( nread = recv( sockfd, line + len, 1, 0 ) ) == -1 ){
+			if ( errno == EINTR ){
+				continue;
+			}
+			return ( -1 );
+		}
+		else if ( nread == 0 ){
+			errno = EPROTO;
+			return ( -1 );
+		}
+	}while ( line[ len++ ] != '\n' );
+	line[ len - 1 ] = '\0';
+
+	if ( strncmp( line, TRENDSFRAME_TAGS, sizeof( TRENDSFRAME_TAGS ) - 1 ) == 0 ){
+		*kind = TRENDING_TAGS;
+		number = line + sizeof( TRENDSFRAME_TAGS ) - 1;
+	}
+	else if ( strncmp( line, TRENDSFRAME_WORDS, sizeof( TRENDSFRAME_WORDS ) - 1 ) == 0 ){
+		*kind = TRENDING_WORDS;
+		number = line + sizeof( TRENDSFRAME_WORDS ) - 1;
+	}
+	else{
+		errno = EPROTO;
+		return ( -1 );
+	}
+	errno = 0;
+	value = strtoul( number, &end, 10 );
+	if ( errno || end == number || *end != '\0' || value == 0 || value > TRENDING_RESULTS_MAXCOUNT ){
+		errno = EPROTO;
+		return ( -1 );
+	}
+	*max = ( size_t )value;
+
+	return ( 0 );
+}
@@ -0,0 +1,59 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file trendsframe.h
+ *
+ * File trendsframe.h defines what a client connected to TRENDS_PORT and the server send each other. The client sends one request
+ * line, at most TRENDSFRAME_REQUEST_MAXLEN bytes with the newline:
+ *	"TAGS n\n" for the n hashtags and mentions seen most often in the twits of the last 10 minutes
+ *	"WORDS n\n" for the n words seen most often in them
+ * n from 1 to 50. The server sends a line for each, from the one seen most often: its name in lower case, a space and the number
+ * of twits it was in, as "#rain 42\n", and closes the connection; it closes it at once for a request it does not take. The numbers
+ * are estimates that may be a bit larger than they should (see trending.h), and a tag or a word seen rarely is not sent.
+ *
+ * This header is shared with the clients so it only holds macros.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( TRENDSFRAME_H_IS_INCLUDED )
+#define TRENDSFRAME_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#define TRENDSFRAME_REQUEST_MAXLEN (16)
+
+#define TRENDSFRAME_TAGS "TAGS "
+
+#define TRENDSFRAME_WORDS "WORDS "
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
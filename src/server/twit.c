@@ -62,6 +62,15 @@ int filltwit( struct twit * restrict t,
 	// Store results back in the twit structure
 	t->t_twit = twit;
 	t->t_twitlen = len;
+	t->t_received = 0;
+	t->t_dequeued = 0;
+	t->t_enqueued = 0;
+	t->t_seq = 0;
+	t->t_durable = 0;
+	t->t_logged = 0;
+	t->t_topiclen = 0;
+	t->t_topichash = 0;
+	t->t_tagcount = 0;
 
 	return ( 0 );
 }
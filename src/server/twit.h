@@ -37,15 +37,41 @@ extern "C"{
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+/**
+ * \struct twittag
+ *
+ * The twittag structure is a hashtag or a mention found in a twit, as twittags() finds them (see tags.h).
+ */
+struct twittag{
+	uint32_t tt_hash; /**< Hash of the tag in lower case */
+	uint8_t tt_offset; /**< Where its '#' or '@' is in the twit */
+	uint8_t tt_len; /**< Its length, the '#' or '@' included */
+};
 
 /**
  * \struct twit
  *
  * The twit structure is an object capable of storing a single twit.
+ *
+ * Besides the twit itself it carries the times, as returned by monotonic_ns(), at which the twit passed through the stages
+ * of the server. Those are used to measure the latency of each stage.
  */
 struct twit{
 	char * restrict t_twit; /**< Pointer to the twit */
 	size_t t_twitlen; /**< Lenght of the twit */
+	uint64_t t_received; /**< When the twit was received from the sayer */
+	uint64_t t_dequeued; /**< When the twit left the twitpool shared by the sayers */
+	uint64_t t_enqueued; /**< When the twit entered the twitpool of a hearer */
+	uint64_t t_seq; /**< Sequence number in the twit log, given by nexttwitlogseq() when the twit is stored; zero if none */
+	int t_durable; /**< Whether the sayer waits for the twit to be synced to the twit log */
+	uint64_t t_logged; /**< Time of its record in the twit log, in nanoseconds since the Epoch, set by appendtwitlog() */
+	size_t t_topiclen; /**< Length of the name of the topic, which starts at t_twit + 1; zero for the global topic (see topicframe.h) */
+	uint32_t t_topichash; /**< Hash of the name of the topic, as twittopic() gives it */
+	struct twittag t_tags[ TWIT_TAGS_MAXCOUNT ]; /**< The hashtags and mentions in the twit, each once, as twittags() finds them */
+	size_t t_tagcount;
 };
 
 /**
@@ -0,0 +1,2813 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file twitlog.c
+ *
+ * File twitlog.c contains the implementation of the twitlog.h interface.
+ *
+ * The appender and the writer share two buffers. The appender encodes each record at the end of tl_buffer[ tl_active ];
+ * the writer, when that buffer is not empty, makes the other one active and writes the records of the one it took while the
+ * appender goes on. So the lock is only held to copy a record or to swap the buffers, never while writing or syncing.
+ *
+ * Threads waiting for durable twits in waittwitlog() are counted in tl_waiting. While there are any, the writer syncs after
+ * every write whatever the policy, and before it takes the buffer it waits up to TWITLOG_COMMIT_USEC microseconds for the
+ * twits they wait for that are not in the buffer yet. One sync then serves every twit in the buffer (group commit) and the
+ * twits handed over during the sync go in the next one, so the more sayers wait the more twits each sync serves.
+ *
+ * When the log is opened every segment is checked, by up to TWITLOG_RECOVERY_THREADS threads that each take the next segment
+ * not checked yet. A segment is mapped in memory and its records are decoded one after the other, which checks their CRC-32C
+ * (with the crc32 instruction where the processor has it, see crc32c.c), until the first one that is not whole and valid. What
+ * follows in the newest segment is what a crash left half written and is cut off; in an older segment it is damage and is left
+ * for someone to look at.
+ *
+ * The cleaner, started by retaintwitlog(), only lists, removes and renames files; the writer only writes the newest segment,
+ * which the cleaner never touches. A segment is compacted into a new file that takes the place of the old one with rename(),
+ * its index first: a reader that opened the old segment may then find entries of the new index, which are at or before the
+ * records they name in the old one, or no valid record at all, and goes on from there; one that opened the new segment finds
+ * the new index. Duplicates are found with a hash table of the CRC-32C of the twits, compared byte by byte when it matches.
+ * A segment is compressed into a new file with another name, which is synced before the old one is unlinked; readers try the
+ * name of the segment not compressed first, and the index stays as it is since the offsets are those of the records before
+ * compression. A compressed segment is read a block at a time into a buffer of its own, so each reader only pays for the blocks
+ * it looks at.
+ *
+ * @author Tassos Souris
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "crc32c.h"
+#include "lz.h"
+#include "histogram.h"
+#include "lockstats.h"
+#include "timing.h"
+#include "twit.h"
+#include "twitlog.h"
+#include "config.h"
+#include "error.h"
+
+// The blocks of a compressed segment are cut at records, so the first one holds the header and a record at least
+#if TWITLOG_BLOCK_SIZE < TWITLOG_SEGMENT_HEADER_SIZE + TWITLOG_RECORD_MAXSIZE
+#error "A block of a compressed segment must hold the header of the segment and a record"
+#endif
+
+
+
+/**
+ * \struct twitlog
+ *
+ * The twitlog structure is an open twit log. The members up to tl_closed are guarded by tl_lock; the rest are only used by
+ * the writer, apart from tl_nextseq and the counters which are updated atomically.
+ */
+struct twitlog{
+	// Handing the records to the writer
+	pthread_mutex_t tl_lock;
+	uint64_t tl_lockedat;
+	pthread_cond_t tl_cond;
+	unsigned char *tl_buffer[ 2 ];
+	int tl_active; /**< The buffer the appender copies the records to */
+	size_t tl_filled; /**< Bytes of records in the active buffer */
+	int tl_closing; /**< Set by closetwitlog() */
+	uint64_t tl_appendedseq; /**< Sequence number of the last record handed to the writer */
+	uint64_t tl_lasttime; /**< Time of the last record appended or left out; the times never go back */
+	// Waiting for durable twits
+	pthread_cond_t tl_synced_cond;
+	int tl_waiting; /**< Threads in waittwitlog() */
+	uint64_t tl_waitseq; /**< Largest sequence number waited for */
+	uint64_t tl_syncedseq; /**< Every record up to this one is synced or failed */
+	uint64_t tl_failedseq; /**< Largest sequence number of a record that failed to be logged */
+	int tl_released; /**< Set by releasetwitlogwaiters(); nothing waits for the writer any more */
+	int tl_closed; /**< Set once the writer has stopped */
+	// Given by nexttwitlogseq()
+	uint64_t tl_nextseq;
+	// The segments recovery found damaged, smallest first; set when the log is opened
+	uint64_t *tl_damaged;
+	size_t tl_damagedcount;
+	// Used by the writer
+	pthread_t tl_writer;
+	enum twitlogsync tl_sync;
+	char tl_dir[ TWITLOG_PATH_MAXLEN ];
+	int tl_fd; /**< The segment written; -1 before the first record */
+	size_t tl_segmentsize; /**< Bytes in that segment */
+	int tl_indexfd; /**< Its index; -1 if it could not be written */
+	size_t tl_nextindexat; /**< The next record starting at or after this offset gets an entry in the index */
+	int tl_dirty; /**< Whether anything was written since the last sync */
+	uint64_t tl_writtenseq; /**< Sequence number of the last record written */
+	uint64_t tl_syncedat; /**< monotonic_ns() at the last sync */
+	// Used by the cleaner, which waits on tl_cleaner_cond with tl_lock until tl_closing is set
+	pthread_t tl_cleaner;
+	int tl_cleaning; /**< Whether retaintwitlog() started the cleaner */
+	pthread_cond_t tl_cleaner_cond;
+	struct twitlogretention tl_retention;
+	char tl_archivedir[ TWITLOG_PATH_MAXLEN ];
+	uint64_t tl_compactedseq; /**< The segments up to the one whose first record has this sequence number were compacted */
+	uint64_t tl_compressedseq; /**< The same, for the segments compressed */
+	// Counters
+	uint64_t tl_appended;
+	uint64_t tl_dropped;
+	uint64_t tl_written;
+	uint64_t tl_bytes;
+	uint64_t tl_segments;
+	uint64_t tl_syncs;
+	uint64_t tl_errors;
+	uint64_t tl_acked;
+	uint64_t tl_commits;
+	uint64_t tl_removed;
+	uint64_t tl_reclaimed;
+	uint64_t tl_compacted;
+	uint64_t tl_compactbytes;
+	uint64_t tl_compactns;
+	uint64_t tl_duplicates;
+	uint64_t tl_compressed;
+	uint64_t tl_compressedin;
+	uint64_t tl_compressedout;
+	struct histogram tl_synclatency;
+};
+
+/**
+ * \struct segmentcheck
+ *
+ * The segmentcheck structure is what checksegment() found in a segment.
+ */
+struct segmentcheck{
+	uint64_t sc_firstseq; /**< From the name of the segment */
+	uint64_t sc_size; /**< Bytes in the segment; before it was compressed, if it was */
+	uint64_t sc_valid; /**< Bytes up to the end of the last valid record; zero if the header is not whole */
+	uint64_t sc_records; /**< Number of valid records */
+	uint64_t sc_lastseq; /**< Sequence number of the last valid record */
+	uint64_t sc_lasttime; /**< Time of the last valid record */
+	int sc_reindexed; /**< Whether the index was written again */
+	int sc_compressed; /**< Whether the segment is compressed */
+	int sc_trusted; /**< Whether it is as a checkpoint had it, so it is not checked */
+	int sc_error; /**< Zero, or the errno of the failure to check the segment */
+};
+
+/**
+ * \struct segmentfile
+ *
+ * The segmentfile structure is a segment opened for reading, compressed or not. Offsets are those of the segment as it was written
+ * whichever way it is stored; segmentat() gives the bytes at an offset, decompressing the block that holds them if needed.
+ */
+struct segmentfile{
+	int sf_fd;
+	const unsigned char *sf_map; /**< The whole file */
+	size_t sf_mapsize;
+	size_t sf_size; /**< Bytes of the segment as it was written */
+	size_t sf_blocks; /**< Number of blocks; zero if the segment is not compressed */
+	const unsigned char *sf_table; /**< The block table in sf_map */
+	unsigned char *sf_block; /**< The block decompressed last */
+	size_t sf_blockat; /**< Which block that is; sf_blocks if none */
+};
+
+/**
+ * \struct dedupslot
+ *
+ * The dedupslot structure is a slot of the hash table of the twits of a segment being compacted.
+ */
+struct dedupslot{
+	uint32_t ds_hash; /**< CRC-32C of the twit */
+	size_t ds_offset; /**< Offset of its record in the segment; zero for an empty slot */
+};
+
+/**
+ * \struct segmentchecks
+ *
+ * The segmentchecks structure is shared by the threads that check the segments of a twit log.
+ */
+struct segmentchecks{
+	const char *scs_dir;
+	struct segmentcheck *scs_segments; /**< Oldest first */
+	size_t scs_count;
+	size_t scs_next; /**< The next segment to check; taken atomically */
+};
+
+
+
+/**
+ * twitlogWriter() runs on its own thread, started by opentwitlog(), and writes the records handed to the twit log pointed to by
+ * parameter arg until the log is closed.
+ */
+static void *twitlogWriter( void *arg );
+
+/**
+ * The writerecords() function shall write the len bytes of whole records pointed to by parameter buf to the segments of the twit
+ * log pointed to by parameter tl, starting a new segment whenever the current one would grow beyond TWITLOG_SEGMENT_SIZE.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned. Failures are reported with error() and
+ * counted in tl_errors; the records not written are lost.
+ */
+static int writerecords( struct twitlog * restrict tl, const unsigned char * restrict buf, size_t len );
+
+/**
+ * The writerun() function shall write to the current segment of the twit log pointed to by parameter tl the len bytes pointed to
+ * by parameter buf, which hold the number of records given as parameter records, the last with the sequence number given as
+ * parameter lastseq, and count them.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set by write().
+ */
+static int writerun( struct twitlog * restrict tl, const unsigned char * restrict buf, size_t len, uint64_t records, uint64_t lastseq );
+
+/**
+ * The indexrun() function shall add to the index of the current segment of the twit log pointed to by parameter tl the entries of
+ * the len bytes of records pointed to by parameter buf, just written at offset in the segment.
+ *
+ * @return Nothing; if the index cannot be written the segment is left without the rest of it, for opentwitlog() to write it again.
+ */
+static void indexrun( struct twitlog * restrict tl, const unsigned char * restrict buf, size_t len, size_t offset );
+
+/**
+ * The indexed() function shall tell whether the record starting at parameter offset of a segment gets an entry in its index,
+ * the previous records having been passed to it in order, and if so move the object pointed to by parameter nextindexat, which
+ * shall be TWITLOG_SEGMENT_HEADER_SIZE for the first record of the segment, past it.
+ *
+ * @return Nonzero if the record gets an entry; otherwise zero.
+ */
+static int indexed( size_t * restrict nextindexat, size_t offset );
+
+/**
+ * The encodeindexentry() function shall store in the TWITLOG_INDEX_ENTRY_SIZE bytes pointed to by parameter buf the index entry
+ * of the record pointed to by parameter r at parameter offset of its segment.
+ *
+ * @return Nothing.
+ */
+static void encodeindexentry( unsigned char * restrict buf, const struct twitlogrecord * restrict r, size_t offset );
+
+/**
+ * The startsegment() function shall sync and close the current segment of the twit log pointed to by parameter tl, if any, and
+ * create a new segment whose first record has the sequence number given as parameter firstseq.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ */
+static int startsegment( struct twitlog * restrict tl, uint64_t firstseq );
+
+/**
+ * The syncsegment() function shall sync the current segment of the twit log pointed to by parameter tl if anything was written
+ * to it since it was last synced.
+ *
+ * @return Nothing. A failure is reported with error() and counted in tl_errors.
+ */
+static void syncsegment( struct twitlog * restrict tl );
+
+/**
+ * The settle() function shall make known to the threads in waittwitlog() that the records of the twit log pointed to by parameter
+ * tl up to the one with the sequence number given as parameter seq are synced if parameter ok is nonzero, or that they failed to
+ * be logged otherwise.
+ *
+ * @return Nothing.
+ */
+static void settle( struct twitlog * restrict tl, uint64_t seq, int ok );
+
+/**
+ * The settlefailed() function shall make known to the threads in waittwitlog() that the records of the twit log pointed to by
+ * parameter tl up to the one with the sequence number given as parameter seq may not be logged. The caller shall hold tl_lock.
+ *
+ * @return Nothing.
+ */
+static void settlefailed( struct twitlog * restrict tl, uint64_t seq );
+
+/**
+ * twitlogCleaner() runs on its own thread, started by retaintwitlog(), and enforces the retention of the twit log pointed to by
+ * parameter arg, and compacts its segments, every tlrt_interval nanoseconds until the log is closed.
+ */
+static void *twitlogCleaner( void *arg );
+
+/**
+ * The retainsegments() function shall remove, or archive, the oldest segments of the twit log pointed to by parameter tl that are
+ * over the limits of its tl_retention, but never the newest one.
+ *
+ * @return Nothing; failures are counted in tl_errors.
+ */
+static void retainsegments( struct twitlog * restrict tl );
+
+/**
+ * The removesegment() function shall remove the segment of the twit log pointed to by parameter tl that starts with the sequence
+ * number given as parameter firstseq, its index first, or move both to tl_archivedir if it is not empty.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ */
+static int removesegment( struct twitlog * restrict tl, uint64_t firstseq );
+
+/**
+ * The compactsegments() function shall compact each segment of the twit log pointed to by parameter tl, other than the newest one,
+ * that was not compacted yet, until the log is being closed.
+ *
+ * @return Nothing; failures are counted in tl_errors.
+ */
+static void compactsegments( struct twitlog * restrict tl );
+
+/**
+ * The compactsegment() function shall write again, without the twits that have the same content as one before them in it, the segment
+ * of the twit log pointed to by parameter tl that starts with the sequence number given as parameter firstseq, if it has any such twit
+ * and no bytes after its last valid record, with a new index, and put the new files in place of the old ones.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ */
+static int compactsegment( struct twitlog * restrict tl, uint64_t firstseq );
+
+/**
+ * The compresssegments() function shall compress with compresssegment() the segments of the twit log pointed to by parameter tl
+ * older than the newest tl_retention.tlrt_hotsegments that were not compressed yet.
+ *
+ * @return Nothing.
+ */
+static void compresssegments( struct twitlog * restrict tl );
+
+/**
+ * The compresssegment() function shall write the segment of the twit log pointed to by parameter tl that starts with the sequence
+ * number given as parameter firstseq compressed, in blocks as described in twitlog.h, and unlink it once the compressed segment
+ * is synced. A segment already compressed, removed meanwhile or with bytes after its last valid record is left as it is.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the
+ * error.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * Any error of open(), write(), fsync() or rename().
+ */
+static int compresssegment( struct twitlog * restrict tl, uint64_t firstseq );
+
+/**
+ * The finddup() function shall look in the hash table of capacity slots pointed to by parameter slots, a power of two, for a twit
+ * with the same content as the twit of the record at the specified offset of the segment mapped at map, whose twit has the CRC-32C
+ * given as parameter hash, and add the record to the table if there is none.
+ *
+ * @return Nonzero if such a twit is in the table, zero otherwise.
+ */
+static int finddup( struct dedupslot * restrict slots, size_t capacity, const unsigned char * restrict map, size_t offset, uint32_t hash );
+
+/**
+ * The recoversegments() function shall check every segment in the directory pointed to by parameter dir, but for the older ones
+ * matching one of the count checkpoints pointed to by parameter cps, cut off what follows the last valid record of the newest one,
+ * or remove it if it has none so a segment can be created with the same name, and store what it found in the object pointed to by
+ * parameter rc. The tlrc_nextseq member is the sequence number that follows the last record of the newest segment; one if there is
+ * no segment. The first sequence numbers of the segments found damaged are stored in an array allocated with malloc(), to which
+ * the object pointed to by parameter damaged is set, and their number in the object pointed to by parameter damagedcount.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EPROTO A segment does not start with a valid header.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ */
+static int recoversegments( const char * restrict dir, const struct twitlogcheckpoint * restrict cps, size_t count,
+	struct twitlogrecovery * restrict rc, uint64_t ** restrict damaged, size_t * restrict damagedcount );
+
+/**
+ * The matchcheckpoint() function shall tell whether the segment of the directory pointed to by parameter dir whose first record
+ * has the sequence number given as parameter firstseq is as one of the count checkpoints pointed to by parameter cps had it.
+ *
+ * @return Nonzero if it is, zero otherwise.
+ */
+static int matchcheckpoint( const char * restrict dir, uint64_t firstseq, const struct twitlogcheckpoint * restrict cps, size_t count );
+
+/**
+ * The statsegment() function shall store in the object pointed to by parameter cp the checkpoint of the segment of the directory
+ * pointed to by parameter dir whose first record has the sequence number given as parameter firstseq, as its files are now.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set by stat(), for
+ * 	the segment or for its index.
+ */
+static int statsegment( const char * restrict dir, uint64_t firstseq, struct twitlogcheckpoint * restrict cp );
+
+/**
+ * The segmentChecker() function shall check segments of the struct segmentchecks object pointed to by parameter arg with
+ * checksegment() until there is none left. It runs in the threads started by recoversegments() and in the thread that called it.
+ *
+ * @return Always NULL.
+ */
+static void *segmentChecker( void *arg );
+
+/**
+ * The checksegment() function shall map the segment of the directory pointed to by parameter dir whose first sequence number is
+ * the sc_firstseq member of the object pointed to by parameter sc and store there what it finds. Checking stops at the first record
+ * that is not whole and valid or whose sequence number is not larger than that of the one before.
+ *
+ * @return Nothing. A failure is stored in the sc_error member; EPROTO if the segment does not start with a valid header.
+ */
+static void checksegment( const char * restrict dir, struct segmentcheck * restrict sc );
+
+/**
+ * The checkindex() function shall compare the index of the segment of the directory pointed to by parameter dir whose first record
+ * has the sequence number given as parameter firstseq with the len bytes of entries pointed to by parameter entries, and write it
+ * again with them if it differs.
+ *
+ * @return One if the index was written again, zero if it matched; otherwise, -1 shall be returned and errno shall be set to
+ * 	indicate the error.
+ */
+static int checkindex( const char * restrict dir, uint64_t firstseq, const unsigned char * restrict entries, size_t len );
+
+/**
+ * The indexedoffset() function shall return the offset, in the segment of the directory pointed to by parameter dir whose first
+ * record has the sequence number given as parameter firstseq, of the last record of its index whose time, if parameter bytime is
+ * nonzero, or sequence number is smaller than parameter key; TWITLOG_SEGMENT_HEADER_SIZE if there is none or no index.
+ *
+ * @return The offset.
+ */
+static size_t indexedoffset( const char * restrict dir, uint64_t firstseq, uint64_t key, int bytime );
+
+/**
+ * The firstrecordtime() function shall store in the object pointed to by parameter time the time of the first record of the segment
+ * of the directory pointed to by parameter dir whose first record has the sequence number given as parameter firstseq, taken from
+ * its index if there is one.
+ *
+ * @return Zero if it was stored, one if the segment has no valid first record; otherwise, -1 shall be returned and errno shall be
+ * 	set to indicate the error.
+ */
+static int firstrecordtime( const char * restrict dir, uint64_t firstseq, uint64_t * restrict time );
+
+/**
+ * The listsegments() function shall store in the object pointed to by parameter firstseqs a pointer to an array, allocated with
+ * malloc(), of the first sequence numbers of the segments in the directory pointed to by parameter dir, smallest first, and their
+ * number in the object pointed to by parameter count.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * Any error of opendir().
+ */
+static int listsegments( const char * restrict dir, uint64_t ** restrict firstseqs, size_t * restrict count );
+
+/**
+ * The compareseqs() function shall compare the uint64_t objects pointed to by its parameters, for qsort().
+ *
+ * @return A negative number, zero or a positive number if the first is smaller than, equal to or larger than the second.
+ */
+static int compareseqs( const void *a, const void *b );
+
+/**
+ * The mapfile() function shall map in memory, read only, the whole segment or index whose path is pointed to by parameter path,
+ * tell the system it is read as parameter advice says (one of the POSIX_MADV_ values) and store its size in the object pointed to
+ * by parameter size. The file shall be unmapped with munmap().
+ *
+ * @return Pointer to the mapped file; NULL if the file is empty or on failure, in which case errno shall be set to indicate
+ * the error.
+ */
+static const unsigned char *mapfile( const char * restrict path, size_t * restrict size, int advice );
+
+/**
+ * The opensegment() function shall open for reading the segment of the twit log in the directory pointed to by parameter dir that
+ * starts with the sequence number given as parameter firstseq, compressed or not, map it as mapfile() does and store what is needed
+ * to read it in the object pointed to by parameter sf. The segment shall be closed with closesegment().
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the
+ * error, or to zero if the segment is empty.
+ * @exception EPROTO The header or the block table of a compressed segment is not valid.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * Any error of open() or mmap().
+ */
+static int opensegment( const char * restrict dir, uint64_t firstseq, int advice, struct segmentfile * restrict sf );
+
+/**
+ * The segmentat() function shall return a pointer to the bytes of the segment pointed to by parameter sf from the specified offset
+ * and store in the object pointed to by parameter avail how many of them follow it there: up to the end of the segment, or of its
+ * block if it is compressed. Records never span blocks.
+ *
+ * @return The pointer; NULL if offset is not before the end of the segment or the block cannot be decompressed, in which case
+ * errno shall be set to EILSEQ.
+ */
+static const unsigned char *segmentat( struct segmentfile * restrict sf, size_t offset, size_t * restrict avail );
+
+/**
+ * The closesegment() function shall close the segment pointed to by parameter sf, opened with opensegment().
+ *
+ * @return Nothing.
+ */
+static void closesegment( struct segmentfile * restrict sf );
+
+/**
+ * The recordat() function shall decode as decodetwitlogrecord() does the record at the specified offset of the segment pointed
+ * to by parameter sf into the object pointed to by parameter r, and store in the object pointed to by parameter record a
+ * pointer to its bytes.
+ *
+ * @return The size of the record; zero if there is no valid record at the offset, or it cannot be read.
+ */
+static ssize_t recordat( struct segmentfile * restrict sf, size_t offset, struct twitlogrecord * restrict r, const unsigned char ** restrict record );
+
+/**
+ * The parsesegmentname() function shall store in the object pointed to by parameter firstseq the sequence number in the name
+ * pointed to by parameter name, if it is the name of a segment as made by twitlogsegmentname() or twitlogcompressedname().
+ *
+ * @return One if name is the name of a segment; otherwise, zero.
+ */
+static int parsesegmentname( const char * restrict name, uint64_t * restrict firstseq );
+
+/**
+ * The writeall() function shall write the len bytes pointed to by parameter buf to the file descriptor given as parameter fd,
+ * going on after partial writes and interruptions.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set by write().
+ */
+static int writeall( int fd, const unsigned char * restrict buf, size_t len );
+
+/**
+ * The putle16(), putle32() and putle64() functions shall store the value given as parameter in the bytes pointed to by parameter
+ * p, little-endian. The getle16(), getle32() and getle64() functions shall return the value stored that way.
+ */
+static void putle16( unsigned char * restrict p, uint16_t value );
+static void putle32( unsigned char * restrict p, uint32_t value );
+static void putle64( unsigned char * restrict p, uint64_t value );
+static uint16_t getle16( const unsigned char * restrict p );
+static uint32_t getle32( const unsigned char * restrict p );
+static uint64_t getle64( const unsigned char * restrict p );
+
+
+
+int opentwitlog( struct twitlog ** restrict tlp, const char * restrict dir, enum twitlogsync sync, struct twitlogrecovery * restrict rc ){
+	return ( opentwitlogfrom( tlp, dir, sync, NULL, 0, rc ) );
+}
+
+int opentwitlogfrom( struct twitlog ** restrict tlp, const char * restrict dir, enum twitlogsync sync,
+	const struct twitlogcheckpoint * restrict cps, size_t count, struct twitlogrecovery * restrict rc ){
+	struct twitlog *tl = NULL;
+	pthread_condattr_t condattr;
+	char path[ TWITLOG_PATH_MAXLEN ];
+	struct twitlogrecovery recovery;
+	uint64_t *damaged = NULL;
+	size_t damagedcount = 0;
+	uint64_t nextseq;
+
+	if ( tlp == NULL || dir == NULL || sync < 0 || sync >= TWITLOG_SYNC_POLICIES || ( cps == NULL && count > 0 ) ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	// The longest segment name must fit
+	if ( twitlogsegmentname( path, sizeof( path ), dir, UINT64_MAX ) == -1 ){
+		return ( -1 );
+	}
+	if ( mkdir( dir, 0755 ) == -1 && errno != EEXIST ){
+		return ( -1 );
+	}
+	if ( recoversegments( dir, cps, count, &recovery, &damaged, &damagedcount ) == -1 ){
+		return ( -1 );
+	}
+	nextseq = recovery.tlrc_nextseq;
+	if ( rc != NULL ){
+		*rc = recovery;
+	}
+
+	if ( ( tl = malloc( sizeof( *tl ) ) ) == NULL ){
+		free( damaged );
+		errno = ENOMEM;
+		return ( -1 );
+	}
+	tl->tl_buffer[ 0 ] = malloc( TWITLOG_BUFFER_SIZE + TWITLOG_DURABLE_RESERVE );
+	tl->tl_buffer[ 1 ] = malloc( TWITLOG_BUFFER_SIZE + TWITLOG_DURABLE_RESERVE );
+	if ( tl->tl_buffer[ 0 ] == NULL || tl->tl_buffer[ 1 ] == NULL ){
+		free( tl->tl_buffer[ 0 ] );
+		free( tl->tl_buffer[ 1 ] );
+		free( tl );
+		free( damaged );
+		errno = ENOMEM;
+		return ( -1 );
+	}
+	tl->tl_active = 0;
+	tl->tl_filled = 0;
+	tl->tl_closing = 0;
+	tl->tl_appendedseq = nextseq - 1;
+	tl->tl_lasttime = recovery.tlrc_lasttime;
+	tl->tl_waiting = 0;
+	tl->tl_waitseq = 0;
+	tl->tl_syncedseq = nextseq - 1;
+	tl->tl_failedseq = 0;
+	tl->tl_released = 0;
+	tl->tl_closed = 0;
+	tl->tl_nextseq = nextseq;
+	tl->tl_damaged = damaged;
+	tl->tl_damagedcount = damagedcount;
+	tl->tl_sync = sync;
+	( void )strcpy( tl->tl_dir, dir );
+	tl->tl_fd = -1;
+	tl->tl_segmentsize = 0;
+	tl->tl_indexfd = -1;
+	tl->tl_nextindexat = TWITLOG_SEGMENT_HEADER_SIZE;
+	tl->tl_dirty = 0;
+	tl->tl_writtenseq = nextseq - 1;
+	tl->tl_syncedat = monotonic_ns();
+	tl->tl_cleaning = 0;
+	tl->tl_archivedir[ 0 ] = '\0';
+	tl->tl_compactedseq = 0;
+	tl->tl_compressedseq = 0;
+	tl->tl_appended = 0;
+	tl->tl_dropped = 0;
+	tl->tl_written = 0;
+	tl->tl_bytes = 0;
+	tl->tl_segments = 0;
+	tl->tl_syncs = 0;
+	tl->tl_errors = 0;
+	tl->tl_acked = 0;
+	tl->tl_commits = 0;
+	tl->tl_removed = 0;
+	tl->tl_reclaimed = 0;
+	tl->tl_compacted = 0;
+	tl->tl_compactbytes = 0;
+	tl->tl_compactns = 0;
+	tl->tl_duplicates = 0;
+	tl->tl_compressed = 0;
+	tl->tl_compressedin = 0;
+	tl->tl_compressedout = 0;
+	inithistogram( &tl->tl_synclatency );
+
+	// The writer and the cleaner wait with deadlines of the monotonic clock
+	while ( pthread_mutex_init( &tl->tl_lock, NULL ) ){ continue; }
+	while ( pthread_condattr_init( &condattr ) ){ continue; }
+	while ( pthread_condattr_setclock( &condattr, CLOCK_MONOTONIC ) ){ continue; }
+	while ( pthread_cond_init( &tl->tl_cond, &condattr ) ){ continue; }
+	while ( pthread_cond_init( &tl->tl_cleaner_cond, &condattr ) ){ continue; }
+	while ( pthread_cond_init( &tl->tl_synced_cond, NULL ) ){ continue; }
+	( void )pthread_condattr_destroy( &condattr );
+
+	if ( ( errno = pthread_create( &tl->tl_writer, NULL, &twitlogWriter, tl ) ) ){
+		( void )pthread_cond_destroy( &tl->tl_synced_cond );
+		( void )pthread_cond_destroy( &tl->tl_cleaner_cond );
+		( void )pthread_cond_destroy( &tl->tl_cond );
+		( void )pthread_mutex_destroy( &tl->tl_lock );
+		free( tl->tl_buffer[ 0 ] );
+		free( tl->tl_buffer[ 1 ] );
+		free( tl->tl_damaged );
+		free( tl );
+		return ( -1 );
+	}
+
+	*tlp = tl;
+
+	return ( 0 );
+}
+
+uint64_t nexttwitlogseq( struct twitlog * restrict tl ){
+	assert( tl != NULL );
+
+	return ( __atomic_fetch_add( &tl->tl_nextseq, 1, __ATOMIC_RELAXED ) );
+}
+
+uint64_t peektwitlogseq( struct twitlog * restrict tl ){
+	assert( tl != NULL );
+
+	return ( __atomic_load_n( &tl->tl_nextseq, __ATOMIC_RELAXED ) );
+}
+
+// The records already written keep their sequence numbers; the writer only needs them to grow
+void skiptwitlogseq( struct twitlog * restrict tl, uint64_t seq ){
+	uint64_t nextseq;
+
+	assert( tl != NULL );
+
+	nextseq = __atomic_load_n( &tl->tl_nextseq, __ATOMIC_RELAXED );
+	while ( nextseq < seq && !__atomic_compare_exchange_n( &tl->tl_nextseq, &nextseq, seq, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ){
+		continue;
+	}
+
+	return ;
+}
+
+// Copy the record to the active buffer. The writer only has to be woken up if the buffer was empty, or if it is waiting
+// for this twit to commit the durable twits. A clock set back does not take the times back, which seektwitlog() relies on
+int appendtwitlog( struct twitlog * restrict tl, struct twit * restrict t ){
+	struct twitlogrecord r;
+	size_t size;
+	size_t limit;
+	int wake;
+
+	assert( tl != NULL );
+	assert( t != NULL );
+	assert( t->t_twitlen > 0 && t->t_twitlen <= TWIT_MAXLEN );
+
+	r.tlr_len = ( uint16_t )t->t_twitlen;
+	r.tlr_flags = t->t_durable ? TWITLOG_FLAG_DURABLE : 0;
+	r.tlr_seq = t->t_seq;
+	r.tlr_time = realtime_ns();
+	size = TWITLOG_RECORD_HEADER_SIZE + t->t_twitlen;
+	limit = TWITLOG_BUFFER_SIZE + ( t->t_durable ? TWITLOG_DURABLE_RESERVE : 0 );
+
+	lock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	assert( r.tlr_seq > tl->tl_appendedseq );
+	if ( r.tlr_time < tl->tl_lasttime ){
+		r.tlr_time = tl->tl_lasttime;
+	}
+	tl->tl_lasttime = r.tlr_time;
+	t->t_logged = r.tlr_time;
+	if ( tl->tl_closing || tl->tl_filled + size > limit ){
+		errno = tl->tl_closing ? ECANCELED : EAGAIN;
+		// Whoever waits for the twit must not wait for ever
+		if ( t->t_durable ){
+			settlefailed( tl, r.tlr_seq );
+		}
+		unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+		( void )__atomic_fetch_add( &tl->tl_dropped, 1, __ATOMIC_RELAXED );
+		return ( -1 );
+	}
+	( void )encodetwitlogrecord( tl->tl_buffer[ tl->tl_active ] + tl->tl_filled, &r, t->t_twit );
+	wake = ( tl->tl_filled == 0 ) || ( tl->tl_waiting > 0 && r.tlr_seq >= tl->tl_waitseq );
+	tl->tl_filled += size;
+	tl->tl_appendedseq = r.tlr_seq;
+	if ( wake ){
+		while ( pthread_cond_signal( &tl->tl_cond ) ){ continue; }
+	}
+	unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	( void )__atomic_fetch_add( &tl->tl_appended, 1, __ATOMIC_RELAXED );
+
+	return ( 0 );
+}
+
+uint64_t appendedtwitlogseq( struct twitlog * restrict tl ){
+	uint64_t seq;
+
+	assert( tl != NULL );
+
+	lock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	seq = tl->tl_appendedseq;
+	unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+
+	return ( seq );
+}
+
+// Tell the writer there is someone waiting, then wait until the twit is settled one way or the other
+int waittwitlog( struct twitlog * restrict tl, uint64_t seq ){
+	int status;
+
+	assert( tl != NULL );
+	assert( seq > 0 );
+
+	lock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	++tl->tl_waiting;
+	if ( seq > tl->tl_waitseq ){
+		tl->tl_waitseq = seq;
+	}
+	while ( pthread_cond_signal( &tl->tl_cond ) ){ continue; }
+	while ( tl->tl_syncedseq < seq && tl->tl_failedseq < seq && !tl->tl_released && !tl->tl_closed ){
+		wait_mutex( LOCK_TWITLOG, &tl->tl_synced_cond, &tl->tl_lock, &tl->tl_lockedat );
+	}
+	status = ( tl->tl_syncedseq >= seq && tl->tl_failedseq < seq ) ? 0 : -1;
+	--tl->tl_waiting;
+	// closetwitlog() waits for the last one to leave
+	if ( tl->tl_closed && tl->tl_waiting == 0 ){
+		while ( pthread_cond_broadcast( &tl->tl_synced_cond ) ){ continue; }
+	}
+	unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+
+	if ( status == 0 ){
+		( void )__atomic_fetch_add( &tl->tl_acked, 1, __ATOMIC_RELAXED );
+	}
+	else{
+		errno = EIO;
+	}
+
+	return ( status );
+}
+
+void releasetwitlogwaiters( struct twitlog * restrict tl ){
+	assert( tl != NULL );
+
+	lock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	tl->tl_released = 1;
+	while ( pthread_cond_broadcast( &tl->tl_synced_cond ) ){ continue; }
+	unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+
+	return ;
+}
+
+// The archive directory is made here so a wrong one is known at once
+int retaintwitlog( struct twitlog * restrict tl, const struct twitlogretention * restrict rt ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+
+	if ( tl == NULL || rt == NULL || rt->tlrt_interval == 0 ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	assert( !tl->tl_cleaning );
+
+	if ( rt->tlrt_archivedir != NULL ){
+		if ( twitlogsegmentname( path, sizeof( path ), rt->tlrt_archivedir, UINT64_MAX ) == -1 ||
+			twitlogindexname( path, sizeof( path ), rt->tlrt_archivedir, UINT64_MAX ) == -1 ){
+			return ( -1 );
+		}
+		if ( mkdir( rt->tlrt_archivedir, 0755 ) == -1 && errno != EEXIST ){
+			return ( -1 );
+		}
+		( void )strcpy( tl->tl_archivedir, rt->tlrt_archivedir );
+	}
+	tl->tl_retention = *rt;
+	tl->tl_retention.tlrt_archivedir = NULL;
+	if ( ( errno = pthread_create( &tl->tl_cleaner, NULL, &twitlogCleaner, tl ) ) ){
+		return ( -1 );
+	}
+	tl->tl_cleaning = 1;
+
+	return ( 0 );
+}
+
+// The writer writes what is left and syncs before it stops; the cleaner stops after the segment it is at
+void closetwitlog( struct twitlog * restrict tl ){
+	assert( tl != NULL );
+
+	lock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	tl->tl_closing = 1;
+	while ( pthread_cond_signal( &tl->tl_cond ) ){ continue; }
+	while ( pthread_cond_signal( &tl->tl_cleaner_cond ) ){ continue; }
+	unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	( void )pthread_join( tl->tl_writer, NULL );
+	if ( tl->tl_cleaning ){
+		( void )pthread_join( tl->tl_cleaner, NULL );
+	}
+
+	// The threads still waiting for durable twits are let go
+	lock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	tl->tl_closed = 1;
+	while ( pthread_cond_broadcast( &tl->tl_synced_cond ) ){ continue; }
+	while ( tl->tl_waiting > 0 ){
+		wait_mutex( LOCK_TWITLOG, &tl->tl_synced_cond, &tl->tl_lock, &tl->tl_lockedat );
+	}
+	unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+
+	if ( tl->tl_fd != -1 ){
+		( void )close( tl->tl_fd );
+	}
+	if ( tl->tl_indexfd != -1 ){
+		( void )close( tl->tl_indexfd );
+	}
+	( void )pthread_cond_destroy( &tl->tl_synced_cond );
+	( void )pthread_cond_destroy( &tl->tl_cleaner_cond );
+	( void )pthread_cond_destroy( &tl->tl_cond );
+	( void )pthread_mutex_destroy( &tl->tl_lock );
+	free( tl->tl_buffer[ 0 ] );
+	free( tl->tl_buffer[ 1 ] );
+	free( tl->tl_damaged );
+	free( tl );
+
+	return ;
+}
+
+// The two newest segments are left out: the newest is being written and recovery looks at the one before when the newest is empty.
+// A segment the cleaner replaces meanwhile gets a file with another serial number, so its checkpoint no longer matches
+int checkpointtwitlog( struct twitlog * restrict tl, struct twitlogcheckpoint ** restrict cps, size_t * restrict count ){
+	uint64_t *firstseqs = NULL;
+	size_t segments;
+	size_t d = 0;
+	size_t i;
+
+	assert( tl != NULL );
+	assert( cps != NULL );
+	assert( count != NULL );
+
+	if ( listsegments( tl->tl_dir, &firstseqs, &segments ) == -1 ){
+		return ( -1 );
+	}
+	if ( ( *cps = malloc( ( segments > 0 ? segments : 1 ) * sizeof( **cps ) ) ) == NULL ){
+		free( firstseqs );
+		errno = ENOMEM;
+		return ( -1 );
+	}
+	*count = 0;
+	for ( i = 0; i + 2 < segments; ++i ){
+		while ( d < tl->tl_damagedcount && tl->tl_damaged[ d ] < firstseqs[ i ] ){
+			++d;
+		}
+		if ( ( d < tl->tl_damagedcount && tl->tl_damaged[ d ] == firstseqs[ i ] ) || statsegment( tl->tl_dir, firstseqs[ i ], &( *cps )[ *count ] ) == -1 ){
+			continue;
+		}
+		++*count;
+	}
+	free( firstseqs );
+
+	return ( 0 );
+}
+
+void snapshottwitlog( struct twitlog * restrict tl, struct twitlogstats * restrict stats ){
+	assert( tl != NULL );
+	assert( stats != NULL );
+
+	stats->tls_appended = __atomic_load_n( &tl->tl_appended, __ATOMIC_RELAXED );
+	stats->tls_dropped = __atomic_load_n( &tl->tl_dropped, __ATOMIC_RELAXED );
+	stats->tls_written = __atomic_load_n( &tl->tl_written, __ATOMIC_RELAXED );
+	stats->tls_bytes = __atomic_load_n( &tl->tl_bytes, __ATOMIC_RELAXED );
+	stats->tls_segments = __atomic_load_n( &tl->tl_segments, __ATOMIC_RELAXED );
+	stats->tls_syncs = __atomic_load_n( &tl->tl_syncs, __ATOMIC_RELAXED );
+	stats->tls_errors = __atomic_load_n( &tl->tl_errors, __ATOMIC_RELAXED );
+	stats->tls_acked = __atomic_load_n( &tl->tl_acked, __ATOMIC_RELAXED );
+	stats->tls_commits = __atomic_load_n( &tl->tl_commits, __ATOMIC_RELAXED );
+	stats->tls_nextseq = __atomic_load_n( &tl->tl_nextseq, __ATOMIC_RELAXED );
+	stats->tls_removed = __atomic_load_n( &tl->tl_removed, __ATOMIC_RELAXED );
+	stats->tls_reclaimed = __atomic_load_n( &tl->tl_reclaimed, __ATOMIC_RELAXED );
+	stats->tls_compacted = __atomic_load_n( &tl->tl_compacted, __ATOMIC_RELAXED );
+	stats->tls_compactbytes = __atomic_load_n( &tl->tl_compactbytes, __ATOMIC_RELAXED );
+	stats->tls_compactns = __atomic_load_n( &tl->tl_compactns, __ATOMIC_RELAXED );
+	stats->tls_duplicates = __atomic_load_n( &tl->tl_duplicates, __ATOMIC_RELAXED );
+	stats->tls_compressed = __atomic_load_n( &tl->tl_compressed, __ATOMIC_RELAXED );
+	stats->tls_compressedin = __atomic_load_n( &tl->tl_compressedin, __ATOMIC_RELAXED );
+	stats->tls_compressedout = __atomic_load_n( &tl->tl_compressedout, __ATOMIC_RELAXED );
+	snapshothistogram( &tl->tl_synclatency, &stats->tls_sync );
+
+	return ;
+}
+
+// Start at the segment that holds fromseq; the records of a segment are checked again as they are read
+int readtwitlog( const char * restrict dir, uint64_t fromseq,
+	int ( *fn )( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg ), void *arg ){
+	struct segmentfile sf;
+	const unsigned char *record = NULL;
+	struct twitlogrecord r;
+	uint64_t *firstseqs = NULL;
+	size_t count;
+	size_t first = 0;
+	size_t offset;
+	ssize_t recordsize;
+	size_t i;
+	int stop = 0;
+
+	if ( dir == NULL || fn == NULL ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	if ( listsegments( dir, &firstseqs, &count ) == -1 ){
+		return ( -1 );
+	}
+	for ( i = 0; i < count && firstseqs[ i ] <= fromseq; ++i ){
+		first = i;
+	}
+	for ( i = first; i < count && !stop; ++i ){
+		if ( opensegment( dir, firstseqs[ i ], POSIX_MADV_SEQUENTIAL, &sf ) == -1 ){
+			// The newest segment may have just been created
+			if ( errno == 0 || errno == ENOENT ){
+				continue;
+			}
+			free( firstseqs );
+			return ( -1 );
+		}
+		// An entry of the index that does not lead to a record is not followed
+		offset = TWITLOG_SEGMENT_HEADER_SIZE;
+		if ( i == first ){
+			offset = indexedoffset( dir, firstseqs[ i ], fromseq, 0 );
+			if ( recordat( &sf, offset, &r, &record ) <= 0 ){
+				offset = TWITLOG_SEGMENT_HEADER_SIZE;
+			}
+		}
+		while ( !stop && ( recordsize = recordat( &sf, offset, &r, &record ) ) > 0 ){
+			if ( r.tlr_seq >= fromseq ){
+				stop = fn( &r, ( const char * )record + TWITLOG_RECORD_HEADER_SIZE, arg );
+			}
+			offset += ( size_t )recordsize;
+		}
+		closesegment( &sf );
+	}
+	free( firstseqs );
+
+	return ( 0 );
+}
+
+// Each segment is sent as one range of bytes; only its ends are looked for, from the entries of its index before them. A compressed
+// segment is sent a block at a time as it is decompressed
+int sendtwitlog( const char * restrict dir, uint64_t fromseq, uint64_t toseq, int sockfd, uint64_t * restrict sent ){
+	struct segmentfile sf;
+	const unsigned char *record = NULL;
+	struct twitlogrecord r;
+	uint64_t *firstseqs = NULL;
+	uint64_t startseq;
+	uint64_t lastseq;
+	size_t count;
+	size_t first = 0;
+	size_t start, end;
+	size_t avail;
+	ssize_t recordsize;
+	ssize_t nsent;
+	off_t position;
+	size_t i;
+	int done = 0;
+
+	if ( dir == NULL || sent == NULL ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	if ( fromseq >= toseq ){
+		return ( 0 );
+	}
+	if ( listsegments( dir, &firstseqs, &count ) == -1 ){
+		return ( -1 );
+	}
+	for ( i = 0; i < count && firstseqs[ i ] <= fromseq; ++i ){
+		first = i;
+	}
+	for ( i = first; i < count && !done && firstseqs[ i ] < toseq; ++i ){
+		if ( opensegment( dir, firstseqs[ i ], POSIX_MADV_RANDOM, &sf ) == -1 ){
+			// The newest segment may have just been created
+			if ( errno == 0 || errno == ENOENT ){
+				continue;
+			}
+			free( firstseqs );
+			return ( -1 );
+		}
+
+		// The first record to send; an entry of the index that does not lead to a record is not followed
+		start = TWITLOG_SEGMENT_HEADER_SIZE;
+		if ( i == first ){
+			start = indexedoffset( dir, firstseqs[ i ], fromseq, 0 );
+			if ( recordat( &sf, start, &r, &record ) <= 0 ){
+				start = TWITLOG_SEGMENT_HEADER_SIZE;
+			}
+		}
+		while ( ( recordsize = recordat( &sf, start, &r, &record ) ) > 0 && r.tlr_seq < fromseq ){
+			start += ( size_t )recordsize;
+		}
+		startseq = r.tlr_seq;
+
+		// The first record not to send
+		end = indexedoffset( dir, firstseqs[ i ], toseq, 0 );
+		if ( end <= start || recordat( &sf, end, &r, &record ) <= 0 ){
+			end = start;
+		}
+		lastseq = startseq;
+		while ( ( recordsize = recordat( &sf, end, &r, &record ) ) > 0 ){
+			if ( r.tlr_seq >= toseq ){
+				done = 1;
+				break;
+			}
+			lastseq = r.tlr_seq;
+			end += ( size_t )recordsize;
+		}
+
+		position = ( off_t )start;
+		while ( ( size_t )position < end ){
+			if ( sf.sf_blocks > 0 ){
+				// The block is decompressed again only if the walk above left another one there
+				if ( ( record = segmentat( &sf, ( size_t )position, &avail ) ) == NULL ){
+					break;
+				}
+				if ( avail > end - ( size_t )position ){
+					avail = end - ( size_t )position;
+				}
+				if ( writeall( sockfd, record, avail ) == -1 ){
+					break;
+				}
+				position += ( off_t )avail;
+				continue;
+			}
+			if ( ( nsent = sendfile( sockfd, sf.sf_fd, &position, end - ( size_t )position ) ) == -1 ){
+				if ( errno == EINTR ){
+					continue;
+				}
+				break;
+			}
+			if ( nsent == 0 ){
+				errno = EIO;
+				break;
+			}
+		}
+		closesegment( &sf );
+		if ( ( size_t )position < end ){
+			free( firstseqs );
+			return ( -1 );
+		}
+		if ( end > start ){
+			*sent += lastseq - startseq + 1;
+		}
+	}
+	free( firstseqs );
+
+	return ( 0 );
+}
+
+// The segments whose first records were logged before the time are found first, then the last entry of the index of the
+// newest of them before the time
+int seektwitlog( const char * restrict dir, uint64_t time, uint64_t * restrict seq ){
+	struct segmentfile sf;
+	const unsigned char *record = NULL;
+	struct twitlogrecord r;
+	uint64_t *firstseqs = NULL;
+	uint64_t firsttime;
+	size_t count;
+	size_t low, high, middle;
+	size_t offset;
+	ssize_t recordsize;
+	int status;
+
+	if ( dir == NULL || seq == NULL ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+	*seq = 0;
+	if ( listsegments( dir, &firstseqs, &count ) == -1 ){
+		return ( -1 );
+	}
+	// Only the newest segment may have no first record yet; it is taken as logged after the time
+	low = 0;
+	high = count;
+	while ( low < high ){
+		middle = low + ( high - low ) / 2;
+		if ( ( status = firstrecordtime( dir, firstseqs[ middle ], &firsttime ) ) == -1 ){
+			free( firstseqs );
+			return ( -1 );
+		}
+		if ( status == 0 && firsttime < time ){
+			low = middle + 1;
+		}
+		else{
+			high = middle;
+		}
+	}
+
+	// The twit is in segment low - 1 or is the first of segment low
+	if ( low > 0 ){
+		if ( opensegment( dir, firstseqs[ low - 1 ], POSIX_MADV_RANDOM, &sf ) == -1 ){
+			if ( errno != 0 && errno != ENOENT ){
+				free( firstseqs );
+				return ( -1 );
+			}
+		}
+		else{
+			offset = indexedoffset( dir, firstseqs[ low - 1 ], time, 1 );
+			if ( recordat( &sf, offset, &r, &record ) <= 0 ){
+				offset = TWITLOG_SEGMENT_HEADER_SIZE;
+			}
+			while ( ( recordsize = recordat( &sf, offset, &r, &record ) ) > 0 ){
+				if ( r.tlr_time >= time ){
+					*seq = r.tlr_seq;
+					break;
+				}
+				offset += ( size_t )recordsize;
+			}
+			closesegment( &sf );
+		}
+	}
+	if ( *seq == 0 && low < count && firstrecordtime( dir, firstseqs[ low ], &firsttime ) == 0 ){
+		*seq = firstseqs[ low ];
+	}
+	free( firstseqs );
+
+	return ( 0 );
+}
+
+// The checksum covers everything after itself
+size_t encodetwitlogrecord( unsigned char * restrict buf, const struct twitlogrecord * restrict r, const char * restrict twit ){
+	assert( buf != NULL );
+	assert( r != NULL );
+	assert( twit != NULL );
+
+	putle16( buf + 4, r->tlr_len );
+	putle16( buf + 6, r->tlr_flags );
+	putle64( buf + 8, r->tlr_seq );
+	putle64( buf + 16, r->tlr_time );
+	( void )memcpy( buf + TWITLOG_RECORD_HEADER_SIZE, twit, r->tlr_len );
+	putle32( buf, crc32c( 0, buf + 4, TWITLOG_RECORD_HEADER_SIZE - 4 + r->tlr_len ) );
+
+	return ( TWITLOG_RECORD_HEADER_SIZE + r->tlr_len );
+}
+
+// A zero length is never written, so zeroed bytes are not taken for a record
+ssize_t decodetwitlogrecord( const unsigned char * restrict buf, size_t len, struct twitlogrecord * restrict r ){
+	assert( buf != NULL );
+	assert( r != NULL );
+
+	if ( len < TWITLOG_RECORD_HEADER_SIZE ){
+		return ( 0 );
+	}
+	r->tlr_crc = getle32( buf );
+	r->tlr_len = getle16( buf + 4 );
+	r->tlr_flags = getle16( buf + 6 );
+	r->tlr_seq = getle64( buf + 8 );
+	r->tlr_time = getle64( buf + 16 );
+	if ( r->tlr_len == 0 || r->tlr_len > TWIT_MAXLEN ){
+		errno = EILSEQ;
+		return ( -1 );
+	}
+	if ( len < ( size_t )TWITLOG_RECORD_HEADER_SIZE + r->tlr_len ){
+		return ( 0 );
+	}
+	if ( crc32c( 0, buf + 4, TWITLOG_RECORD_HEADER_SIZE - 4 + r->tlr_len ) != r->tlr_crc ){
+		errno = EILSEQ;
+		return ( -1 );
+	}
+
+	return ( TWITLOG_RECORD_HEADER_SIZE + r->tlr_len );
+}
+
+// Zero-padded so the names sort in the order of the segments
+int twitlogsegmentname( char * restrict buf, size_t size, const char * restrict dir, uint64_t firstseq ){
+	int len;
+
+	assert( buf != NULL );
+	assert( dir != NULL );
+
+	len = snprintf( buf, size, "%s/%020llu.log", dir, ( unsigned long long )firstseq );
+	if ( len < 0 || ( size_t )len >= size ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+// The name the segment has once it is compressed
+int twitlogcompressedname( char * restrict buf, size_t size, const char * restrict dir, uint64_t firstseq ){
+	int len;
+
+	assert( buf != NULL );
+	assert( dir != NULL );
+
+	len = snprintf( buf, size, "%s/%020llu.lz", dir, ( unsigned long long )firstseq );
+	if ( len < 0 || ( size_t )len >= size ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+// Next to the segment
+int twitlogindexname( char * restrict buf, size_t size, const char * restrict dir, uint64_t firstseq ){
+	int len;
+
+	assert( buf != NULL );
+	assert( dir != NULL );
+
+	len = snprintf( buf, size, "%s/%020llu.idx", dir, ( unsigned long long )firstseq );
+	if ( len < 0 || ( size_t )len >= size ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+const char *twitlogsyncname( enum twitlogsync sync ){
+	static const char * const names[ TWITLOG_SYNC_POLICIES ] = {
+		[ TWITLOG_SYNC_NONE ] = "none",
+		[ TWITLOG_SYNC_INTERVAL ] = "interval",
+		[ TWITLOG_SYNC_ALWAYS ] = "always"
+	};
+
+	assert( sync >= 0 && sync < TWITLOG_SYNC_POLICIES );
+
+	return ( names[ sync ] );
+}
+
+
+
+// Implementation of local functions...
+
+// Take the full buffer, write it, sync as the policy says or because someone waits; with TWITLOG_SYNC_INTERVAL an idle
+// writer wakes up to sync
+static void *twitlogWriter( void *arg ){
+	struct twitlog *tl = ( struct twitlog * )arg;
+	const uint64_t interval = ( uint64_t )TWITLOG_SYNC_MSEC * 1000000u;
+	struct timespec deadline;
+	unsigned char *buffer = NULL;
+	uint64_t lastseq;
+	uint64_t window;
+	size_t len;
+	int closing;
+	int commit;
+
+	assert( arg != NULL );
+
+	while ( 1 ){
+		lock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+		while ( tl->tl_filled == 0 && !tl->tl_closing && !( tl->tl_waiting > 0 && tl->tl_dirty ) ){
+			if ( tl->tl_dirty && tl->tl_sync == TWITLOG_SYNC_INTERVAL ){
+				deadline.tv_sec = ( time_t )( ( tl->tl_syncedat + interval ) / 1000000000u );
+				deadline.tv_nsec = ( long )( ( tl->tl_syncedat + interval ) % 1000000000u );
+				if ( timedwait_mutex( LOCK_TWITLOG, &tl->tl_cond, &tl->tl_lock, &tl->tl_lockedat, &deadline ) == ETIMEDOUT ){
+					break;
+				}
+			}
+			else{
+				wait_mutex( LOCK_TWITLOG, &tl->tl_cond, &tl->tl_lock, &tl->tl_lockedat );
+			}
+		}
+		// Commit the twits that are waited for together, if they are on their way
+		if ( tl->tl_waiting > 0 && !tl->tl_closing && tl->tl_waitseq > tl->tl_appendedseq ){
+			window = monotonic_ns() + ( uint64_t )TWITLOG_COMMIT_USEC * 1000u;
+			deadline.tv_sec = ( time_t )( window / 1000000000u );
+			deadline.tv_nsec = ( long )( window % 1000000000u );
+			while ( tl->tl_waitseq > tl->tl_appendedseq && !tl->tl_closing ){
+				if ( timedwait_mutex( LOCK_TWITLOG, &tl->tl_cond, &tl->tl_lock, &tl->tl_lockedat, &deadline ) == ETIMEDOUT ){
+					break;
+				}
+			}
+		}
+		buffer = tl->tl_buffer[ tl->tl_active ];
+		len = tl->tl_filled;
+		lastseq = tl->tl_appendedseq;
+		tl->tl_active ^= 1;
+		tl->tl_filled = 0;
+		closing = tl->tl_closing;
+		commit = ( tl->tl_waiting > 0 );
+		unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+
+		if ( len > 0 && writerecords( tl, buffer, len ) == -1 ){
+			// Every twit in the buffer is taken for lost
+			tl->tl_writtenseq = lastseq;
+			settle( tl, lastseq, 0 );
+		}
+		if ( commit ){
+			( void )__atomic_fetch_add( &tl->tl_commits, 1, __ATOMIC_RELAXED );
+		}
+		if ( tl->tl_sync == TWITLOG_SYNC_ALWAYS || closing || commit ||
+			( tl->tl_sync == TWITLOG_SYNC_INTERVAL && monotonic_ns() - tl->tl_syncedat >= interval ) ){
+			syncsegment( tl );
+		}
+		// Once closing nothing more is handed over, so an empty buffer means everything is written
+		if ( closing && len == 0 ){
+			break;
+		}
+	}
+
+	pthread_exit( NULL );
+}
+
+// Write runs of records that fit in the current segment
+static int writerecords( struct twitlog * restrict tl, const unsigned char * restrict buf, size_t len ){
+	size_t start = 0;
+	size_t end = 0;
+	size_t size;
+	uint64_t records = 0;
+	uint64_t seq = 0;
+
+	assert( tl != NULL );
+	assert( buf != NULL );
+
+	while ( end < len ){
+		size = TWITLOG_RECORD_HEADER_SIZE + getle16( buf + end + 4 );
+		if ( tl->tl_fd == -1 || ( tl->tl_segmentsize + ( end - start ) + size > TWITLOG_SEGMENT_SIZE &&
+			tl->tl_segmentsize + ( end - start ) > TWITLOG_SEGMENT_HEADER_SIZE ) ){
+			// Finish the current segment with the records so far
+			if ( end > start ){
+				if ( writerun( tl, buf + start, end - start, records, seq ) == -1 ){
+					break;
+				}
+				start = end;
+				records = 0;
+			}
+			if ( startsegment( tl, getle64( buf + end + 8 ) ) == -1 ){
+				error( "Failed to start a segment of the twit log in %s: %s\n", tl->tl_dir, strerror( errno ) );
+				( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+				return ( -1 );
+			}
+		}
+		seq = getle64( buf + end + 8 );
+		end += size;
+		++records;
+	}
+	if ( end == len && writerun( tl, buf + start, end - start, records, seq ) == 0 ){
+		return ( 0 );
+	}
+	// A write failed. The segment may end with part of a record, so the next records go to a new one
+	error( "Failed to write to the twit log in %s: %s\n", tl->tl_dir, strerror( errno ) );
+	( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+	( void )close( tl->tl_fd );
+	tl->tl_fd = -1;
+	if ( tl->tl_indexfd != -1 ){
+		( void )close( tl->tl_indexfd );
+		tl->tl_indexfd = -1;
+	}
+	tl->tl_dirty = 0;
+
+	return ( -1 );
+}
+
+static int writerun( struct twitlog * restrict tl, const unsigned char * restrict buf, size_t len, uint64_t records, uint64_t lastseq ){
+	assert( tl != NULL );
+	assert( buf != NULL );
+
+	if ( writeall( tl->tl_fd, buf, len ) == -1 ){
+		return ( -1 );
+	}
+	indexrun( tl, buf, len, tl->tl_segmentsize );
+	tl->tl_segmentsize += len;
+	tl->tl_dirty = 1;
+	tl->tl_writtenseq = lastseq;
+	( void )__atomic_fetch_add( &tl->tl_written, records, __ATOMIC_RELAXED );
+	( void )__atomic_fetch_add( &tl->tl_bytes, len, __ATOMIC_RELAXED );
+
+	return ( 0 );
+}
+
+// A full segment is synced whatever the policy; its entry in the directory too, unless syncing is left to the system
+static int startsegment( struct twitlog * restrict tl, uint64_t firstseq ){
+	unsigned char header[ TWITLOG_SEGMENT_HEADER_SIZE ];
+	char path[ TWITLOG_PATH_MAXLEN ];
+	int dirfd;
+
+	assert( tl != NULL );
+
+	if ( tl->tl_fd != -1 ){
+		syncsegment( tl );
+		( void )close( tl->tl_fd );
+		tl->tl_fd = -1;
+	}
+	if ( tl->tl_indexfd != -1 ){
+		( void )close( tl->tl_indexfd );
+		tl->tl_indexfd = -1;
+	}
+
+	( void )twitlogsegmentname( path, sizeof( path ), tl->tl_dir, firstseq );
+	if ( ( tl->tl_fd = open( path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644 ) ) == -1 ){
+		return ( -1 );
+	}
+	putle32( header, TWITLOG_SEGMENT_MAGIC );
+	putle32( header + 4, TWITLOG_VERSION );
+	putle64( header + 8, firstseq );
+	if ( writeall( tl->tl_fd, header, sizeof( header ) ) == -1 ){
+		( void )close( tl->tl_fd );
+		tl->tl_fd = -1;
+		return ( -1 );
+	}
+	tl->tl_segmentsize = TWITLOG_SEGMENT_HEADER_SIZE;
+	tl->tl_dirty = 1;
+	( void )__atomic_fetch_add( &tl->tl_segments, 1, __ATOMIC_RELAXED );
+
+	// Without its index the segment is still read, from its start
+	( void )twitlogindexname( path, sizeof( path ), tl->tl_dir, firstseq );
+	if ( ( tl->tl_indexfd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644 ) ) == -1 ){
+		error( "Failed to create the index %s of the twit log: %s\n", path, strerror( errno ) );
+	}
+	tl->tl_nextindexat = TWITLOG_SEGMENT_HEADER_SIZE;
+
+	if ( tl->tl_sync != TWITLOG_SYNC_NONE && ( dirfd = open( tl->tl_dir, O_RDONLY ) ) != -1 ){
+		( void )fsync( dirfd );
+		( void )close( dirfd );
+	}
+
+	return ( 0 );
+}
+
+// The entries are gathered and written together
+static void indexrun( struct twitlog * restrict tl, const unsigned char * restrict buf, size_t len, size_t offset ){
+	unsigned char entries[ 64 * TWITLOG_INDEX_ENTRY_SIZE ];
+	struct twitlogrecord r;
+	size_t filled = 0;
+	size_t at = 0;
+
+	assert( tl != NULL );
+	assert( buf != NULL );
+
+	if ( tl->tl_indexfd == -1 ){
+		return ;
+	}
+	while ( at < len ){
+		r.tlr_len = getle16( buf + at + 4 );
+		if ( indexed( &tl->tl_nextindexat, offset + at ) ){
+			r.tlr_seq = getle64( buf + at + 8 );
+			r.tlr_time = getle64( buf + at + 16 );
+			encodeindexentry( entries + filled, &r, offset + at );
+			filled += TWITLOG_INDEX_ENTRY_SIZE;
+		}
+		at += TWITLOG_RECORD_HEADER_SIZE + r.tlr_len;
+		if ( filled == sizeof( entries ) || ( at >= len && filled > 0 ) ){
+			if ( writeall( tl->tl_indexfd, entries, filled ) == -1 ){
+				error( "Failed to write the index of the twit log in %s: %s\n", tl->tl_dir, strerror( errno ) );
+				( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+				( void )close( tl->tl_indexfd );
+				tl->tl_indexfd = -1;
+				return ;
+			}
+			filled = 0;
+		}
+	}
+
+	return ;
+}
+
+static int indexed( size_t * restrict nextindexat, size_t offset ){
+	assert( nextindexat != NULL );
+
+	if ( offset < *nextindexat ){
+		return ( 0 );
+	}
+	*nextindexat = offset + TWITLOG_INDEX_STRIDE;
+
+	return ( 1 );
+}
+
+static void encodeindexentry( unsigned char * restrict buf, const struct twitlogrecord * restrict r, size_t offset ){
+	assert( buf != NULL );
+	assert( r != NULL );
+
+	putle64( buf, r->tlr_time );
+	putle64( buf + 8, r->tlr_seq );
+	putle64( buf + 16, ( uint64_t )offset );
+
+	return ;
+}
+
+// Only the data and the size of the file matter
+static void syncsegment( struct twitlog * restrict tl ){
+	uint64_t start;
+	int ok;
+
+	assert( tl != NULL );
+
+	if ( tl->tl_fd == -1 || !tl->tl_dirty ){
+		return ;
+	}
+	start = monotonic_ns();
+	ok = ( fdatasync( tl->tl_fd ) == 0 );
+	if ( !ok ){
+		error( "Failed to sync the twit log in %s: %s\n", tl->tl_dir, strerror( errno ) );
+		( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+	}
+	tl->tl_syncedat = monotonic_ns();
+	tl->tl_dirty = 0;
+	recordinhistogram( &tl->tl_synclatency, tl->tl_syncedat - start );
+	( void )__atomic_fetch_add( &tl->tl_syncs, 1, __ATOMIC_RELAXED );
+	settle( tl, tl->tl_writtenseq, ok );
+
+	return ;
+}
+
+// The sequence numbers only grow
+static void settle( struct twitlog * restrict tl, uint64_t seq, int ok ){
+	assert( tl != NULL );
+
+	lock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	if ( seq > tl->tl_syncedseq ){
+		tl->tl_syncedseq = seq;
+	}
+	if ( !ok ){
+		settlefailed( tl, seq );
+	}
+	else if ( tl->tl_waiting > 0 ){
+		while ( pthread_cond_broadcast( &tl->tl_synced_cond ) ){ continue; }
+	}
+	unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+
+	return ;
+}
+
+static void settlefailed( struct twitlog * restrict tl, uint64_t seq ){
+	assert( tl != NULL );
+
+	if ( seq > tl->tl_failedseq ){
+		tl->tl_failedseq = seq;
+	}
+	if ( tl->tl_waiting > 0 ){
+		while ( pthread_cond_broadcast( &tl->tl_synced_cond ) ){ continue; }
+	}
+
+	return ;
+}
+
+// A pass right away, then one every interval
+static void *twitlogCleaner( void *arg ){
+	struct twitlog *tl = ( struct twitlog * )arg;
+	struct timespec deadline;
+	uint64_t next;
+	int closing;
+
+	assert( arg != NULL );
+
+	do{
+		retainsegments( tl );
+		if ( tl->tl_retention.tlrt_compact ){
+			compactsegments( tl );
+		}
+		if ( tl->tl_retention.tlrt_hotsegments > 0 ){
+			compresssegments( tl );
+		}
+		next = monotonic_ns() + tl->tl_retention.tlrt_interval;
+		deadline.tv_sec = ( time_t )( next / 1000000000u );
+		deadline.tv_nsec = ( long )( next % 1000000000u );
+		lock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+		while ( !tl->tl_closing ){
+			if ( timedwait_mutex( LOCK_TWITLOG, &tl->tl_cleaner_cond, &tl->tl_lock, &tl->tl_lockedat, &deadline ) == ETIMEDOUT ){
+				break;
+			}
+		}
+		closing = tl->tl_closing;
+		unlock_mutex( LOCK_TWITLOG, &tl->tl_lock, &tl->tl_lockedat );
+	}while ( !closing );
+
+	pthread_exit( NULL );
+}
+
+// The records of a segment are all older than the first record of the next one, since the times never go back
+static void retainsegments( struct twitlog * restrict tl ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	const struct twitlogretention *rt = &tl->tl_retention;
+	struct stat st;
+	uint64_t *firstseqs = NULL;
+	uint64_t *sizes = NULL;
+	uint64_t total = 0;
+	uint64_t firsttime;
+	uint64_t now;
+	size_t count;
+	size_t removed = 0;
+	size_t i;
+	int expired;
+
+	assert( tl != NULL );
+
+	if ( listsegments( tl->tl_dir, &firstseqs, &count ) == -1 ){
+		error( "Failed to list the segments of the twit log in %s: %s\n", tl->tl_dir, strerror( errno ) );
+		( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+		return ;
+	}
+	if ( count < 2 || ( sizes = calloc( count, sizeof( *sizes ) ) ) == NULL ){
+		free( firstseqs );
+		return ;
+	}
+	// A file that is gone takes no room
+	for ( i = 0; i < count; ++i ){
+		if ( twitlogsegmentname( path, sizeof( path ), tl->tl_dir, firstseqs[ i ] ) == 0 && stat( path, &st ) == 0 ){
+			sizes[ i ] += ( uint64_t )st.st_size;
+		}
+		if ( twitlogcompressedname( path, sizeof( path ), tl->tl_dir, firstseqs[ i ] ) == 0 && stat( path, &st ) == 0 ){
+			sizes[ i ] += ( uint64_t )st.st_size;
+		}
+		if ( twitlogindexname( path, sizeof( path ), tl->tl_dir, firstseqs[ i ] ) == 0 && stat( path, &st ) == 0 ){
+			sizes[ i ] += ( uint64_t )st.st_size;
+		}
+		total += sizes[ i ];
+	}
+
+	now = realtime_ns();
+	while ( removed + 1 < count ){
+		expired = ( rt->tlrt_segments > 0 && count - removed > rt->tlrt_segments ) ||
+			( rt->tlrt_bytes > 0 && total > rt->tlrt_bytes ) ||
+			( rt->tlrt_age > 0 && now > rt->tlrt_age &&
+				firstrecordtime( tl->tl_dir, firstseqs[ removed + 1 ], &firsttime ) == 0 && firsttime < now - rt->tlrt_age );
+		if ( !expired ){
+			break;
+		}
+		if ( removesegment( tl, firstseqs[ removed ] ) == -1 ){
+			error( "Failed to remove the segment %llu of the twit log in %s: %s\n",
+				( unsigned long long )firstseqs[ removed ], tl->tl_dir, strerror( errno ) );
+			( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+			break;
+		}
+		total -= sizes[ removed ];
+		( void )__atomic_fetch_add( &tl->tl_removed, 1, __ATOMIC_RELAXED );
+		( void )__atomic_fetch_add( &tl->tl_reclaimed, sizes[ removed ], __ATOMIC_RELAXED );
+		++removed;
+	}
+	free( sizes );
+	free( firstseqs );
+
+	return ;
+}
+
+// Without its index a segment would still be read; without its segment an index would be left behind. The segment is there
+// compressed or not, or both for a moment
+static int removesegment( struct twitlog * restrict tl, uint64_t firstseq ){
+	static int ( * const names[] )( char * restrict buf, size_t size, const char * restrict dir, uint64_t firstseq ) = {
+		&twitlogindexname, &twitlogsegmentname, &twitlogcompressedname
+	};
+	char path[ TWITLOG_PATH_MAXLEN ];
+	char archived[ TWITLOG_PATH_MAXLEN ];
+	size_t i;
+
+	assert( tl != NULL );
+
+	for ( i = 0; i < sizeof( names ) / sizeof( names[ 0 ] ); ++i ){
+		if ( names[ i ]( path, sizeof( path ), tl->tl_dir, firstseq ) == -1 ){
+			return ( -1 );
+		}
+		if ( tl->tl_archivedir[ 0 ] != '\0' ){
+			( void )names[ i ]( archived, sizeof( archived ), tl->tl_archivedir, firstseq );
+			if ( rename( path, archived ) == -1 && errno != ENOENT ){
+				return ( -1 );
+			}
+		}
+		else if ( unlink( path ) == -1 && errno != ENOENT ){
+			return ( -1 );
+		}
+	}
+
+	return ( 0 );
+}
+
+// The segments are compacted once each, oldest first; after a restart they are all looked at again
+static void compactsegments( struct twitlog * restrict tl ){
+	uint64_t *firstseqs = NULL;
+	size_t count;
+	size_t i;
+
+	assert( tl != NULL );
+
+	if ( listsegments( tl->tl_dir, &firstseqs, &count ) == -1 ){
+		error( "Failed to list the segments of the twit log in %s: %s\n", tl->tl_dir, strerror( errno ) );
+		( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+		return ;
+	}
+	// tl_closing is read without the lock; closing is noticed a segment later at worst
+	for ( i = 0; i + 1 < count && !__atomic_load_n( &tl->tl_closing, __ATOMIC_RELAXED ); ++i ){
+		if ( firstseqs[ i ] <= tl->tl_compactedseq ){
+			continue;
+		}
+		if ( compactsegment( tl, firstseqs[ i ] ) == -1 ){
+			error( "Failed to compact the segment %llu of the twit log in %s: %s\n",
+				( unsigned long long )firstseqs[ i ], tl->tl_dir, strerror( errno ) );
+			( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+		}
+		tl->tl_compactedseq = firstseqs[ i ];
+	}
+	free( firstseqs );
+
+	return ;
+}
+
+// The records are checked once, then only their headers are read. The first record is never a duplicate, so the segment keeps its name
+static int compactsegment( struct twitlog * restrict tl, uint64_t firstseq ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	char indexpath[ TWITLOG_PATH_MAXLEN ];
+	char newpath[ TWITLOG_PATH_MAXLEN ];
+	char newindexpath[ TWITLOG_PATH_MAXLEN ];
+	const unsigned char *map = NULL;
+	struct dedupslot *slots = NULL;
+	size_t *dups = NULL;
+	size_t *moredups = NULL;
+	unsigned char *entries = NULL;
+	unsigned char *larger = NULL;
+	struct twitlogrecord r;
+	uint64_t start;
+	size_t size;
+	size_t offset;
+	size_t recordsize;
+	size_t records = 0;
+	size_t capacity;
+	size_t ndups = 0;
+	size_t dupcapacity = 0;
+	size_t newoffset;
+	size_t runstart;
+	size_t nextindexat = TWITLOG_SEGMENT_HEADER_SIZE;
+	size_t filled = 0;
+	size_t entrycapacity = 0;
+	size_t j = 0;
+	ssize_t decoded;
+	int fd = -1;
+	int indexfd = -1;
+	int status = -1;
+	int saved;
+
+	assert( tl != NULL );
+
+	start = monotonic_ns();
+	if ( twitlogsegmentname( path, sizeof( path ), tl->tl_dir, firstseq ) == -1 ||
+		twitlogindexname( indexpath, sizeof( indexpath ), tl->tl_dir, firstseq ) == -1 ){
+		return ( -1 );
+	}
+	if ( ( size_t )snprintf( newpath, sizeof( newpath ), "%s.compact", path ) >= sizeof( newpath ) ||
+		( size_t )snprintf( newindexpath, sizeof( newindexpath ), "%s.compact", indexpath ) >= sizeof( newindexpath ) ){
+		errno = ENAMETOOLONG;
+		return ( -1 );
+	}
+	if ( ( map = mapfile( path, &size, POSIX_MADV_SEQUENTIAL ) ) == NULL ){
+		// Removed meanwhile, or empty
+		return ( errno == 0 || errno == ENOENT ? 0 : -1 );
+	}
+
+	do{
+		offset = TWITLOG_SEGMENT_HEADER_SIZE;
+		while ( offset < size && ( decoded = decodetwitlogrecord( map + offset, size - offset, &r ) ) > 0 ){
+			++records;
+			offset += ( size_t )decoded;
+		}
+		// Damaged segments are left for someone to look at
+		if ( size < TWITLOG_SEGMENT_HEADER_SIZE || offset != size ){
+			status = 0;
+			break;
+		}
+
+		for ( capacity = 16; capacity < 2 * records; capacity *= 2 ){
+			continue;
+		}
+		if ( ( slots = calloc( capacity, sizeof( *slots ) ) ) == NULL ){
+			errno = ENOMEM;
+			break;
+		}
+		for ( offset = TWITLOG_SEGMENT_HEADER_SIZE; offset < size; offset += recordsize ){
+			recordsize = TWITLOG_RECORD_HEADER_SIZE + getle16( map + offset + 4 );
+			if ( !finddup( slots, capacity, map, offset,
+				crc32c( 0, map + offset + TWITLOG_RECORD_HEADER_SIZE, recordsize - TWITLOG_RECORD_HEADER_SIZE ) ) ){
+				continue;
+			}
+			if ( ndups == dupcapacity ){
+				dupcapacity = dupcapacity ? 2 * dupcapacity : 1024;
+				if ( ( moredups = realloc( dups, dupcapacity * sizeof( *dups ) ) ) == NULL ){
+					errno = ENOMEM;
+					break;
+				}
+				dups = moredups;
+			}
+			dups[ ndups++ ] = offset;
+		}
+		if ( offset < size ){
+			break;
+		}
+		if ( ndups == 0 ){
+			status = 0;
+			break;
+		}
+
+		// The records kept are written in runs and indexed at their new offsets
+		if ( ( fd = open( newpath, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 ||
+			( indexfd = open( newindexpath, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 ||
+			writeall( fd, map, TWITLOG_SEGMENT_HEADER_SIZE ) == -1 ){
+			break;
+		}
+		newoffset = TWITLOG_SEGMENT_HEADER_SIZE;
+		runstart = TWITLOG_SEGMENT_HEADER_SIZE;
+		for ( offset = TWITLOG_SEGMENT_HEADER_SIZE; offset < size; offset += recordsize ){
+			recordsize = TWITLOG_RECORD_HEADER_SIZE + getle16( map + offset + 4 );
+			if ( j < ndups && dups[ j ] == offset ){
+				if ( offset > runstart && writeall( fd, map + runstart, offset - runstart ) == -1 ){
+					break;
+				}
+				runstart = offset + recordsize;
+				++j;
+				continue;
+			}
+			if ( indexed( &nextindexat, newoffset ) ){
+				if ( filled == entrycapacity ){
+					entrycapacity = entrycapacity ? 2 * entrycapacity : 1024 * TWITLOG_INDEX_ENTRY_SIZE;
+					if ( ( larger = realloc( entries, entrycapacity ) ) == NULL ){
+						errno = ENOMEM;
+						break;
+					}
+					entries = larger;
+				}
+				r.tlr_seq = getle64( map + offset + 8 );
+				r.tlr_time = getle64( map + offset + 16 );
+				encodeindexentry( entries + filled, &r, newoffset );
+				filled += TWITLOG_INDEX_ENTRY_SIZE;
+			}
+			newoffset += recordsize;
+		}
+		if ( offset < size || ( size > runstart && writeall( fd, map + runstart, size - runstart ) == -1 ) ||
+			( filled > 0 && writeall( indexfd, entries, filled ) == -1 ) || fsync( fd ) == -1 ){
+			break;
+		}
+		// The index first; see the top of this file
+		if ( rename( newindexpath, indexpath ) == -1 || rename( newpath, path ) == -1 ){
+			break;
+		}
+		( void )__atomic_fetch_add( &tl->tl_reclaimed, size - newoffset, __ATOMIC_RELAXED );
+		( void )__atomic_fetch_add( &tl->tl_duplicates, ndups, __ATOMIC_RELAXED );
+		status = 0;
+	}while ( 0 );
+
+	saved = errno;
+	if ( fd != -1 ){
+		( void )close( fd );
+	}
+	if ( indexfd != -1 ){
+		( void )close( indexfd );
+	}
+	if ( status == -1 ){
+		( void )unlink( newpath );
+		( void )unlink( newindexpath );
+	}
+	free( entries );
+	free( dups );
+	free( slots );
+	( void )munmap( ( void * )map, size );
+	if ( status == 0 ){
+		( void )__atomic_fetch_add( &tl->tl_compacted, 1, __ATOMIC_RELAXED );
+		( void )__atomic_fetch_add( &tl->tl_compactbytes, size, __ATOMIC_RELAXED );
+		( void )__atomic_fetch_add( &tl->tl_compactns, monotonic_ns() - start, __ATOMIC_RELAXED );
+	}
+	errno = saved;
+
+	return ( status );
+}
+
+// Same as compactsegments()
+static void compresssegments( struct twitlog * restrict tl ){
+	uint64_t *firstseqs = NULL;
+	size_t count;
+	size_t i;
+
+	assert( tl != NULL );
+
+	if ( listsegments( tl->tl_dir, &firstseqs, &count ) == -1 ){
+		error( "Failed to list the segments of the twit log in %s: %s\n", tl->tl_dir, strerror( errno ) );
+		( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+		return ;
+	}
+	for ( i = 0; i + tl->tl_retention.tlrt_hotsegments < count && !__atomic_load_n( &tl->tl_closing, __ATOMIC_RELAXED ); ++i ){
+		if ( firstseqs[ i ] <= tl->tl_compressedseq ){
+			continue;
+		}
+		if ( compresssegment( tl, firstseqs[ i ] ) == -1 ){
+			error( "Failed to compress the segment %llu of the twit log in %s: %s\n",
+				( unsigned long long )firstseqs[ i ], tl->tl_dir, strerror( errno ) );
+			( void )__atomic_fetch_add( &tl->tl_errors, 1, __ATOMIC_RELAXED );
+		}
+		tl->tl_compressedseq = firstseqs[ i ];
+	}
+	free( firstseqs );
+
+	return ;
+}
+
+// A block is cut before the record that would not fit in it; the header of the segment goes in the first one
+static int compresssegment( struct twitlog * restrict tl, uint64_t firstseq ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	char lzpath[ TWITLOG_PATH_MAXLEN ];
+	char newpath[ TWITLOG_PATH_MAXLEN ];
+	unsigned char header[ TWITLOG_COMPRESSED_HEADER_SIZE ];
+	const unsigned char *map = NULL;
+	unsigned char *compressed = NULL;
+	unsigned char *table = NULL;
+	unsigned char *larger = NULL;
+	struct twitlogrecord r;
+	size_t size;
+	size_t offset;
+	size_t blockstart;
+	size_t clen;
+	size_t filled = 0;
+	size_t capacity = 0;
+	uint64_t written = TWITLOG_COMPRESSED_HEADER_SIZE;
+	ssize_t decoded;
+	int fd = -1;
+	int status = -1;
+	int saved;
+
+	assert( tl != NULL );
+
+	if ( twitlogsegmentname( path, sizeof( path ), tl->tl_dir, firstseq ) == -1 ||
+		twitlogcompressedname( lzpath, sizeof( lzpath ), tl->tl_dir, firstseq ) == -1 ){
+		return ( -1 );
+	}
+	if ( ( size_t )snprintf( newpath, sizeof( newpath ), "%s.new", lzpath ) >= sizeof( newpath ) ){
+		errno = ENAMETOOLONG;
+		return ( -1 );
+	}
+	if ( ( map = mapfile( path, &size, POSIX_MADV_SEQUENTIAL ) ) == NULL ){
+		// Compressed already, removed meanwhile, or empty
+		return ( errno == 0 || errno == ENOENT ? 0 : -1 );
+	}
+
+	do{
+		// Damaged segments are left for someone to look at
+		offset = TWITLOG_SEGMENT_HEADER_SIZE;
+		while ( offset < size && ( decoded = decodetwitlogrecord( map + offset, size - offset, &r ) ) > 0 ){
+			offset += ( size_t )decoded;
+		}
+		if ( size < TWITLOG_SEGMENT_HEADER_SIZE || offset != size || getle32( map ) != TWITLOG_SEGMENT_MAGIC ){
+			status = 0;
+			break;
+		}
+		if ( ( compressed = malloc( lzbound( TWITLOG_BLOCK_SIZE ) ) ) == NULL ){
+			errno = ENOMEM;
+			break;
+		}
+
+		// The header is written last, once the table is
+		( void )memset( header, 0, sizeof( header ) );
+		if ( ( fd = open( newpath, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 || writeall( fd, header, sizeof( header ) ) == -1 ){
+			break;
+		}
+		for ( blockstart = 0; blockstart < size; blockstart = offset ){
+			offset = blockstart == 0 ? TWITLOG_SEGMENT_HEADER_SIZE : blockstart;
+			while ( offset < size &&
+				offset + TWITLOG_RECORD_HEADER_SIZE + getle16( map + offset + 4 ) - blockstart <= TWITLOG_BLOCK_SIZE ){
+				offset += TWITLOG_RECORD_HEADER_SIZE + getle16( map + offset + 4 );
+			}
+			if ( ( clen = lzcompress( compressed, lzbound( TWITLOG_BLOCK_SIZE ), map + blockstart, offset - blockstart ) ) == 0 ){
+				errno = EOVERFLOW;
+				break;
+			}
+			if ( filled == capacity ){
+				capacity = capacity ? 2 * capacity : 64 * TWITLOG_BLOCK_ENTRY_SIZE;
+				if ( ( larger = realloc( table, capacity ) ) == NULL ){
+					errno = ENOMEM;
+					break;
+				}
+				table = larger;
+			}
+			putle64( table + filled, blockstart );
+			putle64( table + filled + 8, written );
+			putle32( table + filled + 16, ( uint32_t )clen );
+			putle32( table + filled + 20, ( uint32_t )( offset - blockstart ) );
+			filled += TWITLOG_BLOCK_ENTRY_SIZE;
+			if ( writeall( fd, compressed, clen ) == -1 ){
+				break;
+			}
+			written += clen;
+		}
+		if ( blockstart < size ){
+			break;
+		}
+		putle32( header, TWITLOG_COMPRESSED_MAGIC );
+		putle32( header + 4, TWITLOG_VERSION );
+		putle64( header + 8, firstseq );
+		putle64( header + 16, written );
+		if ( writeall( fd, table, filled ) == -1 || pwrite( fd, header, sizeof( header ), 0 ) != ( ssize_t )sizeof( header ) ||
+			fsync( fd ) == -1 ){
+			break;
+		}
+		// See the top of this file
+		if ( rename( newpath, lzpath ) == -1 || unlink( path ) == -1 ){
+			break;
+		}
+		written += filled;
+		( void )__atomic_fetch_add( &tl->tl_compressed, 1, __ATOMIC_RELAXED );
+		( void )__atomic_fetch_add( &tl->tl_compressedin, size, __ATOMIC_RELAXED );
+		( void )__atomic_fetch_add( &tl->tl_compressedout, written, __ATOMIC_RELAXED );
+		if ( written < size ){
+			( void )__atomic_fetch_add( &tl->tl_reclaimed, size - written, __ATOMIC_RELAXED );
+		}
+		status = 0;
+	}while ( 0 );
+
+	saved = errno;
+	if ( fd != -1 ){
+		( void )close( fd );
+	}
+	if ( status == -1 ){
+		( void )unlink( newpath );
+	}
+	free( table );
+	free( compressed );
+	( void )munmap( ( void * )map, size );
+	errno = saved;
+
+	return ( status );
+}
+
+// Linear probing; the table is at most half full
+static int finddup( struct dedupslot * restrict slots, size_t capacity, const unsigned char * restrict map, size_t offset, uint32_t hash ){
+	const size_t len = getle16( map + offset + 4 );
+	size_t i;
+
+	assert( slots != NULL );
+	assert( map != NULL );
+
+	for ( i = hash & ( capacity - 1 ); slots[ i ].ds_offset != 0; i = ( i + 1 ) & ( capacity - 1 ) ){
+		if ( slots[ i ].ds_hash == hash && getle16( map + slots[ i ].ds_offset + 4 ) == len &&
+			memcmp( map + slots[ i ].ds_offset + TWITLOG_RECORD_HEADER_SIZE, map + offset + TWITLOG_RECORD_HEADER_SIZE, len ) == 0 ){
+			return ( 1 );
+		}
+	}
+	slots[ i ].ds_hash = hash;
+	slots[ i ].ds_offset = offset;
+
+	return ( 0 );
+}
+
+// Check the segments in parallel, then deal with the newest. The two newest are always checked
+static int recoversegments( const char * restrict dir, const struct twitlogcheckpoint * restrict cps, size_t cpcount,
+	struct twitlogrecovery * restrict rc, uint64_t ** restrict damaged, size_t * restrict damagedcount ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	struct segmentchecks scs;
+	struct segmentcheck *newest = NULL;
+	pthread_t threads[ TWITLOG_RECOVERY_THREADS ];
+	uint64_t *firstseqs = NULL;
+	uint64_t start;
+	size_t count;
+	size_t started;
+	size_t i;
+	int fd;
+
+	assert( dir != NULL );
+	assert( rc != NULL );
+	assert( damaged != NULL );
+	assert( damagedcount != NULL );
+
+	start = monotonic_ns();
+	( void )memset( rc, 0, sizeof( *rc ) );
+	rc->tlrc_nextseq = 1;
+	*damaged = NULL;
+	*damagedcount = 0;
+	if ( listsegments( dir, &firstseqs, &count ) == -1 ){
+		return ( -1 );
+	}
+	if ( count == 0 ){
+		free( firstseqs );
+		rc->tlrc_elapsed = monotonic_ns() - start;
+		return ( 0 );
+	}
+	// The first sequence numbers are taken over as the array of damaged segments, which cannot be longer
+	if ( ( scs.scs_segments = calloc( count, sizeof( *scs.scs_segments ) ) ) == NULL ){
+		free( firstseqs );
+		errno = ENOMEM;
+		return ( -1 );
+	}
+	for ( i = 0; i < count; ++i ){
+		scs.scs_segments[ i ].sc_firstseq = firstseqs[ i ];
+		scs.scs_segments[ i ].sc_trusted = ( i + 2 < count && matchcheckpoint( dir, firstseqs[ i ], cps, cpcount ) );
+	}
+	*damaged = firstseqs;
+	scs.scs_dir = dir;
+	scs.scs_count = count;
+	scs.scs_next = 0;
+
+	// This thread checks segments too; if threads cannot be started it checks them all
+	for ( started = 0; started + 1 < TWITLOG_RECOVERY_THREADS && started + 1 < count; ++started ){
+		if ( pthread_create( &threads[ started ], NULL, &segmentChecker, &scs ) ){
+			break;
+		}
+	}
+	( void )segmentChecker( &scs );
+	for ( i = 0; i < started; ++i ){
+		( void )pthread_join( threads[ i ], NULL );
+	}
+	rc->tlrc_threads = ( unsigned )started + 1;
+
+	for ( i = 0; i < count; ++i ){
+		if ( scs.scs_segments[ i ].sc_error ){
+			errno = scs.scs_segments[ i ].sc_error;
+			free( scs.scs_segments );
+			free( *damaged );
+			*damaged = NULL;
+			return ( -1 );
+		}
+		if ( scs.scs_segments[ i ].sc_trusted ){
+			++rc->tlrc_trusted;
+			continue;
+		}
+		rc->tlrc_records += scs.scs_segments[ i ].sc_records;
+		rc->tlrc_reindexed += ( uint64_t )scs.scs_segments[ i ].sc_reindexed;
+		rc->tlrc_bytes += scs.scs_segments[ i ].sc_size;
+		if ( scs.scs_segments[ i ].sc_records > 0 ){
+			rc->tlrc_lastseq = scs.scs_segments[ i ].sc_lastseq;
+			rc->tlrc_lasttime = scs.scs_segments[ i ].sc_lasttime;
+		}
+		if ( i + 1 < count && scs.scs_segments[ i ].sc_valid < scs.scs_segments[ i ].sc_size ){
+			( void )( scs.scs_segments[ i ].sc_compressed ? twitlogcompressedname : twitlogsegmentname )( path, sizeof( path ), dir,
+				scs.scs_segments[ i ].sc_firstseq );
+			error( "Segment %s of the twit log is damaged after byte %llu; the %llu records before are kept\n", path,
+				( unsigned long long )scs.scs_segments[ i ].sc_valid, ( unsigned long long )scs.scs_segments[ i ].sc_records );
+			( *damaged )[ ( *damagedcount )++ ] = scs.scs_segments[ i ].sc_firstseq;
+			++rc->tlrc_damaged;
+		}
+	}
+	rc->tlrc_segments = count - rc->tlrc_trusted;
+
+	// Whatever follows the last valid record of the newest segment was being written when the server stopped; a compressed
+	// segment was whole when it was compressed, so it is only damaged
+	newest = &scs.scs_segments[ count - 1 ];
+	( void )twitlogsegmentname( path, sizeof( path ), dir, newest->sc_firstseq );
+	if ( newest->sc_records == 0 ){
+		( void )unlink( path );
+		( void )twitlogcompressedname( path, sizeof( path ), dir, newest->sc_firstseq );
+		( void )unlink( path );
+		( void )twitlogindexname( path, sizeof( path ), dir, newest->sc_firstseq );
+		( void )unlink( path );
+		rc->tlrc_nextseq = newest->sc_firstseq;
+		rc->tlrc_truncated = newest->sc_size;
+	}
+	else{
+		rc->tlrc_nextseq = newest->sc_lastseq + 1;
+		if ( newest->sc_compressed && newest->sc_valid < newest->sc_size ){
+			( void )twitlogcompressedname( path, sizeof( path ), dir, newest->sc_firstseq );
+			error( "Segment %s of the twit log is damaged after byte %llu; the %llu records before are kept\n", path,
+				( unsigned long long )newest->sc_valid, ( unsigned long long )newest->sc_records );
+			( *damaged )[ ( *damagedcount )++ ] = newest->sc_firstseq;
+			++rc->tlrc_damaged;
+		}
+		else if ( newest->sc_valid < newest->sc_size ){
+			if ( ( fd = open( path, O_WRONLY ) ) == -1 || ftruncate( fd, ( off_t )newest->sc_valid ) == -1 || fsync( fd ) == -1 ){
+				if ( fd != -1 ){
+					( void )close( fd );
+				}
+				free( scs.scs_segments );
+				free( *damaged );
+				*damaged = NULL;
+				return ( -1 );
+			}
+			( void )close( fd );
+			rc->tlrc_truncated = newest->sc_size - newest->sc_valid;
+		}
+	}
+	free( scs.scs_segments );
+	rc->tlrc_elapsed = monotonic_ns() - start;
+
+	return ( 0 );
+}
+
+static void *segmentChecker( void *arg ){
+	struct segmentchecks *scs = ( struct segmentchecks * )arg;
+	size_t i;
+
+	assert( arg != NULL );
+
+	while ( ( i = __atomic_fetch_add( &scs->scs_next, 1, __ATOMIC_RELAXED ) ) < scs->scs_count ){
+		if ( !scs->scs_segments[ i ].sc_trusted ){
+			checksegment( scs->scs_dir, &scs->scs_segments[ i ] );
+		}
+	}
+
+	return ( NULL );
+}
+
+// Binary search; the segment and its index must both be the same files, of the same size, last modified at the same time
+static int matchcheckpoint( const char * restrict dir, uint64_t firstseq, const struct twitlogcheckpoint * restrict cps, size_t count ){
+	struct twitlogcheckpoint now;
+	const struct twitlogcheckpoint *cp = NULL;
+	size_t low = 0, high = count, middle;
+
+	assert( dir != NULL );
+	assert( cps != NULL || count == 0 );
+
+	while ( low < high ){
+		middle = low + ( high - low ) / 2;
+		if ( cps[ middle ].tlcp_firstseq < firstseq ){
+			low = middle + 1;
+		}
+		else{
+			high = middle;
+		}
+	}
+	if ( low == count || cps[ low ].tlcp_firstseq != firstseq || statsegment( dir, firstseq, &now ) == -1 ){
+		return ( 0 );
+	}
+	cp = &cps[ low ];
+
+	return ( cp->tlcp_compressed == now.tlcp_compressed && cp->tlcp_ino == now.tlcp_ino && cp->tlcp_size == now.tlcp_size &&
+		cp->tlcp_mtime == now.tlcp_mtime && cp->tlcp_indexino == now.tlcp_indexino && cp->tlcp_indexsize == now.tlcp_indexsize &&
+		cp->tlcp_indexmtime == now.tlcp_indexmtime );
+}
+
+// The segment is read as opensegment() reads it, so it is the file not compressed if both are there
+static int statsegment( const char * restrict dir, uint64_t firstseq, struct twitlogcheckpoint * restrict cp ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	struct stat st;
+
+	assert( dir != NULL );
+	assert( cp != NULL );
+
+	( void )memset( cp, 0, sizeof( *cp ) );
+	cp->tlcp_firstseq = firstseq;
+	if ( twitlogsegmentname( path, sizeof( path ), dir, firstseq ) == -1 ){
+		return ( -1 );
+	}
+	if ( stat( path, &st ) == -1 ){
+		if ( errno != ENOENT || twitlogcompressedname( path, sizeof( path ), dir, firstseq ) == -1 || stat( path, &st ) == -1 ){
+			return ( -1 );
+		}
+		cp->tlcp_compressed = 1;
+	}
+	cp->tlcp_ino = ( uint64_t )st.st_ino;
+	cp->tlcp_size = ( uint64_t )st.st_size;
+	cp->tlcp_mtime = ( int64_t )st.st_mtime;
+	if ( twitlogindexname( path, sizeof( path ), dir, firstseq ) == -1 || stat( path, &st ) == -1 ){
+		return ( -1 );
+	}
+	cp->tlcp_indexino = ( uint64_t )st.st_ino;
+	cp->tlcp_indexsize = ( uint64_t )st.st_size;
+	cp->tlcp_indexmtime = ( int64_t )st.st_mtime;
+
+	return ( 0 );
+}
+
+// A segment cut short before its header was written has no records. The index the records should have is built along
+static void checksegment( const char * restrict dir, struct segmentcheck * restrict sc ){
+	struct segmentfile sf;
+	const unsigned char *header = NULL;
+	const unsigned char *record = NULL;
+	unsigned char *entries = NULL;
+	unsigned char *larger = NULL;
+	struct twitlogrecord r;
+	uint64_t lastseq;
+	size_t avail;
+	size_t offset;
+	size_t nextindexat = TWITLOG_SEGMENT_HEADER_SIZE;
+	size_t filled = 0;
+	size_t capacity = 0;
+	ssize_t recordsize;
+	int status;
+
+	assert( dir != NULL );
+	assert( sc != NULL );
+
+	sc->sc_size = 0;
+	sc->sc_valid = 0;
+	sc->sc_records = 0;
+	sc->sc_lastseq = 0;
+	sc->sc_lasttime = 0;
+	sc->sc_reindexed = 0;
+	sc->sc_compressed = 0;
+	sc->sc_error = 0;
+	if ( opensegment( dir, sc->sc_firstseq, POSIX_MADV_SEQUENTIAL, &sf ) == -1 ){
+		sc->sc_error = errno;
+		return ;
+	}
+	sc->sc_size = sf.sf_size;
+	sc->sc_compressed = ( sf.sf_blocks > 0 );
+	if ( ( header = segmentat( &sf, 0, &avail ) ) == NULL || avail < TWITLOG_SEGMENT_HEADER_SIZE ){
+		// A compressed segment whose first block cannot be read is as damaged as a header cut short is
+		closesegment( &sf );
+		sc->sc_error = sc->sc_compressed ? EPROTO : 0;
+		return ;
+	}
+	if ( getle32( header ) != TWITLOG_SEGMENT_MAGIC || getle32( header + 4 ) != TWITLOG_VERSION || getle64( header + 8 ) != sc->sc_firstseq ){
+		closesegment( &sf );
+		sc->sc_error = EPROTO;
+		return ;
+	}
+
+	offset = TWITLOG_SEGMENT_HEADER_SIZE;
+	lastseq = sc->sc_firstseq - 1;
+	while ( ( recordsize = recordat( &sf, offset, &r, &record ) ) > 0 && r.tlr_seq > lastseq ){
+		if ( indexed( &nextindexat, offset ) ){
+			if ( filled == capacity ){
+				capacity = capacity ? 2 * capacity : 1024 * TWITLOG_INDEX_ENTRY_SIZE;
+				if ( ( larger = realloc( entries, capacity ) ) == NULL ){
+					free( entries );
+					closesegment( &sf );
+					sc->sc_error = ENOMEM;
+					return ;
+				}
+				entries = larger;
+			}
+			encodeindexentry( entries + filled, &r, offset );
+			filled += TWITLOG_INDEX_ENTRY_SIZE;
+		}
+		lastseq = r.tlr_seq;
+		sc->sc_lasttime = r.tlr_time;
+		++sc->sc_records;
+		offset += ( size_t )recordsize;
+	}
+	sc->sc_valid = offset;
+	sc->sc_lastseq = sc->sc_records > 0 ? lastseq : 0;
+	closesegment( &sf );
+
+	if ( ( status = checkindex( dir, sc->sc_firstseq, entries, filled ) ) == -1 ){
+		sc->sc_error = errno;
+	}
+	sc->sc_reindexed = ( status == 1 );
+	free( entries );
+
+	return ;
+}
+
+// A missing index is taken as empty; an index cut short or left longer differs
+static int checkindex( const char * restrict dir, uint64_t firstseq, const unsigned char * restrict entries, size_t len ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	const unsigned char *map = NULL;
+	size_t size = 0;
+	int same;
+	int fd;
+
+	assert( dir != NULL );
+
+	if ( twitlogindexname( path, sizeof( path ), dir, firstseq ) == -1 ){
+		return ( -1 );
+	}
+	if ( ( map = mapfile( path, &size, POSIX_MADV_SEQUENTIAL ) ) == NULL && errno != 0 && errno != ENOENT ){
+		return ( -1 );
+	}
+	same = ( size == len && ( len == 0 || memcmp( map, entries, len ) == 0 ) );
+	if ( map != NULL ){
+		( void )munmap( ( void * )map, size );
+	}
+	if ( same ){
+		return ( 0 );
+	}
+	if ( ( fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 ){
+		return ( -1 );
+	}
+	if ( len > 0 && writeall( fd, entries, len ) == -1 ){
+		( void )close( fd );
+		return ( -1 );
+	}
+	( void )close( fd );
+
+	return ( 1 );
+}
+
+// The entries are in the order of their records, so of both keys
+static size_t indexedoffset( const char * restrict dir, uint64_t firstseq, uint64_t key, int bytime ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	const unsigned char *map = NULL;
+	size_t size;
+	size_t low, high, middle;
+	size_t offset = TWITLOG_SEGMENT_HEADER_SIZE;
+
+	assert( dir != NULL );
+
+	if ( twitlogindexname( path, sizeof( path ), dir, firstseq ) == -1 ||
+		( map = mapfile( path, &size, POSIX_MADV_RANDOM ) ) == NULL ){
+		return ( offset );
+	}
+	// The number of entries whose key is smaller
+	low = 0;
+	high = size / TWITLOG_INDEX_ENTRY_SIZE;
+	while ( low < high ){
+		middle = low + ( high - low ) / 2;
+		if ( getle64( map + middle * TWITLOG_INDEX_ENTRY_SIZE + ( bytime ? 0 : 8 ) ) < key ){
+			low = middle + 1;
+		}
+		else{
+			high = middle;
+		}
+	}
+	if ( low > 0 ){
+		offset = ( size_t )getle64( map + ( low - 1 ) * TWITLOG_INDEX_ENTRY_SIZE + 16 );
+	}
+	( void )munmap( ( void * )map, size );
+
+	return ( offset );
+}
+
+// Both files are as small as they come when the segment was just started
+static int firstrecordtime( const char * restrict dir, uint64_t firstseq, uint64_t * restrict time ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	unsigned char entry[ TWITLOG_INDEX_ENTRY_SIZE ];
+	unsigned char buf[ TWITLOG_RECORD_MAXSIZE ];
+	const unsigned char *record = NULL;
+	struct segmentfile sf;
+	struct twitlogrecord r;
+	ssize_t nread;
+	ssize_t recordsize;
+	int fd;
+
+	assert( dir != NULL );
+	assert( time != NULL );
+
+	if ( twitlogindexname( path, sizeof( path ), dir, firstseq ) == 0 && ( fd = open( path, O_RDONLY ) ) != -1 ){
+		nread = pread( fd, entry, sizeof( entry ), 0 );
+		( void )close( fd );
+		if ( nread == ( ssize_t )sizeof( entry ) && getle64( entry + 8 ) == firstseq ){
+			*time = getle64( entry );
+			return ( 0 );
+		}
+	}
+	if ( twitlogsegmentname( path, sizeof( path ), dir, firstseq ) == -1 ){
+		return ( -1 );
+	}
+	if ( ( fd = open( path, O_RDONLY ) ) == -1 ){
+		if ( errno != ENOENT ){
+			return ( -1 );
+		}
+		// Compressed segments always have their index; this is for one whose index was lost
+		if ( opensegment( dir, firstseq, POSIX_MADV_RANDOM, &sf ) == -1 ){
+			return ( errno == 0 || errno == ENOENT ? 1 : -1 );
+		}
+		recordsize = recordat( &sf, TWITLOG_SEGMENT_HEADER_SIZE, &r, &record );
+		closesegment( &sf );
+		if ( recordsize <= 0 ){
+			return ( 1 );
+		}
+		*time = r.tlr_time;
+		return ( 0 );
+	}
+	nread = pread( fd, buf, sizeof( buf ), TWITLOG_SEGMENT_HEADER_SIZE );
+	( void )close( fd );
+	if ( nread == -1 ){
+		return ( -1 );
+	}
+	if ( decodetwitlogrecord( buf, ( size_t )nread, &r ) <= 0 ){
+		return ( 1 );
+	}
+	*time = r.tlr_time;
+
+	return ( 0 );
+}
+
+static int listsegments( const char * restrict dir, uint64_t ** restrict firstseqs, size_t * restrict count ){
+	struct dirent *entry = NULL;
+	DIR *dp = NULL;
+	uint64_t *seqs = NULL;
+	uint64_t *larger = NULL;
+	size_t capacity = 0;
+	size_t n = 0;
+	size_t i, j;
+	uint64_t firstseq;
+
+	assert( dir != NULL );
+	assert( firstseqs != NULL );
+	assert( count != NULL );
+
+	if ( ( dp = opendir( dir ) ) == NULL ){
+		return ( -1 );
+	}
+	while ( ( entry = readdir( dp ) ) != NULL ){
+		if ( !parsesegmentname( entry->d_name, &firstseq ) ){
+			continue;
+		}
+		if ( n == capacity ){
+			capacity = capacity ? 2 * capacity : 64;
+			if ( ( larger = realloc( seqs, capacity * sizeof( *seqs ) ) ) == NULL ){
+				free( seqs );
+				( void )closedir( dp );
+				errno = ENOMEM;
+				return ( -1 );
+			}
+			seqs = larger;
+		}
+		seqs[ n++ ] = firstseq;
+	}
+	( void )closedir( dp );
+
+	// A segment is seen twice while it is compressed
+	if ( n > 0 ){
+		qsort( seqs, n, sizeof( *seqs ), &compareseqs );
+		for ( i = 1, j = 1; i < n; ++i ){
+			if ( seqs[ i ] != seqs[ j - 1 ] ){
+				seqs[ j++ ] = seqs[ i ];
+			}
+		}
+		n = j;
+	}
+	*firstseqs = seqs;
+	*count = n;
+
+	return ( 0 );
+}
+
+static int compareseqs( const void *a, const void *b ){
+	const uint64_t x = *( const uint64_t * )a;
+	const uint64_t y = *( const uint64_t * )b;
+
+	return ( x < y ? -1 : x > y );
+}
+
+// Segments read from start to end are read ahead; segments and indexes that are searched are not
+static const unsigned char *mapfile( const char * restrict path, size_t * restrict size, int advice ){
+	struct stat st;
+	void *map = NULL;
+	int fd;
+
+	assert( path != NULL );
+	assert( size != NULL );
+
+	*size = 0;
+	if ( ( fd = open( path, O_RDONLY ) ) == -1 ){
+		return ( NULL );
+	}
+	if ( fstat( fd, &st ) == -1 ){
+		( void )close( fd );
+		return ( NULL );
+	}
+	if ( st.st_size == 0 ){
+		( void )close( fd );
+		errno = 0;
+		return ( NULL );
+	}
+	map = mmap( NULL, ( size_t )st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	( void )close( fd );
+	if ( map == MAP_FAILED ){
+		return ( NULL );
+	}
+	( void )posix_madvise( map, ( size_t )st.st_size, advice );
+	*size = ( size_t )st.st_size;
+
+	return ( ( const unsigned char * )map );
+}
+
+// The segment is read in place if it was not compressed; the sizes in the table are checked so a block never goes outside the file
+static int opensegment( const char * restrict dir, uint64_t firstseq, int advice, struct segmentfile * restrict sf ){
+	char path[ TWITLOG_PATH_MAXLEN ];
+	struct stat st;
+	void *map = NULL;
+	const unsigned char *entry;
+	uint64_t tableat;
+	size_t size = 0;
+	size_t i;
+
+	assert( dir != NULL );
+	assert( sf != NULL );
+
+	( void )memset( sf, 0, sizeof( *sf ) );
+	sf->sf_fd = -1;
+	if ( twitlogsegmentname( path, sizeof( path ), dir, firstseq ) == -1 ){
+		return ( -1 );
+	}
+	if ( ( sf->sf_fd = open( path, O_RDONLY ) ) == -1 ){
+		if ( errno != ENOENT || twitlogcompressedname( path, sizeof( path ), dir, firstseq ) == -1 ||
+			( sf->sf_fd = open( path, O_RDONLY ) ) == -1 ){
+			return ( -1 );
+		}
+		sf->sf_blocks = 1;
+	}
+	if ( fstat( sf->sf_fd, &st ) == -1 ){
+		closesegment( sf );
+		return ( -1 );
+	}
+	if ( st.st_size == 0 ){
+		closesegment( sf );
+		errno = 0;
+		return ( -1 );
+	}
+	if ( ( map = mmap( NULL, ( size_t )st.st_size, PROT_READ, MAP_PRIVATE, sf->sf_fd, 0 ) ) == MAP_FAILED ){
+		closesegment( sf );
+		return ( -1 );
+	}
+	( void )posix_madvise( map, ( size_t )st.st_size, advice );
+	sf->sf_map = ( const unsigned char * )map;
+	sf->sf_mapsize = ( size_t )st.st_size;
+	if ( !sf->sf_blocks ){
+		sf->sf_size = sf->sf_mapsize;
+		return ( 0 );
+	}
+
+	// The blocks follow one another in the segment and lie between the header and the table in the file
+	if ( sf->sf_mapsize < TWITLOG_COMPRESSED_HEADER_SIZE || getle32( sf->sf_map ) != TWITLOG_COMPRESSED_MAGIC ||
+		getle32( sf->sf_map + 4 ) != TWITLOG_VERSION || getle64( sf->sf_map + 8 ) != firstseq ||
+		( tableat = getle64( sf->sf_map + 16 ) ) < TWITLOG_COMPRESSED_HEADER_SIZE || tableat > sf->sf_mapsize ||
+		( sf->sf_mapsize - tableat ) % TWITLOG_BLOCK_ENTRY_SIZE != 0 ){
+		closesegment( sf );
+		errno = EPROTO;
+		return ( -1 );
+	}
+	sf->sf_table = sf->sf_map + tableat;
+	sf->sf_blocks = ( sf->sf_mapsize - ( size_t )tableat ) / TWITLOG_BLOCK_ENTRY_SIZE;
+	for ( i = 0; i < sf->sf_blocks; ++i ){
+		entry = sf->sf_table + i * TWITLOG_BLOCK_ENTRY_SIZE;
+		if ( getle64( entry ) != size || getle64( entry + 8 ) < TWITLOG_COMPRESSED_HEADER_SIZE ||
+			getle64( entry + 8 ) > tableat || getle32( entry + 16 ) > tableat - getle64( entry + 8 ) ||
+			getle32( entry + 20 ) == 0 || getle32( entry + 20 ) > TWITLOG_BLOCK_SIZE ){
+			closesegment( sf );
+			errno = EPROTO;
+			return ( -1 );
+		}
+		size += getle32( entry + 20 );
+	}
+	sf->sf_size = size;
+	sf->sf_blockat = sf->sf_blocks;
+	if ( sf->sf_blocks == 0 ){
+		closesegment( sf );
+		errno = 0;
+		return ( -1 );
+	}
+	if ( ( sf->sf_block = malloc( TWITLOG_BLOCK_SIZE ) ) == NULL ){
+		closesegment( sf );
+		errno = ENOMEM;
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+// The block of the last call is looked at first; records are mostly read one after the other
+static const unsigned char *segmentat( struct segmentfile * restrict sf, size_t offset, size_t * restrict avail ){
+	const unsigned char *entry;
+	size_t low, high, middle;
+	size_t start;
+	size_t len;
+
+	assert( sf != NULL );
+	assert( avail != NULL );
+
+	if ( offset >= sf->sf_size ){
+		return ( NULL );
+	}
+	if ( sf->sf_blocks == 0 ){
+		*avail = sf->sf_size - offset;
+		return ( sf->sf_map + offset );
+	}
+
+	entry = sf->sf_table + sf->sf_blockat * TWITLOG_BLOCK_ENTRY_SIZE;
+	if ( sf->sf_blockat == sf->sf_blocks || offset < getle64( entry ) || offset - getle64( entry ) >= getle32( entry + 20 ) ){
+		// The last block that starts at or before the offset
+		low = 0;
+		high = sf->sf_blocks;
+		while ( high - low > 1 ){
+			middle = low + ( high - low ) / 2;
+			if ( getle64( sf->sf_table + middle * TWITLOG_BLOCK_ENTRY_SIZE ) <= offset ){
+				low = middle;
+			}
+			else{
+				high = middle;
+			}
+		}
+		entry = sf->sf_table + low * TWITLOG_BLOCK_ENTRY_SIZE;
+		len = getle32( entry + 20 );
+		if ( lzdecompress( sf->sf_block, TWITLOG_BLOCK_SIZE, sf->sf_map + getle64( entry + 8 ), getle32( entry + 16 ) ) != ( ssize_t )len ){
+			sf->sf_blockat = sf->sf_blocks;
+			errno = EILSEQ;
+			return ( NULL );
+		}
+		sf->sf_blockat = low;
+	}
+	start = ( size_t )getle64( entry );
+	*avail = getle32( entry + 20 ) - ( offset - start );
+
+	return ( sf->sf_block + ( offset - start ) );
+}
+
+// The errno of a failure to open the segment is kept
+static void closesegment( struct segmentfile * restrict sf ){
+	int saved = errno;
+
+	assert( sf != NULL );
+
+	if ( sf->sf_map != NULL ){
+		( void )munmap( ( void * )sf->sf_map, sf->sf_mapsize );
+	}
+	if ( sf->sf_fd != -1 ){
+		( void )close( sf->sf_fd );
+	}
+	free( sf->sf_block );
+	( void )memset( sf, 0, sizeof( *sf ) );
+	sf->sf_fd = -1;
+	errno = saved;
+
+	return ;
+}
+
+static ssize_t recordat( struct segmentfile * restrict sf, size_t offset, struct twitlogrecord * restrict r, const unsigned char ** restrict record ){
+	size_t avail;
+
+	assert( record != NULL );
+
+	if ( ( *record = segmentat( sf, offset, &avail ) ) == NULL ){
+		return ( 0 );
+	}
+
+	return ( decodetwitlogrecord( *record, avail, r ) );
+}
+
+// Twenty digits and ".log" or ".lz"
+static int parsesegmentname( const char * restrict name, uint64_t * restrict firstseq ){
+	uint64_t value = 0;
+	int i;
+
+	assert( name != NULL );
+	assert( firstseq != NULL );
+
+	for ( i = 0; i < 20; ++i ){
+		if ( name[ i ] < '0' || name[ i ] > '9' ){
+			return ( 0 );
+		}
+		value = value * 10 + ( uint64_t )( name[ i ] - '0' );
+	}
+	if ( strcmp( name + 20, ".log" ) != 0 && strcmp( name + 20, ".lz" ) != 0 ){
+		return ( 0 );
+	}
+	*firstseq = value;
+
+	return ( 1 );
+}
+
+static int writeall( int fd, const unsigned char * restrict buf, size_t len ){
+	ssize_t nwritten;
+
+	assert( buf != NULL );
+
+	while ( len > 0 ){
+		if ( ( nwritten = write( fd, buf, len ) ) == -1 ){
+			if ( errno == EINTR ){
+				continue;
+			}
+			return ( -1 );
+		}
+		buf += nwritten;
+		len -= ( size_t )nwritten;
+	}
+
+	return ( 0 );
+}
+
+static void putle16( unsigned char * restrict p, uint16_t value ){
+	p[ 0 ] = ( unsigned char )value;
+	p[ 1 ] = ( unsigned char )( value >> 8 );
+
+	return ;
+}
+
+static void putle32( unsigned char * restrict p, uint32_t value ){
+	putle16( p, ( uint16_t )value );
+	putle16( p + 2, ( uint16_t )( value >> 16 ) );
+
+	return ;
+}
+
+static void putle64( unsigned char * restrict p, uint64_t value ){
+	putle32( p, ( uint32_t )value );
+	putle32( p + 4, ( uint32_t )( value >> 32 ) );
+
+	return ;
+}
+
+static uint16_t getle16( const unsigned char * restrict p ){
+	return ( ( uint16_t )( p[ 0 ] | ( p[ 1 ] << 8 ) ) );
+}
+
+static uint32_t getle32( const unsigned char * restrict p ){
+	return ( ( uint32_t )getle16( p ) | ( ( uint32_t )getle16( p + 2 ) << 16 ) );
+}
+
+static uint64_t getle64( const unsigned char * restrict p ){
+	return ( ( uint64_t )getle32( p ) | ( ( uint64_t )getle32( p + 4 ) << 32 ) );
+}
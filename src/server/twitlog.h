@@ -0,0 +1,476 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file twitlog.h
+ *
+ * File twitlog.h declares the twit log: the twits accepted by the server are appended, in the order they are sent to the
+ * hearers, to segment files in a directory so they outlive the server.
+ *
+ * Each twit gets a sequence number from nexttwitlogseq(), starting from one and never reused, and is stored as a record of a header of
+ * TWITLOG_RECORD_HEADER_SIZE bytes followed by the twit. All numbers are stored little-endian:
+ *	offset 0: CRC-32C of bytes 4 up to the end of the twit (uint32_t)
+ *	offset 4: length of the twit (uint16_t)
+ *	offset 6: flags; TWITLOG_FLAG_DURABLE or zero (uint16_t)
+ *	offset 8: sequence number (uint64_t)
+ *	offset 16: time the twit was logged, in nanoseconds since the Epoch (uint64_t)
+ *
+ * A segment starts with a header of TWITLOG_SEGMENT_HEADER_SIZE bytes: TWITLOG_SEGMENT_MAGIC and TWITLOG_VERSION as uint32_t,
+ * then the sequence number of its first record as uint64_t. It is named after that sequence number (see twitlogsegmentname())
+ * and holds up to TWITLOG_SEGMENT_SIZE bytes; records never span segments. The times of the records never go back.
+ *
+ * Each segment has a sparse index next to it (see twitlogindexname()): an entry of TWITLOG_INDEX_ENTRY_SIZE bytes for the first
+ * record of the segment and for the first record that starts TWITLOG_INDEX_STRIDE bytes or more after the one of the entry before:
+ *	offset 0: time of the record (uint64_t)
+ *	offset 8: sequence number of the record (uint64_t)
+ *	offset 16: offset of the record in the segment (uint64_t)
+ * The index is mapped and binary searched, so seektwitlog() and readtwitlog() get to any twit with a few page faults and read no
+ * more than TWITLOG_INDEX_STRIDE bytes of records before it. It is written with the segment but never synced: opentwitlog() checks
+ * it against the records of the segment and writes it again if it does not match.
+ *
+ * A cold segment may be compressed (see twitlogcompressedname()): its bytes, header included, are cut at records into blocks of up
+ * to TWITLOG_BLOCK_SIZE bytes, each compressed on its own with lzcompress() (see lz.h). The file starts with a header of
+ * TWITLOG_COMPRESSED_HEADER_SIZE bytes: TWITLOG_COMPRESSED_MAGIC and TWITLOG_VERSION as uint32_t, the sequence number of the first
+ * record as uint64_t, then the offset of the block table as uint64_t. The blocks follow and the table ends the file, with an entry of
+ * TWITLOG_BLOCK_ENTRY_SIZE bytes for each block:
+ *	offset 0: offset of the block in the segment as it was written (uint64_t)
+ *	offset 8: offset of the compressed block in the file (uint64_t)
+ *	offset 16: bytes of the compressed block (uint32_t)
+ *	offset 20: bytes of the block (uint32_t)
+ * The offsets of the index are those of the segment as it was written, so a twit is found with the index, then the block that holds
+ * it with the table, and only that block and the ones after it that are needed are decompressed. Every function reads compressed
+ * segments as it reads the others.
+ *
+ * appendtwitlog() never blocks on the disk: it copies the record to a buffer that a writer thread, started by opentwitlog(),
+ * writes and syncs as enum twitlogsync says. If the writer falls behind by more than TWITLOG_BUFFER_SIZE bytes the twits
+ * that do not fit are left out of the log and counted. Durable twits, whose sayers wait in waittwitlog() until they are
+ * synced, may use TWITLOG_DURABLE_RESERVE more bytes so they are not left out when the writer is only a little behind.
+ *
+ * opentwitlog() recovers the log after a crash: it checks every record of every segment and cuts off the half written end of
+ * the newest one, so the twits go on from the last twit that reached the disk. readtwitlog() reads the records back and
+ * sendtwitlog() sends them to a socket as they are, without copying them through the server.
+ *
+ * retaintwitlog() starts a cleaner thread that keeps the log within the limits of a struct twitlogretention: it removes, or
+ * archives, the oldest whole segments, never the newest, may compact the others by writing them again without the twits
+ * that repeat one before them in the same segment and compresses the cold ones. None of it waits for or blocks the appender and
+ * the writer.
+ *
+ * @author Tassos Souris
+ */
+#if !defined( TWITLOG_H_IS_INCLUDED )
+#define TWITLOG_H_IS_INCLUDED 1
+
+#if defined( __cplusplus )
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "histogram.h"
+#include "twit.h"
+#include "config.h"
+
+// "TWLG" read as a little-endian uint32_t
+#define TWITLOG_SEGMENT_MAGIC (0x474c5754u)
+
+#define TWITLOG_VERSION (1)
+
+#define TWITLOG_SEGMENT_HEADER_SIZE (16)
+
+#define TWITLOG_RECORD_HEADER_SIZE (24)
+
+// The largest record
+#define TWITLOG_RECORD_MAXSIZE (TWITLOG_RECORD_HEADER_SIZE + TWIT_MAXLEN)
+
+// The sayer of the twit waited for it to be synced
+#define TWITLOG_FLAG_DURABLE (0x0001u)
+
+// Room kept for durable twits; each durable sayer waits for its twit before it sends the next one
+#define TWITLOG_DURABLE_RESERVE (SAYERS_MAXCOUNT * TWITLOG_RECORD_MAXSIZE)
+
+#define TWITLOG_INDEX_ENTRY_SIZE (24)
+
+// "TWLZ" read as a little-endian uint32_t
+#define TWITLOG_COMPRESSED_MAGIC (0x5a4c5754u)
+
+#define TWITLOG_COMPRESSED_HEADER_SIZE (24)
+
+#define TWITLOG_BLOCK_ENTRY_SIZE (24)
+
+// Enough for the path of a segment
+#define TWITLOG_PATH_MAXLEN (256)
+
+/**
+ * \enum twitlogsync
+ *
+ * The twitlogsync enumeration names the policies for syncing the twit log to the disk.
+ */
+enum twitlogsync{
+	TWITLOG_SYNC_NONE, /**< Left to the system; a segment is synced only when it is full and when the log is closed */
+	TWITLOG_SYNC_INTERVAL, /**< At most TWITLOG_SYNC_MSEC milliseconds after a twit is written */
+	TWITLOG_SYNC_ALWAYS, /**< After every write; the twits handed to the writer while it syncs go in the next write */
+	TWITLOG_SYNC_POLICIES
+};
+
+/**
+ * \struct twitlogrecord
+ *
+ * The twitlogrecord structure is the header of a record, decoded.
+ */
+struct twitlogrecord{
+	uint32_t tlr_crc;
+	uint16_t tlr_len;
+	uint16_t tlr_flags;
+	uint64_t tlr_seq;
+	uint64_t tlr_time;
+};
+
+/**
+ * \struct twitlogstats
+ *
+ * The twitlogstats structure keeps the counters of a twit log. Times are in nanoseconds.
+ */
+struct twitlogstats{
+	uint64_t tls_appended; /**< Number of twits handed to the writer */
+	uint64_t tls_dropped; /**< Number of twits left out of the log because the writer was behind */
+	uint64_t tls_written; /**< Number of twits written */
+	uint64_t tls_bytes; /**< Number of bytes written, headers included */
+	uint64_t tls_segments; /**< Number of segments started */
+	uint64_t tls_syncs; /**< Number of syncs */
+	uint64_t tls_errors; /**< Number of writes, syncs, removals, compactions and compressions that failed */
+	uint64_t tls_acked; /**< Number of twits waited for with waittwitlog() that were synced */
+	uint64_t tls_commits; /**< Number of syncs done because someone waited */
+	uint64_t tls_nextseq; /**< Sequence number the next twit will get */
+	uint64_t tls_removed; /**< Number of segments removed or archived by the cleaner */
+	uint64_t tls_reclaimed; /**< Bytes of segments and indexes removed or archived, and bytes saved by compacting and compressing segments */
+	uint64_t tls_compacted; /**< Number of segments the cleaner compacted, written again or not */
+	uint64_t tls_compactbytes; /**< Bytes of the segments it compacted */
+	uint64_t tls_compactns; /**< Time it took to compact them */
+	uint64_t tls_duplicates; /**< Number of twits compaction left out */
+	uint64_t tls_compressed; /**< Number of segments the cleaner compressed */
+	uint64_t tls_compressedin; /**< Bytes of those segments */
+	uint64_t tls_compressedout; /**< Bytes of them compressed */
+	struct histogram tls_sync; /**< Time each sync took */
+};
+
+/**
+ * \struct twitlogretention
+ *
+ * The twitlogretention structure tells retaintwitlog() how much of the twit log to keep. A limit of zero is no limit.
+ */
+struct twitlogretention{
+	uint64_t tlrt_age; /**< The segments whose records are all older than this many nanoseconds are removed */
+	uint64_t tlrt_bytes; /**< The oldest segments are removed while the segments and their indexes take more bytes */
+	uint64_t tlrt_segments; /**< The oldest segments are removed while there are more of them */
+	uint64_t tlrt_interval; /**< Nanoseconds between two passes of the cleaner */
+	int tlrt_compact; /**< Whether the segments are compacted once they are no longer the newest */
+	uint64_t tlrt_hotsegments; /**< The segments older than the newest tlrt_hotsegments are compressed; zero for none */
+	const char *tlrt_archivedir; /**< The directory, on the same file system, the segments removed are moved to; NULL to delete them */
+};
+
+/**
+ * \struct twitlogrecovery
+ *
+ * The twitlogrecovery structure tells what opentwitlog() found when it checked the segments of a twit log.
+ */
+struct twitlogrecovery{
+	uint64_t tlrc_segments; /**< Number of segments checked */
+	uint64_t tlrc_trusted; /**< Number of older segments not checked because they are as a checkpoint had them */
+	uint64_t tlrc_records; /**< Number of valid records in them */
+	uint64_t tlrc_bytes; /**< Bytes in them */
+	uint64_t tlrc_truncated; /**< Bytes cut off the end of the newest segment */
+	uint64_t tlrc_damaged; /**< Number of older segments with bytes after their last valid record; they are left as they are */
+	uint64_t tlrc_reindexed; /**< Number of segments whose index was written again */
+	uint64_t tlrc_lastseq; /**< Sequence number of the last valid record; zero if there is none */
+	uint64_t tlrc_lasttime; /**< Time of the last valid record; zero if there is none */
+	uint64_t tlrc_nextseq; /**< Sequence number the next twit gets */
+	unsigned tlrc_threads; /**< Number of threads that checked the segments */
+	uint64_t tlrc_elapsed; /**< Time it all took, in nanoseconds */
+};
+
+/**
+ * \struct twitlogcheckpoint
+ *
+ * The twitlogcheckpoint structure identifies the files of an older segment whose records were found whole, and of its index, as
+ * checkpointtwitlog() saw them. The members are all 64 bits wide so an array of them can be kept in a file as it is.
+ */
+struct twitlogcheckpoint{
+	uint64_t tlcp_firstseq; /**< The segment */
+	uint64_t tlcp_compressed; /**< Whether it was compressed */
+	uint64_t tlcp_ino; /**< Serial number of its file */
+	uint64_t tlcp_size; /**< Size of its file */
+	int64_t tlcp_mtime; /**< When its file was last modified, in seconds since the Epoch */
+	uint64_t tlcp_indexino; /**< The same for its index */
+	uint64_t tlcp_indexsize;
+	int64_t tlcp_indexmtime;
+};
+
+// Declared in twitlog.c
+struct twitlog;
+
+
+
+/**
+ * The opentwitlog() function shall open the twit log in the directory pointed to by parameter dir, creating the directory if it
+ * does not exist, start its writer thread and store a pointer to the log in the object pointed to by parameter tl. Every segment
+ * in the directory is checked first, by up to TWITLOG_RECOVERY_THREADS threads. The newest segment is cut after its last valid
+ * record, or removed if it has none. If parameter rc is not a NULL pointer what was found is stored in the object it points to.
+ * The twits appended get sequence numbers after those of the newest segment and go to a new segment. Parameter sync shall be
+ * one of the enum twitlogsync values other than TWITLOG_SYNC_POLICIES.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EINVAL Parameter sync is not valid or the path of a segment in dir would be longer than TWITLOG_PATH_MAXLEN.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * @exception EPROTO A segment does not start with a valid header.
+ * Any error of mkdir(), opendir(), open(), mmap() or ftruncate() on the directory and its segments, or of pthread_create().
+ */
+int opentwitlog( struct twitlog ** restrict tl, const char * restrict dir, enum twitlogsync sync, struct twitlogrecovery * restrict rc );
+
+/**
+ * The opentwitlogfrom() function shall open the twit log as opentwitlog() does, except that the segments other than the two newest
+ * whose files and indexes are the same as in one of the count checkpoints pointed to by parameter cps, sorted by tlcp_firstseq, are
+ * taken as whole without being checked. The checkpoints shall come from checkpointtwitlog() on the same directory.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set as by opentwitlog().
+ */
+int opentwitlogfrom( struct twitlog ** restrict tl, const char * restrict dir, enum twitlogsync sync,
+	const struct twitlogcheckpoint * restrict cps, size_t count, struct twitlogrecovery * restrict rc );
+
+/**
+ * The nexttwitlogseq() function shall return the next sequence number of the twit log pointed to by parameter tl. It may be called
+ * by any thread; the twits shall be appended in the order of their sequence numbers.
+ *
+ * @return The sequence number.
+ */
+uint64_t nexttwitlogseq( struct twitlog * restrict tl );
+
+/**
+ * The peektwitlogseq() function shall return the sequence number the next call of nexttwitlogseq() on the twit log pointed to by
+ * parameter tl shall return, without taking it. The caller shall make sure that no other thread takes one in between.
+ *
+ * @return The sequence number.
+ */
+uint64_t peektwitlogseq( struct twitlog * restrict tl );
+
+/**
+ * The skiptwitlogseq() function shall make sure that the sequence numbers the twit log pointed to by parameter tl gives from then on
+ * are not smaller than parameter seq, skipping those before it. It shall be called before any twit is appended.
+ *
+ * @return Nothing.
+ */
+void skiptwitlogseq( struct twitlog * restrict tl, uint64_t seq );
+
+/**
+ * The appendtwitlog() function shall hand the twit pointed to by parameter t, whose t_seq member holds a sequence number larger than
+ * that of any twit appended before, to the writer of the twit log pointed to by parameter tl, and store in its t_logged member the
+ * time of the record, handed over or not. It never waits for the disk. Only one thread shall append to a twit log.
+ *
+ * @return Zero if the twit was handed to the writer; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * A durable twit that is not handed to the writer makes waittwitlog() fail.
+ * @exception EAGAIN The writer is too far behind; the twit is counted in tls_dropped.
+ * @exception ECANCELED The twit log is being closed.
+ */
+int appendtwitlog( struct twitlog * restrict tl, struct twit * restrict t );
+
+/**
+ * The appendedtwitlogseq() function shall return the sequence number of the last twit handed to the writer of the twit log pointed
+ * to by parameter tl; zero if there is none. Waiting for it with waittwitlog() waits for every twit handed over before.
+ *
+ * @return The sequence number.
+ */
+uint64_t appendedtwitlogseq( struct twitlog * restrict tl );
+
+/**
+ * The waittwitlog() function shall wait until the twit with the sequence number given as parameter seq is synced to the disk by the
+ * writer of the twit log pointed to by parameter tl, whatever the sync policy. The syncs are shared by the twits waited for at the
+ * same time. The twit shall be, or later be, appended with appendtwitlog().
+ *
+ * @return Zero if the twit is on the disk; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EIO The twit was not logged, a write or a sync failed after it was handed to the writer, or the waiters were released or
+ * the log was closed first. A failure may also be reported for a twit synced just before a write of a later one failed.
+ */
+int waittwitlog( struct twitlog * restrict tl, uint64_t seq );
+
+/**
+ * The releasetwitlogwaiters() function shall let the threads in waittwitlog() on the twit log pointed to by parameter tl return, those
+ * whose twit is not synced yet failing, and make the later calls fail at once, so the threads that wait can be stopped before the log
+ * is closed.
+ *
+ * @return Nothing.
+ */
+void releasetwitlogwaiters( struct twitlog * restrict tl );
+
+/**
+ * The readtwitlog() function shall call the function pointed to by parameter fn for each valid record of the twit log in the directory
+ * pointed to by parameter dir whose sequence number is not smaller than parameter fromseq, in the order of their sequence numbers,
+ * with the decoded header of the record, a pointer to its twit and parameter arg, until fn returns nonzero. The log may be written
+ * meanwhile; the records written after a segment was mapped are not read. A segment is read up to its first record that is not
+ * whole and valid. The first segment is read from the entry of its index before fromseq.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EINVAL Parameter dir or fn is a NULL pointer.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * Any error of opendir(), open() or mmap() on the directory and its segments.
+ */
+int readtwitlog( const char * restrict dir, uint64_t fromseq,
+	int ( *fn )( const struct twitlogrecord * restrict r, const char * restrict twit, void *arg ), void *arg );
+
+/**
+ * The sendtwitlog() function shall send to the socket sockfd, with sendfile(), the valid records of the twit log in the directory
+ * pointed to by parameter dir whose sequence numbers are from fromseq up to but not including toseq, as they are stored in the
+ * segments, and add to the object pointed to by parameter sent the number of sequence numbers from the first record sent to the
+ * last one; the twits left out of the log between them are counted too. Only the records within TWITLOG_INDEX_STRIDE bytes of both
+ * ends of each segment sent are read; the ones between them were checked when the log was opened or were written since. A segment
+ * is sent up to its first record that is not whole and valid.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EINVAL Parameter dir or sent is a NULL pointer.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * @exception EIO A segment became shorter while it was sent.
+ * Any error of opendir(), open() or mmap() on the directory and its segments, or of sendfile() on the socket.
+ */
+int sendtwitlog( const char * restrict dir, uint64_t fromseq, uint64_t toseq, int sockfd, uint64_t * restrict sent );
+
+/**
+ * The seektwitlog() function shall store in the object pointed to by parameter seq the sequence number of the first valid record of
+ * the twit log in the directory pointed to by parameter dir that was logged at or after the time given as parameter time, in
+ * nanoseconds since the Epoch; zero if there is none. Only the first record of some segments, the indexes of some of them and the
+ * records of one segment within TWITLOG_INDEX_STRIDE bytes are read.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EINVAL Parameter dir or seq is a NULL pointer.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * Any error of opendir(), open() or mmap() on the directory and its segments.
+ */
+int seektwitlog( const char * restrict dir, uint64_t time, uint64_t * restrict seq );
+
+/**
+ * The retaintwitlog() function shall start the cleaner thread of the twit log pointed to by parameter tl, which every tlrt_interval
+ * nanoseconds removes the oldest segments, and their indexes, that are over the limits of the struct twitlogretention object
+ * pointed to by parameter rt, or moves them to tlrt_archivedir, creating it if it does not exist. The newest segment is never
+ * removed. With tlrt_compact each other segment is then compacted once: if some of its twits have the same content as one before
+ * them in the segment it is written again without them, with its index, and put in place of the old one. Then the segments older
+ * than the newest tlrt_hotsegments are compressed, after they were compacted. Segments with bytes after their last valid record are
+ * left as they are. Readers that opened a segment before go on reading the old one. It shall be called at most once; closetwitlog()
+ * stops the cleaner.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EINVAL Parameter tl or rt is a NULL pointer, tlrt_interval is zero or the path of a segment in tlrt_archivedir would
+ *	be longer than TWITLOG_PATH_MAXLEN.
+ * Any error of mkdir() on tlrt_archivedir or of pthread_create().
+ */
+int retaintwitlog( struct twitlog * restrict tl, const struct twitlogretention * restrict rt );
+
+/**
+ * The checkpointtwitlog() function shall store in the object pointed to by parameter cps a pointer to an array, allocated with
+ * malloc(), of the checkpoints of the segments of the twit log pointed to by parameter tl other than the two newest, sorted by
+ * tlcp_firstseq, and their number in the object pointed to by parameter count. The segments found damaged when the log was opened,
+ * and those without an index, are left out. It may be called by any thread while the log is open.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception ENOMEM Insufficient storage space to perform the operation.
+ * Any error of opendir() on the directory of the log.
+ */
+int checkpointtwitlog( struct twitlog * restrict tl, struct twitlogcheckpoint ** restrict cps, size_t * restrict count );
+
+/**
+ * The closetwitlog() function shall wait until the writer of the twit log pointed to by parameter tl has written and synced every
+ * twit handed to it, stop it and the cleaner, let the threads in waittwitlog() return and deallocate the log. No thread shall use the log after that.
+ *
+ * @return Nothing.
+ */
+void closetwitlog( struct twitlog * restrict tl );
+
+/**
+ * The snapshottwitlog() function shall store in the object pointed to by parameter stats the counters of the twit log pointed to by
+ * parameter tl. It never blocks the appender or the writer.
+ *
+ * @return Nothing.
+ */
+void snapshottwitlog( struct twitlog * restrict tl, struct twitlogstats * restrict stats );
+
+/**
+ * The encodetwitlogrecord() function shall store in the buffer pointed to by parameter buf, which shall have room for
+ * TWITLOG_RECORD_HEADER_SIZE plus tlr_len bytes, the record made of the header pointed to by parameter r and the tlr_len bytes
+ * pointed to by parameter twit. The tlr_crc member of the header is ignored; the checksum is computed.
+ *
+ * @return The size of the record.
+ */
+size_t encodetwitlogrecord( unsigned char * restrict buf, const struct twitlogrecord * restrict r, const char * restrict twit );
+
+/**
+ * The decodetwitlogrecord() function shall decode the header of the record stored at the start of the len bytes pointed to by
+ * parameter buf into the object pointed to by parameter r and check the checksum of the record. The twit follows the header.
+ *
+ * @return The size of the record if it is whole and valid; zero if the len bytes end before the record does; otherwise, -1 shall be
+ * returned and errno shall be set to indicate the error.
+ * @exception EILSEQ The record is empty, longer than TWITLOG_RECORD_MAXSIZE or its checksum does not match.
+ */
+ssize_t decodetwitlogrecord( const unsigned char * restrict buf, size_t len, struct twitlogrecord * restrict r );
+
+/**
+ * The twitlogsegmentname() function shall store in the buffer of size bytes pointed to by parameter buf the path of the segment
+ * in the directory pointed to by parameter dir whose first record has the sequence number given as parameter firstseq.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EINVAL The path does not fit in the buffer.
+ */
+int twitlogsegmentname( char * restrict buf, size_t size, const char * restrict dir, uint64_t firstseq );
+
+/**
+ * The twitlogindexname() function shall store in the buffer of size bytes pointed to by parameter buf the path of the index of
+ * the segment in the directory pointed to by parameter dir whose first record has the sequence number given as parameter firstseq.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EINVAL The path does not fit in the buffer.
+ */
+int twitlogindexname( char * restrict buf, size_t size, const char * restrict dir, uint64_t firstseq );
+
+/**
+ * The twitlogcompressedname() function shall store in the buffer of size bytes pointed to by parameter buf the path of the segment
+ * of the twit log in the directory pointed to by parameter dir whose first record has the sequence number given as parameter
+ * firstseq, once it is compressed: the sequence number in twenty digits followed by ".lz". Only one of the two is there, but for a
+ * moment while the segment is compressed; the one not compressed is read then.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @exception EINVAL The path does not fit in size bytes.
+ */
+int twitlogcompressedname( char * restrict buf, size_t size, const char * restrict dir, uint64_t firstseq );
+
+/**
+ * The twitlogsyncname() function shall return the name of the policy given as parameter, which shall be a valid
+ * enum twitlogsync value other than TWITLOG_SYNC_POLICIES.
+ *
+ * @return Pointer to the name of the policy.
+ */
+const char *twitlogsyncname( enum twitlogsync sync );
+
+#if defined( __cplusplus )
+}
+#endif
+
+#endif
@@ -103,6 +103,35 @@ int putintwitpool( struct twitpool * restrict tp,
 	return ( 0 );
 }
 
+// Put a copy of the twit and its timestamps in the pool
+int puttwitintwitpool( struct twitpool * restrict tp, 
+			const struct twit * restrict t ){
+	// Validate the parameters
+	if ( tp == NULL || t == NULL ){
+		errno = EINVAL;
+		return ( -1 );
+	}
+
+	// Copy the twit itself
+	if ( putintwitpool( tp, t->t_twit, t->t_twitlen ) == -1 ){
+		return ( -1 );
+	}
+
+	// The new node is at the tail
+	tp->tp_tail->tpn_twit.t_received = t->t_received;
+	tp->tp_tail->tpn_twit.t_dequeued = t->t_dequeued;
+	tp->tp_tail->tpn_twit.t_enqueued = t->t_enqueued;
+	tp->tp_tail->tpn_twit.t_seq = t->t_seq;
+	tp->tp_tail->tpn_twit.t_durable = t->t_durable;
+	tp->tp_tail->tpn_twit.t_logged = t->t_logged;
+	tp->tp_tail->tpn_twit.t_topiclen = t->t_topiclen;
+	tp->tp_tail->tpn_twit.t_topichash = t->t_topichash;
+	tp->tp_tail->tpn_twit.t_tagcount = t->t_tagcount;
+	( void )memcpy( tp->tp_tail->tpn_twit.t_tags, t->t_tags, t->t_tagcount * sizeof( *t->t_tags ) );
+
+	return ( 0 );
+}
+
 // Retrieve twit from the head
 int getfromtwitpool( struct twitpool * restrict tp, 
 			struct twit * restrict t ){
@@ -132,6 +161,16 @@ int getfromtwitpool( struct twitpool * restrict tp,
 	// need not copy the twit to the struct twit. I just pass the pointer. 
 	t->t_twit = node->tpn_twit.t_twit;
 	t->t_twitlen = node->tpn_twit.t_twitlen;
+	t->t_received = node->tpn_twit.t_received;
+	t->t_dequeued = node->tpn_twit.t_dequeued;
+	t->t_enqueued = node->tpn_twit.t_enqueued;
+	t->t_seq = node->tpn_twit.t_seq;
+	t->t_durable = node->tpn_twit.t_durable;
+	t->t_logged = node->tpn_twit.t_logged;
+	t->t_topiclen = node->tpn_twit.t_topiclen;
+	t->t_topichash = node->tpn_twit.t_topichash;
+	t->t_tagcount = node->tpn_twit.t_tagcount;
+	( void )memcpy( t->t_tags, node->tpn_twit.t_tags, t->t_tagcount * sizeof( *t->t_tags ) );
 	
 	// free the pool node
 	free( node );
@@ -89,6 +89,18 @@ int inittwitpool( struct twitpool * restrict tp );
  */
 int putintwitpool( struct twitpool * restrict tp, const char * restrict string, size_t string_len );
 
+/**
+ * The puttwitintwitpool() function shall store in the set of twits represented by the struct twitpool object pointed to by parameter tp
+ * a copy of the struct twit object pointed to by parameter t; both the twit and the timestamps are copied.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and errno shall be set to indicate the error.
+ * @param tp Pointer to the struct twitpool object.
+ * @param t Pointer to the struct twit object to be copied.
+ * @exception EINVAL Parameters tp or t is a NULL pointer or the twit is empty.
+ * @exception ENOMEM Insufficiet storage space to perform the operation.
+ */
+int puttwitintwitpool( struct twitpool * restrict tp, const struct twit * restrict t );
+
 /**
  * The getfromtwitpool() function shall retrieve a twit from the set of twits represented by the struct twitpool object pointed to by
  * parameter tp and store the results in the struct twit object pointed to by parameter t. Note that the client is responsible for deallocating
@@ -34,9 +34,11 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 #include "twitpool.h"
 #include "twitpoollist.h"
+#include "lockstats.h"
 
 
 
@@ -50,14 +52,21 @@ int inittwitpoollist( struct twitpoollist * restrict tpl ){
 
 	// At first the list is empty so head points to nothing
 	tpl->tpl_head = NULL;
+	tpl->tpl_nextid = 1;
+	tpl->tpl_hearers = NULL;
+	tpl->tpl_hearercap = 0;
 
 	return ( 0 );
 }
 
 // Create a node and insert it at the begining of the list. Store the address of the new node at *tplnode. 
+// The numbers of the hearers are looked for from the start, there being few hearers, so the lowest free one is taken
 int newtwitpool( struct twitpoollist * restrict tpl, 
 			struct twitpoollist_node ** restrict tplnode ){
 	struct twitpoollist_node *newNode = NULL; // Must be initialized to NULL cause it is used as an error flag later
+	struct twitpoollist_node **hearers = NULL;
+	uint32_t hearer;
+	uint32_t capacity;
 	int status = 0; // Must initialize to 0 cause status will only be changed if something wrong happens
 
 	// Validate the parameters
@@ -67,6 +76,18 @@ int newtwitpool( struct twitpoollist * restrict tpl,
 	}
 
 	do{
+		// Find the number of the hearer, making room for one more if they are all taken
+		for ( hearer = 0; hearer < tpl->tpl_hearercap && tpl->tpl_hearers[ hearer ] != NULL; ++hearer ){
+			continue;
+		}
+		if ( hearer == tpl->tpl_hearercap ){
+			capacity = tpl->tpl_hearercap == 0 ? 32 : 2 * tpl->tpl_hearercap;
+			if ( ( hearers = realloc( tpl->tpl_hearers, capacity * sizeof( *hearers ) ) ) == NULL ){ status = -1; break; }
+			( void )memset( hearers + tpl->tpl_hearercap, 0, ( capacity - tpl->tpl_hearercap ) * sizeof( *hearers ) );
+			tpl->tpl_hearers = hearers;
+			tpl->tpl_hearercap = capacity;
+		}
+
 		// Create the new node
 		if ( ( newNode = malloc( sizeof( struct twitpoollist_node ) ) ) == NULL ){ status = -1; break; }
 
@@ -77,7 +98,15 @@ int newtwitpool( struct twitpoollist * restrict tpl,
 		while ( pthread_mutex_init( &newNode->tpln_lock, NULL ) ){ continue; }
 		while ( pthread_cond_init( &newNode->tpln_cond, NULL ) ){ continue; }
 
+		// Initialize the counters
+		newNode->tpln_id = tpl->tpl_nextid++;
+		newNode->tpln_hearer = hearer;
+		tpl->tpl_hearers[ hearer ] = newNode;
+		newNode->tpln_sockfd = -1;
+		( void )memset( &newNode->tpln_telemetry, 0, sizeof( newNode->tpln_telemetry ) );
+
 		// Link the new node at the beginning of the list
+		newNode->tpln_previous = NULL;
 		newNode->tpln_next = tpl->tpl_head;
 		if ( tpl->tpl_head != NULL ){
 			tpl->tpl_head->tpln_previous = newNode;
@@ -112,6 +141,13 @@ int removefromtwitpoollist( struct twitpoollist * restrict tpl,
 	else{
 		tplnode->tpln_previous->tpln_next = tplnode->tpln_next;
 	}
+	// And the next node, if any, must be made to point back to the previous one
+	if ( tplnode->tpln_next != NULL ){
+		tplnode->tpln_next->tpln_previous = tplnode->tpln_previous;
+	}
+
+	// Its number is free for the next one
+	tpl->tpl_hearers[ tplnode->tpln_hearer ] = NULL;
 
 	// Cleanup that node
 	deltwitpool( &tplnode->tpln_twitpool );
@@ -127,6 +163,7 @@ void deltwitpoollist( struct twitpoollist * restrict tpl ){
 	if ( tpl != NULL ){
 		struct twitpoollist_node *current = NULL;
 		struct twitpoollist_node *next = NULL;
+		// The hearers are gone (see stophearers()), so nobody waits on the nodes any more
 		for ( current = tpl->tpl_head; current != NULL; current = next ){
 			next = current->tpln_next;
 			deltwitpool( &current->tpln_twitpool );
@@ -134,6 +171,10 @@ void deltwitpoollist( struct twitpoollist * restrict tpl ){
 			while ( pthread_cond_destroy( &current->tpln_cond ) ){ continue; }
 			free( current );
 		}
+		tpl->tpl_head = NULL;
+		free( tpl->tpl_hearers );
+		tpl->tpl_hearers = NULL;
+		tpl->tpl_hearercap = 0;
 	}
 
 	return ;
@@ -143,7 +184,7 @@ void deltwitpoollist( struct twitpoollist * restrict tpl ){
 void acquire_twitpool_in_twitpoollist_node( struct twitpoollist_node * restrict tpln ){
 	assert( tpln != NULL );
 
-	while ( pthread_mutex_lock( &tpln->tpln_lock ) ){ continue; }
+	lock_mutex( LOCK_HEARER_TWITPOOL, &tpln->tpln_lock, &tpln->tpln_lockedat );
 
 	return ;
 }
@@ -151,7 +192,15 @@ void acquire_twitpool_in_twitpoollist_node( struct twitpoollist_node * restrict
 void release_twitpool_in_twitpoollist_node( struct twitpoollist_node * restrict tpln ){
 	assert( tpln != NULL );
 
-	while ( pthread_mutex_unlock( &tpln->tpln_lock ) ){ continue; }
+	unlock_mutex( LOCK_HEARER_TWITPOOL, &tpln->tpln_lock, &tpln->tpln_lockedat );
+
+	return ;
+}
+
+void wait_twitpool_in_twitpoollist_node( struct twitpoollist_node * restrict tpln ){
+	assert( tpln != NULL );
+
+	wait_mutex( LOCK_HEARER_TWITPOOL, &tpln->tpln_cond, &tpln->tpln_lock, &tpln->tpln_lockedat );
 
 	return ;
 }
@@ -32,6 +32,7 @@ extern "C"{
 #endif
 
 #include <pthread.h>
+#include <stdint.h>
 #include "twit.h"
 #include "twitpool.h"
 
@@ -42,6 +43,26 @@ extern "C"{
  */
 struct twitpoollist{
 	struct twitpoollist_node *tpl_head;
+	unsigned long tpl_nextid; /**< Identifier given to the next node created */
+	struct twitpoollist_node **tpl_hearers; /**< The nodes by their number of hearer; NULL for the numbers free */
+	uint32_t tpl_hearercap; /**< Entries of tpl_hearers */
+};
+
+/**
+ * \struct hearertelemetry
+ *
+ * The hearertelemetry structure keeps track of how well a hearer keeps up with the twits sent to it.
+ * The members are grouped by who updates them and how.
+ */
+struct hearertelemetry{
+	// Updated with the lock of the twitpool owned
+	uint64_t ht_bytesQueued; /**< Number of bytes of the twits waiting in the twitpool */
+	// Updated by the hearer with atomic builtins; read by anyone
+	uint64_t ht_delivered; /**< Number of twits delivered to the hearer */
+	uint64_t ht_sendBlocked_ns; /**< Total time spent in send() to the hearer */
+	// Only used by the statistics updater, to turn the above into rates
+	uint64_t ht_lastDelivered;
+	uint64_t ht_lastSendBlocked_ns;
 };
 
 /**
@@ -54,7 +75,12 @@ struct twitpoollist_node{
 	struct twitpoollist_node *tpln_previous;
 	struct twitpool tpln_twitpool;
 	pthread_mutex_t tpln_lock; // Used to lock the twitpool; sayers put in here and hearers retrieve from here
+	uint64_t tpln_lockedat; // Time tpln_lock was acquired, as kept by lock_mutex() (see lockstats.h)
 	pthread_cond_t tpln_cond; // Used to signal that a twit was stored in the twitpool
+	unsigned long tpln_id; // Identifies the hearer of this twitpool in the statistics
+	uint32_t tpln_hearer; // Number of the hearer in the bitmaps (see bitmap.h); the lowest free when the node was created
+	int tpln_sockfd; // Socket of the hearer; -1 until the hearer is connected to the twitpool
+	struct hearertelemetry tpln_telemetry; // How well the hearer keeps up
 };
 
 
@@ -71,8 +97,8 @@ struct twitpoollist_node{
 int inittwitpoollist( struct twitpoollist * restrict tpl );
 
 /**
- * The newtwitpool() function shall create a new node in the struct twitpoollist object pointed to by parameter tpl. Function
- * newtwitpool() shall store the address of the new node in the object pointed to by parameter tplnode.
+ * The newtwitpool() function shall create a new node in the struct twitpoollist object pointed to by parameter tpl, with the lowest
+ * number of hearer free. Function newtwitpool() shall store the address of the new node in the object pointed to by parameter tplnode.
  *
  * @return The newtwitpool() function shall return zero if successful; otherwise, -1 shall be returned and errno shall be
  *	set to indicate the error.
@@ -83,7 +109,7 @@ int inittwitpoollist( struct twitpoollist * restrict tpl );
 int newtwitpool( struct twitpoollist * restrict tpl, struct twitpoollist_node ** restrict tplnode );
 
 /**
- * The removefromtwitpoollist() function shall remove from the list the node pointed to by  paramter tplnode.
+ * The removefromtwitpoollist() function shall remove from the list the node pointed to by  paramter tplnode and free its number.
  * It is undefined behavior if parameter tplnode has not been obtained via means of a call to the newtwitpool function.
  *
  * @return The removefromtwitpoollist() function shall return zero if successful; otherwise, -1 shall be returned and errno shall be
@@ -93,8 +119,8 @@ int newtwitpool( struct twitpoollist * restrict tpl, struct twitpoollist_node **
 int removefromtwitpoollist( struct twitpoollist * restrict tpl, struct twitpoollist_node * restrict tplnode );
 
 /**
- * The deltwitpoollist() function shall deallocate all the resources reserved for the struct twitpoollist object 
- * pointed to by parameter tpl. If parameter tpl is a NULL pointer no action shall occur.
+ * The deltwitpoollist() function shall deallocate all the resources reserved for the struct twitpoollist object
+ * pointed to by parameter tpl; no hearer shall be using its twitpool any more. If parameter tpl is a NULL pointer no action shall occur.
  *
  * @return Nothing.
  * @param tpl Pointer to the struct twitpoollist object.
@@ -117,6 +143,15 @@ void acquire_twitpool_in_twitpoollist_node( struct twitpoollist_node * restrict
  */
 void release_twitpool_in_twitpoollist_node( struct twitpoollist_node * restrict tpln );
 
+/**
+ * The wait_twitpool_in_twitpoollist_node() function shall wait until the condition of the twitpoollist_node pointed to by parameter
+ * tpln, which shall not be a NULL pointer, is signaled. The twitpool shall be owned by the caller and it is owned again when the
+ * wait_twitpool_in_twitpoollist_node() function returns.
+ *
+ * @return Nothing.
+ */
+void wait_twitpool_in_twitpoollist_node( struct twitpoollist_node * restrict tpln );
+
 #if defined( __cplusplus )
 }
 #endif
@@ -30,20 +30,31 @@
  * File twithear.c contains the implementation of the twithear program that is part of the project in Operating Systems at TUC.
  *
  * Usage:
- *	twithear ipaddr port timeunit
+ *	twithear [-s seq | -t ms | -c name | -T topic,... | -K keyword,... | -R 'regex ...' | [-N count] -G tag,... | [-N count] [-O] -S word,...]
+ *		ipaddr port timeunit
  * , where ipaddr and port define to which addr and port the twithear program will connect to and timeunit specifies the interval
  * by which the twithear program will receive a byte from the server.
  *
  * The twithear program does the following simple job:
  *	1) Connects to the twitserver (to the addr and port given as command line arguments)
- *	2) Starts receiving twits from the twitserver and prints them to stdout.
- * and it terminates on the arrival of a SIGINT signal (Control-C).
+ *	2) With -s or -t, given when port is the resuming port of the twitserver, asks for the twits after the one with sequence
+ *	number seq (the last one printed before) or for those since ms milliseconds since the Epoch; with -c for the twits after the
+ *	last one the twitserver sent with the cursor name, which it keeps across restarts; with -T, given when port is the topic port
+ *	of the twitserver, for the twits on the topics named, with -K, given for that port too, for the twits with any of the keywords,
+ *	and with -R, given for that port too, for the twits that match any of the regular expressions, and with -G, given for that port
+ *	too, for the twits with any of the hashtags and mentions, such as #rain or @alice, after the last count of them it has with -N;
+ *	with -S, given when port is the search port of the twitserver, for the last count twits, 10 without -N, with all of the words,
+ *	or with any of them with -O
+ *	3) Starts receiving twits from the twitserver and prints them to stdout; with -s, -t, -c or -S one a line with its sequence
+ *	number first, every timeunit.
+ * and it terminates on the arrival of a SIGINT signal (Control-C), or when the server closes the connection with -s, -t, -c or -S.
  *
  *
  * @author Tassos Souris
  */
 #include <unistd.h>
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
@@ -91,16 +102,78 @@ int main( int argc, char *argv[] ){
 	int timeunit;
 	int sockfd = -1; // Must initialize to -1 cause it is used as an error flag later
 	int status = EXIT_SUCCESS; // Must initialize to EXIT_SUCCESS (at the beginning to error has occured)
+	int resume = 0; // Whether -s, -t or -c was given
+	int bytime = 0;
+	unsigned long long value = 0;
+	const char *cursor = NULL;
+	const char *topics = NULL; // Given with -T
+	const char *keywords = NULL; // Given with -K
+	const char *regexes = NULL; // Given with -R
+	const char *tags = NULL; // Given with -G
+	const char *words = NULL; // Given with -S
+	int any = 0; // Whether -O was given
+	unsigned long recent = 0; // Given with -N
+	char *end = NULL;
+	int opt;
 	
 	// Verify that user gave the appropriate arguments
-	if ( argc != 4 ){
+	while ( ( opt = getopt( argc, argv, "s:t:c:T:K:R:G:N:OS:" ) ) != -1 ){
+		// -N goes with -G or -S, and -O with -S, before them
+		if ( opt == 'O' && !any && words == NULL ){
+			any = 1;
+			continue;
+		}
+		if ( opt == 'N' && recent == 0 && tags == NULL && words == NULL ){
+			recent = strtoul( optarg, &end, 10 );
+			if ( end == optarg || *end != '\0' || recent == 0 ){
+				usage( argv[ 0 ] );
+			}
+			continue;
+		}
+		if ( ( opt != 's' && opt != 't' && opt != 'c' && opt != 'T' && opt != 'K' && opt != 'R' && opt != 'G' && opt != 'S' ) || resume ||
+			topics != NULL || keywords != NULL || regexes != NULL || tags != NULL || words != NULL ||
+			( recent > 0 && opt != 'G' && opt != 'S' ) || ( any && opt != 'S' ) ){
+			usage( argv[ 0 ] );
+		}
+		if ( opt == 'S' ){
+			words = optarg;
+			continue;
+		}
+		if ( opt == 'G' ){
+			tags = optarg;
+			continue;
+		}
+		if ( opt == 'T' ){
+			topics = optarg;
+			continue;
+		}
+		if ( opt == 'K' ){
+			keywords = optarg;
+			continue;
+		}
+		if ( opt == 'R' ){
+			regexes = optarg;
+			continue;
+		}
+		resume = 1;
+		if ( opt == 'c' ){
+			cursor = optarg;
+			continue;
+		}
+		bytime = ( opt == 't' );
+		value = strtoull( optarg, &end, 10 );
+		if ( end == optarg || *end != '\0' ){
+			usage( argv[ 0 ] );
+		}
+	}
+	if ( argc - optind != 3 || ( recent > 0 && tags == NULL && words == NULL ) || ( any && words == NULL ) ){
 		usage( argv[ 0 ] );
 	}
 
 	// Retrieve the command line arguments
-	addr = argv[ 1 ];
-	port = argv[ 2 ];	
-	timeunit = atoi( argv[ 3 ] );
+	addr = argv[ optind ];
+	port = argv[ optind + 1 ];	
+	timeunit = atoi( argv[ optind + 2 ] );
 	assert( timeunit >= 0 );
 
 	// Set up the signal handling now
@@ -111,6 +184,33 @@ int main( int argc, char *argv[] ){
 		if ( ( sockfd = connect_to_twitserver( addr, port ) ) == -1 ){ 
 			status = EXIT_FAILURE; 
 		}
+		// Ask for the twits missed and receive them, then the new ones
+		else if ( resume ){
+			if ( ( cursor != NULL ? send_cursor_to_twitserver( sockfd, cursor ) : send_resume_to_twitserver( sockfd, bytime, value ) ) == -1 ||
+				recv_frames_from_twitserver( sockfd, timeunit ) == -1 ){
+				status = EXIT_FAILURE;
+			}
+		}
+		// Search and receive the twits found, until the server closes the connection
+		else if ( words != NULL ){
+			if ( send_search_to_twitserver( sockfd, words, recent > 0 ? ( unsigned )recent : 10u, any ) == -1 ||
+				recv_frames_from_twitserver( sockfd, timeunit ) == -1 ){
+				status = EXIT_FAILURE;
+			}
+		}
+		// Name the topics or give the keywords, the regular expressions or the hashtags and mentions first
+		else if ( topics != NULL && send_topics_to_twitserver( sockfd, topics ) == -1 ){
+			status = EXIT_FAILURE;
+		}
+		else if ( keywords != NULL && send_keywords_to_twitserver( sockfd, keywords ) == -1 ){
+			status = EXIT_FAILURE;
+		}
+		else if ( regexes != NULL && send_regexes_to_twitserver( sockfd, regexes ) == -1 ){
+			status = EXIT_FAILURE;
+		}
+		else if ( tags != NULL && send_tags_to_twitserver( sockfd, tags, ( unsigned )recent ) == -1 ){
+			status = EXIT_FAILURE;
+		}
 		// Start receiving twits from the twitserver
 		else if ( recv_from_twitserver( sockfd, timeunit ) == -1 ){ 
 			status = EXIT_FAILURE;
@@ -131,7 +231,8 @@ int main( int argc, char *argv[] ){
 // Display usage info and exit
 static void usage( const char * restrict programname ){
 	assert( programname != NULL );
-	error( "usage: %s addr port timeunit\n", programname );
+	error( "usage: %s [-s seq | -t ms | -c name | -T topic,... | -K keyword,... | -R 'regex ...' | [-N count] -G tag,... |"
+		" [-N count] [-O] -S word,...] addr port timeunit\n", programname );
 	exit( EXIT_FAILURE );
 }
 
@@ -30,14 +30,16 @@
  * File twitsay.c contains the implementation of the twitsay program that is part of the project in Operating Systems at TUC.
  *
  * Usage:
- *	twitsay ipaddr port
+ *	twitsay [-d] ipaddr port
  * , where ipaddr and port define to which addr and port the twithear program will connect to.
  *
  * The twitsay program performs the following simple steps:
  *	1) Connects to a twitserver (with the given addr and port)
  *	2) Reads a twit from stdin (max TWIT_MAXLEN characters)
  *	3) Sends the twit to the server
- *	4) Exits
+ *	4) With -d, given when port is the durable port of the twitserver, waits until the server acknowledges that the twit
+ *	is on its disk, prints its sequence number to stdout and fails if it is not
+ *	5) Exits
  *
  * @author Tassos Souris
  */
@@ -51,6 +53,7 @@
 #include "read.h"
 #include "config.h"
 #include "error.h"
+#include "server/ackframe.h"
 
 
 
@@ -74,15 +77,25 @@ int main( int argc, char *argv[] ){
 	char twit[ TWIT_MAXLEN + 1 ];
 	size_t twitlen = sizeof( twit ) / sizeof( twit[ 0 ] );
 	struct linger lingerbuf;
+	int durable = 0;
+	int ackstatus;
+	unsigned long long seq;
+	int opt;
 
 	// Verify that user gave the appropriate arguments
-	if ( argc != 3 ){
+	while ( ( opt = getopt( argc, argv, "d" ) ) != -1 ){
+		if ( opt != 'd' ){
+			usage( argv[ 0 ] );
+		}
+		durable = 1;
+	}
+	if ( argc - optind != 2 ){
 		usage( argv[ 0 ] );
 	}
 
 	// Retrieve the command line arguments
-	addr = argv[ 1 ];
-	port = argv[ 2 ];
+	addr = argv[ optind ];
+	port = argv[ optind + 1 ];
 
 	// Connect to the twitserver
 	if ( ( sockfd = connect_to_twitserver( addr, port ) ) == -1 ){ 
@@ -96,6 +109,20 @@ int main( int argc, char *argv[] ){
 	else if ( send_to_twitserver( sockfd, twit, ( size_t )nbytes + 1 ) == -1 ){
 		status = EXIT_FAILURE;
 	}
+	// Wait until the twit is on the disk of the server
+	else if ( durable ){
+		if ( recv_ack_from_twitserver( sockfd, &ackstatus, &seq ) == -1 ){
+			status = EXIT_FAILURE;
+		}
+		else if ( ackstatus == ACKFRAME_SYNCED ){
+			( void )printf( "%llu\n", seq );
+		}
+		else{
+			error( ackstatus == ACKFRAME_REJECTED ? "the twitserver is full; the twit was not taken\n" :
+				"the twitserver may have lost twit %llu\n", seq );
+			status = EXIT_FAILURE;
+		}
+	}
 
 	// Cleanup code
 
@@ -115,6 +142,6 @@ int main( int argc, char *argv[] ){
 // Display usage info and exit
 static void usage( const char * restrict programname ){
 	assert( programname != NULL );
-	error( "usage: %s addr port\n", programname );
+	error( "usage: %s [-d] addr port\n", programname );
 	exit( EXIT_FAILURE );
 }
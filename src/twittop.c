@@ -0,0 +1,237 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file twittop.c
+ *
+ * File twittop.c contains the implementation of the twittop program that is part of the project in Operating Systems at TUC.
+ *
+ * Usage:
+ *	twittop [interval]
+ * , where interval is the number of milliseconds between two refreshes of the view (1000 if not given).
+ *
+ * The twittop program maps the statistics page published by a twitserver running on the same machine (see server/statspage.h)
+ * and shows, like top, the statistics, the latency of each stage and the hearers that are furthest behind, refreshing until
+ * it gets interrupted with Control-C (SIGINT). It only reads the page so it costs nothing to the twitserver, however often
+ * it refreshes.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "server/statspage.h"
+#include "server/histogram.h"
+#include "error.h"
+
+
+
+// Number of refreshes without a new publication after which the twitserver is considered gone
+#define STALE_REFRESHES (3)
+
+
+
+/**
+ * The usage() function shall display to stderr information about the usage of the program and exit with exit status EXIT_FAILURE. 
+ * The name of the program is pointed to by parameter programname which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ * @param programname Pointer to the name of the program.
+ */
+static void usage( const char * restrict programname );
+
+/**
+ * The signal_handler() function is used to terminate the twittop program safely on the arrival of various signals.
+ *
+ * @return Nothing.
+ * @param signum The signal arrived.
+ */
+static void signal_handler( int signum );
+
+/**
+ * The setup_signal_handling() function shall initialize the handling needed for various signals.
+ *
+ * @return Nothing.
+ */
+static void setup_signal_handling( void );
+
+/**
+ * The show() function shall clear the terminal and print the data pointed to by parameter data. Parameter stale tells
+ * whether the data has not changed for a while.
+ *
+ * @return Nothing.
+ */
+static void show( struct statspage_data * restrict data, int stale );
+
+
+
+
+// This is set by the signal_handler() and tells main to terminate
+static volatile sig_atomic_t terminate = 0;
+
+
+
+int main( int argc, char *argv[] ){
+	const struct statspage *page = NULL;
+	struct statspage_data *data = NULL;
+	struct timespec interval;
+	unsigned seq;
+	unsigned lastseq = 0;
+	int unchanged = 0;
+	long ms = 1000;
+
+	// Verify that user gave the appropriate arguments
+	if ( argc > 2 ){
+		usage( argv[ 0 ] );
+	}
+	if ( argc == 2 && ( ms = atol( argv[ 1 ] ) ) <= 0 ){
+		usage( argv[ 0 ] );
+	}
+	interval.tv_sec = ms / 1000;
+	interval.tv_nsec = ( ms % 1000 ) * 1000000L;
+
+	// Set up the signal handling now
+	setup_signal_handling();
+
+	if ( openstatspage( &page ) == -1 ){
+		error( "Failed to open the statistics page %s: %s. Is the twitserver running?\n", STATSPAGE_NAME, strerror( errno ) );
+		exit( EXIT_FAILURE );
+	}
+	// The data is too large to be kept on the stack comfortably
+	if ( ( data = malloc( sizeof( *data ) ) ) == NULL ){
+		error( "Failed to allocate memory: %s\n", strerror( errno ) );
+		closestatspage( page );
+		exit( EXIT_FAILURE );
+	}
+
+	while ( !terminate ){
+		seq = readstatspage( page, data );
+		unchanged = ( seq == lastseq ) ? unchanged + 1 : 0;
+		lastseq = seq;
+		show( data, unchanged >= STALE_REFRESHES );
+		// A signal interrupts the sleep and the loop checks terminate
+		( void )nanosleep( &interval, NULL );
+	}
+
+	// Clean-up code
+	free( data );
+	closestatspage( page );
+
+	exit( EXIT_SUCCESS );
+}
+
+
+
+// Display usage info and exit
+static void usage( const char * restrict programname ){
+	assert( programname != NULL );
+	error( "usage: %s [interval]\n", programname );
+	exit( EXIT_FAILURE );
+}
+
+// This is called when various signals arrive. It tells main to terminate
+static void signal_handler( int signum ){
+	( void )signum;
+	terminate = 1;
+}
+
+// Terminate on SIGINT and SIGTERM
+static void setup_signal_handling( void ){
+	sigset_t sigset;
+	struct sigaction sig_action;
+
+	while ( sigfillset( &sigset ) == -1 ){ continue; }
+
+	( void )memset( &sig_action, 0, sizeof( sig_action ) );
+	sig_action.sa_handler = &signal_handler;
+	sig_action.sa_mask = sigset;
+
+	while ( sigaction( SIGINT, &sig_action, NULL ) == -1 ){ continue; }
+	while ( sigaction( SIGTERM, &sig_action, NULL ) == -1 ){ continue; }
+}
+
+// Print everything in the page
+static void show( struct statspage_data * restrict data, int stale ){
+	const struct statistics *stats = NULL;
+	const struct hearerlag *hl = NULL;
+	int stage;
+	int i;
+
+	assert( data != NULL );
+
+	stats = &data->spd_stats;
+
+	// Home the cursor and clear the screen
+	printf( "\033[H\033[2J" );
+	printf( "twitserver%s\n\n", stale ? " (not updating)" : "" );
+	printf( "Threads %d  Hearers %d  Sayers %d  Stored %d  Arrived %llu  Delivered %llu\n\n",
+		stats->stats_threadsNum, stats->stats_hearersNum, stats->stats_sayersNum, stats->stats_storedTwitsNum,
+		( unsigned long long )stats->stats_arrivedTwitsNum, ( unsigned long long )stats->stats_deliveredTwitsNum );
+
+	printf( "%-10s %10s %10s %10s %10s %10s\n", "twits/s", "1s", "10s", "60s", "p99", "peak" );
+	printf( "%-10s %10.2f %10.2f %10.2f %10.2f %10.2f\n", "incoming", stats->stats_incomingRate.rw_rate1s,
+		stats->stats_incomingRate.rw_rate10s, stats->stats_incomingRate.rw_rate60s,
+		stats->stats_incomingRate.rw_p99, stats->stats_incomingRate.rw_peak );
+	printf( "%-10s %10.2f %10.2f %10.2f %10.2f %10.2f\n\n", "outcoming", stats->stats_outcomingRate.rw_rate1s,
+		stats->stats_outcomingRate.rw_rate10s, stats->stats_outcomingRate.rw_rate60s,
+		stats->stats_outcomingRate.rw_p99, stats->stats_outcomingRate.rw_peak );
+
+	printf( "%-16s %10s %10s %10s %10s %10s\n", "latency (us)", "count", "p50", "p99", "p99.9", "max" );
+	for ( stage = 0; stage < LATENCY_STAGES; ++stage ){
+		data->spd_stagename[ stage ][ STATSPAGE_STAGENAME_MAXLEN - 1 ] = '\0';
+		printf( "%-16s %10llu %10.1f %10.1f %10.1f %10.1f\n", data->spd_stagename[ stage ],
+			( unsigned long long )data->spd_latency[ stage ].h_count,
+			histogrampercentile( &data->spd_latency[ stage ], 50.0 ) / 1000.0,
+			histogrampercentile( &data->spd_latency[ stage ], 99.0 ) / 1000.0,
+			histogrampercentile( &data->spd_latency[ stage ], 99.9 ) / 1000.0,
+			data->spd_latency[ stage ].h_max / 1000.0 );
+	}
+
+	// The server keeps the hearers furthest behind first; all of them fit in a terminal
+	printf( "\n%-8s %8s %10s %11s %9s %10s %8s %8s %6s %8s %9s\n", "hearer", "queued", "bytes", "oldest(ms)",
+		"twits/s", "delivered", "blocked", "retrans", "cwnd", "unacked", "rtt(us)" );
+	for ( i = 0; i < stats->stats_hearerLagNum && i < HEARERS_MAXCOUNT; ++i ){
+		hl = &stats->stats_hearerLag[ i ];
+		printf( "%-8lu %8llu %10llu %11.1f %9.2f %10llu %7.1f%% %8u %6u %8u %9u\n",
+			hl->hl_id,
+			( unsigned long long )hl->hl_queued,
+			( unsigned long long )hl->hl_bytesQueued,
+			hl->hl_oldest_ns / 1000000.0,
+			hl->hl_deliveredRate,
+			( unsigned long long )hl->hl_delivered,
+			hl->hl_sendBlocked * 100.0,
+			( unsigned )hl->hl_retransmits,
+			( unsigned )hl->hl_sndCwnd,
+			( unsigned )hl->hl_unacked,
+			( unsigned )hl->hl_rtt_us );
+	}
+
+	( void )fflush( stdout );
+}
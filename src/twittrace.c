@@ -0,0 +1,327 @@
+/**
+	Copyright (c) 2009,2010, Tassos Souris
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer in the
+		  documentation and/or other materials provided with the distribution.
+		* Neither the name of the <organization> nor the
+		  names of its contributors may be used to endorse or promote products
+		  derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY Tassos Souris ''AS IS'' AND ANY
+	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL Tassos Souris BE LIABLE FOR ANY
+	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * \file twittrace.c
+ *
+ * File twittrace.c contains the implementation of the twittrace program that is part of the project in Operating Systems at TUC.
+ *
+ * Usage:
+ *	twittrace tracefile...
+ * , where each tracefile is a file written by the twitserver with the events its threads traced (see server/trace.h).
+ *
+ * The twittrace program merges the events of all the files given, in the order they happened, and prints them to stdout
+ * as JSON that the Chrome trace viewer (chrome://tracing, or ui.perfetto.dev) can open. Each thread of the twitserver is
+ * shown as a track of its own and the twit each event is about is in the arguments of the event. Events found in more than
+ * one file are printed once.
+ *
+ * @author Tassos Souris
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "server/trace.h"
+#include "error.h"
+
+
+
+/**
+ * \struct mergedevent
+ *
+ * The mergedevent structure is an event placed on the timeline of the monotonic clock.
+ */
+struct mergedevent{
+	double me_ts; /**< Microseconds of the monotonic clock */
+	double me_dur; /**< Microseconds */
+	uint32_t me_thread;
+	struct traceevent me_event;
+};
+
+/**
+ * \struct threadname
+ *
+ * The threadname structure names a thread of the twitserver.
+ */
+struct threadname{
+	uint32_t tn_thread;
+	char tn_name[ TRACE_THREADNAME_MAXLEN ];
+};
+
+/**
+ * \struct merge
+ *
+ * The merge structure keeps everything read from the files.
+ */
+struct merge{
+	struct mergedevent *m_events;
+	size_t m_eventsNum;
+	size_t m_eventsMax;
+	struct threadname *m_threads;
+	size_t m_threadsNum;
+	size_t m_threadsMax;
+};
+
+
+
+/**
+ * The usage() function shall display to stderr information about the usage of the program and exit with exit status EXIT_FAILURE. 
+ * The name of the program is pointed to by parameter programname which shall not be a NULL pointer.
+ *
+ * @return Nothing.
+ * @param programname Pointer to the name of the program.
+ */
+static void usage( const char * restrict programname );
+
+/**
+ * The readtracefile() function shall read the trace file named by parameter path and add its events and threads to the struct merge
+ * object pointed to by parameter m.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned and an error message printed.
+ */
+static int readtracefile( const char * restrict path, struct merge * restrict m );
+
+/**
+ * The addthread() function shall add to the struct merge object pointed to by parameter m the name of the thread given as parameter,
+ * unless it is known already.
+ *
+ * @return Upon successful completion zero shall be returned; otherwise, -1 shall be returned.
+ */
+static int addthread( struct merge * restrict m, uint32_t thread, const char * restrict name );
+
+/**
+ * The compareevents() function shall compare the two struct mergedevent objects pointed to by parameters a and b by time, then
+ * by thread and then by the order in the ring. It is used with qsort().
+ *
+ * @return Refer to the qsort() function.
+ */
+static int compareevents( const void *a, const void *b );
+
+/**
+ * The sameevent() function shall tell whether the two struct mergedevent objects pointed to by parameters a and b are the same
+ * event, read from two files.
+ *
+ * @return 1 if they are; otherwise, zero.
+ */
+static int sameevent( const struct mergedevent * restrict a, const struct mergedevent * restrict b );
+
+/**
+ * The printjson() function shall print the contents of the struct merge object pointed to by parameter m to stdout, in the JSON
+ * format of the Chrome trace viewer. The events shall be sorted already.
+ *
+ * @return Nothing.
+ */
+static void printjson( const struct merge * restrict m );
+
+
+
+int main( int argc, char *argv[] ){
+	struct merge m;
+	int i;
+
+	// Verify that user gave the appropriate arguments
+	if ( argc < 2 ){
+		usage( argv[ 0 ] );
+	}
+
+	( void )memset( &m, 0, sizeof( m ) );
+	for ( i = 1; i < argc; ++i ){
+		if ( readtracefile( argv[ i ], &m ) == -1 ){
+			exit( EXIT_FAILURE );
+		}
+	}
+
+	qsort( m.m_events, m.m_eventsNum, sizeof( m.m_events[ 0 ] ), compareevents );
+	printjson( &m );
+
+	free( m.m_events );
+	free( m.m_threads );
+
+	exit( EXIT_SUCCESS );
+}
+
+
+
+// Display usage info and exit
+static void usage( const char * restrict programname ){
+	assert( programname != NULL );
+	error( "usage: %s tracefile...\n", programname );
+	exit( EXIT_FAILURE );
+}
+
+// Header, then the rings until EOF
+static int readtracefile( const char * restrict path, struct merge * restrict m ){
+	struct tracefileheader fh;
+	struct traceringheader rh;
+	struct mergedevent *me = NULL;
+	FILE *fp = NULL;
+	uint32_t ring;
+	uint32_t i;
+
+	assert( path != NULL );
+	assert( m != NULL );
+
+	if ( ( fp = fopen( path, "rb" ) ) == NULL ){
+		error( "%s: %s\n", path, strerror( errno ) );
+		return ( -1 );
+	}
+	if ( fread( &fh, sizeof( fh ), 1, fp ) != 1 || fh.tfh_magic != TRACE_MAGIC || fh.tfh_version != TRACE_VERSION ){
+		error( "%s: not a trace file of version %d\n", path, TRACE_VERSION );
+		( void )fclose( fp );
+		return ( -1 );
+	}
+
+	// A file cut short still has something to say; keep what is there
+	for ( ring = 0; ring < fh.tfh_rings && fread( &rh, sizeof( rh ), 1, fp ) == 1; ++ring ){
+		rh.trh_name[ TRACE_THREADNAME_MAXLEN - 1 ] = '\0';
+		if ( addthread( m, rh.trh_thread, rh.trh_name ) == -1 ){
+			( void )fclose( fp );
+			return ( -1 );
+		}
+		for ( i = 0; i < rh.trh_events; ++i ){
+			if ( m->m_eventsNum == m->m_eventsMax ){
+				m->m_eventsMax = m->m_eventsMax ? 2 * m->m_eventsMax : 4096;
+				if ( ( me = realloc( m->m_events, m->m_eventsMax * sizeof( *me ) ) ) == NULL ){
+					error( "Failed to allocate memory: %s\n", strerror( errno ) );
+					( void )fclose( fp );
+					return ( -1 );
+				}
+				m->m_events = me;
+			}
+			me = &m->m_events[ m->m_eventsNum ];
+			if ( fread( &me->me_event, sizeof( me->me_event ), 1, fp ) != 1 ){
+				break;
+			}
+			if ( me->me_event.te_type >= TRACE_EVENT_TYPES ){
+				continue;
+			}
+			// Cycles relative to the moment the file was written, then to the monotonic clock
+			me->me_ts = ( fh.tfh_ns + ( double )( int64_t )( me->me_event.te_cycles - fh.tfh_cycles ) * fh.tfh_nspercycle ) / 1000.0;
+			me->me_dur = me->me_event.te_duration * fh.tfh_nspercycle / 1000.0;
+			me->me_thread = rh.trh_thread;
+			++m->m_eventsNum;
+		}
+	}
+
+	( void )fclose( fp );
+
+	return ( 0 );
+}
+
+// Linear search; there are few threads
+static int addthread( struct merge * restrict m, uint32_t thread, const char * restrict name ){
+	struct threadname *tn = NULL;
+	size_t i;
+
+	assert( m != NULL );
+	assert( name != NULL );
+
+	for ( i = 0; i < m->m_threadsNum; ++i ){
+		if ( m->m_threads[ i ].tn_thread == thread ){
+			return ( 0 );
+		}
+	}
+	if ( m->m_threadsNum == m->m_threadsMax ){
+		m->m_threadsMax = m->m_threadsMax ? 2 * m->m_threadsMax : 64;
+		if ( ( tn = realloc( m->m_threads, m->m_threadsMax * sizeof( *tn ) ) ) == NULL ){
+			error( "Failed to allocate memory: %s\n", strerror( errno ) );
+			return ( -1 );
+		}
+		m->m_threads = tn;
+	}
+	tn = &m->m_threads[ m->m_threadsNum++ ];
+	tn->tn_thread = thread;
+	( void )memcpy( tn->tn_name, name, sizeof( tn->tn_name ) );
+
+	return ( 0 );
+}
+
+// Time, thread, cycles
+static int compareevents( const void *a, const void *b ){
+	const struct mergedevent *ma = ( const struct mergedevent * )a;
+	const struct mergedevent *mb = ( const struct mergedevent * )b;
+
+	if ( ma->me_ts != mb->me_ts ){
+		return ( ma->me_ts < mb->me_ts ? -1 : 1 );
+	}
+	if ( ma->me_thread != mb->me_thread ){
+		return ( ma->me_thread < mb->me_thread ? -1 : 1 );
+	}
+	if ( ma->me_event.te_cycles != mb->me_event.te_cycles ){
+		return ( ma->me_event.te_cycles < mb->me_event.te_cycles ? -1 : 1 );
+	}
+
+	return ( 0 );
+}
+
+// Same thread, same moment, same twit, same type
+static int sameevent( const struct mergedevent * restrict a, const struct mergedevent * restrict b ){
+	assert( a != NULL );
+	assert( b != NULL );
+
+	return ( a->me_thread == b->me_thread && a->me_event.te_cycles == b->me_event.te_cycles &&
+		a->me_event.te_twit == b->me_event.te_twit && a->me_event.te_type == b->me_event.te_type );
+}
+
+// One object per event; events with a duration are complete events ("X"), the rest instant events ("i")
+static void printjson( const struct merge * restrict m ){
+	const struct mergedevent *me = NULL;
+	const char *separator = "";
+	size_t i;
+
+	assert( m != NULL );
+
+	printf( "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+	for ( i = 0; i < m->m_threadsNum; ++i ){
+		printf( "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s %lu\"}}",
+			separator, ( unsigned long )m->m_threads[ i ].tn_thread, m->m_threads[ i ].tn_name,
+			( unsigned long )m->m_threads[ i ].tn_thread );
+		separator = ",\n";
+	}
+	for ( i = 0; i < m->m_eventsNum; ++i ){
+		me = &m->m_events[ i ];
+		if ( i > 0 && sameevent( me, &m->m_events[ i - 1 ] ) ){
+			continue;
+		}
+		printf( "%s{\"name\":\"%s\",\"cat\":\"twit\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,",
+			separator, traceeventname( me->me_event.te_type ), ( unsigned long )me->me_thread, me->me_ts );
+		if ( me->me_event.te_duration != 0 ){
+			printf( "\"ph\":\"X\",\"dur\":%.3f,", me->me_dur );
+		}
+		else{
+			printf( "\"ph\":\"i\",\"s\":\"t\"," );
+		}
+		printf( "\"args\":{\"twit\":\"%llu\",\"arg\":%u}}",
+			( unsigned long long )me->me_event.te_twit, ( unsigned )me->me_event.te_arg );
+		separator = ",\n";
+	}
+	printf( "\n]}\n" );
+	fflush( stdout );
+
+	return ;
+}